@@ -5,6 +5,7 @@
 #pragma once
 
 #include <cstddef>
+#include <vector>
 #include "configure.hpp"
 #include "memory.hpp"
 #include "stream.hpp"
@@ -43,4 +44,40 @@ namespace mango
         void write(const void* data, size_t bytes);
     };
 
+    // SegmentedBuffer is a rope of fixed-size pages from a shared pool. Growing
+    // never moves existing data and the pages can be handed to writev() as-is.
+
+    class SegmentedBuffer : public Stream
+    {
+    protected:
+        std::vector<Memory> m_pages; // Memory::size is the used part of the page
+        u64 m_size;
+        u64 m_offset;
+
+    public:
+        enum { PAGE_SIZE = 64 * 1024 };
+
+        SegmentedBuffer();
+        ~SegmentedBuffer();
+
+        void reset();
+
+        // direct write into the tail: acquire() returns at least bytes
+        // of writable memory, commit() appends what was actually written
+        Memory acquire(size_t bytes);
+        void commit(size_t bytes);
+
+        // move all pages from source to the end of this buffer
+        void append(SegmentedBuffer& source);
+
+        const std::vector<Memory>& segments() const;
+
+        // stream
+        u64 size() const;
+        u64 offset() const;
+        void seek(u64 distance, SeekMode mode);
+        void read(void* dest, size_t bytes);
+        void write(const void* data, size_t bytes);
+    };
+
 } // namespace mango
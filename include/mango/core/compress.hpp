@@ -8,10 +8,54 @@
 #include "configure.hpp"
 #include "memory.hpp"
 #include "object.hpp"
+#include "stream.hpp"
 
 namespace mango
 {
 
+    // -----------------------------------------------------------------------
+    // CompressionContext
+    // -----------------------------------------------------------------------
+
+    // The compressors allocate large working state (deflate ~300 KB, bzip2 up to 8 MB,
+    // lzma match finders, zstd contexts) on every call, which dominates runtime for
+    // small payloads. The context recycles these allocations; every thread has its own
+    // context which the compression functions use implicitly. The allocate() / free()
+    // functions have zlib calling convention so that the context can be passed
+    // explicitly as the opaque pointer of a miniz stream.
+
+    class CompressionContext : private NonCopyable
+    {
+    protected:
+        struct Block
+        {
+            void* address;
+            size_t size;
+        };
+
+        std::vector<Block> m_cache;
+        size_t m_cache_size;
+
+        void* m_zstd_compress;
+        void* m_zstd_decompress;
+
+    public:
+        CompressionContext();
+        ~CompressionContext();
+
+        void* allocate(size_t size);
+        void deallocate(void* address);
+        void purge();
+
+        void* getZstdCompressContext();
+        void* getZstdDecompressContext();
+
+        static CompressionContext& getThreadContext();
+
+        static void* allocate(void* opaque, size_t items, size_t size);
+        static void deallocate(void* opaque, void* address);
+    };
+
     // -----------------------------------------------------------------------
     // stream compression
     // -----------------------------------------------------------------------
@@ -191,4 +235,89 @@ namespace mango
     Compressor getCompressor(Compressor::Method method);
     Compressor getCompressor(const std::string& name);
 
+    // -----------------------------------------------------------------------
+    // CompressedOutputStream / CompressedInputStream
+    // -----------------------------------------------------------------------
+
+    // Stream adapters which compress the data written into them, or decompress the
+    // data read from them, using a standard container format. The adapters keep only
+    // bounded internal buffers so that arbitrarily large data can be (de)compressed on
+    // the fly, for example by giving a CompressedOutputStream to an image encoder.
+
+    // The wrapped stream must not be accessed until the adapter is finished; the
+    // output stream writes the container trailer in finish() or in the destructor.
+    // The background mode compresses in a worker thread while the caller keeps
+    // writing into the next block.
+
+    // Seeking is not supported, except forward seeking in the input stream which
+    // decompresses and discards the skipped data. The size() is the number of
+    // uncompressed bytes written or read so far.
+
+    // The values are fixed so that they can be stored; they do not depend on which
+    // formats the build enables.
+    enum class CompressedFormat
+    {
+        ZLIB  = 0, // zlib wrapped deflate
+        GZIP  = 1, // gzip wrapped deflate
+#ifdef MANGO_ENABLE_LICENSE_BSD
+        LZ4   = 2, // lz4 frame
+        ZSTD  = 3, // zstd frame
+#endif
+#ifdef MANGO_ENABLE_LICENSE_ZLIB
+        BZIP2 = 4, // bzip2
+#endif
+        XZ    = 5, // xz (lzma2)
+    };
+
+    class CompressedOutputStream : public Stream
+    {
+    public:
+        struct Encoder;
+        struct Worker;
+
+    protected:
+        Encoder* m_encoder;
+        Worker* m_worker;
+        std::vector<u8> m_buffer;
+        u64 m_size;
+        bool m_finished;
+
+        void flush();
+
+    public:
+        CompressedOutputStream(Stream& stream, CompressedFormat format, int level = 6, bool background = false);
+        ~CompressedOutputStream();
+
+        void finish();
+
+        u64 size() const;
+        u64 offset() const;
+        void seek(u64 distance, SeekMode mode);
+        void read(void* dest, size_t size);
+        void write(const void* data, size_t size);
+    };
+
+    class CompressedInputStream : public Stream
+    {
+    public:
+        struct Decoder;
+
+    protected:
+        Decoder* m_decoder;
+        u64 m_offset;
+
+    public:
+        CompressedInputStream(Stream& stream, CompressedFormat format);
+        ~CompressedInputStream();
+
+        // read as much as is available (up to size bytes); returns zero at end of data
+        size_t readsome(void* dest, size_t size);
+
+        u64 size() const;
+        u64 offset() const;
+        void seek(u64 distance, SeekMode mode);
+        void read(void* dest, size_t size);
+        void write(const void* data, size_t size);
+    };
+
 } // namespace mango
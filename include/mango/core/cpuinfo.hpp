@@ -60,6 +60,8 @@ namespace mango
         CPU_ARM_CRC32  = 0x0010000000000000
     };
 
+    // The runtime dispatch uses these flags; the MANGO_CPU_LEVEL environment
+    // variable can limit them to force a lower code path for testing.
 	u64 getCPUFlags();
 
 } // namespace mango
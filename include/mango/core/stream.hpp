@@ -42,6 +42,15 @@ namespace mango
         {
             write(memory.address, memory.size);
         }
+
+        // gather write; streams with a native vectored write override this
+        virtual void writev(const Memory* segments, size_t count)
+        {
+            for (size_t i = 0; i < count; ++i)
+            {
+                write(segments[i].address, segments[i].size);
+            }
+        }
     };
 
     namespace detail
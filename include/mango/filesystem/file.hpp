@@ -54,6 +54,7 @@ namespace filesystem {
         void seek(u64 distance, SeekMode mode);
         void read(void* dest, size_t size);
         void write(const void* data, size_t size);
+        void writev(const Memory* segments, size_t count);
     };
 
 } // namespace filesystem
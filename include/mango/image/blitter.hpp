@@ -51,6 +51,28 @@ namespace mango
         u32 initMask;
         u32 copyMask;
 
+        // component layout for the generated conversion kernels; each destination component
+        // is computed as t = (s >> srcShift & srcMask) * mul + bias, (t + (t >> round)) >> shift
+        struct Channel
+        {
+            u32 srcShift;
+            u32 srcMask;
+            u32 mul;
+            u32 bias;
+            u32 round;
+            u32 shift;
+            u32 destShift;
+        } channel[4];
+
+        u64 fillMask; // destination bits which are set without a source component
+        int srcBytes;
+        int destBytes;
+
+        // byte permutation of shufflePixels pixels; the index 0x80 clears the byte
+        u8 shuffleIndex[16];
+        u8 shuffleFill[16];
+        int shufflePixels;
+
 #ifdef MANGO_ENABLE_SSE2
         __m128 sseScale;
         __m128i sseSrcMask;
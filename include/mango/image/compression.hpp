@@ -34,6 +34,7 @@ namespace mango
             ASTC        = 12,
             ASTC_HDR    = 13,
             PACKED      = 14,
+            ETC1S       = 15,
         };
 
         enum CompressionFlags : u32
@@ -173,6 +174,12 @@ namespace mango
             ASTC_SRGB_ALPHA_6x6x5         = makeTextureCompression(ASTC_HDR, 18, ORIGIN | ALPHA | SRGB),
             ASTC_SRGB_ALPHA_6x6x6         = makeTextureCompression(ASTC_HDR, 19, ORIGIN | ALPHA | SRGB),
 
+            // ETC1S intermediate format (transcodable)
+            ETC1S_RGB                     = makeTextureCompression(ETC1S, 0, 0),
+            ETC1S_SRGB                    = makeTextureCompression(ETC1S, 1, SRGB),
+            ETC1S_RGBA                    = makeTextureCompression(ETC1S, 2, ALPHA),
+            ETC1S_SRGB_ALPHA              = makeTextureCompression(ETC1S, 3, ALPHA | SRGB),
+
             // Packed Pixels
             RGB9_E5                       = makeTextureCompression(PACKED, 0, FLOAT),
             R11F_G11F_B10F                = makeTextureCompression(PACKED, 1, FLOAT),
@@ -201,7 +208,17 @@ namespace mango
             BC7_UNORM_SRGB                = BPTC_SRGB_ALPHA_UNORM
         };
 
+        // encoder tier of compress(); FAST selects the real-time encoders of BC1, BC3, BC4
+        // and BC5 (unsigned) and the smaller searches of the ETC2, EAC, ASTC and ETC1S encoders,
+        // the other formats (BC2, BC6H, BC7, ETC1, ...) always use the HIGH quality encoders
+        enum class Quality
+        {
+            HIGH,
+            FAST
+        };
+
         typedef void (*DecodeFunc)(const TextureCompressionInfo& info, u8* output, const u8* input, int stride);
+        typedef void (*DecodeBlocksFunc)(const TextureCompressionInfo& info, u8* output, const u8* input, int stride, int count);
         typedef void (*EncodeFunc)(const TextureCompressionInfo& info, u8* output, const u8* input, int stride);
 
         int width; // block width
@@ -209,15 +226,19 @@ namespace mango
         int bytes; // block size in bytes
         Format format; // encode source format / decode target format
         DecodeFunc decode; // decoding function
+        DecodeBlocksFunc decodeBlocks; // decoding function of a row of blocks (optional)
+        Format blocksFormat; // decodeBlocks target format; when it is narrower than format it is
+                             // used only for the surfaces which do not have more precision
         EncodeFunc encode; // encoding function
         TextureCompression compression; // block format (including flags)
 
         TextureCompressionInfo();
         TextureCompressionInfo(TextureCompression compression);
-        TextureCompressionInfo(int width, int height, int bytes, const Format& format, DecodeFunc decode, EncodeFunc encode, TextureCompression compression);
+        TextureCompressionInfo(int width, int height, int bytes, const Format& format, DecodeFunc decode, EncodeFunc encode, TextureCompression compression,
+                               DecodeBlocksFunc decodeBlocks = nullptr, const Format& blocksFormat = FORMAT_NONE);
 
         void decompress(const Surface& surface, Memory memory) const;
-        void compress(Memory memory, const Surface& surface) const;
+        void compress(Memory memory, const Surface& surface, Quality quality = Quality::HIGH) const;
 
         CompressionFormat getCompressionFormat() const
         {
@@ -234,6 +255,15 @@ namespace mango
     using TextureCompressionFormat = TextureCompressionInfo::CompressionFormat;
     using TextureCompressionFlags = TextureCompressionInfo::CompressionFlags;
     using TextureCompression = TextureCompressionInfo::TextureCompression;
+    using TextureQuality = TextureCompressionInfo::Quality;
+
+    // The ETC1S compressions store the texture once for every GPU; the blocks are transcoded
+    // into ETC1, ETC2 / EAC, BC1, BC3, BC4, BC5 and 4x4 ASTC blocks directly from their base
+    // colors and selectors. The ASTC blocks with varying alpha, or all of them when the height
+    // is not a multiple of four, are encoded from the decoded pixels instead.
+    bool isTranscodable(TextureCompression source, TextureCompression target);
+    void transcodeBlocks(Memory output, TextureCompression target, Memory input, TextureCompression source,
+                         int width, int height);
 
     namespace opengl
     {
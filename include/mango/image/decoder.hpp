@@ -5,6 +5,7 @@
 #pragma once
 
 #include <string>
+#include <vector>
 #include "../core/object.hpp"
 #include "format.hpp"
 #include "compression.hpp"
@@ -14,6 +15,38 @@
 namespace mango
 {
 
+    // Planar YCbCr 4:2:0 with 8 bit samples. The chroma planes are (width + 1) / 2 by
+    // (height + 1) / 2 samples. NV12 stores the Cb and Cr samples interleaved in the u plane.
+    struct YUVPlanes
+    {
+        enum Layout
+        {
+            I420,
+            NV12
+        };
+
+        Layout layout = I420;
+
+        u8* y = nullptr;
+        int ystride = 0;
+
+        u8* u = nullptr;
+        int ustride = 0;
+
+        u8* v = nullptr; // I420 only
+        int vstride = 0;
+    };
+
+    // Header and metadata of an image read without constructing a decoder. The
+    // metadata points into the probed memory.
+    struct ImageProbe
+    {
+        ImageHeader header;
+        Memory exif; // TIFF structure for Exif(), empty when not present
+        Memory icc;  // ICC profile; zlib compressed in PNG files
+        bool success = false;
+    };
+
     class ImageDecoderInterface : protected NonCopyable
     {
     public:
@@ -26,12 +59,14 @@ namespace mango
         // optional interface
         virtual Exif exif();
         virtual Memory memory(int level, int depth, int face);
+        virtual bool decodeYUV(const YUVPlanes& planes);
     };
 
     class ImageDecoder : protected NonCopyable
     {
     public:
         typedef ImageDecoderInterface* (*CreateFunc)(Memory memory);
+        typedef bool (*ProbeFunc)(ImageProbe& probe, Memory memory);
 
         ImageDecoder(Memory memory, const std::string& extension);
         ~ImageDecoder();
@@ -42,6 +77,7 @@ namespace mango
         Exif exif();
         Memory memory(int level, int depth, int face);
         void decode(Surface& dest, Palette* palette = nullptr, int level = 0, int depth = 0, int face = 0);
+        bool decodeYUV(const YUVPlanes& planes); // false when the format has no planar output
 
     protected:
         ImageDecoderInterface* m_interface;
@@ -51,4 +87,11 @@ namespace mango
     void registerImageDecoder(ImageDecoder::CreateFunc func, const std::string& extension);
     bool isImageDecoder(const std::string& extension);
 
+    // Probing reads only the header; formats without a registered probe fall back to
+    // ImageDecoder::header(). The batch versions probe the images concurrently.
+    void registerImageProbe(ImageDecoder::ProbeFunc func, const std::string& extension);
+    ImageProbe probeImage(Memory memory, const std::string& extension);
+    std::vector<ImageProbe> probeImages(const std::vector<Memory>& memory, const std::string& extension);
+    std::vector<ImageProbe> probeImages(const std::vector<Memory>& memory, const std::vector<std::string>& extensions);
+
 } // namespace mango
@@ -15,10 +15,50 @@
 namespace mango
 {
 
+    struct Texture;
+
+    struct ImageEncodeOptions
+    {
+        // lossy compression: 0.0 (smallest output) .. 1.0 (best quality)
+        float quality = 1.0f;
+
+        // chroma resolution for encoders which store YCbCr (JPEG)
+        enum Subsampling
+        {
+            SUBSAMPLING_444, // full resolution
+            SUBSAMPLING_422, // half horizontal resolution
+            SUBSAMPLING_420, // half horizontal and vertical resolution
+        } subsampling = SUBSAMPLING_444;
+
+        // image specific huffman tables (JPEG); smaller output but encodes in two passes
+        bool optimize = false;
+
+        // progressive scans (JPEG); always use optimized huffman tables
+        bool progressive = false;
+
+        // block compression of the surface (DDS, KTX, KTX2, PVR)
+        TextureCompression compression = TextureCompression::NONE;
+
+        // encoder tier of the block compression; only BC1, BC3, BC4, BC5 (unsigned), ETC2, EAC,
+        // ASTC and ETC1S have a FAST tier, the other formats (BC2, BC6H, BC7, ETC1, ...) are
+        // always encoded with the HIGH quality encoders
+        TextureQuality compressionQuality = TextureQuality::HIGH;
+
+        // generate the mipmap chain of the surface (DDS, KTX, KTX2, PVR)
+        bool mipmaps = false;
+
+        // images to write instead of the surface (DDS, KTX, KTX2, PVR); the levels and faces
+        // are written as they are stored without compressing them again
+        const Texture* texture = nullptr;
+
+        // zstd supercompression level of the mipmap levels (KTX2); 0 stores them as they are
+        int supercompression = 0;
+    };
+
     class ImageEncoder : protected NonCopyable
     {
     public:
-        typedef void (*CreateFunc)(Stream& output, const Surface& source, float quality);
+        typedef void (*CreateFunc)(Stream& output, const Surface& source, const ImageEncodeOptions& options);
 
         ImageEncoder(const std::string& extension);
         ~ImageEncoder();
@@ -26,6 +66,7 @@ namespace mango
         bool isEncoder() const;
 
         void encode(Stream& output, const Surface& source, float quality);
+        void encode(Stream& output, const Surface& source, const ImageEncodeOptions& options);
 
     protected:
         CreateFunc m_encode;
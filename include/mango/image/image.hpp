@@ -14,3 +14,5 @@
 #include "encoder.hpp"
 #include "blitter.hpp"
 #include "surface.hpp"
+#include "texture.hpp"
+#include "jpeg.hpp"
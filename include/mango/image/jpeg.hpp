@@ -0,0 +1,82 @@
+/*
+    MANGO Multimedia Development Platform
+    Copyright (C) 2012-2019 Twilight Finland 3D Oy Ltd. All rights reserved.
+*/
+#pragma once
+
+#include <string>
+#include <vector>
+#include "../core/configure.hpp"
+#include "../core/memory.hpp"
+#include "../core/stream.hpp"
+#include "encoder.hpp"
+
+namespace mango
+{
+
+    // Lossless JPEG transformations. The quantized DCT coefficients are rearranged and
+    // entropy coded again without decoding the image so the quality is not affected.
+    struct JPEGTransform
+    {
+        enum Operation
+        {
+            NONE,
+            FLIP_HORIZONTAL,
+            FLIP_VERTICAL,
+            TRANSPOSE,      // mirror across the top-left to bottom-right diagonal
+            TRANSVERSE,     // mirror across the top-right to bottom-left diagonal
+            ROTATE_90,      // clockwise
+            ROTATE_180,
+            ROTATE_270,
+        };
+
+        Operation operation = NONE;
+
+        // correct the Exif orientation before the operation; the orientation of
+        // the output is reset to top-left
+        bool orient = false;
+
+        // crop rectangle in the transformed image; the left and top edges are moved
+        // to the MCU grid, which grows the rectangle. Zero size keeps the whole image.
+        int x = 0;
+        int y = 0;
+        int width = 0;
+        int height = 0;
+
+        // progressive scans instead of a sequential scan; the huffman tables are
+        // always optimized for the image
+        bool progressive = false;
+    };
+
+    // A partial MCU can not be moved to the other side of the image so the mirrored edges
+    // are trimmed to the MCU grid. Returns false when the image can not be transformed
+    // (lossless coding, 16 bit quantization tables or more than three components).
+    bool transformJPEG(Stream& output, Memory input, const JPEGTransform& transform);
+
+    // One output of transcodeJPEG(): the image is resized and encoded into the stream.
+    struct JPEGTranscode
+    {
+        Stream* output = nullptr;
+
+        // encoder of the output, for example ".jpg" or ".png"
+        std::string extension = ".jpg";
+
+        // output size; a zero dimension is computed from the other one with the aspect
+        // ratio of the image and when both are zero the image is not resized
+        int width = 0;
+        int height = 0;
+
+        ImageEncodeOptions options;
+    };
+
+    // Decodes the image once for all outputs. The decoder reduces the image with the scaled
+    // IDCT to the smallest size which is still at least as large as the outputs and produces
+    // it in bands, which are resized for each output as they arrive. The baseline JPEG outputs
+    // are encoded from the resized bands so only a few rows of MCUs of each image are in memory;
+    // the other outputs (optimized or progressive JPEG, other encoders) are encoded when their
+    // image is complete. Returns false when the image can not be decoded, the image is truncated
+    // or its entropy coded data is corrupted, or an output does not have a stream or an encoder;
+    // the outputs which were encoded a band at a time are then incomplete.
+    bool transcodeJPEG(Memory input, const std::vector<JPEGTranscode>& outputs);
+
+} // namespace mango
@@ -15,6 +15,58 @@
 namespace mango
 {
 
+    struct ImageEncodeOptions;
+
+    enum class ResizeFilter
+    {
+        BOX,
+        BILINEAR,
+        BICUBIC,
+        MITCHELL,
+        LANCZOS3
+    };
+
+    // Porter-Duff operators
+    enum class CompositeMode
+    {
+        CLEAR,
+        SOURCE,
+        DEST,
+        SOURCE_OVER,
+        DEST_OVER,
+        SOURCE_IN,
+        DEST_IN,
+        SOURCE_OUT,
+        DEST_OUT,
+        SOURCE_ATOP,
+        DEST_ATOP,
+        XOR,
+        PLUS
+    };
+
+    enum class Dither
+    {
+        NONE,
+        BAYER,          // ordered, 8x8 Bayer matrix
+        BLUE_NOISE,     // ordered, 32x32 blue noise
+        FLOYD_STEINBERG // error diffusion
+    };
+
+    struct CompositeOptions
+    {
+        CompositeMode mode = CompositeMode::SOURCE_OVER;
+
+        // constant alpha which scales the source; blends an opaque source with the destination
+        float opacity = 1.0f;
+
+        // the surfaces store premultiplied alpha; otherwise the colors are premultiplied
+        // for the operator and divided back afterwards
+        bool premultiplied = false;
+
+        // the colors are composited in linear light; the alpha is stored as it is
+        bool linear = false;
+    };
+
     class Surface
     {
     protected:
@@ -45,10 +97,28 @@ namespace mango
         }
 
         void save(const std::string& filename, float quality = 1.0f);
+        void save(const std::string& filename, const ImageEncodeOptions& options);
         void clear(float red, float green, float blue, float alpha);
         void blit(int x, int y, const Surface& source);
+
+        // Blits with dithering when the components of this surface have fewer bits than
+        // the source, or when the color is converted into luminance (BT.601 weights);
+        // other conversions are the same as the blit without dithering.
+        void blit(int x, int y, const Surface& source, Dither dither);
         void xflip();
         void yflip();
+
+        // Resamples the source to the size of this surface. The linear option filters the
+        // color components in linear light; the alpha is filtered as it is stored.
+        void resize(const Surface& source, ResizeFilter filter = ResizeFilter::LANCZOS3, bool linear = false);
+
+        // Multiplies the color components with the alpha, or divides them back. The linear
+        // option multiplies the colors in linear light.
+        void premultiply(bool linear = false);
+        void unpremultiply(bool linear = false);
+
+        // Composites the source into this surface at (x, y) with a Porter-Duff operator.
+        void composite(int x, int y, const Surface& source, const CompositeOptions& options = CompositeOptions());
     };
 
     class Bitmap : private NonCopyable, public Surface
@@ -0,0 +1,84 @@
+/*
+    MANGO Multimedia Development Platform
+    Copyright (C) 2012-2019 Twilight Finland 3D Oy Ltd. All rights reserved.
+*/
+#pragma once
+
+#include <string>
+#include <vector>
+#include "../core/configure.hpp"
+#include "../core/object.hpp"
+#include "../core/memory.hpp"
+#include "../core/stream.hpp"
+#include "format.hpp"
+#include "compression.hpp"
+#include "surface.hpp"
+#include "encoder.hpp"
+
+namespace mango
+{
+
+    // Images of a texture; block compressed or stored in the format when there is no
+    // compression. The images are referenced by level and face (face * levels + level);
+    // they point to the data of the texture when it is built from a surface or they can
+    // point to the caller's memory, for example blocks which are already compressed.
+    struct Texture : private NonCopyable
+    {
+        int width = 0;
+        int height = 0;
+        int levels = 0;
+        int faces = 0;
+        Format format;
+        TextureCompression compression = TextureCompression::NONE;
+        std::vector<Memory> images;
+        std::vector<u8> data;
+
+        int getWidth(int level) const;
+        int getHeight(int level) const;
+        size_t getLevelSize(int level) const;
+        Memory getMemory(int level, int face = 0) const;
+    };
+
+    struct TextureOptions
+    {
+        // block compression of the levels; NONE stores them as R8G8B8A8, or RGBA32F
+        // for floating point block formats and surfaces
+        TextureCompression compression = TextureCompression::NONE;
+
+        // encoder tier of the block compression
+        TextureQuality quality = TextureQuality::HIGH;
+
+        // number of levels; zero generates the full chain down to 1x1
+        int levels = 0;
+
+        // filter which reduces each level to the next one
+        ResizeFilter filter = ResizeFilter::BOX;
+
+        // the color is filtered in linear light; clear for normal maps and other
+        // data which is not sRGB encoded
+        bool linear = true;
+
+        // the levels keep the fraction of pixels with alpha above the reference
+        // of the first level so alpha tested geometry does not fade with distance;
+        // zero disables the correction
+        float alphaReference = 0.0f;
+    };
+
+    // Generates the mipmap chain and compresses it. Each level is reduced from the previous
+    // one while the compression of the earlier levels runs in the thread pool, split into
+    // rows of blocks.
+    void buildTexture(Texture& texture, const Surface& source, const TextureOptions& options);
+
+    // Transcodes the levels and faces of an ETC1S texture into the compression the GPU
+    // supports; the images of the input can point to the memory of an image decoder.
+    void transcodeTexture(Texture& output, const Texture& input, TextureCompression compression);
+
+    // Writes the texture into a ".dds", ".ktx", ".ktx2" or ".pvr" container; the options select the
+    // KTX2 supercompression. ETC1S textures are stored only in ".ktx2": the color blocks as ETC2 RGB
+    // and the alpha blocks as a second array layer, marked with the "mangoETC1S" key so that they
+    // are decoded as ETC1S and can be transcoded at load time. Returns false when the extension
+    // is not supported.
+    bool writeTexture(Stream& output, const Texture& texture, const std::string& extension,
+                      const ImageEncodeOptions& options = ImageEncodeOptions());
+
+} // namespace mango
@@ -0,0 +1,325 @@
+/*
+    MANGO Multimedia Development Platform
+    Copyright (C) 2012-2019 Twilight Finland 3D Oy Ltd. All rights reserved.
+*/
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "bench.hpp"
+
+namespace
+{
+    using namespace mango;
+
+    std::string escape(const std::string& text)
+    {
+        std::string s;
+
+        for (char c : text)
+        {
+            switch (c)
+            {
+                case '"': s += "\\\""; break;
+                case '\\': s += "\\\\"; break;
+                case '\n': s += "\\n"; break;
+                case '\t': s += "\\t"; break;
+                default:
+                    if (u8(c) < 0x20)
+                    {
+                        char temp[8];
+                        std::snprintf(temp, sizeof(temp), "\\u%04x", c);
+                        s += temp;
+                    }
+                    else
+                    {
+                        s += c;
+                    }
+                    break;
+            }
+        }
+
+        return s;
+    }
+
+    u32 lcg(u32& state)
+    {
+        state = state * 1664525 + 1013904223;
+        return state;
+    }
+
+    void usage()
+    {
+        std::printf("usage: mango-bench [options] [filter ...]\n");
+        std::printf("\n");
+        std::printf("  filter        run only benchmarks whose \"group/name\" contains the text\n");
+        std::printf("  -o <file>     write the JSON report into file (default: stdout)\n");
+        std::printf("  -t <seconds>  minimum measurement time per benchmark (default: 0.25)\n");
+        std::printf("  -v            print progress into stderr\n");
+    }
+
+} // namespace
+
+namespace bench
+{
+
+    // ----------------------------------------------------------------------------
+    // Bench
+    // ----------------------------------------------------------------------------
+
+    Bench::Bench(const std::vector<std::string>& filters, double min_time, bool verbose)
+        : m_filters(filters)
+        , m_min_time(min_time)
+        , m_min_iterations(3)
+        , m_verbose(verbose)
+    {
+    }
+
+    bool Bench::enabled(const std::string& group, const std::string& name) const
+    {
+        if (m_filters.empty())
+            return true;
+
+        const std::string id = group + "/" + name;
+
+        for (const std::string& filter : m_filters)
+        {
+            if (id.find(filter) != std::string::npos)
+                return true;
+        }
+
+        return false;
+    }
+
+    Result* Bench::run(const std::string& group, const std::string& name, u64 bytes, u64 items,
+                       const std::function<void()>& func)
+    {
+        if (!enabled(group, name))
+            return nullptr;
+
+        if (m_verbose)
+        {
+            std::fprintf(stderr, "%s/%s ", group.c_str(), name.c_str());
+            std::fflush(stderr);
+        }
+
+        // warm-up: caches, thread pool and per-thread contexts
+        func();
+
+        std::vector<double> samples;
+        Timer timer;
+
+        while (timer.time() < m_min_time || int(samples.size()) < m_min_iterations)
+        {
+            Timer sample;
+            func();
+            samples.push_back(double(sample.ns()));
+        }
+
+        std::sort(samples.begin(), samples.end());
+
+        Result result;
+        result.group = group;
+        result.name = name;
+        result.bytes = bytes;
+        result.items = items;
+        result.iterations = samples.size();
+        result.best = samples.front();
+        result.median = samples[samples.size() / 2];
+
+        if (m_verbose)
+        {
+            if (bytes)
+                std::fprintf(stderr, "%.1f MB/s\n", bytes * 1000.0 / result.median);
+            else
+                std::fprintf(stderr, "%.1f ns\n", result.median);
+        }
+
+        m_results.push_back(result);
+        return &m_results.back();
+    }
+
+    void Bench::write(std::FILE* file) const
+    {
+        std::fprintf(file, "{\n");
+        std::fprintf(file, "  \"version\": 1,\n");
+        std::fprintf(file, "  \"system\": \"%s\",\n", escape(getSystemInfo()).c_str());
+        std::fprintf(file, "  \"cpu_flags\": \"0x%016llx\",\n", static_cast<unsigned long long>(getCPUFlags()));
+        std::fprintf(file, "  \"threads\": %d,\n", ThreadPool::getInstanceSize());
+        std::fprintf(file, "  \"results\": [");
+
+        for (size_t i = 0; i < m_results.size(); ++i)
+        {
+            const Result& r = m_results[i];
+
+            std::fprintf(file, "%s\n    {", i ? "," : "");
+            std::fprintf(file, " \"group\": \"%s\",", escape(r.group).c_str());
+            std::fprintf(file, " \"name\": \"%s\",", escape(r.name).c_str());
+            std::fprintf(file, " \"iterations\": %llu,", static_cast<unsigned long long>(r.iterations));
+            std::fprintf(file, " \"best_ns\": %.0f,", r.best);
+            std::fprintf(file, " \"median_ns\": %.0f", r.median);
+
+            if (r.bytes)
+            {
+                std::fprintf(file, ", \"bytes\": %llu", static_cast<unsigned long long>(r.bytes));
+                std::fprintf(file, ", \"mb_per_s\": %.2f", r.bytes * 1000.0 / r.median);
+            }
+
+            if (r.items)
+            {
+                std::fprintf(file, ", \"items\": %llu", static_cast<unsigned long long>(r.items));
+                std::fprintf(file, ", \"ns_per_item\": %.2f", r.median / r.items);
+            }
+
+            for (const auto& metric : r.metrics)
+            {
+                std::fprintf(file, ", \"%s\": %.4f", escape(metric.first).c_str(), metric.second);
+            }
+
+            std::fprintf(file, " }");
+        }
+
+        std::fprintf(file, "\n  ]\n}\n");
+    }
+
+    // ----------------------------------------------------------------------------
+    // synthetic input
+    // ----------------------------------------------------------------------------
+
+    void generateImage(Surface& surface, u32 seed)
+    {
+        // smooth gradients, a few hard edges and low amplitude noise;
+        // compresses like a photograph rather than like flat color or white noise
+        Bitmap temp(surface.width, surface.height, FORMAT_R8G8B8A8);
+
+        u32 state = seed;
+
+        for (int y = 0; y < temp.height; ++y)
+        {
+            u8* p = temp.address<u8>(0, y);
+
+            for (int x = 0; x < temp.width; ++x)
+            {
+                u32 noise = lcg(state) >> 24;
+                int edge = ((x / 64) ^ (y / 64)) & 1 ? 32 : 0;
+                p[0] = u8(((x * 255) / temp.width + edge + (noise & 7)) & 0xff);
+                p[1] = u8(((y * 255) / temp.height + (noise >> 5)) & 0xff);
+                p[2] = u8((((x + y) * 127) / (temp.width + temp.height) + edge) & 0xff);
+                p[3] = u8(255 - ((x ^ y) & 0x3f));
+                p += 4;
+            }
+        }
+
+        surface.blit(0, 0, temp);
+    }
+
+    void generateData(std::vector<u8>& data, size_t size, u32 seed)
+    {
+        // text-like input: words from a small vocabulary with random separators
+        static const char* words[] =
+        {
+            "mango", "image", "stream", "buffer", "texture", "thread", "queue", "surface",
+            "format", "the", "of", "and", "decode", "encode", "block", "pixel",
+            "compress", "memory", "vector", "matrix", "float", "integer", "simd", "cache",
+        };
+        const u32 count = u32(sizeof(words) / sizeof(words[0]));
+
+        data.clear();
+        data.reserve(size);
+
+        u32 state = seed;
+
+        while (data.size() < size)
+        {
+            u32 r = lcg(state);
+            const char* word = words[(r >> 8) % count];
+            data.insert(data.end(), word, word + std::strlen(word));
+
+            switch ((r >> 24) & 15)
+            {
+                case 0: data.push_back('\n'); break;
+                case 1: data.push_back(','); data.push_back(' '); break;
+                case 2: data.push_back(u8('0' + (r & 7))); break;
+                default: data.push_back(' '); break;
+            }
+        }
+
+        data.resize(size);
+    }
+
+    void generateRandom(std::vector<u8>& data, size_t size, u32 seed)
+    {
+        data.resize(size);
+
+        u32 state = seed;
+
+        for (size_t i = 0; i < size; ++i)
+        {
+            data[i] = u8(lcg(state) >> 24);
+        }
+    }
+
+} // namespace bench
+
+// ----------------------------------------------------------------------------
+// main()
+// ----------------------------------------------------------------------------
+
+int main(int argc, const char* argv[])
+{
+    std::vector<std::string> filters;
+    const char* output = nullptr;
+    double min_time = 0.25;
+    bool verbose = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+
+        if (arg == "-o" && i + 1 < argc)
+        {
+            output = argv[++i];
+        }
+        else if (arg == "-t" && i + 1 < argc)
+        {
+            min_time = std::atof(argv[++i]);
+        }
+        else if (arg == "-v")
+        {
+            verbose = true;
+        }
+        else if (arg == "-h" || arg == "--help")
+        {
+            usage();
+            return 0;
+        }
+        else
+        {
+            filters.push_back(arg);
+        }
+    }
+
+    bench::Bench bench(filters, min_time, verbose);
+
+    bench::benchImage(bench);
+    bench::benchTexture(bench);
+    bench::benchCompress(bench);
+    bench::benchHash(bench);
+    bench::benchThread(bench);
+
+    std::FILE* file = output ? std::fopen(output, "w") : stdout;
+    if (!file)
+    {
+        std::fprintf(stderr, "Cannot open \"%s\" for writing.\n", output);
+        return 1;
+    }
+
+    bench.write(file);
+
+    if (output)
+    {
+        std::fclose(file);
+    }
+
+    return 0;
+}
@@ -0,0 +1,79 @@
+/*
+    MANGO Multimedia Development Platform
+    Copyright (C) 2012-2019 Twilight Finland 3D Oy Ltd. All rights reserved.
+*/
+#pragma once
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <mango/mango.hpp>
+
+namespace bench
+{
+
+    using namespace mango;
+
+    // ----------------------------------------------------------------------------
+    // Result
+    // ----------------------------------------------------------------------------
+
+    struct Result
+    {
+        std::string group;
+        std::string name;
+        u64 bytes;          // bytes processed per iteration (0 when not applicable)
+        u64 items;          // items processed per iteration (0 when not applicable)
+        u64 iterations;
+        double best;        // nanoseconds per iteration
+        double median;      // nanoseconds per iteration
+        std::vector<std::pair<std::string, double>> metrics;
+    };
+
+    // ----------------------------------------------------------------------------
+    // Bench
+    // ----------------------------------------------------------------------------
+
+    class Bench
+    {
+    protected:
+        std::vector<std::string> m_filters;
+        double m_min_time;
+        int m_min_iterations;
+        bool m_verbose;
+        std::vector<Result> m_results;
+
+    public:
+        Bench(const std::vector<std::string>& filters, double min_time, bool verbose);
+
+        bool enabled(const std::string& group, const std::string& name) const;
+
+        // measure func() repeatedly; the returned result can be decorated with
+        // extra metrics (compression ratio, etc.) before the next measurement
+        Result* run(const std::string& group, const std::string& name, u64 bytes, u64 items,
+                    const std::function<void()>& func);
+
+        void write(std::FILE* file) const;
+    };
+
+    // ----------------------------------------------------------------------------
+    // synthetic input
+    // ----------------------------------------------------------------------------
+
+    // deterministic; the same seed gives the same data on every platform
+
+    void generateImage(Surface& surface, u32 seed);
+    void generateData(std::vector<u8>& data, size_t size, u32 seed);
+    void generateRandom(std::vector<u8>& data, size_t size, u32 seed);
+
+    // ----------------------------------------------------------------------------
+    // suites
+    // ----------------------------------------------------------------------------
+
+    void benchImage(Bench& bench);
+    void benchTexture(Bench& bench);
+    void benchCompress(Bench& bench);
+    void benchHash(Bench& bench);
+    void benchThread(Bench& bench);
+
+} // namespace bench
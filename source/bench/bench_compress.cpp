@@ -0,0 +1,67 @@
+/*
+    MANGO Multimedia Development Platform
+    Copyright (C) 2012-2019 Twilight Finland 3D Oy Ltd. All rights reserved.
+*/
+#include <cstdio>
+#include "bench.hpp"
+
+namespace bench
+{
+
+    void benchCompress(Bench& bench)
+    {
+        const size_t size = 1024 * 1024;
+
+        std::vector<u8> source;
+        generateData(source, size, 0x2468);
+
+        const int levels[] = { 1, 6, 10 };
+
+        for (const Compressor& compressor : getCompressors())
+        {
+            if (compressor.method == Compressor::NONE)
+                continue;
+
+            std::vector<u8> compressed(compressor.bound(size));
+            std::vector<u8> decompressed(size);
+
+            for (int level : levels)
+            {
+                const std::string name = compressor.name + "." + std::to_string(level);
+
+                size_t bytes = 0;
+
+                Result* result = bench.run("compress", name + ".compress", size, 0, [&] {
+                    bytes = compressor.compress(Memory(compressed.data(), compressed.size()),
+                                                Memory(source.data(), size), level);
+                });
+
+                if (!result && !bench.enabled("compress", name + ".decompress"))
+                    continue;
+
+                if (!result)
+                {
+                    bytes = compressor.compress(Memory(compressed.data(), compressed.size()),
+                                                Memory(source.data(), size), level);
+                }
+
+                if (result)
+                {
+                    result->metrics.emplace_back("compressed_bytes", double(bytes));
+                    result->metrics.emplace_back("ratio", double(size) / double(bytes ? bytes : 1));
+                }
+
+                bench.run("compress", name + ".decompress", size, 0, [&] {
+                    compressor.decompress(Memory(decompressed.data(), size),
+                                          Memory(compressed.data(), bytes));
+                });
+
+                if (decompressed != source)
+                {
+                    std::fprintf(stderr, "%s: round-trip mismatch.\n", name.c_str());
+                }
+            }
+        }
+    }
+
+} // namespace bench
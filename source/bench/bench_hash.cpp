@@ -0,0 +1,93 @@
+/*
+    MANGO Multimedia Development Platform
+    Copyright (C) 2012-2019 Twilight Finland 3D Oy Ltd. All rights reserved.
+*/
+#include "bench.hpp"
+
+namespace bench
+{
+
+    void benchHash(Bench& bench)
+    {
+        const size_t size = 1024 * 1024;
+
+        std::vector<u8> source;
+        generateRandom(source, size, 0x1357);
+
+        const Memory memory(source.data(), size);
+
+        // the results are accumulated so that the calls cannot be optimized away
+        volatile u64 sink = 0;
+
+        bench.run("hash", "md5", size, 0, [&] {
+            u32 hash[4];
+            md5(hash, memory);
+            sink = sink + hash[0];
+        });
+
+        bench.run("hash", "sha1", size, 0, [&] {
+            u32 hash[5];
+            sha1(hash, memory);
+            sink = sink + hash[0];
+        });
+
+        bench.run("hash", "sha2", size, 0, [&] {
+            u32 hash[8];
+            sha2(hash, memory);
+            sink = sink + hash[0];
+        });
+
+        bench.run("hash", "xxhash32", size, 0, [&] {
+            sink = sink + xxhash32(memory);
+        });
+
+        bench.run("hash", "xxhash64", size, 0, [&] {
+            sink = sink + xxhash64(memory);
+        });
+
+        bench.run("hash", "crc32", size, 0, [&] {
+            sink = sink + crc32(0, memory);
+        });
+
+        bench.run("hash", "crc32c", size, 0, [&] {
+            sink = sink + crc32c(0, memory);
+        });
+
+        // ----------------------------------------------------------------------------
+        // aes
+        // ----------------------------------------------------------------------------
+
+        std::vector<u8> output(size);
+
+        u8 key[32];
+        u8 iv[16];
+
+        for (int i = 0; i < 32; ++i)
+            key[i] = u8(i * 7 + 3);
+
+        for (int i = 0; i < 16; ++i)
+            iv[i] = u8(i * 13 + 1);
+
+        const int bits[] = { 128, 256 };
+
+        for (int keybits : bits)
+        {
+            AES aes(key, keybits);
+
+            const std::string prefix = "aes" + std::to_string(keybits);
+
+            bench.run("crypto", prefix + ".ecb", size, 0, [&] {
+                aes.ecb_block_encrypt(output.data(), source.data(), size);
+            });
+
+            bench.run("crypto", prefix + ".cbc", size, 0, [&] {
+                aes.cbc_block_encrypt(output.data(), source.data(), size, iv);
+            });
+
+            bench.run("crypto", prefix + ".ctr", size, 0, [&] {
+                aes.ctr_block_encrypt(output.data(), source.data(), size, iv);
+            });
+        }
+    }
+
+} // namespace bench
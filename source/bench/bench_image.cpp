@@ -0,0 +1,849 @@
+/*
+    MANGO Multimedia Development Platform
+    Copyright (C) 2012-2019 Twilight Finland 3D Oy Ltd. All rights reserved.
+*/
+#include "bench.hpp"
+
+namespace bench
+{
+
+    // Resize of a constant color must return the same color in every format; the float
+    // resize path converts the rows to RGBA32F and back with the blitter.
+    void verifyResize()
+    {
+        struct
+        {
+            const char* name;
+            Format format;
+        }
+        const formats[] =
+        {
+            { "b8g8r8",        FORMAT_B8G8R8 },
+            { "r8g8b8",        FORMAT_R8G8B8 },
+            { "b8g8r8a8",      FORMAT_B8G8R8A8 },
+            { "b8g8r8x8",      FORMAT_B8G8R8X8 },
+            { "r8g8b8a8",      FORMAT_R8G8B8A8 },
+            { "r8g8b8x8",      FORMAT_R8G8B8X8 },
+            { "b5g6r5",        FORMAT_B5G6R5 },
+            { "b5g5r5x1",      FORMAT_B5G5R5X1 },
+            { "b5g5r5a1",      FORMAT_B5G5R5A1 },
+            { "b4g4r4a4",      FORMAT_B4G4R4A4 },
+            { "b4g4r4x4",      FORMAT_B4G4R4X4 },
+            { "b2g3r3",        FORMAT_B2G3R3 },
+            { "b2g3r3a8",      FORMAT_B2G3R3A8 },
+            { "r10g10b10a2",   FORMAT_R10G10B10A2 },
+            { "b10g10r10a2",   FORMAT_B10G10R10A2 },
+            { "r16g16",        FORMAT_R16G16 },
+            { "a8",            FORMAT_A8 },
+            { "r16",           FORMAT_R16 },
+            { "rgb16",         FORMAT_RGB16 },
+            { "rgba16",        FORMAT_RGBA16 },
+            { "argb8888",      FORMAT_BGRA_UNSIGNED_INT_8_8_8_8 },
+            { "l8",            FORMAT_L8 },
+            { "l8a8",          FORMAT_L8A8 },
+            { "l4a4",          FORMAT_L4A4 },
+            { "l16",           FORMAT_L16 },
+            { "l16a16",        FORMAT_L16A16 },
+            { "l16f",          FORMAT_L16F },
+            { "l32f",          FORMAT_L32F },
+            { "rgba16f",       FORMAT_RGBA16F },
+            { "rgba32f",       FORMAT_RGBA32F },
+        };
+
+        const int width = 16;
+        const int height = 16;
+        const int sizes[][2] = { { 7, 5 }, { 37, 23 } };
+
+        Bitmap color(width, height, FORMAT_R8G8B8A8);
+        for (int y = 0; y < height; ++y)
+        {
+            u32* scan = color.address<u32>(0, y);
+            for (int x = 0; x < width; ++x)
+                scan[x] = 0xa0c04080;
+        }
+
+        for (const auto& format : formats)
+        {
+            Bitmap source(width, height, format.format);
+            source.blit(0, 0, color);
+
+            // the constant color as it is stored in the format
+            Bitmap reference(1, 1, FORMAT_R8G8B8A8);
+            reference.blit(0, 0, source);
+            const u32 expected = *reference.address<u32>(0, 0);
+
+            for (int linear = 0; linear < 2; ++linear)
+            {
+                for (const auto& size : sizes)
+                {
+                    Bitmap dest(size[0], size[1], format.format);
+                    dest.resize(source, ResizeFilter::LANCZOS3, linear != 0);
+
+                    Bitmap result(size[0], size[1], FORMAT_R8G8B8A8);
+                    result.blit(0, 0, dest);
+
+                    int errors = 0;
+                    u32 sample = expected;
+
+                    for (int y = 0; y < size[1]; ++y)
+                    {
+                        const u8* scan = result.address<u8>(0, y);
+                        for (int x = 0; x < size[0]; ++x)
+                        {
+                            for (int i = 0; i < 4; ++i)
+                            {
+                                const int delta = scan[x * 4 + i] - int((expected >> (i * 8)) & 0xff);
+                                if (std::abs(delta) > 1)
+                                {
+                                    sample = result.address<u32>(0, y)[x];
+                                    ++errors;
+                                    break;
+                                }
+                            }
+                        }
+                    }
+
+                    if (errors)
+                    {
+                        std::fprintf(stderr, "resize: %s %dx%d%s: %d pixels differ (%08x instead of %08x).\n",
+                            format.name, size[0], size[1], linear ? " linear" : "", errors, sample, expected);
+                    }
+                }
+            }
+        }
+
+        // transparent black next to opaque red is half transparent red; the colors are
+        // filtered with premultiplied alpha
+        const Format alphas[] = { FORMAT_R8G8B8A8, FORMAT_B4G4R4A4, FORMAT_RGBA16, FORMAT_RGBA32F };
+
+        for (const Format& format : alphas)
+        {
+            Bitmap pairs(8, 2, FORMAT_R8G8B8A8);
+            for (int y = 0; y < 2; ++y)
+            {
+                u32* scan = pairs.address<u32>(0, y);
+                for (int x = 0; x < 8; ++x)
+                    scan[x] = x & 1 ? 0xff0000ff : 0;
+            }
+
+            Bitmap source(8, 2, format);
+            source.blit(0, 0, pairs);
+
+            Bitmap dest(4, 1, format);
+            dest.resize(source, ResizeFilter::BOX);
+
+            Bitmap result(4, 1, FORMAT_R8G8B8A8);
+            result.blit(0, 0, dest);
+
+            const u32 color = *result.address<u32>(0, 0);
+            if ((color & 0xffffff) != 0x0000ff)
+            {
+                std::fprintf(stderr, "resize: transparent pixels darken the color (%08x).\n", color);
+            }
+        }
+    }
+
+    // Half transparent red over opaque blue; the 3 channel, 565 and 48 bit destinations
+    // are written through the float rows like the others.
+    void verifyComposite()
+    {
+        struct
+        {
+            const char* name;
+            Format format;
+        }
+        const formats[] =
+        {
+            { "r8g8b8",   FORMAT_R8G8B8 },
+            { "b8g8r8",   FORMAT_B8G8R8 },
+            { "b5g6r5",   FORMAT_B5G6R5 },
+            { "rgb16",    FORMAT_RGB16 },
+            { "r8g8b8a8", FORMAT_R8G8B8A8 },
+            { "b4g4r4a4", FORMAT_B4G4R4A4 },
+            { "rgba16",   FORMAT_RGBA16 },
+            { "rgba16f",  FORMAT_RGBA16F },
+        };
+
+        const int width = 16;
+        const int height = 4;
+
+        Bitmap red(width, height, FORMAT_R8G8B8A8);
+        Bitmap blue(width, height, FORMAT_R8G8B8A8);
+
+        for (int y = 0; y < height; ++y)
+        {
+            u32* r = red.address<u32>(0, y);
+            u32* b = blue.address<u32>(0, y);
+            for (int x = 0; x < width; ++x)
+            {
+                r[x] = 0x800000ff;
+                b[x] = 0xffff0000;
+            }
+        }
+
+        for (const auto& format : formats)
+        {
+            Bitmap dest(width, height, format.format);
+            dest.blit(0, 0, blue);
+            dest.composite(0, 0, red);
+
+            // red * 0.502 + blue * 0.498 as it is stored in the format
+            Bitmap expected(1, 1, FORMAT_R8G8B8A8);
+            *expected.address<u32>(0, 0) = 0xff7f0080;
+            Bitmap stored(1, 1, format.format);
+            stored.blit(0, 0, expected);
+            expected.blit(0, 0, stored);
+            const u32 color = *expected.address<u32>(0, 0);
+
+            Bitmap result(width, height, FORMAT_R8G8B8A8);
+            result.blit(0, 0, dest);
+
+            int errors = 0;
+            u32 sample = color;
+
+            for (int y = 0; y < height; ++y)
+            {
+                const u8* scan = result.address<u8>(0, y);
+                for (int x = 0; x < width; ++x)
+                {
+                    for (int i = 0; i < 4; ++i)
+                    {
+                        const int delta = scan[x * 4 + i] - int((color >> (i * 8)) & 0xff);
+                        if (std::abs(delta) > 1)
+                        {
+                            sample = result.address<u32>(0, y)[x];
+                            ++errors;
+                            break;
+                        }
+                    }
+                }
+            }
+
+            if (errors)
+            {
+                std::fprintf(stderr, "composite: %s: %d pixels differ (%08x instead of %08x).\n",
+                    format.name, errors, sample, color);
+            }
+        }
+    }
+
+    // The 4:2:0 decoding is compared against a reference decoder built from the planar
+    // output: libjpeg's h2v2 triangle filter over the whole chroma plane and the JFIF color
+    // conversion. The chroma is interpolated across the MCU edges so there are no seams.
+    void verifyFancyUpsampling()
+    {
+        if (!isImageEncoder(".jpg"))
+        {
+            return;
+        }
+
+        const int width = 99;
+        const int height = 45;
+        const int chroma_width = (width + 1) / 2;
+        const int chroma_height = (height + 1) / 2;
+
+        Bitmap source(width, height, FORMAT_R8G8B8A8);
+        for (int y = 0; y < height; ++y)
+        {
+            u8* scan = source.address<u8>(0, y);
+            for (int x = 0; x < width; ++x)
+            {
+                scan[x * 4 + 0] = u8(128 + 120 * std::sin(x * 0.21f + y * 0.05f));
+                scan[x * 4 + 1] = u8(128 + 100 * std::cos(y * 0.17f));
+                scan[x * 4 + 2] = u8(128 + 120 * std::sin((x + y) * 0.13f));
+                scan[x * 4 + 3] = 0xff;
+            }
+        }
+
+        for (int mode = 0; mode < 2; ++mode)
+        {
+            ImageEncodeOptions options;
+            options.quality = 0.95f;
+            options.subsampling = ImageEncodeOptions::SUBSAMPLING_420;
+            options.progressive = mode == 1;
+
+            Buffer encoded;
+            ImageEncoder encoder(".jpg");
+            encoder.encode(encoded, source, options);
+
+            std::vector<u8> planes(width * height + chroma_width * chroma_height * 2);
+
+            YUVPlanes yuv;
+            yuv.y = planes.data();
+            yuv.ystride = width;
+            yuv.u = yuv.y + width * height;
+            yuv.ustride = chroma_width;
+            yuv.v = yuv.u + chroma_width * chroma_height;
+            yuv.vstride = chroma_width;
+
+            Bitmap result(width, height, FORMAT_R8G8B8A8);
+            {
+                ImageDecoder decoder(encoded, ".jpg");
+                decoder.decodeYUV(yuv);
+            }
+            {
+                ImageDecoder decoder(encoded, ".jpg");
+                decoder.decode(result);
+            }
+
+            auto sample = [&] (const u8* plane, int x, int y)
+            {
+                x = clamp(x, 0, chroma_width - 1);
+                y = clamp(y, 0, chroma_height - 1);
+                return int(plane[y * chroma_width + x]);
+            };
+
+            auto upsample = [&] (const u8* plane, int x, int y)
+            {
+                const int cx = x >> 1;
+                const int cy = y >> 1;
+                const int dx = x & 1 ? 1 : -1;
+                const int dy = y & 1 ? 1 : -1;
+                const int nearer = sample(plane, cx, cy) * 3 + sample(plane, cx, cy + dy);
+                const int further = sample(plane, cx + dx, cy) * 3 + sample(plane, cx + dx, cy + dy);
+                return (nearer * 3 + further + (x & 1 ? 7 : 8)) >> 4;
+            };
+
+            int errors = 0;
+            int x0 = 0;
+            int y0 = 0;
+
+            for (int y = 0; y < height; ++y)
+            {
+                const u8* scan = result.address<u8>(0, y);
+                for (int x = 0; x < width; ++x)
+                {
+                    const float luma = yuv.y[y * width + x];
+                    const float cb = upsample(yuv.u, x, y) - 128.0f;
+                    const float cr = upsample(yuv.v, x, y) - 128.0f;
+
+                    const int expected[] =
+                    {
+                        clamp(int(luma + 1.402f * cr + 0.5f), 0, 255),
+                        clamp(int(luma - 0.344136f * cb - 0.714136f * cr + 0.5f), 0, 255),
+                        clamp(int(luma + 1.772f * cb + 0.5f), 0, 255),
+                    };
+
+                    for (int i = 0; i < 3; ++i)
+                    {
+                        if (std::abs(scan[x * 4 + i] - expected[i]) > 2)
+                        {
+                            if (!errors)
+                            {
+                                x0 = x;
+                                y0 = y;
+                            }
+                            ++errors;
+                            break;
+                        }
+                    }
+                }
+            }
+
+            if (errors)
+            {
+                std::fprintf(stderr, "jpeg: %s 4:2:0 upsampling differs from the reference in %d pixels (first at %d, %d).\n",
+                    mode ? "progressive" : "sequential", errors, x0, y0);
+            }
+        }
+    }
+
+    void benchImage(Bench& bench)
+    {
+        verifyResize();
+        verifyComposite();
+        verifyFancyUpsampling();
+
+        const int width = 1024;
+        const int height = 1024;
+
+        Bitmap source(width, height, FORMAT_R8G8B8A8);
+        generateImage(source, 0x1234);
+
+        const u64 pixel_bytes = u64(width) * height * 4;
+
+        // ----------------------------------------------------------------------------
+        // codecs
+        // ----------------------------------------------------------------------------
+
+        struct
+        {
+            const char* extension;
+            Format format;
+            float quality;
+        }
+        const codecs[] =
+        {
+            { ".jpg", FORMAT_R8G8B8A8, 0.90f },
+            { ".png", FORMAT_R8G8B8A8, 0.0f },
+            { ".bmp", FORMAT_B8G8R8A8, 0.0f },
+            { ".tga", FORMAT_B8G8R8A8, 0.0f },
+        };
+
+        for (const auto& codec : codecs)
+        {
+            const std::string name = codec.extension + 1;
+
+            if (!isImageEncoder(codec.extension))
+                continue;
+
+            Bitmap image(width, height, codec.format);
+            image.blit(0, 0, source);
+
+            ImageEncoder encoder(codec.extension);
+
+            Buffer encoded;
+            encoder.encode(encoded, image, codec.quality);
+
+            Result* result = bench.run("image", name + ".encode", pixel_bytes, 0, [&] {
+                Buffer buffer;
+                encoder.encode(buffer, image, codec.quality);
+            });
+
+            if (result)
+            {
+                result->metrics.emplace_back("compressed_bytes", double(encoded.size()));
+            }
+
+            bench.run("image", name + ".decode", pixel_bytes, 0, [&] {
+                Bitmap bitmap(encoded, codec.extension, codec.format);
+            });
+
+            bench.run("image", name + ".header", 0, 0, [&] {
+                ImageDecoder decoder(encoded, codec.extension);
+                decoder.header();
+            });
+
+            bench.run("image", name + ".probe", 0, 0, [&] {
+                probeImage(encoded, codec.extension);
+            });
+        }
+
+        // ----------------------------------------------------------------------------
+        // jpeg encoding modes
+        // ----------------------------------------------------------------------------
+
+        if (isImageEncoder(".jpg"))
+        {
+            ImageEncoder encoder(".jpg");
+
+            for (int mode = 0; mode < 2; ++mode)
+            {
+                ImageEncodeOptions options;
+                options.quality = 0.90f;
+                options.optimize = mode == 0;
+                options.progressive = mode == 1;
+
+                Buffer encoded;
+                encoder.encode(encoded, source, options);
+
+                const char* name = mode == 0 ? "jpg.encode.optimize" : "jpg.encode.progressive";
+
+                Result* result = bench.run("image", name, pixel_bytes, 0, [&] {
+                    Buffer buffer;
+                    encoder.encode(buffer, source, options);
+                });
+
+                if (result)
+                {
+                    result->metrics.emplace_back("compressed_bytes", double(encoded.size()));
+                }
+            }
+
+            // planar output straight from the coefficients
+            Buffer encoded;
+            encoder.encode(encoded, source, 0.90f);
+
+            const int chroma_width = (width + 1) / 2;
+            const int chroma_height = (height + 1) / 2;
+            std::vector<u8> planes(width * height + chroma_width * chroma_height * 2);
+
+            YUVPlanes yuv;
+            yuv.y = planes.data();
+            yuv.ystride = width;
+            yuv.u = yuv.y + width * height;
+            yuv.ustride = chroma_width;
+            yuv.v = yuv.u + chroma_width * chroma_height;
+            yuv.vstride = chroma_width;
+
+            bench.run("image", "jpg.decode.i420", pixel_bytes, 0, [&] {
+                ImageDecoder decoder(encoded, ".jpg");
+                decoder.decodeYUV(yuv);
+            });
+
+            // lossless rotation in the coefficient domain
+            JPEGTransform transform;
+            transform.operation = JPEGTransform::ROTATE_90;
+
+            bench.run("image", "jpg.transform.rotate90", pixel_bytes, 0, [&] {
+                Buffer buffer;
+                transformJPEG(buffer, encoded, transform);
+            });
+
+            // one decode into four smaller images
+            const int sizes[] = { width / 2, width / 3, width / 4, width / 8 };
+
+            bench.run("image", "jpg.transcode.4sizes", pixel_bytes, 0, [&] {
+                Buffer buffers[4];
+                std::vector<JPEGTranscode> outputs(4);
+
+                for (int i = 0; i < 4; ++i)
+                {
+                    outputs[i].output = &buffers[i];
+                    outputs[i].extension = i < 3 ? ".jpg" : ".png";
+                    outputs[i].width = sizes[i];
+                    outputs[i].options.quality = 0.90f;
+                }
+
+                transcodeJPEG(encoded, outputs);
+            });
+        }
+
+        // ----------------------------------------------------------------------------
+        // resize
+        // ----------------------------------------------------------------------------
+
+        struct
+        {
+            const char* name;
+            ResizeFilter filter;
+        }
+        const filters[] =
+        {
+            { "box",      ResizeFilter::BOX },
+            { "bilinear", ResizeFilter::BILINEAR },
+            { "bicubic",  ResizeFilter::BICUBIC },
+            { "mitchell", ResizeFilter::MITCHELL },
+            { "lanczos3", ResizeFilter::LANCZOS3 },
+        };
+
+        for (const auto& filter : filters)
+        {
+            const std::string name = filter.name;
+
+            Bitmap reduced(width * 3 / 8, height * 3 / 8, FORMAT_R8G8B8A8);
+            Bitmap enlarged(width * 3 / 2, height * 3 / 2, FORMAT_R8G8B8A8);
+
+            bench.run("resize", name + ".reduce", pixel_bytes, 0, [&] {
+                reduced.resize(source, filter.filter);
+            });
+
+            bench.run("resize", name + ".enlarge", pixel_bytes, 0, [&] {
+                enlarged.resize(source, filter.filter);
+            });
+        }
+
+        {
+            Bitmap reduced(width * 3 / 8, height * 3 / 8, FORMAT_R8G8B8A8);
+
+            bench.run("resize", "lanczos3.reduce.linear", pixel_bytes, 0, [&] {
+                reduced.resize(source, ResizeFilter::LANCZOS3, true);
+            });
+
+            const Format formats[] = { FORMAT_RGBA16, FORMAT_RGBA32F };
+            const char* names[] = { "lanczos3.reduce.rgba16", "lanczos3.reduce.rgba32f" };
+
+            for (int i = 0; i < 2; ++i)
+            {
+                Bitmap src(width, height, formats[i]);
+                src.blit(0, 0, source);
+
+                Bitmap dest(width * 3 / 8, height * 3 / 8, formats[i]);
+
+                bench.run("resize", names[i], pixel_bytes, 0, [&] {
+                    dest.resize(src, ResizeFilter::LANCZOS3);
+                });
+            }
+        }
+
+        // ----------------------------------------------------------------------------
+        // composite
+        // ----------------------------------------------------------------------------
+
+        {
+            struct
+            {
+                const char* name;
+                Format format;
+                bool premultiplied;
+                bool linear;
+            }
+            const composites[] =
+            {
+                { "rgba8888.over",               FORMAT_R8G8B8A8, false, false },
+                { "rgba8888.over.premultiplied", FORMAT_R8G8B8A8, true,  false },
+                { "rgba8888.over.linear",        FORMAT_R8G8B8A8, false, true },
+                { "rgba16.over",                 FORMAT_RGBA16,   false, false },
+                { "rgba32f.over",                FORMAT_RGBA32F,  false, false },
+            };
+
+            for (const auto& composite : composites)
+            {
+                if (!bench.enabled("composite", composite.name))
+                    continue;
+
+                Bitmap src(width, height, composite.format);
+                src.blit(0, 0, source);
+
+                Bitmap dest(width, height, composite.format);
+
+                CompositeOptions options;
+                options.premultiplied = composite.premultiplied;
+                options.linear = composite.linear;
+
+                bench.run("composite", composite.name, pixel_bytes, 0, [&] {
+                    dest.composite(0, 0, src, options);
+                });
+            }
+
+            if (bench.enabled("composite", "rgba8888.premultiply"))
+            {
+                Bitmap dest(width, height, FORMAT_R8G8B8A8);
+                dest.blit(0, 0, source);
+
+                bench.run("composite", "rgba8888.premultiply", pixel_bytes, 0, [&] {
+                    dest.premultiply();
+                });
+            }
+        }
+
+        // ----------------------------------------------------------------------------
+        // dither
+        // ----------------------------------------------------------------------------
+
+        {
+            struct
+            {
+                const char* name;
+                Format source;
+                Format dest;
+                Dither dither;
+            }
+            const dithers[] =
+            {
+                { "rgba32f.rgba8888.bayer",      FORMAT_RGBA32F,  FORMAT_R8G8B8A8, Dither::BAYER },
+                { "rgba32f.rgba8888.bluenoise",  FORMAT_RGBA32F,  FORMAT_R8G8B8A8, Dither::BLUE_NOISE },
+                { "rgba32f.rgba8888.fs",         FORMAT_RGBA32F,  FORMAT_R8G8B8A8, Dither::FLOYD_STEINBERG },
+                { "rgba8888.rgb565.bayer",       FORMAT_R8G8B8A8, FORMAT_B5G6R5,   Dither::BAYER },
+                { "rgba8888.rgb565.bluenoise",   FORMAT_R8G8B8A8, FORMAT_B5G6R5,   Dither::BLUE_NOISE },
+                { "rgba8888.rgb565.fs",          FORMAT_R8G8B8A8, FORMAT_B5G6R5,   Dither::FLOYD_STEINBERG },
+            };
+
+            for (const auto& dither : dithers)
+            {
+                if (!bench.enabled("dither", dither.name))
+                    continue;
+
+                Bitmap src(width, height, dither.source);
+                src.blit(0, 0, source);
+
+                Bitmap dest(width, height, dither.dest);
+
+                bench.run("dither", dither.name, pixel_bytes, 0, [&] {
+                    dest.blit(0, 0, src, dither.dither);
+                });
+            }
+        }
+
+        // ----------------------------------------------------------------------------
+        // texture
+        // ----------------------------------------------------------------------------
+
+        struct
+        {
+            const char* name;
+            TextureCompression compression;
+            float alphaReference;
+            TextureQuality quality;
+        }
+        const textures[] =
+        {
+            { "mipmap",               TextureCompression::NONE, 0.0f, TextureQuality::HIGH },
+            { "mipmap.coverage",      TextureCompression::NONE, 0.5f, TextureQuality::HIGH },
+            { "mipmap.dxt1",          TextureCompression::DXT1, 0.0f, TextureQuality::HIGH },
+            { "mipmap.dxt5.coverage", TextureCompression::DXT5, 0.5f, TextureQuality::HIGH },
+            { "mipmap.dxt1.fast",     TextureCompression::DXT1, 0.0f, TextureQuality::FAST },
+            { "mipmap.dxt5.fast",     TextureCompression::DXT5, 0.0f, TextureQuality::FAST },
+            { "mipmap.bc4.fast",      TextureCompression::BC4_UNORM, 0.0f, TextureQuality::FAST },
+            { "mipmap.bc5.fast",      TextureCompression::BC5_UNORM, 0.0f, TextureQuality::FAST },
+            { "mipmap.etc2",          TextureCompression::ETC2_RGB, 0.0f, TextureQuality::HIGH },
+            { "mipmap.etc2.fast",     TextureCompression::ETC2_RGB, 0.0f, TextureQuality::FAST },
+            { "mipmap.eac_rg11.fast", TextureCompression::EAC_RG11, 0.0f, TextureQuality::FAST },
+            { "mipmap.astc4x4",       TextureCompression::ASTC_RGBA_4x4, 0.0f, TextureQuality::HIGH },
+            { "mipmap.astc4x4.fast",  TextureCompression::ASTC_RGBA_4x4, 0.0f, TextureQuality::FAST },
+            { "mipmap.etc1s.fast",    TextureCompression::ETC1S_RGBA, 0.0f, TextureQuality::FAST },
+        };
+
+        for (const auto& texture : textures)
+        {
+            TextureCompressionInfo info(texture.compression);
+
+            if (texture.compression != TextureCompression::NONE && !info.encode)
+                continue;
+
+            TextureOptions options;
+            options.compression = texture.compression;
+            options.alphaReference = texture.alphaReference;
+            options.quality = texture.quality;
+
+            Texture output;
+
+            Result* result = bench.run("texture", texture.name, pixel_bytes, 0, [&] {
+                buildTexture(output, source, options);
+            });
+
+            if (result)
+            {
+                result->metrics.emplace_back("compressed_bytes", double(output.data.size()));
+            }
+        }
+
+        // ----------------------------------------------------------------------------
+        // transcode
+        // ----------------------------------------------------------------------------
+
+        struct
+        {
+            const char* name;
+            TextureCompression compression;
+        }
+        const transcodes[] =
+        {
+            { "etc1s_to_bc1",     TextureCompression::DXT1 },
+            { "etc1s_to_bc3",     TextureCompression::DXT5 },
+            { "etc1s_to_etc2",    TextureCompression::ETC2_RGBA },
+            { "etc1s_to_astc4x4", TextureCompression::ASTC_RGBA_4x4 },
+        };
+
+        {
+            TextureOptions options;
+            options.compression = TextureCompression::ETC1S_RGB;
+            options.quality = TextureQuality::FAST;
+
+            Texture universal;
+            buildTexture(universal, source, options);
+
+            for (const auto& transcode : transcodes)
+            {
+                Texture output;
+
+                bench.run("transcode", transcode.name, pixel_bytes, 0, [&] {
+                    transcodeTexture(output, universal, transcode.compression);
+                });
+            }
+        }
+
+        // ----------------------------------------------------------------------------
+        // decode
+        // ----------------------------------------------------------------------------
+
+        struct
+        {
+            const char* name;
+            TextureCompression compression;
+        }
+        const decoders[] =
+        {
+            { "bc1",     TextureCompression::DXT1 },
+            { "bc2",     TextureCompression::DXT3 },
+            { "bc3",     TextureCompression::DXT5 },
+            { "bc4",     TextureCompression::RGTC1_RED },
+            { "bc5",     TextureCompression::RGTC2_RG },
+            { "bc6h",    TextureCompression::BPTC_RGB_UNSIGNED_FLOAT },
+            { "bc7",     TextureCompression::BPTC_RGBA_UNORM },
+            { "etc2",    TextureCompression::ETC2_RGBA },
+            { "astc4x4", TextureCompression::ASTC_RGBA_4x4 },
+        };
+
+        for (const auto& decoder : decoders)
+        {
+            TextureCompressionInfo info(decoder.compression);
+
+            if (!info.decode || !bench.enabled("decode", decoder.name))
+                continue;
+
+            const bool bptc = info.getCompressionFormat() == TextureCompressionFormat::BPTC;
+
+            // the encoders are too slow for the BPTC formats; their random blocks exercise
+            // all of the modes, the lowest set bit of the first byte selects the BC7 mode
+            const int xblocks = round_multiple_up(width, info.width);
+            const int yblocks = round_multiple_up(height, info.height);
+            std::vector<u8> blocks(size_t(xblocks) * yblocks * info.bytes);
+
+            u32 seed = 0x1234;
+            for (size_t i = 0; i < blocks.size(); ++i)
+            {
+                seed = seed * 1103515245 + 12345;
+                blocks[i] = u8(seed >> 16);
+
+                if (decoder.compression == TextureCompression::BPTC_RGBA_UNORM && i % info.bytes == 0)
+                {
+                    const int mode = (seed >> 24) & 7;
+                    blocks[i] = u8((blocks[i] << (mode + 1)) | (1 << mode));
+                }
+            }
+
+            if (info.encode && !bptc)
+            {
+                Bitmap temp(width, height, info.format);
+                temp.blit(0, 0, source);
+                info.compress(Memory(blocks.data(), blocks.size()), temp, TextureQuality::FAST);
+            }
+
+            Bitmap dest(width, height, FORMAT_R8G8B8A8);
+
+            bench.run("decode", decoder.name, pixel_bytes, 0, [&] {
+                info.decompress(dest, Memory(blocks.data(), blocks.size()));
+            });
+        }
+
+        // ----------------------------------------------------------------------------
+        // blitter
+        // ----------------------------------------------------------------------------
+
+        struct
+        {
+            const char* name;
+            Format format;
+        }
+        const formats[] =
+        {
+            { "rgba8888", FORMAT_R8G8B8A8 },
+            { "bgra8888", FORMAT_B8G8R8A8 },
+            { "rgb888",   FORMAT_R8G8B8 },
+            { "bgr888",   FORMAT_B8G8R8 },
+            { "rgb565",   FORMAT_B5G6R5 },
+            { "rgba4444", FORMAT_B4G4R4A4 },
+            { "l8",       FORMAT_L8 },
+            { "la88",     FORMAT_L8A8 },
+            { "rgb10a2",  FORMAT_R10G10B10A2 },
+            { "rgba16",   FORMAT_RGBA16 },
+            { "rgba32f",  FORMAT_RGBA32F },
+        };
+
+        // every conversion between the formats
+        for (const auto& from : formats)
+        {
+            Bitmap src(width, height, from.format);
+            src.blit(0, 0, source);
+
+            for (const auto& to : formats)
+            {
+                if (from.format == to.format)
+                    continue;
+
+                const std::string name = std::string(from.name) + "_to_" + to.name;
+
+                if (!bench.enabled("blit", name))
+                    continue;
+
+                Bitmap dest(width, height, to.format);
+
+                bench.run("blit", name, u64(width) * height * from.format.bytes(), 0, [&] {
+                    dest.blit(0, 0, src);
+                });
+            }
+        }
+    }
+
+} // namespace bench
@@ -0,0 +1,541 @@
+/*
+    MANGO Multimedia Development Platform
+    Copyright (C) 2012-2019 Twilight Finland 3D Oy Ltd. All rights reserved.
+*/
+#include "bench.hpp"
+
+namespace bench
+{
+
+    // Round trip of constant blocks at the ends of the value range with the FAST encoders;
+    // the base value of EAC must stay in range when the values are at the end of theirs.
+    void verifyExtremes()
+    {
+        const int width = 64;
+        const int height = 64;
+
+        struct
+        {
+            const char* name;
+            TextureCompression compression;
+            u16 values[2];  // 8 bit alpha or 16 bit components
+            int tolerance;
+        }
+        const formats[] =
+        {
+            { "etc2_rgba",          TextureCompression::ETC2_RGBA,        { 0x00ff, 0x0000 }, 0 },
+            { "etc2_srgb_alpha8",   TextureCompression::ETC2_SRGB_ALPHA8, { 0x00ff, 0x0000 }, 0 },
+            { "eac_r11",            TextureCompression::EAC_R11,          { 0xffff, 0x0000 }, 32 },
+            { "eac_rg11",           TextureCompression::EAC_RG11,         { 0xffff, 0x0000 }, 32 },
+            { "eac_signed_r11",     TextureCompression::EAC_SIGNED_R11,   { 0x7fff, 0x8001 }, 32 },
+            { "eac_signed_rg11",    TextureCompression::EAC_SIGNED_RG11,  { 0x7fff, 0x8001 }, 32 },
+        };
+
+        Bitmap color(width, height, FORMAT_R8G8B8A8);
+        generateImage(color, 0x1234);
+
+        for (const auto& format : formats)
+        {
+            TextureCompressionInfo info(format.compression);
+            if (!info.encode || !info.decode)
+                continue;
+
+            const bool alpha = info.format.bytes() == 4 && info.format.size[3] == 8;
+
+            for (u16 value : format.values)
+            {
+                Bitmap image(width, height, info.format);
+                Bitmap result(width, height, info.format);
+
+                if (alpha)
+                {
+                    image.blit(0, 0, color);
+                }
+
+                for (int y = 0; y < height; ++y)
+                {
+                    u8* scan = image.address<u8>(0, y);
+
+                    for (int x = 0; x < width; ++x)
+                    {
+                        if (alpha)
+                        {
+                            scan[x * 4 + 3] = u8(value);
+                        }
+                        else
+                        {
+                            u16* p = reinterpret_cast<u16*>(scan) + x * (info.format.bytes() / 2);
+                            for (int c = 0; c < info.format.bytes() / 2; ++c)
+                                p[c] = value;
+                        }
+                    }
+                }
+
+                const int xblocks = (width + info.width - 1) / info.width;
+                const int yblocks = (height + info.height - 1) / info.height;
+
+                std::vector<u8> compressed(size_t(xblocks) * yblocks * info.bytes);
+                Memory memory(compressed.data(), compressed.size());
+
+                info.compress(memory, image, TextureQuality::FAST);
+                info.decompress(result, memory);
+
+                int errors = 0;
+
+                for (int y = 0; y < height; ++y)
+                {
+                    const u8* a = image.address<u8>(0, y);
+                    const u8* b = result.address<u8>(0, y);
+
+                    for (int x = 0; x < width; ++x)
+                    {
+                        if (alpha)
+                        {
+                            errors += std::abs(a[x * 4 + 3] - b[x * 4 + 3]) > format.tolerance;
+                        }
+                        else
+                        {
+                            const int channels = info.format.bytes() / 2;
+                            const u16* pa = reinterpret_cast<const u16*>(a) + x * channels;
+                            const u16* pb = reinterpret_cast<const u16*>(b) + x * channels;
+
+                            for (int c = 0; c < channels; ++c)
+                            {
+                                const bool sign = info.format.type == Format::SNORM;
+                                const int va = sign ? int(s16(pa[c])) : int(pa[c]);
+                                const int vb = sign ? int(s16(pb[c])) : int(pb[c]);
+                                errors += std::abs(va - vb) > format.tolerance;
+                            }
+                        }
+                    }
+                }
+
+                if (errors)
+                {
+                    std::fprintf(stderr, "%s: round-trip mismatch of constant 0x%04x (%d values).\n",
+                                 format.name, value, errors);
+                }
+            }
+        }
+    }
+
+    // ASTC of a color gradient across the blocks and an alpha gradient along them; the alpha
+    // does not follow the color, so it needs the second weight plane at both encoder tiers.
+    void verifyDualPlane()
+    {
+        const int width = 64;
+        const int height = 64;
+
+        Bitmap image(width, height, FORMAT_R8G8B8A8);
+
+        for (int y = 0; y < height; ++y)
+        {
+            u8* p = image.address<u8>(0, y);
+
+            for (int x = 0; x < width; ++x)
+            {
+                p[x * 4 + 0] = u8(x * 4);
+                p[x * 4 + 1] = u8(x * 2 + 40);
+                p[x * 4 + 2] = u8(250 - x * 3);
+                p[x * 4 + 3] = u8(y * 4);
+            }
+        }
+
+        struct
+        {
+            const char* name;
+            TextureCompression compression;
+        }
+        const formats[] =
+        {
+            { "astc4x4", TextureCompression::ASTC_RGBA_4x4 },
+            { "astc5x5", TextureCompression::ASTC_RGBA_5x5 },
+        };
+
+        for (const auto& format : formats)
+        {
+            for (TextureQuality quality : { TextureQuality::FAST, TextureQuality::HIGH })
+            {
+                TextureCompressionInfo info(format.compression);
+
+                const size_t blocks = size_t((width + info.width - 1) / info.width) *
+                                      ((height + info.height - 1) / info.height);
+                std::vector<u8> data(blocks * info.bytes);
+                Memory memory(data.data(), data.size());
+
+                info.compress(memory, image, quality);
+
+                Bitmap result(width, height, FORMAT_R8G8B8A8);
+                info.decompress(result, memory);
+
+                double error[4] = { };
+
+                for (int y = 0; y < height; ++y)
+                {
+                    const u8* a = image.address<u8>(0, y);
+                    const u8* b = result.address<u8>(0, y);
+
+                    for (int x = 0; x < width * 4; ++x)
+                    {
+                        const int d = a[x] - b[x];
+                        error[x & 3] += d * d;
+                    }
+                }
+
+                for (int c = 0; c < 4; ++c)
+                {
+                    const double mse = error[c] / (width * height);
+                    const double psnr = mse > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / mse) : 99.0;
+
+                    if (psnr < 40.0)
+                    {
+                        std::fprintf(stderr, "%s: independent alpha (%s) channel %d at %.1f dB.\n", format.name,
+                                     quality == TextureQuality::FAST ? "fast" : "high", c, psnr);
+                    }
+                }
+            }
+        }
+    }
+
+    // ETC1S transcoded to ASTC against the ETC1S pixels. The ASTC blocks are aligned with the
+    // source blocks only when the height is a multiple of four; the other heights must not
+    // lose much more than the aligned one.
+    void verifyTranscodeASTC()
+    {
+        const TextureCompression sources[] =
+        {
+            TextureCompression::ETC1S_RGB,
+            TextureCompression::ETC1S_RGBA,
+        };
+
+        for (TextureCompression compression : sources)
+        {
+            for (int height : { 64, 66 })
+            {
+                const int width = 64;
+
+                Bitmap image(width, height, FORMAT_R8G8B8A8);
+                generateImage(image, 0x2468);
+
+                TextureCompressionInfo source(compression);
+                TextureCompressionInfo target(TextureCompression::ASTC_RGBA_4x4);
+
+                const size_t blocks = size_t((width + 3) / 4) * ((height + 3) / 4);
+                std::vector<u8> etc1s(blocks * source.bytes);
+                std::vector<u8> astc(blocks * target.bytes);
+
+                source.compress(Memory(etc1s.data(), etc1s.size()), image, TextureQuality::FAST);
+                transcodeBlocks(Memory(astc.data(), astc.size()), target.compression,
+                                Memory(etc1s.data(), etc1s.size()), compression, width, height);
+
+                Bitmap expected(width, height, FORMAT_R8G8B8A8);
+                Bitmap result(width, height, FORMAT_R8G8B8A8);
+                source.decompress(expected, Memory(etc1s.data(), etc1s.size()));
+                target.decompress(result, Memory(astc.data(), astc.size()));
+
+                double error[4] = { };
+
+                for (int y = 0; y < height; ++y)
+                {
+                    const u8* a = expected.address<u8>(0, y);
+                    const u8* b = result.address<u8>(0, y);
+
+                    for (int x = 0; x < width * 4; ++x)
+                    {
+                        const int d = a[x] - b[x];
+                        error[x & 3] += d * d;
+                    }
+                }
+
+                for (int c = 0; c < 4; ++c)
+                {
+                    const double mse = error[c] / (width * height);
+                    const double psnr = mse > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / mse) : 99.0;
+
+                    if (psnr < 38.0)
+                    {
+                        std::fprintf(stderr, "astc: ETC1S transcode of %dx%d (%s) channel %d at %.1f dB.\n",
+                                     width, height, source.bytes == 16 ? "rgba" : "rgb", c, psnr);
+                    }
+                }
+            }
+        }
+    }
+
+    // Interoperability of the KTX2 container with a reference file laid out as libktx writes
+    // a 4x4 VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK texture. The reader must decode the reference
+    // and the writer must produce the same header and data format descriptor for ETC1S,
+    // which is stored as ETC2 RGB marked with the "mangoETC1S" key since KTX2 has no other
+    // representation of it without the BasisLZ supercompression.
+    void verifyKTX2()
+    {
+        const u8 reference[] =
+        {
+            // identifier
+            0xab, 0x4b, 0x54, 0x58, 0x20, 0x32, 0x30, 0xbb, 0x0d, 0x0a, 0x1a, 0x0a,
+            0x93, 0x00, 0x00, 0x00, // vkFormat: VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK
+            0x01, 0x00, 0x00, 0x00, // typeSize
+            0x04, 0x00, 0x00, 0x00, // pixelWidth
+            0x04, 0x00, 0x00, 0x00, // pixelHeight
+            0x00, 0x00, 0x00, 0x00, // pixelDepth
+            0x00, 0x00, 0x00, 0x00, // layerCount
+            0x01, 0x00, 0x00, 0x00, // faceCount
+            0x01, 0x00, 0x00, 0x00, // levelCount
+            0x00, 0x00, 0x00, 0x00, // supercompressionScheme: none
+            0x68, 0x00, 0x00, 0x00, // dfdByteOffset
+            0x2c, 0x00, 0x00, 0x00, // dfdByteLength
+            0x00, 0x00, 0x00, 0x00, // kvdByteOffset
+            0x00, 0x00, 0x00, 0x00, // kvdByteLength
+            0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // sgdByteOffset
+            0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // sgdByteLength
+
+            // level index
+            0x98, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // byteOffset
+            0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // byteLength
+            0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // uncompressedByteLength
+
+            // data format descriptor
+            0x2c, 0x00, 0x00, 0x00, // dfdTotalSize
+            0x00, 0x00, 0x00, 0x00, // vendorId: Khronos, descriptorType: basic
+            0x02, 0x00, 0x28, 0x00, // versionNumber: 1.3, descriptorBlockSize
+            0xa1, 0x01, 0x01, 0x00, // colorModel: ETC2, BT709 primaries, linear transfer, straight alpha
+            0x03, 0x03, 0x00, 0x00, // texelBlockDimension: 4x4
+            0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // bytesPlane
+            0x00, 0x00, 0x3f, 0x02, // bitOffset, bitLength: 64, channelType: ETC2 color
+            0x00, 0x00, 0x00, 0x00, // samplePosition
+            0x00, 0x00, 0x00, 0x00, // sampleLower
+            0xff, 0xff, 0xff, 0xff, // sampleUpper
+
+            // level 0 aligned to eight bytes
+            0x00, 0x00, 0x00, 0x00,
+            0x5a, 0x82, 0x3c, 0x12, 0xe4, 0x1b, 0x70, 0x8d,
+        };
+
+        const u32 dfdOffset = 104;
+        const u32 dfdLength = 44;
+        const u32 levelOffset = 152;
+
+        TextureCompressionInfo etc2(TextureCompression::ETC2_RGB);
+
+        // reader
+        {
+            Bitmap expected(4, 4, FORMAT_R8G8B8A8);
+            Bitmap result(4, 4, FORMAT_R8G8B8A8);
+
+            etc2.decompress(expected, Memory(const_cast<u8*>(reference + levelOffset), 8));
+
+            ImageDecoder decoder(Memory(const_cast<u8*>(reference), sizeof(reference)), ".ktx2");
+            ImageHeader header = decoder.header();
+            decoder.decode(result);
+
+            bool match = header.compression == TextureCompression::ETC2_RGB;
+
+            for (int y = 0; y < 4; ++y)
+            {
+                match &= !std::memcmp(expected.address(0, y), result.address(0, y), 16);
+            }
+
+            if (!match)
+            {
+                std::fprintf(stderr, "ktx2: the reference file does not decode correctly.\n");
+            }
+        }
+
+        // writer
+        {
+            Bitmap image(4, 4, FORMAT_R8G8B8A8);
+            generateImage(image, 0x4321);
+
+            TextureOptions options;
+            options.compression = TextureCompression::ETC1S_RGB;
+            options.quality = TextureQuality::FAST;
+            options.levels = 1;
+
+            Texture texture;
+            buildTexture(texture, image, options);
+
+            Buffer buffer;
+            writeTexture(buffer, texture, ".ktx2");
+
+            const u8* p = buffer.data();
+            bool match = buffer.size() >= 80 && !std::memcmp(p, reference, 48);
+
+            if (match)
+            {
+                const u32 offset = uload32le(p + 48);
+                const u32 length = uload32le(p + 52);
+
+                match = length == dfdLength && offset + length <= buffer.size() &&
+                        !std::memcmp(p + offset, reference + dfdOffset, dfdLength);
+            }
+
+            if (match)
+            {
+                // the ETC1S blocks are ETC1 blocks, so the pixels must not change
+                Bitmap expected(4, 4, FORMAT_R8G8B8A8);
+                Bitmap result(4, 4, FORMAT_R8G8B8A8);
+
+                TextureCompressionInfo(texture.compression).decompress(expected, texture.getMemory(0));
+
+                ImageDecoder decoder(buffer, ".ktx2");
+                decoder.decode(result);
+
+                for (int y = 0; y < 4; ++y)
+                {
+                    match &= !std::memcmp(expected.address(0, y), result.address(0, y), 16);
+                }
+            }
+
+            if (!match)
+            {
+                std::fprintf(stderr, "ktx2: the ETC1S texture does not match the reference layout.\n");
+            }
+        }
+
+        // ETC1S round trip; the blocks are read back unchanged for every level and face
+        struct
+        {
+            const char* name;
+            TextureCompression compression;
+        }
+        const etc1s[] =
+        {
+            { "etc1s.rgb", TextureCompression::ETC1S_RGB },
+            { "etc1s.srgb_alpha", TextureCompression::ETC1S_SRGB_ALPHA },
+        };
+
+        for (const auto& format : etc1s)
+        {
+            const TextureCompression compression = format.compression;
+
+            Bitmap image(20, 12, FORMAT_R8G8B8A8);
+            generateImage(image, 0x1234);
+
+            TextureOptions options;
+            options.compression = compression;
+            options.quality = TextureQuality::FAST;
+
+            Texture level;
+            buildTexture(level, image, options);
+
+            // the levels are repeated as a cube map to cover the face and layer order
+            Texture texture;
+            texture.width = level.width;
+            texture.height = level.height;
+            texture.levels = level.levels;
+            texture.faces = 6;
+            texture.format = level.format;
+            texture.compression = level.compression;
+
+            for (int face = 0; face < 6; ++face)
+            {
+                texture.images.insert(texture.images.end(), level.images.begin(), level.images.end());
+            }
+
+            Buffer buffer;
+            writeTexture(buffer, texture, ".ktx2");
+
+            ImageDecoder decoder(buffer, ".ktx2");
+            ImageHeader header = decoder.header();
+
+            bool match = header.compression == compression && header.levels == texture.levels &&
+                         header.faces == texture.faces;
+
+            for (int face = 0; match && face < texture.faces; ++face)
+            {
+                for (int i = 0; i < texture.levels; ++i)
+                {
+                    Memory expected = texture.getMemory(i, face);
+                    Memory result = decoder.memory(i, 0, face);
+
+                    match &= expected.size == result.size &&
+                             !std::memcmp(expected.address, result.address, expected.size);
+                }
+            }
+
+            if (!match)
+            {
+                std::fprintf(stderr, "ktx2: the ETC1S blocks do not survive the round trip (%s).\n", format.name);
+            }
+        }
+    }
+
+    void benchTexture(Bench& bench)
+    {
+        verifyExtremes();
+        verifyDualPlane();
+        verifyTranscodeASTC();
+        verifyKTX2();
+
+        const int width = 512;
+        const int height = 512;
+
+        Bitmap source(width, height, FORMAT_R8G8B8A8);
+        generateImage(source, 0x5678);
+
+        struct
+        {
+            const char* name;
+            TextureCompression compression;
+        }
+        const formats[] =
+        {
+            { "bc1", TextureCompression::BC1_UNORM },
+            { "bc2", TextureCompression::BC2_UNORM },
+            { "bc3", TextureCompression::BC3_UNORM },
+            { "bc4", TextureCompression::BC4_UNORM },
+            { "bc5", TextureCompression::BC5_UNORM },
+            { "bc6h", TextureCompression::BC6H_UF16 },
+            { "bc7", TextureCompression::BC7_UNORM },
+            { "etc1", TextureCompression::ETC1_RGB },
+            { "etc2_rgba", TextureCompression::ETC2_RGBA },
+            { "eac_r11", TextureCompression::EAC_R11 },
+            { "astc_4x4", TextureCompression::ASTC_RGBA_4x4 },
+            { "astc_8x8", TextureCompression::ASTC_RGBA_8x8 },
+            { "pvrtc_4bpp", TextureCompression::PVRTC_RGBA_4BPP },
+        };
+
+        for (const auto& format : formats)
+        {
+            TextureCompressionInfo info(format.compression);
+            if (!info.bytes)
+                continue;
+
+            const int xblocks = (width + info.width - 1) / info.width;
+            const int yblocks = (height + info.height - 1) / info.height;
+            const u64 blocks = u64(xblocks) * yblocks;
+
+            std::vector<u8> compressed(size_t(blocks * info.bytes));
+            Memory memory(compressed.data(), compressed.size());
+
+            Bitmap image(width, height, info.format);
+            image.blit(0, 0, source);
+
+            const u64 pixel_bytes = u64(width) * height * info.format.bytes();
+
+            if (info.encode)
+            {
+                bench.run("texture", std::string(format.name) + ".encode", pixel_bytes, blocks, [&] {
+                    info.compress(memory, image);
+                });
+
+                // the decoder is measured with the encoder output
+                info.compress(memory, image);
+            }
+            else
+            {
+                // decode-only formats are measured with arbitrary block data;
+                // the decoders must handle any bit pattern anyway
+                generateRandom(compressed, compressed.size(), 0x9abc);
+            }
+
+            if (info.decode)
+            {
+                bench.run("texture", std::string(format.name) + ".decode", pixel_bytes, blocks, [&] {
+                    info.decompress(image, memory);
+                });
+            }
+        }
+    }
+
+} // namespace bench
@@ -0,0 +1,68 @@
+/*
+    MANGO Multimedia Development Platform
+    Copyright (C) 2012-2019 Twilight Finland 3D Oy Ltd. All rights reserved.
+*/
+#include "bench.hpp"
+
+namespace bench
+{
+
+    void benchThread(Bench& bench)
+    {
+        const int count = 10000;
+
+        // scheduling overhead: empty tasks
+
+        bench.run("thread", "concurrent.empty", 0, count, [&] {
+            ConcurrentQueue queue;
+            for (int i = 0; i < count; ++i)
+            {
+                queue.enqueue([] {});
+            }
+            queue.wait();
+        });
+
+        bench.run("thread", "serial.empty", 0, count, [&] {
+            SerialQueue queue;
+            for (int i = 0; i < count; ++i)
+            {
+                queue.enqueue([] {});
+            }
+            queue.wait();
+        });
+
+        // scaling: independent tasks with a small amount of work each
+
+        const int tasks = 256;
+        const int work = 16 * 1024;
+
+        std::vector<u32> results(tasks);
+
+        auto task = [&] (int index)
+        {
+            u32 value = index;
+            for (int i = 0; i < work; ++i)
+            {
+                value = value * 1664525 + 1013904223;
+            }
+            results[index] = value;
+        };
+
+        bench.run("thread", "single.work", 0, tasks, [&] {
+            for (int i = 0; i < tasks; ++i)
+            {
+                task(i);
+            }
+        });
+
+        bench.run("thread", "concurrent.work", 0, tasks, [&] {
+            ConcurrentQueue queue;
+            for (int i = 0; i < tasks; ++i)
+            {
+                queue.enqueue(task, i);
+            }
+            queue.wait();
+        });
+    }
+
+} // namespace bench
@@ -1084,14 +1084,14 @@ static inline void FillWithErrorColors(u8* output, int stride)
 {
     for(size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
     {
-		HDRColorA* pOut = ComputeAddress(output, stride, i);;
+		HDRColorA* pOut = ComputeAddress(output, stride, i);
 
 #ifdef _DEBUG
         // Use Magenta in debug as a highly-visible error color
-        pOut[i] = HDRColorA(1.0f, 0.0f, 1.0f, 1.0f);
+        pOut[0] = HDRColorA(1.0f, 0.0f, 1.0f, 1.0f);
 #else
         // In production use, default to black
-        pOut[i] = HDRColorA(0.0f, 0.0f, 0.0f, 1.0f);
+        pOut[0] = HDRColorA(0.0f, 0.0f, 0.0f, 1.0f);
 #endif
     }
 }
@@ -1221,9 +1221,9 @@ void D3DX_BC6H::Decode(bool bSigned, u8* output, int stride) const
             int b2 = Unquantize(aEndPts[uRegion].B.b, info.RGBAPrec[0][0].b, bSigned);
             const int* aWeights = info.uPartitions > 0 ? g_aWeights3 : g_aWeights4;
             INTColor fc;
-            fc.r = FinishUnquantize((r1 * (BC67_WEIGHT_MAX - aWeights[uIndex]) + r2 * aWeights[uIndex] + BC67_WEIGHT_ROUND) >> BC67_WEIGHT_SHIFT, bSigned);
-            fc.g = FinishUnquantize((g1 * (BC67_WEIGHT_MAX - aWeights[uIndex]) + g2 * aWeights[uIndex] + BC67_WEIGHT_ROUND) >> BC67_WEIGHT_SHIFT, bSigned);
-            fc.b = FinishUnquantize((b1 * (BC67_WEIGHT_MAX - aWeights[uIndex]) + b2 * aWeights[uIndex] + BC67_WEIGHT_ROUND) >> BC67_WEIGHT_SHIFT, bSigned);
+            fc.r = FinishUnquantize((r1 * (int(BC67_WEIGHT_MAX) - aWeights[uIndex]) + r2 * aWeights[uIndex] + int(BC67_WEIGHT_ROUND)) >> BC67_WEIGHT_SHIFT, bSigned);
+            fc.g = FinishUnquantize((g1 * (int(BC67_WEIGHT_MAX) - aWeights[uIndex]) + g2 * aWeights[uIndex] + int(BC67_WEIGHT_ROUND)) >> BC67_WEIGHT_SHIFT, bSigned);
+            fc.b = FinishUnquantize((b1 * (int(BC67_WEIGHT_MAX) - aWeights[uIndex]) + b2 * aWeights[uIndex] + int(BC67_WEIGHT_ROUND)) >> BC67_WEIGHT_SHIFT, bSigned);
 
             float16 rgb[3];
             fc.ToF16(rgb, bSigned);
@@ -1437,13 +1437,13 @@ void D3DX_BC6H::GeneratePaletteQuantized(const EncodeParams* pEP, const INTEndPn
     for (size_t i = 0; i < uNumIndices; ++i)
     {
         aPalette[i].r = FinishUnquantize(
-            (unqEndPts.A.r * (BC67_WEIGHT_MAX - aWeights[i]) + unqEndPts.B.r * aWeights[i] + BC67_WEIGHT_ROUND) >> BC67_WEIGHT_SHIFT,
+            (unqEndPts.A.r * (int(BC67_WEIGHT_MAX) - aWeights[i]) + unqEndPts.B.r * aWeights[i] + int(BC67_WEIGHT_ROUND)) >> BC67_WEIGHT_SHIFT,
             pEP->bSigned);
         aPalette[i].g = FinishUnquantize(
-            (unqEndPts.A.g * (BC67_WEIGHT_MAX - aWeights[i]) + unqEndPts.B.g * aWeights[i] + BC67_WEIGHT_ROUND) >> BC67_WEIGHT_SHIFT,
+            (unqEndPts.A.g * (int(BC67_WEIGHT_MAX) - aWeights[i]) + unqEndPts.B.g * aWeights[i] + int(BC67_WEIGHT_ROUND)) >> BC67_WEIGHT_SHIFT,
             pEP->bSigned);
         aPalette[i].b = FinishUnquantize(
-            (unqEndPts.A.b * (BC67_WEIGHT_MAX - aWeights[i]) + unqEndPts.B.b * aWeights[i] + BC67_WEIGHT_ROUND) >> BC67_WEIGHT_SHIFT,
+            (unqEndPts.A.b * (int(BC67_WEIGHT_MAX) - aWeights[i]) + unqEndPts.B.b * aWeights[i] + int(BC67_WEIGHT_ROUND)) >> BC67_WEIGHT_SHIFT,
             pEP->bSigned);
     }
 }
@@ -24,7 +24,9 @@
     The original source code has been modified for integration.
 */
 
+#include <cstring>
 #include "astc.hpp"
+#include <mango/core/bits.hpp>
 #include <mango/core/endian.hpp>
 #include <mango/math/vector.hpp>
 
@@ -61,14 +63,6 @@ namespace
         return getBit(src, ndx) != 0;
     }
     
-    inline u32 reverseBits (u32 src, int numBits)
-    {
-        u32 result = 0;
-        for (int i = 0; i < numBits; i++)
-            result |= ((src >> i) & 1) << (numBits-1-i);
-        return result;
-    }
-    
     inline u32 bitReplicationScale (u32 src, int numSrcBits, int numDstBits)
     {
         u32 dst = 0;
@@ -101,15 +95,23 @@ namespace
             NUM_WORDS	= 128 / WORD_BITS
         };
         
+        Block128 (Word low, Word high)
+        {
+            m_words[0] = low;
+            m_words[1] = high;
+        }
+        
     public:
         Block128 (const u8* src)
         {
-            for (int wordNdx = 0; wordNdx < NUM_WORDS; wordNdx++)
-            {
-                m_words[wordNdx] = 0;
-                for (int byteNdx = 0; byteNdx < WORD_BYTES; byteNdx++)
-                    m_words[wordNdx] |= (Word)src[wordNdx*WORD_BYTES + byteNdx] << (8*byteNdx);
-            }
+            m_words[0] = uload64le(src + 0);
+            m_words[1] = uload64le(src + 8);
+        }
+        
+        // the bits in reverse order; bit i is the bit 127 - i of this block
+        Block128 reversed () const
+        {
+            return Block128(u64_reverse_bits(m_words[1]), u64_reverse_bits(m_words[0]));
         }
         
         u32 getBit (int ndx) const
@@ -119,22 +121,15 @@ namespace
         
         u32 getBits (int low, int high) const
         {
-            if (high-low+1 == 0)
+            const int count = high-low+1;
+            if (count <= 0)
                 return 0;
             
-            const int word0Ndx = low / WORD_BITS;
-            const int word1Ndx = high / WORD_BITS;
+            const Word value = low >= WORD_BITS ? m_words[1] >> (low - WORD_BITS)
+                             : low ? (m_words[0] >> low) | (m_words[1] << (WORD_BITS - low))
+                             : m_words[0];
             
-            if (word0Ndx == word1Ndx)
-            {
-                u64 temp = (m_words[word0Ndx] & ((((Word)1 << high%WORD_BITS << 1) - 1))) >> ((Word)low % WORD_BITS);
-                return u32(temp);
-            }
-            else
-            {
-                return (u32)(m_words[word0Ndx] >> (low%WORD_BITS)) |
-                       (u32)((m_words[word1Ndx] & (((Word)1 << high%WORD_BITS << 1) - 1)) << (high-low - high%WORD_BITS));
-            }
+            return u32(value & (~Word(0) >> (WORD_BITS - count)));
         }
         
         bool isBitSet (int ndx) const
@@ -146,7 +141,8 @@ namespace
         Word m_words[NUM_WORDS];
     };
     
-    // A helper for sequential access into a Block128.
+    // A helper for sequential access into a Block128. The backward streams read the reversed
+    // block forward so that the values do not have to be reversed.
     class BitAccessStream
     {
     protected:
@@ -154,10 +150,9 @@ namespace
 
     public:
         BitAccessStream (const Block128& src, int startNdxInSrc, int length, bool forward)
-        : m_src				(src)
-        , m_startNdxInSrc	(startNdxInSrc)
+        : m_src				(forward ? src : src.reversed())
+        , m_startNdxInSrc	(forward ? startNdxInSrc : 127 - startNdxInSrc)
         , m_length			(length)
-        , m_forward			(forward)
         , m_ndx				(0)
         {
         }
@@ -168,22 +163,18 @@ namespace
             if (num == 0 || m_ndx >= m_length)
                 return 0;
             
-            const int end				= m_ndx + num;
-            const int numBitsFromSrc	= std::max(0, std::min(m_length, end) - m_ndx);
-            const int low				= m_ndx;
-            const int high				= m_ndx + numBitsFromSrc - 1;
+            const int numBitsFromSrc	= std::min(m_length, m_ndx + num) - m_ndx;
+            const int low				= m_startNdxInSrc + m_ndx;
             
             m_ndx += num;
             
-            return m_forward ?			   m_src.getBits(m_startNdxInSrc + low,  m_startNdxInSrc + high)
-                             : reverseBits(m_src.getBits(m_startNdxInSrc - high, m_startNdxInSrc - low), numBitsFromSrc);
+            return m_src.getBits(low, low + numBitsFromSrc - 1);
         }
         
     private:
-        const Block128&		m_src;
+        const Block128		m_src;
         const int			m_startNdxInSrc;
         const int			m_length;
-        const bool			m_forward;
         
         int					m_ndx;
     };
@@ -378,13 +369,28 @@ namespace
         return blockMode;
     }
     
-    inline void setASTCErrorColorBlock (void* dst, int blockWidth, int blockHeight, bool isSRGB)
+    // The texels are written as 8 bit components. The LDR components are truncated from their
+    // 16 bit value and the HDR components from their half float value, which gives the same
+    // result as converting the float texels of the reference decoder.
+
+    inline u8 unorm8FromUnorm16 (u32 c)
+    {
+        // (c / 65536.0f) * 255 is exact in float; 0xffff decodes as 1.0
+        return c == 0xffff ? 0xff : u8((c * 255) >> 16);
+    }
+
+    inline u8 unorm8FromHalf (Half h)
+    {
+        return u8(float(h) * 255);
+    }
+
+    inline void setASTCErrorColorBlock (u8* dst, int stride, int blockWidth, int blockHeight)
     {
-        if (isSRGB)
+        for (int y = 0; y < blockHeight; y++)
         {
-            u8* const dstU = (u8*)dst;
-            
-            for (int i = 0; i < blockWidth*blockHeight; i++)
+            u8* const dstU = dst + y*stride;
+
+            for (int i = 0; i < blockWidth; i++)
             {
                 dstU[4*i + 0] = 0xff;
                 dstU[4*i + 1] = 0;
@@ -392,21 +398,9 @@ namespace
                 dstU[4*i + 3] = 0xff;
             }
         }
-        else
-        {
-            float* const dstF = (float*)dst;
-            
-            for (int i = 0; i < blockWidth*blockHeight; i++)
-            {
-                dstF[4*i + 0] = 1.0f;
-                dstF[4*i + 1] = 0.0f;
-                dstF[4*i + 2] = 1.0f;
-                dstF[4*i + 3] = 1.0f;
-            }
-        }
     }
     
-    void decodeVoidExtentBlock (void* dst, const Block128& blockData, int blockWidth, int blockHeight, bool isSRGB, bool isLDRMode)
+    void decodeVoidExtentBlock (u8* dst, int stride, const Block128& blockData, int blockWidth, int blockHeight, bool isSRGB, bool isLDRMode)
     {
         const u32	minSExtent			= blockData.getBits(12, 24);
         const u32	maxSExtent			= blockData.getBits(25, 37);
@@ -417,7 +411,7 @@ namespace
         
         if ((isLDRMode && isHDRBlock) || (!allExtentsAllOnes && (minSExtent >= maxSExtent || minTExtent >= maxTExtent)))
         {
-            setASTCErrorColorBlock(dst, blockWidth, blockHeight, isSRGB);
+            setASTCErrorColorBlock(dst, stride, blockWidth, blockHeight);
             return;
         }
         
@@ -429,48 +423,35 @@ namespace
             blockData.getBits(112, 127)
         };
         
-        if (isSRGB)
-        {
-            u8* const dstU = (u8*)dst;
-            for (int i = 0; i < blockWidth*blockHeight; i++)
-                for (int c = 0; c < 4; c++)
-                {
-                    dstU[i*4 + c] = (rgba[c] & 0xff00) >> 8;
-                }
-        }
-        else
+        u8 color[4];
+
+        for (int c = 0; c < 4; c++)
         {
-            float* const dstF = (float*)dst;
-            
-            if (isHDRBlock)
+            if (isSRGB)
             {
-                for (int c = 0; c < 4; c++)
-                {
-                    float16 h = u16(rgba[c]);
-                    if (isFloat16InfOrNan(h))
-                    {
-                        //throw tcu::InternalError("Infinity or NaN color component in HDR void extent block in ASTC texture (behavior undefined by ASTC specification)");
-                    }
-                }
-                
-                for (int i = 0; i < blockWidth*blockHeight; i++)
-                    for (int c = 0; c < 4; c++)
-                    {
-                        float16 h = u16(rgba[c]);
-                        dstF[i*4 + c] = h;
-                    }
+                color[c] = (rgba[c] & 0xff00) >> 8;
+            }
+            else if (isHDRBlock)
+            {
+                // \note Infinity and NaN components are undefined by the ASTC specification.
+                float16 h = u16(rgba[c]);
+                color[c] = unorm8FromHalf(h);
             }
             else
             {
-                for (int i = 0; i < blockWidth*blockHeight; i++)
-                    for (int c = 0; c < 4; c++)
-                    {
-                        dstF[i*4 + c] = rgba[c] == 65535 ? 1.0f : (float)rgba[c] / 65536.0f;
-                    }
+                color[c] = unorm8FromUnorm16(rgba[c]);
+            }
+        }
+
+        for (int y = 0; y < blockHeight; y++)
+        {
+            u8* const dstU = dst + y*stride;
+
+            for (int i = 0; i < blockWidth; i++)
+            {
+                std::memcpy(dstU + i*4, color, 4);
             }
         }
-        
-        return;
     }
     
     void decodeColorEndpointModes (u32* endpointModesDst, const Block128& blockData, int numPartitions, int extraCemBitsStart)
@@ -1267,11 +1248,10 @@ namespace
         return p;
     }
     
-    int computeTexelPartition (u32 seedIn, u32 xIn, u32 yIn, u32 zIn, int numPartitions, bool smallBlock)
+    // computeTexelPartition() of the reference decoder for all of the texels of a 2D block;
+    // the hash of the seed is the same for every texel so it is computed once.
+    void computeTexelPartitions (u8* dst, u32 seedIn, int numPartitions, int blockWidth, int blockHeight, bool smallBlock)
     {
-        const u32	x		= smallBlock ? xIn << 1 : xIn;
-        const u32	y		= smallBlock ? yIn << 1 : yIn;
-        const u32	z		= smallBlock ? zIn << 1 : zIn;
         const u32	seed	= seedIn + 1024*(numPartitions-1);
         const u32	rnum	= hash52(seed);
         u8			seed1	=  rnum							& 0xf;
@@ -1282,38 +1262,43 @@ namespace
         u8			seed6	= (rnum >> 20)					& 0xf;
         u8			seed7	= (rnum >> 24)					& 0xf;
         u8			seed8	= (rnum >> 28)					& 0xf;
-        u8			seed9	= (rnum >> 18)					& 0xf;
-        u8			seed10	= (rnum >> 22)					& 0xf;
-        u8			seed11	= (rnum >> 26)					& 0xf;
-        u8			seed12	= ((rnum >> 30) | (rnum << 2))	& 0xf;
         
-        seed1 *= seed1;		seed5 *= seed5;		seed9  *= seed9;
-        seed2 *= seed2;		seed6 *= seed6;		seed10 *= seed10;
-        seed3 *= seed3;		seed7 *= seed7;		seed11 *= seed11;
-        seed4 *= seed4;		seed8 *= seed8;		seed12 *= seed12;
+        seed1 *= seed1;		seed5 *= seed5;
+        seed2 *= seed2;		seed6 *= seed6;
+        seed3 *= seed3;		seed7 *= seed7;
+        seed4 *= seed4;		seed8 *= seed8;
         
         const int shA = (seed & 2) != 0		? 4		: 5;
         const int shB = numPartitions == 3	? 6		: 5;
         const int sh1 = (seed & 1) != 0		? shA	: shB;
         const int sh2 = (seed & 1) != 0		? shB	: shA;
-        const int sh3 = (seed & 0x10) != 0	? sh1	: sh2;
         
         seed1 >>= sh1;		seed2  >>= sh2;		seed3  >>= sh1;		seed4  >>= sh2;
         seed5 >>= sh1;		seed6  >>= sh2;		seed7  >>= sh1;		seed8  >>= sh2;
-        seed9 >>= sh3;		seed10 >>= sh3;		seed11 >>= sh3;		seed12 >>= sh3;
-        
-        const int a =						0x3f & (seed1*x + seed2*y + seed11*z + (rnum >> 14));
-        const int b =						0x3f & (seed3*x + seed4*y + seed12*z + (rnum >> 10));
-        const int c = numPartitions >= 3 ?	0x3f & (seed5*x + seed6*y + seed9*z  + (rnum >>  6))	: 0;
-        const int d = numPartitions >= 4 ?	0x3f & (seed7*x + seed8*y + seed10*z + (rnum >>  2))	: 0;
         
-        return a >= b && a >= c && a >= d	? 0
-        : b >= c && b >= d				? 1
-        : c >= d						? 2
-        :								  3;
+        // the z coordinate is zero; its seeds do not contribute
+        for (int texelY = 0; texelY < blockHeight; texelY++)
+        {
+            const u32 y = smallBlock ? texelY << 1 : texelY;
+
+            for (int texelX = 0; texelX < blockWidth; texelX++)
+            {
+                const u32 x = smallBlock ? texelX << 1 : texelX;
+                
+                const int a =						0x3f & (seed1*x + seed2*y + (rnum >> 14));
+                const int b =						0x3f & (seed3*x + seed4*y + (rnum >> 10));
+                const int c = numPartitions >= 3 ?	0x3f & (seed5*x + seed6*y + (rnum >>  6))	: 0;
+                const int d = numPartitions >= 4 ?	0x3f & (seed7*x + seed8*y + (rnum >>  2))	: 0;
+                
+                *dst++ = a >= b && a >= c && a >= d	? 0
+                : b >= c && b >= d				? 1
+                : c >= d						? 2
+                :								  3;
+            }
+        }
     }
     
-    void setTexelColors (void* dst, ColorEndpointPair* colorEndpoints, TexelWeightPair* texelWeights, int ccs, u32 partitionIndexSeed,
+    void setTexelColors (u8* dst, int stride, ColorEndpointPair* colorEndpoints, TexelWeightPair* texelWeights, int ccs, u32 partitionIndexSeed,
                                 int numPartitions, int blockWidth, int blockHeight, bool isSRGB, bool isLDRMode, const u32* colorEndpointModes)
     {
         const bool	smallBlock = blockWidth*blockHeight < 31;
@@ -1322,31 +1307,31 @@ namespace
         for (int i = 0; i < numPartitions; i++)
             isHDREndpoint[i] = isColorEndpointModeHDR(colorEndpointModes[i]);
         
+        u8 partitions[ASTC_MAX_BLOCK_WIDTH*ASTC_MAX_BLOCK_HEIGHT];
+        
+        if (numPartitions > 1)
+            computeTexelPartitions(partitions, partitionIndexSeed, numPartitions, blockWidth, blockHeight, smallBlock);
+        
         for (int texelY = 0; texelY < blockHeight; texelY++)
+        {
+            u8* const dstU = dst + texelY*stride;
+            
             for (int texelX = 0; texelX < blockWidth; texelX++)
             {
                 const int				texelNdx			= texelY*blockWidth + texelX;
-                const int				colorEndpointNdx	= numPartitions == 1 ? 0 : computeTexelPartition(partitionIndexSeed, texelX, texelY, 0, numPartitions, smallBlock);
+                const int				colorEndpointNdx	= numPartitions == 1 ? 0 : partitions[texelNdx];
                 const uint4&			e0					= colorEndpoints[colorEndpointNdx].e0;
                 const uint4&			e1					= colorEndpoints[colorEndpointNdx].e1;
                 const TexelWeightPair&	weight				= texelWeights[texelNdx];
+                u8* const				texel				= dstU + texelX*4;
                 
-                if (isLDRMode && isHDREndpoint[colorEndpointNdx])
+                // \note The 8 bit sRGB output can not store the HDR endpoints; they are errors as in the LDR mode.
+                if ((isLDRMode || isSRGB) && isHDREndpoint[colorEndpointNdx])
                 {
-                    if (isSRGB)
-                    {
-                        ((u8*)dst)[texelNdx*4 + 0] = 0xff;
-                        ((u8*)dst)[texelNdx*4 + 1] = 0;
-                        ((u8*)dst)[texelNdx*4 + 2] = 0xff;
-                        ((u8*)dst)[texelNdx*4 + 3] = 0xff;
-                    }
-                    else
-                    {
-                        ((float*)dst)[texelNdx*4 + 0] = 1.0f;
-                        ((float*)dst)[texelNdx*4 + 1] = 0;
-                        ((float*)dst)[texelNdx*4 + 2] = 1.0f;
-                        ((float*)dst)[texelNdx*4 + 3] = 1.0f;
-                    }
+                    texel[0] = 0xff;
+                    texel[1] = 0;
+                    texel[2] = 0xff;
+                    texel[3] = 0xff;
                 }
                 else
                 {
@@ -1359,10 +1344,7 @@ namespace
                             const u32 w	= weight.w[ccs == channelNdx ? 1 : 0];
                             const u32 c	= (c0*(64-w) + c1*w + 32) / 64;
                             
-                            if (isSRGB)
-                                ((u8*)dst)[texelNdx*4 + channelNdx] = (c & 0xff00) >> 8;
-                            else
-                                ((float*)dst)[texelNdx*4 + channelNdx] = c == 65535 ? 1.0f : (float)c / 65536.0f;
+                            texel[channelNdx] = isSRGB ? u8((c & 0xff00) >> 8) : unorm8FromUnorm16(c);
                         }
                         else
                         {
@@ -1381,14 +1363,15 @@ namespace
                             if (isFloat16InfOrNan(cf))
                                 cf.u = 0x7bff;
 
-                            ((float*)dst)[texelNdx*4 + channelNdx] = cf;
+                            texel[channelNdx] = unorm8FromHalf(cf);
                         }
                     }
                 }
             }
+        }
     }
 
-    void decompressASTCBlock (void* dst, const Block128& blockData, int blockWidth, int blockHeight, bool isSRGB, bool isLDR)
+    void decompressASTCBlock (u8* dst, int stride, const Block128& blockData, int blockWidth, int blockHeight, bool isSRGB, bool isLDR)
     {
         // Decode block mode.
         
@@ -1398,7 +1381,7 @@ namespace
         
         if (blockMode.isError)
         {
-            setASTCErrorColorBlock(dst, blockWidth, blockHeight, isSRGB);
+            setASTCErrorColorBlock(dst, stride, blockWidth, blockHeight);
             return;
         }
         
@@ -1406,7 +1389,7 @@ namespace
         
         if (blockMode.isVoidExtent)
         {
-            decodeVoidExtentBlock(dst, blockData, blockWidth, blockHeight, isSRGB, isLDR);
+            decodeVoidExtentBlock(dst, stride, blockData, blockWidth, blockHeight, isSRGB, isLDR);
             return;
         }
         
@@ -1425,7 +1408,7 @@ namespace
             blockMode.weightGridHeight > blockHeight	||
             (numPartitions == 4 && blockMode.isDualPlane))
         {
-            setASTCErrorColorBlock(dst, blockWidth, blockHeight, isSRGB);
+            setASTCErrorColorBlock(dst, stride, blockWidth, blockHeight);
             return;
         }
         
@@ -1451,7 +1434,7 @@ namespace
         
         if (numColorEndpointValues > 18 || numBitsForColorEndpoints < divRoundUp(13*numColorEndpointValues, 5))
         {
-            setASTCErrorColorBlock(dst, blockWidth, blockHeight, isSRGB);
+            setASTCErrorColorBlock(dst, stride, blockWidth, blockHeight);
             return;
         }
         
@@ -1471,7 +1454,7 @@ namespace
         const int		ccs					= blockMode.isDualPlane ? (int)blockData.getBits(extraCemBitsStart-2, extraCemBitsStart-1) : -1;
         const u32	partitionIndexSeed		= numPartitions > 1 ? blockData.getBits(13, 22) : (u32)-1;
         
-        setTexelColors(dst, &colorEndpoints[0], &texelWeights[0], ccs, partitionIndexSeed, numPartitions, blockWidth, blockHeight, isSRGB, isLDR, &colorEndpointModes[0]);
+        setTexelColors(dst, stride, &colorEndpoints[0], &texelWeights[0], ccs, partitionIndexSeed, numPartitions, blockWidth, blockHeight, isSRGB, isLDR, &colorEndpointModes[0]);
     }
     
 } // namespace
@@ -1481,63 +1464,11 @@ namespace mango
 
     void decode_block_astc(const TextureCompressionInfo& info, u8* output, const u8* input, int stride)
     {
-        union
-        {
-            u8 sRGB[ASTC_MAX_BLOCK_WIDTH * ASTC_MAX_BLOCK_HEIGHT * 4];
-            float linear[ASTC_MAX_BLOCK_WIDTH * ASTC_MAX_BLOCK_HEIGHT * 4];
-        } decompressedBuffer;
-
         const bool isLDR = false; // TODO: determine from block information
         const bool isSRGB = (info.getCompressionFlags() & TextureCompressionFlags::SRGB) != 0;
-        const int blockWidth = info.width;
-        const int blockHeight = info.height;
 
         const Block128 blockData(input);
-
-        // TODO: Support writing directly into the output pointer
-        if (isSRGB)
-        {
-            decompressASTCBlock(&decompressedBuffer.sRGB[0], blockData, blockWidth, blockHeight, isSRGB, isLDR);
-
-            for (int y = 0; y < blockHeight; ++y)
-            {
-                u8* dest = output + y * stride;
-                u8* src = decompressedBuffer.sRGB + y * blockWidth * 4;
-
-                for (int x = 0; x < blockWidth; ++x)
-                {
-                    dest[0] = src[0];
-                    dest[1] = src[1];
-                    dest[2] = src[2];
-                    dest[3] = src[3];
-                    dest += 4;
-                    src += 4;
-                }
-            }
-        }
-        else
-        {
-            // TODO: Write result out in Half or Float format.
-            // NOTE: The code does internally use Half format and converts to Float.
-            decompressASTCBlock(&decompressedBuffer.linear[0], blockData, blockWidth, blockHeight, isSRGB, isLDR);
-
-            // convert to unorm8
-            for (int y = 0; y < blockHeight; ++y)
-            {
-                u8* dest = output + y * stride;
-                float* src = decompressedBuffer.linear + y * blockWidth * 4;
-
-                for (int x = 0; x < blockWidth; ++x)
-                {
-                    dest[0] = u8(src[0] * 255);
-                    dest[1] = u8(src[1] * 255);
-                    dest[2] = u8(src[2] * 255);
-                    dest[3] = u8(src[3] * 255);
-                    dest += 4;
-                    src += 4;
-                }
-            }
-        }
+        decompressASTCBlock(output, stride, blockData, info.width, info.height, isSRGB, isLDR);
     }
 
 } // namespace mango
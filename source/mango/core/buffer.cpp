@@ -2,13 +2,86 @@
     MANGO Multimedia Development Platform
     Copyright (C) 2012-2018 Twilight Finland 3D Oy Ltd. All rights reserved.
 */
+#include <mutex>
 #include <mango/core/buffer.hpp>
 #include <mango/core/exception.hpp>
 
 #define ID "[Buffer] "
 
+namespace
+{
+    using namespace mango;
+
+    // ----------------------------------------------------------------------------
+    // PagePool
+    // ----------------------------------------------------------------------------
+
+    class PagePool
+    {
+    protected:
+        std::mutex m_mutex;
+        std::vector<u8*> m_free;
+
+        // pages kept around for reuse: 4 MB
+        enum { MAX_FREE_PAGES = 64 };
+
+    public:
+        PagePool()
+        {
+        }
+
+        ~PagePool()
+        {
+            for (u8* page : m_free)
+            {
+                delete[] page;
+            }
+        }
+
+        u8* acquire()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (!m_free.empty())
+                {
+                    u8* page = m_free.back();
+                    m_free.pop_back();
+                    return page;
+                }
+            }
+
+            return new u8[SegmentedBuffer::PAGE_SIZE];
+        }
+
+        void release(u8* page)
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (m_free.size() < MAX_FREE_PAGES)
+                {
+                    m_free.push_back(page);
+                    return;
+                }
+            }
+
+            delete[] page;
+        }
+    };
+
+    PagePool& getPagePool()
+    {
+        static PagePool pool;
+        return pool;
+    }
+
+} // namespace
+
 namespace mango {
 
+    // ----------------------------------------------------------------------------
+    // Buffer
+    // ----------------------------------------------------------------------------
+
     Buffer::Buffer()
         : m_memory(nullptr, 0)
         , m_capacity(0)
@@ -140,4 +213,175 @@ namespace mango {
         m_memory.size = std::max(m_memory.size, m_offset);
     }
 
+    // ----------------------------------------------------------------------------
+    // SegmentedBuffer
+    // ----------------------------------------------------------------------------
+
+    SegmentedBuffer::SegmentedBuffer()
+        : m_size(0)
+        , m_offset(0)
+    {
+    }
+
+    SegmentedBuffer::~SegmentedBuffer()
+    {
+        reset();
+    }
+
+    void SegmentedBuffer::reset()
+    {
+        PagePool& pool = getPagePool();
+
+        for (Memory& page : m_pages)
+        {
+            pool.release(page.address);
+        }
+
+        m_pages.clear();
+        m_size = 0;
+        m_offset = 0;
+    }
+
+    Memory SegmentedBuffer::acquire(size_t bytes)
+    {
+        if (bytes > PAGE_SIZE)
+        {
+            MANGO_EXCEPTION(ID"Acquire request larger than page.");
+        }
+
+        if (m_pages.empty() || PAGE_SIZE - m_pages.back().size < bytes)
+        {
+            m_pages.emplace_back(getPagePool().acquire(), 0);
+        }
+
+        Memory& page = m_pages.back();
+        return Memory(page.address + page.size, PAGE_SIZE - page.size);
+    }
+
+    void SegmentedBuffer::commit(size_t bytes)
+    {
+        Memory& page = m_pages.back();
+        page.size += bytes;
+        m_size += bytes;
+        m_offset = m_size;
+    }
+
+    void SegmentedBuffer::append(SegmentedBuffer& source)
+    {
+        m_pages.insert(m_pages.end(), source.m_pages.begin(), source.m_pages.end());
+        m_size += source.m_size;
+        m_offset = m_size;
+
+        source.m_pages.clear();
+        source.m_size = 0;
+        source.m_offset = 0;
+    }
+
+    const std::vector<Memory>& SegmentedBuffer::segments() const
+    {
+        return m_pages;
+    }
+
+    u64 SegmentedBuffer::size() const
+    {
+        return m_size;
+    }
+
+    u64 SegmentedBuffer::offset() const
+    {
+        return m_offset;
+    }
+
+    void SegmentedBuffer::seek(u64 distance, SeekMode mode)
+    {
+        switch (mode)
+        {
+            case BEGIN:
+                m_offset = distance;
+                break;
+
+            case CURRENT:
+                m_offset += distance;
+                break;
+
+            case END:
+                m_offset = m_size - distance;
+                break;
+        }
+
+        if (m_offset > m_size)
+        {
+            MANGO_EXCEPTION(ID"Seeking past end of buffer.");
+        }
+    }
+
+    void SegmentedBuffer::read(void* dest, size_t bytes)
+    {
+        if (m_size - m_offset < bytes)
+        {
+            MANGO_EXCEPTION(ID"Reading past end of buffer.");
+        }
+
+        u8* output = reinterpret_cast<u8*>(dest);
+        u64 position = 0;
+
+        for (const Memory& page : m_pages)
+        {
+            if (!bytes)
+                break;
+
+            if (m_offset < position + page.size)
+            {
+                size_t start = size_t(m_offset - position);
+                size_t n = std::min(bytes, page.size - start);
+                std::memcpy(output, page.address + start, n);
+                output += n;
+                bytes -= n;
+                m_offset += n;
+            }
+
+            position += page.size;
+        }
+    }
+
+    void SegmentedBuffer::write(const void* data, size_t bytes)
+    {
+        const u8* input = reinterpret_cast<const u8*>(data);
+
+        // overwrite existing content
+        if (m_offset < m_size)
+        {
+            u64 position = 0;
+
+            for (Memory& page : m_pages)
+            {
+                if (!bytes)
+                    break;
+
+                if (m_offset < position + page.size)
+                {
+                    size_t start = size_t(m_offset - position);
+                    size_t n = std::min(bytes, page.size - start);
+                    std::memcpy(page.address + start, input, n);
+                    input += n;
+                    bytes -= n;
+                    m_offset += n;
+                }
+
+                position += page.size;
+            }
+        }
+
+        // append
+        while (bytes > 0)
+        {
+            Memory tail = acquire(1);
+            size_t n = std::min(bytes, tail.size);
+            std::memcpy(tail.address, input, n);
+            commit(n);
+            input += n;
+            bytes -= n;
+        }
+    }
+
 } // namespace mango
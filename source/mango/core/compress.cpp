@@ -36,6 +36,177 @@
 
 namespace mango {
 
+// ----------------------------------------------------------------------------
+// CompressionContext
+// ----------------------------------------------------------------------------
+
+    // Every allocation has a header which stores the block capacity; the zlib and
+    // lzma free callbacks do not tell the size of the released block.
+    static constexpr size_t g_context_header_size = MANGO_DEFAULT_ALIGNMENT;
+
+    // Upper limit for memory retained by one thread; large enough for bzip2 at
+    // maximum level (~7.6 MB) and all of the lzma / deflate state.
+    static constexpr size_t g_context_cache_limit = 32 * 1024 * 1024;
+
+    CompressionContext::CompressionContext()
+        : m_cache_size(0)
+        , m_zstd_compress(nullptr)
+        , m_zstd_decompress(nullptr)
+    {
+    }
+
+    CompressionContext::~CompressionContext()
+    {
+        purge();
+
+#ifdef MANGO_ENABLE_LICENSE_BSD
+        ZSTD_freeCCtx(reinterpret_cast<ZSTD_CCtx*>(m_zstd_compress));
+        ZSTD_freeDCtx(reinterpret_cast<ZSTD_DCtx*>(m_zstd_decompress));
+#endif
+    }
+
+    void* CompressionContext::allocate(size_t size)
+    {
+        // best fit from the cache; accept blocks up to twice the requested size
+        auto best = m_cache.end();
+
+        for (auto i = m_cache.begin(); i != m_cache.end(); ++i)
+        {
+            if (i->size >= size && i->size <= size * 2)
+            {
+                if (best == m_cache.end() || i->size < best->size)
+                {
+                    best = i;
+                    if (best->size == size)
+                        break;
+                }
+            }
+        }
+
+        if (best != m_cache.end())
+        {
+            void* address = best->address;
+            m_cache_size -= best->size;
+            m_cache.erase(best);
+            return address;
+        }
+
+        u8* block = reinterpret_cast<u8*>(aligned_malloc(size + g_context_header_size));
+        if (!block)
+        {
+            return nullptr;
+        }
+
+        *reinterpret_cast<size_t*>(block) = size;
+        return block + g_context_header_size;
+    }
+
+    void CompressionContext::deallocate(void* address)
+    {
+        if (!address)
+        {
+            return;
+        }
+
+        u8* block = reinterpret_cast<u8*>(address) - g_context_header_size;
+        const size_t size = *reinterpret_cast<size_t*>(block);
+
+        if (size > g_context_cache_limit)
+        {
+            aligned_free(block);
+            return;
+        }
+
+        m_cache.push_back({ address, size });
+        m_cache_size += size;
+
+        // evict the least recently released blocks
+        while (m_cache_size > g_context_cache_limit)
+        {
+            Block& front = m_cache.front();
+            m_cache_size -= front.size;
+            aligned_free(reinterpret_cast<u8*>(front.address) - g_context_header_size);
+            m_cache.erase(m_cache.begin());
+        }
+    }
+
+    void CompressionContext::purge()
+    {
+        for (auto& block : m_cache)
+        {
+            aligned_free(reinterpret_cast<u8*>(block.address) - g_context_header_size);
+        }
+
+        m_cache.clear();
+        m_cache_size = 0;
+    }
+
+    void* CompressionContext::getZstdCompressContext()
+    {
+#ifdef MANGO_ENABLE_LICENSE_BSD
+        if (!m_zstd_compress)
+        {
+            m_zstd_compress = ZSTD_createCCtx();
+        }
+#endif
+        return m_zstd_compress;
+    }
+
+    void* CompressionContext::getZstdDecompressContext()
+    {
+#ifdef MANGO_ENABLE_LICENSE_BSD
+        if (!m_zstd_decompress)
+        {
+            m_zstd_decompress = ZSTD_createDCtx();
+        }
+#endif
+        return m_zstd_decompress;
+    }
+
+    CompressionContext& CompressionContext::getThreadContext()
+    {
+        static thread_local CompressionContext context;
+        return context;
+    }
+
+    void* CompressionContext::allocate(void* opaque, size_t items, size_t size)
+    {
+        CompressionContext* context = opaque ? reinterpret_cast<CompressionContext*>(opaque) : &getThreadContext();
+        return context->allocate(items * size);
+    }
+
+    void CompressionContext::deallocate(void* opaque, void* address)
+    {
+        CompressionContext* context = opaque ? reinterpret_cast<CompressionContext*>(opaque) : &getThreadContext();
+        context->deallocate(address);
+    }
+
+    // lzma-sdk allocator interface
+
+    struct ContextAllocator : ISzAlloc
+    {
+        CompressionContext* context;
+
+        ContextAllocator()
+            : context(&CompressionContext::getThreadContext())
+        {
+            Alloc = alloc;
+            Free = free;
+        }
+
+        static void* alloc(ISzAllocPtr p, size_t size)
+        {
+            const ContextAllocator* allocator = static_cast<const ContextAllocator*>(p);
+            return allocator->context->allocate(size);
+        }
+
+        static void free(ISzAllocPtr p, void* address)
+        {
+            const ContextAllocator* allocator = static_cast<const ContextAllocator*>(p);
+            allocator->context->deallocate(address);
+        }
+    };
+
 // ----------------------------------------------------------------------------
 // nocompress
 // ----------------------------------------------------------------------------
@@ -73,28 +244,64 @@ namespace miniz {
 		return mz_compressBound(s);
     }
 
+    static void init_stream(mz_stream& stream, Memory dest, Memory source)
+    {
+        std::memset(&stream, 0, sizeof(stream));
+
+        stream.next_in = source.address;
+        stream.avail_in = static_cast<unsigned int>(source.size);
+        stream.next_out = dest.address;
+        stream.avail_out = static_cast<unsigned int>(dest.size);
+
+        // recycle the (de)compressor state through the thread's context
+        stream.zalloc = CompressionContext::allocate;
+        stream.zfree = CompressionContext::deallocate;
+        stream.opaque = &CompressionContext::getThreadContext();
+    }
+
 	size_t compress(Memory dest, Memory source, int level)
 	{
         level = clamp(level, 0, 10);
 
-        mz_ulong dest_size = mz_ulong(dest.size);
-        mz_ulong source_size = mz_ulong(source.size);
+        mz_stream stream;
+        init_stream(stream, dest, source);
 
-        int status = mz_compress2(dest, &dest_size, source, source_size, level);
-        if (status != MZ_OK)
+        int status = mz_deflateInit(&stream, level);
+        if (status == MZ_OK)
+        {
+            status = mz_deflate(&stream, MZ_FINISH);
+            mz_deflateEnd(&stream);
+        }
+
+        if (status != MZ_STREAM_END)
         {
             MANGO_EXCEPTION("[miniz] compression failed.");
         }
 
-        return dest_size;
+        return size_t(stream.total_out);
 	}
 
     void decompress(Memory dest, Memory source)
     {
-        mz_ulong dest_size = mz_ulong(dest.size);
-        mz_ulong source_size = mz_ulong(source.size);
+        mz_stream stream;
+        init_stream(stream, dest, source);
+
+        int status = mz_inflateInit(&stream);
+        if (status == MZ_OK)
+        {
+            status = mz_inflate(&stream, MZ_FINISH);
+            mz_inflateEnd(&stream);
+
+            if (status == MZ_STREAM_END)
+            {
+                status = MZ_OK;
+            }
+            else if (status == MZ_BUF_ERROR && !stream.avail_in)
+            {
+                status = MZ_DATA_ERROR;
+            }
+        }
 
-        int status = mz_uncompress(dest, &dest_size, source, source_size);
         if (status != MZ_OK)
         {
             const char* msg = nullptr;
@@ -315,7 +522,8 @@ namespace lzo {
 
     size_t compress(Memory dest, Memory source, int level)
     {
-        void* workmem = aligned_malloc(LZO1X_MEM_COMPRESS);
+        CompressionContext& context = CompressionContext::getThreadContext();
+        void* workmem = context.allocate(LZO1X_MEM_COMPRESS);
 
         lzo_uint dst_len = (lzo_uint)dest.size;
         int x = lzo1x_1_compress(
@@ -325,7 +533,7 @@ namespace lzo {
             &dst_len,
             workmem);
 
-        aligned_free(workmem);
+        context.deallocate(workmem);
         if (x != LZO_E_OK)
         {
             MANGO_EXCEPTION("[lzo] compression failed.");
@@ -372,8 +580,11 @@ namespace zstd {
 
         level = clamp(level * 2, 1, 20);
 
-        const size_t x = ZSTD_compress(dest.address, dest.size,
-                                       source.address, source.size, level);
+        CompressionContext& context = CompressionContext::getThreadContext();
+        ZSTD_CCtx* cctx = reinterpret_cast<ZSTD_CCtx*>(context.getZstdCompressContext());
+
+        const size_t x = ZSTD_compressCCtx(cctx, dest.address, dest.size,
+                                           source.address, source.size, level);
         if (ZSTD_isError(x))
         {
             MANGO_EXCEPTION("[zstd] %s", ZSTD_getErrorName(x));
@@ -384,8 +595,11 @@ namespace zstd {
 
     void decompress(Memory dest, Memory source)
     {
-        size_t x = ZSTD_decompress((void*)dest.address, dest.size,
-                                   source.address, source.size);
+        CompressionContext& context = CompressionContext::getThreadContext();
+        ZSTD_DCtx* dctx = reinterpret_cast<ZSTD_DCtx*>(context.getZstdDecompressContext());
+
+        size_t x = ZSTD_decompressDCtx(dctx, (void*)dest.address, dest.size,
+                                       source.address, source.size);
         if (ZSTD_isError(x))
         {
             MANGO_EXCEPTION("[zstd] %s", ZSTD_getErrorName(x));
@@ -508,6 +722,18 @@ namespace zstd {
 
 namespace bzip2 {
 
+    static void* bz_alloc(void* opaque, int items, int size)
+    {
+        CompressionContext* context = reinterpret_cast<CompressionContext*>(opaque);
+        return context->allocate(size_t(items) * size_t(size));
+    }
+
+    static void bz_free(void* opaque, void* address)
+    {
+        CompressionContext* context = reinterpret_cast<CompressionContext*>(opaque);
+        context->deallocate(address);
+    }
+
     size_t bound(size_t size)
     {
         return size + (size / 100) + 600;
@@ -522,9 +748,9 @@ namespace bzip2 {
 
         bz_stream strm;
 
-        strm.bzalloc = nullptr;
-        strm.bzfree = nullptr;
-        strm.opaque = nullptr;
+        strm.bzalloc = bz_alloc;
+        strm.bzfree = bz_free;
+        strm.opaque = &CompressionContext::getThreadContext();
 
         int x = BZ2_bzCompressInit(&strm, blockSize100k, verbosity, workFactor);
         if (x != BZ_OK)
@@ -561,9 +787,9 @@ namespace bzip2 {
     {
         bz_stream strm;
 
-        strm.bzalloc = nullptr;
-        strm.bzfree = nullptr;
-        strm.opaque = nullptr;
+        strm.bzalloc = bz_alloc;
+        strm.bzfree = bz_free;
+        strm.opaque = &CompressionContext::getThreadContext();
 
         int x = BZ2_bzDecompressInit(&strm, 0, 0);
         if (x != BZ_OK)
@@ -609,17 +835,19 @@ namespace lzfse {
     {
         MANGO_UNREFERENCED_PARAMETER(level);
 
-        const size_t scratch_size = lzfse_encode_scratch_size();
-        Buffer scratch(scratch_size);
+        CompressionContext& context = CompressionContext::getThreadContext();
+        void* scratch = context.allocate(lzfse_encode_scratch_size());
         size_t written = lzfse_encode_buffer(dest.address, dest.size, source, source.size, scratch);
+        context.deallocate(scratch);
         return written;
     }
 
     void decompress(Memory dest, Memory source)
     {
-        const size_t scratch_size = lzfse_decode_scratch_size();
-        Buffer scratch(scratch_size);
+        CompressionContext& context = CompressionContext::getThreadContext();
+        void* scratch = context.allocate(lzfse_decode_scratch_size());
         size_t written = lzfse_decode_buffer(dest.address, dest.size, source, source.size, scratch);
+        context.deallocate(scratch);
         MANGO_UNREFERENCED_PARAMETER(written);
     }
 
@@ -684,10 +912,12 @@ namespace lzma
         SizeT dest_length = dest.size;
         SizeT source_length = source.size;
 
+        ContextAllocator allocator;
+
         SRes result = LzmaEncode(
             dest.address, &dest_length, source.address, source_length,
             &props, props_output, &props_output_size, 0,
-            nullptr, &g_Alloc, &g_Alloc);
+            nullptr, &allocator, &allocator);
 
         const char* error = get_error_string(result);
         if (error)
@@ -709,9 +939,11 @@ namespace lzma
         SizeT destLen = dest.size;
         SizeT srcLen = source.size;
 
+        ContextAllocator allocator;
+
         ELzmaStatus status;
         SRes result = LzmaDecode(dest.address, &destLen, source.address, &srcLen,
-            prop, LZMA_PROPS_SIZE, LZMA_FINISH_ANY, &status, &g_Alloc);
+            prop, LZMA_PROPS_SIZE, LZMA_FINISH_ANY, &status, &allocator);
 
         const char* error = get_error_string(result);
         if (error)
@@ -742,7 +974,8 @@ namespace lzma2
 
         level = clamp(level, 0, 10);
 
-        CLzma2EncHandle encoder = Lzma2Enc_Create(&g_Alloc, &g_Alloc);
+        ContextAllocator allocator;
+        CLzma2EncHandle encoder = Lzma2Enc_Create(&allocator, &allocator);
 
         Lzma2Enc_SetProps(encoder, &props);
         Byte p = Lzma2Enc_WriteProperties(encoder);
@@ -786,9 +1019,11 @@ namespace lzma2
         SizeT destLen = dest.size;
         SizeT srcLen = source.size;
 
+        ContextAllocator allocator;
+
         ELzmaStatus status;
         SRes result = Lzma2Decode(dest.address, &destLen, source.address, &srcLen,
-            prop, LZMA_FINISH_ANY, &status, &g_Alloc);
+            prop, LZMA_FINISH_ANY, &status, &allocator);
 
         const char* error = lzma::get_error_string(result);
         if (error)
@@ -0,0 +1,1525 @@
+/*
+    MANGO Multimedia Development Platform
+    Copyright (C) 2012-2019 Twilight Finland 3D Oy Ltd. All rights reserved.
+*/
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <exception>
+
+#include <mango/core/compress.hpp>
+#include <mango/core/exception.hpp>
+#include <mango/core/pointer.hpp>
+#include <mango/core/crc32.hpp>
+#include <mango/core/thread.hpp>
+
+#define MINIZ_NO_ZLIB_COMPATIBLE_NAMES
+#include "../../external/miniz/miniz.h"
+
+#ifdef MANGO_ENABLE_LICENSE_BSD
+#include "../../external/lz4/lz4.h"
+#include "../../external/lz4/lz4hc.h"
+#include "../../external/zstd/zstd.h"
+#include "../../external/zstd/common/xxhash.h"
+#endif
+
+#ifdef MANGO_ENABLE_LICENSE_ZLIB
+#include "../../external/bzip2/bzlib.h"
+#endif
+
+#include "../../external/lzma/Alloc.h"
+#include "../../external/lzma/7zCrc.h"
+#include "../../external/lzma/XzCrc64.h"
+#include "../../external/lzma/Xz.h"
+#include "../../external/lzma/XzEnc.h"
+
+#define ID "[CompressedStream] "
+
+namespace
+{
+    using namespace mango;
+
+    // uncompressed bytes collected before a block is handed to the encoder
+    constexpr size_t g_block_size = 1024 * 1024;
+
+    // temporary buffer for encoder output and decoder input
+    constexpr size_t g_io_size = 1024 * 64;
+
+    // ----------------------------------------------------------------------------
+    // InputBuffer
+    // ----------------------------------------------------------------------------
+
+    class InputBuffer
+    {
+    protected:
+        Stream& m_stream;
+        std::vector<u8> m_buffer;
+
+    public:
+        const u8* next;
+        size_t avail;
+
+        InputBuffer(Stream& stream)
+            : m_stream(stream)
+            , m_buffer(g_io_size)
+            , next(nullptr)
+            , avail(0)
+        {
+        }
+
+        // returns false when there is no more input
+        bool refill()
+        {
+            if (avail)
+                return true;
+
+            const u64 left = m_stream.size() - m_stream.offset();
+            if (!left)
+                return false;
+
+            const size_t bytes = size_t(std::min(u64(m_buffer.size()), left));
+            m_stream.read(m_buffer.data(), bytes);
+
+            next = m_buffer.data();
+            avail = bytes;
+            return true;
+        }
+
+        // copies the next bytes without consuming them; returns false when the input
+        // ends before them
+        bool peek(void* dest, size_t bytes)
+        {
+            if (avail < bytes)
+            {
+                // move the remaining input to the front of the buffer and read more after it
+                if (avail)
+                {
+                    std::memmove(m_buffer.data(), next, avail);
+                }
+
+                next = m_buffer.data();
+
+                const u64 left = m_stream.size() - m_stream.offset();
+                const size_t count = size_t(std::min(u64(m_buffer.size() - avail), left));
+                m_stream.read(m_buffer.data() + avail, count);
+                avail += count;
+
+                if (avail < bytes)
+                    return false;
+            }
+
+            std::memcpy(dest, next, bytes);
+            return true;
+        }
+
+        // returns the input which was read ahead but not consumed back to the stream
+        void rewind()
+        {
+            if (avail)
+            {
+                m_stream.seek(m_stream.offset() - avail, Stream::BEGIN);
+                avail = 0;
+            }
+        }
+
+        // returns consumed bytes which follow the compressed data back to the stream
+        void unread(size_t bytes)
+        {
+            rewind();
+            m_stream.seek(m_stream.offset() - bytes, Stream::BEGIN);
+        }
+
+        void consume(size_t bytes)
+        {
+            next += bytes;
+            avail -= bytes;
+        }
+
+        void read(void* dest, size_t bytes)
+        {
+            u8* d = reinterpret_cast<u8*>(dest);
+
+            while (bytes > 0)
+            {
+                if (!refill())
+                {
+                    MANGO_EXCEPTION(ID"Unexpected end of compressed data.");
+                }
+
+                const size_t n = std::min(bytes, avail);
+                std::memcpy(d, next, n);
+                consume(n);
+                d += n;
+                bytes -= n;
+            }
+        }
+
+        u8 read8()
+        {
+            u8 value;
+            read(&value, 1);
+            return value;
+        }
+
+        u32 read32le()
+        {
+            u8 temp[4];
+            read(temp, 4);
+            return uload32le(temp);
+        }
+    };
+
+} // namespace
+
+namespace mango
+{
+
+    struct CompressedOutputStream::Encoder
+    {
+        Stream& stream;
+
+        Encoder(Stream& stream)
+            : stream(stream)
+        {
+        }
+
+        virtual ~Encoder()
+        {
+        }
+
+        virtual void encode(Memory source) = 0;
+        virtual void finish() = 0;
+    };
+
+    struct CompressedInputStream::Decoder
+    {
+        InputBuffer input;
+
+        Decoder(Stream& stream)
+            : input(stream)
+        {
+        }
+
+        virtual ~Decoder()
+        {
+        }
+
+        // returns zero at the end of data
+        virtual size_t decode(u8* dest, size_t size) = 0;
+    };
+
+} // namespace mango
+
+namespace
+{
+    using namespace mango;
+
+    // ----------------------------------------------------------------------------
+    // deflate
+    // ----------------------------------------------------------------------------
+
+    // gzip member header (RFC 1952)
+    static const u8 g_gzip_header [] =
+    {
+        0x1f, 0x8b, // magic
+        0x08,       // deflate
+        0x00,       // flags
+        0x00, 0x00, 0x00, 0x00, // modification time
+        0x00,       // extra flags
+        0xff,       // operating system: unknown
+    };
+
+    struct DeflateEncoder : CompressedOutputStream::Encoder
+    {
+        mz_stream z;
+        bool gzip;
+        u32 crc;
+        u32 isize;
+        std::vector<u8> output;
+
+        DeflateEncoder(Stream& stream, int level, bool gzip)
+            : Encoder(stream)
+            , gzip(gzip)
+            , crc(0)
+            , isize(0)
+            , output(g_io_size)
+        {
+            std::memset(&z, 0, sizeof(z));
+
+            level = clamp(level, 0, 10);
+            const int window_bits = gzip ? -MZ_DEFAULT_WINDOW_BITS : MZ_DEFAULT_WINDOW_BITS;
+
+            if (mz_deflateInit2(&z, level, MZ_DEFLATED, window_bits, 9, MZ_DEFAULT_STRATEGY) != MZ_OK)
+            {
+                MANGO_EXCEPTION(ID"[deflate] compression init failed.");
+            }
+
+            if (gzip)
+            {
+                stream.write(g_gzip_header, sizeof(g_gzip_header));
+            }
+        }
+
+        ~DeflateEncoder()
+        {
+            mz_deflateEnd(&z);
+        }
+
+        int deflate(int flush)
+        {
+            z.next_out = output.data();
+            z.avail_out = static_cast<unsigned int>(output.size());
+
+            int status = mz_deflate(&z, flush);
+            if (status < 0 && status != MZ_BUF_ERROR)
+            {
+                MANGO_EXCEPTION(ID"[deflate] compression failed.");
+            }
+
+            stream.write(output.data(), output.size() - z.avail_out);
+            return status;
+        }
+
+        void encode(Memory source) override
+        {
+            if (gzip)
+            {
+                crc = crc32(crc, source);
+                isize += u32(source.size);
+            }
+
+            z.next_in = source.address;
+            z.avail_in = static_cast<unsigned int>(source.size);
+
+            while (z.avail_in > 0)
+            {
+                deflate(MZ_NO_FLUSH);
+            }
+        }
+
+        void finish() override
+        {
+            z.next_in = nullptr;
+            z.avail_in = 0;
+
+            while (deflate(MZ_FINISH) != MZ_STREAM_END)
+            {
+            }
+
+            if (gzip)
+            {
+                u8 trailer[8];
+                ustore32le(trailer + 0, crc);
+                ustore32le(trailer + 4, isize);
+                stream.write(trailer, 8);
+            }
+        }
+    };
+
+    struct DeflateDecoder : CompressedInputStream::Decoder
+    {
+        mz_stream z;
+        bool gzip;
+        bool active;
+        u32 crc;
+        u32 isize;
+
+        DeflateDecoder(Stream& stream, bool gzip)
+            : Decoder(stream)
+            , gzip(gzip)
+            , active(false)
+            , crc(0)
+            , isize(0)
+        {
+            std::memset(&z, 0, sizeof(z));
+        }
+
+        ~DeflateDecoder()
+        {
+            if (active)
+            {
+                mz_inflateEnd(&z);
+            }
+        }
+
+        void readGzipHeader()
+        {
+            u8 header[10];
+            input.read(header, 10);
+
+            if (header[0] != 0x1f || header[1] != 0x8b || header[2] != 0x08)
+            {
+                MANGO_EXCEPTION(ID"[gzip] Incorrect header.");
+            }
+
+            const u8 flags = header[3];
+
+            if (flags & 0x04)
+            {
+                // FEXTRA
+                u8 temp[2];
+                input.read(temp, 2);
+                std::vector<u8> extra(uload16le(temp));
+                input.read(extra.data(), extra.size());
+            }
+
+            if (flags & 0x08)
+            {
+                // FNAME
+                while (input.read8())
+                    ;
+            }
+
+            if (flags & 0x10)
+            {
+                // FCOMMENT
+                while (input.read8())
+                    ;
+            }
+
+            if (flags & 0x02)
+            {
+                // FHCRC
+                u8 temp[2];
+                input.read(temp, 2);
+            }
+        }
+
+        void begin()
+        {
+            if (gzip)
+            {
+                readGzipHeader();
+                crc = 0;
+                isize = 0;
+            }
+
+            const int window_bits = gzip ? -MZ_DEFAULT_WINDOW_BITS : MZ_DEFAULT_WINDOW_BITS;
+            if (mz_inflateInit2(&z, window_bits) != MZ_OK)
+            {
+                MANGO_EXCEPTION(ID"[deflate] decompression init failed.");
+            }
+
+            active = true;
+        }
+
+        void end()
+        {
+            mz_inflateEnd(&z);
+            active = false;
+
+            if (gzip)
+            {
+                const u32 expected_crc = input.read32le();
+                const u32 expected_size = input.read32le();
+                if (crc != expected_crc || isize != expected_size)
+                {
+                    MANGO_EXCEPTION(ID"[gzip] CRC mismatch.");
+                }
+            }
+        }
+
+        size_t decode(u8* dest, size_t size) override
+        {
+            size_t total = 0;
+
+            while (total < size)
+            {
+                if (!active)
+                {
+                    // gzip files can have multiple members
+                    if (!input.refill() || (!gzip && z.total_in))
+                        break;
+                    begin();
+                }
+
+                if (!input.avail && !input.refill())
+                {
+                    MANGO_EXCEPTION(ID"[deflate] Unexpected end of compressed data.");
+                }
+
+                z.next_in = input.next;
+                z.avail_in = static_cast<unsigned int>(input.avail);
+                z.next_out = dest + total;
+                z.avail_out = static_cast<unsigned int>(size - total);
+
+                int status = mz_inflate(&z, MZ_NO_FLUSH);
+                if (status < 0 && status != MZ_BUF_ERROR)
+                {
+                    MANGO_EXCEPTION(ID"[deflate] Corrupted input data.");
+                }
+
+                const size_t produced = (size - total) - z.avail_out;
+                input.consume(input.avail - z.avail_in);
+
+                if (gzip)
+                {
+                    crc = crc32(crc, Memory(dest + total, produced));
+                    isize += u32(produced);
+                }
+
+                total += produced;
+
+                if (status == MZ_STREAM_END)
+                {
+                    end();
+                }
+            }
+
+            return total;
+        }
+    };
+
+#ifdef MANGO_ENABLE_LICENSE_BSD
+
+    // ----------------------------------------------------------------------------
+    // zstd
+    // ----------------------------------------------------------------------------
+
+    struct ZstdEncoder : CompressedOutputStream::Encoder
+    {
+        ZSTD_CStream* z;
+        std::vector<u8> output;
+
+        ZstdEncoder(Stream& stream, int level)
+            : Encoder(stream)
+            , output(ZSTD_CStreamOutSize())
+        {
+            level = clamp(level * 2, 1, 20);
+            z = ZSTD_createCStream();
+            ZSTD_initCStream(z, level);
+        }
+
+        ~ZstdEncoder()
+        {
+            ZSTD_freeCStream(z);
+        }
+
+        void encode(Memory source) override
+        {
+            ZSTD_inBuffer in = { source.address, source.size, 0 };
+
+            while (in.pos < in.size)
+            {
+                ZSTD_outBuffer out = { output.data(), output.size(), 0 };
+                size_t x = ZSTD_compressStream(z, &out, &in);
+                if (ZSTD_isError(x))
+                {
+                    MANGO_EXCEPTION(ID"[zstd] %s", ZSTD_getErrorName(x));
+                }
+                stream.write(output.data(), out.pos);
+            }
+        }
+
+        void finish() override
+        {
+            for (;;)
+            {
+                ZSTD_outBuffer out = { output.data(), output.size(), 0 };
+                size_t remaining = ZSTD_endStream(z, &out);
+                if (ZSTD_isError(remaining))
+                {
+                    MANGO_EXCEPTION(ID"[zstd] %s", ZSTD_getErrorName(remaining));
+                }
+                stream.write(output.data(), out.pos);
+                if (!remaining)
+                    break;
+            }
+        }
+    };
+
+    struct ZstdDecoder : CompressedInputStream::Decoder
+    {
+        ZSTD_DStream* z;
+        bool frame_complete;
+
+        ZstdDecoder(Stream& stream)
+            : Decoder(stream)
+            , frame_complete(true)
+        {
+            z = ZSTD_createDStream();
+            ZSTD_initDStream(z);
+        }
+
+        ~ZstdDecoder()
+        {
+            ZSTD_freeDStream(z);
+        }
+
+        size_t decode(u8* dest, size_t size) override
+        {
+            size_t total = 0;
+
+            while (total < size)
+            {
+                const bool more = input.refill();
+                if (!more && frame_complete)
+                    break;
+
+                ZSTD_inBuffer in = { input.next, input.avail, 0 };
+                ZSTD_outBuffer out = { dest + total, size - total, 0 };
+
+                size_t x = ZSTD_decompressStream(z, &out, &in);
+                if (ZSTD_isError(x))
+                {
+                    MANGO_EXCEPTION(ID"[zstd] %s", ZSTD_getErrorName(x));
+                }
+
+                input.consume(in.pos);
+                total += out.pos;
+                frame_complete = (x == 0);
+
+                if (!more && !out.pos && !frame_complete)
+                {
+                    MANGO_EXCEPTION(ID"[zstd] Unexpected end of compressed data.");
+                }
+            }
+
+            return total;
+        }
+    };
+
+    // ----------------------------------------------------------------------------
+    // lz4 frame
+    // ----------------------------------------------------------------------------
+
+    // https://github.com/lz4/lz4/blob/dev/doc/lz4_Frame_format.md
+
+    constexpr u32 LZ4_FRAME_MAGIC = 0x184d2204;
+    constexpr size_t LZ4_FRAME_BLOCK_SIZE = 1024 * 64;
+    constexpr size_t LZ4_FRAME_WINDOW_SIZE = 1024 * 64;
+
+    struct LZ4Encoder : CompressedOutputStream::Encoder
+    {
+        int level;
+        std::vector<u8> output;
+
+        LZ4Encoder(Stream& stream, int level)
+            : Encoder(stream)
+            , level(clamp(level, 0, 10))
+            , output(4 + LZ4_compressBound(int(LZ4_FRAME_BLOCK_SIZE)))
+        {
+            u8 header[7];
+            ustore32le(header, LZ4_FRAME_MAGIC);
+            header[4] = 0x60; // version 01, independent blocks, no checksums
+            header[5] = 0x40; // maximum block size: 64 KB
+            header[6] = u8(XXH32(header + 4, 2, 0) >> 8);
+            stream.write(header, 7);
+        }
+
+        void encode(Memory source) override
+        {
+            while (source.size > 0)
+            {
+                const int block_size = int(std::min(source.size, LZ4_FRAME_BLOCK_SIZE));
+
+                const char* src = reinterpret_cast<const char*>(source.address);
+                char* dst = reinterpret_cast<char*>(output.data() + 4);
+                const int capacity = int(output.size() - 4);
+
+                int bytes;
+                if (level > 6)
+                {
+                    const int compression_level = 1 + (level - 7) * 5;
+                    bytes = LZ4_compress_HC(src, dst, block_size, capacity, compression_level);
+                }
+                else
+                {
+                    const int acceleration = 19 - level * 3;
+                    bytes = LZ4_compress_fast(src, dst, block_size, capacity, acceleration);
+                }
+
+                if (bytes > 0 && bytes < block_size)
+                {
+                    ustore32le(output.data(), u32(bytes));
+                    stream.write(output.data(), 4 + bytes);
+                }
+                else
+                {
+                    // incompressible block is stored as-is
+                    ustore32le(output.data(), u32(block_size) | 0x80000000);
+                    stream.write(output.data(), 4);
+                    stream.write(source.address, block_size);
+                }
+
+                source.address += block_size;
+                source.size -= block_size;
+            }
+        }
+
+        void finish() override
+        {
+            u8 endmark[4] = { 0, 0, 0, 0 };
+            stream.write(endmark, 4);
+        }
+    };
+
+    struct LZ4Decoder : CompressedInputStream::Decoder
+    {
+        bool in_frame;
+        bool block_checksum;
+        bool content_checksum;
+        size_t block_maxsize;
+
+        // decoding window: [history | current block]
+        std::vector<u8> window;
+        std::vector<u8> compressed;
+        size_t history;
+        size_t block_offset;
+        size_t block_size;
+
+        LZ4Decoder(Stream& stream)
+            : Decoder(stream)
+            , in_frame(false)
+            , block_checksum(false)
+            , content_checksum(false)
+            , block_maxsize(0)
+            , history(0)
+            , block_offset(0)
+            , block_size(0)
+        {
+        }
+
+        void readFrameHeader()
+        {
+            if (input.read32le() != LZ4_FRAME_MAGIC)
+            {
+                MANGO_EXCEPTION(ID"[lz4] Incorrect frame header.");
+            }
+
+            u8 descriptor[15];
+            descriptor[0] = input.read8();
+            descriptor[1] = input.read8();
+
+            const u8 flags = descriptor[0];
+            if ((flags >> 6) != 1)
+            {
+                MANGO_EXCEPTION(ID"[lz4] Unsupported frame version.");
+            }
+
+            size_t length = 2;
+            if (flags & 0x08)
+            {
+                // content size
+                input.read(descriptor + length, 8);
+                length += 8;
+            }
+
+            if (flags & 0x01)
+            {
+                // dictionary id
+                input.read(descriptor + length, 4);
+                length += 4;
+            }
+
+            const u8 checksum = input.read8();
+            if (checksum != u8(XXH32(descriptor, length, 0) >> 8))
+            {
+                MANGO_EXCEPTION(ID"[lz4] Frame header checksum mismatch.");
+            }
+
+            block_checksum = (flags & 0x10) != 0;
+            content_checksum = (flags & 0x04) != 0;
+
+            const int bd = (descriptor[1] >> 4) & 7;
+            if (bd < 4)
+            {
+                MANGO_EXCEPTION(ID"[lz4] Incorrect maximum block size.");
+            }
+
+            block_maxsize = size_t(1) << (bd * 2 + 8);
+            window.resize(LZ4_FRAME_WINDOW_SIZE + block_maxsize);
+            history = 0;
+            in_frame = true;
+        }
+
+        // returns false at the end of the frame
+        bool readBlock()
+        {
+            const u32 header = input.read32le();
+            if (!header)
+            {
+                if (content_checksum)
+                {
+                    input.read32le();
+                }
+                in_frame = false;
+                return false;
+            }
+
+            const size_t size = header & 0x7fffffff;
+            if (size > block_maxsize)
+            {
+                MANGO_EXCEPTION(ID"[lz4] Incorrect block size.");
+            }
+
+            u8* dest = window.data() + history;
+
+            if (header & 0x80000000)
+            {
+                input.read(dest, size);
+                block_size = size;
+            }
+            else
+            {
+                compressed.resize(size);
+                input.read(compressed.data(), size);
+
+                // history is directly before the destination; lz4 uses it as prefix
+                int bytes = LZ4_decompress_safe_usingDict(
+                    reinterpret_cast<const char*>(compressed.data()),
+                    reinterpret_cast<char*>(dest), int(size), int(block_maxsize),
+                    reinterpret_cast<const char*>(window.data()), int(history));
+                if (bytes < 0)
+                {
+                    MANGO_EXCEPTION(ID"[lz4] Corrupted input data.");
+                }
+                block_size = size_t(bytes);
+            }
+
+            if (block_checksum)
+            {
+                input.read32le();
+            }
+
+            block_offset = history;
+            return true;
+        }
+
+        void retireBlock()
+        {
+            // keep the last 64 KB of decoded data as history for linked blocks
+            const size_t total = history + block_size;
+            const size_t keep = std::min(total, LZ4_FRAME_WINDOW_SIZE);
+            std::memmove(window.data(), window.data() + total - keep, keep);
+            history = keep;
+            block_size = 0;
+            block_offset = history;
+        }
+
+        size_t decode(u8* dest, size_t size) override
+        {
+            size_t total = 0;
+
+            while (total < size)
+            {
+                const size_t available = history + block_size - block_offset;
+                if (available)
+                {
+                    const size_t n = std::min(available, size - total);
+                    std::memcpy(dest + total, window.data() + block_offset, n);
+                    block_offset += n;
+                    total += n;
+                    continue;
+                }
+
+                if (block_size)
+                {
+                    retireBlock();
+                }
+
+                if (!in_frame)
+                {
+                    // frames can be concatenated
+                    if (!input.refill())
+                        break;
+                    readFrameHeader();
+                }
+
+                readBlock();
+            }
+
+            return total;
+        }
+    };
+
+#endif // MANGO_ENABLE_LICENSE_BSD
+
+#ifdef MANGO_ENABLE_LICENSE_ZLIB
+
+    // ----------------------------------------------------------------------------
+    // bzip2
+    // ----------------------------------------------------------------------------
+
+    struct Bzip2Encoder : CompressedOutputStream::Encoder
+    {
+        bz_stream z;
+        std::vector<u8> output;
+
+        Bzip2Encoder(Stream& stream, int level)
+            : Encoder(stream)
+            , output(g_io_size)
+        {
+            std::memset(&z, 0, sizeof(z));
+
+            const int blockSize100k = clamp(level, 1, 9);
+            if (BZ2_bzCompressInit(&z, blockSize100k, 0, 30) != BZ_OK)
+            {
+                MANGO_EXCEPTION(ID"[bzip2] compression init failed.");
+            }
+        }
+
+        ~Bzip2Encoder()
+        {
+            BZ2_bzCompressEnd(&z);
+        }
+
+        int compress(int action)
+        {
+            z.next_out = reinterpret_cast<char*>(output.data());
+            z.avail_out = static_cast<unsigned int>(output.size());
+
+            int status = BZ2_bzCompress(&z, action);
+            if (status < 0)
+            {
+                MANGO_EXCEPTION(ID"[bzip2] compression failed.");
+            }
+
+            stream.write(output.data(), output.size() - z.avail_out);
+            return status;
+        }
+
+        void encode(Memory source) override
+        {
+            z.next_in = reinterpret_cast<char*>(source.address);
+            z.avail_in = static_cast<unsigned int>(source.size);
+
+            while (z.avail_in > 0)
+            {
+                compress(BZ_RUN);
+            }
+        }
+
+        void finish() override
+        {
+            while (compress(BZ_FINISH) != BZ_STREAM_END)
+            {
+            }
+        }
+    };
+
+    struct Bzip2Decoder : CompressedInputStream::Decoder
+    {
+        bz_stream z;
+        bool complete;
+
+        Bzip2Decoder(Stream& stream)
+            : Decoder(stream)
+            , complete(false)
+        {
+            begin();
+        }
+
+        void begin()
+        {
+            std::memset(&z, 0, sizeof(z));
+
+            if (BZ2_bzDecompressInit(&z, 0, 0) != BZ_OK)
+            {
+                MANGO_EXCEPTION(ID"[bzip2] decompression init failed.");
+            }
+        }
+
+        ~Bzip2Decoder()
+        {
+            BZ2_bzDecompressEnd(&z);
+        }
+
+        bool isStreamHeader()
+        {
+            // "BZh" followed by the block size '1' .. '9'
+            u8 header[4];
+            return input.peek(header, 4) &&
+                   header[0] == 'B' && header[1] == 'Z' && header[2] == 'h' &&
+                   header[3] >= '1' && header[3] <= '9';
+        }
+
+        size_t decode(u8* dest, size_t size) override
+        {
+            size_t total = 0;
+
+            while (total < size)
+            {
+                if (complete)
+                {
+                    // concatenated streams are decoded as one; the data which does not start
+                    // with a stream header is left in the input
+                    if (!isStreamHeader())
+                        break;
+
+                    BZ2_bzDecompressEnd(&z);
+                    begin();
+                    complete = false;
+                }
+
+                if (!input.refill())
+                {
+                    MANGO_EXCEPTION(ID"[bzip2] Unexpected end of compressed data.");
+                }
+
+                z.next_in = const_cast<char*>(reinterpret_cast<const char*>(input.next));
+                z.avail_in = static_cast<unsigned int>(input.avail);
+                z.next_out = reinterpret_cast<char*>(dest + total);
+                z.avail_out = static_cast<unsigned int>(size - total);
+
+                int status = BZ2_bzDecompress(&z);
+                if (status != BZ_OK && status != BZ_STREAM_END)
+                {
+                    MANGO_EXCEPTION(ID"[bzip2] Corrupted input data.");
+                }
+
+                input.consume(input.avail - z.avail_in);
+                total += (size - total) - z.avail_out;
+                complete = (status == BZ_STREAM_END);
+            }
+
+            return total;
+        }
+    };
+
+#endif // MANGO_ENABLE_LICENSE_ZLIB
+
+    // ----------------------------------------------------------------------------
+    // xz
+    // ----------------------------------------------------------------------------
+
+    void init_xz_tables()
+    {
+        static std::once_flag flag;
+        std::call_once(flag, [] {
+            CrcGenerateTable();
+            Crc64GenerateTable();
+        });
+    }
+
+    // The lzma-sdk xz encoder pulls its input through a callback, so it runs in
+    // a dedicated thread; encode() hands over one block at a time and waits until
+    // the encoder has consumed it, which keeps the memory use bounded.
+
+    struct XzEncoder : CompressedOutputStream::Encoder
+    {
+        struct Reader : ISeqInStream
+        {
+            XzEncoder* encoder;
+        } reader;
+
+        struct Writer : ISeqOutStream
+        {
+            XzEncoder* encoder;
+        } writer;
+
+        std::mutex mutex;
+        std::condition_variable condition;
+        std::thread thread;
+
+        Memory pending;
+        bool eof;
+        bool done;
+        SRes result;
+        std::exception_ptr exception;
+
+        XzEncoder(Stream& stream, int level)
+            : Encoder(stream)
+            , eof(false)
+            , done(false)
+            , result(SZ_OK)
+        {
+            init_xz_tables();
+
+            reader.Read = read;
+            reader.encoder = this;
+            writer.Write = write;
+            writer.encoder = this;
+
+            CXzProps props;
+            XzProps_Init(&props);
+            props.lzma2Props.lzmaProps.level = clamp(level - 1, 0, 9);
+            props.checkId = XZ_CHECK_CRC32;
+
+            thread = std::thread([this, props] {
+                SRes status = Xz_Encode(&writer, &reader, &props, nullptr);
+                std::unique_lock<std::mutex> lock(mutex);
+                result = status;
+                done = true;
+                condition.notify_all();
+            });
+        }
+
+        ~XzEncoder()
+        {
+            if (thread.joinable())
+            {
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    eof = true;
+                    condition.notify_all();
+                }
+                thread.join();
+            }
+        }
+
+        static SRes read(const ISeqInStream* p, void* buf, size_t* size)
+        {
+            XzEncoder* encoder = static_cast<const Reader*>(p)->encoder;
+
+            std::unique_lock<std::mutex> lock(encoder->mutex);
+            encoder->condition.wait(lock, [encoder] {
+                return encoder->pending.size > 0 || encoder->eof;
+            });
+
+            const size_t bytes = std::min(*size, encoder->pending.size);
+            std::memcpy(buf, encoder->pending.address, bytes);
+            encoder->pending.address += bytes;
+            encoder->pending.size -= bytes;
+            *size = bytes;
+
+            if (!encoder->pending.size)
+            {
+                encoder->condition.notify_all();
+            }
+
+            return SZ_OK;
+        }
+
+        static size_t write(const ISeqOutStream* p, const void* buf, size_t size)
+        {
+            XzEncoder* encoder = static_cast<const Writer*>(p)->encoder;
+
+            try
+            {
+                encoder->stream.write(buf, size);
+            }
+            catch (...)
+            {
+                encoder->exception = std::current_exception();
+                return 0;
+            }
+
+            return size;
+        }
+
+        void check()
+        {
+            if (exception)
+            {
+                std::rethrow_exception(exception);
+            }
+
+            if (result != SZ_OK)
+            {
+                MANGO_EXCEPTION(ID"[xz] compression failed.");
+            }
+        }
+
+        void encode(Memory source) override
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            pending = source;
+            condition.notify_all();
+            condition.wait(lock, [this] {
+                return pending.size == 0 || done;
+            });
+
+            if (done)
+            {
+                check();
+            }
+        }
+
+        void finish() override
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                eof = true;
+                condition.notify_all();
+            }
+
+            thread.join();
+            check();
+        }
+    };
+
+    struct XzDecoder : CompressedInputStream::Decoder
+    {
+        CXzUnpacker unpacker;
+        bool complete;
+
+        XzDecoder(Stream& stream)
+            : Decoder(stream)
+            , complete(false)
+        {
+            init_xz_tables();
+            XzUnpacker_Construct(&unpacker, &g_Alloc);
+            XzUnpacker_Init(&unpacker);
+        }
+
+        ~XzDecoder()
+        {
+            XzUnpacker_Free(&unpacker);
+        }
+
+        size_t decode(u8* dest, size_t size) override
+        {
+            size_t total = 0;
+
+            while (total < size && !complete)
+            {
+                const bool more = input.refill();
+
+                SizeT dest_length = size - total;
+                SizeT source_length = input.avail;
+
+                ECoderStatus status;
+                SRes result = XzUnpacker_Code(&unpacker, dest + total, &dest_length,
+                    input.next, &source_length, !more, CODER_FINISH_ANY, &status);
+
+                input.consume(source_length);
+                total += dest_length;
+
+                if (result != SZ_OK)
+                {
+                    if (!unpacker.numFinishedStreams)
+                    {
+                        MANGO_EXCEPTION(ID"[xz] Corrupted input data.");
+                    }
+
+                    // the data after the last stream is not xz; the bytes which the
+                    // unpacker took as padding or as the next stream header are returned
+                    input.unread(size_t(XzUnpacker_GetExtraSize(&unpacker)));
+                    complete = true;
+                    break;
+                }
+
+                if (!more)
+                {
+                    if (XzUnpacker_IsStreamWasFinished(&unpacker))
+                    {
+                        complete = true;
+                    }
+                    else if (!dest_length)
+                    {
+                        MANGO_EXCEPTION(ID"[xz] Unexpected end of compressed data.");
+                    }
+                }
+            }
+
+            return total;
+        }
+    };
+
+} // namespace
+
+namespace mango
+{
+
+    // ----------------------------------------------------------------------------
+    // CompressedOutputStream
+    // ----------------------------------------------------------------------------
+
+    struct CompressedOutputStream::Worker
+    {
+        SerialQueue queue;
+        std::vector<u8> buffer;
+        std::exception_ptr exception;
+
+        Worker()
+            : queue("compressed.stream")
+        {
+        }
+
+        void wait()
+        {
+            queue.wait();
+            if (exception)
+            {
+                std::exception_ptr e = exception;
+                exception = nullptr;
+                std::rethrow_exception(e);
+            }
+        }
+    };
+
+    CompressedOutputStream::CompressedOutputStream(Stream& stream, CompressedFormat format, int level, bool background)
+        : m_encoder(nullptr)
+        , m_worker(nullptr)
+        , m_size(0)
+        , m_finished(false)
+    {
+        switch (format)
+        {
+            case CompressedFormat::ZLIB:
+                m_encoder = new DeflateEncoder(stream, level, false);
+                break;
+            case CompressedFormat::GZIP:
+                m_encoder = new DeflateEncoder(stream, level, true);
+                break;
+#ifdef MANGO_ENABLE_LICENSE_BSD
+            case CompressedFormat::LZ4:
+                m_encoder = new LZ4Encoder(stream, level);
+                break;
+            case CompressedFormat::ZSTD:
+                m_encoder = new ZstdEncoder(stream, level);
+                break;
+#endif
+#ifdef MANGO_ENABLE_LICENSE_ZLIB
+            case CompressedFormat::BZIP2:
+                m_encoder = new Bzip2Encoder(stream, level);
+                break;
+#endif
+            case CompressedFormat::XZ:
+                m_encoder = new XzEncoder(stream, level);
+                break;
+        }
+
+        m_buffer.reserve(g_block_size);
+
+        if (background)
+        {
+            m_worker = new Worker();
+            m_worker->buffer.reserve(g_block_size);
+        }
+    }
+
+    CompressedOutputStream::~CompressedOutputStream()
+    {
+        try
+        {
+            finish();
+        }
+        catch (...)
+        {
+            // call finish() explicitly to receive the errors
+        }
+
+        delete m_worker;
+        delete m_encoder;
+    }
+
+    void CompressedOutputStream::flush()
+    {
+        if (!m_buffer.size())
+            return;
+
+        if (m_worker)
+        {
+            // wait for the previous block and swap buffers with the worker
+            m_worker->wait();
+
+            std::swap(m_buffer, m_worker->buffer);
+            m_buffer.clear();
+
+            Worker* worker = m_worker;
+            Encoder* encoder = m_encoder;
+
+            worker->queue.enqueue([worker, encoder] {
+                try
+                {
+                    encoder->encode(Memory(worker->buffer.data(), worker->buffer.size()));
+                }
+                catch (...)
+                {
+                    worker->exception = std::current_exception();
+                }
+            });
+        }
+        else
+        {
+            m_encoder->encode(Memory(m_buffer.data(), m_buffer.size()));
+            m_buffer.clear();
+        }
+    }
+
+    void CompressedOutputStream::finish()
+    {
+        if (m_finished)
+            return;
+
+        m_finished = true;
+
+        flush();
+
+        if (m_worker)
+        {
+            m_worker->wait();
+        }
+
+        m_encoder->finish();
+    }
+
+    u64 CompressedOutputStream::size() const
+    {
+        return m_size;
+    }
+
+    u64 CompressedOutputStream::offset() const
+    {
+        return m_size;
+    }
+
+    void CompressedOutputStream::seek(u64 distance, SeekMode mode)
+    {
+        MANGO_UNREFERENCED_PARAMETER(distance);
+        MANGO_UNREFERENCED_PARAMETER(mode);
+        MANGO_EXCEPTION(ID"CompressedOutputStream does not support seeking.");
+    }
+
+    void CompressedOutputStream::read(void* dest, size_t size)
+    {
+        MANGO_UNREFERENCED_PARAMETER(dest);
+        MANGO_UNREFERENCED_PARAMETER(size);
+        MANGO_EXCEPTION(ID"CompressedOutputStream does not support reading.");
+    }
+
+    void CompressedOutputStream::write(const void* data, size_t size)
+    {
+        if (m_finished)
+        {
+            MANGO_EXCEPTION(ID"Writing into finished stream.");
+        }
+
+        const u8* source = reinterpret_cast<const u8*>(data);
+        m_size += size;
+
+        while (size > 0)
+        {
+            const size_t left = g_block_size - m_buffer.size();
+            const size_t bytes = std::min(size, left);
+
+            m_buffer.insert(m_buffer.end(), source, source + bytes);
+            source += bytes;
+            size -= bytes;
+
+            if (m_buffer.size() == g_block_size)
+            {
+                flush();
+            }
+        }
+    }
+
+    // ----------------------------------------------------------------------------
+    // CompressedInputStream
+    // ----------------------------------------------------------------------------
+
+    CompressedInputStream::CompressedInputStream(Stream& stream, CompressedFormat format)
+        : m_decoder(nullptr)
+        , m_offset(0)
+    {
+        switch (format)
+        {
+            case CompressedFormat::ZLIB:
+                m_decoder = new DeflateDecoder(stream, false);
+                break;
+            case CompressedFormat::GZIP:
+                m_decoder = new DeflateDecoder(stream, true);
+                break;
+#ifdef MANGO_ENABLE_LICENSE_BSD
+            case CompressedFormat::LZ4:
+                m_decoder = new LZ4Decoder(stream);
+                break;
+            case CompressedFormat::ZSTD:
+                m_decoder = new ZstdDecoder(stream);
+                break;
+#endif
+#ifdef MANGO_ENABLE_LICENSE_ZLIB
+            case CompressedFormat::BZIP2:
+                m_decoder = new Bzip2Decoder(stream);
+                break;
+#endif
+            case CompressedFormat::XZ:
+                m_decoder = new XzDecoder(stream);
+                break;
+        }
+    }
+
+    CompressedInputStream::~CompressedInputStream()
+    {
+        try
+        {
+            // leave the stream at the end of the compressed data
+            m_decoder->input.rewind();
+        }
+        catch (...)
+        {
+        }
+
+        delete m_decoder;
+    }
+
+    size_t CompressedInputStream::readsome(void* dest, size_t size)
+    {
+        size_t bytes = m_decoder->decode(reinterpret_cast<u8*>(dest), size);
+        if (!bytes && size)
+        {
+            m_decoder->input.rewind();
+        }
+        m_offset += bytes;
+        return bytes;
+    }
+
+    u64 CompressedInputStream::size() const
+    {
+        return m_offset;
+    }
+
+    u64 CompressedInputStream::offset() const
+    {
+        return m_offset;
+    }
+
+    void CompressedInputStream::seek(u64 distance, SeekMode mode)
+    {
+        u64 skip = 0;
+
+        switch (mode)
+        {
+            case BEGIN:
+                if (distance < m_offset)
+                {
+                    MANGO_EXCEPTION(ID"CompressedInputStream cannot seek backwards.");
+                }
+                skip = distance - m_offset;
+                break;
+
+            case CURRENT:
+                skip = distance;
+                break;
+
+            case END:
+                MANGO_EXCEPTION(ID"CompressedInputStream cannot seek from the end.");
+                break;
+        }
+
+        u8 temp[1024 * 4];
+
+        while (skip > 0)
+        {
+            const size_t bytes = size_t(std::min(skip, u64(sizeof(temp))));
+            read(temp, bytes);
+            skip -= bytes;
+        }
+    }
+
+    void CompressedInputStream::read(void* dest, size_t size)
+    {
+        u8* d = reinterpret_cast<u8*>(dest);
+
+        while (size > 0)
+        {
+            size_t bytes = readsome(d, size);
+            if (!bytes)
+            {
+                MANGO_EXCEPTION(ID"Reading past end of stream.");
+            }
+            d += bytes;
+            size -= bytes;
+        }
+    }
+
+    void CompressedInputStream::write(const void* data, size_t size)
+    {
+        MANGO_UNREFERENCED_PARAMETER(data);
+        MANGO_UNREFERENCED_PARAMETER(size);
+        MANGO_EXCEPTION(ID"CompressedInputStream does not support writing.");
+    }
+
+} // namespace mango
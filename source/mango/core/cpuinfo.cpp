@@ -3,6 +3,8 @@
     Copyright (C) 2012-2019 Twilight Finland 3D Oy Ltd. All rights reserved.
 */
 #include <algorithm>
+#include <cstdlib>
+#include <string>
 #include <mango/core/cpuinfo.hpp>
 
 namespace
@@ -45,6 +47,22 @@ namespace
 
 #endif
 
+    // ----------------------------------------------------------------------------
+    // xgetbv()
+    // ----------------------------------------------------------------------------
+
+    u64 xgetbv()
+    {
+#if defined(MANGO_PLATFORM_WINDOWS)
+        return _xgetbv(0);
+#else
+        u32 eax;
+        u32 edx;
+        __asm__ volatile ("xgetbv" : "=a" (eax), "=d" (edx) : "c" (0));
+        return (u64(edx) << 32) | eax;
+#endif
+    }
+
 	// ----------------------------------------------------------------------------
 	// getCPUFlagsInternal()
 	// ----------------------------------------------------------------------------
@@ -52,6 +70,7 @@ namespace
     u64 getCPUFlagsInternal()
     {
         u64 flags = 0;
+        bool osxsave = false;
 
 		int cpuInfo[4] = { 0, 0, 0, 0 };
 
@@ -92,6 +111,7 @@ namespace
                     if ((cpuInfo[2] & 0x20000000) != 0) flags |= CPU_F16C;
                     if ((cpuInfo[2] & 0x40000000) != 0) flags |= CPU_RDRAND;
                     if ((cpuInfo[2] & 0x00002000) != 0) flags |= CPU_CMPXCHG16B;
+                    if ((cpuInfo[2] & 0x08000000) != 0) osxsave = true;
                     break;
                 case 7:
                     // ebx
@@ -134,6 +154,25 @@ namespace
             }
         }
 
+        // The CPU can support AVX while the OS does not save the register state
+        const u64 avx_flags = CPU_AVX | CPU_AVX2 | CPU_FMA3 | CPU_F16C | CPU_FMA4 | CPU_XOP;
+        const u64 avx512_flags = CPU_AVX512F | CPU_AVX512PFI | CPU_AVX512ERI | CPU_AVX512CDI |
+            CPU_AVX512BW | CPU_AVX512VL | CPU_AVX512DQ | CPU_AVX512IFMA | CPU_AVX512VBMI;
+
+        u64 xcr0 = osxsave ? xgetbv() : 0;
+
+        if ((xcr0 & 0x06) != 0x06)
+        {
+            // XMM and YMM state
+            flags &= ~(avx_flags | avx512_flags);
+        }
+
+        if ((xcr0 & 0xe0) != 0xe0)
+        {
+            // opmask and ZMM state
+            flags &= ~avx512_flags;
+        }
+
 		return flags;
 	}
 
@@ -204,6 +243,125 @@ namespace
         return flags;
     }
 
+#elif defined(MANGO_CPU_ARM) && defined(MANGO_PLATFORM_LINUX)
+
+#include <sys/auxv.h>
+
+    u64 getCPUFlagsInternal()
+    {
+        u64 flags = 0;
+
+        const unsigned long hwcap = getauxval(AT_HWCAP);
+
+#if defined(MANGO_CPU_64BIT)
+
+        // AT_HWCAP bits of arm64 (asm/hwcap.h)
+        const unsigned long hwcap_aes = 1 << 3;
+        const unsigned long hwcap_sha1 = 1 << 5;
+        const unsigned long hwcap_sha2 = 1 << 6;
+        const unsigned long hwcap_crc32 = 1 << 7;
+
+        flags |= CPU_NEON; // default for ARM64
+
+        const unsigned long crypto = hwcap;
+
+#else
+
+        // AT_HWCAP and AT_HWCAP2 bits of arm (asm/hwcap.h)
+        const unsigned long hwcap_neon = 1 << 12;
+        const unsigned long hwcap_aes = 1 << 0;
+        const unsigned long hwcap_sha1 = 1 << 2;
+        const unsigned long hwcap_sha2 = 1 << 3;
+        const unsigned long hwcap_crc32 = 1 << 4;
+
+        if ((hwcap & hwcap_neon) != 0)
+        {
+            flags |= CPU_NEON;
+        }
+
+        const unsigned long crypto = getauxval(AT_HWCAP2);
+
+#endif
+
+        if ((crypto & hwcap_aes) != 0)
+        {
+            flags |= CPU_ARM_AES;
+        }
+
+        if ((crypto & hwcap_sha1) != 0)
+        {
+            flags |= CPU_ARM_SHA1;
+        }
+
+        if ((crypto & hwcap_sha2) != 0)
+        {
+            flags |= CPU_ARM_SHA2;
+        }
+
+        if ((crypto & hwcap_crc32) != 0)
+        {
+            flags |= CPU_ARM_CRC32;
+        }
+
+        return flags;
+    }
+
+#elif defined(MANGO_CPU_ARM) && (defined(MANGO_PLATFORM_OSX) || defined(MANGO_PLATFORM_IOS))
+
+#include <sys/types.h>
+#include <sys/sysctl.h>
+
+    bool getSysctlFeature(const char* name)
+    {
+        int value = 0;
+        size_t size = sizeof(value);
+        return !sysctlbyname(name, &value, &size, nullptr, 0) && value != 0;
+    }
+
+    u64 getCPUFlagsInternal()
+    {
+        u64 flags = 0;
+
+#if defined(MANGO_CPU_64BIT)
+        flags |= CPU_NEON; // default for ARM64
+#else
+        if (getSysctlFeature("hw.optional.neon"))
+        {
+            flags |= CPU_NEON;
+        }
+#endif
+
+        if (getSysctlFeature("hw.optional.arm.FEAT_AES"))
+        {
+            flags |= CPU_ARM_AES;
+        }
+
+        if (getSysctlFeature("hw.optional.arm.FEAT_SHA1"))
+        {
+            flags |= CPU_ARM_SHA1;
+        }
+
+        if (getSysctlFeature("hw.optional.arm.FEAT_SHA256"))
+        {
+            flags |= CPU_ARM_SHA2;
+        }
+
+        if (getSysctlFeature("hw.optional.armv8_crc32"))
+        {
+            flags |= CPU_ARM_CRC32;
+        }
+
+        return flags;
+    }
+
+#elif defined(MANGO_CPU_ARM) && defined(MANGO_CPU_64BIT)
+
+    u64 getCPUFlagsInternal()
+    {
+        // the extensions are not detected on this platform
+        return CPU_NEON; // default for ARM64
+    }
+
 #else
 
     u64 getCPUFlagsInternal()
@@ -215,12 +373,105 @@ namespace
 
 } // namespace
 
+namespace
+{
+
+	// ----------------------------------------------------------------------------
+	// getCPUFlagsOverride()
+	// ----------------------------------------------------------------------------
+
+    // MANGO_CPU_LEVEL limits the features reported to the runtime dispatch:
+    //
+    //   MANGO_CPU_LEVEL=scalar | sse2 | sse4 | avx | avx2 | avx512 | neon
+    //
+    // The ARM features are detected on Android, Linux, macOS and iOS; other ARM64
+    // platforms only report NEON.
+    //
+    // Individual features can be removed with a comma separated list, for example:
+    //
+    //   MANGO_CPU_LEVEL=avx2,-aes,-sha
+
+    u64 getCPUFlagsOverride(u64 flags)
+    {
+        const char* env = std::getenv("MANGO_CPU_LEVEL");
+        if (!env)
+            return flags;
+
+        const u64 sse2 = CPU_MMX | CPU_MMX_PLUS | CPU_SSE | CPU_SSE2 | CPU_CMOV | CPU_CMPXCHG16B |
+            CPU_AES | CPU_CLMUL | CPU_SHA | CPU_RDRAND | CPU_3DNOW | CPU_3DNOW_EXT;
+        const u64 sse4 = sse2 | CPU_SSE3 | CPU_SSSE3 | CPU_SSE4_1 | CPU_SSE4_2 | CPU_SSE4A | CPU_POPCNT;
+        const u64 avx = sse4 | CPU_AVX;
+        const u64 avx2 = avx | CPU_AVX2 | CPU_FMA3 | CPU_F16C | CPU_MOVBE | CPU_BMI1 | CPU_BMI2;
+        const u64 neon = CPU_NEON | CPU_ARM_AES | CPU_ARM_SHA1 | CPU_ARM_SHA2 | CPU_ARM_CRC32;
+
+        const struct
+        {
+            const char* name;
+            u64 mask;
+        }
+        levels[] =
+        {
+            { "scalar", 0 },
+            { "sse2", sse2 },
+            { "sse4", sse4 },
+            { "avx", avx },
+            { "avx2", avx2 },
+            { "avx512", ~0ull },
+            { "neon", neon },
+        },
+        features[] =
+        {
+            { "aes", CPU_AES | CPU_ARM_AES },
+            { "clmul", CPU_CLMUL },
+            { "sha", CPU_SHA | CPU_ARM_SHA1 | CPU_ARM_SHA2 },
+            { "crc32", CPU_SSE4_2 | CPU_ARM_CRC32 },
+            { "popcnt", CPU_POPCNT },
+            { "bmi", CPU_BMI1 | CPU_BMI2 },
+            { "f16c", CPU_F16C },
+            { "fma", CPU_FMA3 | CPU_FMA4 },
+        };
+
+        std::string text(env);
+        size_t start = 0;
+
+        while (start <= text.length())
+        {
+            size_t end = std::min(text.find(',', start), text.length());
+            std::string token = text.substr(start, end - start);
+            start = end + 1;
+
+            if (token.empty())
+                continue;
+
+            if (token[0] == '-')
+            {
+                for (const auto& feature : features)
+                {
+                    if (token.compare(1, std::string::npos, feature.name) == 0)
+                        flags &= ~feature.mask;
+                }
+            }
+            else
+            {
+                for (const auto& level : levels)
+                {
+                    if (token == level.name)
+                        flags &= level.mask;
+                }
+            }
+        }
+
+        return flags;
+    }
+
+} // namespace
+
 namespace mango
 {
 
     u64 getCPUFlags()
     {
-        static u64 flags = getCPUFlagsInternal(); // cache the value
+        static u64 flags = getCPUFlagsOverride(getCPUFlagsInternal()); // cache the value
         return flags;
     }
 
@@ -6,15 +6,20 @@
 #include <mango/core/exception.hpp>
 #include <mango/core/bits.hpp>
 #include <mango/core/endian.hpp>
+#include <mango/core/cpuinfo.hpp>
+#include "dispatch.hpp"
 
-#if defined(MANGO_ENABLE_SSE4_2)
+#if defined(__ARM_FEATURE_CRC32)
 
+    #define MANGO_HARDWARE_CRC32
     #define MANGO_HARDWARE_CRC32C
 
-#elif defined(__ARM_FEATURE_CRC32)
+#endif
 
-    #define MANGO_HARDWARE_CRC32
-    #define MANGO_HARDWARE_CRC32C
+#if defined(MANGO_ENABLE_SSE4_2) || defined(MANGO_ENABLE_DISPATCH)
+
+    // x86 kernels are selected at runtime from the CPU features
+    #define MANGO_DISPATCH_CRC32
 
 #endif
 
@@ -676,37 +681,157 @@ namespace {
 #endif // MANGO_CPU_64BIT
 #endif // MANGO_HARDWARE_CRC32C
 
-#if defined(MANGO_ENABLE_SSE4_2)
+#if defined(MANGO_DISPATCH_CRC32)
 
-    inline u32 u8_crc32c(u32 crc, u8 data)
+    // ----------------------------------------------------------------------------
+    // crc32c (SSE4.2)
+    // ----------------------------------------------------------------------------
+
+    MANGO_TARGET("sse4.2")
+    u32 crc32c_sse42(u32 crc, Memory memory)
     {
-        return _mm_crc32_u8(crc, data);
-    }
+        const u8* p = memory.address;
+        size_t size = memory.size;
+
+        crc = ~crc;
+
+        for ( ; size > 0 && (reinterpret_cast<uintptr_t>(p) & 7); --size)
+        {
+            crc = _mm_crc32_u8(crc, *p++);
+        }
 
 #ifdef MANGO_CPU_64BIT
+        u64 crc64 = crc;
+        for ( ; size >= 8; size -= 8)
+        {
+            crc64 = _mm_crc32_u64(crc64, *reinterpret_cast<const u64 *>(p));
+            p += 8;
+        }
+        crc = u32(crc64);
+#else
+        // _mm_crc32_u64 is not available in 32 bit x86
+        for ( ; size >= 4; size -= 4)
+        {
+            crc = _mm_crc32_u32(crc, *reinterpret_cast<const u32 *>(p));
+            p += 4;
+        }
+#endif
 
-    // 64 bit crc32c (SSE4.2)
+        for ( ; size > 0; --size)
+        {
+            crc = _mm_crc32_u8(crc, *p++);
+        }
 
-    inline u32 u64_crc32c(u32 crc, const u8* data)
-    {
-        return u32(_mm_crc32_u64(crc, *reinterpret_cast<const u64 *>(data)));
+        return ~crc;
     }
 
-#else
+    // ----------------------------------------------------------------------------
+    // crc32 (PCLMULQDQ)
+    // ----------------------------------------------------------------------------
 
-    // 32 bit crc32c (SSE4.2)
-    // (_mm_crc32_u64 is not available in 32 bit x86)
+    // Folding with carry-less multiplication; see "Fast CRC Computation for
+    // Generic Polynomials Using PCLMULQDQ Instruction" (Intel, 2009).
+    // The crc is the inverted running value; size must be >= 64 and a multiple of 16.
 
-    inline u32 u64_crc32c(u32 crc, const u8* data)
+    MANGO_TARGET("sse4.1,pclmul")
+    u32 crc32_fold_pclmul(u32 crc, const u8* p, size_t size)
     {
-        crc = _mm_crc32_u32(crc, *reinterpret_cast<const u32 *>(data + 0));
-        crc = _mm_crc32_u32(crc, *reinterpret_cast<const u32 *>(data + 4));
-        return crc;
+        alignas(16) static const u64 k1k2[] = { 0x0154442bd4, 0x01c6e41596 };
+        alignas(16) static const u64 k3k4[] = { 0x01751997d0, 0x00ccaa009e };
+        alignas(16) static const u64 k5k0[] = { 0x0163cd6124, 0x0000000000 };
+        alignas(16) static const u64 poly[] = { 0x01db710641, 0x01f7011641 };
+
+        __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8;
+
+        x1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 0x00));
+        x2 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 0x10));
+        x3 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 0x20));
+        x4 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 0x30));
+        x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(crc));
+
+        x0 = _mm_load_si128(reinterpret_cast<const __m128i *>(k1k2));
+
+        p += 64;
+        size -= 64;
+
+        // fold 4 x 128 bits in parallel
+        while (size >= 64)
+        {
+            x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+            x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+            x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+            x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+
+            x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+            x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+            x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+            x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+
+            x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 0x00)));
+            x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 0x10)));
+            x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 0x20)));
+            x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 0x30)));
+
+            p += 64;
+            size -= 64;
+        }
+
+        // fold into 128 bits
+        x0 = _mm_load_si128(reinterpret_cast<const __m128i *>(k3k4));
+
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+        // fold remaining 128 bit blocks
+        while (size >= 16)
+        {
+            x2 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+
+            x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+            x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+            x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+            p += 16;
+            size -= 16;
+        }
+
+        // fold 128 bits to 64 bits
+        x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+        x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+        x1 = _mm_srli_si128(x1, 8);
+        x1 = _mm_xor_si128(x1, x2);
+
+        x0 = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(k5k0));
+
+        x2 = _mm_srli_si128(x1, 4);
+        x1 = _mm_and_si128(x1, x3);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_xor_si128(x1, x2);
+
+        // barrett reduction to 32 bits
+        x0 = _mm_load_si128(reinterpret_cast<const __m128i *>(poly));
+
+        x2 = _mm_and_si128(x1, x3);
+        x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+        x2 = _mm_and_si128(x2, x3);
+        x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+        x1 = _mm_xor_si128(x1, x2);
+
+        return u32(_mm_extract_epi32(x1, 1));
     }
 
-#endif // MANGO_CPU_64BIT
+#endif // MANGO_DISPATCH_CRC32
 
-#elif defined(__ARM_FEATURE_CRC32)
+#if defined(__ARM_FEATURE_CRC32)
 
     inline u32 u8_crc32(u32 crc, u8 data)
     {
@@ -760,18 +885,82 @@ namespace {
         return ~crc;
     }
 
+    // ----------------------------------------------------------------------------
+    // dispatch
+    // ----------------------------------------------------------------------------
+
+    using CrcFunc = u32 (*)(u32 crc, Memory memory);
+
+    u32 crc32_default(u32 crc, Memory memory)
+    {
+        return crc_template(crc, memory, u8_crc32, u64_crc32);
+    }
+
+    u32 crc32c_default(u32 crc, Memory memory)
+    {
+        return crc_template(crc, memory, u8_crc32c, u64_crc32c);
+    }
+
+#if defined(MANGO_DISPATCH_CRC32)
+
+    u32 crc32_pclmul(u32 crc, Memory memory)
+    {
+        if (memory.size >= 64)
+        {
+            const size_t size = memory.size & ~size_t(15);
+            crc = ~crc32_fold_pclmul(~crc, memory.address, size);
+            memory.address += size;
+            memory.size -= size;
+        }
+
+        return crc32_default(crc, memory);
+    }
+
+#endif
+
+    CrcFunc select_crc32()
+    {
+        CrcFunc func = crc32_default;
+
+#if defined(MANGO_DISPATCH_CRC32)
+        const u64 flags = getCPUFlags();
+        if ((flags & CPU_CLMUL) && (flags & CPU_SSE4_1))
+        {
+            func = crc32_pclmul;
+        }
+#endif
+
+        return func;
+    }
+
+    CrcFunc select_crc32c()
+    {
+        CrcFunc func = crc32c_default;
+
+#if defined(MANGO_DISPATCH_CRC32)
+        if (getCPUFlags() & CPU_SSE4_2)
+        {
+            func = crc32c_sse42;
+        }
+#endif
+
+        return func;
+    }
+
 } // namespace
 
 namespace mango {
 
     u32 crc32(u32 crc, Memory memory)
     {
-        return crc_template(crc, memory, u8_crc32, u64_crc32);
+        static const CrcFunc func = select_crc32();
+        return func(crc, memory);
     }
 
     u32 crc32c(u32 crc, Memory memory)
     {
-        return crc_template(crc, memory, u8_crc32c, u64_crc32c);
+        static const CrcFunc func = select_crc32c();
+        return func(crc, memory);
     }
 
 } // namespace mango
@@ -0,0 +1,18 @@
+/*
+    MANGO Multimedia Development Platform
+    Copyright (C) 2012-2019 Twilight Finland 3D Oy Ltd. All rights reserved.
+*/
+#pragma once
+
+#include <mango/core/configure.hpp>
+
+// The kernels for the instruction sets above the compile-time baseline are compiled with
+// MANGO_TARGET("isa"); their intrinsics are declared regardless of the compiler flags.
+
+#if defined(MANGO_ENABLE_DISPATCH)
+    #if defined(MANGO_COMPILER_MICROSOFT)
+        #include <intrin.h>
+    #else
+        #include <immintrin.h>
+    #endif
+#endif
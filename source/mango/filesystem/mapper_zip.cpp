@@ -496,6 +496,11 @@ namespace
 		zstream.next_in  = compressed;
 		zstream.avail_in = uInt(compressedLen); // TODO: upgrade to support 64 bit files
 
+		// reuse the inflater state between entries decompressed on this thread
+		zstream.zalloc = CompressionContext::allocate;
+		zstream.zfree  = CompressionContext::deallocate;
+		zstream.opaque = &CompressionContext::getThreadContext();
+
         if (inflateInit2(&zstream, -MAX_WBITS) != Z_OK)
 		{
             MANGO_EXCEPTION(ID"InflateInit failed.");
@@ -6,8 +6,12 @@
 #define _FILE_OFFSET_BITS 64 /* LFS: 64 bit off_t */
 #endif
 #include <cstdio>
+#include <climits>
+#include <cerrno>
+#include <algorithm>
 #include <unistd.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 
 #include <mango/core/string.hpp>
 #include <mango/core/exception.hpp>
@@ -73,6 +77,71 @@ namespace filesystem {
 	        size_t status = std::fwrite(data, 1, size, m_file);
 	        MANGO_UNREFERENCED_PARAMETER(status);
 	    }
+
+	    void writev(const Memory* segments, size_t count)
+	    {
+#if defined(IOV_MAX)
+            const size_t max_iov = IOV_MAX;
+#else
+            const size_t max_iov = 1024;
+#endif
+            // the stdio buffer must be empty before we go around it
+            ::fflush(m_file);
+            int fd = ::fileno(m_file);
+
+            std::vector<struct iovec> iov;
+            iov.reserve(std::min(count, max_iov));
+
+            while (count > 0)
+            {
+                iov.clear();
+
+                for ( ; count > 0 && iov.size() < max_iov; --count, ++segments)
+                {
+                    if (segments->size > 0)
+                    {
+                        struct iovec v;
+                        v.iov_base = segments->address;
+                        v.iov_len = segments->size;
+                        iov.push_back(v);
+                    }
+                }
+
+                struct iovec* current = iov.data();
+                size_t left = iov.size();
+
+                while (left > 0)
+                {
+                    ssize_t written = ::writev(fd, current, int(left));
+                    if (written < 0)
+                    {
+                        // interrupted before anything was written
+                        if (errno == EINTR)
+                            continue;
+
+                        MANGO_EXCEPTION(ID"writev() failed.");
+                    }
+
+                    // skip fully written vectors, adjust partially written one
+                    size_t n = size_t(written);
+                    while (left > 0 && n >= current->iov_len)
+                    {
+                        n -= current->iov_len;
+                        ++current;
+                        --left;
+                    }
+
+                    if (left > 0)
+                    {
+                        current->iov_base = reinterpret_cast<u8*>(current->iov_base) + n;
+                        current->iov_len -= n;
+                    }
+                }
+            }
+
+            // re-synchronize stdio with the descriptor
+            fseeko(m_file, ::lseek(fd, 0, SEEK_CUR), SEEK_SET);
+	    }
 	};
 
     // -----------------------------------------------------------------
@@ -157,5 +226,10 @@ namespace filesystem {
 		m_handle->write(data, size);
     }
 
+    void FileStream::writev(const Memory* segments, size_t count)
+    {
+		m_handle->writev(segments, count);
+    }
+
 } // namespace filesystem
 } // namespace mango
@@ -75,6 +75,16 @@ namespace filesystem {
 			MANGO_UNREFERENCED_PARAMETER(status);
 			MANGO_UNREFERENCED_PARAMETER(bytes_written);
 	    }
+
+	    void writev(const Memory* segments, size_t count)
+	    {
+            // WriteFileGather() requires unbuffered, page aligned i/o so we issue
+            // the writes directly without going through any intermediate copy
+            for (size_t i = 0; i < count; ++i)
+            {
+                write(segments[i].address, segments[i].size);
+            }
+	    }
 	};
 
     // -----------------------------------------------------------------
@@ -169,5 +179,10 @@ namespace filesystem {
 		m_handle->write(data, size);
     }
 
+    void FileStream::writev(const Memory* segments, size_t count)
+    {
+		m_handle->writev(segments, count);
+    }
+
 } // namespace filesystem
 } // namespace mango
@@ -3,12 +3,14 @@
     Copyright (C) 2012-2017 Twilight Finland 3D Oy Ltd. All rights reserved.
 */
 #include <map>
+#include <type_traits>
 #include <mango/core/system.hpp>
 #include <mango/core/cpuinfo.hpp>
 #include <mango/core/half.hpp>
 #include <mango/image/blitter.hpp>
 #include <mango/math/vector.hpp>
 #include <mango/math/srgb.hpp>
+#include "../core/dispatch.hpp"
 
 namespace
 {
@@ -176,7 +178,6 @@ namespace
     is practical to support wider range of formats than these basic facilities we offer here.
 
     TODO:
-    - blitter can handle all UNORM conversions
     - other types will be handled by generic/slow path
     - generic/slow path will have optional LLVM JIT optimizer
     - palette to rgba conversions
@@ -236,7 +237,8 @@ namespace
         switch (format.type)
         {
 			case Format::UNORM:
-				bits = format.bits;
+				// wider formats would alias the float modes; they are handled by the kernels
+				bits = format.bits <= 32 ? format.bits : 0;
 				break;
 		
 			case Format::FP16:
@@ -266,14 +268,6 @@ namespace
         return u32(v * 255.0f + 0.5f);
     }
 
-    inline u32 packFloat(u32 mask, float v)
-    {
-        v = clamp(v, 0.0f, 1.0f);
-        const u32 lsb = mask ^ (mask - 1);
-        const float bias = lsb * 0.5f; // The rounding bias should be precomputed
-        return u32(v * mask + bias) & mask;
-    }
-
     // ----------------------------------------------------------------------------
     // debug print
     // ----------------------------------------------------------------------------
@@ -334,7 +328,11 @@ namespace
 
     // unorm <- fp
 
-    template <typename DestType, typename SourceType>
+    // The unorm side is processed as a 64 bit integer so that all unorm formats up to
+    // 16 bits per component (RGB16, RGBA16) are supported; the float side is stepped
+    // by the number of elements in the float format.
+
+    template <int Bytes, typename SourceType>
     void convert_template_unorm_fp_fpu(const Blitter& blitter, const BlitRect& rect)
     {
         u8* source = rect.src.address;
@@ -343,46 +341,55 @@ namespace
         const Format& sf = blitter.srcFormat;
         const Format& df = blitter.destFormat;
 
-        u32 mask[4];
+        u64 mask[4];
+        float scale[4];
+        int shift[4];
         int offset[4];
         int components = 0;
 
         for (int i = 0; i < 4; ++i)
         {
-            if (df.size[i] && sf.size[i])
+            // luminance stores the color channels at the same offset; use the first one
+            const bool shared = df.luminance() && i > 0 && i < 3;
+
+            if (df.size[i] && sf.size[i] && !shared)
             {
-                mask[components] = df.mask(i);
+                mask[components] = (1ull << df.size[i]) - 1;
+                scale[components] = float(mask[components]);
+                shift[components] = df.offset[i];
                 offset[components] = sf.offset[i] / (sizeof(SourceType) * 8);
                 ++components;
             }
         }
 
-        // default alpha is 1.0 (if destination does not have alpha the mask is 0)
-        u32 alphaMask = df.mask(3);
+        // default alpha is 1.0
+        u64 alphaMask = 0;
+        if (df.size[3] && !sf.size[3])
+        {
+            alphaMask = ((1ull << df.size[3]) - 1) << df.offset[3];
+        }
 
-        // if source format has alpha channel use computed alpha instead of the default
-        if (sf.alpha())
-            alphaMask = 0;
+        const int elements = sf.bits / (sizeof(SourceType) * 8);
 
         for (int y = 0; y < rect.height; ++y)
         {
             const SourceType* src = reinterpret_cast<const SourceType*>(source);
-            DestType* dst = reinterpret_cast<DestType*>(dest);
+            u8* dst = dest;
 
             for (int x = 0; x < rect.width; ++x)
             {
-                u32 v = alphaMask;
+                u64 v = alphaMask;
 
-                switch (components)
+                for (int i = 0; i < components; ++i)
                 {
-                    case 4: v |= packFloat(mask[3], src[offset[3]]);
-                    case 3: v |= packFloat(mask[2], src[offset[2]]);
-                    case 2: v |= packFloat(mask[1], src[offset[1]]);
-                    case 1: v |= packFloat(mask[0], src[offset[0]]);
+                    const float s = clamp(float(src[offset[i]]), 0.0f, 1.0f);
+                    const u64 c = u64(s * scale[i] + 0.5f);
+                    v |= std::min(c, mask[i]) << shift[i];
                 }
 
-                src += components;
-                dst[x] = DestType(v);
+                std::memcpy(dst, &v, Bytes);
+                src += elements;
+                dst += Bytes;
             }
 
             source += rect.src.stride;
@@ -392,24 +399,57 @@ namespace
 
     // fp <- unorm
 
-    template <typename DestType, typename SourceType>
+    template <typename DestType, int Bytes>
     void convert_template_fp_unorm_fpu(const Blitter& blitter, const BlitRect& rect)
     {
-        MANGO_UNREFERENCED_PARAMETER(blitter);
-
         u8* source = rect.src.address;
         u8* dest = rect.dest.address;
 
+        const Format& sf = blitter.srcFormat;
+        const Format& df = blitter.destFormat;
+
+        u64 mask[4];
+        float scale[4];
+        float constant[4];
+        int shift[4];
+        int offset[4];
+        int components = 0;
+
+        for (int i = 0; i < 4; ++i)
+        {
+            const bool shared = df.luminance() && i > 0 && i < 3;
+
+            if (df.size[i] && !shared)
+            {
+                const u64 m = sf.size[i] ? (1ull << sf.size[i]) - 1 : 0;
+                mask[components] = m;
+                scale[components] = m ? 1.0f / float(m) : 0.0f;
+                constant[components] = !m && i == 3 ? 1.0f : 0.0f; // default alpha is 1.0
+                shift[components] = sf.offset[i];
+                offset[components] = df.offset[i] / (sizeof(DestType) * 8);
+                ++components;
+            }
+        }
+
+        const int elements = df.bits / (sizeof(DestType) * 8);
+
         for (int y = 0; y < rect.height; ++y)
         {
-            const SourceType* src = reinterpret_cast<const SourceType*>(source);
+            const u8* src = source;
             DestType* dst = reinterpret_cast<DestType*>(dest);
 
             for (int x = 0; x < rect.width; ++x)
             {
-                // TODO
-                MANGO_UNREFERENCED_PARAMETER(src);
-                MANGO_UNREFERENCED_PARAMETER(dst);
+                u64 s = 0;
+                std::memcpy(&s, src, Bytes);
+
+                for (int i = 0; i < components; ++i)
+                {
+                    dst[offset[i]] = DestType(float((s >> shift[i]) & mask[i]) * scale[i] + constant[i]);
+                }
+
+                src += Bytes;
+                dst += elements;
             }
 
             source += rect.src.stride;
@@ -417,6 +457,64 @@ namespace
         }
     }
 
+    template <typename FloatType>
+    Blitter::ConvertFunc convert_unorm_fp(int bytes)
+    {
+        Blitter::ConvertFunc func = nullptr;
+
+        switch (bytes)
+        {
+            case 1: func = convert_template_unorm_fp_fpu<1, FloatType>; break;
+            case 2: func = convert_template_unorm_fp_fpu<2, FloatType>; break;
+            case 3: func = convert_template_unorm_fp_fpu<3, FloatType>; break;
+            case 4: func = convert_template_unorm_fp_fpu<4, FloatType>; break;
+            case 6: func = convert_template_unorm_fp_fpu<6, FloatType>; break;
+            case 8: func = convert_template_unorm_fp_fpu<8, FloatType>; break;
+        }
+
+        return func;
+    }
+
+    template <typename FloatType>
+    Blitter::ConvertFunc convert_fp_unorm(int bytes)
+    {
+        Blitter::ConvertFunc func = nullptr;
+
+        switch (bytes)
+        {
+            case 1: func = convert_template_fp_unorm_fpu<FloatType, 1>; break;
+            case 2: func = convert_template_fp_unorm_fpu<FloatType, 2>; break;
+            case 3: func = convert_template_fp_unorm_fpu<FloatType, 3>; break;
+            case 4: func = convert_template_fp_unorm_fpu<FloatType, 4>; break;
+            case 6: func = convert_template_fp_unorm_fpu<FloatType, 6>; break;
+            case 8: func = convert_template_fp_unorm_fpu<FloatType, 8>; break;
+        }
+
+        return func;
+    }
+
+    Blitter::ConvertFunc convert_fpu_float(const Format& dest, const Format& source)
+    {
+        Blitter::ConvertFunc func = nullptr;
+
+        if (dest.type == Format::UNORM)
+        {
+            if (source.type == Format::FP16)
+                func = convert_unorm_fp<float16>(dest.bytes());
+            else if (source.type == Format::FP32)
+                func = convert_unorm_fp<float>(dest.bytes());
+        }
+        else if (source.type == Format::UNORM)
+        {
+            if (dest.type == Format::FP16)
+                func = convert_fp_unorm<float16>(source.bytes());
+            else if (dest.type == Format::FP32)
+                func = convert_fp_unorm<float>(source.bytes());
+        }
+
+        return func;
+    }
+
     // fp <- fp
 
     template <typename DestType, typename SourceType>
@@ -425,52 +523,44 @@ namespace
         u8* source = rect.src.address;
         u8* dest = rect.dest.address;
 
-        SourceType constant[4];
-        const SourceType* input[4];
-        int stride[4];
+        const Format& sf = blitter.srcFormat;
+        const Format& df = blitter.destFormat;
 
-        const int components = std::min(4, blitter.components);
+        DestType constant[4];
+        int input[4];
+        int offset[4];
+        int components = 0;
 
-        // TODO: initialize blitter variables; they are not configured for FP formats in the code yet!
-        for (int i = 0; i < components; ++i)
+        for (int i = 0; i < 4; ++i)
         {
-            int offset = blitter.component[i].offset;
-            if (offset < 0)
-            {
-                constant[i] = SourceType(blitter.component[i].constant);
-                input[i] = &constant[i];
-                stride[i] = 0;
-            }
-            else
+            const bool shared = df.luminance() && i > 0 && i < 3;
+
+            if (df.size[i] && !shared)
             {
-                stride[i] = blitter.sampleSize;
+                constant[components] = DestType(i == 3 ? 1.0f : 0.0f); // default alpha is 1.0
+                input[components] = sf.size[i] ? sf.offset[i] / int(sizeof(SourceType) * 8) : -1;
+                offset[components] = df.offset[i] / int(sizeof(DestType) * 8);
+                ++components;
             }
         }
 
+        const int srcElements = sf.bits / (sizeof(SourceType) * 8);
+        const int destElements = df.bits / (sizeof(DestType) * 8);
+
         for (int y = 0; y < rect.height; ++y)
         {
             const SourceType* src = reinterpret_cast<const SourceType*>(source);
             DestType* dst = reinterpret_cast<DestType*>(dest);
 
-            for (int i = 0; i < components; ++i)
-            {
-                int offset = blitter.component[i].offset;
-                if (offset >= 0)
-                {
-                    input[i] = src + offset;
-                }
-            }
-
             for (int x = 0; x < rect.width; ++x)
             {
-                switch (components)
+                for (int i = 0; i < components; ++i)
                 {
-                    case 4: dst[3] = *input[3]; input[3] += stride[3];
-                    case 3: dst[2] = *input[2]; input[2] += stride[2];
-                    case 2: dst[1] = *input[1]; input[1] += stride[1];
-                    case 1: dst[0] = *input[0]; input[0] += stride[0];
+                    dst[offset[i]] = input[i] < 0 ? constant[i] : DestType(float(src[input[i]]));
                 }
-                dst += components;
+
+                src += srcElements;
+                dst += destElements;
             }
 
             source += rect.src.stride;
@@ -500,22 +590,6 @@ namespace
             case MAKE_MODEMASK(32, 16): func = convert_template_unorm_unorm_fpu<u32, u16>; break;
             case MAKE_MODEMASK(32, 24): func = convert_template_unorm_unorm_fpu<u32, u24>; break;
             case MAKE_MODEMASK(32, 32): func = convert_template_unorm_unorm_fpu<u32, u32>; break;
-            case MAKE_MODEMASK( 8, BITS_FP16): func = convert_template_unorm_fp_fpu<u8, float16>; break;
-            case MAKE_MODEMASK(16, BITS_FP16): func = convert_template_unorm_fp_fpu<u16, float16>; break;
-            case MAKE_MODEMASK(24, BITS_FP16): func = convert_template_unorm_fp_fpu<u24, float16>; break;
-            case MAKE_MODEMASK(32, BITS_FP16): func = convert_template_unorm_fp_fpu<u32, float16>; break;
-            case MAKE_MODEMASK( 8, BITS_FP32): func = convert_template_unorm_fp_fpu<u8, float>; break;
-            case MAKE_MODEMASK(16, BITS_FP32): func = convert_template_unorm_fp_fpu<u16, float>; break;
-            case MAKE_MODEMASK(24, BITS_FP32): func = convert_template_unorm_fp_fpu<u24, float>; break;
-            case MAKE_MODEMASK(32, BITS_FP32): func = convert_template_unorm_fp_fpu<u32, float>; break;
-            case MAKE_MODEMASK(BITS_FP16,  8): func = convert_template_fp_unorm_fpu<float16, u8>; break;
-            case MAKE_MODEMASK(BITS_FP16, 16): func = convert_template_fp_unorm_fpu<float16, u16>; break;
-            case MAKE_MODEMASK(BITS_FP16, 24): func = convert_template_fp_unorm_fpu<float16, u24>; break;
-            case MAKE_MODEMASK(BITS_FP16, 32): func = convert_template_fp_unorm_fpu<float16, u32>; break;
-            case MAKE_MODEMASK(BITS_FP32,  8): func = convert_template_fp_unorm_fpu<float, u8>; break;
-            case MAKE_MODEMASK(BITS_FP32, 16): func = convert_template_fp_unorm_fpu<float, u16>; break;
-            case MAKE_MODEMASK(BITS_FP32, 24): func = convert_template_fp_unorm_fpu<float, u24>; break;
-            case MAKE_MODEMASK(BITS_FP32, 32): func = convert_template_fp_unorm_fpu<float, u32>; break;
             case MAKE_MODEMASK(BITS_FP16, BITS_FP16): func = convert_template_fp_fp_fpu<float16, float16>; break;
             case MAKE_MODEMASK(BITS_FP16, BITS_FP32): func = convert_template_fp_fp_fpu<float16, float>; break;
             case MAKE_MODEMASK(BITS_FP32, BITS_FP16): func = convert_template_fp_fp_fpu<float, float16>; break;
@@ -887,7 +961,7 @@ namespace
             float32x4 f = convert<float32x4>(s[x]);
             f = clamp(f, 0.0f, 1.0f);
             f = f * 255.0f + 0.5f;
-            int32x4 i = convert<int32x4>(f);
+            int32x4 i = truncate<int32x4>(f);
             d[x] = i.pack();
         }
     }
@@ -901,7 +975,7 @@ namespace
             f = f.zyxw;
             f = clamp(f, 0.0f, 1.0f);
             f = f * 255.0f + 0.5f;
-            int32x4 i = convert<int32x4>(f);
+            int32x4 i = truncate<int32x4>(f);
             d[x] = i.pack();
         }
     }
@@ -914,7 +988,7 @@ namespace
             float32x4 f = s[x];
             f = clamp(f, 0.0f, 1.0f);
             f = f * 255.0f + 0.5f;
-            int32x4 i = convert<int32x4>(f);
+            int32x4 i = truncate<int32x4>(f);
             d[x] = i.pack();
         }
     }
@@ -928,7 +1002,7 @@ namespace
             f = f.zyxw;
             f = clamp(f, 0.0f, 1.0f);
             f = f * 255.0f + 0.5f;
-            int32x4 i = convert<int32x4>(f);
+            int32x4 i = truncate<int32x4>(f);
             d[x] = i.pack();
         }
     }
@@ -951,6 +1025,802 @@ namespace
         }
     }
 
+    // ----------------------------------------------------------------------------
+    // custom conversion functions (runtime dispatch)
+    // ----------------------------------------------------------------------------
+
+#if defined(MANGO_ENABLE_DISPATCH)
+
+    MANGO_TARGET("ssse3")
+    void blit_bgra8888_to_and_from_rgba8888_ssse3(u8* dest, const u8* src, int count)
+    {
+        const __m128i mask = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+
+        for ( ; count >= 4; count -= 4)
+        {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dest), _mm_shuffle_epi8(v, mask));
+            src += 16;
+            dest += 16;
+        }
+
+        blit_bgra8888_to_and_from_rgba8888(dest, src, count);
+    }
+
+    MANGO_TARGET("avx2")
+    void blit_bgra8888_to_and_from_rgba8888_avx2(u8* dest, const u8* src, int count)
+    {
+        const __m256i mask = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+                                              2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+
+        for ( ; count >= 8; count -= 8)
+        {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(dest), _mm256_shuffle_epi8(v, mask));
+            src += 32;
+            dest += 32;
+        }
+
+        blit_bgra8888_to_and_from_rgba8888(dest, src, count);
+    }
+
+    MANGO_TARGET("ssse3")
+    void blit_bgra8888_from_bgr888_ssse3(u8* dest, const u8* src, int count)
+    {
+        const __m128i mask = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+        const __m128i alpha = _mm_set1_epi32(0xff000000);
+
+        // 4 pixels per iteration; the 16 byte load reads 4 bytes ahead
+        for ( ; count >= 6; count -= 4)
+        {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src));
+            v = _mm_or_si128(_mm_shuffle_epi8(v, mask), alpha);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dest), v);
+            src += 12;
+            dest += 16;
+        }
+
+        blit_bgra8888_from_bgr888(dest, src, count);
+    }
+
+    MANGO_TARGET("ssse3")
+    void blit_rgba8888_from_bgr888_ssse3(u8* dest, const u8* src, int count)
+    {
+        const __m128i mask = _mm_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1);
+        const __m128i alpha = _mm_set1_epi32(0xff000000);
+
+        // 4 pixels per iteration; the 16 byte load reads 4 bytes ahead
+        for ( ; count >= 6; count -= 4)
+        {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src));
+            v = _mm_or_si128(_mm_shuffle_epi8(v, mask), alpha);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dest), v);
+            src += 12;
+            dest += 16;
+        }
+
+        blit_rgba8888_from_bgr888(dest, src, count);
+    }
+
+#endif // MANGO_ENABLE_DISPATCH
+
+    // ----------------------------------------------------------------------------
+    // generated conversion kernels
+    // ----------------------------------------------------------------------------
+
+    /*
+
+    The UNORM formats with at most 16 bits per component and 64 bits per pixel are converted
+    with integer arithmetic instead of the float scaling. Widening replicates the bits, for
+    example 5 bits abcde become 8 bits abcdeabc, and narrowing is rounded to nearest with the
+    division by (2^n - 1) computed as (t + (t >> n)) >> n. The kernels are instantiated for
+    each pair of pixel sizes; the layout of the components is in the Blitter.
+
+    When every component is one or two whole bytes the conversion is a byte permutation,
+    for example RGBA8 <-> BGR8 or L8A8 -> RGBA8, which is done with pshufb or tbl.
+
+    */
+
+    // compute the component layout; false when the formats are not supported by the kernels
+    bool setup_layout(Blitter& blitter, const Format& dest, const Format& source)
+    {
+        blitter.srcBytes = 0;
+        blitter.destBytes = 0;
+
+        if (dest.type != Format::UNORM || source.type != Format::UNORM)
+            return false;
+
+        if (dest.bits > 64 || source.bits > 64)
+            return false;
+
+        // luminance is only computed from luminance
+        if (dest.luminance() && !source.luminance())
+            return false;
+
+        std::memset(blitter.channel, 0, sizeof(blitter.channel));
+        blitter.fillMask = 0;
+
+        for (int i = 0; i < 4; ++i)
+        {
+            // (t >> 32) is zero
+            blitter.channel[i].round = 32;
+        }
+
+        u64 used = 0;
+
+        for (int i = 0; i < 4; ++i)
+        {
+            const int m = dest.size[i];
+            const int n = source.size[i];
+
+            if (!m)
+                continue;
+
+            if (m > 16 || n > 16 || dest.offset[i] + m > int(dest.bits) || source.offset[i] + n > int(source.bits))
+                return false;
+
+            const u64 mask = u64((1u << m) - 1) << dest.offset[i];
+
+            if ((used & mask) == mask)
+            {
+                // the luminance is stored only once
+                continue;
+            }
+
+            if (used & mask)
+                return false;
+
+            used |= mask;
+
+            if (!n)
+            {
+                // alpha defaults to 1.0, color to 0.0
+                if (i == 3)
+                {
+                    blitter.fillMask |= mask;
+                }
+
+                continue;
+            }
+
+            Blitter::Channel& c = blitter.channel[i];
+
+            c.srcShift = source.offset[i];
+            c.srcMask = (1u << n) - 1;
+            c.destShift = dest.offset[i];
+
+            if (m > n)
+            {
+                // replicate the bits
+                const int k = (m + n - 1) / n;
+
+                for (int j = 0; j < k; ++j)
+                {
+                    c.mul |= 1u << (j * n);
+                }
+
+                c.shift = k * n - m;
+            }
+            else if (m < n)
+            {
+                // t = v * (2^m - 1) + 2^(n - 1) is divided by (2^n - 1)
+                c.mul = (1u << m) - 1;
+                c.bias = 1u << (n - 1);
+                c.round = n;
+                c.shift = n;
+            }
+            else
+            {
+                c.mul = 1;
+            }
+        }
+
+        blitter.srcBytes = source.bits / 8;
+        blitter.destBytes = dest.bits / 8;
+
+        return true;
+    }
+
+    // compute the byte permutation; false when the components are not whole bytes
+    bool setup_shuffle(Blitter& blitter)
+    {
+        const int srcBytes = blitter.srcBytes;
+        const int destBytes = blitter.destBytes;
+
+        if (!srcBytes)
+            return false;
+
+        u8 index[8];
+
+        for (int i = 0; i < destBytes; ++i)
+        {
+            index[i] = 0x80;
+        }
+
+        for (int i = 0; i < 4; ++i)
+        {
+            const Blitter::Channel& c = blitter.channel[i];
+
+            if (!c.srcMask)
+                continue;
+
+            if (c.mul != 1 || (c.srcMask != 0xff && c.srcMask != 0xffff) || ((c.srcShift | c.destShift) & 7))
+                return false;
+
+            const int bytes = c.srcMask == 0xff ? 1 : 2;
+
+            for (int j = 0; j < bytes; ++j)
+            {
+                index[c.destShift / 8 + j] = u8(c.srcShift / 8 + j);
+            }
+        }
+
+        const int pixels = std::min(16 / srcBytes, 16 / destBytes);
+
+        for (int i = 0; i < 16; ++i)
+        {
+            const int pixel = i / destBytes;
+            const int offset = i % destBytes;
+
+            if (pixel < pixels)
+            {
+                const u8 s = index[offset];
+                blitter.shuffleIndex[i] = s & 0x80 ? s : u8(pixel * srcBytes + s);
+                blitter.shuffleFill[i] = u8(blitter.fillMask >> (offset * 8));
+            }
+            else
+            {
+                blitter.shuffleIndex[i] = 0x80;
+                blitter.shuffleFill[i] = 0;
+            }
+        }
+
+        blitter.shufflePixels = pixels;
+
+        return true;
+    }
+
+    template <int bytes>
+    inline u64 read_pixel(const u8* src)
+    {
+        u64 value = 0;
+
+        switch (bytes)
+        {
+            case 1: value = src[0]; break;
+            case 2: value = uload16le(src); break;
+            case 4: value = uload32le(src); break;
+            case 8: value = uload64le(src); break;
+            default:
+                for (int i = 0; i < bytes; ++i)
+                {
+                    value |= u64(src[i]) << (i * 8);
+                }
+                break;
+        }
+
+        return value;
+    }
+
+    template <int bytes>
+    inline void write_pixel(u8* dest, u64 value)
+    {
+        switch (bytes)
+        {
+            case 1: dest[0] = u8(value); break;
+            case 2: ustore16le(dest, u16(value)); break;
+            case 4: ustore32le(dest, u32(value)); break;
+            case 8: ustore64le(dest, value); break;
+            default:
+                for (int i = 0; i < bytes; ++i)
+                {
+                    dest[i] = u8(value >> (i * 8));
+                }
+                break;
+        }
+    }
+
+    template <int DestBytes, int SourceBytes>
+    void convert_integer_span(const Blitter& blitter, u8* dest, const u8* src, int count)
+    {
+        // the pixels up to 32 bits are computed in 32 bits; the (t >> 32) is done as ((t >> 1) >> 31)
+        using Word = typename std::conditional<(DestBytes > 4 || SourceBytes > 4), u64, u32>::type;
+
+        struct Channel
+        {
+            Word srcShift;
+            Word srcMask;
+            Word mul;
+            Word bias;
+            Word round;
+            Word shift;
+            Word destShift;
+        } channel[4];
+
+        for (int i = 0; i < 4; ++i)
+        {
+            const Blitter::Channel& c = blitter.channel[i];
+            channel[i] = { c.srcShift, c.srcMask, c.mul, c.bias, c.round - 1, c.shift, c.destShift };
+        }
+
+        const Word fill = Word(blitter.fillMask);
+
+        auto compute = [] (const Channel& c, Word s) -> Word
+        {
+            const Word t = ((s >> c.srcShift) & c.srcMask) * c.mul + c.bias;
+            return ((t + ((t >> 1) >> c.round)) >> c.shift) << c.destShift;
+        };
+
+        for (int x = 0; x < count; ++x)
+        {
+            const Word s = Word(read_pixel<SourceBytes>(src));
+            const Word v = fill | compute(channel[0], s) | compute(channel[1], s) | compute(channel[2], s) | compute(channel[3], s);
+            write_pixel<DestBytes>(dest, v);
+            src += SourceBytes;
+            dest += DestBytes;
+        }
+    }
+
+    template <int DestBytes, int SourceBytes>
+    void convert_template_integer(const Blitter& blitter, const BlitRect& rect)
+    {
+        u8* source = rect.src.address;
+        u8* dest = rect.dest.address;
+
+        for (int y = 0; y < rect.height; ++y)
+        {
+            convert_integer_span<DestBytes, SourceBytes>(blitter, dest, source, rect.width);
+            source += rect.src.stride;
+            dest += rect.dest.stride;
+        }
+    }
+
+    template <int DestBytes>
+    Blitter::ConvertFunc select_integer_source(int srcBytes)
+    {
+        Blitter::ConvertFunc func = nullptr;
+
+        switch (srcBytes)
+        {
+            case 1: func = convert_template_integer<DestBytes, 1>; break;
+            case 2: func = convert_template_integer<DestBytes, 2>; break;
+            case 3: func = convert_template_integer<DestBytes, 3>; break;
+            case 4: func = convert_template_integer<DestBytes, 4>; break;
+            case 6: func = convert_template_integer<DestBytes, 6>; break;
+            case 8: func = convert_template_integer<DestBytes, 8>; break;
+        }
+
+        return func;
+    }
+
+    Blitter::ConvertFunc select_integer(Blitter& blitter, const Format& dest, const Format& source)
+    {
+        MANGO_UNREFERENCED_PARAMETER(dest);
+        MANGO_UNREFERENCED_PARAMETER(source);
+
+        Blitter::ConvertFunc func = nullptr;
+
+        switch (blitter.destBytes)
+        {
+            case 1: func = select_integer_source<1>(blitter.srcBytes); break;
+            case 2: func = select_integer_source<2>(blitter.srcBytes); break;
+            case 3: func = select_integer_source<3>(blitter.srcBytes); break;
+            case 4: func = select_integer_source<4>(blitter.srcBytes); break;
+            case 6: func = select_integer_source<6>(blitter.srcBytes); break;
+            case 8: func = select_integer_source<8>(blitter.srcBytes); break;
+        }
+
+        return func;
+    }
+
+    // byte permutation of the pixels which are left over from the vector loop
+    void convert_shuffle_span(const Blitter& blitter, u8* dest, const u8* src, int count)
+    {
+        const int srcBytes = blitter.srcBytes;
+        const int destBytes = blitter.destBytes;
+
+        for (int x = 0; x < count; ++x)
+        {
+            for (int i = 0; i < destBytes; ++i)
+            {
+                const u8 index = blitter.shuffleIndex[i];
+                dest[i] = (index & 0x80 ? 0 : src[index]) | blitter.shuffleFill[i];
+            }
+
+            src += srcBytes;
+            dest += destBytes;
+        }
+    }
+
+#if defined(MANGO_ENABLE_DISPATCH)
+
+    MANGO_TARGET("ssse3")
+    void convert_shuffle_ssse3(const Blitter& blitter, const BlitRect& rect)
+    {
+        const __m128i index = _mm_loadu_si128(reinterpret_cast<const __m128i *>(blitter.shuffleIndex));
+        const __m128i fill = _mm_loadu_si128(reinterpret_cast<const __m128i *>(blitter.shuffleFill));
+
+        const int srcBytes = blitter.srcBytes;
+        const int destBytes = blitter.destBytes;
+        const int pixels = blitter.shufflePixels;
+
+        for (int y = 0; y < rect.height; ++y)
+        {
+            const u8* src = rect.src.address + y * rect.src.stride;
+            u8* dest = rect.dest.address + y * rect.dest.stride;
+            int count = rect.width;
+
+            // the 16 byte loads and stores stay inside the scanline
+            for ( ; count * srcBytes >= 16 && count * destBytes >= 16; count -= pixels)
+            {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src));
+                v = _mm_or_si128(_mm_shuffle_epi8(v, index), fill);
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dest), v);
+                src += pixels * srcBytes;
+                dest += pixels * destBytes;
+            }
+
+            convert_shuffle_span(blitter, dest, src, count);
+        }
+    }
+
+    MANGO_TARGET("avx2")
+    void convert_shuffle_avx2(const Blitter& blitter, const BlitRect& rect)
+    {
+        const __m128i index128 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(blitter.shuffleIndex));
+        const __m128i fill128 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(blitter.shuffleFill));
+        const __m256i index = _mm256_broadcastsi128_si256(index128);
+        const __m256i fill = _mm256_broadcastsi128_si256(fill128);
+
+        const int srcBytes = blitter.srcBytes;
+        const int destBytes = blitter.destBytes;
+        const int pixels = blitter.shufflePixels;
+        const int srcStep = pixels * srcBytes;
+        const int destStep = pixels * destBytes;
+
+        for (int y = 0; y < rect.height; ++y)
+        {
+            const u8* src = rect.src.address + y * rect.src.stride;
+            u8* dest = rect.dest.address + y * rect.dest.stride;
+            int count = rect.width;
+
+            // each 128 bit lane converts one group of pixels
+            for ( ; count * srcBytes >= srcStep + 16 && count * destBytes >= destStep + 16; count -= pixels * 2)
+            {
+                __m128i s0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src));
+                __m128i s1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + srcStep));
+                __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(s0), s1, 1);
+                v = _mm256_or_si256(_mm256_shuffle_epi8(v, index), fill);
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dest), _mm256_castsi256_si128(v));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dest + destStep), _mm256_extracti128_si256(v, 1));
+                src += srcStep * 2;
+                dest += destStep * 2;
+            }
+
+            for ( ; count * srcBytes >= 16 && count * destBytes >= 16; count -= pixels)
+            {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src));
+                v = _mm_or_si128(_mm_shuffle_epi8(v, index128), fill128);
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dest), v);
+                src += srcStep;
+                dest += destStep;
+            }
+
+            convert_shuffle_span(blitter, dest, src, count);
+        }
+    }
+
+    // The vector kernels convert pixels of at most 32 bits; the components are computed as in
+    // the scalar kernel with the same shift for every lane and the shifts by 32 give zero.
+    // The 24 bit pixels are expanded with a shuffle of four pixels in each 128 bit lane.
+
+    struct VectorChannel
+    {
+        __m128i srcShift;
+        __m128i srcMask;
+        __m128i mul;
+        __m128i bias;
+        __m128i round;
+        __m128i shift;
+        __m128i destShift;
+    };
+
+    // compact the used components; returns the number of components
+    int setup_vector_channels(VectorChannel* channel, const Blitter& blitter)
+    {
+        int channels = 0;
+
+        for (int i = 0; i < 4; ++i)
+        {
+            const Blitter::Channel& c = blitter.channel[i];
+
+            if (c.srcMask)
+            {
+                channel[channels].srcShift = _mm_cvtsi32_si128(c.srcShift);
+                channel[channels].srcMask = _mm_set1_epi32(c.srcMask);
+                channel[channels].mul = _mm_set1_epi32(c.mul);
+                channel[channels].bias = _mm_set1_epi32(c.bias);
+                channel[channels].round = _mm_cvtsi32_si128(c.round);
+                channel[channels].shift = _mm_cvtsi32_si128(c.shift);
+                channel[channels].destShift = _mm_cvtsi32_si128(c.destShift);
+                ++channels;
+            }
+        }
+
+        return channels;
+    }
+
+    // four pixels in a vector
+    template <int DestBytes, int SourceBytes>
+    MANGO_TARGET("sse4.1")
+    void convert_template_integer_sse41(const Blitter& blitter, const BlitRect& rect)
+    {
+        VectorChannel channel[4];
+        const int channels = setup_vector_channels(channel, blitter);
+
+        const __m128i fill = _mm_set1_epi32(u32(blitter.fillMask));
+        const __m128i expand = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+        const __m128i pack = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+
+        // the 24 bit pixels are loaded 16 bytes at a time
+        const int last = SourceBytes == 3 ? 6 : 4;
+
+        for (int y = 0; y < rect.height; ++y)
+        {
+            const u8* src = rect.src.address + y * rect.src.stride;
+            u8* dest = rect.dest.address + y * rect.dest.stride;
+            int count = rect.width;
+
+            for ( ; count >= last; count -= 4)
+            {
+                __m128i s;
+
+                switch (SourceBytes)
+                {
+                    case 1:
+                        s = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(uload32(src)));
+                        break;
+                    case 2:
+                        s = _mm_cvtepu16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(src)));
+                        break;
+                    case 3:
+                        s = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src)), expand);
+                        break;
+                    default:
+                        s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src));
+                        break;
+                }
+
+                __m128i v = fill;
+
+                for (int i = 0; i < channels; ++i)
+                {
+                    __m128i t = _mm_and_si128(_mm_srl_epi32(s, channel[i].srcShift), channel[i].srcMask);
+                    t = _mm_add_epi32(_mm_mullo_epi32(t, channel[i].mul), channel[i].bias);
+                    t = _mm_add_epi32(t, _mm_srl_epi32(t, channel[i].round));
+                    t = _mm_srl_epi32(t, channel[i].shift);
+                    v = _mm_or_si128(v, _mm_sll_epi32(t, channel[i].destShift));
+                }
+
+                // the values are in range so the saturating packs are exact
+                switch (DestBytes)
+                {
+                    case 1:
+                        v = _mm_packus_epi32(v, v);
+                        ustore32(dest, _mm_cvtsi128_si32(_mm_packus_epi16(v, v)));
+                        break;
+                    case 2:
+                        _mm_storel_epi64(reinterpret_cast<__m128i *>(dest), _mm_packus_epi32(v, v));
+                        break;
+                    case 3:
+                        v = _mm_shuffle_epi8(v, pack);
+                        _mm_storel_epi64(reinterpret_cast<__m128i *>(dest), v);
+                        ustore32(dest + 8, _mm_extract_epi32(v, 2));
+                        break;
+                    default:
+                        _mm_storeu_si128(reinterpret_cast<__m128i *>(dest), v);
+                        break;
+                }
+
+                src += SourceBytes * 4;
+                dest += DestBytes * 4;
+            }
+
+            convert_integer_span<DestBytes, SourceBytes>(blitter, dest, src, count);
+        }
+    }
+
+    // eight pixels in a vector
+    template <int DestBytes, int SourceBytes>
+    MANGO_TARGET("avx2")
+    void convert_template_integer_avx2(const Blitter& blitter, const BlitRect& rect)
+    {
+        VectorChannel channel[4];
+        const int channels = setup_vector_channels(channel, blitter);
+
+        const __m256i fill = _mm256_set1_epi32(u32(blitter.fillMask));
+
+        const __m256i expand_index = _mm256_setr_epi32(0, 1, 2, 0, 3, 4, 5, 0);
+        const __m256i expand_shuffle = _mm256_setr_epi8(
+            0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+            0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+        const __m256i pack_shuffle = _mm256_setr_epi8(
+            0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+            0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+        const __m256i pack_index = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+
+        // the 24 bit pixels are loaded 32 bytes at a time
+        const int last = SourceBytes == 3 ? 11 : 8;
+
+        for (int y = 0; y < rect.height; ++y)
+        {
+            const u8* src = rect.src.address + y * rect.src.stride;
+            u8* dest = rect.dest.address + y * rect.dest.stride;
+            int count = rect.width;
+
+            for ( ; count >= last; count -= 8)
+            {
+                __m256i s;
+
+                switch (SourceBytes)
+                {
+                    case 1:
+                        s = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(src)));
+                        break;
+                    case 2:
+                        s = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src)));
+                        break;
+                    case 3:
+                        s = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src));
+                        s = _mm256_shuffle_epi8(_mm256_permutevar8x32_epi32(s, expand_index), expand_shuffle);
+                        break;
+                    default:
+                        s = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src));
+                        break;
+                }
+
+                __m256i v = fill;
+
+                for (int i = 0; i < channels; ++i)
+                {
+                    __m256i t = _mm256_and_si256(_mm256_srl_epi32(s, channel[i].srcShift), _mm256_broadcastsi128_si256(channel[i].srcMask));
+                    t = _mm256_add_epi32(_mm256_mullo_epi32(t, _mm256_broadcastsi128_si256(channel[i].mul)), _mm256_broadcastsi128_si256(channel[i].bias));
+                    t = _mm256_add_epi32(t, _mm256_srl_epi32(t, channel[i].round));
+                    t = _mm256_srl_epi32(t, channel[i].shift);
+                    v = _mm256_or_si256(v, _mm256_sll_epi32(t, channel[i].destShift));
+                }
+
+                // the values are in range so the saturating packs are exact
+                __m128i lo = _mm256_castsi256_si128(v);
+                __m128i hi = _mm256_extracti128_si256(v, 1);
+
+                switch (DestBytes)
+                {
+                    case 1:
+                        lo = _mm_packus_epi32(lo, hi);
+                        _mm_storel_epi64(reinterpret_cast<__m128i *>(dest), _mm_packus_epi16(lo, lo));
+                        break;
+                    case 2:
+                        _mm_storeu_si128(reinterpret_cast<__m128i *>(dest), _mm_packus_epi32(lo, hi));
+                        break;
+                    case 3:
+                        v = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(v, pack_shuffle), pack_index);
+                        _mm_storeu_si128(reinterpret_cast<__m128i *>(dest), _mm256_castsi256_si128(v));
+                        _mm_storel_epi64(reinterpret_cast<__m128i *>(dest + 16), _mm256_extracti128_si256(v, 1));
+                        break;
+                    default:
+                        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dest), v);
+                        break;
+                }
+
+                src += SourceBytes * 8;
+                dest += DestBytes * 8;
+            }
+
+            convert_integer_span<DestBytes, SourceBytes>(blitter, dest, src, count);
+        }
+    }
+
+    template <int DestBytes>
+    Blitter::ConvertFunc select_integer_vector_source(int srcBytes, bool avx2)
+    {
+        Blitter::ConvertFunc func = nullptr;
+
+        switch (srcBytes)
+        {
+            case 1: func = avx2 ? convert_template_integer_avx2<DestBytes, 1> : convert_template_integer_sse41<DestBytes, 1>; break;
+            case 2: func = avx2 ? convert_template_integer_avx2<DestBytes, 2> : convert_template_integer_sse41<DestBytes, 2>; break;
+            case 3: func = avx2 ? convert_template_integer_avx2<DestBytes, 3> : convert_template_integer_sse41<DestBytes, 3>; break;
+            case 4: func = avx2 ? convert_template_integer_avx2<DestBytes, 4> : convert_template_integer_sse41<DestBytes, 4>; break;
+        }
+
+        return func;
+    }
+
+    Blitter::ConvertFunc select_integer_vector(const Blitter& blitter, bool avx2)
+    {
+        Blitter::ConvertFunc func = nullptr;
+
+        switch (blitter.destBytes)
+        {
+            case 1: func = select_integer_vector_source<1>(blitter.srcBytes, avx2); break;
+            case 2: func = select_integer_vector_source<2>(blitter.srcBytes, avx2); break;
+            case 3: func = select_integer_vector_source<3>(blitter.srcBytes, avx2); break;
+            case 4: func = select_integer_vector_source<4>(blitter.srcBytes, avx2); break;
+        }
+
+        return func;
+    }
+
+    Blitter::ConvertFunc select_integer_sse41(Blitter& blitter, const Format& dest, const Format& source)
+    {
+        MANGO_UNREFERENCED_PARAMETER(dest);
+        MANGO_UNREFERENCED_PARAMETER(source);
+        return select_integer_vector(blitter, false);
+    }
+
+    Blitter::ConvertFunc select_integer_avx2(Blitter& blitter, const Format& dest, const Format& source)
+    {
+        MANGO_UNREFERENCED_PARAMETER(dest);
+        MANGO_UNREFERENCED_PARAMETER(source);
+        return select_integer_vector(blitter, true);
+    }
+
+    Blitter::ConvertFunc select_shuffle_ssse3(Blitter& blitter, const Format& dest, const Format& source)
+    {
+        MANGO_UNREFERENCED_PARAMETER(dest);
+        MANGO_UNREFERENCED_PARAMETER(source);
+        return setup_shuffle(blitter) ? convert_shuffle_ssse3 : nullptr;
+    }
+
+    Blitter::ConvertFunc select_shuffle_avx2(Blitter& blitter, const Format& dest, const Format& source)
+    {
+        MANGO_UNREFERENCED_PARAMETER(dest);
+        MANGO_UNREFERENCED_PARAMETER(source);
+        return setup_shuffle(blitter) ? convert_shuffle_avx2 : nullptr;
+    }
+
+#endif // MANGO_ENABLE_DISPATCH
+
+#if defined(MANGO_ENABLE_NEON) && defined(__aarch64__)
+
+    void convert_shuffle_neon(const Blitter& blitter, const BlitRect& rect)
+    {
+        // the tbl gives zero for out of range indices
+        const uint8x16_t index = vld1q_u8(blitter.shuffleIndex);
+        const uint8x16_t fill = vld1q_u8(blitter.shuffleFill);
+
+        const int srcBytes = blitter.srcBytes;
+        const int destBytes = blitter.destBytes;
+        const int pixels = blitter.shufflePixels;
+
+        for (int y = 0; y < rect.height; ++y)
+        {
+            const u8* src = rect.src.address + y * rect.src.stride;
+            u8* dest = rect.dest.address + y * rect.dest.stride;
+            int count = rect.width;
+
+            for ( ; count * srcBytes >= 16 && count * destBytes >= 16; count -= pixels)
+            {
+                uint8x16_t v = vld1q_u8(src);
+                vst1q_u8(dest, vorrq_u8(vqtbl1q_u8(v, index), fill));
+                src += pixels * srcBytes;
+                dest += pixels * destBytes;
+            }
+
+            convert_shuffle_span(blitter, dest, src, count);
+        }
+    }
+
+    Blitter::ConvertFunc select_shuffle_neon(Blitter& blitter, const Format& dest, const Format& source)
+    {
+        MANGO_UNREFERENCED_PARAMETER(dest);
+        MANGO_UNREFERENCED_PARAMETER(source);
+        return setup_shuffle(blitter) ? convert_shuffle_neon : nullptr;
+    }
+
+#endif
+
     // ----------------------------------------------------------------------------
     // custom conversion function lookup
     // ----------------------------------------------------------------------------
@@ -960,7 +1830,7 @@ namespace
     {
         Format dest;
         Format source;
-        u32 requireCpuFeature;
+        u64 requireCpuFeature;
         Blitter::FastFunc func;
     }
     const g_custom_func_table[] =
@@ -1003,6 +1873,19 @@ namespace
         { FORMAT_B8G8R8A8, FORMAT_RGBA32F,    0, blit_bgra8888_from_rgba32f },
         { FORMAT_RGBA16F,  FORMAT_RGBA32F,    0, blit_rgba16f_from_rgba32f },
         { FORMAT_RGBA32F,  FORMAT_RGBA16F,    0, blit_rgba32f_from_rgba16f },
+#if defined(MANGO_ENABLE_DISPATCH)
+        // later entries replace the above when the CPU supports them
+        { FORMAT_B8G8R8X8, FORMAT_R8G8B8X8,   CPU_SSSE3, blit_bgra8888_to_and_from_rgba8888_ssse3 },
+        { FORMAT_R8G8B8X8, FORMAT_B8G8R8X8,   CPU_SSSE3, blit_bgra8888_to_and_from_rgba8888_ssse3 },
+        { FORMAT_B8G8R8A8, FORMAT_R8G8B8A8,   CPU_SSSE3, blit_bgra8888_to_and_from_rgba8888_ssse3 },
+        { FORMAT_R8G8B8A8, FORMAT_B8G8R8A8,   CPU_SSSE3, blit_bgra8888_to_and_from_rgba8888_ssse3 },
+        { FORMAT_B8G8R8A8, FORMAT_B8G8R8,     CPU_SSSE3, blit_bgra8888_from_bgr888_ssse3 },
+        { FORMAT_B8G8R8A8, FORMAT_R8G8B8,     CPU_SSSE3, blit_rgba8888_from_bgr888_ssse3 },
+        { FORMAT_B8G8R8X8, FORMAT_R8G8B8X8,   CPU_AVX2,  blit_bgra8888_to_and_from_rgba8888_avx2 },
+        { FORMAT_R8G8B8X8, FORMAT_B8G8R8X8,   CPU_AVX2,  blit_bgra8888_to_and_from_rgba8888_avx2 },
+        { FORMAT_B8G8R8A8, FORMAT_R8G8B8A8,   CPU_AVX2,  blit_bgra8888_to_and_from_rgba8888_avx2 },
+        { FORMAT_R8G8B8A8, FORMAT_B8G8R8A8,   CPU_AVX2,  blit_bgra8888_to_and_from_rgba8888_avx2 },
+#endif
     };
 
     typedef std::map< std::pair<Format, Format>, Blitter::FastFunc > FastConversionMap;
@@ -1060,6 +1943,46 @@ namespace
         return func;
     }
 
+    // ----------------------------------------------------------------------------
+    // conversion kernel registry
+    // ----------------------------------------------------------------------------
+
+    Blitter::ConvertFunc select_custom(Blitter& blitter, const Format& dest, const Format& source)
+    {
+        blitter.custom = find_custom_blitter(dest, source);
+        return blitter.custom ? convert_custom : nullptr;
+    }
+
+    Blitter::ConvertFunc select_memcpy(Blitter& blitter, const Format& dest, const Format& source)
+    {
+        return dest == source ? select_custom(blitter, dest, source) : nullptr;
+    }
+
+    // the conversion kernels in order of preference; the first one which supports the formats
+    // is used. The byte shuffles replace the scalar custom conversion functions.
+    struct
+    {
+        u64 requireCpuFeature;
+        Blitter::ConvertFunc (*select)(Blitter& blitter, const Format& dest, const Format& source);
+    }
+    const g_kernel_table[] =
+    {
+        { 0,          select_memcpy },
+#if defined(MANGO_ENABLE_DISPATCH)
+        { CPU_AVX2,   select_shuffle_avx2 },
+        { CPU_SSSE3,  select_shuffle_ssse3 },
+#endif
+#if defined(MANGO_ENABLE_NEON) && defined(__aarch64__)
+        { 0,          select_shuffle_neon },
+#endif
+        { 0,          select_custom },
+#if defined(MANGO_ENABLE_DISPATCH)
+        { CPU_AVX2,   select_integer_avx2 },
+        { CPU_SSE4_1, select_integer_sse41 },
+#endif
+        { 0,          select_integer },
+    };
+
 } // namespace
 
 namespace mango
@@ -1072,12 +1995,21 @@ namespace mango
     Blitter::Blitter(const Format& dest, const Format& source)
     : srcFormat(source), destFormat(dest), custom(NULL), convertFunc(NULL)
     {
-        custom = find_custom_blitter(dest, source);
-        if (custom)
+        setup_layout(*this, dest, source);
+
+        u64 cpuFlags = getCPUFlags();
+
+        for (const auto& node : g_kernel_table)
         {
-            // found custom blitter
-            convertFunc = convert_custom;
-            return;
+            if ((cpuFlags & node.requireCpuFeature) == node.requireCpuFeature)
+            {
+                convertFunc = node.select(*this, dest, source);
+                if (convertFunc)
+                {
+                    // found conversion kernel
+                    return;
+                }
+            }
         }
 
         components = 0;
@@ -1086,7 +2018,13 @@ namespace mango
 
         sampleSize = 0; // TODO
 
-        u64 cpuFlags = getCPUFlags();
+        convertFunc = convert_fpu_float(dest, source);
+        if (convertFunc)
+        {
+            // unorm <-> fp conversion
+            return;
+        }
+
         bool sse2 = (cpuFlags & CPU_SSE2) != 0;
 
         for (int i = 0; i < 4; ++i)
@@ -3,6 +3,8 @@
     Copyright (C) 2012-2017 Twilight Finland 3D Oy Ltd. All rights reserved.
 */
 #include <map>
+#include <cstring>
+#include <algorithm>
 #include <mango/core/core.hpp>
 #include <mango/image/image.hpp>
 #include "../../external/google/etc.hpp"
@@ -30,8 +32,32 @@ namespace mango
     void decode_block_r11f_g11f_b10f (const TextureCompressionInfo& info, u8* output, const u8* input, int stride);
     void decode_block_r10f_g11f_b11f (const TextureCompressionInfo& info, u8* output, const u8* input, int stride);
     void decode_block_pvrtc          (const TextureCompressionInfo& info, u8* output, const u8* input, int stride);
+    void decode_block_etc1s          (const TextureCompressionInfo& info, u8* output, const u8* input, int stride);
+
+    void decode_blocks_dxt1          (const TextureCompressionInfo& info, u8* output, const u8* input, int stride, int count);
+    void decode_blocks_dxt3          (const TextureCompressionInfo& info, u8* output, const u8* input, int stride, int count);
+    void decode_blocks_dxt5          (const TextureCompressionInfo& info, u8* output, const u8* input, int stride, int count);
+    void decode_blocks_3dc_x         (const TextureCompressionInfo& info, u8* output, const u8* input, int stride, int count);
+    void decode_blocks_3dc_xy        (const TextureCompressionInfo& info, u8* output, const u8* input, int stride, int count);
+    void decode_blocks_bc4u          (const TextureCompressionInfo& info, u8* output, const u8* input, int stride, int count);
+    void decode_blocks_bc5u          (const TextureCompressionInfo& info, u8* output, const u8* input, int stride, int count);
+    void decode_blocks_bc6hu         (const TextureCompressionInfo& info, u8* output, const u8* input, int stride, int count);
+    void decode_blocks_bc6hs         (const TextureCompressionInfo& info, u8* output, const u8* input, int stride, int count);
+    void decode_blocks_bc7           (const TextureCompressionInfo& info, u8* output, const u8* input, int stride, int count);
 
     void encode_block_etc1           (const TextureCompressionInfo& info, u8* output, const u8* input, int stride);
+    void encode_block_etc2           (const TextureCompressionInfo& info, u8* output, const u8* input, int stride);
+    void encode_block_etc2_fast      (const TextureCompressionInfo& info, u8* output, const u8* input, int stride);
+    void encode_block_eac_r11        (const TextureCompressionInfo& info, u8* output, const u8* input, int stride);
+    void encode_block_eac_r11_fast   (const TextureCompressionInfo& info, u8* output, const u8* input, int stride);
+    void encode_block_eac_rg11       (const TextureCompressionInfo& info, u8* output, const u8* input, int stride);
+    void encode_block_eac_rg11_fast  (const TextureCompressionInfo& info, u8* output, const u8* input, int stride);
+    void encode_block_astc           (const TextureCompressionInfo& info, u8* output, const u8* input, int stride);
+    void encode_block_astc_fast      (const TextureCompressionInfo& info, u8* output, const u8* input, int stride);
+    void encode_block_etc1s          (const TextureCompressionInfo& info, u8* output, const u8* input, int stride);
+    void encode_block_etc1s_fast     (const TextureCompressionInfo& info, u8* output, const u8* input, int stride);
+
+    bool encodeBlocksFast(const TextureCompressionInfo& info, u8* output, const Surface& surface, int y0, int y1);
 
 } // namespace mango
 
@@ -47,8 +73,8 @@ namespace
         { 4, 4, 16, FORMAT_NONE, nullptr, nullptr, TextureCompression::ATC_RGBA_INTERPOLATED_ALPHA },
 
         // AMD_compressed_3DC_texture
-        { 4, 4,  8, MAKE_FORMAT(8, UNORM, R, 8, 0, 0, 0), decode_block_3dc_x, nullptr, TextureCompression::AMD_3DC_X },
-        { 4, 4, 16, MAKE_FORMAT(16, UNORM, RG, 8, 8, 0, 0), decode_block_3dc_xy, nullptr, TextureCompression::AMD_3DC_XY },
+        { 4, 4,  8, MAKE_FORMAT(8, UNORM, R, 8, 0, 0, 0), decode_block_3dc_x, nullptr, TextureCompression::AMD_3DC_X, decode_blocks_3dc_x },
+        { 4, 4, 16, MAKE_FORMAT(16, UNORM, RG, 8, 8, 0, 0), decode_block_3dc_xy, nullptr, TextureCompression::AMD_3DC_XY, decode_blocks_3dc_xy },
 
 		// LATC
         { 4, 4,  8, FORMAT_NONE, nullptr, nullptr, TextureCompression::LATC1_LUMINANCE },
@@ -57,27 +83,27 @@ namespace
         { 4, 4, 16, FORMAT_NONE, nullptr, nullptr, TextureCompression::LATC2_SIGNED_LUMINANCE_ALPHA },
 
         // DXT
-        { 4, 4,  8, MAKE_FORMAT(32, UNORM, RGBA, 8, 8, 8, 8), decode_block_dxt1, encode_block_bc1, TextureCompression::DXT1 },
-        { 4, 4,  8, MAKE_FORMAT(32, UNORM, RGBA, 8, 8, 8, 8), decode_block_dxt1, encode_block_bc1, TextureCompression::DXT1_SRGB },
-        { 4, 4,  8, MAKE_FORMAT(32, UNORM, RGBA, 8, 8, 8, 8), decode_block_dxt1, encode_block_bc1a, TextureCompression::DXT1_ALPHA1 },
-        { 4, 4,  8, MAKE_FORMAT(32, UNORM, RGBA, 8, 8, 8, 8), decode_block_dxt1, encode_block_bc1a, TextureCompression::DXT1_ALPHA1_SRGB },
-        { 4, 4, 16, MAKE_FORMAT(32, UNORM, RGBA, 8, 8, 8, 8), decode_block_dxt3, encode_block_bc2, TextureCompression::DXT3 },
-        { 4, 4, 16, MAKE_FORMAT(32, UNORM, RGBA, 8, 8, 8, 8), decode_block_dxt3, encode_block_bc2, TextureCompression::DXT3_SRGB },
-        { 4, 4, 16, MAKE_FORMAT(32, UNORM, RGBA, 8, 8, 8, 8), decode_block_dxt5, encode_block_bc3, TextureCompression::DXT5 },
-        { 4, 4, 16, MAKE_FORMAT(32, UNORM, RGBA, 8, 8, 8, 8), decode_block_dxt5, encode_block_bc3, TextureCompression::DXT5_SRGB },
+        { 4, 4,  8, MAKE_FORMAT(32, UNORM, RGBA, 8, 8, 8, 8), decode_block_dxt1, encode_block_bc1, TextureCompression::DXT1, decode_blocks_dxt1 },
+        { 4, 4,  8, MAKE_FORMAT(32, UNORM, RGBA, 8, 8, 8, 8), decode_block_dxt1, encode_block_bc1, TextureCompression::DXT1_SRGB, decode_blocks_dxt1 },
+        { 4, 4,  8, MAKE_FORMAT(32, UNORM, RGBA, 8, 8, 8, 8), decode_block_dxt1, encode_block_bc1a, TextureCompression::DXT1_ALPHA1, decode_blocks_dxt1 },
+        { 4, 4,  8, MAKE_FORMAT(32, UNORM, RGBA, 8, 8, 8, 8), decode_block_dxt1, encode_block_bc1a, TextureCompression::DXT1_ALPHA1_SRGB, decode_blocks_dxt1 },
+        { 4, 4, 16, MAKE_FORMAT(32, UNORM, RGBA, 8, 8, 8, 8), decode_block_dxt3, encode_block_bc2, TextureCompression::DXT3, decode_blocks_dxt3 },
+        { 4, 4, 16, MAKE_FORMAT(32, UNORM, RGBA, 8, 8, 8, 8), decode_block_dxt3, encode_block_bc2, TextureCompression::DXT3_SRGB, decode_blocks_dxt3 },
+        { 4, 4, 16, MAKE_FORMAT(32, UNORM, RGBA, 8, 8, 8, 8), decode_block_dxt5, encode_block_bc3, TextureCompression::DXT5, decode_blocks_dxt5 },
+        { 4, 4, 16, MAKE_FORMAT(32, UNORM, RGBA, 8, 8, 8, 8), decode_block_dxt5, encode_block_bc3, TextureCompression::DXT5_SRGB, decode_blocks_dxt5 },
 
 #ifdef MANGO_ENABLE_LICENSE_MICROSOFT
         // RGTC
-        { 4, 4,  8, MAKE_FORMAT(128, FP32, RGBA, 32, 32, 32, 32), decode_block_bc4u, encode_block_bc4u, TextureCompression::RGTC1_RED },
+        { 4, 4,  8, MAKE_FORMAT(128, FP32, RGBA, 32, 32, 32, 32), decode_block_bc4u, encode_block_bc4u, TextureCompression::RGTC1_RED, decode_blocks_bc4u, MAKE_FORMAT(8, UNORM, R, 8, 0, 0, 0) },
         { 4, 4,  8, MAKE_FORMAT(128, FP32, RGBA, 32, 32, 32, 32), decode_block_bc4s, encode_block_bc4s, TextureCompression::RGTC1_SIGNED_RED },
-        { 4, 4, 16, MAKE_FORMAT(128, FP32, RGBA, 32, 32, 32, 32), decode_block_bc5u, encode_block_bc5u, TextureCompression::RGTC2_RG },
+        { 4, 4, 16, MAKE_FORMAT(128, FP32, RGBA, 32, 32, 32, 32), decode_block_bc5u, encode_block_bc5u, TextureCompression::RGTC2_RG, decode_blocks_bc5u, MAKE_FORMAT(16, UNORM, RG, 8, 8, 0, 0) },
         { 4, 4, 16, MAKE_FORMAT(128, FP32, RGBA, 32, 32, 32, 32), decode_block_bc5s, encode_block_bc5s, TextureCompression::RGTC2_SIGNED_RG },
 
         // BPTC
-        { 4, 4, 16, MAKE_FORMAT(128, FP32, RGBA, 32, 32, 32, 32), decode_block_bc6hu, encode_block_bc6hu, TextureCompression::BPTC_RGB_UNSIGNED_FLOAT },
-        { 4, 4, 16, MAKE_FORMAT(128, FP32, RGBA, 32, 32, 32, 32), decode_block_bc6hs, encode_block_bc6hs, TextureCompression::BPTC_RGB_SIGNED_FLOAT },
-        { 4, 4, 16, MAKE_FORMAT(128, FP32, RGBA, 32, 32, 32, 32), decode_block_bc7, encode_block_bc7, TextureCompression::BPTC_RGBA_UNORM },
-        { 4, 4, 16, MAKE_FORMAT(128, FP32, RGBA, 32, 32, 32, 32), decode_block_bc7, encode_block_bc7, TextureCompression::BPTC_SRGB_ALPHA_UNORM },
+        { 4, 4, 16, MAKE_FORMAT(128, FP32, RGBA, 32, 32, 32, 32), decode_block_bc6hu, encode_block_bc6hu, TextureCompression::BPTC_RGB_UNSIGNED_FLOAT, decode_blocks_bc6hu },
+        { 4, 4, 16, MAKE_FORMAT(128, FP32, RGBA, 32, 32, 32, 32), decode_block_bc6hs, encode_block_bc6hs, TextureCompression::BPTC_RGB_SIGNED_FLOAT, decode_blocks_bc6hs },
+        { 4, 4, 16, MAKE_FORMAT(128, FP32, RGBA, 32, 32, 32, 32), decode_block_bc7, encode_block_bc7, TextureCompression::BPTC_RGBA_UNORM, decode_blocks_bc7, MAKE_FORMAT(32, UNORM, RGBA, 8, 8, 8, 8) },
+        { 4, 4, 16, MAKE_FORMAT(128, FP32, RGBA, 32, 32, 32, 32), decode_block_bc7, encode_block_bc7, TextureCompression::BPTC_SRGB_ALPHA_UNORM, decode_blocks_bc7, MAKE_FORMAT(32, UNORM, RGBA, 8, 8, 8, 8) },
 #endif
 
         // IMG_texture_compression_pvrtc
@@ -98,49 +124,49 @@ namespace
 
 #ifdef MANGO_ENABLE_LICENSE_APACHE
         // ETC2 / EAC
-        { 4, 4,  8, MAKE_FORMAT(16, UNORM, R, 16, 0, 0, 0), decode_block_eac_r11, nullptr, TextureCompression::EAC_R11 },
-        { 4, 4,  8, MAKE_FORMAT(16, SNORM, R, 16, 0, 0, 0), decode_block_eac_r11, nullptr, TextureCompression::EAC_SIGNED_R11 },
-        { 4, 4, 16, MAKE_FORMAT(32, UNORM, RG, 16, 16, 0, 0), decode_block_eac_rg11, nullptr, TextureCompression::EAC_RG11 },
-        { 4, 4, 16, MAKE_FORMAT(32, SNORM, RG, 16, 16, 0, 0), decode_block_eac_rg11, nullptr, TextureCompression::EAC_SIGNED_RG11 },
-        { 4, 4,  8, MAKE_FORMAT(32, UNORM, RGBA, 8, 8, 8, 8), decode_block_etc2, nullptr, TextureCompression::ETC2_RGB },
-        { 4, 4,  8, MAKE_FORMAT(32, UNORM, RGBA, 8, 8, 8, 8), decode_block_etc2, nullptr, TextureCompression::ETC2_SRGB },
-        { 4, 4,  8, MAKE_FORMAT(32, UNORM, RGBA, 8, 8, 8, 8), decode_block_etc2, nullptr, TextureCompression::ETC2_RGB_ALPHA1 },
-        { 4, 4,  8, MAKE_FORMAT(32, UNORM, RGBA, 8, 8, 8, 8), decode_block_etc2, nullptr, TextureCompression::ETC2_SRGB_ALPHA1 },
-        { 4, 4, 16, MAKE_FORMAT(32, UNORM, RGBA, 8, 8, 8, 8), decode_block_etc2_eac, nullptr, TextureCompression::ETC2_RGBA },
-        { 4, 4, 16, MAKE_FORMAT(32, UNORM, RGBA, 8, 8, 8, 8), decode_block_etc2_eac, nullptr, TextureCompression::ETC2_SRGB_ALPHA8 },
+        { 4, 4,  8, MAKE_FORMAT(16, UNORM, R, 16, 0, 0, 0), decode_block_eac_r11, encode_block_eac_r11, TextureCompression::EAC_R11 },
+        { 4, 4,  8, MAKE_FORMAT(16, SNORM, R, 16, 0, 0, 0), decode_block_eac_r11, encode_block_eac_r11, TextureCompression::EAC_SIGNED_R11 },
+        { 4, 4, 16, MAKE_FORMAT(32, UNORM, RG, 16, 16, 0, 0), decode_block_eac_rg11, encode_block_eac_rg11, TextureCompression::EAC_RG11 },
+        { 4, 4, 16, MAKE_FORMAT(32, SNORM, RG, 16, 16, 0, 0), decode_block_eac_rg11, encode_block_eac_rg11, TextureCompression::EAC_SIGNED_RG11 },
+        { 4, 4,  8, MAKE_FORMAT(32, UNORM, RGBA, 8, 8, 8, 8), decode_block_etc2, encode_block_etc2, TextureCompression::ETC2_RGB },
+        { 4, 4,  8, MAKE_FORMAT(32, UNORM, RGBA, 8, 8, 8, 8), decode_block_etc2, encode_block_etc2, TextureCompression::ETC2_SRGB },
+        { 4, 4,  8, MAKE_FORMAT(32, UNORM, RGBA, 8, 8, 8, 8), decode_block_etc2, encode_block_etc2, TextureCompression::ETC2_RGB_ALPHA1 },
+        { 4, 4,  8, MAKE_FORMAT(32, UNORM, RGBA, 8, 8, 8, 8), decode_block_etc2, encode_block_etc2, TextureCompression::ETC2_SRGB_ALPHA1 },
+        { 4, 4, 16, MAKE_FORMAT(32, UNORM, RGBA, 8, 8, 8, 8), decode_block_etc2_eac, encode_block_etc2, TextureCompression::ETC2_RGBA },
+        { 4, 4, 16, MAKE_FORMAT(32, UNORM, RGBA, 8, 8, 8, 8), decode_block_etc2_eac, encode_block_etc2, TextureCompression::ETC2_SRGB_ALPHA8 },
 
         // OES_compressed_ETC1_RGB8_texture
         { 4, 4, 8, MAKE_FORMAT(32, UNORM, RGBA, 8, 8, 8, 8), decode_block_etc1, encode_block_etc1, TextureCompression::ETC1_RGB },
 
         // KHR_texture_compression_astc_ldr
-        {  4,  4, 16, FORMAT_ASTC, decode_block_astc, nullptr, TextureCompression::ASTC_RGBA_4x4 },
-        {  5,  4, 16, FORMAT_ASTC, decode_block_astc, nullptr, TextureCompression::ASTC_RGBA_5x4 },
-        {  5,  5, 16, FORMAT_ASTC, decode_block_astc, nullptr, TextureCompression::ASTC_RGBA_5x5 },
-        {  6,  5, 16, FORMAT_ASTC, decode_block_astc, nullptr, TextureCompression::ASTC_RGBA_6x5 },
-        {  6,  6, 16, FORMAT_ASTC, decode_block_astc, nullptr, TextureCompression::ASTC_RGBA_6x6 },
-        {  8,  5, 16, FORMAT_ASTC, decode_block_astc, nullptr, TextureCompression::ASTC_RGBA_8x5 },
-        {  8,  6, 16, FORMAT_ASTC, decode_block_astc, nullptr, TextureCompression::ASTC_RGBA_8x6 },
-        {  8,  8, 16, FORMAT_ASTC, decode_block_astc, nullptr, TextureCompression::ASTC_RGBA_8x8 },
-        { 10,  5, 16, FORMAT_ASTC, decode_block_astc, nullptr, TextureCompression::ASTC_RGBA_10x5 },
-        { 10,  6, 16, FORMAT_ASTC, decode_block_astc, nullptr, TextureCompression::ASTC_RGBA_10x6 },
-        { 10,  8, 16, FORMAT_ASTC, decode_block_astc, nullptr, TextureCompression::ASTC_RGBA_10x8 },
-        { 10, 10, 16, FORMAT_ASTC, decode_block_astc, nullptr, TextureCompression::ASTC_RGBA_10x10 },
-        { 12, 10, 16, FORMAT_ASTC, decode_block_astc, nullptr, TextureCompression::ASTC_RGBA_12x10 },
-        { 12, 12, 16, FORMAT_ASTC, decode_block_astc, nullptr, TextureCompression::ASTC_RGBA_12x12 },
-        {  4,  4, 16, FORMAT_ASTC, decode_block_astc, nullptr, TextureCompression::ASTC_SRGB_ALPHA_4x4 },
-        {  5,  4, 16, FORMAT_ASTC, decode_block_astc, nullptr, TextureCompression::ASTC_SRGB_ALPHA_5x4 },
-        {  5,  5, 16, FORMAT_ASTC, decode_block_astc, nullptr, TextureCompression::ASTC_SRGB_ALPHA_5x5 },
-        {  4,  4, 16, FORMAT_ASTC, decode_block_astc, nullptr, TextureCompression::ASTC_SRGB_ALPHA_6x5 },
-        {  6,  6, 16, FORMAT_ASTC, decode_block_astc, nullptr, TextureCompression::ASTC_SRGB_ALPHA_6x6 },
-        {  8,  5, 16, FORMAT_ASTC, decode_block_astc, nullptr, TextureCompression::ASTC_SRGB_ALPHA_8x5 },
-        {  8,  6, 16, FORMAT_ASTC, decode_block_astc, nullptr, TextureCompression::ASTC_SRGB_ALPHA_8x6 },
-        {  8,  8, 16, FORMAT_ASTC, decode_block_astc, nullptr, TextureCompression::ASTC_SRGB_ALPHA_8x8 },
-        { 10,  5, 16, FORMAT_ASTC, decode_block_astc, nullptr, TextureCompression::ASTC_SRGB_ALPHA_10x5 },
-        { 10,  6, 16, FORMAT_ASTC, decode_block_astc, nullptr, TextureCompression::ASTC_SRGB_ALPHA_10x6 },
-        { 10,  8, 16, FORMAT_ASTC, decode_block_astc, nullptr, TextureCompression::ASTC_SRGB_ALPHA_10x8 },
-        { 10, 10, 16, FORMAT_ASTC, decode_block_astc, nullptr, TextureCompression::ASTC_SRGB_ALPHA_10x10 },
-        { 12, 10, 16, FORMAT_ASTC, decode_block_astc, nullptr, TextureCompression::ASTC_SRGB_ALPHA_12x10 },
-        { 12, 12, 16, FORMAT_ASTC, decode_block_astc, nullptr, TextureCompression::ASTC_SRGB_ALPHA_12x12 },
+        {  4,  4, 16, FORMAT_ASTC, decode_block_astc, encode_block_astc, TextureCompression::ASTC_RGBA_4x4 },
+        {  5,  4, 16, FORMAT_ASTC, decode_block_astc, encode_block_astc, TextureCompression::ASTC_RGBA_5x4 },
+        {  5,  5, 16, FORMAT_ASTC, decode_block_astc, encode_block_astc, TextureCompression::ASTC_RGBA_5x5 },
+        {  6,  5, 16, FORMAT_ASTC, decode_block_astc, encode_block_astc, TextureCompression::ASTC_RGBA_6x5 },
+        {  6,  6, 16, FORMAT_ASTC, decode_block_astc, encode_block_astc, TextureCompression::ASTC_RGBA_6x6 },
+        {  8,  5, 16, FORMAT_ASTC, decode_block_astc, encode_block_astc, TextureCompression::ASTC_RGBA_8x5 },
+        {  8,  6, 16, FORMAT_ASTC, decode_block_astc, encode_block_astc, TextureCompression::ASTC_RGBA_8x6 },
+        {  8,  8, 16, FORMAT_ASTC, decode_block_astc, encode_block_astc, TextureCompression::ASTC_RGBA_8x8 },
+        { 10,  5, 16, FORMAT_ASTC, decode_block_astc, encode_block_astc, TextureCompression::ASTC_RGBA_10x5 },
+        { 10,  6, 16, FORMAT_ASTC, decode_block_astc, encode_block_astc, TextureCompression::ASTC_RGBA_10x6 },
+        { 10,  8, 16, FORMAT_ASTC, decode_block_astc, encode_block_astc, TextureCompression::ASTC_RGBA_10x8 },
+        { 10, 10, 16, FORMAT_ASTC, decode_block_astc, encode_block_astc, TextureCompression::ASTC_RGBA_10x10 },
+        { 12, 10, 16, FORMAT_ASTC, decode_block_astc, encode_block_astc, TextureCompression::ASTC_RGBA_12x10 },
+        { 12, 12, 16, FORMAT_ASTC, decode_block_astc, encode_block_astc, TextureCompression::ASTC_RGBA_12x12 },
+        {  4,  4, 16, FORMAT_ASTC, decode_block_astc, encode_block_astc, TextureCompression::ASTC_SRGB_ALPHA_4x4 },
+        {  5,  4, 16, FORMAT_ASTC, decode_block_astc, encode_block_astc, TextureCompression::ASTC_SRGB_ALPHA_5x4 },
+        {  5,  5, 16, FORMAT_ASTC, decode_block_astc, encode_block_astc, TextureCompression::ASTC_SRGB_ALPHA_5x5 },
+        {  6,  5, 16, FORMAT_ASTC, decode_block_astc, encode_block_astc, TextureCompression::ASTC_SRGB_ALPHA_6x5 },
+        {  6,  6, 16, FORMAT_ASTC, decode_block_astc, encode_block_astc, TextureCompression::ASTC_SRGB_ALPHA_6x6 },
+        {  8,  5, 16, FORMAT_ASTC, decode_block_astc, encode_block_astc, TextureCompression::ASTC_SRGB_ALPHA_8x5 },
+        {  8,  6, 16, FORMAT_ASTC, decode_block_astc, encode_block_astc, TextureCompression::ASTC_SRGB_ALPHA_8x6 },
+        {  8,  8, 16, FORMAT_ASTC, decode_block_astc, encode_block_astc, TextureCompression::ASTC_SRGB_ALPHA_8x8 },
+        { 10,  5, 16, FORMAT_ASTC, decode_block_astc, encode_block_astc, TextureCompression::ASTC_SRGB_ALPHA_10x5 },
+        { 10,  6, 16, FORMAT_ASTC, decode_block_astc, encode_block_astc, TextureCompression::ASTC_SRGB_ALPHA_10x6 },
+        { 10,  8, 16, FORMAT_ASTC, decode_block_astc, encode_block_astc, TextureCompression::ASTC_SRGB_ALPHA_10x8 },
+        { 10, 10, 16, FORMAT_ASTC, decode_block_astc, encode_block_astc, TextureCompression::ASTC_SRGB_ALPHA_10x10 },
+        { 12, 10, 16, FORMAT_ASTC, decode_block_astc, encode_block_astc, TextureCompression::ASTC_SRGB_ALPHA_12x10 },
+        { 12, 12, 16, FORMAT_ASTC, decode_block_astc, encode_block_astc, TextureCompression::ASTC_SRGB_ALPHA_12x12 },
 
         // KHR_texture_compression_astc_hdr
         { 3, 3, 16, FORMAT_NONE, nullptr, nullptr, TextureCompression::ASTC_RGBA_3x3x3 },
@@ -165,6 +191,12 @@ namespace
         { 6, 6, 16, FORMAT_NONE, nullptr, nullptr, TextureCompression::ASTC_SRGB_ALPHA_6x6x6 },
 #endif
 
+        // ETC1S
+        { 4, 4,  8, FORMAT_R8G8B8A8, decode_block_etc1s, encode_block_etc1s, TextureCompression::ETC1S_RGB },
+        { 4, 4,  8, FORMAT_R8G8B8A8, decode_block_etc1s, encode_block_etc1s, TextureCompression::ETC1S_SRGB },
+        { 4, 4, 16, FORMAT_R8G8B8A8, decode_block_etc1s, encode_block_etc1s, TextureCompression::ETC1S_RGBA },
+        { 4, 4, 16, FORMAT_R8G8B8A8, decode_block_etc1s, encode_block_etc1s, TextureCompression::ETC1S_SRGB_ALPHA },
+
         // Packed Pixel
         { 1, 1, 4, MAKE_FORMAT(128, FP32, RGBA, 32, 32, 32, 32), decode_block_rgb9e5, nullptr, TextureCompression::RGB9_E5 },
         { 1, 1, 4, MAKE_FORMAT(128, FP32, RGBA, 32, 32, 32, 32), decode_block_r11f_g11f_b10f, nullptr, TextureCompression::R11F_G11F_B10F },
@@ -210,13 +242,13 @@ namespace
         ET( 0x8C72, 0,    0, LATC2_LUMINANCE_ALPHA ),
         ET( 0x8C73, 0,    0, LATC2_SIGNED_LUMINANCE_ALPHA ),
 		ET( 0x83F0, 131, 71, DXT1 ),
-		ET( 0,      132, 72, DXT1_SRGB ),
+		ET( 0x8C4C, 132, 72, DXT1_SRGB ),
 		ET( 0x83F1, 133,  0, DXT1_ALPHA1 ),
-		ET( 0,      133,  0, DXT1_ALPHA1_SRGB ),
+		ET( 0x8C4D, 134,  0, DXT1_ALPHA1_SRGB ),
 		ET( 0x83F2, 135, 74, DXT3 ),
-		ET( 0,      136, 75, DXT3_SRGB ),
+		ET( 0x8C4E, 136, 75, DXT3_SRGB ),
 		ET( 0x83F3, 137, 77, DXT5 ),
-        ET( 0,      138, 78, DXT5_SRGB ),
+        ET( 0x8C4F, 138, 78, DXT5_SRGB ),
 		ET( 0x8DBB, 139, 80, RGTC1_RED ),
         ET( 0x8DBC, 140, 81, RGTC1_SIGNED_RED ),
         ET( 0x8DBD, 141, 83, RGTC2_RG ),
@@ -303,10 +335,48 @@ namespace
         ET( 0,      0,   68, R8G8B8G8 )
 	};
 
-    void directBlockDecode(const TextureCompressionInfo& block, const Surface& surface, Memory memory, int xsize, int ysize)
+    // The surface stores at most 8 bits of every channel which the 8 bit decoders
+    // produce without loss; the luminance and packed formats are excluded because
+    // their conversion is not exact.
+    bool isNarrowSurface(const Format& format)
+    {
+        if (format.type != Format::UNORM || format.luminance())
+            return false;
+
+        for (int i = 0; i < 4; ++i)
+        {
+            if (format.size[i] != 0 && format.size[i] != 8)
+                return false;
+        }
+
+        return true;
+    }
+
+    // Decodes a row of blocks; the formats without a row decoder call the block decoder
+    // for each block.
+    void decodeBlockRow(const TextureCompressionInfo& block, TextureCompressionInfo::DecodeBlocksFunc decodeRow,
+                        u8* image, const u8* data, int stride, int xsize, int blockImageSize)
+    {
+        if (decodeRow)
+        {
+            decodeRow(block, image, data, stride, xsize);
+            return;
+        }
+
+        for (int x = 0; x < xsize; ++x)
+        {
+            block.decode(block, image, data, stride);
+            image += blockImageSize;
+            data += block.bytes;
+        }
+    }
+
+    void directBlockDecode(const TextureCompressionInfo& block, TextureCompressionInfo::DecodeBlocksFunc decodeRow,
+                           const Surface& surface, Memory memory, int xsize, int ysize)
     {
         const int blockImageSize = block.width * surface.format.bytes();
         const int blockImageStride = block.height * surface.stride;
+        const size_t blockRowSize = size_t(xsize) * block.bytes;
 
         const bool origin = (block.getCompressionFlags() & TextureCompressionInfo::ORIGIN) != 0;
         const u8* data = memory.address;
@@ -327,48 +397,42 @@ namespace
                 image += y * blockImageStride;
             }
 
-            for (int x = 0; x < xsize; ++x)
-            {
-                block.decode(block, image, data, stride);
-                image += blockImageSize;
-                data += block.bytes;
-            }
+            decodeBlockRow(block, decodeRow, image, data, stride, xsize, blockImageSize);
+            data += blockRowSize;
         }
     }
 
-    void clipConvertBlockDecode(const TextureCompressionInfo& block, const Surface& surface, Memory memory, int xsize, int ysize)
+    void clipConvertBlockDecode(const TextureCompressionInfo& block, TextureCompressionInfo::DecodeBlocksFunc decodeRow, const Format& format,
+                                const Surface& surface, Memory memory, int xsize, int ysize)
     {
-        Blitter blitter(surface.format, block.format);
+        MANGO_UNREFERENCED_PARAMETER(ysize);
+
+        Blitter blitter(surface.format, format);
         BlitRect rect;
 
         const bool origin = (block.getCompressionFlags() & TextureCompressionInfo::ORIGIN) != 0;
         const u8* data = memory.address;
 
+        // the whole row of blocks is decoded and converted at once
+        const int blockImageSize = block.width * format.bytes();
+        const size_t blockRowSize = size_t(xsize) * block.bytes;
+
         rect.dest.stride = origin ? -surface.stride : surface.stride;
-        rect.src.stride = block.width * block.format.bytes();
+        rect.src.stride = xsize * blockImageSize;
+        rect.width = surface.width; // horizontal clipping
 
         Buffer temp(block.height * rect.src.stride);
         rect.src.address = temp;
 
-        const int pixelSize = block.width * surface.format.bytes();
-
         for (int y = 0; y < surface.height; y += block.height)
         {
             rect.dest.address = surface.image + (origin ? surface.height - y - 1 : y) * surface.stride;
             rect.height = std::min(y + block.height, surface.height) - y; // vertical clipping
 
-            for (int x = 0; x < surface.width; x += block.width)
-            {
-                block.decode(block, temp, data, rect.src.stride);
-
-                rect.width = std::min(x + block.width, surface.width) - x; // horizontal clipping
+            decodeBlockRow(block, decodeRow, temp, data, rect.src.stride, xsize, blockImageSize);
+            data += blockRowSize;
 
-                // TODO: async conversion
-                blitter.convert(rect);
-
-                rect.dest.address += pixelSize;
-                data += block.bytes;
-            }
+            blitter.convert(rect);
         }
     }
 
@@ -391,6 +455,27 @@ namespace
         Surface(surface).blit(0, 0, bitmap);
     }
 
+    // The block encoders which have a faster variant with a smaller search.
+    TextureCompressionInfo::EncodeFunc getFastEncoder(const TextureCompressionInfo& info)
+    {
+        if (info.encode == encode_block_etc2)
+            return encode_block_etc2_fast;
+
+        if (info.encode == encode_block_eac_r11)
+            return encode_block_eac_r11_fast;
+
+        if (info.encode == encode_block_eac_rg11)
+            return encode_block_eac_rg11_fast;
+
+        if (info.encode == encode_block_astc)
+            return encode_block_astc_fast;
+
+        if (info.encode == encode_block_etc1s)
+            return encode_block_etc1s_fast;
+
+        return info.encode;
+    }
+
 } // namespace
 
 namespace mango
@@ -476,7 +561,8 @@ namespace mango
     // ----------------------------------------------------------------------------
 
     TextureCompressionInfo::TextureCompressionInfo()
-    : width(1), height(1), bytes(0), format(FORMAT_NONE), decode(nullptr), encode(nullptr), compression(TextureCompression::NONE)
+    : width(1), height(1), bytes(0), format(FORMAT_NONE), decode(nullptr), decodeBlocks(nullptr), blocksFormat(FORMAT_NONE)
+    , encode(nullptr), compression(TextureCompression::NONE)
     {
     }
 
@@ -488,8 +574,10 @@ namespace mango
     }
 
     TextureCompressionInfo::TextureCompressionInfo(int width, int height, int bytes, const Format& format,
-                                                   DecodeFunc decode, EncodeFunc encode, TextureCompression compression)
-    : width(width), height(height), bytes(bytes), format(format), decode(decode), encode(encode), compression(compression)
+                                                   DecodeFunc decode, EncodeFunc encode, TextureCompression compression,
+                                                   DecodeBlocksFunc decodeBlocks, const Format& blocksFormat)
+    : width(width), height(height), bytes(bytes), format(format), decode(decode), decodeBlocks(decodeBlocks)
+    , blocksFormat(blocksFormat == FORMAT_NONE ? format : blocksFormat), encode(encode), compression(compression)
     {
     }
 
@@ -519,18 +607,90 @@ namespace mango
         }
         else
         {
-            if (direct)
+            DecodeBlocksFunc decodeRow = decodeBlocks;
+            Format decodeFormat = format;
+
+            if (decodeBlocks && blocksFormat != format)
             {
-                directBlockDecode(*this, surface, memory, xsize, ysize);
+                if (isNarrowSurface(surface.format))
+                    decodeFormat = blocksFormat;
+                else
+                    decodeRow = nullptr;
+            }
+
+            if (noclip && surface.format == decodeFormat)
+            {
+                directBlockDecode(*this, decodeRow, surface, memory, xsize, ysize);
             }
             else
             {
-                clipConvertBlockDecode(*this, surface, memory, xsize, ysize);
+                clipConvertBlockDecode(*this, decodeRow, decodeFormat, surface, memory, xsize, ysize);
+            }
+        }
+    }
+
+    // Encodes the rows of blocks [y0, y1) of the surface; output points to the first row.
+    // The encoder reads the surface in place when it is in the right format; partial blocks
+    // are copied and the edge pixels are replicated.
+    void compressBlocks(const TextureCompressionInfo& info, u8* output, const Surface& image,
+                        int y0, int y1, TextureQuality quality)
+    {
+        // the blocks of the bottom-left origin formats start from the last scanline
+        const bool origin = (info.getCompressionFlags() & TextureCompressionInfo::ORIGIN) != 0;
+        const Surface surface = origin ?
+            Surface(image.width, image.height, image.format, -image.stride, image.image + (image.height - 1) * image.stride) :
+            image;
+
+        if (quality == TextureQuality::FAST && encodeBlocksFast(info, output, surface, y0, y1))
+            return;
+
+        const auto encode = quality == TextureQuality::FAST ? getFastEncoder(info) : info.encode;
+
+        const int xblocks = round_multiple_up(surface.width, info.width);
+        const int bpp = info.format.bytes();
+
+        const bool direct = surface.format == info.format;
+        Bitmap temp(info.width, info.height, info.format);
+
+        for (int y = y0; y < y1; ++y)
+        {
+            u8* data = output + size_t(y) * xblocks * info.bytes;
+
+            for (int x = 0; x < xblocks; ++x)
+            {
+                Surface block(surface, x * info.width, y * info.height, info.width, info.height);
+
+                if (direct && block.width == info.width && block.height == info.height)
+                {
+                    encode(info, data, block.image, int(block.stride));
+                }
+                else
+                {
+                    temp.blit(0, 0, block);
+
+                    for (int i = 0; i < block.height; ++i)
+                    {
+                        u8* scan = temp.address<u8>(0, i);
+                        for (int j = block.width; j < info.width; ++j)
+                        {
+                            std::memcpy(scan + j * bpp, scan + (block.width - 1) * bpp, bpp);
+                        }
+                    }
+
+                    for (int i = block.height; i < info.height; ++i)
+                    {
+                        std::memcpy(temp.address<u8>(0, i), temp.address<u8>(0, block.height - 1), info.width * bpp);
+                    }
+
+                    encode(info, data, temp.image, int(temp.stride));
+                }
+
+                data += info.bytes;
             }
         }
     }
 
-    void TextureCompressionInfo::compress(Memory memory, const Surface& surface) const
+    void TextureCompressionInfo::compress(Memory memory, const Surface& surface, Quality quality) const
     {
         if (!encode)
             return;
@@ -539,25 +699,18 @@ namespace mango
 
         u8* address = memory.address;
 
+        // split the surface into tasks of about a thousand blocks
         const int xblocks = round_multiple_up(surface.width, width);
         const int yblocks = round_multiple_up(surface.height, height);
+        const int rows = std::max(1, 1024 / xblocks);
 
-        for (int y = 0; y < yblocks; ++y)
+        for (int y = 0; y < yblocks; y += rows)
         {
-            queue.enqueue([this, y, xblocks, &surface, address]
-            {
-                Bitmap temp(width, height, format);
-                u8* data = address + y * xblocks * bytes;
+            const int y1 = std::min(y + rows, yblocks);
 
-                for (int x = 0; x < xblocks; ++x)
-                {
-                    Surface source(surface, x * width, y * height, width, height);
-                    temp.blit(0, 0, source);
-
-                    u8* image = temp.address<u8>();
-                    encode(*this, data, image, temp.stride);
-                    data += bytes;
-                }
+            queue.enqueue([this, address, &surface, y, y1, quality]
+            {
+                compressBlocks(*this, address, surface, y, y1, quality);
             });
         }
 
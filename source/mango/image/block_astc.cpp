@@ -0,0 +1,1389 @@
+/*
+    MANGO Multimedia Development Platform
+    Copyright (C) 2012-2019 Twilight Finland 3D Oy Ltd. All rights reserved.
+*/
+#include <cmath>
+#include <cfloat>
+#include <climits>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <mango/core/core.hpp>
+#include <mango/math/math.hpp>
+#include <mango/image/image.hpp>
+
+// ----------------------------------------------------------------------------
+// ASTC LDR encoder
+// ----------------------------------------------------------------------------
+
+// The blocks are encoded with a single partition using the direct RGB (CEM 8) or RGBA
+// (CEM 12) endpoint modes. The endpoints start from the principal axis of the texels;
+// each candidate weight grid and quantization is reconstructed and measured with the
+// same interpolation as the decoder, and the endpoints are refitted to the weights with
+// least squares. When the alpha does not follow the color the alpha gets a second weight
+// plane. The fast preset encodes the first candidate of each plane count, the thorough
+// one keeps the best of several candidates. The caller can add a two partition candidate
+// with a known partition seed, for example the texels of two different source blocks.
+
+namespace
+{
+    using namespace mango;
+
+    enum
+    {
+        MAX_TEXELS = 12 * 12,
+        MAX_WEIGHTS = 64
+    };
+
+    // ----------------------------------------------------------------------------
+    // integer sequence encoding
+    // ----------------------------------------------------------------------------
+
+    enum SequenceMode
+    {
+        BITS,
+        TRITS,
+        QUINTS
+    };
+
+    struct Range
+    {
+        SequenceMode mode;
+        int bits;
+
+        int levels() const
+        {
+            return (mode == TRITS ? 3 : mode == QUINTS ? 5 : 1) << bits;
+        }
+
+        int getSequenceBits(int count) const
+        {
+            switch (mode)
+            {
+                case TRITS:  return (count * 8 + 4) / 5 + count * bits;
+                case QUINTS: return (count * 7 + 2) / 3 + count * bits;
+                default:     return count * bits;
+            }
+        }
+    };
+
+    // weight ranges in the order of the quantization index of the block mode
+    const Range g_weight_ranges[] =
+    {
+        { BITS,   1 }, { TRITS,  0 }, { BITS,   2 }, { QUINTS, 0 },
+        { TRITS,  1 }, { BITS,   3 }, { QUINTS, 1 }, { TRITS,  2 },
+        { BITS,   4 }, { QUINTS, 2 }, { TRITS,  3 }, { BITS,   5 }
+    };
+
+    // color endpoint ranges from the largest down; the endpoints use the largest
+    // range which fits in the bits left by the weights
+    const Range g_color_ranges[] =
+    {
+        { BITS,   8 }, { TRITS,  6 }, { QUINTS, 5 }, { BITS,   7 }, { TRITS,  5 },
+        { QUINTS, 4 }, { BITS,   6 }, { TRITS,  4 }, { QUINTS, 3 }, { BITS,   5 },
+        { TRITS,  3 }, { QUINTS, 2 }, { BITS,   4 }, { TRITS,  2 }, { QUINTS, 1 },
+        { BITS,   3 }, { TRITS,  1 }, { BITS,   2 }, { BITS,   1 }
+    };
+
+    const int WEIGHT_RANGES = int(sizeof(g_weight_ranges) / sizeof(g_weight_ranges[0]));
+    const int COLOR_RANGES = int(sizeof(g_color_ranges) / sizeof(g_color_ranges[0]));
+
+    inline int getBit(int value, int index)
+    {
+        return (value >> index) & 1;
+    }
+
+    inline int replicate(int value, int bits, int target)
+    {
+        int result = 0;
+
+        for (int shift = target - bits; shift > -bits; shift -= bits)
+        {
+            result |= shift >= 0 ? value << shift : value >> -shift;
+        }
+
+        return result;
+    }
+
+    void decodeTrits(int* trit, int T)
+    {
+        int C;
+
+        if (((T >> 2) & 7) == 7)
+        {
+            C = (((T >> 5) & 7) << 2) | (T & 3);
+            trit[4] = 2;
+            trit[3] = 2;
+        }
+        else
+        {
+            C = T & 0x1f;
+
+            if (((T >> 5) & 3) == 3)
+            {
+                trit[4] = 2;
+                trit[3] = getBit(T, 7);
+            }
+            else
+            {
+                trit[4] = getBit(T, 7);
+                trit[3] = (T >> 5) & 3;
+            }
+        }
+
+        if ((C & 3) == 3)
+        {
+            trit[2] = 2;
+            trit[1] = getBit(C, 4);
+            trit[0] = (getBit(C, 3) << 1) | (getBit(C, 2) & ~getBit(C, 3) & 1);
+        }
+        else if (((C >> 2) & 3) == 3)
+        {
+            trit[2] = 2;
+            trit[1] = 2;
+            trit[0] = C & 3;
+        }
+        else
+        {
+            trit[2] = getBit(C, 4);
+            trit[1] = (C >> 2) & 3;
+            trit[0] = (getBit(C, 1) << 1) | (getBit(C, 0) & ~getBit(C, 1) & 1);
+        }
+    }
+
+    void decodeQuints(int* quint, int Q)
+    {
+        if (((Q >> 1) & 3) == 3 && ((Q >> 5) & 3) == 0)
+        {
+            const int q0 = getBit(Q, 0);
+            quint[2] = (q0 << 2) | ((getBit(Q, 4) & ~q0 & 1) << 1) | (getBit(Q, 3) & ~q0 & 1);
+            quint[1] = 4;
+            quint[0] = 4;
+        }
+        else
+        {
+            int C;
+
+            if (((Q >> 1) & 3) == 3)
+            {
+                quint[2] = 4;
+                C = (((Q >> 3) & 3) << 3) | ((~(Q >> 5) & 3) << 1) | (Q & 1);
+            }
+            else
+            {
+                quint[2] = (Q >> 5) & 3;
+                C = Q & 0x1f;
+            }
+
+            if ((C & 7) == 5)
+            {
+                quint[1] = 4;
+                quint[0] = (C >> 3) & 3;
+            }
+            else
+            {
+                quint[1] = (C >> 3) & 3;
+                quint[0] = C & 7;
+            }
+        }
+    }
+
+    int unquantizeColor(const Range& range, int value)
+    {
+        if (range.mode == BITS)
+        {
+            return replicate(value, range.bits, 8);
+        }
+
+        const int m = value & ((1 << range.bits) - 1);
+        const int tq = value >> range.bits;
+        const int b = getBit(m, 1);
+        const int c = getBit(m, 2);
+        const int d = getBit(m, 3);
+        const int e = getBit(m, 4);
+        const int f = getBit(m, 5);
+        const int A = getBit(m, 0) ? 0x1ff : 0;
+
+        static const int table[] = { 204, 113, 93, 54, 44, 26, 22, 13, 11, 6, 5 };
+        const int rangeCase = range.bits * 2 - (range.mode == TRITS ? 2 : 1);
+
+        int B = 0;
+
+        switch (rangeCase)
+        {
+            case 2:  B = (b << 8) | (b << 4) | (b << 2) | (b << 1); break;
+            case 3:  B = (b << 8) | (b << 3) | (b << 2); break;
+            case 4:  B = (c << 8) | (b << 7) | (c << 3) | (b << 2) | (c << 1) | b; break;
+            case 5:  B = (c << 8) | (b << 7) | (c << 2) | (b << 1) | c; break;
+            case 6:  B = (d << 8) | (c << 7) | (b << 6) | (d << 2) | (c << 1) | b; break;
+            case 7:  B = (d << 8) | (c << 7) | (b << 6) | (d << 1) | c; break;
+            case 8:  B = (e << 8) | (d << 7) | (c << 6) | (b << 5) | (e << 1) | d; break;
+            case 9:  B = (e << 8) | (d << 7) | (c << 6) | (b << 5) | e; break;
+            case 10: B = (f << 8) | (e << 7) | (d << 6) | (c << 5) | (b << 4) | f; break;
+            default: break;
+        }
+
+        return (((tq * table[rangeCase] + B) ^ A) >> 2) | (A & 0x80);
+    }
+
+    int unquantizeWeight(const Range& range, int value)
+    {
+        int result;
+
+        if (range.mode == BITS)
+        {
+            result = replicate(value, range.bits, 6);
+        }
+        else if (range.bits == 0)
+        {
+            static const int trits[] = { 0, 32, 63 };
+            static const int quints[] = { 0, 16, 32, 47, 63 };
+            result = range.mode == TRITS ? trits[value] : quints[value];
+        }
+        else
+        {
+            const int m = value & ((1 << range.bits) - 1);
+            const int tq = value >> range.bits;
+            const int b = getBit(m, 1);
+            const int c = getBit(m, 2);
+            const int A = getBit(m, 0) ? 0x7f : 0;
+
+            static const int table[] = { 50, 28, 23, 13, 11 };
+            const int rangeCase = range.bits * 2 + (range.mode == QUINTS ? 1 : 0);
+
+            int B = 0;
+
+            switch (rangeCase)
+            {
+                case 4: B = (b << 6) | (b << 2) | b; break;
+                case 5: B = (b << 6) | (b << 1); break;
+                case 6: B = (c << 6) | (b << 5) | (c << 1) | b; break;
+                default: break;
+            }
+
+            result = (((tq * table[rangeCase - 2] + B) ^ A) >> 2) | (A & 0x20);
+        }
+
+        return result + (result > 32);
+    }
+
+    // Decodes the block mode; returns false for the void extent and the reserved encodings.
+    bool decodeBlockMode(int bits, int& width, int& height, int& quant, bool& dual)
+    {
+        if ((bits & 0x1ff) == 0x1fc)
+            return false;
+
+        if (((bits & 3) == 0 && ((bits >> 6) & 7) == 7) || (bits & 15) == 0)
+            return false;
+
+        const int a = (bits >> 5) & 3;
+        bool high = getBit(bits, 9) != 0;
+        dual = getBit(bits, 10) != 0;
+        int r;
+
+        if (bits & 3)
+        {
+            r = ((bits & 3) << 1) | getBit(bits, 4);
+            const int b = (bits >> 7) & 3;
+
+            switch ((bits >> 2) & 3)
+            {
+                case 0: width = b + 4; height = a + 2; break;
+                case 1: width = b + 8; height = a + 2; break;
+                case 2: width = a + 2; height = b + 8; break;
+                default:
+                    if (bits & 0x100)
+                    {
+                        width = (b & 1) + 2;
+                        height = a + 2;
+                    }
+                    else
+                    {
+                        width = a + 2;
+                        height = (b & 1) + 6;
+                    }
+                    break;
+            }
+        }
+        else
+        {
+            r = (((bits >> 2) & 3) << 1) | getBit(bits, 4);
+
+            switch ((bits >> 7) & 3)
+            {
+                case 0: width = 12; height = a + 2; break;
+                case 1: width = a + 2; height = 12; break;
+                case 2:
+                    width = a + 6;
+                    height = ((bits >> 9) & 3) + 6;
+                    high = false;
+                    dual = false;
+                    break;
+                default:
+                    width = getBit(bits, 5) ? 10 : 6;
+                    height = getBit(bits, 5) ? 6 : 10;
+                    break;
+            }
+        }
+
+        quant = r - 2 + (high ? 6 : 0);
+        return true;
+    }
+
+    // ----------------------------------------------------------------------------
+    // tables
+    // ----------------------------------------------------------------------------
+
+    struct Config
+    {
+        int mode;
+        int gridWidth;
+        int gridHeight;
+        int weightRange;
+        int weightBits;
+        int colorRange;
+        int colorBits;
+        bool dual;
+    };
+
+    struct Tables
+    {
+        // trits and quints packed into the 8 and 7 bit blocks
+        u8 tritBlock[243];
+        u8 quintBlock[125];
+
+        // nearest code of each 8 bit color and 6 bit weight
+        u8 colorCode[COLOR_RANGES][256];
+        u8 colorValue[COLOR_RANGES][256];
+        u8 weightCode[WEIGHT_RANGES][65];
+        u8 weightValue[WEIGHT_RANGES][32];
+
+        // candidate configurations of each partition count, number of weight planes, block size
+        // and endpoint mode; the second plane is the alpha of the single partition RGBA endpoints
+        std::vector<Config> configs[2][2][13][13][2];
+
+        Tables()
+        {
+            // the smallest block of each combination; the blocks with trailing zeros
+            // then fit into the bits of a partial block
+            for (int T = 255; T >= 0; --T)
+            {
+                int t[5];
+                decodeTrits(t, T);
+                tritBlock[t[0] + t[1] * 3 + t[2] * 9 + t[3] * 27 + t[4] * 81] = u8(T);
+            }
+
+            for (int Q = 127; Q >= 0; --Q)
+            {
+                int q[3];
+                decodeQuints(q, Q);
+                quintBlock[q[0] + q[1] * 5 + q[2] * 25] = u8(Q);
+            }
+
+            for (int i = 0; i < COLOR_RANGES; ++i)
+            {
+                const Range& range = g_color_ranges[i];
+                const int levels = range.levels();
+
+                for (int code = 0; code < levels; ++code)
+                {
+                    colorValue[i][code] = u8(unquantizeColor(range, code));
+                }
+
+                for (int value = 0; value < 256; ++value)
+                {
+                    int best = 0;
+                    for (int code = 1; code < levels; ++code)
+                    {
+                        if (std::abs(colorValue[i][code] - value) < std::abs(colorValue[i][best] - value))
+                            best = code;
+                    }
+
+                    colorCode[i][value] = u8(best);
+                }
+            }
+
+            for (int i = 0; i < WEIGHT_RANGES; ++i)
+            {
+                const Range& range = g_weight_ranges[i];
+                const int levels = range.levels();
+
+                for (int code = 0; code < levels; ++code)
+                {
+                    weightValue[i][code] = u8(unquantizeWeight(range, code));
+                }
+
+                for (int value = 0; value <= 64; ++value)
+                {
+                    int best = 0;
+                    for (int code = 1; code < levels; ++code)
+                    {
+                        if (std::abs(weightValue[i][code] - value) < std::abs(weightValue[i][best] - value))
+                            best = code;
+                    }
+
+                    weightCode[i][value] = u8(best);
+                }
+            }
+
+            for (int width = 4; width <= 12; ++width)
+            {
+                for (int height = 4; height <= 12; ++height)
+                {
+                    for (int alpha = 0; alpha < 2; ++alpha)
+                    {
+                        buildConfigs(configs[0][0][width][height][alpha], width, height, 1, alpha ? 8 : 6, false);
+                        buildConfigs(configs[1][0][width][height][alpha], width, height, 2, alpha ? 8 : 6, false);
+                    }
+
+                    buildConfigs(configs[0][1][width][height][1], width, height, 1, 8, true);
+                }
+            }
+        }
+
+        static void buildConfigs(std::vector<Config>& output, int width, int height, int partitions, int values, bool dual)
+        {
+            // block mode, partition count, the partition index and shared endpoint mode
+            // of the partitioned blocks, and the channel of the second plane
+            const int headerBits = (partitions > 1 ? 29 : 17) + (dual ? 2 : 0);
+            values *= partitions;
+
+            for (int mode = 0; mode < 2048; ++mode)
+            {
+                Config config;
+
+                if (!decodeBlockMode(mode, config.gridWidth, config.gridHeight, config.weightRange, config.dual))
+                    continue;
+
+                if (config.gridWidth > width || config.gridHeight > height || config.dual != dual)
+                    continue;
+
+                const int count = config.gridWidth * config.gridHeight * (dual ? 2 : 1);
+                config.mode = mode;
+                config.weightBits = g_weight_ranges[config.weightRange].getSequenceBits(count);
+
+                if (count > MAX_WEIGHTS || config.weightBits < 24 || config.weightBits > 96)
+                    continue;
+
+                // the bits after the block mode, partition count and endpoint mode
+                config.colorBits = 128 - headerBits - config.weightBits;
+
+                if (config.colorBits < (values * 13 + 4) / 5)
+                    continue;
+
+                config.colorRange = 0;
+                while (g_color_ranges[config.colorRange].getSequenceBits(values) > config.colorBits)
+                {
+                    ++config.colorRange;
+                }
+
+                // the same grid and quantization can be encoded with more than one mode
+                bool duplicate = false;
+                for (const Config& other : output)
+                {
+                    duplicate |= other.gridWidth == config.gridWidth &&
+                                 other.gridHeight == config.gridHeight &&
+                                 other.weightRange == config.weightRange;
+                }
+
+                if (!duplicate)
+                {
+                    output.push_back(config);
+                }
+            }
+
+            // the configurations with at least 64 endpoint levels first, then in the order
+            // of the information in the weight grid
+            auto score = [] (const Config& config)
+            {
+                const int levels = g_color_ranges[config.colorRange].levels();
+                const float weights = config.gridWidth * config.gridHeight * (config.dual ? 2 : 1) *
+                    std::log2(float(g_weight_ranges[config.weightRange].levels()));
+                return weights + (levels >= 64 ? 10000.0f : 0.0f);
+            };
+
+            std::stable_sort(output.begin(), output.end(), [&] (const Config& a, const Config& b)
+            {
+                return score(a) > score(b);
+            });
+        }
+    };
+
+    const Tables& getTables()
+    {
+        static const Tables tables;
+        return tables;
+    }
+
+    // ----------------------------------------------------------------------------
+    // bit packing
+    // ----------------------------------------------------------------------------
+
+    struct BitWriter
+    {
+        u64 data[2] = { 0, 0 };
+        int position;
+        int end;
+
+        BitWriter(int position, int end)
+            : position(position)
+            , end(end)
+        {
+        }
+
+        void write(u32 value, int count)
+        {
+            for (int i = 0; i < count && position < end; ++i, ++position)
+            {
+                data[position >> 6] |= u64((value >> i) & 1) << (position & 63);
+            }
+        }
+    };
+
+    void writeSequence(BitWriter& writer, const Tables& tables, const u8* values, int count, const Range& range)
+    {
+        const int bits = range.bits;
+        const u32 mask = (1 << bits) - 1;
+
+        if (range.mode == TRITS)
+        {
+            for (int i = 0; i < count; i += 5)
+            {
+                u32 m[5] = { 0, 0, 0, 0, 0 };
+                int index = 0;
+
+                for (int j = 0, scale = 1; j < 5 && i + j < count; ++j, scale *= 3)
+                {
+                    m[j] = values[i + j] & mask;
+                    index += (values[i + j] >> bits) * scale;
+                }
+
+                const u32 T = tables.tritBlock[index];
+
+                writer.write(m[0], bits);
+                writer.write(T, 2);
+                writer.write(m[1], bits);
+                writer.write(T >> 2, 2);
+                writer.write(m[2], bits);
+                writer.write(T >> 4, 1);
+                writer.write(m[3], bits);
+                writer.write(T >> 5, 2);
+                writer.write(m[4], bits);
+                writer.write(T >> 7, 1);
+            }
+        }
+        else if (range.mode == QUINTS)
+        {
+            for (int i = 0; i < count; i += 3)
+            {
+                u32 m[3] = { 0, 0, 0 };
+                int index = 0;
+
+                for (int j = 0, scale = 1; j < 3 && i + j < count; ++j, scale *= 5)
+                {
+                    m[j] = values[i + j] & mask;
+                    index += (values[i + j] >> bits) * scale;
+                }
+
+                const u32 Q = tables.quintBlock[index];
+
+                writer.write(m[0], bits);
+                writer.write(Q, 3);
+                writer.write(m[1], bits);
+                writer.write(Q >> 3, 2);
+                writer.write(m[2], bits);
+                writer.write(Q >> 5, 2);
+            }
+        }
+        else
+        {
+            for (int i = 0; i < count; ++i)
+            {
+                writer.write(values[i], bits);
+            }
+        }
+    }
+
+    // ----------------------------------------------------------------------------
+    // partitions
+    // ----------------------------------------------------------------------------
+
+    u32 hashPartition(u32 seed)
+    {
+        seed ^= seed >> 15;
+        seed -= seed << 17;
+        seed += seed << 7;
+        seed += seed << 4;
+        seed ^= seed >> 5;
+        seed += seed << 16;
+        seed ^= seed >> 7;
+        seed ^= seed >> 3;
+        seed ^= seed << 6;
+        seed ^= seed >> 17;
+        return seed;
+    }
+
+    // partition of the texel in a two partition block of the seed (the 2D case of the
+    // partition selection of the specification)
+    int selectPartition(int seed, int x, int y, bool small)
+    {
+        if (small)
+        {
+            x <<= 1;
+            y <<= 1;
+        }
+
+        seed += 1024;
+        const u32 rnum = hashPartition(seed);
+
+        int value[4];
+        for (int i = 0; i < 4; ++i)
+        {
+            const int v = (rnum >> (i * 4)) & 15;
+            value[i] = v * v;
+        }
+
+        const int sh1 = seed & 1 ? (seed & 2 ? 4 : 5) : 5;
+        const int sh2 = seed & 1 ? 5 : (seed & 2 ? 4 : 5);
+
+        const int a = ((value[0] >> sh1) * x + (value[1] >> sh2) * y + (rnum >> 14)) & 0x3f;
+        const int b = ((value[2] >> sh1) * x + (value[3] >> sh2) * y + (rnum >> 10)) & 0x3f;
+
+        return a >= b ? 0 : 1;
+    }
+
+    // ----------------------------------------------------------------------------
+    // encoder
+    // ----------------------------------------------------------------------------
+
+    struct TexelBlock
+    {
+        int width;
+        int height;
+        int count;
+        bool alpha;
+        bool separate;
+        int partitions;
+        int seed;
+        u8 partition[MAX_TEXELS];
+        float texel[MAX_TEXELS][4];
+
+        // endpoints of each partition for one weight plane, and for two where the
+        // color and alpha are fitted independently
+        float32x4 endpoint[2][2][2];
+
+        TexelBlock(const u8* input, int stride, int width, int height, int seed = -1)
+            : width(width)
+            , height(height)
+            , count(width * height)
+            , alpha(false)
+            , separate(false)
+            , partitions(seed < 0 ? 1 : 2)
+            , seed(seed)
+        {
+            const bool small = count < 31;
+
+            for (int y = 0; y < height; ++y)
+            {
+                const u8* scan = input + y * stride;
+
+                for (int x = 0; x < width; ++x)
+                {
+                    float* dest = texel[y * width + x];
+                    dest[0] = scan[x * 4 + 0];
+                    dest[1] = scan[x * 4 + 1];
+                    dest[2] = scan[x * 4 + 2];
+                    dest[3] = scan[x * 4 + 3];
+                    alpha |= scan[x * 4 + 3] != 255;
+
+                    partition[y * width + x] = u8(seed < 0 ? 0 : selectPartition(seed, x, y, small));
+                }
+            }
+
+            for (int p = 0; p < partitions; ++p)
+            {
+                computeEndpoints(endpoint[0][p], p, float32x4(1.0f, 1.0f, 1.0f, alpha ? 1.0f : 0.0f));
+            }
+
+            if (alpha)
+            {
+                separate = !isCorrelated();
+
+                for (int p = 0; p < partitions; ++p)
+                {
+                    // the color is on the principal axis of the first plane, the alpha
+                    // has the second plane to itself
+                    float32x4* e = endpoint[1][p];
+                    computeEndpoints(e, p, float32x4(1.0f, 1.0f, 1.0f, 0.0f));
+
+                    float low = 255.0f;
+                    float high = 0.0f;
+
+                    for (int i = 0; i < count; ++i)
+                    {
+                        if (partition[i] == p)
+                        {
+                            low = std::min(low, texel[i][3]);
+                            high = std::max(high, texel[i][3]);
+                        }
+                    }
+
+                    e[0] = float32x4(float(e[0].x), float(e[0].y), float(e[0].z), low);
+                    e[1] = float32x4(float(e[1].x), float(e[1].y), float(e[1].z), high);
+                }
+            }
+        }
+
+        float32x4 load(int index) const
+        {
+            return simd::f32x4_uload(texel[index]);
+        }
+
+        static float dot(float32x4 a, float32x4 b)
+        {
+            const float32x4 v = a * b;
+            return float(v.x) + float(v.y) + float(v.z) + float(v.w);
+        }
+
+        // alpha follows the luminance closely enough to share the weights with the color;
+        // constant color or alpha is on the line of the other
+        bool isCorrelated() const
+        {
+            double sl = 0.0, sa = 0.0, sll = 0.0, saa = 0.0, sla = 0.0;
+
+            for (int i = 0; i < count; ++i)
+            {
+                const double l = double(texel[i][0]) + texel[i][1] + texel[i][2];
+                const double a = texel[i][3];
+                sl += l;
+                sa += a;
+                sll += l * l;
+                saa += a * a;
+                sla += l * a;
+            }
+
+            const double vl = sll - sl * sl / count;
+            const double va = saa - sa * sa / count;
+            const double cov = sla - sl * sa / count;
+
+            if (vl < 1.0 || va < 1.0)
+                return true;
+
+            return cov * cov >= 0.9 * vl * va;
+        }
+
+        // endpoints at the extent of the texels of the partition along the principal axis
+        // of the channels in the mask
+        void computeEndpoints(float32x4* output, int p, float32x4 mask) const
+        {
+            float32x4 mean = 0.0f;
+            int n = 0;
+
+            for (int i = 0; i < count; ++i)
+            {
+                if (partition[i] == p)
+                {
+                    mean = mean + load(i);
+                    ++n;
+                }
+            }
+
+            mean = mean * float32x4(1.0f / std::max(1, n));
+
+            float32x4 axis = mask;
+
+            for (int iteration = 0; iteration < 2; ++iteration)
+            {
+                float32x4 next = 0.0f;
+
+                for (int i = 0; i < count; ++i)
+                {
+                    if (partition[i] == p)
+                    {
+                        const float32x4 d = (load(i) - mean) * mask;
+                        next = next + d * float32x4(dot(d, axis));
+                    }
+                }
+
+                const float length = std::sqrt(dot(next, next));
+                if (length < 1e-6f)
+                {
+                    output[0] = mean;
+                    output[1] = mean;
+                    return;
+                }
+
+                axis = next * float32x4(1.0f / length);
+            }
+
+            float low = FLT_MAX;
+            float high = -FLT_MAX;
+
+            for (int i = 0; i < count; ++i)
+            {
+                if (partition[i] == p)
+                {
+                    const float t = dot(load(i) - mean, axis);
+                    low = std::min(low, t);
+                    high = std::max(high, t);
+                }
+            }
+
+            output[0] = clamp(mean + axis * float32x4(low), float32x4(0.0f), float32x4(255.0f));
+            output[1] = clamp(mean + axis * float32x4(high), float32x4(0.0f), float32x4(255.0f));
+        }
+    };
+
+    // The texels sample the weight grid bilinearly; each texel has four grid weights
+    // with the fractions in 1/16th.
+    struct Infill
+    {
+        int index[MAX_TEXELS][4];
+        int weight[MAX_TEXELS][4];
+
+        Infill(const TexelBlock& block, const Config& config)
+        {
+            const int scaleX = (1024 + block.width / 2) / (block.width - 1);
+            const int scaleY = (1024 + block.height / 2) / (block.height - 1);
+
+            for (int y = 0; y < block.height; ++y)
+            {
+                for (int x = 0; x < block.width; ++x)
+                {
+                    const int gx = (scaleX * x * (config.gridWidth - 1) + 32) >> 6;
+                    const int gy = (scaleY * y * (config.gridHeight - 1) + 32) >> 6;
+                    const int jx = gx >> 4;
+                    const int jy = gy >> 4;
+                    const int fx = gx & 15;
+                    const int fy = gy & 15;
+                    const int w11 = (fx * fy + 8) >> 4;
+                    const int v0 = jy * config.gridWidth + jx;
+
+                    const int i = y * block.width + x;
+
+                    index[i][0] = v0;
+                    index[i][1] = v0 + 1;
+                    index[i][2] = v0 + config.gridWidth;
+                    index[i][3] = v0 + config.gridWidth + 1;
+                    weight[i][0] = 16 - fx - fy + w11;
+                    weight[i][1] = fx - w11;
+                    weight[i][2] = fy - w11;
+                    weight[i][3] = w11;
+                }
+            }
+        }
+
+        float interpolate(const float* grid, int i) const
+        {
+            float sum = 0.0f;
+
+            for (int j = 0; j < 4; ++j)
+            {
+                if (weight[i][j])
+                    sum += grid[index[i][j]] * weight[i][j];
+            }
+
+            return sum * (1.0f / 16.0f);
+        }
+
+        int interpolate(const u8* grid, int i) const
+        {
+            int sum = 8;
+
+            for (int j = 0; j < 4; ++j)
+            {
+                // the indices past the grid have zero weight
+                if (weight[i][j])
+                    sum += grid[index[i][j]] * weight[i][j];
+            }
+
+            return sum >> 4;
+        }
+    };
+
+    struct Encoding
+    {
+        u8 color[2][8];  // codes of each partition in the order r0, r1, g0, g1, b0, b1, a0, a1
+        u8 weight[MAX_WEIGHTS];  // the planes are interleaved
+        float32x4 endpoint[2][2];
+        float error;
+    };
+
+    // the texel weights of each plane
+    typedef u8 TexelWeights[2][MAX_TEXELS];
+
+    // channels of each weight plane
+    inline float32x4 getPlaneMask(const Config& config, int plane)
+    {
+        if (!config.dual)
+            return float32x4(1.0f);
+
+        return plane ? float32x4(0.0f, 0.0f, 0.0f, 1.0f) : float32x4(1.0f, 1.0f, 1.0f, 0.0f);
+    }
+
+    void quantizeEndpoints(Encoding& encoding, int p, const Tables& tables, const Config& config,
+                           float32x4 e0, float32x4 e1, bool alpha)
+    {
+        float value[2][4];
+        simd::f32x4_ustore(value[0], clamp(e0, float32x4(0.0f), float32x4(255.0f)));
+        simd::f32x4_ustore(value[1], clamp(e1, float32x4(0.0f), float32x4(255.0f)));
+
+        int code[2][4];
+        int unquantized[2][4];
+
+        for (int i = 0; i < 2; ++i)
+        {
+            for (int c = 0; c < 4; ++c)
+            {
+                code[i][c] = tables.colorCode[config.colorRange][int(value[i][c] + 0.5f)];
+                unquantized[i][c] = tables.colorValue[config.colorRange][code[i][c]];
+            }
+
+            if (!alpha)
+            {
+                unquantized[i][3] = 255;
+            }
+        }
+
+        // the decoder swaps and blue contracts the endpoints when the second one has
+        // the smaller sum; the endpoints are stored in the order which avoids that
+        const int sum0 = unquantized[0][0] + unquantized[0][1] + unquantized[0][2];
+        const int sum1 = unquantized[1][0] + unquantized[1][1] + unquantized[1][2];
+        const int first = sum1 >= sum0 ? 0 : 1;
+
+        for (int c = 0; c < 4; ++c)
+        {
+            encoding.color[p][c * 2 + 0] = u8(code[first][c]);
+            encoding.color[p][c * 2 + 1] = u8(code[first ^ 1][c]);
+        }
+
+        const int* u0 = unquantized[first];
+        const int* u1 = unquantized[first ^ 1];
+        encoding.endpoint[p][0] = float32x4(float(u0[0]), float(u0[1]), float(u0[2]), float(u0[3]));
+        encoding.endpoint[p][1] = float32x4(float(u1[0]), float(u1[1]), float(u1[2]), float(u1[3]));
+    }
+
+    // Quantized weight grids for the endpoints of the encoding; returns the texel weights.
+    void computeWeights(Encoding& encoding, TexelWeights& texelWeight, const Tables& tables, const TexelBlock& block,
+                        const Config& config, const Infill& infill)
+    {
+        const int planes = config.dual ? 2 : 1;
+        const int gridCount = config.gridWidth * config.gridHeight;
+
+        for (int plane = 0; plane < planes; ++plane)
+        {
+            const float32x4 mask = getPlaneMask(config, plane);
+
+            float32x4 delta[2];
+            float scale[2];
+
+            for (int p = 0; p < block.partitions; ++p)
+            {
+                delta[p] = (encoding.endpoint[p][1] - encoding.endpoint[p][0]) * mask;
+                const float length = TexelBlock::dot(delta[p], delta[p]);
+                scale[p] = length > 0.0f ? 64.0f / length : 0.0f;
+            }
+
+            float ideal[MAX_TEXELS];
+
+            for (int i = 0; i < block.count; ++i)
+            {
+                const int p = block.partition[i];
+                const float t = TexelBlock::dot(block.load(i) - encoding.endpoint[p][0], delta[p]) * scale[p];
+                ideal[i] = std::min(64.0f, std::max(0.0f, t));
+            }
+
+            // each grid weight is the average of the texels it contributes to
+            float sum[MAX_WEIGHTS] = { };
+            float total[MAX_WEIGHTS] = { };
+
+            for (int i = 0; i < block.count; ++i)
+            {
+                for (int j = 0; j < 4; ++j)
+                {
+                    const int w = infill.weight[i][j];
+                    if (w)
+                    {
+                        sum[infill.index[i][j]] += ideal[i] * w;
+                        total[infill.index[i][j]] += float(w);
+                    }
+                }
+            }
+
+            float value[MAX_WEIGHTS];
+
+            for (int i = 0; i < gridCount; ++i)
+            {
+                value[i] = total[i] > 0.0f ? sum[i] / total[i] : 0.0f;
+            }
+
+            if (gridCount < block.count)
+            {
+                // the average pulls the weights of a decimated grid towards the middle;
+                // steps on the residual of the interpolated weights restore the range
+                for (int iteration = 0; iteration < 2; ++iteration)
+                {
+                    float correction[MAX_WEIGHTS] = { };
+
+                    for (int i = 0; i < block.count; ++i)
+                    {
+                        const float residual = ideal[i] - infill.interpolate(value, i);
+
+                        for (int j = 0; j < 4; ++j)
+                        {
+                            const int w = infill.weight[i][j];
+                            if (w)
+                                correction[infill.index[i][j]] += residual * w;
+                        }
+                    }
+
+                    for (int i = 0; i < gridCount; ++i)
+                    {
+                        if (total[i] > 0.0f)
+                            value[i] = std::min(64.0f, std::max(0.0f, value[i] + correction[i] / total[i]));
+                    }
+                }
+            }
+
+            u8 grid[MAX_WEIGHTS];
+
+            for (int i = 0; i < gridCount; ++i)
+            {
+                const int code = tables.weightCode[config.weightRange][int(value[i] + 0.5f)];
+                encoding.weight[i * planes + plane] = u8(code);
+                grid[i] = tables.weightValue[config.weightRange][code];
+            }
+
+            for (int i = 0; i < block.count; ++i)
+            {
+                texelWeight[plane][i] = u8(infill.interpolate(grid, i));
+            }
+        }
+    }
+
+    // least squares endpoints of the texel weights of the partition
+    bool refitEndpoints(float32x4* endpoint, const TexelBlock& block, const u8* texelWeight, int p)
+    {
+        float a = 0.0f;
+        float b = 0.0f;
+        float c = 0.0f;
+        float32x4 d0 = 0.0f;
+        float32x4 d1 = 0.0f;
+
+        for (int i = 0; i < block.count; ++i)
+        {
+            if (block.partition[i] != p)
+                continue;
+
+            const float w = texelWeight[i] / 64.0f;
+            const float iw = 1.0f - w;
+            const float32x4 v = block.load(i);
+
+            a += iw * iw;
+            b += iw * w;
+            c += w * w;
+            d0 = d0 + v * float32x4(iw);
+            d1 = d1 + v * float32x4(w);
+        }
+
+        const float det = a * c - b * b;
+        if (std::abs(det) < 1e-3f)
+            return false;
+
+        const float32x4 inv = 1.0f / det;
+        endpoint[0] = (d0 * float32x4(c) - d1 * float32x4(b)) * inv;
+        endpoint[1] = (d1 * float32x4(a) - d0 * float32x4(b)) * inv;
+        return true;
+    }
+
+    float computeError(const TexelBlock& block, const Encoding& encoding, const TexelWeights& texelWeight,
+                       const Config& config)
+    {
+        const u8* alphaWeight = texelWeight[config.dual ? 1 : 0];
+
+        float32x4 error = 0.0f;
+
+        for (int i = 0; i < block.count; ++i)
+        {
+            const int p = block.partition[i];
+            const float32x4 e0 = encoding.endpoint[p][0];
+            const float32x4 delta = encoding.endpoint[p][1] - e0;
+            const float w = texelWeight[0][i] / 64.0f;
+            const float32x4 color = e0 + delta * float32x4(w, w, w, alphaWeight[i] / 64.0f);
+            const float32x4 d = color - block.load(i);
+            error = error + d * d;
+        }
+
+        return float(error.x) + float(error.y) + float(error.z) + float(error.w);
+    }
+
+    void encodeConfig(Encoding& encoding, const Tables& tables, const TexelBlock& block, const Config& config, bool refine)
+    {
+        const Infill infill(block, config);
+        const int planes = config.dual ? 2 : 1;
+        TexelWeights texelWeight;
+
+        for (int p = 0; p < block.partitions; ++p)
+        {
+            const float32x4* endpoint = block.endpoint[planes - 1][p];
+            quantizeEndpoints(encoding, p, tables, config, endpoint[0], endpoint[1], block.alpha);
+        }
+
+        computeWeights(encoding, texelWeight, tables, block, config, infill);
+        encoding.error = computeError(block, encoding, texelWeight, config);
+
+        if (refine)
+        {
+            Encoding refined = encoding;
+            bool refitted = false;
+
+            for (int p = 0; p < block.partitions; ++p)
+            {
+                float32x4 endpoint[2];
+
+                if (!refitEndpoints(endpoint, block, texelWeight[0], p))
+                    continue;
+
+                if (config.dual)
+                {
+                    // the alpha of the second plane is fitted to its own weights
+                    float32x4 alpha[2] = { encoding.endpoint[p][0], encoding.endpoint[p][1] };
+                    refitEndpoints(alpha, block, texelWeight[1], p);
+
+                    const float32x4 mask = getPlaneMask(config, 0);
+                    endpoint[0] = endpoint[0] * mask + alpha[0] * (1.0f - mask);
+                    endpoint[1] = endpoint[1] * mask + alpha[1] * (1.0f - mask);
+                }
+
+                quantizeEndpoints(refined, p, tables, config, endpoint[0], endpoint[1], block.alpha);
+                refitted = true;
+            }
+
+            if (refitted)
+            {
+                TexelWeights refinedWeight;
+
+                computeWeights(refined, refinedWeight, tables, block, config, infill);
+                refined.error = computeError(block, refined, refinedWeight, config);
+
+                if (refined.error < encoding.error)
+                {
+                    encoding = refined;
+                }
+            }
+        }
+    }
+
+    void packBlock(u8* output, const Tables& tables, const Encoding& encoding, const Config& config,
+                   bool alpha, int partitions, int seed)
+    {
+        const int endpointMode = alpha ? 12 : 8;
+
+        BitWriter writer(0, 128);
+        writer.write(config.mode, 11);
+
+        int colorOffset;
+
+        if (partitions > 1)
+        {
+            // the partitions share the endpoint mode
+            writer.write(partitions - 1, 2);
+            writer.write(seed, 10);
+            writer.write(0, 2);
+            writer.write(endpointMode, 4);
+            colorOffset = 29;
+        }
+        else
+        {
+            writer.write(0, 2); // single partition
+            writer.write(endpointMode, 4);
+            colorOffset = 17;
+        }
+
+        if (config.dual)
+        {
+            // the alpha channel has the second plane; the selector is below the weights
+            BitWriter selector(128 - config.weightBits - 2, 128);
+            selector.write(3, 2);
+            writer.data[0] |= selector.data[0];
+            writer.data[1] |= selector.data[1];
+        }
+
+        const Range& colorRange = g_color_ranges[config.colorRange];
+        const int valueCount = alpha ? 8 : 6;
+        const int colorCount = valueCount * partitions;
+
+        u8 values[16];
+        for (int p = 0; p < partitions; ++p)
+        {
+            std::memcpy(values + p * valueCount, encoding.color[p], valueCount);
+        }
+
+        BitWriter colors(colorOffset, colorOffset + colorRange.getSequenceBits(colorCount));
+        writeSequence(colors, tables, values, colorCount, colorRange);
+
+        // the weights are stored in reverse bit order from the end of the block
+        const Range& weightRange = g_weight_ranges[config.weightRange];
+        const int weightCount = config.gridWidth * config.gridHeight * (config.dual ? 2 : 1);
+        BitWriter weights(0, config.weightBits);
+        writeSequence(weights, tables, encoding.weight, weightCount, weightRange);
+
+        u64 data[2] =
+        {
+            writer.data[0] | colors.data[0],
+            writer.data[1] | colors.data[1]
+        };
+
+        for (int i = 0; i < config.weightBits; ++i)
+        {
+            const u64 bit = (weights.data[i >> 6] >> (i & 63)) & 1;
+            const int position = 127 - i;
+            data[position >> 6] |= bit << (position & 63);
+        }
+
+        ustore64le(output + 0, data[0]);
+        ustore64le(output + 8, data[1]);
+    }
+
+    struct BlockEncoder
+    {
+        const Tables& tables;
+        const TextureCompressionInfo& info;
+
+        Encoding best;
+        Config config;
+        int partitions = 1;
+        int seed = 0;
+
+        BlockEncoder(const TextureCompressionInfo& info)
+            : tables(getTables())
+            , info(info)
+        {
+            best.error = FLT_MAX;
+        }
+
+        const std::vector<Config>& getConfigs(const TexelBlock& block, bool dual) const
+        {
+            return tables.configs[block.partitions - 1][dual][info.width][info.height][block.alpha];
+        }
+
+        // encodes the configurations [first, last) of the block; returns the best one
+        int encode(const TexelBlock& block, const std::vector<Config>& configs, int first, int last, bool refine)
+        {
+            last = std::min(last, int(configs.size()));
+
+            int selected = first;
+            float error = FLT_MAX;
+
+            for (int i = first; i < last && best.error > 0.0f; ++i)
+            {
+                Encoding encoding;
+                encodeConfig(encoding, tables, block, configs[i], refine);
+
+                if (encoding.error < error)
+                {
+                    error = encoding.error;
+                    selected = i;
+                }
+
+                if (encoding.error < best.error)
+                {
+                    best = encoding;
+                    config = configs[i];
+                    partitions = block.partitions;
+                    seed = block.seed;
+                }
+            }
+
+            return selected;
+        }
+
+        // the first configurations are tried without the refit, which is done for the best one
+        void search(const TexelBlock& block, bool dual, int count)
+        {
+            const std::vector<Config>& configs = getConfigs(block, dual);
+            const int selected = count > 1 ? encode(block, configs, 0, count, false) : 0;
+            encode(block, configs, selected, selected + 1, true);
+        }
+    };
+
+    // Keeps the best of the candidate configurations of the single partition block; the
+    // dual plane configurations are candidates when the alpha does not follow the color.
+    // Without the refine each candidate is measured as it is and the best one is refitted.
+    // The configurations are ordered for the single partition, so every configuration of
+    // the two partition block of the seed is tried.
+    void encodeBlockASTC(const TextureCompressionInfo& info, u8* output, const u8* input, int stride,
+                         int candidates, bool refine, int seed = -1)
+    {
+        BlockEncoder encoder(info);
+
+        const TexelBlock block(input, stride, info.width, info.height);
+
+        for (int dual = 0; dual <= int(block.separate); ++dual)
+        {
+            if (refine)
+            {
+                encoder.encode(block, encoder.getConfigs(block, dual != 0), 0, candidates, true);
+            }
+            else
+            {
+                encoder.search(block, dual != 0, candidates);
+            }
+        }
+
+        if (seed >= 0 && encoder.best.error > 0.0f)
+        {
+            const TexelBlock split(input, stride, info.width, info.height, seed);
+            encoder.search(split, false, INT_MAX);
+        }
+
+        packBlock(output, encoder.tables, encoder.best, encoder.config, block.alpha, encoder.partitions, encoder.seed);
+    }
+
+} // namespace
+
+namespace mango
+{
+
+    void encode_block_astc(const TextureCompressionInfo& info, u8* output, const u8* input, int stride)
+    {
+        encodeBlockASTC(info, output, input, stride, 16, true);
+    }
+
+    void encode_block_astc_fast(const TextureCompressionInfo& info, u8* output, const u8* input, int stride)
+    {
+        encodeBlockASTC(info, output, input, stride, 1, false);
+    }
+
+    int get_astc_partition_seed(int width, int height, const u8* partition)
+    {
+        const bool small = width * height < 31;
+
+        for (int seed = 0; seed < 1024; ++seed)
+        {
+            bool match = true;
+            bool inverse = true;
+
+            for (int y = 0; y < height; ++y)
+            {
+                for (int x = 0; x < width; ++x)
+                {
+                    const int p = selectPartition(seed, x, y, small);
+                    match &= p == partition[y * width + x];
+                    inverse &= p != partition[y * width + x];
+                }
+            }
+
+            if (match || inverse)
+                return seed;
+        }
+
+        return -1;
+    }
+
+    void encode_block_astc_partition(const TextureCompressionInfo& info, u8* output, const u8* input, int stride, int seed)
+    {
+        encodeBlockASTC(info, output, input, stride, 4, true, seed);
+    }
+
+} // namespace mango
@@ -0,0 +1,684 @@
+/*
+    MANGO Multimedia Development Platform
+    Copyright (C) 2012-2019 Twilight Finland 3D Oy Ltd. All rights reserved.
+*/
+#include <cstring>
+#include <algorithm>
+#include <mango/core/core.hpp>
+#include <mango/image/image.hpp>
+
+// ----------------------------------------------------------------------------
+// Real-time BC1 / BC3 / BC4 / BC5 encoders
+// ----------------------------------------------------------------------------
+
+// The blocks are encoded in groups of eight straight from the R8G8B8A8 scanlines;
+// each component of a pixel is transposed into a vector of 16 bit lanes with one
+// lane per block, so that every step of the encoder handles the whole group.
+//
+// The color endpoints are the bounding box of the block, inset by 1/16 of its size
+// and flipped to the diagonal which follows the sign of the red-green and blue-green
+// covariance. The pixels are projected onto the quantized endpoints and rounded to
+// the nearest of the four colors. The single channel blocks (BC3 alpha, BC4, BC5)
+// use the minimum and maximum as the endpoints of the eight value mode.
+
+namespace
+{
+    using namespace mango;
+
+    constexpr int GROUP_BLOCKS = 8;
+
+    // lane[pixel][component][block]
+    struct BlockGroup
+    {
+        alignas(16) u16 lane[16][4][GROUP_BLOCKS];
+    };
+
+#if defined(MANGO_ENABLE_SSE2)
+
+    static inline __m128i select_sse2(__m128i mask, __m128i a, __m128i b)
+    {
+        return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+    }
+
+    static inline __m128i quantize_sse2(__m128i v, int scale)
+    {
+        __m128i t = _mm_add_epi16(_mm_mullo_epi16(v, _mm_set1_epi16(s16(scale))), _mm_set1_epi16(128));
+        return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+    }
+
+    void load_group_sse2(BlockGroup& group, const u8* const* rows)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        __m128i* lane = reinterpret_cast<__m128i *>(group.lane);
+
+        for (int y = 0; y < 4; ++y)
+        {
+            const __m128i* scan = reinterpret_cast<const __m128i *>(rows[y]);
+
+            __m128i a0 = _mm_loadu_si128(scan + 0);
+            __m128i a1 = _mm_loadu_si128(scan + 1);
+            __m128i a2 = _mm_loadu_si128(scan + 2);
+            __m128i a3 = _mm_loadu_si128(scan + 3);
+            __m128i a4 = _mm_loadu_si128(scan + 4);
+            __m128i a5 = _mm_loadu_si128(scan + 5);
+            __m128i a6 = _mm_loadu_si128(scan + 6);
+            __m128i a7 = _mm_loadu_si128(scan + 7);
+
+            // 8x16 byte transpose: blocks -> pairs -> quads -> octets of the same component
+            __m128i b0 = _mm_unpacklo_epi8(a0, a1);
+            __m128i b1 = _mm_unpackhi_epi8(a0, a1);
+            __m128i b2 = _mm_unpacklo_epi8(a2, a3);
+            __m128i b3 = _mm_unpackhi_epi8(a2, a3);
+            __m128i b4 = _mm_unpacklo_epi8(a4, a5);
+            __m128i b5 = _mm_unpackhi_epi8(a4, a5);
+            __m128i b6 = _mm_unpacklo_epi8(a6, a7);
+            __m128i b7 = _mm_unpackhi_epi8(a6, a7);
+
+            __m128i c0 = _mm_unpacklo_epi16(b0, b2);
+            __m128i c1 = _mm_unpackhi_epi16(b0, b2);
+            __m128i c2 = _mm_unpacklo_epi16(b1, b3);
+            __m128i c3 = _mm_unpackhi_epi16(b1, b3);
+            __m128i c4 = _mm_unpacklo_epi16(b4, b6);
+            __m128i c5 = _mm_unpackhi_epi16(b4, b6);
+            __m128i c6 = _mm_unpacklo_epi16(b5, b7);
+            __m128i c7 = _mm_unpackhi_epi16(b5, b7);
+
+            const __m128i pixel[8] =
+            {
+                _mm_unpacklo_epi32(c0, c4), _mm_unpackhi_epi32(c0, c4),
+                _mm_unpacklo_epi32(c1, c5), _mm_unpackhi_epi32(c1, c5),
+                _mm_unpacklo_epi32(c2, c6), _mm_unpackhi_epi32(c2, c6),
+                _mm_unpacklo_epi32(c3, c7), _mm_unpackhi_epi32(c3, c7),
+            };
+
+            for (int x = 0; x < 4; ++x)
+            {
+                __m128i* dest = lane + (y * 4 + x) * 4;
+                dest[0] = _mm_unpacklo_epi8(pixel[x * 2 + 0], zero);
+                dest[1] = _mm_unpackhi_epi8(pixel[x * 2 + 0], zero);
+                dest[2] = _mm_unpacklo_epi8(pixel[x * 2 + 1], zero);
+                dest[3] = _mm_unpackhi_epi8(pixel[x * 2 + 1], zero);
+            }
+        }
+    }
+
+    void encode_color_sse2(u64* output, const BlockGroup& group)
+    {
+        const __m128i* lane = reinterpret_cast<const __m128i *>(group.lane);
+        const __m128i zero = _mm_setzero_si128();
+
+        __m128i minR = lane[0];
+        __m128i minG = lane[1];
+        __m128i minB = lane[2];
+        __m128i maxR = minR;
+        __m128i maxG = minG;
+        __m128i maxB = minB;
+        __m128i sumR = minR;
+        __m128i sumG = minG;
+        __m128i sumB = minB;
+
+        for (int i = 1; i < 16; ++i)
+        {
+            const __m128i r = lane[i * 4 + 0];
+            const __m128i g = lane[i * 4 + 1];
+            const __m128i b = lane[i * 4 + 2];
+            minR = _mm_min_epi16(minR, r);
+            minG = _mm_min_epi16(minG, g);
+            minB = _mm_min_epi16(minB, b);
+            maxR = _mm_max_epi16(maxR, r);
+            maxG = _mm_max_epi16(maxG, g);
+            maxB = _mm_max_epi16(maxB, b);
+            sumR = _mm_add_epi16(sumR, r);
+            sumG = _mm_add_epi16(sumG, g);
+            sumB = _mm_add_epi16(sumB, b);
+        }
+
+        const __m128i eight = _mm_set1_epi16(8);
+        const __m128i meanR = _mm_srli_epi16(_mm_add_epi16(sumR, eight), 4);
+        const __m128i meanG = _mm_srli_epi16(_mm_add_epi16(sumG, eight), 4);
+        const __m128i meanB = _mm_srli_epi16(_mm_add_epi16(sumB, eight), 4);
+
+        __m128i covRG = zero;
+        __m128i covBG = zero;
+
+        for (int i = 0; i < 16; ++i)
+        {
+            const __m128i dr = _mm_srai_epi16(_mm_sub_epi16(lane[i * 4 + 0], meanR), 2);
+            const __m128i dg = _mm_srai_epi16(_mm_sub_epi16(lane[i * 4 + 1], meanG), 2);
+            const __m128i db = _mm_srai_epi16(_mm_sub_epi16(lane[i * 4 + 2], meanB), 2);
+            covRG = _mm_adds_epi16(covRG, _mm_mullo_epi16(dr, dg));
+            covBG = _mm_adds_epi16(covBG, _mm_mullo_epi16(db, dg));
+        }
+
+        __m128i inset;
+        inset = _mm_srli_epi16(_mm_sub_epi16(maxR, minR), 4);
+        minR = _mm_add_epi16(minR, inset);
+        maxR = _mm_sub_epi16(maxR, inset);
+        inset = _mm_srli_epi16(_mm_sub_epi16(maxG, minG), 4);
+        minG = _mm_add_epi16(minG, inset);
+        maxG = _mm_sub_epi16(maxG, inset);
+        inset = _mm_srli_epi16(_mm_sub_epi16(maxB, minB), 4);
+        minB = _mm_add_epi16(minB, inset);
+        maxB = _mm_sub_epi16(maxB, inset);
+
+        const __m128i flipR = _mm_cmplt_epi16(covRG, zero);
+        const __m128i flipB = _mm_cmplt_epi16(covBG, zero);
+
+        const __m128i r0 = quantize_sse2(select_sse2(flipR, minR, maxR), 31);
+        const __m128i g0 = quantize_sse2(maxG, 63);
+        const __m128i b0 = quantize_sse2(select_sse2(flipB, minB, maxB), 31);
+        const __m128i r1 = quantize_sse2(select_sse2(flipR, maxR, minR), 31);
+        const __m128i g1 = quantize_sse2(minG, 63);
+        const __m128i b1 = quantize_sse2(select_sse2(flipB, maxB, minB), 31);
+
+        const __m128i color0 = _mm_or_si128(_mm_or_si128(_mm_slli_epi16(r0, 11), _mm_slli_epi16(g0, 5)), b0);
+        const __m128i color1 = _mm_or_si128(_mm_or_si128(_mm_slli_epi16(r1, 11), _mm_slli_epi16(g1, 5)), b1);
+
+        const __m128i pr0 = _mm_or_si128(_mm_slli_epi16(r0, 3), _mm_srli_epi16(r0, 2));
+        const __m128i pg0 = _mm_or_si128(_mm_slli_epi16(g0, 2), _mm_srli_epi16(g0, 4));
+        const __m128i pb0 = _mm_or_si128(_mm_slli_epi16(b0, 3), _mm_srli_epi16(b0, 2));
+        const __m128i pr1 = _mm_or_si128(_mm_slli_epi16(r1, 3), _mm_srli_epi16(r1, 2));
+        const __m128i pg1 = _mm_or_si128(_mm_slli_epi16(g1, 2), _mm_srli_epi16(g1, 4));
+        const __m128i pb1 = _mm_or_si128(_mm_slli_epi16(b1, 3), _mm_srli_epi16(b1, 2));
+
+        // the dot products are computed in 32 bits with _mm_madd_epi16 from interleaved
+        // (red, green) and (blue, zero) pairs; the low half has blocks 0..3, the high half 4..7
+        const __m128i dirR = _mm_sub_epi16(pr1, pr0);
+        const __m128i dirG = _mm_sub_epi16(pg1, pg0);
+        const __m128i dirB = _mm_sub_epi16(pb1, pb0);
+
+        const __m128i dirRG[2] = { _mm_unpacklo_epi16(dirR, dirG), _mm_unpackhi_epi16(dirR, dirG) };
+        const __m128i dirB0[2] = { _mm_unpacklo_epi16(dirB, zero), _mm_unpackhi_epi16(dirB, zero) };
+
+        const __m128i dot0[2] =
+        {
+            _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(pr0, pg0), dirRG[0]), _mm_madd_epi16(_mm_unpacklo_epi16(pb0, zero), dirB0[0])),
+            _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(pr0, pg0), dirRG[1]), _mm_madd_epi16(_mm_unpackhi_epi16(pb0, zero), dirB0[1])),
+        };
+
+        const __m128i dot1[2] =
+        {
+            _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(pr1, pg1), dirRG[0]), _mm_madd_epi16(_mm_unpacklo_epi16(pb1, zero), dirB0[0])),
+            _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(pr1, pg1), dirRG[1]), _mm_madd_epi16(_mm_unpackhi_epi16(pb1, zero), dirB0[1])),
+        };
+
+        __m128i threshold1[2];
+        __m128i threshold2[2];
+        __m128i threshold3[2];
+
+        for (int j = 0; j < 2; ++j)
+        {
+            const __m128i delta = _mm_sub_epi32(dot1[j], dot0[j]);
+            const __m128i delta2 = _mm_add_epi32(delta, delta);
+            const __m128i dot6 = _mm_add_epi32(_mm_slli_epi32(dot0[j], 1), _mm_slli_epi32(dot0[j], 2));
+            threshold1[j] = _mm_add_epi32(dot6, delta);
+            threshold2[j] = _mm_add_epi32(threshold1[j], delta2);
+            threshold3[j] = _mm_add_epi32(threshold2[j], delta2);
+        }
+
+        const __m128i one = _mm_set1_epi32(1);
+        const __m128i two = _mm_set1_epi32(2);
+
+        __m128i indices[2] = { zero, zero };
+
+        for (int i = 0; i < 16; ++i)
+        {
+            const __m128i r = lane[i * 4 + 0];
+            const __m128i g = lane[i * 4 + 1];
+            const __m128i b = lane[i * 4 + 2];
+            const __m128i rg[2] = { _mm_unpacklo_epi16(r, g), _mm_unpackhi_epi16(r, g) };
+            const __m128i bz[2] = { _mm_unpacklo_epi16(b, zero), _mm_unpackhi_epi16(b, zero) };
+            const __m128i shift = _mm_cvtsi32_si128(i * 2);
+
+            for (int j = 0; j < 2; ++j)
+            {
+                __m128i dot = _mm_add_epi32(_mm_madd_epi16(rg[j], dirRG[j]), _mm_madd_epi16(bz[j], dirB0[j]));
+                dot = _mm_add_epi32(_mm_slli_epi32(dot, 1), _mm_slli_epi32(dot, 2));
+
+                const __m128i m1 = _mm_cmpgt_epi32(dot, threshold1[j]);
+                const __m128i m2 = _mm_cmpgt_epi32(dot, threshold2[j]);
+                const __m128i m3 = _mm_cmpgt_epi32(dot, threshold3[j]);
+                const __m128i index = _mm_or_si128(_mm_and_si128(m2, one), _mm_and_si128(_mm_andnot_si128(m3, m1), two));
+                indices[j] = _mm_or_si128(indices[j], _mm_sll_epi32(index, shift));
+            }
+        }
+
+        // color0 must be greater than color1 for the four color mode
+        const __m128i bias = _mm_set1_epi16(-0x8000);
+        const __m128i swap = _mm_cmplt_epi16(_mm_xor_si128(color0, bias), _mm_xor_si128(color1, bias));
+        const __m128i equal = _mm_cmpeq_epi16(color0, color1);
+
+        const __m128i c0 = select_sse2(swap, color1, color0);
+        const __m128i c1 = select_sse2(swap, color0, color1);
+        const __m128i colors[2] = { _mm_unpacklo_epi16(c0, c1), _mm_unpackhi_epi16(c0, c1) };
+        const __m128i swap32[2] = { _mm_unpacklo_epi16(swap, swap), _mm_unpackhi_epi16(swap, swap) };
+        const __m128i equal32[2] = { _mm_unpacklo_epi16(equal, equal), _mm_unpackhi_epi16(equal, equal) };
+        const __m128i reverse = _mm_set1_epi32(0x55555555);
+
+        __m128i* dest = reinterpret_cast<__m128i *>(output);
+
+        for (int j = 0; j < 2; ++j)
+        {
+            __m128i index = _mm_xor_si128(indices[j], _mm_and_si128(swap32[j], reverse));
+            index = _mm_andnot_si128(equal32[j], index);
+            _mm_storeu_si128(dest + j * 2 + 0, _mm_unpacklo_epi32(colors[j], index));
+            _mm_storeu_si128(dest + j * 2 + 1, _mm_unpackhi_epi32(colors[j], index));
+        }
+    }
+
+    void encode_channel_sse2(u64* output, const BlockGroup& group, int component)
+    {
+        const __m128i* lane = reinterpret_cast<const __m128i *>(group.lane) + component;
+
+        __m128i low = lane[0];
+        __m128i high = low;
+
+        for (int i = 1; i < 16; ++i)
+        {
+            low = _mm_min_epi16(low, lane[i * 4]);
+            high = _mm_max_epi16(high, lane[i * 4]);
+        }
+
+        const __m128i range = _mm_sub_epi16(high, low);
+
+        __m128i threshold[7];
+        for (int k = 1; k < 8; ++k)
+        {
+            threshold[k - 1] = _mm_mullo_epi16(range, _mm_set1_epi16(s16(k * 2 - 1)));
+        }
+
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i one = _mm_set1_epi16(1);
+        const __m128i seven = _mm_set1_epi16(7);
+        const __m128i fourteen = _mm_set1_epi16(14);
+
+        alignas(16) u16 index[16][GROUP_BLOCKS];
+
+        for (int i = 0; i < 16; ++i)
+        {
+            const __m128i t = _mm_mullo_epi16(_mm_sub_epi16(high, lane[i * 4]), fourteen);
+
+            __m128i q = zero;
+            for (int k = 0; k < 7; ++k)
+            {
+                q = _mm_sub_epi16(q, _mm_cmpgt_epi16(t, threshold[k]));
+            }
+
+            // 0 -> 0, 7 -> 1, q -> q + 1
+            __m128i v = _mm_add_epi16(q, one);
+            v = _mm_add_epi16(v, _mm_cmpeq_epi16(q, zero));
+            v = _mm_sub_epi16(v, _mm_and_si128(_mm_cmpeq_epi16(q, seven), seven));
+            _mm_store_si128(reinterpret_cast<__m128i *>(index[i]), v);
+        }
+
+        alignas(16) u16 endpoint[2][GROUP_BLOCKS];
+        _mm_store_si128(reinterpret_cast<__m128i *>(endpoint[0]), high);
+        _mm_store_si128(reinterpret_cast<__m128i *>(endpoint[1]), low);
+
+        for (int block = 0; block < GROUP_BLOCKS; ++block)
+        {
+            u64 indices = 0;
+            for (int i = 0; i < 16; ++i)
+            {
+                indices |= u64(index[i][block]) << (i * 3);
+            }
+
+            output[block] = u64(endpoint[0][block]) | (u64(endpoint[1][block]) << 8) | (indices << 16);
+        }
+    }
+
+    #define load_group      load_group_sse2
+    #define encode_color    encode_color_sse2
+    #define encode_channel  encode_channel_sse2
+
+#else
+
+    // round(v * scale / 255)
+    inline int quantize(int v, int scale)
+    {
+        const int t = v * scale + 128;
+        return (t + (t >> 8)) >> 8;
+    }
+
+    inline int saturate16(int v)
+    {
+        return std::min(32767, std::max(-32768, v));
+    }
+
+    // The scalar encoders compute exactly the same blocks as the SIMD ones.
+
+    void load_group_scalar(BlockGroup& group, const u8* const* rows)
+    {
+        for (int y = 0; y < 4; ++y)
+        {
+            for (int block = 0; block < GROUP_BLOCKS; ++block)
+            {
+                const u8* scan = rows[y] + block * 16;
+
+                for (int x = 0; x < 4; ++x)
+                {
+                    for (int c = 0; c < 4; ++c)
+                    {
+                        group.lane[y * 4 + x][c][block] = scan[x * 4 + c];
+                    }
+                }
+            }
+        }
+    }
+
+    void encode_color_scalar(u64* output, const BlockGroup& group)
+    {
+        for (int block = 0; block < GROUP_BLOCKS; ++block)
+        {
+            int minColor[3] = { 255, 255, 255 };
+            int maxColor[3] = { 0, 0, 0 };
+            int sum[3] = { 0, 0, 0 };
+
+            for (int i = 0; i < 16; ++i)
+            {
+                for (int c = 0; c < 3; ++c)
+                {
+                    const int v = group.lane[i][c][block];
+                    minColor[c] = std::min(minColor[c], v);
+                    maxColor[c] = std::max(maxColor[c], v);
+                    sum[c] += v;
+                }
+            }
+
+            int mean[3];
+            for (int c = 0; c < 3; ++c)
+            {
+                mean[c] = (sum[c] + 8) >> 4;
+            }
+
+            int covRG = 0;
+            int covBG = 0;
+
+            for (int i = 0; i < 16; ++i)
+            {
+                const int dr = (group.lane[i][0][block] - mean[0]) >> 2;
+                const int dg = (group.lane[i][1][block] - mean[1]) >> 2;
+                const int db = (group.lane[i][2][block] - mean[2]) >> 2;
+                covRG = saturate16(covRG + dr * dg);
+                covBG = saturate16(covBG + db * dg);
+            }
+
+            for (int c = 0; c < 3; ++c)
+            {
+                const int inset = (maxColor[c] - minColor[c]) >> 4;
+                minColor[c] += inset;
+                maxColor[c] -= inset;
+            }
+
+            int e0[3] = { maxColor[0], maxColor[1], maxColor[2] };
+            int e1[3] = { minColor[0], minColor[1], minColor[2] };
+
+            if (covRG < 0)
+                std::swap(e0[0], e1[0]);
+            if (covBG < 0)
+                std::swap(e0[2], e1[2]);
+
+            // quantize to 565 and expand back to the decoded colors
+            const int r0 = quantize(e0[0], 31);
+            const int g0 = quantize(e0[1], 63);
+            const int b0 = quantize(e0[2], 31);
+            const int r1 = quantize(e1[0], 31);
+            const int g1 = quantize(e1[1], 63);
+            const int b1 = quantize(e1[2], 31);
+
+            const int color0 = (r0 << 11) | (g0 << 5) | b0;
+            const int color1 = (r1 << 11) | (g1 << 5) | b1;
+
+            const int p0[3] = { (r0 << 3) | (r0 >> 2), (g0 << 2) | (g0 >> 4), (b0 << 3) | (b0 >> 2) };
+            const int p1[3] = { (r1 << 3) | (r1 >> 2), (g1 << 2) | (g1 >> 4), (b1 << 3) | (b1 >> 2) };
+            const int dir[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+
+            const int dot0 = p0[0] * dir[0] + p0[1] * dir[1] + p0[2] * dir[2];
+            const int dot1 = p1[0] * dir[0] + p1[1] * dir[1] + p1[2] * dir[2];
+            const int delta = dot1 - dot0;
+            const int threshold1 = dot0 * 6 + delta;
+            const int threshold2 = threshold1 + delta * 2;
+            const int threshold3 = threshold2 + delta * 2;
+
+            u32 indices = 0;
+
+            for (int i = 0; i < 16; ++i)
+            {
+                const int r = group.lane[i][0][block];
+                const int g = group.lane[i][1][block];
+                const int b = group.lane[i][2][block];
+                const int dot = (r * dir[0] + g * dir[1] + b * dir[2]) * 6;
+
+                // position 0..3 from color0 to color1 in the index order 0, 2, 3, 1
+                const bool m1 = dot > threshold1;
+                const bool m2 = dot > threshold2;
+                const bool m3 = dot > threshold3;
+                const u32 index = u32(m2) | (u32(m1 && !m3) << 1);
+                indices |= index << (i * 2);
+            }
+
+            u32 colors;
+
+            if (color0 < color1)
+            {
+                // reversed endpoints swap the indices 0 <-> 1 and 2 <-> 3
+                colors = color1 | (color0 << 16);
+                indices ^= 0x55555555;
+            }
+            else
+            {
+                colors = color0 | (color1 << 16);
+                if (color0 == color1)
+                    indices = 0;
+            }
+
+            output[block] = u64(colors) | (u64(indices) << 32);
+        }
+    }
+
+    void encode_channel_scalar(u64* output, const BlockGroup& group, int component)
+    {
+        for (int block = 0; block < GROUP_BLOCKS; ++block)
+        {
+            int low = 255;
+            int high = 0;
+
+            for (int i = 0; i < 16; ++i)
+            {
+                const int v = group.lane[i][component][block];
+                low = std::min(low, v);
+                high = std::max(high, v);
+            }
+
+            const int range = high - low;
+            u64 indices = 0;
+
+            for (int i = 0; i < 16; ++i)
+            {
+                // distance from alpha0 (high) to alpha1 (low) in 1/7 steps
+                const int t = (high - group.lane[i][component][block]) * 14;
+                int q = 0;
+
+                for (int k = 1; k < 8; ++k)
+                {
+                    q += t > range * (k * 2 - 1);
+                }
+
+                const int index = q == 0 ? 0 : q == 7 ? 1 : q + 1;
+                indices |= u64(index) << (i * 3);
+            }
+
+            output[block] = u64(high) | (u64(low) << 8) | (indices << 16);
+        }
+    }
+
+    #define load_group      load_group_scalar
+    #define encode_color    encode_color_scalar
+    #define encode_channel  encode_channel_scalar
+
+#endif // defined(MANGO_ENABLE_SSE2)
+
+    enum class FastMode
+    {
+        BC1, BC3, BC4, BC5
+    };
+
+    void encode_group(FastMode mode, u8* output, const u8* const* rows, int count)
+    {
+        BlockGroup group;
+        load_group(group, rows);
+
+        u64 block0[GROUP_BLOCKS];
+        u64 block1[GROUP_BLOCKS];
+
+        switch (mode)
+        {
+            case FastMode::BC1:
+                encode_color(block0, group);
+                for (int i = 0; i < count; ++i)
+                {
+                    ustore64le(output + i * 8, block0[i]);
+                }
+                break;
+
+            case FastMode::BC3:
+                encode_channel(block0, group, 3);
+                encode_color(block1, group);
+                for (int i = 0; i < count; ++i)
+                {
+                    ustore64le(output + i * 16 + 0, block0[i]);
+                    ustore64le(output + i * 16 + 8, block1[i]);
+                }
+                break;
+
+            case FastMode::BC4:
+                encode_channel(block0, group, 0);
+                for (int i = 0; i < count; ++i)
+                {
+                    ustore64le(output + i * 8, block0[i]);
+                }
+                break;
+
+            case FastMode::BC5:
+                encode_channel(block0, group, 0);
+                encode_channel(block1, group, 1);
+                for (int i = 0; i < count; ++i)
+                {
+                    ustore64le(output + i * 16 + 0, block0[i]);
+                    ustore64le(output + i * 16 + 8, block1[i]);
+                }
+                break;
+        }
+    }
+
+    #undef load_group
+    #undef encode_color
+    #undef encode_channel
+
+} // namespace
+
+namespace mango
+{
+
+    // Encodes the rows of blocks [y0, y1) with the real-time encoders; returns false when
+    // the compression has no fast encoder. The surface is read in place when it is
+    // R8G8B8A8, otherwise one band of four scanlines at a time is converted.
+    bool encodeBlocksFast(const TextureCompressionInfo& info, u8* output, const Surface& surface, int y0, int y1)
+    {
+        FastMode mode;
+
+        switch (info.compression)
+        {
+            case TextureCompression::DXT1:
+            case TextureCompression::DXT1_SRGB:
+                mode = FastMode::BC1;
+                break;
+            case TextureCompression::DXT5:
+            case TextureCompression::DXT5_SRGB:
+                mode = FastMode::BC3;
+                break;
+            case TextureCompression::RGTC1_RED:
+                mode = FastMode::BC4;
+                break;
+            case TextureCompression::RGTC2_RG:
+                mode = FastMode::BC5;
+                break;
+            default:
+                return false;
+        }
+
+        const int width = surface.width;
+        const int xblocks = round_multiple_up(width, 4);
+        const bool direct = surface.format == FORMAT_R8G8B8A8;
+
+        std::vector<u8> band(direct ? 0 : size_t(width) * 4 * 4);
+
+        // the last group of a row is padded with the edge pixels
+        u8 padded[4][GROUP_BLOCKS * 16];
+
+        for (int y = y0; y < y1; ++y)
+        {
+            const int height = std::min(4, surface.height - y * 4);
+            const u8* rows[4];
+
+            if (direct)
+            {
+                for (int i = 0; i < height; ++i)
+                {
+                    rows[i] = surface.address<u8>(0, y * 4 + i);
+                }
+            }
+            else
+            {
+                Surface source(surface, 0, y * 4, width, height);
+                Surface dest(width, height, FORMAT_R8G8B8A8, width * 4, band.data());
+                dest.blit(0, 0, source);
+
+                for (int i = 0; i < height; ++i)
+                {
+                    rows[i] = band.data() + i * width * 4;
+                }
+            }
+
+            for (int i = height; i < 4; ++i)
+            {
+                rows[i] = rows[height - 1];
+            }
+
+            u8* data = output + size_t(y) * xblocks * info.bytes;
+
+            for (int x = 0; x < xblocks; x += GROUP_BLOCKS)
+            {
+                const int count = std::min(GROUP_BLOCKS, xblocks - x);
+                const int x0 = x * 4;
+
+                if (x0 + GROUP_BLOCKS * 4 <= width)
+                {
+                    const u8* group[4] = { rows[0] + x0 * 4, rows[1] + x0 * 4, rows[2] + x0 * 4, rows[3] + x0 * 4 };
+                    encode_group(mode, data, group, count);
+                }
+                else
+                {
+                    const int valid = width - x0;
+
+                    for (int i = 0; i < 4; ++i)
+                    {
+                        std::memcpy(padded[i], rows[i] + x0 * 4, valid * 4);
+                        for (int j = valid; j < GROUP_BLOCKS * 4; ++j)
+                        {
+                            std::memcpy(padded[i] + j * 4, padded[i] + (valid - 1) * 4, 4);
+                        }
+                    }
+
+                    const u8* group[4] = { padded[0], padded[1], padded[2], padded[3] };
+                    encode_group(mode, data, group, count);
+                }
+
+                data += count * info.bytes;
+            }
+        }
+
+        return true;
+    }
+
+} // namespace mango
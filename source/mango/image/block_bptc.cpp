@@ -0,0 +1,706 @@
+/*
+    MANGO Multimedia Development Platform
+    Copyright (C) 2012-2019 Twilight Finland 3D Oy Ltd. All rights reserved.
+*/
+#include <cstring>
+#include <mango/core/core.hpp>
+#include <mango/image/image.hpp>
+
+// ----------------------------------------------------------------------------
+// BC7 decoder
+// ----------------------------------------------------------------------------
+
+// The blocks are decoded into 8 bit RGBA; the mode selects the layout of the fields
+// from a table, the endpoints of each subset are expanded into a palette and the
+// pixels are looked up from the palette of their subset. The results are identical
+// to the reference decoder, which produces the same 8 bit values in floating point.
+
+namespace
+{
+    using namespace mango;
+
+    struct ModeBPTC
+    {
+        int subsets;
+        int partitionBits;
+        int rotationBits;
+        int indexSelectionBits;
+        int colorBits;
+        int alphaBits;
+        int pbits; // unique per endpoint (1), shared per subset (2) or none (0)
+        int indexBits;
+        int indexBits2;
+    };
+
+    const ModeBPTC g_modeTable[] =
+    {
+        { 3, 4, 0, 0, 4, 0, 1, 3, 0 },
+        { 2, 6, 0, 0, 6, 0, 2, 3, 0 },
+        { 3, 6, 0, 0, 5, 0, 0, 2, 0 },
+        { 2, 6, 0, 0, 7, 0, 1, 2, 0 },
+        { 1, 0, 2, 1, 5, 6, 0, 2, 3 },
+        { 1, 0, 2, 0, 7, 8, 0, 2, 2 },
+        { 1, 0, 0, 0, 7, 7, 1, 4, 0 },
+        { 2, 6, 0, 0, 5, 5, 1, 2, 0 },
+    };
+
+    const u8 g_weights2[] = { 0, 21, 43, 64 };
+    const u8 g_weights3[] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+    const u8 g_weights4[] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+    // subset of each pixel, 2 bits per pixel
+    const u32 g_partition2[] =
+    {
+        0x50505050, 0x40404040, 0x54545454, 0x54505040, 0x50404000, 0x55545450, 0x55545040, 0x54504000,
+        0x50400000, 0x55555450, 0x55544000, 0x54400000, 0x55555440, 0x55550000, 0x55555500, 0x55000000,
+        0x55150100, 0x00004054, 0x15010000, 0x00405054, 0x00004050, 0x15050100, 0x05010000, 0x40505054,
+        0x00404050, 0x05010100, 0x14141414, 0x05141450, 0x01155440, 0x00555500, 0x15014054, 0x05414150,
+        0x44444444, 0x55005500, 0x11441144, 0x05055050, 0x05500550, 0x11114444, 0x41144114, 0x44111144,
+        0x15055054, 0x01055040, 0x05041050, 0x05455150, 0x14414114, 0x50050550, 0x41411414, 0x00141400,
+        0x00041504, 0x00105410, 0x10541000, 0x04150400, 0x50410514, 0x41051450, 0x05415014, 0x14054150,
+        0x41050514, 0x41505014, 0x40011554, 0x54150140, 0x50505500, 0x00555050, 0x15151010, 0x54540404,
+    };
+
+    const u32 g_partition3[] =
+    {
+        0xaa685050, 0x6a5a5040, 0x5a5a4200, 0x5450a0a8, 0xa5a50000, 0xa0a05050, 0x5555a0a0, 0x5a5a5050,
+        0xaa550000, 0xaa555500, 0xaaaa5500, 0x90909090, 0x94949494, 0xa4a4a4a4, 0xa9a59450, 0x2a0a4250,
+        0xa5945040, 0x0a425054, 0xa5a5a500, 0x55a0a0a0, 0xa8a85454, 0x6a6a4040, 0xa4a45000, 0x1a1a0500,
+        0x0050a4a4, 0xaaa59090, 0x14696914, 0x69691400, 0xa08585a0, 0xaa821414, 0x50a4a450, 0x6a5a0200,
+        0xa9a58000, 0x5090a0a8, 0xa8a09050, 0x24242424, 0x00aa5500, 0x24924924, 0x24499224, 0x50a50a50,
+        0x500aa550, 0xaaaa4444, 0x66660000, 0xa5a0a5a0, 0x50a050a0, 0x69286928, 0x44aaaa44, 0x66666600,
+        0xaa444444, 0x54a854a8, 0x95809580, 0x96969600, 0xa85454a8, 0x80959580, 0xaa141414, 0x96960000,
+        0xaaaa1414, 0xa05050a0, 0xa0a5a5a0, 0x96000000, 0x40804080, 0xa9a8a9a8, 0xaaaaaa44, 0x2a4a5254,
+    };
+
+    // anchor pixels of the second and third subsets; their indices drop the top bit
+    const u8 g_anchor2[] =
+    {
+        15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+        15,  2,  8,  2,  2,  8,  8, 15,  2,  8,  2,  2,  8,  8,  2,  2,
+        15, 15,  6,  8,  2,  8, 15, 15,  2,  8,  2,  2,  2, 15, 15,  6,
+         6,  2,  6,  8, 15, 15,  2,  2, 15, 15, 15, 15, 15,  2,  2, 15,
+    };
+
+    const u8 g_anchor3a[] =
+    {
+         3,  3, 15, 15,  8,  3, 15, 15,  8,  8,  6,  6,  6,  5,  3,  3,
+         3,  3,  8, 15,  3,  3,  6, 10,  5,  8,  8,  6,  8,  5, 15, 15,
+         8, 15,  3,  5,  6, 10,  8, 15, 15,  3, 15,  5, 15, 15, 15, 15,
+         3, 15,  5,  5,  5,  8,  5, 10,  5, 10,  8, 13, 15, 12,  3,  3,
+    };
+
+    const u8 g_anchor3b[] =
+    {
+        15,  8,  8,  3, 15, 15,  3,  8, 15, 15, 15, 15, 15, 15, 15,  8,
+        15,  8, 15,  3, 15,  8, 15,  8,  3, 15,  6, 10, 15, 15, 10,  8,
+        15,  3, 15, 10, 10,  8,  9, 10,  6, 15,  8, 15,  3,  6,  6,  8,
+        15,  3, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,  3, 15, 15,  8,
+    };
+
+    struct BitReader
+    {
+        u64 lo;
+        u64 hi;
+
+        BitReader(const u8* data)
+            : lo(uload64le(data + 0))
+            , hi(uload64le(data + 8))
+        {
+        }
+
+        u32 get(int bits)
+        {
+            const u32 value = u32(lo) & ((1u << bits) - 1);
+            if (bits)
+            {
+                lo = (lo >> bits) | (hi << (64 - bits));
+                hi >>= bits;
+            }
+            return value;
+        }
+    };
+
+    inline int unquantize(int value, int bits)
+    {
+        value = (value << (8 - bits)) & 0xff;
+        return value | (value >> bits);
+    }
+
+    inline const u8* getWeights(int bits)
+    {
+        return bits == 2 ? g_weights2 : bits == 3 ? g_weights3 : g_weights4;
+    }
+
+    // interpolated values of one channel; channel is the byte offset in the palette
+    void interpolate(u32* palette, int e0, int e1, const u8* weights, int count, int channel)
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            const u32 w = weights[i];
+            const u32 v = (e0 * (64 - w) + e1 * w + 32) >> 6;
+            palette[i] |= v << (channel * 8);
+        }
+    }
+
+    void fillError(u8* output, int stride)
+    {
+        for (int y = 0; y < 4; ++y)
+        {
+            u32* dest = reinterpret_cast<u32*>(output);
+            for (int x = 0; x < 4; ++x)
+            {
+                ustore32le(dest + x, 0xff000000);
+            }
+            output += stride;
+        }
+    }
+
+    void decodeBlock(u8* output, int stride, const u8* input)
+    {
+        const int mode = u32_tzcnt(input[0] | 0x100);
+        if (mode >= 8)
+        {
+            fillError(output, stride);
+            return;
+        }
+
+        const ModeBPTC& info = g_modeTable[mode];
+
+        BitReader reader(input);
+        reader.get(mode + 1);
+
+        const int partition = reader.get(info.partitionBits);
+        const int rotation = reader.get(info.rotationBits);
+        const int selection = reader.get(info.indexSelectionBits);
+
+        const int endpoints = info.subsets * 2;
+
+        // endpoints: the channels are stored one after another for all endpoints
+        int color[6][4];
+
+        for (int c = 0; c < 3; ++c)
+        {
+            for (int i = 0; i < endpoints; ++i)
+            {
+                color[i][c] = reader.get(info.colorBits);
+            }
+        }
+
+        for (int i = 0; i < endpoints; ++i)
+        {
+            color[i][3] = info.alphaBits ? reader.get(info.alphaBits) : 255;
+        }
+
+        int colorBits = info.colorBits;
+        int alphaBits = info.alphaBits;
+
+        if (info.pbits)
+        {
+            const int count = info.pbits == 1 ? endpoints : info.subsets;
+
+            int pbit[6];
+            for (int i = 0; i < count; ++i)
+            {
+                pbit[i] = reader.get(1);
+            }
+
+            for (int i = 0; i < endpoints; ++i)
+            {
+                const int p = pbit[info.pbits == 1 ? i : i >> 1];
+                color[i][0] = (color[i][0] << 1) | p;
+                color[i][1] = (color[i][1] << 1) | p;
+                color[i][2] = (color[i][2] << 1) | p;
+                if (alphaBits)
+                {
+                    color[i][3] = (color[i][3] << 1) | p;
+                }
+            }
+
+            ++colorBits;
+            if (alphaBits)
+            {
+                ++alphaBits;
+            }
+        }
+
+        for (int i = 0; i < endpoints; ++i)
+        {
+            color[i][0] = unquantize(color[i][0], colorBits);
+            color[i][1] = unquantize(color[i][1], colorBits);
+            color[i][2] = unquantize(color[i][2], colorBits);
+            if (alphaBits)
+            {
+                color[i][3] = unquantize(color[i][3], alphaBits);
+            }
+        }
+
+        // subset and anchor pixels
+        u32 subsets = 0;
+        u32 anchors = 1;
+
+        if (info.subsets == 2)
+        {
+            subsets = g_partition2[partition];
+            anchors |= 1u << g_anchor2[partition];
+        }
+        else if (info.subsets == 3)
+        {
+            subsets = g_partition3[partition];
+            anchors |= 1u << g_anchor3a[partition];
+            anchors |= 1u << g_anchor3b[partition];
+        }
+
+        u8 index[16];
+        u8 index2[16];
+
+        for (int i = 0; i < 16; ++i)
+        {
+            index[i] = u8(reader.get(info.indexBits - ((anchors >> i) & 1)));
+        }
+
+        u32 palette[3 * 16];
+        const int paletteSize = 1 << info.indexBits;
+
+        if (!info.indexBits2)
+        {
+            // the color and alpha share the indices
+            const u8* weights = getWeights(info.indexBits);
+
+            for (int s = 0; s < info.subsets; ++s)
+            {
+                u32* p = palette + s * 16;
+                const int* c0 = color[s * 2 + 0];
+                const int* c1 = color[s * 2 + 1];
+
+                for (int i = 0; i < paletteSize; ++i)
+                {
+                    p[i] = 0;
+                }
+
+                for (int c = 0; c < 4; ++c)
+                {
+                    interpolate(p, c0[c], c1[c], weights, paletteSize, c);
+                }
+            }
+
+            for (int y = 0; y < 4; ++y)
+            {
+                u32* dest = reinterpret_cast<u32*>(output);
+                for (int x = 0; x < 4; ++x)
+                {
+                    const int i = y * 4 + x;
+                    const int s = (subsets >> (i * 2)) & 3;
+                    ustore32le(dest + x, palette[s * 16 + index[i]]);
+                }
+                output += stride;
+            }
+
+            return;
+        }
+
+        // separate alpha indices; the anchor is the first pixel
+        for (int i = 0; i < 16; ++i)
+        {
+            index2[i] = u8(reader.get(info.indexBits2 - (i == 0)));
+        }
+
+        int colorIndexBits = info.indexBits;
+        int alphaIndexBits = info.indexBits2;
+        const u8* colorIndex = index;
+        const u8* alphaIndex = index2;
+
+        if (selection)
+        {
+            std::swap(colorIndexBits, alphaIndexBits);
+            std::swap(colorIndex, alphaIndex);
+        }
+
+        u32* colorPalette = palette;
+        u32* alphaPalette = palette + 16;
+
+        const int colorSize = 1 << colorIndexBits;
+        const int alphaSize = 1 << alphaIndexBits;
+
+        for (int i = 0; i < colorSize; ++i)
+        {
+            colorPalette[i] = 0;
+        }
+
+        for (int i = 0; i < alphaSize; ++i)
+        {
+            alphaPalette[i] = 0;
+        }
+
+        // the rotation swaps the alpha with one of the color channels
+        int channel[4] = { 0, 1, 2, 3 };
+        if (rotation)
+        {
+            std::swap(channel[rotation - 1], channel[3]);
+        }
+
+        const u8* colorWeights = getWeights(colorIndexBits);
+        const u8* alphaWeights = getWeights(alphaIndexBits);
+
+        for (int c = 0; c < 3; ++c)
+        {
+            interpolate(colorPalette, color[0][c], color[1][c], colorWeights, colorSize, channel[c]);
+        }
+
+        interpolate(alphaPalette, color[0][3], color[1][3], alphaWeights, alphaSize, channel[3]);
+
+        for (int y = 0; y < 4; ++y)
+        {
+            u32* dest = reinterpret_cast<u32*>(output);
+            for (int x = 0; x < 4; ++x)
+            {
+                const int i = y * 4 + x;
+                ustore32le(dest + x, colorPalette[colorIndex[i]] | alphaPalette[alphaIndex[i]]);
+            }
+            output += stride;
+        }
+    }
+
+} // namespace
+
+// ----------------------------------------------------------------------------
+// BC6H decoder
+// ----------------------------------------------------------------------------
+
+// The header fields of each mode are read from runs of consecutive bits instead of one
+// bit at a time and the endpoints are unquantized once per block into a palette of
+// half floats; the results are identical to the reference decoder.
+
+namespace
+{
+    using namespace mango;
+
+    struct FieldBC6H
+    {
+        u8 offset;  // first bit in the block
+        u8 count;   // number of bits
+        u8 field;   // channel * 4 + endpoint, or 12 for the partition
+        u8 shift;   // first bit in the field
+    };
+
+    struct ModeBC6H
+    {
+        int subsets;
+        int transformed;
+        int basePrecision[3];
+        int deltaPrecision[3];
+        FieldBC6H fields[25]; // terminated with zero count
+    };
+
+    const s8 g_bc6hModeIndex[] =
+    {
+         0,  1,  2, 10, -1, -1,  3, 11, -1, -1,  4, 12, -1, -1,  5, 13,
+        -1, -1,  6, -1, -1, -1,  7, -1, -1, -1,  8, -1, -1, -1,  9, -1,
+    };
+
+    const ModeBC6H g_bc6hModeTable[] =
+    {
+        { 2, 1, { 10, 10, 10 }, { 5, 5, 5 }, {
+            { 2, 1, 6, 4 }, { 3, 1, 10, 4 }, { 4, 1, 11, 4 }, { 5, 10, 0, 0 }, { 15, 10, 4, 0 }, { 25, 10, 8, 0 },
+            { 35, 5, 1, 0 }, { 40, 1, 7, 4 }, { 41, 4, 6, 0 }, { 45, 5, 5, 0 }, { 50, 1, 11, 0 }, { 51, 4, 7, 0 },
+            { 55, 5, 9, 0 }, { 60, 1, 11, 1 }, { 61, 4, 10, 0 }, { 65, 5, 2, 0 }, { 70, 1, 11, 2 }, { 71, 5, 3, 0 },
+            { 76, 1, 11, 3 }, { 77, 5, 12, 0 },
+        } },
+        { 2, 1, {  7,  7,  7 }, { 6, 6, 6 }, {
+            { 2, 1, 6, 5 }, { 3, 2, 7, 4 }, { 5, 7, 0, 0 }, { 12, 2, 11, 0 }, { 14, 1, 10, 4 }, { 15, 7, 4, 0 },
+            { 22, 1, 10, 5 }, { 23, 1, 11, 2 }, { 24, 1, 6, 4 }, { 25, 7, 8, 0 }, { 32, 1, 11, 3 }, { 33, 1, 11, 5 },
+            { 34, 1, 11, 4 }, { 35, 6, 1, 0 }, { 41, 4, 6, 0 }, { 45, 6, 5, 0 }, { 51, 4, 7, 0 }, { 55, 6, 9, 0 },
+            { 61, 4, 10, 0 }, { 65, 6, 2, 0 }, { 71, 6, 3, 0 }, { 77, 5, 12, 0 },
+        } },
+        { 2, 1, { 11, 11, 11 }, { 5, 4, 4 }, {
+            { 5, 10, 0, 0 }, { 15, 10, 4, 0 }, { 25, 10, 8, 0 }, { 35, 5, 1, 0 }, { 40, 1, 0, 10 }, { 41, 4, 6, 0 },
+            { 45, 4, 5, 0 }, { 49, 1, 4, 10 }, { 50, 1, 11, 0 }, { 51, 4, 7, 0 }, { 55, 4, 9, 0 }, { 59, 1, 8, 10 },
+            { 60, 1, 11, 1 }, { 61, 4, 10, 0 }, { 65, 5, 2, 0 }, { 70, 1, 11, 2 }, { 71, 5, 3, 0 }, { 76, 1, 11, 3 },
+            { 77, 5, 12, 0 },
+        } },
+        { 2, 1, { 11, 11, 11 }, { 4, 5, 4 }, {
+            { 5, 10, 0, 0 }, { 15, 10, 4, 0 }, { 25, 10, 8, 0 }, { 35, 4, 1, 0 }, { 39, 1, 0, 10 }, { 40, 1, 7, 4 },
+            { 41, 4, 6, 0 }, { 45, 5, 5, 0 }, { 50, 1, 4, 10 }, { 51, 4, 7, 0 }, { 55, 4, 9, 0 }, { 59, 1, 8, 10 },
+            { 60, 1, 11, 1 }, { 61, 4, 10, 0 }, { 65, 4, 2, 0 }, { 69, 1, 11, 0 }, { 70, 1, 11, 2 }, { 71, 4, 3, 0 },
+            { 75, 1, 6, 4 }, { 76, 1, 11, 3 }, { 77, 5, 12, 0 },
+        } },
+        { 2, 1, { 11, 11, 11 }, { 4, 4, 5 }, {
+            { 5, 10, 0, 0 }, { 15, 10, 4, 0 }, { 25, 10, 8, 0 }, { 35, 4, 1, 0 }, { 39, 1, 0, 10 }, { 40, 1, 10, 4 },
+            { 41, 4, 6, 0 }, { 45, 4, 5, 0 }, { 49, 1, 4, 10 }, { 50, 1, 11, 0 }, { 51, 4, 7, 0 }, { 55, 5, 9, 0 },
+            { 60, 1, 8, 10 }, { 61, 4, 10, 0 }, { 65, 4, 2, 0 }, { 69, 2, 11, 1 }, { 71, 4, 3, 0 }, { 75, 1, 11, 4 },
+            { 76, 1, 11, 3 }, { 77, 5, 12, 0 },
+        } },
+        { 2, 1, {  9,  9,  9 }, { 5, 5, 5 }, {
+            { 5, 9, 0, 0 }, { 14, 1, 10, 4 }, { 15, 9, 4, 0 }, { 24, 1, 6, 4 }, { 25, 9, 8, 0 }, { 34, 1, 11, 4 },
+            { 35, 5, 1, 0 }, { 40, 1, 7, 4 }, { 41, 4, 6, 0 }, { 45, 5, 5, 0 }, { 50, 1, 11, 0 }, { 51, 4, 7, 0 },
+            { 55, 5, 9, 0 }, { 60, 1, 11, 1 }, { 61, 4, 10, 0 }, { 65, 5, 2, 0 }, { 70, 1, 11, 2 }, { 71, 5, 3, 0 },
+            { 76, 1, 11, 3 }, { 77, 5, 12, 0 },
+        } },
+        { 2, 1, {  8,  8,  8 }, { 6, 5, 5 }, {
+            { 5, 8, 0, 0 }, { 13, 1, 7, 4 }, { 14, 1, 10, 4 }, { 15, 8, 4, 0 }, { 23, 1, 11, 2 }, { 24, 1, 6, 4 },
+            { 25, 8, 8, 0 }, { 33, 2, 11, 3 }, { 35, 6, 1, 0 }, { 41, 4, 6, 0 }, { 45, 5, 5, 0 }, { 50, 1, 11, 0 },
+            { 51, 4, 7, 0 }, { 55, 5, 9, 0 }, { 60, 1, 11, 1 }, { 61, 4, 10, 0 }, { 65, 6, 2, 0 }, { 71, 6, 3, 0 },
+            { 77, 5, 12, 0 },
+        } },
+        { 2, 1, {  8,  8,  8 }, { 5, 6, 5 }, {
+            { 5, 8, 0, 0 }, { 13, 1, 11, 0 }, { 14, 1, 10, 4 }, { 15, 8, 4, 0 }, { 23, 1, 6, 5 }, { 24, 1, 6, 4 },
+            { 25, 8, 8, 0 }, { 33, 1, 7, 5 }, { 34, 1, 11, 4 }, { 35, 5, 1, 0 }, { 40, 1, 7, 4 }, { 41, 4, 6, 0 },
+            { 45, 6, 5, 0 }, { 51, 4, 7, 0 }, { 55, 5, 9, 0 }, { 60, 1, 11, 1 }, { 61, 4, 10, 0 }, { 65, 5, 2, 0 },
+            { 70, 1, 11, 2 }, { 71, 5, 3, 0 }, { 76, 1, 11, 3 }, { 77, 5, 12, 0 },
+        } },
+        { 2, 1, {  8,  8,  8 }, { 5, 5, 6 }, {
+            { 5, 8, 0, 0 }, { 13, 1, 11, 1 }, { 14, 1, 10, 4 }, { 15, 8, 4, 0 }, { 23, 1, 10, 5 }, { 24, 1, 6, 4 },
+            { 25, 8, 8, 0 }, { 33, 1, 11, 5 }, { 34, 1, 11, 4 }, { 35, 5, 1, 0 }, { 40, 1, 7, 4 }, { 41, 4, 6, 0 },
+            { 45, 5, 5, 0 }, { 50, 1, 11, 0 }, { 51, 4, 7, 0 }, { 55, 6, 9, 0 }, { 61, 4, 10, 0 }, { 65, 5, 2, 0 },
+            { 70, 1, 11, 2 }, { 71, 5, 3, 0 }, { 76, 1, 11, 3 }, { 77, 5, 12, 0 },
+        } },
+        { 2, 0, {  6,  6,  6 }, { 6, 6, 6 }, {
+            { 5, 6, 0, 0 }, { 11, 1, 7, 4 }, { 12, 2, 11, 0 }, { 14, 1, 10, 4 }, { 15, 6, 4, 0 }, { 21, 1, 6, 5 },
+            { 22, 1, 10, 5 }, { 23, 1, 11, 2 }, { 24, 1, 6, 4 }, { 25, 6, 8, 0 }, { 31, 1, 7, 5 }, { 32, 1, 11, 3 },
+            { 33, 1, 11, 5 }, { 34, 1, 11, 4 }, { 35, 6, 1, 0 }, { 41, 4, 6, 0 }, { 45, 6, 5, 0 }, { 51, 4, 7, 0 },
+            { 55, 6, 9, 0 }, { 61, 4, 10, 0 }, { 65, 6, 2, 0 }, { 71, 6, 3, 0 }, { 77, 5, 12, 0 },
+        } },
+        { 1, 0, { 10, 10, 10 }, { 10, 10, 10 }, {
+            { 5, 10, 0, 0 }, { 15, 10, 4, 0 }, { 25, 10, 8, 0 }, { 35, 10, 1, 0 }, { 45, 10, 5, 0 }, { 55, 10, 9, 0 },
+        } },
+        { 1, 1, { 11, 11, 11 }, { 9, 9, 9 }, {
+            { 5, 10, 0, 0 }, { 15, 10, 4, 0 }, { 25, 10, 8, 0 }, { 35, 9, 1, 0 }, { 44, 1, 0, 10 }, { 45, 9, 5, 0 },
+            { 54, 1, 4, 10 }, { 55, 9, 9, 0 }, { 64, 1, 8, 10 },
+        } },
+        { 1, 1, { 12, 12, 12 }, { 8, 8, 8 }, {
+            { 5, 10, 0, 0 }, { 15, 10, 4, 0 }, { 25, 10, 8, 0 }, { 35, 8, 1, 0 }, { 43, 1, 0, 11 }, { 44, 1, 0, 10 },
+            { 45, 8, 5, 0 }, { 53, 1, 4, 11 }, { 54, 1, 4, 10 }, { 55, 8, 9, 0 }, { 63, 1, 8, 11 }, { 64, 1, 8, 10 },
+        } },
+        { 1, 1, { 16, 16, 16 }, { 4, 4, 4 }, {
+            { 5, 10, 0, 0 }, { 15, 10, 4, 0 }, { 25, 10, 8, 0 }, { 35, 4, 1, 0 }, { 39, 1, 0, 15 }, { 40, 1, 0, 14 },
+            { 41, 1, 0, 13 }, { 42, 1, 0, 12 }, { 43, 1, 0, 11 }, { 44, 1, 0, 10 }, { 45, 4, 5, 0 }, { 49, 1, 4, 15 },
+            { 50, 1, 4, 14 }, { 51, 1, 4, 13 }, { 52, 1, 4, 12 }, { 53, 1, 4, 11 }, { 54, 1, 4, 10 }, { 55, 4, 9, 0 },
+            { 59, 1, 8, 15 }, { 60, 1, 8, 14 }, { 61, 1, 8, 13 }, { 62, 1, 8, 12 }, { 63, 1, 8, 11 }, { 64, 1, 8, 10 },
+        } },
+    };
+
+    inline u32 getBits(u64 lo, u64 hi, int offset, int count)
+    {
+        u64 value;
+        if (offset >= 64)
+            value = hi >> (offset - 64);
+        else if (offset + count <= 64)
+            value = lo >> offset;
+        else
+            value = (lo >> offset) | (hi << (64 - offset));
+        return u32(value) & ((1u << count) - 1);
+    }
+
+    inline int signExtend(int value, int bits)
+    {
+        return value - ((value & (1 << (bits - 1))) << 1);
+    }
+
+    inline int unquantizeUnsigned(int value, int bits)
+    {
+        if (bits >= 15 || !value)
+            return value;
+        if (value == (1 << bits) - 1)
+            return 0xffff;
+        return ((value << 16) + 0x8000) >> bits;
+    }
+
+    inline int unquantizeSigned(int value, int bits)
+    {
+        if (bits >= 16)
+            return value;
+
+        const int sign = value < 0;
+        value = sign ? -value : value;
+
+        if (!value)
+            ;
+        else if (value >= (1 << (bits - 1)) - 1)
+            value = 0x7fff;
+        else
+            value = ((value << 15) + 0x4000) >> (bits - 1);
+
+        return sign ? -value : value;
+    }
+
+    // interpolated value scaled into the half float range
+    inline float finishUnquantize(int value, bool isSigned)
+    {
+        u16 bits;
+        if (isSigned)
+        {
+            // the sign is dropped when the magnitude rounds to zero
+            value = value < 0 ? -(((-value) * 31) >> 5) : (value * 31) >> 5;
+            bits = value < 0 ? u16(0x8000 | -value) : u16(value);
+        }
+        else
+        {
+            bits = u16((value * 31) >> 6);
+        }
+        return float(Half(bits));
+    }
+
+    void fillErrorBC6H(u8* output, int stride)
+    {
+        const float error[] = { 0.0f, 0.0f, 0.0f, 1.0f };
+        for (int y = 0; y < 4; ++y)
+        {
+            for (int x = 0; x < 4; ++x)
+            {
+                std::memcpy(output + x * 16, error, 16);
+            }
+            output += stride;
+        }
+    }
+
+    void decodeBlockBC6H(u8* output, int stride, const u8* input, bool isSigned)
+    {
+        const u64 lo = uload64le(input + 0);
+        const u64 hi = uload64le(input + 8);
+
+        const int mode = (lo & 2) ? int(lo & 0x1f) : int(lo & 1);
+        const int index = g_bc6hModeIndex[mode];
+        if (index < 0)
+        {
+            fillErrorBC6H(output, stride);
+            return;
+        }
+
+        const ModeBC6H& info = g_bc6hModeTable[index];
+
+        // endpoints: value[channel * 4 + endpoint], partition: value[12]
+        int value[13] = { 0 };
+        for (const FieldBC6H* field = info.fields; field->count; ++field)
+        {
+            value[field->field] |= int(getBits(lo, hi, field->offset, field->count) << field->shift);
+        }
+
+        const int endpoints = info.subsets * 2;
+        const int count = info.subsets == 2 ? 8 : 16;
+        const u8* weights = info.subsets == 2 ? g_weights3 : g_weights4;
+
+        float palette[2][16][4];
+
+        for (int c = 0; c < 3; ++c)
+        {
+            int* e = value + c * 4;
+            const int base = info.basePrecision[c];
+
+            if (isSigned)
+            {
+                e[0] = signExtend(e[0], base);
+            }
+
+            if (isSigned || info.transformed)
+            {
+                for (int i = 1; i < endpoints; ++i)
+                {
+                    e[i] = signExtend(e[i], info.deltaPrecision[c]);
+                }
+            }
+
+            if (info.transformed)
+            {
+                const int mask = (1 << base) - 1;
+                for (int i = 1; i < endpoints; ++i)
+                {
+                    e[i] = (e[i] + e[0]) & mask;
+                    if (isSigned)
+                    {
+                        e[i] = signExtend(e[i], base);
+                    }
+                }
+            }
+
+            for (int s = 0; s < info.subsets; ++s)
+            {
+                const int e0 = isSigned ? unquantizeSigned(e[s * 2 + 0], base) : unquantizeUnsigned(e[s * 2 + 0], base);
+                const int e1 = isSigned ? unquantizeSigned(e[s * 2 + 1], base) : unquantizeUnsigned(e[s * 2 + 1], base);
+
+                for (int i = 0; i < count; ++i)
+                {
+                    const int w = weights[i];
+                    palette[s][i][c] = finishUnquantize((e0 * (64 - w) + e1 * w + 32) >> 6, isSigned);
+                    palette[s][i][3] = 1.0f;
+                }
+            }
+        }
+
+        // the indices are at the end of the block; the anchor pixels drop the top bit
+        u32 subsets = 0;
+        u32 anchors = 1;
+        u64 indices;
+        int bits;
+
+        if (info.subsets == 2)
+        {
+            const int partition = value[12];
+            subsets = g_partition2[partition];
+            anchors |= 1u << g_anchor2[partition];
+            indices = hi >> 18;
+            bits = 3;
+        }
+        else
+        {
+            indices = hi >> 1;
+            bits = 4;
+        }
+
+        for (int y = 0; y < 4; ++y)
+        {
+            float* dest = reinterpret_cast<float*>(output);
+            for (int x = 0; x < 4; ++x)
+            {
+                const int i = y * 4 + x;
+                const int n = bits - ((anchors >> i) & 1);
+                const int s = (subsets >> (i * 2)) & 3;
+                const int idx = int(indices & ((1u << n) - 1));
+                indices >>= n;
+                std::memcpy(dest + x * 4, palette[s][idx], 16);
+            }
+            output += stride;
+        }
+    }
+
+} // namespace
+
+namespace mango
+{
+
+    void decode_blocks_bc7(const TextureCompressionInfo& info, u8* output, const u8* input, int stride, int count)
+    {
+        MANGO_UNREFERENCED_PARAMETER(info);
+
+        for (int i = 0; i < count; ++i)
+        {
+            decodeBlock(output, stride, input);
+            output += 16;
+            input += 16;
+        }
+    }
+
+    void decode_blocks_bc6hu(const TextureCompressionInfo& info, u8* output, const u8* input, int stride, int count)
+    {
+        MANGO_UNREFERENCED_PARAMETER(info);
+
+        for (int i = 0; i < count; ++i)
+        {
+            decodeBlockBC6H(output, stride, input, false);
+            output += 64;
+            input += 16;
+        }
+    }
+
+    void decode_blocks_bc6hs(const TextureCompressionInfo& info, u8* output, const u8* input, int stride, int count)
+    {
+        MANGO_UNREFERENCED_PARAMETER(info);
+
+        for (int i = 0; i < count; ++i)
+        {
+            decodeBlockBC6H(output, stride, input, true);
+            output += 64;
+            input += 16;
+        }
+    }
+
+} // namespace mango
@@ -2,6 +2,7 @@
     MANGO Multimedia Development Platform
     Copyright (C) 2012-2016 Twilight Finland 3D Oy Ltd. All rights reserved.
 */
+#include <cstring>
 #include <mango/core/endian.hpp>
 #include <mango/image/compression.hpp>
 
@@ -30,6 +31,346 @@ namespace
         u8 stuff[6];
     };
 
+    // ------------------------------------------------------------
+    // index expansion
+    // ------------------------------------------------------------
+
+    // Spreads eight 2, 3 or 4 bit indices into one byte each; the bytes select
+    // the entries of the color and alpha tables.
+
+    inline u64 spread2(u32 bits)
+    {
+        u64 v = bits & 0xffff;
+        v = (v | (v << 24)) & 0x000000ff000000ffull;
+        v = (v | (v << 12)) & 0x000f000f000f000full;
+        v = (v | (v <<  6)) & 0x0303030303030303ull;
+        return v;
+    }
+
+    inline u64 spread3(u32 bits)
+    {
+        u64 v = bits & 0xffffff;
+        v = (v | (v << 20)) & 0x00000fff00000fffull;
+        v = (v | (v << 10)) & 0x003f003f003f003full;
+        v = (v | (v <<  5)) & 0x0707070707070707ull;
+        return v;
+    }
+
+    inline u64 spread4(u32 bits)
+    {
+        u64 v = bits;
+        v = (v | (v << 16)) & 0x0000ffff0000ffffull;
+        v = (v | (v <<  8)) & 0x00ff00ff00ff00ffull;
+        v = (v | (v <<  4)) & 0x0f0f0f0f0f0f0f0full;
+        return v;
+    }
+
+    inline u64 getExplicitAlpha(const DXTAlphaBlockExplicit* block, int half)
+    {
+        // 4 bit alpha extended to 8 bits: 0xf -> 0xff
+        return spread4(uload32le(block->data + half * 2)) * 0x11;
+    }
+
+    inline u64 getLinearIndices(const DXTAlphaBlock3BitLinear* block, int half)
+    {
+        const u8* p = block->stuff + half * 3;
+        return spread3(p[0] | (p[1] << 8) | (p[2] << 16));
+    }
+
+#if defined(MANGO_ENABLE_SSSE3) || (defined(MANGO_ENABLE_NEON) && defined(MANGO_CPU_64BIT))
+
+    // ------------------------------------------------------------
+    // SIMD block decoders
+    // ------------------------------------------------------------
+
+    // The pixels are looked up from the color and alpha tables of the block with a
+    // byte shuffle, four pixels (one row) per instruction.
+
+#if defined(MANGO_ENABLE_SSSE3)
+
+    using vector16 = __m128i;
+
+    inline vector16 make16(u64 low, u64 high)
+    {
+        return _mm_set_epi64x(s64(high), s64(low));
+    }
+
+    inline vector16 load16(const void* p)
+    {
+        return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    }
+
+    inline void store16(void* p, vector16 v)
+    {
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(p), v);
+    }
+
+    inline vector16 lookup16(vector16 table, vector16 index)
+    {
+        return _mm_shuffle_epi8(table, index);
+    }
+
+    inline vector16 unpacklo8(vector16 a, vector16 b)
+    {
+        return _mm_unpacklo_epi8(a, b);
+    }
+
+    inline vector16 unpackhi8(vector16 a, vector16 b)
+    {
+        return _mm_unpackhi_epi8(a, b);
+    }
+
+    inline vector16 unpacklo16(vector16 a, vector16 b)
+    {
+        return _mm_unpacklo_epi16(a, b);
+    }
+
+    inline vector16 unpackhi16(vector16 a, vector16 b)
+    {
+        return _mm_unpackhi_epi16(a, b);
+    }
+
+    inline vector16 add8(vector16 a, vector16 b)
+    {
+        return _mm_add_epi8(a, b);
+    }
+
+    inline vector16 or8(vector16 a, vector16 b)
+    {
+        return _mm_or_si128(a, b);
+    }
+
+#else
+
+    using vector16 = uint8x16_t;
+
+    inline vector16 make16(u64 low, u64 high)
+    {
+        return vcombine_u8(vcreate_u8(low), vcreate_u8(high));
+    }
+
+    inline vector16 load16(const void* p)
+    {
+        return vld1q_u8(reinterpret_cast<const u8 *>(p));
+    }
+
+    inline void store16(void* p, vector16 v)
+    {
+        vst1q_u8(reinterpret_cast<u8 *>(p), v);
+    }
+
+    inline vector16 lookup16(vector16 table, vector16 index)
+    {
+        return vqtbl1q_u8(table, index);
+    }
+
+    inline vector16 unpacklo8(vector16 a, vector16 b)
+    {
+        return vzip1q_u8(a, b);
+    }
+
+    inline vector16 unpackhi8(vector16 a, vector16 b)
+    {
+        return vzip2q_u8(a, b);
+    }
+
+    inline vector16 unpacklo16(vector16 a, vector16 b)
+    {
+        return vreinterpretq_u8_u16(vzip1q_u16(vreinterpretq_u16_u8(a), vreinterpretq_u16_u8(b)));
+    }
+
+    inline vector16 unpackhi16(vector16 a, vector16 b)
+    {
+        return vreinterpretq_u8_u16(vzip2q_u16(vreinterpretq_u16_u8(a), vreinterpretq_u16_u8(b)));
+    }
+
+    inline vector16 add8(vector16 a, vector16 b)
+    {
+        return vaddq_u8(a, b);
+    }
+
+    inline vector16 or8(vector16 a, vector16 b)
+    {
+        return vorrq_u8(a, b);
+    }
+
+#endif
+
+    // byte offsets of the pixels of a row in the 16 alpha values; the color
+    // channels are out of range and read as zero
+    const u8 g_alphaRowIndex[4][16] =
+    {
+        { 0x80, 0x80, 0x80,  0, 0x80, 0x80, 0x80,  1, 0x80, 0x80, 0x80,  2, 0x80, 0x80, 0x80,  3 },
+        { 0x80, 0x80, 0x80,  4, 0x80, 0x80, 0x80,  5, 0x80, 0x80, 0x80,  6, 0x80, 0x80, 0x80,  7 },
+        { 0x80, 0x80, 0x80,  8, 0x80, 0x80, 0x80,  9, 0x80, 0x80, 0x80, 10, 0x80, 0x80, 0x80, 11 },
+        { 0x80, 0x80, 0x80, 12, 0x80, 0x80, 0x80, 13, 0x80, 0x80, 0x80, 14, 0x80, 0x80, 0x80, 15 },
+    };
+
+    // The tables are computed in registers; storing the bytes and loading them as a
+    // vector would stall on the store forwarding.
+
+    inline vector16 DecodeLinearValues(const DXTAlphaBlock3BitLinear* block, bool rounding)
+    {
+        const u32 a0 = block->alpha[0];
+        const u32 a1 = block->alpha[1];
+
+        // 8-alpha and 6-alpha blocks selected without a branch
+        const u32 bias7 = rounding ? 3 : 0;
+        const u32 bias5 = rounding ? 2 : 0;
+
+        u64 table7 = 0;
+        u64 table5 = 0xff00000000000000ull;
+
+        for (u32 i = 1; i < 7; ++i)
+        {
+            table7 |= u64((a0 * (7 - i) + a1 * i + bias7) / 7) << (i * 8 + 8);
+        }
+
+        for (u32 i = 1; i < 5; ++i)
+        {
+            table5 |= u64((a0 * (5 - i) + a1 * i + bias5) / 5) << (i * 8 + 8);
+        }
+
+        const u64 mask = 0 - u64(a0 > a1);
+        const u64 table = a0 | (a1 << 8) | (table7 & mask) | (table5 & ~mask);
+
+        vector16 index = make16(getLinearIndices(block, 0), getLinearIndices(block, 1));
+        return lookup16(make16(table, 0), index);
+    }
+
+    inline u32 expand565(u32 packed, u32 alpha)
+    {
+        u32 r = (packed >> 11) & 0x1f;
+        u32 g = (packed >>  5) & 0x3f;
+        u32 b = (packed >>  0) & 0x1f;
+        r = (r << 3) | (r >> 2);
+        g = (g << 2) | (g >> 4);
+        b = (b << 3) | (b >> 2);
+        return r | (g << 8) | (b << 16) | (alpha << 24);
+    }
+
+    inline u32 blend(u32 c0, u32 c1, u32 w0, u32 w1, u32 divisor, u32 alpha)
+    {
+        u32 color = alpha << 24;
+        for (int i = 0; i < 24; i += 8)
+        {
+            const u32 v = (((c0 >> i) & 0xff) * w0 + ((c1 >> i) & 0xff) * w1) / divisor;
+            color |= v << i;
+        }
+        return color;
+    }
+
+    inline vector16 GetColorPalette(const DXTColBlock* block, u32 alpha)
+    {
+        const u32 a = uload16le(&block->color[0]);
+        const u32 b = uload16le(&block->color[1]);
+
+        const u32 c0 = expand565(a, alpha);
+        const u32 c1 = expand565(b, alpha);
+
+        // four-color block or three-color block with transparent last color; both are
+        // computed and selected without a branch as the blocks mix them unpredictably
+        const u32 mask = 0 - u32(a > b);
+        const u32 c2 = (blend(c0, c1, 2, 1, 3, alpha) & mask) | (blend(c0, c1, 1, 1, 2, alpha) & ~mask);
+        const u32 c3 = blend(c0, c1, 1, 2, 3, alpha) & mask;
+
+        return make16(c0 | (u64(c1) << 32), c2 | (u64(c3) << 32));
+    }
+
+    void DecodeColorBlock(u8* dest, int stride, const DXTColBlock* colorBlock, u8 alpha, const vector16* alphaValues)
+    {
+        const u32 data = uload32le(&colorBlock->data);
+
+        // index * 4 replicated into the four bytes of the pixel
+        const u64 offset = 0x0302010003020100ull;
+        vector16 index = make16(spread2(data) * 4, spread2(data >> 16) * 4);
+        vector16 low = unpacklo8(index, index);
+        vector16 high = unpackhi8(index, index);
+        vector16 bytes = make16(offset, offset);
+
+        const vector16 row[4] =
+        {
+            add8(unpacklo16(low, low), bytes),
+            add8(unpackhi16(low, low), bytes),
+            add8(unpacklo16(high, high), bytes),
+            add8(unpackhi16(high, high), bytes),
+        };
+
+        const vector16 palette = GetColorPalette(colorBlock, alpha);
+
+        for (int y = 0; y < 4; ++y)
+        {
+            vector16 pixels = lookup16(palette, row[y]);
+            if (alphaValues)
+            {
+                pixels = or8(pixels, lookup16(*alphaValues, load16(g_alphaRowIndex[y])));
+            }
+            store16(dest, pixels);
+            dest += stride;
+        }
+    }
+
+    void decodeBlockDXT1(u8* out, int stride, const u8* in)
+    {
+        const DXTColBlock* colorBlock = reinterpret_cast<const DXTColBlock*>(in + 0);
+        DecodeColorBlock(out, stride, colorBlock, 0xff, nullptr);
+    }
+
+    void decodeBlockDXT3(u8* out, int stride, const u8* in)
+    {
+        const DXTAlphaBlockExplicit* alphaBlock = reinterpret_cast<const DXTAlphaBlockExplicit *>(in + 0);
+        const DXTColBlock* colorBlock = reinterpret_cast<const DXTColBlock*>(in + 8);
+        const vector16 alpha = make16(getExplicitAlpha(alphaBlock, 0), getExplicitAlpha(alphaBlock, 1));
+        DecodeColorBlock(out, stride, colorBlock, 0, &alpha);
+    }
+
+    void decodeBlockDXT5(u8* out, int stride, const u8* in)
+    {
+        const DXTAlphaBlock3BitLinear* alphaBlock = reinterpret_cast<const DXTAlphaBlock3BitLinear *>(in + 0);
+        const DXTColBlock* colorBlock = reinterpret_cast<const DXTColBlock*>(in + 8);
+        const vector16 alpha = DecodeLinearValues(alphaBlock, false);
+        DecodeColorBlock(out, stride, colorBlock, 0, &alpha);
+    }
+
+    void decodeBlockX(u8* out, int stride, const u8* in, bool rounding)
+    {
+        const DXTAlphaBlock3BitLinear* redBlock = reinterpret_cast<const DXTAlphaBlock3BitLinear*>(in + 0);
+
+        u8 temp[16];
+        store16(temp, DecodeLinearValues(redBlock, rounding));
+
+        for (int y = 0; y < 4; ++y)
+        {
+            std::memcpy(out, temp + y * 4, 4);
+            out += stride;
+        }
+    }
+
+    void decodeBlockXY(u8* out, int stride, const u8* in, bool rounding)
+    {
+        const DXTAlphaBlock3BitLinear* redBlock = reinterpret_cast<const DXTAlphaBlock3BitLinear*>(in + 0);
+        const DXTAlphaBlock3BitLinear* greenBlock = reinterpret_cast<const DXTAlphaBlock3BitLinear*>(in + 8);
+
+        vector16 red = DecodeLinearValues(redBlock, rounding);
+        vector16 green = DecodeLinearValues(greenBlock, rounding);
+
+        u8 temp[32];
+        store16(temp + 0, unpacklo8(red, green));
+        store16(temp + 16, unpackhi8(red, green));
+
+        for (int y = 0; y < 4; ++y)
+        {
+            std::memcpy(out, temp + y * 8, 8);
+            out += stride;
+        }
+    }
+
+#else
+
+    // ------------------------------------------------------------
+    // scalar block decoders
+    // ------------------------------------------------------------
+
     void unpack565(u8* dest, u16 packed)
     {
         u32 r = (packed >> 11) & 0x1f;
@@ -40,10 +381,6 @@ namespace
         dest[2] = u8((b << 3) | (b >> 2));
     }
 
-    // ------------------------------------------------------------
-    // block decoders
-    // ------------------------------------------------------------
-
     void GetColorBlockColors(u32* color, const DXTColBlock* block, u8 alpha)
     {
         u8* dest = reinterpret_cast<u8*>(color);
@@ -90,26 +427,7 @@ namespace
         }
     }
 
-    void DecodeColorBlock(u8* dest, int stride, const DXTColBlock* colorBlock, u8 alpha)
-    {
-        u32 color[4];
-        GetColorBlockColors(color, colorBlock, alpha);
-
-        u32 data = uload32le(&colorBlock->data);
-
-        for (int y = 0; y < 4; ++y)
-        {
-            u32* d = reinterpret_cast<u32*>(dest);
-            d[0] = color[(data >> 0) & 3];
-            d[1] = color[(data >> 2) & 3];
-            d[2] = color[(data >> 4) & 3];
-            d[3] = color[(data >> 6) & 3];
-            data >>= 8;
-            dest += stride;
-        }
-    }
-
-    void DecodeAlphaTable(u8* alpha, const DXTAlphaBlock3BitLinear* alphaBlock)
+    void DecodeAlphaTable(u8* alpha, const DXTAlphaBlock3BitLinear* alphaBlock, bool rounding)
     {
         alpha[0] = alphaBlock->alpha[0];
         alpha[1] = alphaBlock->alpha[1];
@@ -117,7 +435,7 @@ namespace
         if (alpha[0] > alpha[1])
         {
             const int delta = alpha[1] - alpha[0];
-            int alpha7 = 6 * alpha[0] + alpha[1];
+            int alpha7 = 6 * alpha[0] + alpha[1] + (rounding ? 3 : 0);
 
             // 8-alpha block
             for (int i = 2; i < 8; ++i)
@@ -129,7 +447,7 @@ namespace
         else
         {
             const int delta = alpha[1] - alpha[0];
-            int alpha5 = 4 * alpha[0] + alpha[1];
+            int alpha5 = 4 * alpha[0] + alpha[1] + (rounding ? 2 : 0);
 
             // 6-alpha block
             for (int i = 2; i < 6; ++i)
@@ -143,85 +461,92 @@ namespace
         }
     }
 
-    inline u8 ExtendAlpha(u32 alpha)
+    void DecodeColorBlock(u8* dest, int stride, const DXTColBlock* colorBlock, u8 alpha)
     {
-        return u8(alpha |= (alpha << 4));
+        u32 color[4];
+        GetColorBlockColors(color, colorBlock, alpha);
+
+        u32 data = uload32le(&colorBlock->data);
+
+        for (int y = 0; y < 4; ++y)
+        {
+            u32* d = reinterpret_cast<u32*>(dest);
+            d[0] = color[(data >> 0) & 3];
+            d[1] = color[(data >> 2) & 3];
+            d[2] = color[(data >> 4) & 3];
+            d[3] = color[(data >> 6) & 3];
+            data >>= 8;
+            dest += stride;
+        }
     }
 
-#ifdef MANGO_CPU_64BIT
-    
     void DecodeAlphaExplicit(u8* dest, int stride, const DXTAlphaBlockExplicit* alphaBlock)
     {
-        u64 data = uload64le(&alphaBlock->data[0]);
+        const u64 data[2] = { getExplicitAlpha(alphaBlock, 0), getExplicitAlpha(alphaBlock, 1) };
 
         for (int y = 0; y < 4; ++y)
         {
-            dest[0] = ExtendAlpha((data >> 0) & 0xf);
-            dest[4] = ExtendAlpha((data >> 4) & 0xf);
-            dest[8] = ExtendAlpha((data >> 8) & 0xf);
-            dest[12] = ExtendAlpha((data >> 12) & 0xf);
-            data >>= 16;
+            const u32 alpha = u32(data[y >> 1] >> ((y & 1) * 32));
+            dest[0] = u8(alpha >> 0);
+            dest[4] = u8(alpha >> 8);
+            dest[8] = u8(alpha >> 16);
+            dest[12] = u8(alpha >> 24);
             dest += stride;
         }
     }
 
-    void Decode3BitLinear(u8* dest, int bpp, int stride, const DXTAlphaBlock3BitLinear* block)
+    void Decode3BitLinear(u8* dest, int bpp, int stride, const DXTAlphaBlock3BitLinear* block, bool rounding)
     {
         u8 table[8];
-        DecodeAlphaTable(table, block);
+        DecodeAlphaTable(table, block, rounding);
 
-        // decode the codes into values
-        u64 data = uload64le(block) >> 16; // load whole block and discard first 16 bits
+        const u64 data[2] = { getLinearIndices(block, 0), getLinearIndices(block, 1) };
 
         for (int y = 0; y < 4; ++y)
         {
-            dest[bpp * 0] = table[(data >> 0) & 7];
-            dest[bpp * 1] = table[(data >> 3) & 7];
-            dest[bpp * 2] = table[(data >> 6) & 7];
-            dest[bpp * 3] = table[(data >> 9) & 7];
-            data >>= 12;
+            const u32 index = u32(data[y >> 1] >> ((y & 1) * 32));
+            dest[bpp * 0] = table[(index >> 0) & 0xff];
+            dest[bpp * 1] = table[(index >> 8) & 0xff];
+            dest[bpp * 2] = table[(index >> 16) & 0xff];
+            dest[bpp * 3] = table[(index >> 24) & 0xff];
             dest += stride;
         }
-	}
+    }
 
-#else
+    void decodeBlockDXT1(u8* out, int stride, const u8* in)
+    {
+        const DXTColBlock* colorBlock = reinterpret_cast<const DXTColBlock*>(in + 0);
+        DecodeColorBlock(out, stride, colorBlock, 0xff);
+    }
 
-    void DecodeAlphaExplicit(u8* dest, int stride, const DXTAlphaBlockExplicit* alphaBlock)
+    void decodeBlockDXT3(u8* out, int stride, const u8* in)
     {
-        for (int y = 0; y < 4; ++y)
-        {
-            u32 data = uload16le(&alphaBlock->data[y]);
-            dest[0] = ExtendAlpha((data >> 0) & 0xf);
-            dest[4] = ExtendAlpha((data >> 4) & 0xf);
-            dest[8] = ExtendAlpha((data >> 8) & 0xf);
-            dest[12] = ExtendAlpha((data >> 12) & 0xf);
-            dest += stride;
-        }
+        const DXTAlphaBlockExplicit* alphaBlock = reinterpret_cast<const DXTAlphaBlockExplicit *>(in + 0);
+        const DXTColBlock* colorBlock = reinterpret_cast<const DXTColBlock*>(in + 8);
+        DecodeColorBlock(out + 0, stride, colorBlock, 0);
+        DecodeAlphaExplicit(out + 3, stride, alphaBlock);
     }
 
-    void Decode3BitLinear(u8* dest, int bpp, int stride, const DXTAlphaBlock3BitLinear* block)
+    void decodeBlockDXT5(u8* out, int stride, const u8* in)
     {
-        u8 table[8];
-        DecodeAlphaTable(table, block);
+        const DXTAlphaBlock3BitLinear* alphaBlock = reinterpret_cast<const DXTAlphaBlock3BitLinear *>(in + 0);
+        const DXTColBlock* colorBlock = reinterpret_cast<const DXTColBlock*>(in + 8);
+        DecodeColorBlock(out + 0, stride, colorBlock, 0);
+        Decode3BitLinear(out + 3, 4, stride, alphaBlock, false);
+    }
 
-        // decode the codes into values
-        const u8* stuff = block->stuff;
-        
-        for (int i = 0; i < 2; ++i)
-        {
-            u32 data = (stuff[2] << 16) | (stuff[1] << 8) | stuff[0];
-            stuff += 3;
-            
-            for (int y = 0; y < 2; ++y)
-            {
-                dest[bpp * 0] = table[data & 7];
-                dest[bpp * 1] = table[(data >> 3) & 7];
-                dest[bpp * 2] = table[(data >> 6) & 7];
-                dest[bpp * 3] = table[(data >> 9) & 7];
-                data >>= 12;
-                dest += stride;
-            }
-        }
+    void decodeBlockX(u8* out, int stride, const u8* in, bool rounding)
+    {
+        const DXTAlphaBlock3BitLinear* redBlock = reinterpret_cast<const DXTAlphaBlock3BitLinear*>(in + 0);
+        Decode3BitLinear(out + 0, 1, stride, redBlock, rounding);
+    }
+
+    void decodeBlockXY(u8* out, int stride, const u8* in, bool rounding)
+    {
+        const DXTAlphaBlock3BitLinear* redBlock = reinterpret_cast<const DXTAlphaBlock3BitLinear*>(in + 0);
+        const DXTAlphaBlock3BitLinear* greenBlock = reinterpret_cast<const DXTAlphaBlock3BitLinear*>(in + 8);
+        Decode3BitLinear(out + 0, 2, stride, redBlock, rounding);
+        Decode3BitLinear(out + 1, 2, stride, greenBlock, rounding);
     }
 
 #endif
@@ -231,45 +556,119 @@ namespace
 namespace mango
 {
 
-    void decode_block_dxt1(const TextureCompressionInfo& info, u8* out, const u8* in, int stride)
+    // ------------------------------------------------------------
+    // row decoders
+    // ------------------------------------------------------------
+
+    // The decoders of a row of blocks; the output advances by the width of a block
+    // and the input by the size of a block for each of the count blocks.
+
+    void decode_blocks_dxt1(const TextureCompressionInfo& info, u8* out, const u8* in, int stride, int count)
     {
         MANGO_UNREFERENCED_PARAMETER(info);
-        const DXTColBlock* blockColor = reinterpret_cast<const DXTColBlock*>(in + 0);
-        DecodeColorBlock(out, stride, blockColor, 0xff);
+        for (int i = 0; i < count; ++i)
+        {
+            decodeBlockDXT1(out, stride, in);
+            out += 16;
+            in += 8;
+        }
     }
 
-    void decode_block_dxt3(const TextureCompressionInfo& info, u8* out, const u8* in, int stride)
+    void decode_blocks_dxt3(const TextureCompressionInfo& info, u8* out, const u8* in, int stride, int count)
     {
         MANGO_UNREFERENCED_PARAMETER(info);
-        const DXTAlphaBlockExplicit* alphaBlock = reinterpret_cast<const DXTAlphaBlockExplicit *>(in + 0);
-        const DXTColBlock* colorBlock = reinterpret_cast<const DXTColBlock*>(in + 8);
-        DecodeColorBlock(out + 0, stride, colorBlock, 0);
-        DecodeAlphaExplicit(out + 3, stride, alphaBlock);
+        for (int i = 0; i < count; ++i)
+        {
+            decodeBlockDXT3(out, stride, in);
+            out += 16;
+            in += 16;
+        }
     }
 
-    void decode_block_dxt5(const TextureCompressionInfo& info, u8* out, const u8* in, int stride)
+    void decode_blocks_dxt5(const TextureCompressionInfo& info, u8* out, const u8* in, int stride, int count)
     {
         MANGO_UNREFERENCED_PARAMETER(info);
-        const DXTAlphaBlock3BitLinear* alphaBlock = reinterpret_cast<const DXTAlphaBlock3BitLinear *>(in + 0);
-        const DXTColBlock* colorBlock = reinterpret_cast<const DXTColBlock*>(in + 8);
-        DecodeColorBlock(out + 0, stride, colorBlock, 0);
-        Decode3BitLinear(out + 3, 4, stride, alphaBlock);
+        for (int i = 0; i < count; ++i)
+        {
+            decodeBlockDXT5(out, stride, in);
+            out += 16;
+            in += 16;
+        }
     }
 
-    void decode_block_3dc_x(const TextureCompressionInfo& info, u8* out, const u8* in, int stride)
+    void decode_blocks_3dc_x(const TextureCompressionInfo& info, u8* out, const u8* in, int stride, int count)
     {
         MANGO_UNREFERENCED_PARAMETER(info);
-        const DXTAlphaBlock3BitLinear* redBlock = reinterpret_cast<const DXTAlphaBlock3BitLinear*>(in + 0);
-        Decode3BitLinear(out + 0, 1, stride, redBlock);
+        for (int i = 0; i < count; ++i)
+        {
+            decodeBlockX(out, stride, in, false);
+            out += 4;
+            in += 8;
+        }
     }
 
-    void decode_block_3dc_xy(const TextureCompressionInfo& info, u8* out, const u8* in, int stride)
+    void decode_blocks_3dc_xy(const TextureCompressionInfo& info, u8* out, const u8* in, int stride, int count)
     {
         MANGO_UNREFERENCED_PARAMETER(info);
-        const DXTAlphaBlock3BitLinear* redBlock = reinterpret_cast<const DXTAlphaBlock3BitLinear*>(in + 0);
-        const DXTAlphaBlock3BitLinear* greenBlock = reinterpret_cast<const DXTAlphaBlock3BitLinear*>(in + 8);
-        Decode3BitLinear(out + 0, 2, stride, redBlock);
-        Decode3BitLinear(out + 1, 2, stride, greenBlock);
+        for (int i = 0; i < count; ++i)
+        {
+            decodeBlockXY(out, stride, in, false);
+            out += 8;
+            in += 16;
+        }
+    }
+
+    // BC4 and BC5 (unsigned) into 8 bits; the interpolated values are rounded to
+    // nearest like the floating point decoders are when they are stored in 8 bits
+    void decode_blocks_bc4u(const TextureCompressionInfo& info, u8* out, const u8* in, int stride, int count)
+    {
+        MANGO_UNREFERENCED_PARAMETER(info);
+        for (int i = 0; i < count; ++i)
+        {
+            decodeBlockX(out, stride, in, true);
+            out += 4;
+            in += 8;
+        }
+    }
+
+    void decode_blocks_bc5u(const TextureCompressionInfo& info, u8* out, const u8* in, int stride, int count)
+    {
+        MANGO_UNREFERENCED_PARAMETER(info);
+        for (int i = 0; i < count; ++i)
+        {
+            decodeBlockXY(out, stride, in, true);
+            out += 8;
+            in += 16;
+        }
+    }
+
+    // ------------------------------------------------------------
+    // block decoders
+    // ------------------------------------------------------------
+
+    void decode_block_dxt1(const TextureCompressionInfo& info, u8* out, const u8* in, int stride)
+    {
+        decode_blocks_dxt1(info, out, in, stride, 1);
+    }
+
+    void decode_block_dxt3(const TextureCompressionInfo& info, u8* out, const u8* in, int stride)
+    {
+        decode_blocks_dxt3(info, out, in, stride, 1);
+    }
+
+    void decode_block_dxt5(const TextureCompressionInfo& info, u8* out, const u8* in, int stride)
+    {
+        decode_blocks_dxt5(info, out, in, stride, 1);
+    }
+
+    void decode_block_3dc_x(const TextureCompressionInfo& info, u8* out, const u8* in, int stride)
+    {
+        decode_blocks_3dc_x(info, out, in, stride, 1);
+    }
+
+    void decode_block_3dc_xy(const TextureCompressionInfo& info, u8* out, const u8* in, int stride)
+    {
+        decode_blocks_3dc_xy(info, out, in, stride, 1);
     }
 
 } // namespace mango
@@ -0,0 +1,979 @@
+/*
+    MANGO Multimedia Development Platform
+    Copyright (C) 2012-2019 Twilight Finland 3D Oy Ltd. All rights reserved.
+*/
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+#include <mango/core/core.hpp>
+#include <mango/math/math.hpp>
+#include <mango/image/image.hpp>
+
+// ----------------------------------------------------------------------------
+// ETC2 / EAC encoders
+// ----------------------------------------------------------------------------
+
+// The color blocks are searched over the ETC1 compatible individual and differential
+// modes and the ETC2 planar mode; the thorough search refines the base colors and
+// adds the T and H modes. The candidate palettes are evaluated four pixels at a time.
+// The EAC blocks fit the range of each modifier table to the range of the values.
+
+namespace
+{
+    using namespace mango;
+
+    const int g_etc_modifier[8][2] =
+    {
+        {  2,   8 },
+        {  5,  17 },
+        {  9,  29 },
+        { 13,  42 },
+        { 18,  60 },
+        { 24,  80 },
+        { 33, 106 },
+        { 47, 183 }
+    };
+
+    const int g_etc_distance[8] =
+    {
+        3, 6, 11, 16, 23, 32, 41, 64
+    };
+
+    const int g_eac_modifier[16][8] =
+    {
+        { -3,  -6,  -9, -15,  2,  5,  8, 14 },
+        { -3,  -7, -10, -13,  2,  6,  9, 12 },
+        { -2,  -5,  -8, -13,  1,  4,  7, 12 },
+        { -2,  -4,  -6, -13,  1,  3,  5, 12 },
+        { -3,  -6,  -8, -12,  2,  5,  7, 11 },
+        { -3,  -7,  -9, -11,  2,  6,  8, 10 },
+        { -4,  -7,  -8, -11,  3,  6,  7, 10 },
+        { -3,  -5,  -8, -11,  2,  4,  7, 10 },
+        { -2,  -6,  -8, -10,  1,  5,  7,  9 },
+        { -2,  -5,  -8, -10,  1,  4,  7,  9 },
+        { -2,  -4,  -8, -10,  1,  3,  7,  9 },
+        { -2,  -5,  -7, -10,  1,  4,  6,  9 },
+        { -3,  -4,  -7, -10,  2,  3,  6,  9 },
+        { -1,  -2,  -3, -10,  0,  1,  2,  9 },
+        { -4,  -6,  -8,  -9,  3,  5,  7,  8 },
+        { -3,  -5,  -7,  -9,  2,  4,  6,  8 }
+    };
+
+    // palette color which is never selected
+    const int INVALID_COLOR = 100000;
+
+    inline int quantize(int value, int bits)
+    {
+        const int maximum = (1 << bits) - 1;
+        return (value * maximum + 127) / 255;
+    }
+
+    inline int expand(int value, int bits)
+    {
+        value <<= 8 - bits;
+        return value | (value >> bits);
+    }
+
+    inline u64 getBits(u64 value, int low, int count)
+    {
+        return (value >> low) & ((u64(1) << count) - 1);
+    }
+
+    inline int signExtend3(int value)
+    {
+        return (value & 4) ? value - 8 : value;
+    }
+
+    // The T, H and planar modes are signalled by an overflow of the red, green or blue
+    // component of the differential mode: 0 (no overflow), 1 (red), 2 (green), 3 (blue).
+    int getOverflow(u64 bits)
+    {
+        const int r = int(getBits(bits, 59, 5)) + signExtend3(int(getBits(bits, 56, 3)));
+        const int g = int(getBits(bits, 51, 5)) + signExtend3(int(getBits(bits, 48, 3)));
+        const int b = int(getBits(bits, 43, 5)) + signExtend3(int(getBits(bits, 40, 3)));
+
+        if (r < 0 || r > 31) return 1;
+        if (g < 0 || g > 31) return 2;
+        if (b < 0 || b > 31) return 3;
+        return 0;
+    }
+
+    // Sets the bits of the mask which the mode does not use so that the block selects the mode.
+    u64 selectMode(u64 bits, u64 mask, int overflow)
+    {
+        u64 subset = 0;
+
+        do
+        {
+            if (getOverflow(bits | subset) == overflow)
+                return bits | subset;
+
+            subset = (subset - mask) & mask;
+        } while (subset);
+
+        // every mode has an assignment of its free bits which selects it
+        return bits;
+    }
+
+    // ----------------------------------------------------------------------------
+    // color block
+    // ----------------------------------------------------------------------------
+
+    enum
+    {
+        COLUMN_ORDER = 0, // x * 4 + y, the ETC pixel order; halves of the split into columns
+        ROW_ORDER = 1     // y * 4 + x; halves of the flipped split into rows
+    };
+
+    struct ColorBlock
+    {
+        float color[2][3][16];
+        float weight[2][16];
+        int rgb[16][3];
+        u32 transparent = 0;
+
+        ColorBlock(const u8* input, int stride, bool punchthrough)
+        {
+            for (int y = 0; y < 4; ++y)
+            {
+                const u8* scan = input + y * stride;
+
+                for (int x = 0; x < 4; ++x)
+                {
+                    const int column = x * 4 + y;
+                    const int row = y * 4 + x;
+                    const bool opaque = !punchthrough || scan[x * 4 + 3] >= 128;
+
+                    for (int c = 0; c < 3; ++c)
+                    {
+                        color[COLUMN_ORDER][c][column] = scan[x * 4 + c];
+                        color[ROW_ORDER][c][row] = scan[x * 4 + c];
+                        rgb[column][c] = scan[x * 4 + c];
+                    }
+
+                    weight[COLUMN_ORDER][column] = opaque ? 1.0f : 0.0f;
+                    weight[ROW_ORDER][row] = opaque ? 1.0f : 0.0f;
+
+                    if (!opaque)
+                    {
+                        transparent |= 1 << column;
+                    }
+                }
+            }
+        }
+
+        // Squared error of the pixels [first, first + count) to the nearest palette color;
+        // the index of the nearest color is stored for each pixel.
+        float evaluate(int order, int first, int count, const int (*palette)[3], u8* index) const
+        {
+            float32x4 total = 0.0f;
+
+            for (int i = first; i < first + count; i += 4)
+            {
+                const float32x4 r = simd::f32x4_uload(color[order][0] + i);
+                const float32x4 g = simd::f32x4_uload(color[order][1] + i);
+                const float32x4 b = simd::f32x4_uload(color[order][2] + i);
+
+                float32x4 best = FLT_MAX;
+                float32x4 nearest = 0.0f;
+
+                for (int k = 0; k < 4; ++k)
+                {
+                    const float32x4 dr = r - float32x4(float(palette[k][0]));
+                    const float32x4 dg = g - float32x4(float(palette[k][1]));
+                    const float32x4 db = b - float32x4(float(palette[k][2]));
+                    const float32x4 error = dr * dr + dg * dg + db * db;
+                    const mask32x4 mask = error < best;
+                    best = select(mask, error, best);
+                    nearest = select(mask, float32x4(float(k)), nearest);
+                }
+
+                total = total + best * float32x4(simd::f32x4_uload(weight[order] + i));
+
+                float temp[4];
+                simd::f32x4_ustore(temp, nearest);
+
+                for (int j = 0; j < 4; ++j)
+                {
+                    index[i - first + j] = u8(temp[j]);
+                }
+            }
+
+            return float(total.x) + float(total.y) + float(total.z) + float(total.w);
+        }
+
+        void average(int* output, int order, int first) const
+        {
+            float sum[3] = { 0.0f, 0.0f, 0.0f };
+            float count = 0.0f;
+
+            for (int i = first; i < first + 8; ++i)
+            {
+                const float w = weight[order][i];
+                sum[0] += color[order][0][i] * w;
+                sum[1] += color[order][1][i] * w;
+                sum[2] += color[order][2][i] * w;
+                count += w;
+            }
+
+            for (int c = 0; c < 3; ++c)
+            {
+                output[c] = count > 0.0f ? int(sum[c] / count + 0.5f) : 0;
+            }
+        }
+    };
+
+    inline int getPixelIndex(int order, int position)
+    {
+        return order == COLUMN_ORDER ? position : (position & 3) * 4 + (position >> 2);
+    }
+
+    struct Candidate
+    {
+        u64 bits = 0;
+        float error = FLT_MAX;
+
+        void update(u64 candidate, float candidateError)
+        {
+            if (candidateError < error)
+            {
+                bits = candidate;
+                error = candidateError;
+            }
+        }
+    };
+
+    // ----------------------------------------------------------------------------
+    // individual and differential modes
+    // ----------------------------------------------------------------------------
+
+    struct Subblock
+    {
+        int base[3];
+        int table;
+        float error;
+        u8 index[8];
+    };
+
+    // Searches the base color in [low, high] of the quantized components and the modifier
+    // table of one half of the block.
+    void encodeSubblock(Subblock& result, const ColorBlock& block, int order, int half,
+                        const int* low, const int* high, int bits, bool punchthrough)
+    {
+        result.error = FLT_MAX;
+
+        for (int r = low[0]; r <= high[0]; ++r)
+        {
+            for (int g = low[1]; g <= high[1]; ++g)
+            {
+                for (int b = low[2]; b <= high[2]; ++b)
+                {
+                    const int color[3] = { expand(r, bits), expand(g, bits), expand(b, bits) };
+
+                    for (int table = 0; table < 8; ++table)
+                    {
+                        const int modifier[4] =
+                        {
+                            g_etc_modifier[table][0],
+                            g_etc_modifier[table][1],
+                            -g_etc_modifier[table][0],
+                            -g_etc_modifier[table][1]
+                        };
+
+                        int palette[4][3];
+
+                        for (int k = 0; k < 4; ++k)
+                        {
+                            for (int c = 0; c < 3; ++c)
+                            {
+                                palette[k][c] = byteclamp(color[c] + modifier[k]);
+                            }
+                        }
+
+                        if (punchthrough)
+                        {
+                            // index 0 is the base color and index 2 is transparent
+                            for (int c = 0; c < 3; ++c)
+                            {
+                                palette[0][c] = color[c];
+                                palette[2][c] = INVALID_COLOR;
+                            }
+                        }
+
+                        u8 index[8];
+                        const float error = block.evaluate(order, half * 8, 8, palette, index);
+
+                        if (error < result.error)
+                        {
+                            result.base[0] = r;
+                            result.base[1] = g;
+                            result.base[2] = b;
+                            result.table = table;
+                            result.error = error;
+                            std::copy(index, index + 8, result.index);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    u64 packSubblocks(const ColorBlock& block, int order, bool differential, bool opaque,
+                      const Subblock& s0, const Subblock& s1)
+    {
+        u64 high;
+
+        if (differential)
+        {
+            const int dr = s1.base[0] - s0.base[0];
+            const int dg = s1.base[1] - s0.base[1];
+            const int db = s1.base[2] - s0.base[2];
+            high = (s0.base[0] << 27) | ((dr & 7) << 24) | (s0.base[1] << 19) | ((dg & 7) << 16) |
+                   (s0.base[2] << 11) | ((db & 7) << 8) | (opaque ? 2 : 0);
+        }
+        else
+        {
+            high = (s0.base[0] << 28) | (s1.base[0] << 24) | (s0.base[1] << 20) | (s1.base[1] << 16) |
+                   (s0.base[2] << 12) | (s1.base[2] << 8);
+        }
+
+        high |= (s0.table << 5) | (s1.table << 2) | order;
+
+        u64 low = 0;
+
+        for (int i = 0; i < 16; ++i)
+        {
+            const int pixel = getPixelIndex(order, i);
+            int index = i < 8 ? s0.index[i] : s1.index[i - 8];
+
+            if (block.transparent & (1 << pixel))
+            {
+                index = 2;
+            }
+
+            low |= u64(index & 1) << pixel;
+            low |= u64(index >> 1) << (pixel + 16);
+        }
+
+        return (high << 32) | low;
+    }
+
+    void encodeDifferentialModes(Candidate& best, const ColorBlock& block, int order,
+                                 bool thorough, bool punchthrough, bool individual)
+    {
+        int average[2][3];
+        block.average(average[0], order, 0);
+        block.average(average[1], order, 8);
+
+        const int radius = thorough ? 1 : 0;
+
+        // differential mode; the second base color is searched within the delta range of the first
+        int q5[2][3];
+        int low[3];
+        int high[3];
+
+        for (int c = 0; c < 3; ++c)
+        {
+            q5[0][c] = quantize(average[0][c], 5);
+            q5[1][c] = quantize(average[1][c], 5);
+            low[c] = std::max(0, q5[0][c] - radius);
+            high[c] = std::min(31, q5[0][c] + radius);
+        }
+
+        Subblock s0 = { };
+        Subblock s1 = { };
+        encodeSubblock(s0, block, order, 0, low, high, 5, punchthrough);
+
+        bool clamped = false;
+
+        for (int c = 0; c < 3; ++c)
+        {
+            const int minimum = std::max(0, s0.base[c] - 4);
+            const int maximum = std::min(31, s0.base[c] + 3);
+            low[c] = std::max(minimum, q5[1][c] - radius);
+            high[c] = std::min(maximum, q5[1][c] + radius);
+
+            if (low[c] > high[c])
+            {
+                low[c] = high[c] = std::min(maximum, std::max(minimum, q5[1][c]));
+                clamped = true;
+            }
+        }
+
+        encodeSubblock(s1, block, order, 1, low, high, 5, punchthrough);
+        best.update(packSubblocks(block, order, true, !punchthrough || !block.transparent, s0, s1), s0.error + s1.error);
+
+        // individual mode; the differential bit is the opaque flag in the punch-through blocks
+        if (individual && (thorough || clamped))
+        {
+            for (int half = 0; half < 2; ++half)
+            {
+                for (int c = 0; c < 3; ++c)
+                {
+                    const int q4 = quantize(average[half][c], 4);
+                    low[c] = std::max(0, q4 - radius);
+                    high[c] = std::min(15, q4 + radius);
+                }
+
+                encodeSubblock(half ? s1 : s0, block, order, half, low, high, 4, false);
+            }
+
+            best.update(packSubblocks(block, order, false, true, s0, s1), s0.error + s1.error);
+        }
+    }
+
+    // ----------------------------------------------------------------------------
+    // planar mode
+    // ----------------------------------------------------------------------------
+
+    float planarError(const ColorBlock& block, int c, int o, int h, int v)
+    {
+        float error = 0.0f;
+
+        for (int x = 0; x < 4; ++x)
+        {
+            for (int y = 0; y < 4; ++y)
+            {
+                const int value = byteclamp((x * (h - o) + y * (v - o) + 4 * o + 2) >> 2);
+                const float d = float(value - block.rgb[x * 4 + y][c]);
+                error += d * d;
+            }
+        }
+
+        return error;
+    }
+
+    void encodePlanarMode(Candidate& best, const ColorBlock& block, bool thorough)
+    {
+        // least squares fit of the plane: c(x, y) = O + x * (H - O) / 4 + y * (V - O) / 4
+        int plane[3][3];
+        float error = 0.0f;
+
+        for (int c = 0; c < 3; ++c)
+        {
+            float sum = 0.0f;
+            float sx = 0.0f;
+            float sy = 0.0f;
+
+            for (int x = 0; x < 4; ++x)
+            {
+                for (int y = 0; y < 4; ++y)
+                {
+                    const float value = float(block.rgb[x * 4 + y][c]);
+                    sum += value;
+                    sx += (x - 1.5f) * value;
+                    sy += (y - 1.5f) * value;
+                }
+            }
+
+            const float a = sx / 20.0f;
+            const float b = sy / 20.0f;
+            const float o = sum / 16.0f - 1.5f * a - 1.5f * b;
+            const float target[3] = { o, o + 4.0f * a, o + 4.0f * b };
+
+            const int bits = c == 1 ? 7 : 6;
+            const int maximum = (1 << bits) - 1;
+            const int radius = thorough ? 1 : 0;
+
+            int q[3];
+            for (int i = 0; i < 3; ++i)
+            {
+                q[i] = quantize(byteclamp(int(std::floor(target[i] + 0.5f))), bits);
+            }
+
+            float channelError = FLT_MAX;
+
+            for (int i = std::max(0, q[0] - radius); i <= std::min(maximum, q[0] + radius); ++i)
+            {
+                for (int j = std::max(0, q[1] - radius); j <= std::min(maximum, q[1] + radius); ++j)
+                {
+                    for (int k = std::max(0, q[2] - radius); k <= std::min(maximum, q[2] + radius); ++k)
+                    {
+                        const float e = planarError(block, c, expand(i, bits), expand(j, bits), expand(k, bits));
+                        if (e < channelError)
+                        {
+                            channelError = e;
+                            plane[c][0] = i;
+                            plane[c][1] = j;
+                            plane[c][2] = k;
+                        }
+                    }
+                }
+            }
+
+            error += channelError;
+        }
+
+        if (error >= best.error)
+            return;
+
+        const u64 ro = plane[0][0], rh = plane[0][1], rv = plane[0][2];
+        const u64 go = plane[1][0], gh = plane[1][1], gv = plane[1][2];
+        const u64 bo = plane[2][0], bh = plane[2][1], bv = plane[2][2];
+
+        u64 bits = (ro << 57) | ((go >> 6) << 56) | ((go & 63) << 49) | ((bo >> 5) << 48) |
+                   (((bo >> 3) & 3) << 43) | ((bo & 7) << 39) | ((rh >> 1) << 34) | (u64(1) << 33) |
+                   ((rh & 1) << 32) | (gh << 25) | (bh << 19) | (rv << 13) | (gv << 6) | bv;
+
+        const u64 mask = (u64(1) << 63) | (u64(1) << 55) | (u64(7) << 45) | (u64(1) << 42);
+        best.update(selectMode(bits, mask, 3), error);
+    }
+
+    // ----------------------------------------------------------------------------
+    // T and H modes
+    // ----------------------------------------------------------------------------
+
+    u64 packPaintIndices(const u8* index)
+    {
+        u64 low = 0;
+
+        for (int i = 0; i < 16; ++i)
+        {
+            low |= u64(index[i] & 1) << i;
+            low |= u64(index[i] >> 1) << (i + 16);
+        }
+
+        return low;
+    }
+
+    void encodeTHModes(Candidate& best, const ColorBlock& block)
+    {
+        // split the pixels into two clusters along the principal axis
+        float mean[3] = { 0.0f, 0.0f, 0.0f };
+
+        for (int i = 0; i < 16; ++i)
+        {
+            for (int c = 0; c < 3; ++c)
+            {
+                mean[c] += block.rgb[i][c] / 16.0f;
+            }
+        }
+
+        float covariance[3][3] = { };
+
+        for (int i = 0; i < 16; ++i)
+        {
+            float d[3];
+            for (int c = 0; c < 3; ++c)
+            {
+                d[c] = block.rgb[i][c] - mean[c];
+            }
+
+            for (int j = 0; j < 3; ++j)
+            {
+                for (int k = 0; k < 3; ++k)
+                {
+                    covariance[j][k] += d[j] * d[k];
+                }
+            }
+        }
+
+        float axis[3] = { 1.0f, 1.0f, 1.0f };
+
+        for (int iteration = 0; iteration < 4; ++iteration)
+        {
+            float next[3];
+            float scale = 0.0f;
+
+            for (int j = 0; j < 3; ++j)
+            {
+                next[j] = covariance[j][0] * axis[0] + covariance[j][1] * axis[1] + covariance[j][2] * axis[2];
+                scale = std::max(scale, std::abs(next[j]));
+            }
+
+            if (scale == 0.0f)
+                return;
+
+            for (int j = 0; j < 3; ++j)
+            {
+                axis[j] = next[j] / scale;
+            }
+        }
+
+        int cluster[2][3] = { };
+        int count[2] = { 0, 0 };
+
+        for (int i = 0; i < 16; ++i)
+        {
+            float projection = 0.0f;
+            for (int c = 0; c < 3; ++c)
+            {
+                projection += (block.rgb[i][c] - mean[c]) * axis[c];
+            }
+
+            const int side = projection > 0.0f;
+            for (int c = 0; c < 3; ++c)
+            {
+                cluster[side][c] += block.rgb[i][c];
+            }
+
+            ++count[side];
+        }
+
+        if (!count[0] || !count[1])
+            return;
+
+        int q[2][3];
+        int color[2][3];
+
+        for (int side = 0; side < 2; ++side)
+        {
+            for (int c = 0; c < 3; ++c)
+            {
+                q[side][c] = quantize((cluster[side][c] + count[side] / 2) / count[side], 4);
+                color[side][c] = expand(q[side][c], 4);
+            }
+        }
+
+        u8 index[16];
+
+        // H mode: two base colors, each with +/- distance; the order of the base colors
+        // stores the lowest bit of the distance index
+        const u32 value0 = (color[0][0] << 16) | (color[0][1] << 8) | color[0][2];
+        const u32 value1 = (color[1][0] << 16) | (color[1][1] << 8) | color[1][2];
+
+        for (int d = 0; d < 8; ++d)
+        {
+            int first = 0;
+
+            if (int(value0 >= value1) != (d & 1))
+            {
+                if (value0 == value1)
+                    continue;
+                first = 1;
+            }
+
+            const int* b0 = color[first];
+            const int* b1 = color[first ^ 1];
+            const int distance = g_etc_distance[d];
+
+            int palette[4][3];
+            for (int c = 0; c < 3; ++c)
+            {
+                palette[0][c] = byteclamp(b0[c] + distance);
+                palette[1][c] = byteclamp(b0[c] - distance);
+                palette[2][c] = byteclamp(b1[c] + distance);
+                palette[3][c] = byteclamp(b1[c] - distance);
+            }
+
+            const float error = block.evaluate(COLUMN_ORDER, 0, 16, palette, index);
+            if (error < best.error)
+            {
+                const u64 r1 = q[first][0], g1 = q[first][1], b1 = q[first][2];
+                const u64 r2 = q[first ^ 1][0], g2 = q[first ^ 1][1], b2 = q[first ^ 1][2];
+
+                u64 bits = (r1 << 59) | ((g1 >> 1) << 56) | ((g1 & 1) << 52) | ((b1 >> 3) << 51) |
+                           ((b1 & 7) << 47) | (r2 << 43) | (g2 << 39) | (b2 << 35) |
+                           (u64((d >> 2) & 1) << 34) | (u64(1) << 33) | (u64((d >> 1) & 1) << 32);
+
+                bits = (bits << 0) | packPaintIndices(index);
+
+                const u64 mask = (u64(1) << 63) | (u64(7) << 53) | (u64(1) << 50);
+                best.update(selectMode(bits, mask, 2), error);
+            }
+        }
+
+        // T mode: a single color and a base color with +/- distance
+        for (int single = 0; single < 2; ++single)
+        {
+            const int* c0 = color[single];
+            const int* c1 = color[single ^ 1];
+
+            for (int d = 0; d < 8; ++d)
+            {
+                const int distance = g_etc_distance[d];
+
+                int palette[4][3];
+                for (int c = 0; c < 3; ++c)
+                {
+                    palette[0][c] = c0[c];
+                    palette[1][c] = byteclamp(c1[c] + distance);
+                    palette[2][c] = c1[c];
+                    palette[3][c] = byteclamp(c1[c] - distance);
+                }
+
+                const float error = block.evaluate(COLUMN_ORDER, 0, 16, palette, index);
+                if (error < best.error)
+                {
+                    const u64 r1 = q[single][0], g1 = q[single][1], b1 = q[single][2];
+                    const u64 r2 = q[single ^ 1][0], g2 = q[single ^ 1][1], b2 = q[single ^ 1][2];
+
+                    u64 bits = ((r1 >> 2) << 59) | ((r1 & 3) << 56) | (g1 << 52) | (b1 << 48) |
+                               (r2 << 44) | (g2 << 40) | (b2 << 36) | (u64(d >> 1) << 34) |
+                               (u64(1) << 33) | (u64(d & 1) << 32);
+
+                    bits |= packPaintIndices(index);
+
+                    const u64 mask = (u64(7) << 61) | (u64(1) << 58);
+                    best.update(selectMode(bits, mask, 1), error);
+                }
+            }
+        }
+    }
+
+    u64 encodeColorBlock(const u8* input, int stride, bool thorough, bool punchthrough)
+    {
+        const ColorBlock block(input, stride, punchthrough);
+        const bool transparent = block.transparent != 0;
+
+        Candidate best;
+
+        for (int order = 0; order < 2; ++order)
+        {
+            encodeDifferentialModes(best, block, order, thorough, transparent, !punchthrough);
+        }
+
+        if (!transparent)
+        {
+            encodePlanarMode(best, block, thorough);
+
+            if (thorough)
+            {
+                encodeTHModes(best, block);
+            }
+        }
+
+        return best.bits;
+    }
+
+    // ----------------------------------------------------------------------------
+    // EAC
+    // ----------------------------------------------------------------------------
+
+    struct EacRange
+    {
+        int scale;
+        int offset;
+        int low;
+        int high;
+        int baseLow;
+        int baseHigh;
+        int multiplierLow;
+
+        int decode(int base, int multiplier, int modifier) const
+        {
+            const int delta = multiplier ? multiplier * modifier * scale : modifier;
+            return std::min(high, std::max(low, base * scale + offset + delta));
+        }
+    };
+
+    const EacRange g_eac_alpha    = { 1, 0,     0,  255,    0, 255, 1 };
+    const EacRange g_eac_unsigned = { 8, 4,     0, 2047,    0, 255, 0 };
+    const EacRange g_eac_signed   = { 8, 0, -1023, 1023, -127, 127, 0 };
+
+    float evaluateEAC(const float* values, const int* palette, u8* index)
+    {
+        float32x4 total = 0.0f;
+
+        for (int i = 0; i < 16; i += 4)
+        {
+            const float32x4 v = simd::f32x4_uload(values + i);
+
+            float32x4 best = FLT_MAX;
+            float32x4 nearest = 0.0f;
+
+            for (int k = 0; k < 8; ++k)
+            {
+                const float32x4 d = v - float32x4(float(palette[k]));
+                const float32x4 error = d * d;
+                const mask32x4 mask = error < best;
+                best = select(mask, error, best);
+                nearest = select(mask, float32x4(float(k)), nearest);
+            }
+
+            total = total + best;
+
+            float temp[4];
+            simd::f32x4_ustore(temp, nearest);
+
+            for (int j = 0; j < 4; ++j)
+            {
+                index[i + j] = u8(temp[j]);
+            }
+        }
+
+        return float(total.x) + float(total.y) + float(total.z) + float(total.w);
+    }
+
+    // values are in the ETC pixel order (x * 4 + y)
+    u64 encodeEAC(const float* values, const EacRange& range, bool thorough)
+    {
+        float vmin = values[0];
+        float vmax = values[0];
+
+        for (int i = 1; i < 16; ++i)
+        {
+            vmin = std::min(vmin, values[i]);
+            vmax = std::max(vmax, values[i]);
+        }
+
+        float bestError = FLT_MAX;
+        int bestBase = 0;
+        int bestMultiplier = 0;
+        int bestTable = 0;
+        u8 bestIndex[16] = { };
+
+        const int radius = thorough ? 1 : 0;
+
+        for (int table = 0; table < 16; ++table)
+        {
+            const int* modifier = g_eac_modifier[table];
+            const int mmin = modifier[3];
+            const int mmax = modifier[7];
+
+            // map the range of the modifiers to the range of the values
+            const float fit = (vmax - vmin) / float((mmax - mmin) * range.scale);
+            const int multiplier = std::min(15, std::max(range.multiplierLow, int(fit + 0.5f)));
+            const float center = (vmin + vmax) * 0.5f - (multiplier ? multiplier * range.scale : 1) * (mmin + mmax) * 0.5f;
+            // the center can be outside of the base range when the values are at the end
+            // of their range, for example opaque alpha
+            const int base = clamp(int(std::floor((center - range.offset) / range.scale + 0.5f)),
+                                   range.baseLow, range.baseHigh);
+
+            for (int m = std::max(range.multiplierLow, multiplier - radius); m <= std::min(15, multiplier + radius); ++m)
+            {
+                for (int b = std::max(range.baseLow, base - radius); b <= std::min(range.baseHigh, base + radius); ++b)
+                {
+                    int palette[8];
+                    for (int k = 0; k < 8; ++k)
+                    {
+                        palette[k] = range.decode(b, m, modifier[k]);
+                    }
+
+                    u8 index[16];
+                    const float error = evaluateEAC(values, palette, index);
+
+                    if (error < bestError)
+                    {
+                        bestError = error;
+                        bestBase = b;
+                        bestMultiplier = m;
+                        bestTable = table;
+                        std::copy(index, index + 16, bestIndex);
+                    }
+                }
+            }
+
+            if (!thorough && bestError == 0.0f)
+                break;
+        }
+
+        u64 bits = (u64(bestBase & 0xff) << 56) | (u64(bestMultiplier) << 52) | (u64(bestTable) << 48);
+
+        for (int i = 0; i < 16; ++i)
+        {
+            bits |= u64(bestIndex[i]) << (45 - i * 3);
+        }
+
+        return bits;
+    }
+
+    // Loads one 16 bit channel of the block in the ETC pixel order as 11 bit values.
+    void loadChannel11(float* values, const u8* input, int stride, int channels, int channel, bool isSigned)
+    {
+        for (int y = 0; y < 4; ++y)
+        {
+            const u8* scan = input + y * stride;
+
+            for (int x = 0; x < 4; ++x)
+            {
+                const u8* p = scan + (x * channels + channel) * 2;
+                float value;
+
+                if (isSigned)
+                {
+                    const s16 sample = s16(uload16(p));
+                    value = std::max(-1023.0f, std::floor(sample * (1023.0f / 32767.0f) + 0.5f));
+                }
+                else
+                {
+                    value = std::floor(uload16(p) * (2047.0f / 65535.0f) + 0.5f);
+                }
+
+                values[x * 4 + y] = value;
+            }
+        }
+    }
+
+    void encodeBlockETC2(const TextureCompressionInfo& info, u8* output, const u8* input, int stride, bool thorough)
+    {
+        switch (info.compression)
+        {
+            case TextureCompression::ETC2_RGBA:
+            case TextureCompression::ETC2_SRGB_ALPHA8:
+            {
+                float alpha[16];
+
+                for (int y = 0; y < 4; ++y)
+                {
+                    for (int x = 0; x < 4; ++x)
+                    {
+                        alpha[x * 4 + y] = input[y * stride + x * 4 + 3];
+                    }
+                }
+
+                ustore64be(output + 0, encodeEAC(alpha, g_eac_alpha, thorough));
+                ustore64be(output + 8, encodeColorBlock(input, stride, thorough, false));
+                break;
+            }
+
+            case TextureCompression::ETC2_RGB_ALPHA1:
+            case TextureCompression::ETC2_SRGB_ALPHA1:
+                ustore64be(output, encodeColorBlock(input, stride, thorough, true));
+                break;
+
+            default:
+                ustore64be(output, encodeColorBlock(input, stride, thorough, false));
+                break;
+        }
+    }
+
+    void encodeBlockEAC(const TextureCompressionInfo& info, u8* output, const u8* input, int stride, int channels, bool thorough)
+    {
+        const bool isSigned = (info.getCompressionFlags() & TextureCompressionInfo::SIGNED) != 0;
+        const EacRange& range = isSigned ? g_eac_signed : g_eac_unsigned;
+
+        for (int channel = 0; channel < channels; ++channel)
+        {
+            float values[16];
+            loadChannel11(values, input, stride, channels, channel, isSigned);
+            ustore64be(output + channel * 8, encodeEAC(values, range, thorough));
+        }
+    }
+
+} // namespace
+
+namespace mango
+{
+
+    void encode_block_etc2(const TextureCompressionInfo& info, u8* output, const u8* input, int stride)
+    {
+        encodeBlockETC2(info, output, input, stride, true);
+    }
+
+    void encode_block_etc2_fast(const TextureCompressionInfo& info, u8* output, const u8* input, int stride)
+    {
+        encodeBlockETC2(info, output, input, stride, false);
+    }
+
+    void encode_block_eac_r11(const TextureCompressionInfo& info, u8* output, const u8* input, int stride)
+    {
+        encodeBlockEAC(info, output, input, stride, 1, true);
+    }
+
+    void encode_block_eac_r11_fast(const TextureCompressionInfo& info, u8* output, const u8* input, int stride)
+    {
+        encodeBlockEAC(info, output, input, stride, 1, false);
+    }
+
+    void encode_block_eac_rg11(const TextureCompressionInfo& info, u8* output, const u8* input, int stride)
+    {
+        encodeBlockEAC(info, output, input, stride, 2, true);
+    }
+
+    void encode_block_eac_rg11_fast(const TextureCompressionInfo& info, u8* output, const u8* input, int stride)
+    {
+        encodeBlockEAC(info, output, input, stride, 2, false);
+    }
+
+} // namespace mango
@@ -0,0 +1,1022 @@
+/*
+    MANGO Multimedia Development Platform
+    Copyright (C) 2012-2019 Twilight Finland 3D Oy Ltd. All rights reserved.
+*/
+#include <climits>
+#include <cstring>
+#include <algorithm>
+#include <mango/core/core.hpp>
+#include <mango/image/image.hpp>
+
+#define ID "[Transcode] "
+
+// ----------------------------------------------------------------------------
+// ETC1S
+// ----------------------------------------------------------------------------
+
+// ETC1S is the subset of ETC1 where both sub-blocks share the base color and the
+// intensity table; the block is a differential mode ETC1 block with zero deltas. The
+// RGBA variant stores a second ETC1S block with gray base color for the alpha. The
+// four colors of a block lie on a line so the blocks are transcoded into the other
+// 4x4 formats from the base color, table and selectors without decoding the pixels.
+
+namespace mango
+{
+
+    int get_astc_partition_seed(int width, int height, const u8* partition);
+    void encode_block_astc_partition(const TextureCompressionInfo& info, u8* output, const u8* input, int stride, int seed);
+
+} // namespace mango
+
+namespace
+{
+    using namespace mango;
+
+    const int g_etc_modifier[8][2] =
+    {
+        {  2,   8 },
+        {  5,  17 },
+        {  9,  29 },
+        { 13,  42 },
+        { 18,  60 },
+        { 24,  80 },
+        { 33, 106 },
+        { 47, 183 }
+    };
+
+    const int g_eac_modifier[16][8] =
+    {
+        { -3, -6,  -9, -15, 2, 5, 8, 14 },
+        { -3, -7, -10, -13, 2, 6, 9, 12 },
+        { -2, -5,  -8, -13, 1, 4, 7, 12 },
+        { -2, -4,  -6, -13, 1, 3, 5, 12 },
+        { -3, -6,  -8, -12, 2, 5, 7, 11 },
+        { -3, -7,  -9, -11, 2, 6, 8, 10 },
+        { -4, -7,  -8, -11, 3, 6, 7, 10 },
+        { -3, -5,  -8, -11, 2, 4, 7, 10 },
+        { -2, -6,  -8, -10, 1, 5, 7,  9 },
+        { -2, -5,  -8, -10, 1, 4, 7,  9 },
+        { -2, -4,  -8, -10, 1, 3, 7,  9 },
+        { -2, -5,  -7, -10, 1, 4, 6,  9 },
+        { -3, -4,  -7, -10, 2, 3, 6,  9 },
+        { -1, -2,  -3, -10, 0, 1, 2,  9 },
+        { -4, -6,  -8,  -9, 3, 5, 7,  8 },
+        { -3, -5,  -7,  -9, 2, 4, 6,  8 }
+    };
+
+    // selectors from the smallest to the largest modifier
+    const int g_selector_order[4] = { 3, 2, 0, 1 };
+
+    inline int expand5(int value)
+    {
+        return (value << 3) | (value >> 2);
+    }
+
+    inline int getModifier(int table, int selector)
+    {
+        const int modifier = g_etc_modifier[table][selector & 1];
+        return selector & 2 ? -modifier : modifier;
+    }
+
+    inline int square(int value)
+    {
+        return value * value;
+    }
+
+    // ----------------------------------------------------------------------------
+    // block
+    // ----------------------------------------------------------------------------
+
+    struct BlockETC1S
+    {
+        int color[3]; // 5 bit base color
+        int table;
+        u8 selector[16]; // scanline order
+
+        void unpack(const u8* input)
+        {
+            const u64 data = uload64be(input);
+
+            color[0] = (data >> 59) & 0x1f;
+            color[1] = (data >> 51) & 0x1f;
+            color[2] = (data >> 43) & 0x1f;
+            table = (data >> 37) & 0x7;
+
+            // the pixels of ETC blocks are in column order
+            for (int i = 0; i < 16; ++i)
+            {
+                const int msb = (data >> (16 + i)) & 1;
+                const int lsb = (data >> i) & 1;
+                selector[(i & 3) * 4 + (i >> 2)] = u8(msb * 2 + lsb);
+            }
+        }
+
+        void pack(u8* output) const
+        {
+            u64 data = (u64(color[0]) << 59) | (u64(color[1]) << 51) | (u64(color[2]) << 43) |
+                       (u64(table) << 37) | (u64(table) << 34) | (u64(1) << 33);
+
+            for (int i = 0; i < 16; ++i)
+            {
+                const int s = selector[(i & 3) * 4 + (i >> 2)];
+                data |= u64(s >> 1) << (16 + i);
+                data |= u64(s & 1) << i;
+            }
+
+            ustore64be(output, data);
+        }
+
+        // values of a color component for each selector
+        void getValues(int* value, int component) const
+        {
+            const int base = expand5(color[component]);
+
+            for (int s = 0; s < 4; ++s)
+            {
+                value[s] = byteclamp(base + getModifier(table, s));
+            }
+        }
+
+        u32 getSelectorMask() const
+        {
+            u32 mask = 0;
+
+            for (int i = 0; i < 16; ++i)
+            {
+                mask |= 1 << selector[i];
+            }
+
+            return mask;
+        }
+
+        // the smallest and largest selectors used in the block
+        void getSelectorRange(int& low, int& high) const
+        {
+            const u32 mask = getSelectorMask();
+
+            low = 0;
+            while (!(mask & (1 << g_selector_order[low])))
+                ++low;
+
+            high = 3;
+            while (!(mask & (1 << g_selector_order[high])))
+                --high;
+
+            low = g_selector_order[low];
+            high = g_selector_order[high];
+        }
+    };
+
+    // alpha of the RGB blocks; the positive modifiers clamp to 255
+    BlockETC1S getOpaqueBlock()
+    {
+        BlockETC1S block;
+
+        block.color[0] = 31;
+        block.color[1] = 31;
+        block.color[2] = 31;
+        block.table = 0;
+        std::memset(block.selector, 0, 16);
+
+        return block;
+    }
+
+    // ----------------------------------------------------------------------------
+    // encoder
+    // ----------------------------------------------------------------------------
+
+    int evaluate(u8* selector, const int (*pixel)[3], const int* color, int table)
+    {
+        int palette[4][3];
+
+        for (int s = 0; s < 4; ++s)
+        {
+            const int modifier = getModifier(table, s);
+
+            for (int c = 0; c < 3; ++c)
+            {
+                palette[s][c] = byteclamp(expand5(color[c]) + modifier);
+            }
+        }
+
+        int error = 0;
+
+        for (int i = 0; i < 16; ++i)
+        {
+            int best = INT_MAX;
+
+            for (int s = 0; s < 4; ++s)
+            {
+                const int distance = square(pixel[i][0] - palette[s][0]) +
+                                     square(pixel[i][1] - palette[s][1]) +
+                                     square(pixel[i][2] - palette[s][2]);
+                if (distance < best)
+                {
+                    best = distance;
+                    selector[i] = u8(s);
+                }
+            }
+
+            error += best;
+        }
+
+        return error;
+    }
+
+    struct EncoderETC1S
+    {
+        BlockETC1S block;
+        int error = INT_MAX;
+
+        void search(const int (*pixel)[3], const int* color)
+        {
+            u8 selector[16];
+
+            for (int table = 0; table < 8; ++table)
+            {
+                const int e = evaluate(selector, pixel, color, table);
+                if (e < error)
+                {
+                    error = e;
+                    std::memcpy(block.color, color, sizeof(block.color));
+                    block.table = table;
+                    std::memcpy(block.selector, selector, 16);
+                }
+            }
+        }
+
+        // Searches the tables around the quantized average color; the thorough search
+        // also tries the neighbouring base colors and the base color which is the average
+        // of the pixels minus their modifiers. Gray blocks keep the components equal.
+        void encode(const int (*pixel)[3], bool gray, bool thorough)
+        {
+            int center[3];
+
+            for (int c = 0; c < 3; ++c)
+            {
+                int sum = 0;
+                for (int i = 0; i < 16; ++i)
+                {
+                    sum += pixel[i][c];
+                }
+
+                center[c] = ((sum + 8) / 16 * 31 + 127) / 255;
+            }
+
+            search(pixel, center);
+
+            if (!thorough)
+                return;
+
+            for (int d0 = -1; d0 <= 1; ++d0)
+            {
+                for (int d1 = -1; d1 <= 1; ++d1)
+                {
+                    for (int d2 = -1; d2 <= 1; ++d2)
+                    {
+                        if (gray && (d1 != d0 || d2 != d0))
+                            continue;
+
+                        if (!d0 && !d1 && !d2)
+                            continue;
+
+                        const int color[3] =
+                        {
+                            std::max(0, std::min(31, center[0] + d0)),
+                            std::max(0, std::min(31, center[1] + d1)),
+                            std::max(0, std::min(31, center[2] + d2))
+                        };
+
+                        search(pixel, color);
+                    }
+                }
+            }
+
+            int sum[3] = { 0, 0, 0 };
+
+            for (int i = 0; i < 16; ++i)
+            {
+                const int modifier = getModifier(block.table, block.selector[i]);
+
+                for (int c = 0; c < 3; ++c)
+                {
+                    sum[c] += pixel[i][c] - modifier;
+                }
+            }
+
+            int refined[3];
+
+            for (int c = 0; c < 3; ++c)
+            {
+                const int value = byteclamp((sum[c] + 8) >> 4);
+                refined[c] = (value * 31 + 127) / 255;
+            }
+
+            search(pixel, refined);
+        }
+    };
+
+    void encodeBlockETC1S(const TextureCompressionInfo& info, u8* output, const u8* input, int stride, bool thorough)
+    {
+        int color[16][3];
+        int alpha[16][3];
+
+        for (int y = 0; y < 4; ++y)
+        {
+            const u8* scan = input + y * stride;
+
+            for (int x = 0; x < 4; ++x)
+            {
+                const int i = y * 4 + x;
+                color[i][0] = scan[x * 4 + 0];
+                color[i][1] = scan[x * 4 + 1];
+                color[i][2] = scan[x * 4 + 2];
+                alpha[i][0] = scan[x * 4 + 3];
+                alpha[i][1] = scan[x * 4 + 3];
+                alpha[i][2] = scan[x * 4 + 3];
+            }
+        }
+
+        EncoderETC1S encoder;
+        encoder.encode(color, false, thorough);
+        encoder.block.pack(output);
+
+        if (info.bytes == 16)
+        {
+            EncoderETC1S encoder;
+            encoder.encode(alpha, true, thorough);
+            encoder.block.pack(output + 8);
+        }
+    }
+
+    void decodeBlockETC1S(u8* output, int stride, const u8* input, bool alpha)
+    {
+        BlockETC1S color;
+        color.unpack(input);
+
+        BlockETC1S opacity = getOpaqueBlock();
+        if (alpha)
+        {
+            opacity.unpack(input + 8);
+        }
+
+        int palette[4][4];
+
+        for (int c = 0; c < 3; ++c)
+        {
+            int value[4];
+            color.getValues(value, c);
+
+            for (int s = 0; s < 4; ++s)
+            {
+                palette[s][c] = value[s];
+            }
+        }
+
+        int value[4];
+        opacity.getValues(value, 1);
+
+        for (int y = 0; y < 4; ++y)
+        {
+            u8* scan = output + y * stride;
+
+            for (int x = 0; x < 4; ++x)
+            {
+                const int* p = palette[color.selector[y * 4 + x]];
+                scan[x * 4 + 0] = u8(p[0]);
+                scan[x * 4 + 1] = u8(p[1]);
+                scan[x * 4 + 2] = u8(p[2]);
+                scan[x * 4 + 3] = u8(value[opacity.selector[y * 4 + x]]);
+            }
+        }
+    }
+
+    // ----------------------------------------------------------------------------
+    // EAC
+    // ----------------------------------------------------------------------------
+
+    // The EAC codes which best approximate the four values of each intensity table and
+    // 5 bit base component are searched once. The same code works for the 8 bit alpha
+    // of ETC2 and the 11 bit R11 / RG11 blocks as the multiplier is never zero.
+
+    struct CodeEAC
+    {
+        u8 base;
+        u8 multiplier;
+        u8 table;
+        u8 index[4]; // EAC index of each ETC1S selector
+    };
+
+    struct TableEAC
+    {
+        CodeEAC code[8][32];
+
+        TableEAC()
+        {
+            for (int table = 0; table < 8; ++table)
+            {
+                for (int color = 0; color < 32; ++color)
+                {
+                    int value[4];
+                    for (int s = 0; s < 4; ++s)
+                    {
+                        value[s] = byteclamp(expand5(color) + getModifier(table, s));
+                    }
+
+                    code[table][color] = search(value);
+                }
+            }
+        }
+
+        static CodeEAC search(const int* value)
+        {
+            const int low = std::min(std::min(value[0], value[1]), std::min(value[2], value[3]));
+            const int high = std::max(std::max(value[0], value[1]), std::max(value[2], value[3]));
+            const int center = (low + high + 1) / 2;
+
+            CodeEAC best = { 0, 1, 0, { 0, 0, 0, 0 } };
+            int bestError = INT_MAX;
+
+            for (int table = 0; table < 16; ++table)
+            {
+                const int* modifier = g_eac_modifier[table];
+                const int span = modifier[7] - modifier[3];
+                const int estimate = (high - low + span / 2) / span;
+
+                for (int m = estimate - 1; m <= estimate + 1; ++m)
+                {
+                    const int multiplier = std::max(1, std::min(15, m));
+
+                    for (int base = center - 8; base <= center + 8; ++base)
+                    {
+                        if (base < 0 || base > 255)
+                            continue;
+
+                        CodeEAC code = { u8(base), u8(multiplier), u8(table), { 0, 0, 0, 0 } };
+                        int error = 0;
+
+                        for (int s = 0; s < 4; ++s)
+                        {
+                            int distance = INT_MAX;
+
+                            for (int k = 0; k < 8; ++k)
+                            {
+                                const int d = square(value[s] - byteclamp(base + modifier[k] * multiplier));
+                                if (d < distance)
+                                {
+                                    distance = d;
+                                    code.index[s] = u8(k);
+                                }
+                            }
+
+                            error += distance;
+                        }
+
+                        if (error < bestError)
+                        {
+                            bestError = error;
+                            best = code;
+                        }
+                    }
+                }
+            }
+
+            return best;
+        }
+    };
+
+    const TableEAC& getTableEAC()
+    {
+        static TableEAC table;
+        return table;
+    }
+
+    void transcodeEAC(u8* output, const BlockETC1S& block, int component)
+    {
+        const CodeEAC& code = getTableEAC().code[block.table][block.color[component]];
+
+        u64 data = (u64(code.base) << 56) | (u64(code.multiplier) << 52) | (u64(code.table) << 48);
+
+        for (int i = 0; i < 16; ++i)
+        {
+            const int s = block.selector[(i & 3) * 4 + (i >> 2)];
+            data |= u64(code.index[s]) << (45 - i * 3);
+        }
+
+        ustore64be(output, data);
+    }
+
+    // ----------------------------------------------------------------------------
+    // BC1 / BC4
+    // ----------------------------------------------------------------------------
+
+    void transcodeBC1(u8* output, const BlockETC1S& block)
+    {
+        int low;
+        int high;
+        block.getSelectorRange(low, high);
+
+        int color[4][3];
+
+        for (int c = 0; c < 3; ++c)
+        {
+            int value[4];
+            block.getValues(value, c);
+
+            for (int s = 0; s < 4; ++s)
+            {
+                color[s][c] = value[s];
+            }
+        }
+
+        const int r0 = (color[high][0] * 31 + 127) / 255;
+        const int g0 = (color[high][1] * 63 + 127) / 255;
+        const int b0 = (color[high][2] * 31 + 127) / 255;
+        const int r1 = (color[low][0] * 31 + 127) / 255;
+        const int g1 = (color[low][1] * 63 + 127) / 255;
+        const int b1 = (color[low][2] * 31 + 127) / 255;
+
+        // the components of the high color are never below the low color so the
+        // endpoints are ordered for the four color mode unless they are equal
+        const u16 c0 = u16((r0 << 11) | (g0 << 5) | b0);
+        const u16 c1 = u16((r1 << 11) | (g1 << 5) | b1);
+
+        u8 index[4] = { 0, 0, 0, 0 };
+
+        if (c0 != c1)
+        {
+            const int e0[3] = { expand5(r0), (g0 << 2) | (g0 >> 4), expand5(b0) };
+            const int e1[3] = { expand5(r1), (g1 << 2) | (g1 >> 4), expand5(b1) };
+
+            int palette[4][3];
+
+            for (int c = 0; c < 3; ++c)
+            {
+                palette[0][c] = e0[c];
+                palette[1][c] = e1[c];
+                palette[2][c] = (e0[c] * 2 + e1[c]) / 3;
+                palette[3][c] = (e0[c] + e1[c] * 2) / 3;
+            }
+
+            for (int s = 0; s < 4; ++s)
+            {
+                int best = INT_MAX;
+
+                for (int k = 0; k < 4; ++k)
+                {
+                    const int distance = square(color[s][0] - palette[k][0]) +
+                                         square(color[s][1] - palette[k][1]) +
+                                         square(color[s][2] - palette[k][2]);
+                    if (distance < best)
+                    {
+                        best = distance;
+                        index[s] = u8(k);
+                    }
+                }
+            }
+        }
+
+        u32 indices = 0;
+
+        for (int i = 0; i < 16; ++i)
+        {
+            indices |= u32(index[block.selector[i]]) << (i * 2);
+        }
+
+        ustore16le(output + 0, c0);
+        ustore16le(output + 2, c1);
+        ustore32le(output + 4, indices);
+    }
+
+    void transcodeBC4(u8* output, const BlockETC1S& block, int component)
+    {
+        int low;
+        int high;
+        block.getSelectorRange(low, high);
+
+        int value[4];
+        block.getValues(value, component);
+
+        const int v0 = value[high];
+        const int v1 = value[low];
+
+        u8 index[4] = { 0, 0, 0, 0 };
+
+        if (v0 != v1)
+        {
+            // eight value mode; the interpolated values are in steps of 1/7
+            for (int s = 0; s < 4; ++s)
+            {
+                const int step = ((v0 - value[s]) * 14 + (v0 - v1)) / ((v0 - v1) * 2);
+                const int k = std::max(0, std::min(7, step));
+                index[s] = u8(k == 0 ? 0 : k == 7 ? 1 : k + 1);
+            }
+        }
+
+        u64 indices = 0;
+
+        for (int i = 0; i < 16; ++i)
+        {
+            indices |= u64(index[block.selector[i]]) << (i * 3);
+        }
+
+        output[0] = u8(v0);
+        output[1] = u8(v1);
+
+        for (int i = 0; i < 6; ++i)
+        {
+            output[2 + i] = u8(indices >> (i * 8));
+        }
+    }
+
+    // ----------------------------------------------------------------------------
+    // ASTC
+    // ----------------------------------------------------------------------------
+
+    // 4x4 weight grid with four weight levels in a single plane; the endpoints fit with
+    // eight bits per component with both the RGB (CEM 8) and the RGBA (CEM 12) modes.
+    constexpr u32 ASTC_BLOCK_MODE_4x4_W2 = 0x042;
+
+    void packASTC(u8* output, const int* e0, const int* e1, bool alpha, const u8* weight)
+    {
+        u64 data[2] = { 0, 0 };
+
+        auto write = [&data] (int position, u32 value, int count)
+        {
+            for (int i = 0; i < count; ++i, ++position)
+            {
+                data[position >> 6] |= u64((value >> i) & 1) << (position & 63);
+            }
+        };
+
+        write(0, ASTC_BLOCK_MODE_4x4_W2, 11);
+        write(11, 0, 2); // single partition
+        write(13, alpha ? 12 : 8, 4);
+
+        const int components = alpha ? 4 : 3;
+
+        for (int c = 0; c < components; ++c)
+        {
+            write(17 + c * 16, e0[c], 8);
+            write(25 + c * 16, e1[c], 8);
+        }
+
+        // the weights are stored in reverse bit order from the end of the block
+        for (int i = 0; i < 16; ++i)
+        {
+            for (int b = 0; b < 2; ++b)
+            {
+                const int position = 127 - (i * 2 + b);
+                data[position >> 6] |= u64((weight[i] >> b) & 1) << (position & 63);
+            }
+        }
+
+        ustore64le(output + 0, data[0]);
+        ustore64le(output + 8, data[1]);
+    }
+
+    // The source block is flipped vertically to the bottom-left origin of the ASTC blocks.
+    void transcodeASTC(u8* output, const BlockETC1S& block, const BlockETC1S& opacity, bool alpha)
+    {
+        int low;
+        int high;
+        block.getSelectorRange(low, high);
+
+        int color[4][3];
+
+        for (int c = 0; c < 3; ++c)
+        {
+            int value[4];
+            block.getValues(value, c);
+
+            for (int s = 0; s < 4; ++s)
+            {
+                color[s][c] = value[s];
+            }
+        }
+
+        // the alpha is constant; the caller encodes the other blocks from the pixels
+        int value[4];
+        opacity.getValues(value, 1);
+        const int a = value[opacity.selector[0]];
+
+        const int e0[4] = { color[low][0], color[low][1], color[low][2], a };
+        const int e1[4] = { color[high][0], color[high][1], color[high][2], a };
+
+        const int sum0 = e0[0] + e0[1] + e0[2];
+        const int sum1 = e1[0] + e1[1] + e1[2];
+
+        u8 index[4] = { 0, 0, 0, 0 };
+
+        if (sum1 > sum0)
+        {
+            for (int s = 0; s < 4; ++s)
+            {
+                const int sum = color[s][0] + color[s][1] + color[s][2];
+                const int w = ((sum - sum0) * 6 + (sum1 - sum0)) / ((sum1 - sum0) * 2);
+                index[s] = u8(std::max(0, std::min(3, w)));
+            }
+        }
+
+        u8 weight[16];
+
+        for (int y = 0; y < 4; ++y)
+        {
+            for (int x = 0; x < 4; ++x)
+            {
+                weight[y * 4 + x] = index[block.selector[(3 - y) * 4 + x]];
+            }
+        }
+
+        packASTC(output, e0, e1, alpha, weight);
+    }
+
+    bool isConstantAlpha(const BlockETC1S& opacity)
+    {
+        const u32 mask = opacity.getSelectorMask();
+        return !(mask & (mask - 1));
+    }
+
+    // ----------------------------------------------------------------------------
+    // transcoder
+    // ----------------------------------------------------------------------------
+
+    struct Transcoder
+    {
+        TextureCompressionInfo target;
+        const u8* input;
+        int xblocks;
+        int yblocks;
+        int width;
+        int height;
+        bool alpha;
+
+        // the ASTC blocks are the flipped source blocks; otherwise the partition seed which
+        // splits them at the source block boundary
+        bool aligned;
+        int seed;
+
+        void transcodeBlock(u8* output, const u8* data) const
+        {
+            BlockETC1S block;
+            block.unpack(data);
+
+            BlockETC1S opacity = getOpaqueBlock();
+            if (alpha)
+            {
+                opacity.unpack(data + 8);
+            }
+
+            switch (target.compression)
+            {
+                case TextureCompression::ETC1_RGB:
+                case TextureCompression::ETC2_RGB:
+                case TextureCompression::ETC2_SRGB:
+                    std::memcpy(output, data, 8);
+                    break;
+
+                case TextureCompression::ETC2_RGBA:
+                case TextureCompression::ETC2_SRGB_ALPHA8:
+                    transcodeEAC(output, opacity, 1);
+                    std::memcpy(output + 8, data, 8);
+                    break;
+
+                case TextureCompression::EAC_R11:
+                    transcodeEAC(output, block, 0);
+                    break;
+
+                case TextureCompression::EAC_RG11:
+                    transcodeEAC(output + 0, block, 0);
+                    transcodeEAC(output + 8, block, 1);
+                    break;
+
+                case TextureCompression::DXT1:
+                case TextureCompression::DXT1_SRGB:
+                    transcodeBC1(output, block);
+                    break;
+
+                case TextureCompression::DXT5:
+                case TextureCompression::DXT5_SRGB:
+                    transcodeBC4(output, opacity, 1);
+                    transcodeBC1(output + 8, block);
+                    break;
+
+                case TextureCompression::RGTC1_RED:
+                    transcodeBC4(output, block, 0);
+                    break;
+
+                case TextureCompression::RGTC2_RG:
+                    transcodeBC4(output + 0, block, 0);
+                    transcodeBC4(output + 8, block, 1);
+                    break;
+
+                default:
+                    break;
+            }
+        }
+
+        void transcodeRows(u8* output, int y0, int y1) const
+        {
+            const int sourceBytes = alpha ? 16 : 8;
+
+            for (int y = y0; y < y1; ++y)
+            {
+                const u8* data = input + size_t(y) * xblocks * sourceBytes;
+                u8* dest = output + size_t(y) * xblocks * target.bytes;
+
+                for (int x = 0; x < xblocks; ++x)
+                {
+                    transcodeBlock(dest, data);
+                    data += sourceBytes;
+                    dest += target.bytes;
+                }
+            }
+        }
+
+        // The ASTC block rows start from the last scanline. When the height is a multiple of
+        // the block size each ASTC block is one source block flipped. Otherwise the image
+        // cannot be padded to align the blocks as the origins are at the opposite edges;
+        // each ASTC block has the rows of two source blocks and is encoded from the pixels
+        // with the two partition split at the source block boundary.
+        void transcodeRowsASTC(u8* output, int y0, int y1) const
+        {
+            const int sourceBytes = alpha ? 16 : 8;
+
+            for (int y = y0; y < y1; ++y)
+            {
+                u8* dest = output + size_t(y) * xblocks * target.bytes;
+
+                for (int x = 0; x < xblocks; ++x)
+                {
+                    if (aligned)
+                    {
+                        const u8* data = input + (size_t(yblocks - 1 - y) * xblocks + x) * sourceBytes;
+
+                        BlockETC1S block;
+                        block.unpack(data);
+
+                        BlockETC1S opacity = getOpaqueBlock();
+                        if (alpha)
+                        {
+                            opacity.unpack(data + 8);
+                        }
+
+                        if (isConstantAlpha(opacity))
+                        {
+                            transcodeASTC(dest, block, opacity, alpha);
+                            dest += target.bytes;
+                            continue;
+                        }
+                    }
+
+                    u8 pixels[16 * 4];
+                    decodePixels(pixels, x, y);
+                    encode_block_astc_partition(target, dest, pixels, 16, seed);
+                    dest += target.bytes;
+                }
+            }
+        }
+
+        // flipped 4x4 pixels of a bottom-left origin block; the rows below the image repeat
+        // the last scanline like the encoder does
+        void decodePixels(u8* pixels, int x, int y) const
+        {
+            const int sourceBytes = alpha ? 16 : 8;
+
+            u8 temp[2][16 * 4];
+            int cached[2] = { -1, -1 };
+
+            for (int row = 0; row < 4; ++row)
+            {
+                const int scanline = std::max(0, height - 1 - (y * 4 + row));
+                const int by = scanline >> 2;
+                const int slot = by & 1;
+
+                if (cached[slot] != by)
+                {
+                    const u8* data = input + (size_t(by) * xblocks + x) * sourceBytes;
+                    decodeBlockETC1S(temp[slot], 16, data, alpha);
+                    cached[slot] = by;
+                }
+
+                std::memcpy(pixels + row * 16, temp[slot] + (scanline & 3) * 16, 16);
+            }
+        }
+    };
+
+} // namespace
+
+namespace mango
+{
+
+    void decode_block_etc1s(const TextureCompressionInfo& info, u8* output, const u8* input, int stride)
+    {
+        decodeBlockETC1S(output, stride, input, info.bytes == 16);
+    }
+
+    void encode_block_etc1s(const TextureCompressionInfo& info, u8* output, const u8* input, int stride)
+    {
+        encodeBlockETC1S(info, output, input, stride, true);
+    }
+
+    void encode_block_etc1s_fast(const TextureCompressionInfo& info, u8* output, const u8* input, int stride)
+    {
+        encodeBlockETC1S(info, output, input, stride, false);
+    }
+
+    bool isTranscodable(TextureCompression source, TextureCompression target)
+    {
+        if (TextureCompressionInfo(source).getCompressionFormat() != TextureCompressionInfo::ETC1S)
+            return false;
+
+        switch (target)
+        {
+            case TextureCompression::ETC1_RGB:
+            case TextureCompression::ETC2_RGB:
+            case TextureCompression::ETC2_SRGB:
+            case TextureCompression::ETC2_RGBA:
+            case TextureCompression::ETC2_SRGB_ALPHA8:
+            case TextureCompression::EAC_R11:
+            case TextureCompression::EAC_RG11:
+            case TextureCompression::DXT1:
+            case TextureCompression::DXT1_SRGB:
+            case TextureCompression::DXT5:
+            case TextureCompression::DXT5_SRGB:
+            case TextureCompression::RGTC1_RED:
+            case TextureCompression::RGTC2_RG:
+            case TextureCompression::ASTC_RGBA_4x4:
+            case TextureCompression::ASTC_SRGB_ALPHA_4x4:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    void transcodeBlocks(Memory output, TextureCompression target, Memory input, TextureCompression source,
+                         int width, int height)
+    {
+        if (!isTranscodable(source, target))
+        {
+            MANGO_EXCEPTION(ID"Unsupported compression.");
+        }
+
+        Transcoder transcoder;
+        transcoder.target = TextureCompressionInfo(target);
+        transcoder.input = input.address;
+        transcoder.xblocks = round_multiple_up(width, 4);
+        transcoder.yblocks = round_multiple_up(height, 4);
+        transcoder.width = width;
+        transcoder.height = height;
+        transcoder.alpha = TextureCompressionInfo(source).bytes == 16;
+        transcoder.aligned = (height & 3) == 0;
+        transcoder.seed = -1;
+
+        const size_t blocks = size_t(transcoder.xblocks) * transcoder.yblocks;
+
+        if (input.size < blocks * (transcoder.alpha ? 16 : 8) ||
+            output.size < blocks * transcoder.target.bytes)
+        {
+            MANGO_EXCEPTION(ID"Incorrect image size.");
+        }
+
+        const bool astc = transcoder.target.getCompressionFormat() == TextureCompressionInfo::ASTC;
+
+        if (astc && !transcoder.aligned)
+        {
+            // the first rows of the flipped block are from one source block, the rest
+            // from the next one
+            u8 partition[16];
+            for (int i = 0; i < 16; ++i)
+            {
+                partition[i] = (i >> 2) >= (height & 3);
+            }
+
+            transcoder.seed = get_astc_partition_seed(4, 4, partition);
+        }
+
+        ConcurrentQueue queue;
+
+        // split the blocks into tasks of about a thousand blocks
+        const int rows = std::max(1, 1024 / transcoder.xblocks);
+
+        for (int y = 0; y < transcoder.yblocks; y += rows)
+        {
+            const int y1 = std::min(y + rows, transcoder.yblocks);
+
+            queue.enqueue([&transcoder, output, astc, y, y1]
+            {
+                if (astc)
+                {
+                    transcoder.transcodeRowsASTC(output.address, y, y1);
+                }
+                else
+                {
+                    transcoder.transcodeRows(output.address, y, y1);
+                }
+            });
+        }
+
+        queue.wait();
+    }
+
+} // namespace mango
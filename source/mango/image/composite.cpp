@@ -0,0 +1,584 @@
+/*
+    MANGO Multimedia Development Platform
+    Copyright (C) 2012-2019 Twilight Finland 3D Oy Ltd. All rights reserved.
+*/
+#include <cstring>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <limits>
+#include <mango/core/thread.hpp>
+#include <mango/image/image.hpp>
+#include <mango/math/srgb.hpp>
+#include "float_rows.hpp"
+
+namespace mango {
+namespace detail {
+
+    // ----------------------------------------------------------------------------
+    // premultiplied alpha
+    // ----------------------------------------------------------------------------
+
+    static inline u32 div255(u32 x)
+    {
+        x += 128;
+        return (x + (x >> 8)) >> 8;
+    }
+
+    // reciprocals of the alpha in 16.16 fixed point
+    struct ReciprocalTable
+    {
+        u32 value[256];
+
+        ReciprocalTable()
+        {
+            value[0] = 0;
+            for (u32 a = 1; a < 256; ++a)
+            {
+                value[a] = ((255u << 16) + a / 2) / a;
+            }
+        }
+    };
+
+    static const ReciprocalTable& getReciprocalTable()
+    {
+        static const ReciprocalTable table;
+        return table;
+    }
+
+    static void premultiply_u8_scalar(u8* dest, const u8* src, int width)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            const u32 a = src[3];
+            dest[0] = u8(div255(src[0] * a));
+            dest[1] = u8(div255(src[1] * a));
+            dest[2] = u8(div255(src[2] * a));
+            dest[3] = u8(a);
+            src += 4;
+            dest += 4;
+        }
+    }
+
+    void unpremultiply_u8(u8* dest, const u8* src, int width)
+    {
+        const u32* reciprocal = getReciprocalTable().value;
+
+        for (int x = 0; x < width; ++x)
+        {
+            const u32 a = src[3];
+            const u32 r = reciprocal[a];
+            dest[0] = u8(std::min((src[0] * r + 0x8000) >> 16, 255u));
+            dest[1] = u8(std::min((src[1] * r + 0x8000) >> 16, 255u));
+            dest[2] = u8(std::min((src[2] * r + 0x8000) >> 16, 255u));
+            dest[3] = u8(a);
+            src += 4;
+            dest += 4;
+        }
+    }
+
+#if defined(MANGO_ENABLE_SSE2)
+
+    // Two pixels are widened to 16 bits per component; the alpha of each pixel is
+    // broadcast into the components with a word shuffle.
+
+    static inline __m128i div255_sse2(__m128i x)
+    {
+        x = _mm_add_epi16(x, _mm_set1_epi16(128));
+        return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+    }
+
+    static inline __m128i alpha_sse2(__m128i v)
+    {
+        v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(3, 3, 3, 3));
+        return _mm_shufflehi_epi16(v, _MM_SHUFFLE(3, 3, 3, 3));
+    }
+
+    static inline __m128i premultiply_sse2(__m128i v)
+    {
+        // the alpha is multiplied with 255
+        const __m128i mask = _mm_set_epi16(0, -1, -1, -1, 0, -1, -1, -1);
+        const __m128i alpha = _mm_set_epi16(255, 0, 0, 0, 255, 0, 0, 0);
+        const __m128i a = _mm_or_si128(_mm_and_si128(alpha_sse2(v), mask), alpha);
+        return div255_sse2(_mm_mullo_epi16(v, a));
+    }
+
+    void premultiply_u8(u8* dest, const u8* src, int width)
+    {
+        const __m128i zero = _mm_setzero_si128();
+
+        for ( ; width >= 4; width -= 4)
+        {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src));
+            __m128i lo = premultiply_sse2(_mm_unpacklo_epi8(v, zero));
+            __m128i hi = premultiply_sse2(_mm_unpackhi_epi8(v, zero));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dest), _mm_packus_epi16(lo, hi));
+            src += 16;
+            dest += 16;
+        }
+
+        premultiply_u8_scalar(dest, src, width);
+    }
+
+#elif defined(MANGO_ENABLE_NEON)
+
+    // Two pixels are widened to 16 bits per component; the alpha of each pixel is
+    // broadcast into the components with a table lookup.
+
+    static inline uint16x8_t div255_neon(uint16x8_t x)
+    {
+        return vrshrq_n_u16(vrsraq_n_u16(x, x, 8), 8);
+    }
+
+    static inline uint16x8_t alpha_neon(uint8x8_t v)
+    {
+        const uint8x8_t index = { 3, 3, 3, 3, 7, 7, 7, 7 };
+        return vmovl_u8(vtbl1_u8(v, index));
+    }
+
+    static inline uint8x8_t premultiply_neon(uint8x8_t v)
+    {
+        const uint8x8_t index = { 3, 3, 3, 8, 7, 7, 7, 8 };
+        uint8x8x2_t table;
+        table.val[0] = v;
+        table.val[1] = vdup_n_u8(255);
+        const uint8x8_t a = vtbl2_u8(table, index);
+        return vmovn_u16(div255_neon(vmull_u8(v, a)));
+    }
+
+    void premultiply_u8(u8* dest, const u8* src, int width)
+    {
+        for ( ; width >= 4; width -= 4)
+        {
+            const uint8x16_t v = vld1q_u8(src);
+            uint8x8_t lo = premultiply_neon(vget_low_u8(v));
+            uint8x8_t hi = premultiply_neon(vget_high_u8(v));
+            vst1q_u8(dest, vcombine_u8(lo, hi));
+            src += 16;
+            dest += 16;
+        }
+
+        premultiply_u8_scalar(dest, src, width);
+    }
+
+#else
+
+    void premultiply_u8(u8* dest, const u8* src, int width)
+    {
+        premultiply_u8_scalar(dest, src, width);
+    }
+
+#endif
+
+    void premultiply_float(float* data, int width)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            float32x4 v = simd::f32x4_uload(data);
+            float32x4 c = v * v.wwww;
+            c.w = float(v.w);
+            simd::f32x4_ustore(data, c);
+            data += 4;
+        }
+    }
+
+    void unpremultiply_float(float* data, int width)
+    {
+        const float32x4 zero(0.0f);
+
+        for (int x = 0; x < width; ++x)
+        {
+            float32x4 v = simd::f32x4_uload(data);
+            float32x4 a = v.wwww;
+            float32x4 c = select(a > zero, v / a, zero);
+            c.w = float(v.w);
+            simd::f32x4_ustore(data, c);
+            data += 4;
+        }
+    }
+
+} // namespace detail
+} // namespace mango
+
+namespace
+{
+    using namespace mango;
+    using namespace mango::detail;
+
+    // ----------------------------------------------------------------------------
+    // Porter-Duff operators
+    // ----------------------------------------------------------------------------
+
+    // The result is source * Fa + dest * Fb with premultiplied colors, where
+    // Fa = a0 + a1 * dest.alpha and Fb = b0 + b1 * source.alpha.
+    struct Factors
+    {
+        int a0, a1;
+        int b0, b1;
+    };
+
+    const Factors g_factors[] =
+    {
+        { 0,  0, 0,  0 }, // CLEAR
+        { 1,  0, 0,  0 }, // SOURCE
+        { 0,  0, 1,  0 }, // DEST
+        { 1,  0, 1, -1 }, // SOURCE_OVER
+        { 1, -1, 1,  0 }, // DEST_OVER
+        { 0,  1, 0,  0 }, // SOURCE_IN
+        { 0,  0, 0,  1 }, // DEST_IN
+        { 1, -1, 0,  0 }, // SOURCE_OUT
+        { 0,  0, 1, -1 }, // DEST_OUT
+        { 0,  1, 1, -1 }, // SOURCE_ATOP
+        { 1, -1, 0,  1 }, // DEST_ATOP
+        { 1, -1, 1, -1 }, // XOR
+        { 1,  0, 1,  0 }, // PLUS
+    };
+
+    // ----------------------------------------------------------------------------
+    // 8 bit kernels
+    // ----------------------------------------------------------------------------
+
+    void composite_u8_scalar(u8* dest, const u8* src, int width, const Factors& factors, u32 opacity)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            u32 s[4];
+            for (int i = 0; i < 4; ++i)
+            {
+                s[i] = div255(src[i] * opacity);
+            }
+
+            const u32 fa = u32(factors.a0 * 255 + factors.a1 * int(dest[3]));
+            const u32 fb = u32(factors.b0 * 255 + factors.b1 * int(s[3]));
+
+            for (int i = 0; i < 4; ++i)
+            {
+                const u32 v = div255(s[i] * fa) + div255(dest[i] * fb);
+                dest[i] = u8(std::min(v, 255u));
+            }
+
+            src += 4;
+            dest += 4;
+        }
+    }
+
+#if defined(MANGO_ENABLE_SSE2)
+
+    static inline __m128i composite_sse2(__m128i& s, __m128i d, __m128i opacity,
+                                         __m128i a0, __m128i a1, __m128i b0, __m128i b1)
+    {
+        s = div255_sse2(_mm_mullo_epi16(s, opacity));
+        const __m128i fa = _mm_add_epi16(a0, _mm_mullo_epi16(a1, alpha_sse2(d)));
+        const __m128i fb = _mm_add_epi16(b0, _mm_mullo_epi16(b1, alpha_sse2(s)));
+        s = div255_sse2(_mm_mullo_epi16(s, fa));
+        return div255_sse2(_mm_mullo_epi16(d, fb));
+    }
+
+    void composite_u8(u8* dest, const u8* src, int width, const Factors& factors, u32 opacity)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i vopacity = _mm_set1_epi16(short(opacity));
+        const __m128i a0 = _mm_set1_epi16(short(factors.a0 * 255));
+        const __m128i a1 = _mm_set1_epi16(short(factors.a1));
+        const __m128i b0 = _mm_set1_epi16(short(factors.b0 * 255));
+        const __m128i b1 = _mm_set1_epi16(short(factors.b1));
+
+        for (int n = width & ~3; n; n -= 4)
+        {
+            __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src));
+            __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i *>(dest));
+            __m128i slo = _mm_unpacklo_epi8(s, zero);
+            __m128i shi = _mm_unpackhi_epi8(s, zero);
+            __m128i dlo = composite_sse2(slo, _mm_unpacklo_epi8(d, zero), vopacity, a0, a1, b0, b1);
+            __m128i dhi = composite_sse2(shi, _mm_unpackhi_epi8(d, zero), vopacity, a0, a1, b0, b1);
+            s = _mm_packus_epi16(slo, shi);
+            d = _mm_packus_epi16(dlo, dhi);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dest), _mm_adds_epu8(s, d));
+            src += 16;
+            dest += 16;
+        }
+
+        composite_u8_scalar(dest, src, width & 3, factors, opacity);
+    }
+
+#elif defined(MANGO_ENABLE_NEON)
+
+    static inline uint8x8_t composite_neon(uint8x8_t s8, uint8x8_t d8, uint8x8_t opacity,
+                                           uint16x8_t a0, uint16x8_t a1, uint16x8_t b0, uint16x8_t b1)
+    {
+        s8 = vmovn_u16(div255_neon(vmull_u8(s8, opacity)));
+        const uint16x8_t fa = vmlaq_u16(a0, a1, alpha_neon(d8));
+        const uint16x8_t fb = vmlaq_u16(b0, b1, alpha_neon(s8));
+        const uint16x8_t s = div255_neon(vmulq_u16(vmovl_u8(s8), fa));
+        const uint16x8_t d = div255_neon(vmulq_u16(vmovl_u8(d8), fb));
+        return vqadd_u8(vqmovn_u16(s), vqmovn_u16(d));
+    }
+
+    void composite_u8(u8* dest, const u8* src, int width, const Factors& factors, u32 opacity)
+    {
+        const uint8x8_t vopacity = vdup_n_u8(u8(opacity));
+        const uint16x8_t a0 = vdupq_n_u16(u16(factors.a0 * 255));
+        const uint16x8_t a1 = vdupq_n_u16(u16(factors.a1));
+        const uint16x8_t b0 = vdupq_n_u16(u16(factors.b0 * 255));
+        const uint16x8_t b1 = vdupq_n_u16(u16(factors.b1));
+
+        for (int n = width & ~3; n; n -= 4)
+        {
+            const uint8x16_t s = vld1q_u8(src);
+            const uint8x16_t d = vld1q_u8(dest);
+            uint8x8_t lo = composite_neon(vget_low_u8(s), vget_low_u8(d), vopacity, a0, a1, b0, b1);
+            uint8x8_t hi = composite_neon(vget_high_u8(s), vget_high_u8(d), vopacity, a0, a1, b0, b1);
+            vst1q_u8(dest, vcombine_u8(lo, hi));
+            src += 16;
+            dest += 16;
+        }
+
+        composite_u8_scalar(dest, src, width & 3, factors, opacity);
+    }
+
+#else
+
+    void composite_u8(u8* dest, const u8* src, int width, const Factors& factors, u32 opacity)
+    {
+        composite_u8_scalar(dest, src, width, factors, opacity);
+    }
+
+#endif
+
+    // ----------------------------------------------------------------------------
+    // float kernels
+    // ----------------------------------------------------------------------------
+
+    // the results are limited to one; the colors of floating point formats are not limited
+    void composite_float(float* dest, const float* src, int width, const Factors& factors, float opacity, float32x4 limit)
+    {
+        const float32x4 a0(float(factors.a0));
+        const float32x4 a1(float(factors.a1));
+        const float32x4 b0(float(factors.b0));
+        const float32x4 b1(float(factors.b1));
+
+        for (int x = 0; x < width; ++x)
+        {
+            float32x4 s = simd::f32x4_uload(src) * opacity;
+            float32x4 d = simd::f32x4_uload(dest);
+            float32x4 fa = madd(a0, a1, d.wwww);
+            float32x4 fb = madd(b0, b1, s.wwww);
+            simd::f32x4_ustore(dest, min(madd(s * fa, d, fb), limit));
+            src += 4;
+            dest += 4;
+        }
+    }
+
+    // conversions between sRGB and linear light; the alpha is linear
+    void linearize_float(float* data, int width)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            float32x4 v = simd::f32x4_uload(data);
+            float32x4 c = srgb_to_linear(clamp(v, 0.0f, 1.0f));
+            c.w = float(v.w);
+            simd::f32x4_ustore(data, c);
+            data += 4;
+        }
+    }
+
+    void delinearize_float(float* data, int width)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            float32x4 v = simd::f32x4_uload(data);
+            float32x4 c = linear_to_srgb(clamp(v, 0.0f, 1.0f));
+            c.w = float(v.w);
+            simd::f32x4_ustore(data, c);
+            data += 4;
+        }
+    }
+
+    void premultiplySurface(const Surface& surface, bool linear, bool inverse)
+    {
+        if (!surface.format.alpha())
+            return;
+
+        const int width = surface.width;
+
+        if (!linear && isByteAlphaFormat(surface.format))
+        {
+            processBands("premultiply", width, surface.height, [&] (int y0, int y1)
+            {
+                for (int y = y0; y < y1; ++y)
+                {
+                    u8* scan = surface.address<u8>(0, y);
+                    if (inverse)
+                        unpremultiply_u8(scan, scan, width);
+                    else
+                        premultiply_u8(scan, scan, width);
+                }
+            });
+            return;
+        }
+
+        FloatRows rows(surface.format, true, linear);
+
+        processBands("premultiply", width, surface.height, [&] (int y0, int y1)
+        {
+            std::vector<float> temp(width * 4);
+
+            for (int y = y0; y < y1; ++y)
+            {
+                u8* scan = surface.address<u8>(0, y);
+                float* data = rows.read(temp.data(), scan, width);
+
+                if (inverse)
+                    unpremultiply_float(data, width);
+                else
+                    premultiply_float(data, width);
+
+                rows.write(scan, data, width);
+            }
+        });
+    }
+
+} // namespace
+
+namespace mango
+{
+
+    void Surface::premultiply(bool linear)
+    {
+        premultiplySurface(*this, linear, false);
+    }
+
+    void Surface::unpremultiply(bool linear)
+    {
+        premultiplySurface(*this, linear, true);
+    }
+
+    void Surface::composite(int x, int y, const Surface& source, const CompositeOptions& options)
+    {
+        if (!source.width || !source.height || !source.format.bits || !format.bits)
+            return;
+
+        // clip the source rectangle to this surface
+        const int x0 = std::max(x, 0);
+        const int y0 = std::max(y, 0);
+        const int x1 = std::min(x + source.width, width);
+        const int y1 = std::min(y + source.height, height);
+
+        if (x0 >= x1 || y0 >= y1)
+            return;
+
+        const Surface dest(*this, x0, y0, x1 - x0, y1 - y0);
+        const Surface src(source, x0 - x, y0 - y, x1 - x0, y1 - y0);
+
+        const Factors& factors = g_factors[int(options.mode)];
+        const float opacity = std::max(0.0f, std::min(1.0f, options.opacity));
+        const bool premultiplied = options.premultiplied;
+        const bool linear = options.linear;
+        const int w = dest.width;
+
+        if (!linear && isByteAlphaFormat(dest.format))
+        {
+            // the source is converted into the layout of the destination
+            std::unique_ptr<Blitter> input;
+            if (src.format != dest.format)
+            {
+                input.reset(new Blitter(dest.format, src.format));
+            }
+
+            const u32 opacity8 = u32(opacity * 255.0f + 0.5f);
+
+            processBands("composite", w, dest.height, [&] (int y0, int y1)
+            {
+                std::vector<u8> stemp(w * 4);
+                std::vector<u8> dtemp(w * 4);
+
+                for (int y = y0; y < y1; ++y)
+                {
+                    const u8* s = src.address<u8>(0, y);
+                    u8* d = dest.address<u8>(0, y);
+
+                    if (input)
+                    {
+                        BlitRect rect;
+                        rect.src.address = const_cast<u8*>(s);
+                        rect.src.stride = 0;
+                        rect.dest.address = stemp.data();
+                        rect.dest.stride = 0;
+                        rect.width = w;
+                        rect.height = 1;
+                        input->convert(rect);
+                        s = stemp.data();
+                    }
+
+                    if (premultiplied)
+                    {
+                        composite_u8(d, s, w, factors, opacity8);
+                    }
+                    else
+                    {
+                        premultiply_u8(stemp.data(), s, w);
+                        premultiply_u8(dtemp.data(), d, w);
+                        composite_u8(dtemp.data(), stemp.data(), w, factors, opacity8);
+                        unpremultiply_u8(d, dtemp.data(), w);
+                    }
+                }
+            });
+            return;
+        }
+
+        FloatRows srcRows(src.format, false);
+        FloatRows destRows(dest.format, true);
+
+        const bool hdr = dest.format.type == Format::FP16 || dest.format.type == Format::FP32;
+        const float color = hdr ? std::numeric_limits<float>::max() : 1.0f;
+        const float32x4 limit(color, color, color, 1.0f);
+
+        // the operators work on premultiplied colors in the working color space
+        auto prepare = [=] (float* data)
+        {
+            if (linear)
+            {
+                if (premultiplied)
+                    unpremultiply_float(data, w);
+                linearize_float(data, w);
+            }
+
+            if (!premultiplied || linear)
+                premultiply_float(data, w);
+        };
+
+        auto finish = [=] (float* data)
+        {
+            if (!premultiplied || linear)
+                unpremultiply_float(data, w);
+
+            if (linear)
+            {
+                delinearize_float(data, w);
+                if (premultiplied)
+                    premultiply_float(data, w);
+            }
+        };
+
+        processBands("composite", w, dest.height, [&] (int y0, int y1)
+        {
+            std::vector<float> stemp(w * 4);
+            std::vector<float> dtemp(w * 4);
+
+            for (int y = y0; y < y1; ++y)
+            {
+                u8* scan = dest.address<u8>(0, y);
+                float* s = srcRows.read(stemp.data(), src.address<u8>(0, y), w);
+                float* d = destRows.read(dtemp.data(), scan, w);
+
+                prepare(s);
+                prepare(d);
+                composite_float(d, s, w, factors, opacity, limit);
+                finish(d);
+
+                destRows.write(scan, d, w);
+            }
+        });
+    }
+
+} // namespace mango
@@ -0,0 +1,498 @@
+/*
+    MANGO Multimedia Development Platform
+    Copyright (C) 2012-2019 Twilight Finland 3D Oy Ltd. All rights reserved.
+*/
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <algorithm>
+#include <mango/core/endian.hpp>
+#include <mango/core/thread.hpp>
+#include <mango/image/image.hpp>
+#include <mango/math/math.hpp>
+#include "float_rows.hpp"
+
+namespace
+{
+    using namespace mango;
+    using namespace mango::detail;
+
+    // ----------------------------------------------------------------------------
+    // threshold matrices
+    // ----------------------------------------------------------------------------
+
+    const u8 g_bayer8x8[] =
+    {
+         0, 32,  8, 40,  2, 34, 10, 42,
+        48, 16, 56, 24, 50, 18, 58, 26,
+        12, 44,  4, 36, 14, 46,  6, 38,
+        60, 28, 52, 20, 62, 30, 54, 22,
+         3, 35, 11, 43,  1, 33,  9, 41,
+        51, 19, 59, 27, 49, 17, 57, 25,
+        15, 47,  7, 39, 13, 45,  5, 37,
+        63, 31, 55, 23, 61, 29, 53, 21,
+    };
+
+    constexpr int BLUE_NOISE_SIZE = 32;
+
+    // Blue noise thresholds from the void-and-cluster method; the energy of each pixel
+    // is the sum of a gaussian of the toroidal distance to the set pixels and it is
+    // updated incrementally when a pixel is set or cleared.
+    struct BlueNoise
+    {
+        enum { N = BLUE_NOISE_SIZE, SIZE = N * N };
+
+        float threshold[SIZE];
+
+        float gaussian[SIZE];
+        float energy[SIZE];
+        bool pattern[SIZE];
+
+        void update(int index, float sign)
+        {
+            const int x0 = index % N;
+            const int y0 = index / N;
+
+            for (int y = 0; y < N; ++y)
+            {
+                const int dy = (y - y0 + N) % N;
+                for (int x = 0; x < N; ++x)
+                {
+                    const int dx = (x - x0 + N) % N;
+                    energy[y * N + x] += sign * gaussian[dy * N + dx];
+                }
+            }
+        }
+
+        // the set pixel with the highest energy, or the clear pixel with the lowest
+        int find(bool cluster) const
+        {
+            int best = -1;
+            for (int i = 0; i < SIZE; ++i)
+            {
+                if (pattern[i] == cluster)
+                {
+                    if (best < 0 || (cluster ? energy[i] > energy[best] : energy[i] < energy[best]))
+                        best = i;
+                }
+            }
+            return best;
+        }
+
+        void set(int index, bool value)
+        {
+            pattern[index] = value;
+            update(index, value ? 1.0f : -1.0f);
+        }
+
+        BlueNoise()
+        {
+            const float sigma = 1.5f;
+
+            for (int y = 0; y < N; ++y)
+            {
+                const int dy = std::min(y, N - y);
+                for (int x = 0; x < N; ++x)
+                {
+                    const int dx = std::min(x, N - x);
+                    gaussian[y * N + x] = std::exp(-float(dx * dx + dy * dy) / (2.0f * sigma * sigma));
+                }
+            }
+
+            std::fill(energy, energy + SIZE, 0.0f);
+            std::fill(pattern, pattern + SIZE, false);
+
+            // initial random pattern
+            const int ones = SIZE / 10;
+            u32 seed = 0x9e3779b9;
+
+            for (int count = 0; count < ones; )
+            {
+                seed = seed * 1664525 + 1013904223;
+                const int index = int(seed >> 22) % SIZE;
+                if (!pattern[index])
+                {
+                    set(index, true);
+                    ++count;
+                }
+            }
+
+            // move the pixels from the tightest clusters into the largest voids
+            for (int i = 0; i < SIZE; ++i)
+            {
+                const int cluster = find(true);
+                set(cluster, false);
+
+                const int empty = find(false);
+                set(empty, true);
+
+                if (empty == cluster)
+                    break;
+            }
+
+            bool initial[SIZE];
+            float initialEnergy[SIZE];
+            std::memcpy(initial, pattern, sizeof(initial));
+            std::memcpy(initialEnergy, energy, sizeof(initialEnergy));
+
+            int rank[SIZE];
+
+            // rank the initial pixels by removing the tightest clusters
+            for (int r = ones - 1; r >= 0; --r)
+            {
+                const int cluster = find(true);
+                set(cluster, false);
+                rank[cluster] = r;
+            }
+
+            std::memcpy(pattern, initial, sizeof(initial));
+            std::memcpy(energy, initialEnergy, sizeof(initialEnergy));
+
+            // rank the remaining pixels by filling the largest voids
+            for (int r = ones; r < SIZE; ++r)
+            {
+                const int empty = find(false);
+                set(empty, true);
+                rank[empty] = r;
+            }
+
+            for (int i = 0; i < SIZE; ++i)
+            {
+                threshold[i] = (rank[i] + 0.5f) / SIZE;
+            }
+        }
+    };
+
+    const BlueNoise& getBlueNoise()
+    {
+        static const BlueNoise noise;
+        return noise;
+    }
+
+    // ----------------------------------------------------------------------------
+    // Quantizer
+    // ----------------------------------------------------------------------------
+
+    // BT.601 luma, the weights of the JPEG encoder
+    void luminance_float(float* data, int width)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            const float luma = data[0] * 0.299f + data[1] * 0.587f + data[2] * 0.114f;
+            data[0] = luma;
+            data[1] = luma;
+            data[2] = luma;
+            data += 4;
+        }
+    }
+
+    // Converts RGBA32F rows into the destination format. The components are quantized
+    // with a per pixel bias instead of the rounding of Blitter; the bias is the threshold
+    // of the ordered dithering for the components which lose precision and 0.5 for the
+    // others. The color is converted to luminance before it is quantized into luminance
+    // formats.
+    class Quantizer
+    {
+    protected:
+        const Surface& m_dest;
+        const Surface& m_source;
+        FloatRows m_rows;
+        bool m_luminance;
+
+        int m_components;
+        int m_channel[4];   // component of the RGBA32F row
+        int m_offset[4];    // bit offset in the destination pixel
+        float m_scale[4];   // largest value of the destination component
+
+        float32x4 m_scalev;
+        float32x4 m_dither;  // one for the components which are dithered
+
+    public:
+        bool narrowing;
+
+        Quantizer(const Surface& dest, const Surface& source)
+            : m_dest(dest)
+            , m_source(source)
+            , m_rows(source.format, false)
+            , m_luminance(dest.format.luminance() && !source.format.luminance())
+            , m_components(0)
+            , narrowing(false)
+        {
+            const Format& df = dest.format;
+            const Format& sf = source.format;
+
+            const bool floating = sf.type == Format::FP16 || sf.type == Format::FP32;
+            const bool luminance = df.luminance();
+
+            float scale[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+            float dither[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+            for (int i = 0; i < 4; ++i)
+            {
+                // the luminance is stored from the red component
+                if (!df.size[i] || (luminance && (i == 1 || i == 2)))
+                    continue;
+
+                m_channel[m_components] = i;
+                m_offset[m_components] = df.offset[i];
+                m_scale[m_components] = float((u64(1) << df.size[i]) - 1);
+                scale[i] = m_scale[m_components];
+                ++m_components;
+
+                // the luminance computed from the color has more precision than the color
+                const int precision = floating || (m_luminance && i == 0) ? 32 : sf.size[i];
+                if (precision > df.size[i])
+                {
+                    dither[i] = 1.0f;
+                    narrowing = true;
+                }
+            }
+
+            m_scalev = float32x4(scale[0], scale[1], scale[2], scale[3]);
+            m_dither = float32x4(dither[0], dither[1], dither[2], dither[3]);
+        }
+
+        const float* read(float* temp, int y) const
+        {
+            const int width = m_dest.width;
+            float* data = m_rows.read(temp, m_source.address<u8>(0, y), width);
+
+            if (m_luminance)
+            {
+                luminance_float(data, width);
+            }
+
+            return data;
+        }
+
+        // stores the quantized components of a pixel
+        void store(u8* dest, int x, int32x4 value) const
+        {
+            s32 q[4];
+            simd::s32x4_ustore(q, value);
+
+            u64 color = 0;
+            for (int i = 0; i < m_components; ++i)
+            {
+                color |= u64(u32(q[m_channel[i]])) << m_offset[i];
+            }
+
+            const int bytes = m_dest.format.bytes();
+            dest += x * bytes;
+
+            for (int i = 0; i < bytes; ++i)
+            {
+                dest[i] = u8(color >> (i * 8));
+            }
+        }
+
+        // ordered dithering; the thresholds repeat every size pixels
+        void ordered(int y0, int y1, const float* threshold, int size) const
+        {
+            const int width = m_dest.width;
+            std::vector<float> temp(width * 4);
+
+            const float32x4 zero(0.0f);
+            const float32x4 one(1.0f);
+            const float32x4 half(0.5f);
+
+            for (int y = y0; y < y1; ++y)
+            {
+                const float* data = read(temp.data(), y);
+
+                const float* row = threshold + (y % size) * size;
+                u8* dest = m_dest.address<u8>(0, y);
+
+                for (int x = 0; x < width; ++x)
+                {
+                    float32x4 v = simd::f32x4_uload(data + x * 4);
+                    v = clamp(v, zero, one);
+                    float32x4 bias = madd(half, m_dither, float32x4(row[x % size] - 0.5f));
+                    store(dest, x, truncate<int32x4>(madd(bias, v, m_scalev)));
+                }
+            }
+        }
+
+        // Floyd-Steinberg error diffusion of one row; the error of each pixel is added to the
+        // next pixel and to three pixels of the next row. The progress of the previous row is
+        // checked before the pixels which it diffuses into are read.
+        void diffuse(int y, float* error, float* next, const std::atomic<int>* previous, std::atomic<int>& progress) const
+        {
+            const int width = m_dest.width;
+            std::vector<float> temp(width * 4);
+
+            const float* data = read(temp.data(), y);
+
+            u8* dest = m_dest.address<u8>(0, y);
+
+            const float32x4 zero(0.0f);
+            const float32x4 half(0.5f);
+            const float32x4 w7(7.0f / 16.0f);
+            const float32x4 w3(3.0f / 16.0f);
+            const float32x4 w5(5.0f / 16.0f);
+            const float32x4 w1(1.0f / 16.0f);
+            const float32x4 rcp = select(m_scalev > zero, 1.0f / m_scalev, zero);
+
+            float32x4 carry = zero;
+
+            constexpr int chunk = 32;
+
+            for (int x0 = 0; x0 < width; x0 += chunk)
+            {
+                const int x1 = std::min(x0 + chunk, width);
+
+                if (previous)
+                {
+                    // the error of the previous row is complete one pixel past the chunk
+                    const int ready = std::min(x1 + 1, width);
+                    while (previous->load(std::memory_order_acquire) < ready)
+                    {
+                        std::this_thread::yield();
+                    }
+                }
+
+                for (int x = x0; x < x1; ++x)
+                {
+                    // the error buffers have one pixel of padding on both sides
+                    float* e = error + (x + 1) * 4;
+                    float* n = next + (x + 1) * 4;
+
+                    float32x4 v = simd::f32x4_uload(data + x * 4);
+                    v = v + simd::f32x4_uload(e) + carry;
+                    simd::f32x4_ustore(e, zero);
+
+                    float32x4 q = clamp(floor(madd(half, v, m_scalev)), zero, m_scalev);
+                    float32x4 diff = (v - q * rcp) * m_dither;
+
+                    store(dest, x, truncate<int32x4>(q));
+
+                    float32x4 n0 = simd::f32x4_uload(n - 4);
+                    float32x4 n1 = simd::f32x4_uload(n + 0);
+                    float32x4 n2 = simd::f32x4_uload(n + 4);
+
+                    carry = diff * w7;
+                    simd::f32x4_ustore(n - 4, madd(n0, diff, w3));
+                    simd::f32x4_ustore(n + 0, madd(n1, diff, w5));
+                    simd::f32x4_ustore(n + 4, madd(n2, diff, w1));
+                }
+
+                progress.store(x1, std::memory_order_release);
+            }
+        }
+    };
+
+    // The rows are diffused as a wavefront: each row is a task which follows the previous
+    // row a few pixels behind. The tasks are queued in order from one thread so a task
+    // never waits for a row which has not been started. The error buffers of the rows
+    // alternate; a row has consumed the error it reads before the row after it writes
+    // into the same buffer.
+    void diffuseRows(const Quantizer& quantizer, int width, int height)
+    {
+        std::vector<float> buffer(2 * (width + 2) * 4, 0.0f);
+        float* errors[] = { buffer.data(), buffer.data() + (width + 2) * 4 };
+
+        std::unique_ptr<std::atomic<int>[]> progress(new std::atomic<int>[height]);
+        for (int y = 0; y < height; ++y)
+        {
+            progress[y] = 0;
+        }
+
+        const int threads = ThreadPool::getInstanceSize();
+
+        if (threads < 2 || width * height < 16384 || height < 2)
+        {
+            for (int y = 0; y < height; ++y)
+            {
+                quantizer.diffuse(y, errors[y & 1], errors[~y & 1], nullptr, progress[y]);
+            }
+            return;
+        }
+
+        ConcurrentQueue queue("dither", Priority::HIGH);
+
+        for (int y = 0; y < height; ++y)
+        {
+            queue.enqueue([&quantizer, &errors, &progress, y]
+            {
+                const std::atomic<int>* previous = y ? &progress[y - 1] : nullptr;
+                quantizer.diffuse(y, errors[y & 1], errors[~y & 1], previous, progress[y]);
+            });
+        }
+
+        queue.wait();
+    }
+
+} // namespace
+
+namespace mango
+{
+
+    void Surface::blit(int x, int y, const Surface& source, Dither dither)
+    {
+        if (dither == Dither::NONE || format.type != Format::UNORM || format.bits > 64 || !source.format.bits)
+        {
+            blit(x, y, source);
+            return;
+        }
+
+        // clip the source rectangle to this surface
+        const int x0 = std::max(x, 0);
+        const int y0 = std::max(y, 0);
+        const int x1 = std::min(x + source.width, width);
+        const int y1 = std::min(y + source.height, height);
+
+        if (x0 >= x1 || y0 >= y1)
+            return;
+
+        const Surface dest(*this, x0, y0, x1 - x0, y1 - y0);
+        const Surface src(source, x0 - x, y0 - y, x1 - x0, y1 - y0);
+
+        Quantizer quantizer(dest, src);
+
+        if (!quantizer.narrowing)
+        {
+            blit(x, y, source);
+            return;
+        }
+
+        switch (dither)
+        {
+            case Dither::BAYER:
+            {
+                float threshold[64];
+                for (int i = 0; i < 64; ++i)
+                {
+                    threshold[i] = (g_bayer8x8[i] + 0.5f) / 64.0f;
+                }
+
+                processBands("dither", dest.width, dest.height, [&] (int y0, int y1)
+                {
+                    quantizer.ordered(y0, y1, threshold, 8);
+                });
+                break;
+            }
+
+            case Dither::BLUE_NOISE:
+            {
+                const float* threshold = getBlueNoise().threshold;
+
+                processBands("dither", dest.width, dest.height, [&] (int y0, int y1)
+                {
+                    quantizer.ordered(y0, y1, threshold, BLUE_NOISE_SIZE);
+                });
+                break;
+            }
+
+            case Dither::FLOYD_STEINBERG:
+                diffuseRows(quantizer, dest.width, dest.height);
+                break;
+
+            default:
+                break;
+        }
+    }
+
+} // namespace mango
@@ -0,0 +1,241 @@
+/*
+    MANGO Multimedia Development Platform
+    Copyright (C) 2012-2019 Twilight Finland 3D Oy Ltd. All rights reserved.
+*/
+#include <cstring>
+#include <mango/core/endian.hpp>
+#include <mango/math/srgb.hpp>
+#include "float_rows.hpp"
+
+namespace
+{
+    using namespace mango;
+
+    constexpr int LINEAR_BITS = 14;
+
+    // conversions between 8 bit sRGB and linear light
+    struct LinearTables
+    {
+        float linear[256];
+        u8 srgb[(1 << LINEAR_BITS) + 1];
+
+        LinearTables()
+        {
+            for (int i = 0; i < 256; ++i)
+            {
+                linear[i] = srgb_to_linear(i / 255.0f);
+            }
+
+            for (int i = 0; i <= (1 << LINEAR_BITS); ++i)
+            {
+                srgb[i] = u8(linear_to_srgb(float(i) / (1 << LINEAR_BITS)) * 255.0f + 0.5f);
+            }
+        }
+    };
+
+    const LinearTables& getLinearTables()
+    {
+        static const LinearTables tables;
+        return tables;
+    }
+
+    // conversions between sRGB and linear light; the alpha is linear
+    void linearize(float* data, int width)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            float32x4 v = simd::f32x4_uload(data);
+            float32x4 c = srgb_to_linear(clamp(v, 0.0f, 1.0f));
+            c.w = float(v.w);
+            simd::f32x4_ustore(data, c);
+            data += 4;
+        }
+    }
+
+    void delinearize(float* data, int width)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            float32x4 v = simd::f32x4_uload(data);
+            float32x4 c = linear_to_srgb(clamp(v, 0.0f, 1.0f));
+            c.w = float(v.w);
+            simd::f32x4_ustore(data, c);
+            data += 4;
+        }
+    }
+
+    void blit(const Blitter& blitter, u8* dest, const u8* source, int width)
+    {
+        BlitRect rect;
+
+        rect.src.address = const_cast<u8*>(source);
+        rect.src.stride = 0;
+        rect.dest.address = dest;
+        rect.dest.stride = 0;
+        rect.width = width;
+        rect.height = 1;
+
+        blitter.convert(rect);
+    }
+
+} // namespace
+
+namespace mango {
+namespace detail {
+
+    // ----------------------------------------------------------------------------
+    // formats
+    // ----------------------------------------------------------------------------
+
+    bool isByteFormat(const Format& format)
+    {
+        if (format.bits != 32 || format.type != Format::UNORM)
+            return false;
+
+        for (int i = 0; i < 4; ++i)
+        {
+            if (format.size[i] && (format.size[i] != 8 || format.offset[i] & 7))
+                return false;
+        }
+
+        return true;
+    }
+
+    bool isByteAlphaFormat(const Format& format)
+    {
+        if (!isByteFormat(format))
+            return false;
+
+        for (int i = 0; i < 4; ++i)
+        {
+            if (!format.size[i])
+                return false;
+        }
+
+        return format.offset[3] == 24;
+    }
+
+    // ----------------------------------------------------------------------------
+    // FloatRows
+    // ----------------------------------------------------------------------------
+
+    FloatRows::FloatRows(const Format& format, bool output, bool linear)
+        : m_format(format)
+        , m_linear(linear)
+    {
+        if (format != FORMAT_RGBA32F && format != FORMAT_RGBA16 && !isByteFormat(format))
+        {
+            m_input.reset(new Blitter(FORMAT_RGBA32F, format));
+            if (output)
+            {
+                m_output.reset(new Blitter(format, FORMAT_RGBA32F));
+            }
+        }
+
+        if (linear)
+        {
+            getLinearTables();
+        }
+    }
+
+    float* FloatRows::read(float* temp, const u8* src, int width) const
+    {
+        if (isByteFormat(m_format))
+        {
+            const float* table = m_linear ? getLinearTables().linear : nullptr;
+            float* dest = temp;
+
+            for (int x = 0; x < width; ++x)
+            {
+                for (int i = 0; i < 4; ++i)
+                {
+                    const u8 s = src[m_format.offset[i] >> 3];
+                    dest[i] = !m_format.size[i] ? float(i == 3) : i < 3 && table ? table[s] : s / 255.0f;
+                }
+
+                src += 4;
+                dest += 4;
+            }
+
+            return temp;
+        }
+
+        if (m_format == FORMAT_RGBA16)
+        {
+            const u16* s = reinterpret_cast<const u16*>(src);
+
+            for (int i = 0; i < width * 4; ++i)
+            {
+                temp[i] = s[i] * (1.0f / 65535.0f);
+            }
+        }
+        else if (m_input)
+        {
+            blit(*m_input, reinterpret_cast<u8*>(temp), src, width);
+        }
+        else
+        {
+            std::memcpy(temp, src, width * 16);
+        }
+
+        if (m_linear)
+        {
+            linearize(temp, width);
+        }
+
+        return temp;
+    }
+
+    void FloatRows::write(u8* dest, float* src, int width) const
+    {
+        if (isByteFormat(m_format))
+        {
+            const u8* table = m_linear ? getLinearTables().srgb : nullptr;
+            const float scale = 1 << LINEAR_BITS;
+
+            for (int x = 0; x < width; ++x)
+            {
+                u32 color = 0;
+
+                for (int i = 0; i < 4; ++i)
+                {
+                    const float s = clamp(src[i], 0.0f, 1.0f);
+                    const u32 c = i < 3 && table ? table[int(s * scale + 0.5f)] : u32(s * 255.0f + 0.5f);
+                    color |= m_format.size[i] ? c << m_format.offset[i] : 0;
+                }
+
+                ustore32le(dest, color);
+                src += 4;
+                dest += 4;
+            }
+
+            return;
+        }
+
+        if (m_linear)
+        {
+            delinearize(src, width);
+        }
+
+        if (m_format == FORMAT_RGBA16)
+        {
+            u16* d = reinterpret_cast<u16*>(dest);
+
+            for (int i = 0; i < width * 4; ++i)
+            {
+                d[i] = u16(clamp(src[i], 0.0f, 1.0f) * 65535.0f + 0.5f);
+            }
+        }
+        else if (m_output)
+        {
+            // the blitter clamps the unorm formats
+            blit(*m_output, dest, reinterpret_cast<const u8*>(src), width);
+        }
+        else if (dest != reinterpret_cast<u8*>(src))
+        {
+            std::memcpy(dest, src, width * 16);
+        }
+    }
+
+} // namespace detail
+} // namespace mango
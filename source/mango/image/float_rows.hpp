@@ -0,0 +1,108 @@
+/*
+    MANGO Multimedia Development Platform
+    Copyright (C) 2012-2019 Twilight Finland 3D Oy Ltd. All rights reserved.
+*/
+#pragma once
+
+#include <memory>
+#include <algorithm>
+#include <mango/core/thread.hpp>
+#include <mango/image/image.hpp>
+
+namespace mango {
+namespace detail {
+
+    // ----------------------------------------------------------------------------
+    // formats
+    // ----------------------------------------------------------------------------
+
+    // 32 bit formats with 8 bit components at byte boundaries; the integer kernels
+    // filter the bytes without knowing which components they are.
+    bool isByteFormat(const Format& format);
+
+    // byte formats which have all four components and the alpha in the last byte
+    bool isByteAlphaFormat(const Format& format);
+
+    // ----------------------------------------------------------------------------
+    // premultiplied alpha (composite.cpp)
+    // ----------------------------------------------------------------------------
+
+    // 8 bit kernels process the byte alpha formats; the float kernels RGBA32F
+    void premultiply_u8(u8* dest, const u8* src, int width);
+    void unpremultiply_u8(u8* dest, const u8* src, int width);
+    void premultiply_float(float* data, int width);
+    void unpremultiply_float(float* data, int width);
+
+    // ----------------------------------------------------------------------------
+    // FloatRows
+    // ----------------------------------------------------------------------------
+
+    // Reads rows of a surface into RGBA32F and writes them back. The byte formats,
+    // RGBA16 and RGBA32F are converted directly and the other formats with the
+    // blitter's unorm/float conversions. The linear rows have the colors in linear
+    // light; the alpha is always linear.
+    class FloatRows
+    {
+    protected:
+        Format m_format;
+        bool m_linear;
+        std::unique_ptr<Blitter> m_input;
+        std::unique_ptr<Blitter> m_output;
+
+    public:
+        FloatRows(const Format& format, bool output, bool linear = false);
+
+        // returns temp which holds the converted row
+        float* read(float* temp, const u8* src, int width) const;
+
+        // the row is modified when it is converted from linear light
+        void write(u8* dest, float* src, int width) const;
+    };
+
+    // ----------------------------------------------------------------------------
+    // bands
+    // ----------------------------------------------------------------------------
+
+    // The rows are processed in bands which run in parallel like the conversions of
+    // Surface::blit; small surfaces are processed on the calling thread. The work is
+    // the number of pixels the rows process when it is more than the surface has,
+    // like a resize which reads a larger source; the bands are then made shorter.
+    template <typename Func>
+    void processBands(const char* name, int width, int height, Func func, u64 work = 0)
+    {
+        const int threads = ThreadPool::getInstanceSize();
+        const u64 pixels = u64(width) * height;
+
+        work = std::max(work, pixels);
+
+        // at least 16 rows worth of work for each band
+        const int rows = int(std::max(u64(1), 16 * pixels / work));
+
+        const int N = work < 16384 ? 1 : std::max(1, std::min(threads * 2, height / rows));
+        const int section = height / N;
+
+        ConcurrentQueue queue(name, Priority::HIGH);
+
+        for (int i = 0; i < N; ++i)
+        {
+            const int y0 = i * section;
+            const int y1 = i == N - 1 ? height : y0 + section;
+
+            if (N == 1)
+            {
+                func(y0, y1);
+            }
+            else
+            {
+                queue.enqueue([&func, y0, y1]
+                {
+                    func(y0, y1);
+                });
+            }
+        }
+
+        queue.wait();
+    }
+
+} // namespace detail
+} // namespace mango
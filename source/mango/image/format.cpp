@@ -110,11 +110,11 @@ namespace mango
 
     bool Format::luminance() const
     {
-        // check if red, green and blue channels are identical
-        u32 red   = mask(RED);
-        u32 green = mask(GREEN);
-        u32 blue  = mask(BLUE);
-        return (red != 0) && (red == green) && (red == blue);
+        // check if red, green and blue channels are identical; the sizes and offsets
+        // are compared instead of the masks so that the 32 bit float channels work
+        const bool green = size[GREEN] == size[RED] && offset[GREEN] == offset[RED];
+        const bool blue = size[BLUE] == size[RED] && offset[BLUE] == offset[RED];
+        return (size[RED] != 0) && green && blue;
     }
 
     u32 Format::mask(int component) const
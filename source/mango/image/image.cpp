@@ -5,6 +5,7 @@
 #include <map>
 #include <mango/core/string.hpp>
 #include <mango/core/timer.hpp>
+#include <mango/core/thread.hpp>
 #include <mango/image/image.hpp>
 
 namespace mango
@@ -52,11 +53,11 @@ namespace mango
     // unsupportedImageEncoder
     // ----------------------------------------------------------------------------
 
-    void unsupportedImageEncoder(Stream& output, const Surface& source, float quality)
+    void unsupportedImageEncoder(Stream& output, const Surface& source, const ImageEncodeOptions& options)
     {
         MANGO_UNREFERENCED_PARAMETER(output);
         MANGO_UNREFERENCED_PARAMETER(source);
-        MANGO_UNREFERENCED_PARAMETER(quality);
+        MANGO_UNREFERENCED_PARAMETER(options);
         printf("[WARNING] ImageEncoder::encode() is not supported for this extension.");
     }
 
@@ -88,6 +89,7 @@ namespace mango
     protected:
         std::map<std::string, ImageDecoder::CreateFunc> m_decoders;
         std::map<std::string, ImageEncoder::CreateFunc> m_encoders;
+        std::map<std::string, ImageDecoder::ProbeFunc> m_probes;
 
     public:
         ImageServer()
@@ -133,6 +135,11 @@ namespace mango
             m_encoders[toLower(extension)] = func;
         }
 
+        void registerImageProbe(ImageDecoder::ProbeFunc func, const std::string& extension)
+        {
+            m_probes[toLower(extension)] = func;
+        }
+
         ImageDecoder::CreateFunc getImageDecoder(const std::string& extension) const
         {
             auto i = m_decoders.find(getLowerCaseExtension(extension));
@@ -154,6 +161,17 @@ namespace mango
 
             return unsupportedImageEncoder;
         }
+
+        ImageDecoder::ProbeFunc getImageProbe(const std::string& extension) const
+        {
+            auto i = m_probes.find(getLowerCaseExtension(extension));
+            if (i != m_probes.end())
+            {
+                return i->second;
+            }
+
+            return nullptr;
+        }
     } g_imageServer;
 
     void registerImageDecoder(ImageDecoder::CreateFunc func, const std::string& extension)
@@ -166,6 +184,11 @@ namespace mango
         g_imageServer.registerImageEncoder(func, extension);
     }
 
+    void registerImageProbe(ImageDecoder::ProbeFunc func, const std::string& extension)
+    {
+        g_imageServer.registerImageProbe(func, extension);
+    }
+
     bool isImageDecoder(const std::string& extension)
     {
         auto func = g_imageServer.getImageDecoder(extension);
@@ -195,6 +218,12 @@ namespace mango
         return Memory();
     }
 
+    bool ImageDecoderInterface::decodeYUV(const YUVPlanes& planes)
+    {
+        MANGO_UNREFERENCED_PARAMETER(planes);
+        return false;
+    }
+
     // ----------------------------------------------------------------------------
     // ImageDecoder
     // ----------------------------------------------------------------------------
@@ -236,6 +265,100 @@ namespace mango
         m_interface->decode(dest, palette, level, depth, face);
     }
 
+    bool ImageDecoder::decodeYUV(const YUVPlanes& planes)
+    {
+        return m_interface->decodeYUV(planes);
+    }
+
+    // ----------------------------------------------------------------------------
+    // probeImage()
+    // ----------------------------------------------------------------------------
+
+    static ImageProbe probeMemory(ImageDecoder::ProbeFunc func, Memory memory, const std::string& extension)
+    {
+        ImageProbe probe;
+
+        if (func)
+        {
+            probe.success = func(probe, memory);
+            if (!probe.success)
+            {
+                probe.header = ImageHeader();
+            }
+        }
+        else
+        {
+            // the decoders report errors with exceptions
+            try
+            {
+                ImageDecoder decoder(memory, extension);
+                if (decoder.isDecoder())
+                {
+                    probe.header = decoder.header();
+                    probe.success = probe.header.width > 0 && probe.header.height > 0;
+                }
+            }
+            catch (...)
+            {
+                probe.header = ImageHeader();
+            }
+        }
+
+        return probe;
+    }
+
+    // The extension of image i is extensions[i * step]; a zero step shares one extension.
+    static std::vector<ImageProbe> probeBatch(const std::vector<Memory>& memory, const std::string* extensions, size_t step)
+    {
+        std::vector<ImageProbe> probes(memory.size());
+
+        ImageDecoder::ProbeFunc shared = step ? nullptr : g_imageServer.getImageProbe(extensions[0]);
+
+        // the probes are cheap; amortize the task overhead over a number of images
+        const size_t batch = 64;
+
+        ConcurrentQueue queue("image.probe", Priority::HIGH);
+
+        for (size_t first = 0; first < memory.size(); first += batch)
+        {
+            const size_t last = std::min(first + batch, memory.size());
+
+            queue.enqueue([&, first, last]
+            {
+                for (size_t i = first; i < last; ++i)
+                {
+                    const std::string& extension = extensions[i * step];
+                    ImageDecoder::ProbeFunc func = step ? g_imageServer.getImageProbe(extension) : shared;
+                    probes[i] = probeMemory(func, memory[i], extension);
+                }
+            });
+        }
+
+        queue.wait();
+
+        return probes;
+    }
+
+    ImageProbe probeImage(Memory memory, const std::string& extension)
+    {
+        return probeMemory(g_imageServer.getImageProbe(extension), memory, extension);
+    }
+
+    std::vector<ImageProbe> probeImages(const std::vector<Memory>& memory, const std::string& extension)
+    {
+        return probeBatch(memory, &extension, 0);
+    }
+
+    std::vector<ImageProbe> probeImages(const std::vector<Memory>& memory, const std::vector<std::string>& extensions)
+    {
+        if (extensions.size() != memory.size())
+        {
+            MANGO_EXCEPTION("[probeImages] The number of extensions does not match the number of images.");
+        }
+
+        return probeBatch(memory, extensions.data(), 1);
+    }
+
     // ----------------------------------------------------------------------------
     // ImageEncoder
     // ----------------------------------------------------------------------------
@@ -256,7 +379,14 @@ namespace mango
 
     void ImageEncoder::encode(Stream& output, const Surface& source, float quality)
     {
-        m_encode(output, source,quality);
+        ImageEncodeOptions options;
+        options.quality = quality;
+        m_encode(output, source, options);
+    }
+
+    void ImageEncoder::encode(Stream& output, const Surface& source, const ImageEncodeOptions& options)
+    {
+        m_encode(output, source, options);
     }
 
 } // namespace mango
@@ -1010,13 +1010,81 @@ namespace
         return x;
     }
 
+    bool probeHeader(ImageProbe& probe, Memory memory)
+    {
+        if (memory.size < 18)
+            return false;
+
+        switch (uload16le(memory.address))
+        {
+            case 0x4d42: // BM - Windows Bitmap
+            case 0x4142: // BA - OS/2 Bitmap
+            case 0x4943: // CI - OS/2 Color Icon
+            case 0x5043: // CP - OS/2 Color Pointer
+            case 0x4349: // IC - OS/2 Icon
+            case 0x5450: // PT - OS/2 Pointer
+                break;
+
+            // embedded formats
+            case 0x5089:
+                probe = probeImage(memory, ".png");
+                return probe.success;
+
+            case 0xd8ff:
+                probe = probeImage(memory, ".jpg");
+                return probe.success;
+
+            case 0x4947:
+                probe = probeImage(memory, ".gif");
+                return probe.success;
+
+            default:
+                return false;
+        }
+
+        Memory bitmapMemory = memory.slice(14);
+
+        // the header is validated when it is parsed
+        if (bitmapMemory.size < uload32le(bitmapMemory.address))
+            return false;
+
+        try
+        {
+            BitmapHeader header(bitmapMemory, false);
+
+            probe.header.width   = header.width;
+            probe.header.height  = header.height;
+            probe.header.depth   = 0;
+            probe.header.levels  = 0;
+            probe.header.faces   = 0;
+            probe.header.palette = header.isPalette();
+            probe.header.format  = header.format;
+            probe.header.compression = TextureCompression::NONE;
+
+            // embedded ICC profile; the offset is from the beginning of the header
+            const u32 PROFILE_EMBEDDED = 0x4d424544; // 'MBED'
+            if (header.csType == PROFILE_EMBEDDED && header.profileSize &&
+                header.profileData <= bitmapMemory.size &&
+                header.profileSize <= bitmapMemory.size - header.profileData)
+            {
+                probe.icc = Memory(bitmapMemory.address + header.profileData, header.profileSize);
+            }
+        }
+        catch (Exception&)
+        {
+            return false;
+        }
+
+        return true;
+    }
+
     // ------------------------------------------------------------
     // ImageEncoder
     // ------------------------------------------------------------
 
-    void imageEncode(Stream& stream, const Surface& surface, float quality)
+    void imageEncode(Stream& stream, const Surface& surface, const ImageEncodeOptions& options)
     {
-        MANGO_UNREFERENCED_PARAMETER(quality);
+        MANGO_UNREFERENCED_PARAMETER(options);
 
         int width = surface.width;
         int height = surface.height;
@@ -1070,6 +1138,7 @@ namespace mango
     void registerImageDecoderBMP()
     {
         registerImageDecoder(createInterface, ".bmp");
+        registerImageProbe(probeHeader, ".bmp");
         registerImageDecoder(createInterface, ".ico");
         registerImageDecoder(createInterface, ".cur");
         registerImageEncoder(imageEncode, ".bmp");
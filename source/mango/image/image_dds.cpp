@@ -2,17 +2,28 @@
     MANGO Multimedia Development Platform
     Copyright (C) 2012-2018 Twilight Finland 3D Oy Ltd. All rights reserved.
 */
+#include <vector>
 #include <mango/core/pointer.hpp>
 #include <mango/core/exception.hpp>
 #include <mango/image/image.hpp>
 
 #define ID "[ImageDecoder.DDS] "
+#define ID_ENCODER "[ImageEncoder.DDS] "
 
 //#define DEBUG_DDS
 
 #define MAKE_FORMAT(bits, type, order, s0, s1, s2, s3) \
     Format(bits, Format::type, Format::order, s0, s1, s2, s3)
 
+namespace mango
+{
+
+    void encodeTexture(Stream& output, const Surface& surface, const ImageEncodeOptions& options,
+                       void (*write)(Stream& output, const Texture& texture, const ImageEncodeOptions& options));
+    void writeTextureDDS(Stream& output, const Texture& texture, const ImageEncodeOptions& options);
+
+} // namespace mango
+
 namespace
 {
     using namespace mango;
@@ -940,14 +951,289 @@ namespace
         return x;
     }
 
+    bool probeHeader(ImageProbe& probe, Memory memory)
+    {
+        // magic, header and the optional DX10 header
+        if (memory.size < 128 || uload32le(memory.address) != FOURCC_DDS)
+            return false;
+
+        if (uload32le(memory.address + 84) == FOURCC_DX10 && memory.size < 148)
+            return false;
+
+        HeaderDDS header;
+
+        try
+        {
+            header.read(memory.address);
+        }
+        catch (Exception&)
+        {
+            return false;
+        }
+
+        probe.header.width   = header.getWidth();
+        probe.header.height  = header.getHeight();
+        probe.header.depth   = 0;
+        probe.header.levels  = header.getMipmapCount();
+        probe.header.faces   = header.getFaceCount();
+        probe.header.palette = false;
+        probe.header.format  = header.getFormat();
+        probe.header.compression = header.getCompression();
+
+        return true;
+    }
+
+    // ------------------------------------------------------------
+    // writer
+    // ------------------------------------------------------------
+
+    u32 compression_to_fourcc(TextureCompression compression)
+    {
+        u32 fourcc = 0;
+
+        switch (compression)
+        {
+            case TextureCompression::DXT1:
+            case TextureCompression::DXT1_ALPHA1:
+                fourcc = FOURCC_DXT1;
+                break;
+            case TextureCompression::DXT3:
+                fourcc = FOURCC_DXT3;
+                break;
+            case TextureCompression::DXT5:
+                fourcc = FOURCC_DXT5;
+                break;
+            case TextureCompression::RGTC1_RED:
+                fourcc = FOURCC_BC4U;
+                break;
+            case TextureCompression::RGTC1_SIGNED_RED:
+                fourcc = FOURCC_BC4S;
+                break;
+            case TextureCompression::RGTC2_RG:
+                fourcc = FOURCC_BC5U;
+                break;
+            case TextureCompression::RGTC2_SIGNED_RG:
+                fourcc = FOURCC_BC5S;
+                break;
+            case TextureCompression::UYVY:
+                fourcc = FOURCC_UYVY;
+                break;
+            case TextureCompression::YUY2:
+                fourcc = FOURCC_YUY2;
+                break;
+            case TextureCompression::G8R8G8B8:
+                fourcc = FOURCC_G8R8G8B8;
+                break;
+            case TextureCompression::R8G8B8G8:
+                fourcc = FOURCC_R8G8B8G8;
+                break;
+            default:
+                break;
+        }
+
+        return fourcc;
+    }
+
+    struct WriterDDS
+    {
+        u32 flags = 0;
+        u32 fourCC = 0;
+        u32 rgbBitCount = 0;
+        u32 mask[4] = { 0, 0, 0, 0 };
+        u32 dxgiFormat = 0;
+
+        WriterDDS(const Texture& texture)
+        {
+            if (texture.compression != TextureCompression::NONE)
+            {
+                // sRGB and the block formats without a fourcc need the DX10 header
+                const u32 srgb = u32(texture.compression) & TextureCompressionInfo::SRGB;
+                fourCC = srgb ? 0 : compression_to_fourcc(texture.compression);
+
+                if (!fourCC)
+                {
+                    dxgiFormat = directx::getTextureFormat(texture.compression);
+                    fourCC = dxgiFormat ? u32(FOURCC_DX10) : compression_to_fourcc(texture.compression);
+                }
+
+                if (!fourCC)
+                {
+                    MANGO_EXCEPTION(ID_ENCODER"Unsupported compression.");
+                }
+
+                flags = DDPF_FOURCC;
+                if (texture.compression == TextureCompression::DXT1_ALPHA1)
+                {
+                    flags |= DDPF_ALPHAPIXELS;
+                }
+
+                return;
+            }
+
+            const Format& format = texture.format;
+
+            switch (format.type)
+            {
+                case Format::UNORM:
+                    if (format.bits > 32)
+                    {
+                        MANGO_EXCEPTION(ID_ENCODER"Unsupported format.");
+                    }
+
+                    rgbBitCount = format.bits;
+
+                    for (int i = 0; i < 4; ++i)
+                    {
+                        mask[i] = format.size[i] ? format.mask(i) : 0;
+                    }
+
+                    if (format.size[1] || format.size[2])
+                        flags = DDPF_RGB;
+                    else if (format.size[0])
+                        flags = DDPF_LUMINANCE;
+                    else
+                        flags = DDPF_ALPHA;
+
+                    if (mask[3] && flags != DDPF_ALPHA)
+                    {
+                        flags |= DDPF_ALPHAPIXELS;
+                    }
+                    break;
+
+                case Format::FP16:
+                case Format::FP32:
+                    if (format == FORMAT_RGBA16F)
+                        fourCC = FOURCC_ABGR16F;
+                    else if (format == FORMAT_RGBA32F)
+                        fourCC = FOURCC_ABGR32F;
+                    else
+                        MANGO_EXCEPTION(ID_ENCODER"Unsupported format.");
+                    flags = DDPF_FOURCC;
+                    break;
+
+                default:
+                    MANGO_EXCEPTION(ID_ENCODER"Unsupported format.");
+                    break;
+            }
+        }
+
+        void write(Stream& stream, const Texture& texture) const
+        {
+            LittleEndianStream s(stream);
+
+            const bool compressed = texture.compression != TextureCompression::NONE;
+            const bool cubemap = texture.faces == 6;
+
+            if (texture.faces != 1 && !cubemap)
+            {
+                MANGO_EXCEPTION(ID_ENCODER"Incorrect number of faces.");
+            }
+
+            u32 headerFlags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT;
+            headerFlags |= compressed ? DDSD_LINEARSIZE : DDSD_PITCH;
+            if (texture.levels > 1)
+            {
+                headerFlags |= DDSD_MIPMAPCOUNT;
+            }
+
+            const u32 pitch = compressed ? u32(texture.getLevelSize(0)) :
+                                           u32(texture.width * texture.format.bytes());
+
+            u32 caps = DDSCAPS_TEXTURE;
+            if (texture.levels > 1)
+            {
+                caps |= DDSCAPS_COMPLEX | DDSCAPS_MIPMAP;
+            }
+
+            u32 caps2 = 0;
+            if (cubemap)
+            {
+                caps |= DDSCAPS_COMPLEX;
+                caps2 = DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_ALLFACES;
+            }
+
+            s.write32(FOURCC_DDS);
+            s.write32(124);
+            s.write32(headerFlags);
+            s.write32(texture.height);
+            s.write32(texture.width);
+            s.write32(pitch);
+            s.write32(0); // depth
+            s.write32(texture.levels);
+
+            for (int i = 0; i < 11; ++i)
+            {
+                s.write32(0); // reserved
+            }
+
+            s.write32(32);
+            s.write32(flags);
+            s.write32(fourCC);
+            s.write32(rgbBitCount);
+            s.write32(mask[0]);
+            s.write32(mask[1]);
+            s.write32(mask[2]);
+            s.write32(mask[3]);
+
+            s.write32(caps);
+            s.write32(caps2);
+            s.write32(0); // caps3
+            s.write32(0); // caps4
+            s.write32(0); // reserved
+
+            if (fourCC == FOURCC_DX10)
+            {
+                s.write32(dxgiFormat);
+                s.write32(3); // D3D10_RESOURCE_DIMENSION_TEXTURE2D
+                s.write32(cubemap ? 4 : 0); // D3D10_RESOURCE_MISC_TEXTURECUBE
+                s.write32(1); // arraySize
+                s.write32(0); // reserved
+            }
+
+            // the images are written from where they are stored: faces outer, levels inner
+            std::vector<Memory> segments;
+
+            for (int face = 0; face < texture.faces; ++face)
+            {
+                for (int level = 0; level < texture.levels; ++level)
+                {
+                    Memory image = texture.getMemory(level, face);
+                    if (image.size < texture.getLevelSize(level))
+                    {
+                        MANGO_EXCEPTION(ID_ENCODER"Incorrect image size.");
+                    }
+
+                    segments.emplace_back(image.address, texture.getLevelSize(level));
+                }
+            }
+
+            stream.writev(segments.data(), segments.size());
+        }
+    };
+
+    void imageEncode(Stream& output, const Surface& surface, const ImageEncodeOptions& options)
+    {
+        encodeTexture(output, surface, options, writeTextureDDS);
+    }
+
 } // namespace
 
 namespace mango
 {
 
+    void writeTextureDDS(Stream& output, const Texture& texture, const ImageEncodeOptions& options)
+    {
+        MANGO_UNREFERENCED_PARAMETER(options);
+
+        WriterDDS writer(texture);
+        writer.write(output, texture);
+    }
+
     void registerImageDecoderDDS()
     {
         registerImageDecoder(createInterface, ".dds");
+        registerImageProbe(probeHeader, ".dds");
+        registerImageEncoder(imageEncode, ".dds");
     }
 
 } // namespace mango
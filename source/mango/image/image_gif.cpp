@@ -502,6 +502,30 @@ namespace
         return x;
     }
 
+    bool probeHeader(ImageProbe& probe, Memory memory)
+    {
+        // magic and the logical screen descriptor
+        if (memory.size < 13)
+            return false;
+
+        const char* magic = reinterpret_cast<const char*>(memory.address);
+        if (std::strncmp(magic, "GIF87a", 6) && std::strncmp(magic, "GIF89a", 6))
+            return false;
+
+        LittleEndianPointer p = memory.address + 6;
+
+        probe.header.width   = p.read16();
+        probe.header.height  = p.read16();
+        probe.header.depth   = 0;
+        probe.header.levels  = 0;
+        probe.header.faces   = 0;
+        probe.header.palette = true;
+        probe.header.format  = FORMAT_B8G8R8A8;
+        probe.header.compression = TextureCompression::NONE;
+
+        return true;
+    }
+
 } // namespace
 
 namespace mango
@@ -510,6 +534,7 @@ namespace mango
     void registerImageDecoderGIF()
     {
         registerImageDecoder(createInterface, ".gif");
+        registerImageProbe(probeHeader, ".gif");
     }
 
 } // namespace mango
@@ -66,6 +66,12 @@ namespace
             jpeg::Status s = m_parser.decode(dest);
             MANGO_UNREFERENCED_PARAMETER(s);
         }
+
+        bool decodeYUV(const YUVPlanes& planes) override
+        {
+            jpeg::Status s = m_parser.decodeYUV(planes);
+            return s.success;
+        }
     };
 
     ImageDecoderInterface* createInterface(Memory memory)
@@ -78,9 +84,9 @@ namespace
     // ImageEncoder
     // ------------------------------------------------------------
 
-    void imageEncode(Stream& stream, const Surface& surface, float quality)
+    void imageEncode(Stream& stream, const Surface& surface, const ImageEncodeOptions& options)
     {
-        jpeg::EncodeImage(stream, surface, quality);
+        jpeg::EncodeImage(stream, surface, options);
     }
 
 } // namespace
@@ -88,12 +94,30 @@ namespace
 namespace mango
 {
 
+    bool transformJPEG(Stream& output, Memory input, const JPEGTransform& transform)
+    {
+        jpeg::Parser parser(input);
+        jpeg::Status s = parser.transform(output, transform);
+        return s.success;
+    }
+
+    bool transcodeJPEG(Memory input, const std::vector<JPEGTranscode>& outputs)
+    {
+        jpeg::Parser parser(input);
+        jpeg::Status s = parser.transcode(outputs);
+        return s.success;
+    }
+
     void registerImageDecoderJPG()
     {
         registerImageDecoder(createInterface, ".jpg");
         registerImageDecoder(createInterface, ".jpeg");
         registerImageDecoder(createInterface, ".jfif");
         registerImageDecoder(createInterface, ".mpo");
+        registerImageProbe(jpeg::Probe, ".jpg");
+        registerImageProbe(jpeg::Probe, ".jpeg");
+        registerImageProbe(jpeg::Probe, ".jfif");
+        registerImageProbe(jpeg::Probe, ".mpo");
         registerImageEncoder(imageEncode, ".jpg");
         registerImageEncoder(imageEncode, ".jpeg");
     }
@@ -3,12 +3,26 @@
     Copyright (C) 2012-2018 Twilight Finland 3D Oy Ltd. All rights reserved.
 */
 #include <cstring>
+#include <vector>
 #include <mango/core/pointer.hpp>
+#include <mango/core/compress.hpp>
+#include <mango/core/thread.hpp>
 #include <mango/core/exception.hpp>
 #include <mango/image/image.hpp>
 //#include <mango/opengl/opengl.hpp>
 
 #define ID "[ImageDecoder.KTX] "
+#define ID_ENCODER "[ImageEncoder.KTX] "
+
+namespace mango
+{
+
+    void encodeTexture(Stream& output, const Surface& surface, const ImageEncodeOptions& options,
+                       void (*write)(Stream& output, const Texture& texture, const ImageEncodeOptions& options));
+    void writeTextureKTX(Stream& output, const Texture& texture, const ImageEncodeOptions& options);
+    void writeTextureKTX2(Stream& output, const Texture& texture, const ImageEncodeOptions& options);
+
+} // namespace mango
 
 namespace
 {
@@ -625,14 +639,1054 @@ glBaseInternalFormat:
         return x;
     }
 
+    // ------------------------------------------------------------
+    // writer
+    // ------------------------------------------------------------
+
+    const u8 g_zeros[16] = { 0 };
+
+    void getImages(std::vector<Memory>& segments, const Texture& texture, int level)
+    {
+        const size_t size = texture.getLevelSize(level);
+
+        for (int face = 0; face < texture.faces; ++face)
+        {
+            Memory image = texture.getMemory(level, face);
+            if (image.size < size)
+            {
+                MANGO_EXCEPTION(ID_ENCODER"Incorrect image size.");
+            }
+
+            segments.emplace_back(image.address, size);
+        }
+    }
+
+    struct WriterKTX
+    {
+        u32 glType = 0;
+        u32 glTypeSize = 1;
+        u32 glFormat = 0;
+        u32 glInternalFormat = 0;
+        u32 glBaseInternalFormat = 0;
+
+        WriterKTX(const Texture& texture)
+        {
+            if (texture.compression != TextureCompression::NONE)
+            {
+                glInternalFormat = opengl::getTextureFormat(texture.compression);
+                if (!glInternalFormat)
+                {
+                    MANGO_EXCEPTION(ID_ENCODER"Unsupported compression.");
+                }
+
+                switch (texture.compression)
+                {
+                    case TextureCompression::RGTC1_RED:
+                    case TextureCompression::RGTC1_SIGNED_RED:
+                    case TextureCompression::EAC_R11:
+                    case TextureCompression::EAC_SIGNED_R11:
+                        glBaseInternalFormat = KTX_RED;
+                        break;
+                    case TextureCompression::RGTC2_RG:
+                    case TextureCompression::RGTC2_SIGNED_RG:
+                    case TextureCompression::EAC_RG11:
+                    case TextureCompression::EAC_SIGNED_RG11:
+                        glBaseInternalFormat = KTX_RG;
+                        break;
+                    default:
+                        glBaseInternalFormat = u32(texture.compression) & TextureCompressionInfo::ALPHA ?
+                            KTX_RGBA : KTX_RGB;
+                        break;
+                }
+            }
+            else if (texture.format == FORMAT_R8G8B8A8)
+            {
+                glType = KTX_UNSIGNED_BYTE;
+                glFormat = KTX_RGBA;
+                glInternalFormat = KTX_RGBA8;
+                glBaseInternalFormat = KTX_RGBA;
+            }
+            else if (texture.format == FORMAT_RGBA16F)
+            {
+                glType = KTX_HALF_FLOAT;
+                glTypeSize = 2;
+                glFormat = KTX_RGBA;
+                glInternalFormat = KTX_RGBA16F;
+                glBaseInternalFormat = KTX_RGBA;
+            }
+            else if (texture.format == FORMAT_RGBA32F)
+            {
+                glType = KTX_FLOAT;
+                glTypeSize = 4;
+                glFormat = KTX_RGBA;
+                glInternalFormat = KTX_RGBA32F;
+                glBaseInternalFormat = KTX_RGBA;
+            }
+            else
+            {
+                MANGO_EXCEPTION(ID_ENCODER"Unsupported format.");
+            }
+        }
+
+        void write(Stream& stream, const Texture& texture) const
+        {
+            const u8 ktxIdentifier[] =
+            {
+                0xab, 0x4b, 0x54, 0x58, 0x20, 0x31,
+                0x31, 0xbb, 0x0d, 0x0a, 0x1a, 0x0a
+            };
+
+            if (texture.faces != 1 && texture.faces != 6)
+            {
+                MANGO_EXCEPTION(ID_ENCODER"Incorrect number of faces.");
+            }
+
+            LittleEndianStream s(stream);
+
+            s.write(ktxIdentifier, 12);
+            s.write32(0x04030201);
+            s.write32(glType);
+            s.write32(glTypeSize);
+            s.write32(glFormat);
+            s.write32(glInternalFormat);
+            s.write32(glBaseInternalFormat);
+            s.write32(texture.width);
+            s.write32(texture.height);
+            s.write32(0); // pixelDepth
+            s.write32(0); // numberOfArrayElements
+            s.write32(texture.faces);
+            s.write32(texture.levels);
+            s.write32(0); // bytesOfKeyValueData
+
+            // the file stores the faces of each level together; the images are gathered
+            // between the image sizes and the padding
+            std::vector<u8> imageSizes(texture.levels * 4);
+            std::vector<Memory> segments;
+
+            for (int level = 0; level < texture.levels; ++level)
+            {
+                const u32 imageSize = u32(texture.getLevelSize(level));
+                const u32 padding = ((imageSize + 3) & ~3) - imageSize;
+
+                u8* size = imageSizes.data() + level * 4;
+                ustore32le(size, imageSize);
+                segments.emplace_back(size, 4);
+
+                std::vector<Memory> images;
+                getImages(images, texture, level);
+
+                for (const Memory& image : images)
+                {
+                    segments.push_back(image);
+                    if (padding)
+                    {
+                        segments.emplace_back(const_cast<u8*>(g_zeros), padding);
+                    }
+                }
+            }
+
+            stream.writev(segments.data(), segments.size());
+        }
+    };
+
+    // ------------------------------------------------------------
+    // KTX2 writer
+    // ------------------------------------------------------------
+
+    // KTX 2.0 Specification:
+    // https://github.khronos.org/KTX-Specification/
+
+    // Khronos Data Format Specification (basic descriptor block):
+    // https://www.khronos.org/registry/DataFormat/specs/1.3/dataformat.1.3.html
+
+    enum
+    {
+        KHR_DF_MODEL_RGBSDA = 1,
+        KHR_DF_MODEL_BC1A   = 128,
+        KHR_DF_MODEL_BC2    = 129,
+        KHR_DF_MODEL_BC3    = 130,
+        KHR_DF_MODEL_BC4    = 131,
+        KHR_DF_MODEL_BC5    = 132,
+        KHR_DF_MODEL_BC6H   = 133,
+        KHR_DF_MODEL_BC7    = 134,
+        KHR_DF_MODEL_ETC1   = 160,
+        KHR_DF_MODEL_ETC2   = 161,
+        KHR_DF_MODEL_ASTC   = 162,
+    };
+
+    enum
+    {
+        KHR_DF_CHANNEL_RED          = 0,
+        KHR_DF_CHANNEL_GREEN        = 1,
+        KHR_DF_CHANNEL_BLUE         = 2,
+        KHR_DF_CHANNEL_ALPHA        = 15,
+        KHR_DF_CHANNEL_ALPHAPRESENT = 1,  // BC1A
+        KHR_DF_CHANNEL_COLOR        = 0,  // BC, ETC1
+        KHR_DF_CHANNEL_ETC2_COLOR   = 2,
+    };
+
+    enum
+    {
+        KHR_DF_SAMPLE_DATATYPE_LINEAR   = 0x10,
+        KHR_DF_SAMPLE_DATATYPE_SIGNED   = 0x40,
+        KHR_DF_SAMPLE_DATATYPE_FLOAT    = 0x80,
+    };
+
+    enum
+    {
+        KHR_DF_TRANSFER_LINEAR  = 1,
+        KHR_DF_TRANSFER_SRGB    = 2,
+        KHR_DF_PRIMARIES_BT709  = 1,
+    };
+
+    enum
+    {
+        KTX2_SUPERCOMPRESSION_NONE  = 0,
+        KTX2_SUPERCOMPRESSION_ZSTD  = 2,
+    };
+
+    enum
+    {
+        VK_FORMAT_UNDEFINED             = 0,
+        VK_FORMAT_R8G8B8A8_UNORM        = 37,
+        VK_FORMAT_R8G8B8A8_SRGB         = 43,
+        VK_FORMAT_R16G16B16A16_SFLOAT   = 97,
+        VK_FORMAT_R32G32B32A32_SFLOAT   = 109,
+    };
+
+    struct DescriptorKTX2
+    {
+        struct Sample
+        {
+            u32 offset;
+            u32 bits;
+            u32 channel;
+        };
+
+        u32 vkFormat = 0;
+        u32 typeSize = 1;
+        u32 model = 0;
+        u32 transfer = KHR_DF_TRANSFER_LINEAR;
+        u32 blockWidth = 1;
+        u32 blockHeight = 1;
+        u32 blockBytes = 0;
+        u32 qualifiers = 0;
+        std::vector<Sample> samples;
+
+        DescriptorKTX2(const Texture& texture)
+        {
+            if (texture.compression == TextureCompression::NONE)
+            {
+                const int bits = texture.format.size[0];
+
+                if (texture.format == FORMAT_R8G8B8A8)
+                {
+                    vkFormat = VK_FORMAT_R8G8B8A8_UNORM;
+                }
+                else if (texture.format == FORMAT_RGBA16F)
+                {
+                    vkFormat = VK_FORMAT_R16G16B16A16_SFLOAT;
+                    typeSize = 2;
+                    qualifiers = KHR_DF_SAMPLE_DATATYPE_FLOAT | KHR_DF_SAMPLE_DATATYPE_SIGNED;
+                }
+                else if (texture.format == FORMAT_RGBA32F)
+                {
+                    vkFormat = VK_FORMAT_R32G32B32A32_SFLOAT;
+                    typeSize = 4;
+                    qualifiers = KHR_DF_SAMPLE_DATATYPE_FLOAT | KHR_DF_SAMPLE_DATATYPE_SIGNED;
+                }
+                else
+                {
+                    MANGO_EXCEPTION(ID_ENCODER"Unsupported format.");
+                }
+
+                model = KHR_DF_MODEL_RGBSDA;
+                blockBytes = texture.format.bytes();
+                samples = {
+                    { 0, u32(bits), KHR_DF_CHANNEL_RED },
+                    { u32(bits), u32(bits), KHR_DF_CHANNEL_GREEN },
+                    { u32(bits * 2), u32(bits), KHR_DF_CHANNEL_BLUE },
+                    { u32(bits * 3), u32(bits), KHR_DF_CHANNEL_ALPHA },
+                };
+                return;
+            }
+
+            TextureCompressionInfo info(texture.compression);
+            const u32 flags = info.getCompressionFlags();
+
+            vkFormat = vulkan::getTextureFormat(texture.compression);
+            if (!vkFormat || info.getCompressionFormat() == TextureCompressionInfo::ASTC_HDR)
+            {
+                MANGO_EXCEPTION(ID_ENCODER"Unsupported compression.");
+            }
+
+            transfer = flags & TextureCompressionInfo::SRGB ? KHR_DF_TRANSFER_SRGB : KHR_DF_TRANSFER_LINEAR;
+            blockWidth = info.width;
+            blockHeight = info.height;
+            blockBytes = info.bytes;
+
+            if (flags & TextureCompressionInfo::SIGNED)
+            {
+                qualifiers |= KHR_DF_SAMPLE_DATATYPE_SIGNED;
+            }
+
+            switch (texture.compression)
+            {
+                case TextureCompression::DXT1:
+                case TextureCompression::DXT1_SRGB:
+                    model = KHR_DF_MODEL_BC1A;
+                    samples = { { 0, 64, KHR_DF_CHANNEL_COLOR } };
+                    break;
+
+                case TextureCompression::DXT1_ALPHA1:
+                case TextureCompression::DXT1_ALPHA1_SRGB:
+                    model = KHR_DF_MODEL_BC1A;
+                    samples = { { 0, 64, KHR_DF_CHANNEL_ALPHAPRESENT } };
+                    break;
+
+                case TextureCompression::DXT3:
+                case TextureCompression::DXT3_SRGB:
+                    model = KHR_DF_MODEL_BC2;
+                    samples = { { 0, 64, KHR_DF_CHANNEL_ALPHA }, { 64, 64, KHR_DF_CHANNEL_COLOR } };
+                    break;
+
+                case TextureCompression::DXT5:
+                case TextureCompression::DXT5_SRGB:
+                    model = KHR_DF_MODEL_BC3;
+                    samples = { { 0, 64, KHR_DF_CHANNEL_ALPHA }, { 64, 64, KHR_DF_CHANNEL_COLOR } };
+                    break;
+
+                case TextureCompression::RGTC1_RED:
+                case TextureCompression::RGTC1_SIGNED_RED:
+                    model = KHR_DF_MODEL_BC4;
+                    samples = { { 0, 64, KHR_DF_CHANNEL_RED } };
+                    break;
+
+                case TextureCompression::RGTC2_RG:
+                case TextureCompression::RGTC2_SIGNED_RG:
+                    model = KHR_DF_MODEL_BC5;
+                    samples = { { 0, 64, KHR_DF_CHANNEL_RED }, { 64, 64, KHR_DF_CHANNEL_GREEN } };
+                    break;
+
+                case TextureCompression::BPTC_RGB_UNSIGNED_FLOAT:
+                case TextureCompression::BPTC_RGB_SIGNED_FLOAT:
+                    model = KHR_DF_MODEL_BC6H;
+                    qualifiers |= KHR_DF_SAMPLE_DATATYPE_FLOAT;
+                    samples = { { 0, 128, KHR_DF_CHANNEL_COLOR } };
+                    break;
+
+                case TextureCompression::BPTC_RGBA_UNORM:
+                case TextureCompression::BPTC_SRGB_ALPHA_UNORM:
+                    model = KHR_DF_MODEL_BC7;
+                    samples = { { 0, 128, KHR_DF_CHANNEL_COLOR } };
+                    break;
+
+                case TextureCompression::ETC1_RGB:
+                    model = KHR_DF_MODEL_ETC1;
+                    samples = { { 0, 64, KHR_DF_CHANNEL_COLOR } };
+                    break;
+
+                case TextureCompression::ETC2_RGB:
+                case TextureCompression::ETC2_SRGB:
+                case TextureCompression::ETC2_RGB_ALPHA1:
+                case TextureCompression::ETC2_SRGB_ALPHA1:
+                    model = KHR_DF_MODEL_ETC2;
+                    samples = { { 0, 64, KHR_DF_CHANNEL_ETC2_COLOR } };
+                    break;
+
+                case TextureCompression::ETC2_RGBA:
+                case TextureCompression::ETC2_SRGB_ALPHA8:
+                    model = KHR_DF_MODEL_ETC2;
+                    samples = { { 0, 64, KHR_DF_CHANNEL_ALPHA }, { 64, 64, KHR_DF_CHANNEL_ETC2_COLOR } };
+                    break;
+
+                case TextureCompression::EAC_R11:
+                case TextureCompression::EAC_SIGNED_R11:
+                    model = KHR_DF_MODEL_ETC2;
+                    samples = { { 0, 64, KHR_DF_CHANNEL_RED } };
+                    break;
+
+                case TextureCompression::EAC_RG11:
+                case TextureCompression::EAC_SIGNED_RG11:
+                    model = KHR_DF_MODEL_ETC2;
+                    samples = { { 0, 64, KHR_DF_CHANNEL_RED }, { 64, 64, KHR_DF_CHANNEL_GREEN } };
+                    break;
+
+                default:
+                    if (info.getCompressionFormat() != TextureCompressionInfo::ASTC)
+                    {
+                        MANGO_EXCEPTION(ID_ENCODER"Unsupported compression.");
+                    }
+
+                    model = KHR_DF_MODEL_ASTC;
+                    samples = { { 0, 128, KHR_DF_CHANNEL_COLOR } };
+                    break;
+            }
+        }
+
+        void write(std::vector<u8>& dfd) const
+        {
+            const u32 blockSize = 24 + 16 * u32(samples.size());
+            const u32 totalSize = 4 + blockSize;
+
+            dfd.resize(totalSize);
+            u8* p = dfd.data();
+
+            ustore32le(p + 0, totalSize);
+            ustore32le(p + 4, 0); // vendorId: Khronos, descriptorType: basic
+            ustore32le(p + 8, 2 | (blockSize << 16)); // versionNumber: 1.3
+            p[12] = u8(model);
+            p[13] = u8(KHR_DF_PRIMARIES_BT709);
+            p[14] = u8(transfer);
+            p[15] = 0; // flags: straight alpha
+            p[16] = u8(blockWidth - 1);
+            p[17] = u8(blockHeight - 1);
+            p[18] = 0;
+            p[19] = 0;
+            std::memset(p + 20, 0, 8);
+            p[20] = u8(blockBytes);
+            p += 28;
+
+            const bool fp = (qualifiers & KHR_DF_SAMPLE_DATATYPE_FLOAT) != 0;
+            const bool sign = (qualifiers & KHR_DF_SAMPLE_DATATYPE_SIGNED) != 0;
+
+            for (const Sample& sample : samples)
+            {
+                u32 channel = sample.channel | qualifiers;
+                u32 lower = 0;
+                u32 upper = 0xffffffff;
+
+                if (fp)
+                {
+                    // the values which correspond to 0.0 (or -1.0) and 1.0
+                    lower = sign ? 0xbf800000 : 0;
+                    upper = 0x3f800000;
+                }
+                else if (sign)
+                {
+                    lower = 0x80000000;
+                    upper = 0x7fffffff;
+                }
+                else if (model == KHR_DF_MODEL_RGBSDA)
+                {
+                    upper = (1u << sample.bits) - 1;
+                }
+
+                if (model == KHR_DF_MODEL_RGBSDA && sample.channel == KHR_DF_CHANNEL_ALPHA &&
+                    transfer == KHR_DF_TRANSFER_SRGB)
+                {
+                    channel |= KHR_DF_SAMPLE_DATATYPE_LINEAR;
+                }
+
+                ustore32le(p + 0, sample.offset | ((sample.bits - 1) << 16) | (channel << 24));
+                ustore32le(p + 4, 0); // samplePosition
+                ustore32le(p + 8, lower);
+                ustore32le(p + 12, upper);
+                p += 16;
+            }
+        }
+    };
+
+    struct WriterKTX2
+    {
+        struct Level
+        {
+            std::vector<Memory> segments;
+            std::vector<u8> compressed;
+            u64 offset = 0;
+            u64 size = 0;
+            u64 uncompressedSize = 0;
+        };
+
+        DescriptorKTX2 descriptor;
+        int supercompression;
+
+        // the faces of the texture are the faces of each array layer
+        int layers;
+
+        // key/value pairs sorted by the key
+        std::vector<std::pair<std::string, std::string>> keys;
+
+        WriterKTX2(const Texture& texture, int supercompression, int layers = 1)
+            : descriptor(texture)
+            , supercompression(supercompression)
+            , layers(layers)
+        {
+            const int faces = texture.faces / layers;
+
+            if ((faces != 1 && faces != 6) || faces * layers != texture.faces)
+            {
+                MANGO_EXCEPTION(ID_ENCODER"Incorrect number of faces.");
+            }
+
+            keys.emplace_back("KTXwriter", "mango");
+        }
+
+        void write(Stream& stream, const Texture& texture) const
+        {
+            const u8 ktx2Identifier[] =
+            {
+                0xab, 0x4b, 0x54, 0x58, 0x20, 0x32,
+                0x30, 0xbb, 0x0d, 0x0a, 0x1a, 0x0a
+            };
+
+            std::vector<Level> levels(texture.levels);
+
+            for (int level = 0; level < texture.levels; ++level)
+            {
+                getImages(levels[level].segments, texture, level);
+                levels[level].uncompressedSize = u64(texture.getLevelSize(level)) * texture.faces;
+            }
+
+            if (supercompression > 0)
+            {
+                // the levels are compressed independently of each other in the thread pool
+                ConcurrentQueue queue("ktx2.zstd", Priority::HIGH);
+
+                for (Level& level : levels)
+                {
+                    queue.enqueue([&level, this]
+                    {
+                        std::vector<u8> temp;
+                        Memory source = level.segments[0];
+
+                        if (level.segments.size() > 1)
+                        {
+                            for (const Memory& segment : level.segments)
+                            {
+                                temp.insert(temp.end(), segment.address, segment.address + segment.size);
+                            }
+
+                            source = Memory(temp.data(), temp.size());
+                        }
+
+                        level.compressed.resize(zstd::bound(source.size));
+                        Memory dest(level.compressed.data(), level.compressed.size());
+                        level.compressed.resize(zstd::compress(dest, source, supercompression));
+                        level.segments = { Memory(level.compressed.data(), level.compressed.size()) };
+                    });
+                }
+
+                queue.wait();
+            }
+
+            // key/value data; each entry is padded to four bytes
+            std::vector<u8> kvd;
+
+            for (const auto& key : keys)
+            {
+                u8 length[4];
+                ustore32le(length, u32(key.first.size() + key.second.size() + 2));
+
+                kvd.insert(kvd.end(), length, length + 4);
+                kvd.insert(kvd.end(), key.first.begin(), key.first.end());
+                kvd.push_back(0);
+                kvd.insert(kvd.end(), key.second.begin(), key.second.end());
+                kvd.push_back(0);
+
+                while (kvd.size() & 3)
+                {
+                    kvd.push_back(0);
+                }
+            }
+
+            const u32 kvdLength = u32(kvd.size());
+
+            std::vector<u8> dfd;
+            descriptor.write(dfd);
+
+            const u32 dfdOffset = 80 + 24 * u32(texture.levels);
+            const u32 kvdOffset = dfdOffset + u32(dfd.size());
+
+            // the level data must be aligned to the least common multiple of the block
+            // size and four unless it is supercompressed
+            u32 alignment = 1;
+            if (supercompression <= 0)
+            {
+                alignment = descriptor.blockBytes;
+                while (alignment % 4)
+                {
+                    alignment += descriptor.blockBytes;
+                }
+            }
+
+            // the smallest level is stored first
+            u64 offset = kvdOffset + kvdLength;
+            std::vector<Memory> segments;
+
+            for (int level = texture.levels - 1; level >= 0; --level)
+            {
+                Level& current = levels[level];
+
+                const u64 padding = (alignment - offset % alignment) % alignment;
+                if (padding)
+                {
+                    segments.emplace_back(const_cast<u8*>(g_zeros), size_t(padding));
+                }
+
+                current.offset = offset + padding;
+                current.size = 0;
+
+                for (const Memory& segment : current.segments)
+                {
+                    segments.push_back(segment);
+                    current.size += segment.size;
+                }
+
+                offset = current.offset + current.size;
+            }
+
+            LittleEndianStream s(stream);
+
+            s.write(ktx2Identifier, 12);
+            s.write32(descriptor.vkFormat);
+            s.write32(descriptor.typeSize);
+            s.write32(texture.width);
+            s.write32(texture.height);
+            s.write32(0); // pixelDepth
+            s.write32(layers > 1 ? layers : 0); // layerCount
+            s.write32(texture.faces / layers);
+            s.write32(texture.levels);
+            s.write32(supercompression > 0 ? KTX2_SUPERCOMPRESSION_ZSTD : KTX2_SUPERCOMPRESSION_NONE);
+
+            s.write32(dfdOffset);
+            s.write32(u32(dfd.size()));
+            s.write32(kvdOffset);
+            s.write32(kvdLength);
+            s.write64(0); // sgdByteOffset
+            s.write64(0); // sgdByteLength
+
+            for (const Level& level : levels)
+            {
+                s.write64(level.offset);
+                s.write64(level.size);
+                s.write64(level.uncompressedSize);
+            }
+
+            s.write(dfd.data(), dfd.size());
+
+            s.write(kvd.data(), kvd.size());
+
+            stream.writev(segments.data(), segments.size());
+        }
+    };
+
+    // ------------------------------------------------------------
+    // KTX2 reader
+    // ------------------------------------------------------------
+
+    struct HeaderKTX2
+    {
+        struct Level
+        {
+            u64 offset;
+            u64 size;
+            u64 uncompressedSize;
+        };
+
+        u32 vkFormat;
+        int width;
+        int height;
+        int depth;
+        int faces;
+        int levels;
+        u32 supercompression;
+        int layers;
+        std::vector<Level> levelIndex;
+
+        // value of the "mangoETC1S" key; the ETC2 blocks are ETC1S
+        std::string etc1s;
+
+        TextureCompression compression = TextureCompression::NONE;
+        Format format;
+
+        HeaderKTX2(Memory memory)
+        {
+            const u8 ktx2Identifier[] =
+            {
+                0xab, 0x4b, 0x54, 0x58, 0x20, 0x32,
+                0x30, 0xbb, 0x0d, 0x0a, 0x1a, 0x0a
+            };
+
+            if (memory.size < 80 || std::memcmp(ktx2Identifier, memory.address, 12))
+            {
+                MANGO_EXCEPTION(ID"Incorrect identifier.");
+            }
+
+            LittleEndianPointer p = memory.address + 12;
+
+            vkFormat = p.read32();
+            p += 4; // typeSize
+            width = p.read32();
+            height = p.read32();
+            depth = p.read32();
+            const u32 layerCount = p.read32();
+            faces = p.read32();
+            levels = std::max(1U, p.read32());
+            supercompression = p.read32();
+
+            const u32 dfdOffset = p.read32();
+            const u32 dfdLength = p.read32();
+            const u32 kvdOffset = p.read32();
+            const u32 kvdLength = p.read32();
+            p += 16; // supercompression global data
+
+            if (faces != 1 && faces != 6)
+            {
+                MANGO_EXCEPTION(ID"Incorrect number of faces.");
+            }
+
+            if (u64(kvdOffset) + kvdLength > memory.size)
+            {
+                MANGO_EXCEPTION(ID"Incorrect header.");
+            }
+
+            parseKeys(memory.slice(kvdOffset, kvdLength));
+
+            // the alpha blocks of ETC1S are the second layer
+            layers = std::max(1U, layerCount);
+
+            if (layers > 1 && !(layers == 2 && etc1s == "RGBA"))
+            {
+                MANGO_EXCEPTION(ID"Incorrect number of array elements (not supported).");
+            }
+
+            if (supercompression != KTX2_SUPERCOMPRESSION_NONE && supercompression != KTX2_SUPERCOMPRESSION_ZSTD)
+            {
+                MANGO_EXCEPTION(ID"Unsupported supercompression: %d", supercompression);
+            }
+
+            if (80 + 24 * u64(levels) > memory.size || u64(dfdOffset) + dfdLength > memory.size)
+            {
+                MANGO_EXCEPTION(ID"Incorrect header.");
+            }
+
+            for (int level = 0; level < levels; ++level)
+            {
+                Level index;
+                index.offset = p.read64();
+                index.size = p.read64();
+                index.uncompressedSize = p.read64();
+
+                if (index.offset + index.size > memory.size)
+                {
+                    MANGO_EXCEPTION(ID"Incorrect level index.");
+                }
+
+                levelIndex.push_back(index);
+            }
+
+            parseFormat();
+        }
+
+        void parseKeys(Memory memory)
+        {
+            LittleEndianPointer p = memory.address;
+            const u8* end = memory.address + memory.size;
+
+            while (end - p >= 4)
+            {
+                const u32 length = p.read32();
+                if (length > u32(end - p))
+                    break;
+
+                const char* key = reinterpret_cast<const char*>(&p[0]);
+                const char* value = reinterpret_cast<const char*>(std::memchr(key, 0, length));
+
+                if (value && !std::strcmp(key, "mangoETC1S"))
+                {
+                    ++value;
+                    etc1s.assign(value, strnlen(value, key + length - value));
+                }
+
+                p += (length + 3) & ~3;
+            }
+        }
+
+        void parseFormat()
+        {
+            if (vkFormat == VK_FORMAT_UNDEFINED)
+            {
+                // BasisLZ / ETC1S and UASTC textures need the basis transcoder
+                MANGO_EXCEPTION(ID"Unsupported format (VK_FORMAT_UNDEFINED).");
+            }
+
+            compression = vulkan::getTextureCompression(vkFormat);
+
+            if (!etc1s.empty())
+            {
+                const bool alpha = etc1s == "RGBA";
+                const bool srgb = compression == TextureCompression::ETC2_SRGB;
+
+                if ((etc1s != "RGB" && !alpha) || (alpha != (layers == 2)) ||
+                    (compression != TextureCompression::ETC2_RGB && !srgb))
+                {
+                    MANGO_EXCEPTION(ID"Incorrect ETC1S layout.");
+                }
+
+                compression = alpha ?
+                    (srgb ? TextureCompression::ETC1S_SRGB_ALPHA : TextureCompression::ETC1S_RGBA) :
+                    (srgb ? TextureCompression::ETC1S_SRGB : TextureCompression::ETC1S_RGB);
+            }
+
+            if (compression != TextureCompression::NONE)
+            {
+                format = TextureCompressionInfo(compression).format;
+                return;
+            }
+
+            switch (vkFormat)
+            {
+                case VK_FORMAT_R8G8B8A8_UNORM:
+                case VK_FORMAT_R8G8B8A8_SRGB:
+                    format = FORMAT_R8G8B8A8;
+                    break;
+                case VK_FORMAT_R16G16B16A16_SFLOAT:
+                    format = FORMAT_RGBA16F;
+                    break;
+                case VK_FORMAT_R32G32B32A32_SFLOAT:
+                    format = FORMAT_RGBA32F;
+                    break;
+                default:
+                    MANGO_EXCEPTION(ID"Unsupported format: %d", vkFormat);
+                    break;
+            }
+        }
+    };
+
+    struct InterfaceKTX2 : ImageDecoderInterface
+    {
+        Memory m_memory;
+        HeaderKTX2 m_header;
+        std::vector<std::vector<u8>> m_levels;
+
+        InterfaceKTX2(Memory memory)
+            : m_memory(memory)
+            , m_header(memory)
+        {
+            if (m_header.supercompression == KTX2_SUPERCOMPRESSION_ZSTD)
+            {
+                m_levels.resize(m_header.levels);
+
+                for (int level = 0; level < m_header.levels; ++level)
+                {
+                    const HeaderKTX2::Level& index = m_header.levelIndex[level];
+                    m_levels[level].resize(size_t(index.uncompressedSize));
+
+                    Memory source(memory.address + index.offset, size_t(index.size));
+                    Memory dest(m_levels[level].data(), m_levels[level].size());
+                    zstd::decompress(dest, source);
+                }
+            }
+
+            if (m_header.layers == 2)
+            {
+                interleaveLayers();
+            }
+        }
+
+        // The color and alpha layers of ETC1S are interleaved into the 16 byte blocks
+        void interleaveLayers()
+        {
+            std::vector<std::vector<u8>> levels(m_header.levels);
+
+            for (int level = 0; level < m_header.levels; ++level)
+            {
+                Memory data = levelMemory(level);
+                const size_t layer = data.size / 2;
+                const size_t blocks = layer / 8;
+
+                levels[level].resize(layer * 2);
+                u8* dest = levels[level].data();
+
+                for (size_t i = 0; i < blocks; ++i)
+                {
+                    std::memcpy(dest + i * 16 + 0, data.address + i * 8, 8);
+                    std::memcpy(dest + i * 16 + 8, data.address + layer + i * 8, 8);
+                }
+            }
+
+            m_levels.swap(levels);
+        }
+
+        Memory levelMemory(int level) const
+        {
+            if (m_levels.empty())
+            {
+                const HeaderKTX2::Level& index = m_header.levelIndex[level];
+                return Memory(m_memory.address + index.offset, size_t(index.size));
+            }
+
+            return Memory(const_cast<u8*>(m_levels[level].data()), m_levels[level].size());
+        }
+
+        ~InterfaceKTX2()
+        {
+        }
+
+        ImageHeader header() override
+        {
+            ImageHeader header;
+
+            header.width   = m_header.width;
+            header.height  = m_header.height;
+            header.depth   = m_header.depth;
+            header.levels  = m_header.levels;
+            header.faces   = m_header.faces;
+            header.palette = false;
+            header.format  = m_header.format;
+            header.compression = m_header.compression;
+
+            return header;
+        }
+
+        Memory memory(int level, int depth, int face) override
+        {
+            if (level < 0 || level >= m_header.levels || face < 0 || face >= m_header.faces)
+            {
+                return Memory();
+            }
+
+            Memory data = levelMemory(level);
+
+            // the level stores the faces and their depth slices one after another
+            const int slices = std::max(1, m_header.depth >> level);
+            const size_t size = data.size / (m_header.faces * slices);
+            const int image = face * slices + std::min(std::max(0, depth), slices - 1);
+
+            return data.slice(image * size, size);
+        }
+
+        void decode(Surface& dest, Palette* palette, int level, int depth, int face) override
+        {
+            MANGO_UNREFERENCED_PARAMETER(palette);
+
+            Memory data = memory(level, depth, face);
+
+            if (m_header.compression != TextureCompression::NONE)
+            {
+                TextureCompressionInfo info(m_header.compression);
+                info.decompress(dest, data);
+            }
+            else
+            {
+                int width = std::max(1, m_header.width >> level);
+                int height = std::max(1, m_header.height >> level);
+                int stride = width * m_header.format.bytes();
+                Surface source(width, height, m_header.format, stride, data.address);
+                dest.blit(0, 0, source);
+            }
+        }
+    };
+
+    ImageDecoderInterface* createInterfaceKTX2(Memory memory)
+    {
+        ImageDecoderInterface* x = new InterfaceKTX2(memory);
+        return x;
+    }
+
+    void imageEncodeKTX(Stream& output, const Surface& surface, const ImageEncodeOptions& options)
+    {
+        encodeTexture(output, surface, options, writeTextureKTX);
+    }
+
+    void imageEncodeKTX2(Stream& output, const Surface& surface, const ImageEncodeOptions& options)
+    {
+        encodeTexture(output, surface, options, writeTextureKTX2);
+    }
+
 } // namespace
 
 namespace mango
 {
 
+    void writeTextureKTX(Stream& output, const Texture& texture, const ImageEncodeOptions& options)
+    {
+        MANGO_UNREFERENCED_PARAMETER(options);
+
+        WriterKTX writer(texture);
+        writer.write(output, texture);
+    }
+
+    void writeTextureKTX2(Stream& output, const Texture& texture, const ImageEncodeOptions& options)
+    {
+        TextureCompressionInfo info(texture.compression);
+
+        if (info.getCompressionFormat() == TextureCompressionInfo::ETC1S)
+        {
+            // KTX2 stores ETC1S only as BasisLZ with the global codebooks in the supercompression
+            // data, which is not supported. The color blocks are valid ETC2 RGB blocks so the file
+            // is written as ETC2 RGB; the alpha blocks of the RGBA variants are the second array
+            // layer. The "mangoETC1S" key ("RGB" or "RGBA") marks the file so that it is decoded
+            // as ETC1S and can be transcoded at load time; other readers see an ETC2 texture.
+            const bool srgb = (info.getCompressionFlags() & TextureCompressionInfo::SRGB) != 0;
+            const bool alpha = (info.getCompressionFlags() & TextureCompressionInfo::ALPHA) != 0;
+            const int layers = alpha ? 2 : 1;
+
+            Texture etc2;
+            etc2.width = texture.width;
+            etc2.height = texture.height;
+            etc2.levels = texture.levels;
+            etc2.faces = texture.faces * layers;
+            etc2.compression = srgb ? TextureCompression::ETC2_SRGB : TextureCompression::ETC2_RGB;
+            etc2.format = TextureCompressionInfo(etc2.compression).format;
+
+            if (alpha)
+            {
+                // the 16 byte blocks are split into the color and alpha layers
+                size_t size = 0;
+
+                for (int level = 0; level < texture.levels; ++level)
+                {
+                    size += texture.getLevelSize(level) * texture.faces;
+                }
+
+                etc2.data.resize(size);
+                etc2.images.resize(etc2.faces * etc2.levels);
+
+                u8* dest = etc2.data.data();
+
+                for (int layer = 0; layer < layers; ++layer)
+                {
+                    for (int face = 0; face < texture.faces; ++face)
+                    {
+                        for (int level = 0; level < texture.levels; ++level)
+                        {
+                            Memory source = texture.getMemory(level, face);
+                            const size_t blocks = source.size / 16;
+
+                            for (size_t i = 0; i < blocks; ++i)
+                            {
+                                std::memcpy(dest + i * 8, source.address + i * 16 + layer * 8, 8);
+                            }
+
+                            etc2.images[(layer * texture.faces + face) * etc2.levels + level] = Memory(dest, blocks * 8);
+                            dest += blocks * 8;
+                        }
+                    }
+                }
+            }
+            else
+            {
+                etc2.images = texture.images;
+            }
+
+            WriterKTX2 writer(etc2, options.supercompression, layers);
+            writer.keys.emplace_back("mangoETC1S", alpha ? "RGBA" : "RGB");
+            writer.write(output, etc2);
+            return;
+        }
+
+        WriterKTX2 writer(texture, options.supercompression);
+        writer.write(output, texture);
+    }
+
     void registerImageDecoderKTX()
     {
         registerImageDecoder(createInterface, ".ktx");
+        registerImageEncoder(imageEncodeKTX, ".ktx");
+        registerImageDecoder(createInterfaceKTX2, ".ktx2");
+        registerImageEncoder(imageEncodeKTX2, ".ktx2");
     }
 
 } // namespace mango
@@ -538,6 +538,102 @@ STBIDEF char *stbi_zlib_decode_malloc_guesssize_headerflag(const char *buffer, i
         COLOR_TYPE_RGBA    = 6,
     };
 
+    // number of channels of a valid color type and bit depth combination, zero otherwise
+    int getChannels(int color_type, int bit_depth)
+    {
+        if (!u32_is_power_of_two(bit_depth))
+            return 0;
+
+        // bit-depth range defaults
+        int minBits = 3; // log2(8) bits
+        int maxBits = 4; // log2(16) bits
+        int channels = 0;
+
+        switch (color_type)
+        {
+            case COLOR_TYPE_I:
+                // supported: 1, 2, 4, 8, 16 bits
+                minBits = 0;
+                channels = 1;
+                break;
+            case COLOR_TYPE_RGB:
+                // supported: 8, 16 bits
+                channels = 3;
+                break;
+            case COLOR_TYPE_PALETTE:
+                // supported: 1, 2, 4, 8 bits
+                minBits = 0;
+                maxBits = 3;
+                channels = 1;
+                break;
+            case COLOR_TYPE_IA:
+                // supported: 8, 16 bits
+                channels = 2;
+                break;
+            case COLOR_TYPE_RGBA:
+                // supported: 8, 16 bits
+                channels = 4;
+                break;
+            default:
+                return 0;
+        }
+
+        const int log2bits = u32_log2(bit_depth);
+        if (log2bits < minBits || log2bits > maxBits)
+            return 0;
+
+        return channels;
+    }
+
+    ImageHeader createHeader(int width, int height, int color_type, int bit_depth, bool transparent)
+    {
+        ImageHeader header;
+
+        header.width   = width;
+        header.height  = height;
+        header.depth   = 0;
+        header.levels  = 0;
+        header.faces   = 0;
+		header.palette = false;
+        header.compression = TextureCompression::NONE;
+
+        // force alpha channel on when transparency is enabled
+        if (transparent && color_type != COLOR_TYPE_PALETTE)
+        {
+            color_type |= 4;
+        }
+
+        // select decoding format
+        switch (color_type)
+        {
+            case COLOR_TYPE_I:
+                header.format = bit_depth <= 8 ?
+                    Format(8, 0xff, 0xff, 0xff, 0) :
+                    Format(16, 0xffff, 0xffff, 0xffff, 0);
+                break;
+
+            case COLOR_TYPE_IA:
+                header.format = bit_depth <= 8 ?
+                    Format(16, 0xff, 0xff, 0xff, 0xff00) :
+                    Format(32, 0xffff, 0xffff, 0xffff, 0xffff0000);
+                break;
+
+            case COLOR_TYPE_PALETTE:
+                header.palette = true;
+                header.format = Format(32, Format::UNORM, Format::BGRA, 8, 8, 8, 8);
+                break;
+
+            case COLOR_TYPE_RGB:
+            case COLOR_TYPE_RGBA:
+                header.format = bit_depth <= 8 ?
+                    Format(32, Format::UNORM, Format::BGRA, 8, 8, 8, 8) :
+                    Format(64, Format::UNORM, Format::RGBA, 16, 16, 16, 16); // RGBA!
+                break;
+        }
+
+        return header;
+    }
+
     struct Chromaticity
     {
         float2 white;
@@ -705,18 +801,15 @@ STBIDEF char *stbi_zlib_decode_malloc_guesssize_headerflag(const char *buffer, i
             return;
         }
 
-        if (!u32_is_power_of_two(m_bit_depth))
-        {
-            setError("Incorrect bit depth.");
-            return;
-        }
-
-        // look-ahead into the chunks to see if we have transparency information
+        // look-ahead into the chunks to see if we have transparency information;
+        // the tRNS chunk must come before the image data
         p += 4; // skip crc
         for (; p < m_end - 8;)
         {
             const u32 size = p.read32();
             const u32 id = p.read32();
+            if (id == make_u32rev('I', 'D', 'A', 'T'))
+                break;
             switch (id)
             {
                 case make_u32rev('t', 'R', 'N', 'S'):
@@ -726,44 +819,10 @@ STBIDEF char *stbi_zlib_decode_malloc_guesssize_headerflag(const char *buffer, i
             p += (size + 4);
         }
 
-        // bit-depth range defaults
-        int minBits = 3; // log2(8) bits
-        int maxBits = 4; // log2(16) bits
-
-        switch (m_color_type)
+        m_channels = getChannels(m_color_type, m_bit_depth);
+        if (!m_channels)
         {
-            case COLOR_TYPE_I:
-                // supported: 1, 2, 4, 8, 16 bits
-                minBits = 0;
-                m_channels = 1;
-                break;
-            case COLOR_TYPE_RGB:
-                // supported: 8, 16 bits
-                m_channels = 3;
-                break;
-            case COLOR_TYPE_PALETTE:
-                // supported: 1, 2, 4, 8 bits
-                minBits = 0;
-                maxBits = 3;
-                m_channels = 1;
-                break;
-            case COLOR_TYPE_IA:
-                // supported: 8, 16 bits
-                m_channels = 2;
-                break;
-            case COLOR_TYPE_RGBA:
-                // supported: 8, 16 bits
-                m_channels = 4;
-                break;
-            default:
-                setError("Incorrect color type.");
-                return;
-        }
-
-        const int log2bits = u32_log2(m_bit_depth);
-        if (log2bits < minBits || log2bits > maxBits)
-        {
-            setError("Unsupported bit depth for color type.");
+            setError("Unsupported color type and bit depth combination.");
             return;
         }
 
@@ -914,55 +973,12 @@ STBIDEF char *stbi_zlib_decode_malloc_guesssize_headerflag(const char *buffer, i
 
     ImageHeader ParserPNG::header() const
     {
-        ImageHeader header;
-
-        if (!m_error)
+        if (m_error)
         {
-            header.width   = m_width;
-            header.height  = m_height;
-            header.depth   = 0;
-            header.levels  = 0;
-            header.faces   = 0;
-			header.palette = false;
-            header.compression = TextureCompression::NONE;
-
-            // force alpha channel on when transparency is enabled
-            int color_type = m_color_type;
-            if (m_transparent_enable && color_type != COLOR_TYPE_PALETTE)
-            {
-                color_type |= 4;
-            }
-
-            // select decoding format
-            switch (color_type)
-            {
-                case COLOR_TYPE_I:
-                    header.format = m_bit_depth <= 8 ?
-                        Format(8, 0xff, 0xff, 0xff, 0) :
-                        Format(16, 0xffff, 0xffff, 0xffff, 0);
-                    break;
-
-                case COLOR_TYPE_IA:
-                    header.format = m_bit_depth <= 8 ?
-                        Format(16, 0xff, 0xff, 0xff, 0xff00) :
-                        Format(32, 0xffff, 0xffff, 0xffff, 0xffff0000);
-                    break;
-
-                case COLOR_TYPE_PALETTE:
-                    header.palette = true;
-                    header.format = Format(32, Format::UNORM, Format::BGRA, 8, 8, 8, 8);
-                    break;
-
-                case COLOR_TYPE_RGB:
-                case COLOR_TYPE_RGBA:
-                    header.format = m_bit_depth <= 8 ?
-                        Format(32, Format::UNORM, Format::BGRA, 8, 8, 8, 8) :
-                        Format(64, Format::UNORM, Format::RGBA, 16, 16, 16, 16); // RGBA!
-                    break;
-            }
+            return ImageHeader();
         }
 
-        return header;
+        return createHeader(m_width, m_height, m_color_type, m_bit_depth, m_transparent_enable);
     }
 
     void ParserPNG::parse()
@@ -1728,6 +1744,9 @@ STBIDEF char *stbi_zlib_decode_malloc_guesssize_headerflag(const char *buffer, i
             stream.avail_in  = (unsigned int)m_compressed.size();
             stream.next_out  = buffer;
             stream.avail_out = (unsigned int)buffer_size;
+            stream.zalloc    = CompressionContext::allocate;
+            stream.zfree     = CompressionContext::deallocate;
+            stream.opaque    = &CompressionContext::getThreadContext();
 
             status = mz_inflateInit(&stream);
             if (status != MZ_OK)
@@ -1807,42 +1826,85 @@ STBIDEF char *stbi_zlib_decode_malloc_guesssize_headerflag(const char *buffer, i
     void write_IDAT(Stream& stream, const Surface& surface)
     {
         const int bytesPerLine = surface.width * surface.format.bytes();
-        const int bytes = (FILTER_BYTE + bytesPerLine) * surface.height;
 
         z_stream z = { 0 };
+        z.zalloc = CompressionContext::allocate;
+        z.zfree = CompressionContext::deallocate;
+        z.opaque = &CompressionContext::getThreadContext();
         deflateInit(&z, -1);
 
-        z.avail_out = (unsigned int)deflateBound(&z, bytes);
-        Buffer buffer(4 + z.avail_out);
+        // compress into pooled pages; no worst case preallocation
+        SegmentedBuffer buffer;
 
-        BigEndianStream s(buffer);
-        s.write32(make_u32rev('I', 'D', 'A', 'T'));
+        Memory page = buffer.acquire(1);
+        z.next_out = page.address;
+        z.avail_out = (unsigned int)page.size;
+
+        auto compress = [&] (const u8* data, size_t size, int flush)
+        {
+            z.next_in = const_cast<u8*>(data);
+            z.avail_in = (unsigned int)size;
+
+            for (;;)
+            {
+                int status = deflate(&z, flush);
+                if (status == Z_STREAM_END || status == Z_STREAM_ERROR)
+                    break;
 
-        z.next_out = buffer + 4;
+                if (z.avail_out == 0)
+                {
+                    // page is full; continue in a fresh one
+                    buffer.commit(page.size);
+                    page = buffer.acquire(1);
+                    z.next_out = page.address;
+                    z.avail_out = (unsigned int)page.size;
+                }
+                else if (flush != Z_FINISH && z.avail_in == 0)
+                {
+                    break;
+                }
+            }
+        };
 
         for (int y = 0; y < surface.height; ++y)
         {
             bool last_scan = (y == surface.height - 1);
 
             // compress filler byte
-            u8 zero = 0;
-            z.avail_in = 1;
-            z.next_in = &zero;
-            deflate(&z, Z_NO_FLUSH);
+            const u8 zero = 0;
+            compress(&zero, 1, Z_NO_FLUSH);
 
             // compress scanline
-            z.avail_in = bytesPerLine;
-            z.next_in = surface.address<u8>(0, y);
-            deflate(&z, last_scan ? Z_FINISH : Z_NO_FLUSH);
+            compress(surface.address<u8>(0, y), bytesPerLine, last_scan ? Z_FINISH : Z_NO_FLUSH);
         }
 
-        // compressed size includes chunkID
-        const size_t compressed_size = int(z.next_out - buffer);
+        buffer.commit(z.next_out - page.address);
 
         deflateEnd(&z);
 
-        // write chunkdID + compressed data
-        writeChunk(stream, Memory(buffer, compressed_size));
+        const std::vector<Memory>& pages = buffer.segments();
+
+        // chunk header and crc are computed over the pages in-place
+        u8 header[8];
+        ustore32be(header + 0, u32(buffer.size()));
+        ustore32be(header + 4, make_u32rev('I', 'D', 'A', 'T'));
+
+        u32 crc = crc32(0, Memory(header + 4, 4));
+        for (const Memory& memory : pages)
+        {
+            crc = crc32(crc, memory);
+        }
+
+        u8 trailer[4];
+        ustore32be(trailer, crc);
+
+        std::vector<Memory> segments;
+        segments.reserve(pages.size() + 2);
+        segments.emplace_back(header, 8);
+        segments.insert(segments.end(), pages.begin(), pages.end());
+        segments.emplace_back(trailer, 4);
+
+        stream.writev(segments.data(), segments.size());
     }
 
     void writePNG(Stream& stream, const Surface& surface, u8 color_bits, ColorType color_type)
@@ -1941,13 +2003,79 @@ STBIDEF char *stbi_zlib_decode_malloc_guesssize_headerflag(const char *buffer, i
         return x;
     }
 
+    bool probeHeader(ImageProbe& probe, Memory memory)
+    {
+        if (memory.size < 33)
+            return false;
+
+        BigEndianPointer p = memory.address;
+        const u8* end = memory.address + memory.size;
+
+        if (p.read64() != 0x89504e470d0a1a0a)
+            return false;
+
+        const u32 size = p.read32();
+        const u32 id = p.read32();
+        if (id != make_u32rev('I', 'H', 'D', 'R') || size != 13)
+            return false;
+
+        const int width = p.read32();
+        const int height = p.read32();
+        const int bit_depth = p.read8();
+        const int color_type = p.read8();
+        p += 7; // compression, filter, interlace and crc
+
+        if (width > 0x8000 || height > 0x8000 || !getChannels(color_type, bit_depth))
+            return false;
+
+        bool transparent = false;
+
+        // the chunks which affect the header and the metadata come before the image data
+        while (p + 8 <= end)
+        {
+            const u32 size = p.read32();
+            const u32 id = p.read32();
+
+            if (id == make_u32rev('I', 'D', 'A', 'T') || size > u32(end - p))
+                break;
+
+            switch (id)
+            {
+                case make_u32rev('t', 'R', 'N', 'S'):
+                    transparent = true;
+                    break;
+
+                case make_u32rev('e', 'X', 'I', 'f'):
+                    probe.exif = Memory(p, size);
+                    break;
+
+                case make_u32rev('i', 'C', 'C', 'P'):
+                {
+                    // profile name, compression method and the compressed profile
+                    const u8* name_end = reinterpret_cast<const u8*>(std::memchr(p, 0, std::min(size, 80u)));
+                    if (name_end && name_end + 2 <= p + size)
+                    {
+                        probe.icc = Memory(const_cast<u8*>(name_end + 2), size - u32(name_end + 2 - p));
+                    }
+                    break;
+                }
+            }
+
+            p += size + 4;
+        }
+
+        probe.header = createHeader(width, height, color_type, bit_depth, transparent);
+
+        return true;
+    }
+
     // ------------------------------------------------------------
     // ImageEncoder
     // ------------------------------------------------------------
 
-    void imageEncode(Stream& stream, const Surface& surface, float quality)
+    void imageEncode(Stream& stream, const Surface& surface, const ImageEncodeOptions& options)
     {
-        MANGO_UNREFERENCED_PARAMETER(quality);
+        MANGO_UNREFERENCED_PARAMETER(options);
 
         // defaults
         u8 color_bits = 8;
@@ -2025,6 +2153,7 @@ namespace mango
     void registerImageDecoderPNG()
     {
         registerImageDecoder(createInterface, ".png");
+        registerImageProbe(probeHeader, ".png");
         registerImageEncoder(imageEncode, ".png");
     }
 
@@ -9,6 +9,16 @@
 
 //#define ENABLE_PVR_DEBUG
 #define ID "[ImageDecoder.PVR] "
+#define ID_ENCODER "[ImageEncoder.PVR] "
+
+namespace mango
+{
+
+    void encodeTexture(Stream& output, const Surface& surface, const ImageEncodeOptions& options,
+                       void (*write)(Stream& output, const Texture& texture, const ImageEncodeOptions& options));
+    void writeTexturePVR(Stream& output, const Texture& texture, const ImageEncodeOptions& options);
+
+} // namespace mango
 
 // http://cdn.imgtec.com/sdk-documentation/PVR+File+Format.Specification.Legacy.pdf
 // http://cdn.imgtec.com/sdk-documentation/PVR+File+Format.Specification.pdf
@@ -99,9 +109,7 @@ namespace
         TextureCompression::ETC2_RGBA,
         TextureCompression::ETC2_RGB_ALPHA1,
         TextureCompression::EAC_R11,
-        TextureCompression::EAC_SIGNED_R11,
         TextureCompression::EAC_RG11,
-        TextureCompression::EAC_SIGNED_RG11,
         TextureCompression::ASTC_RGBA_4x4,
         TextureCompression::ASTC_RGBA_5x4,
         TextureCompression::ASTC_RGBA_5x5,
@@ -130,6 +138,77 @@ namespace
 
     const int formatTableSize = sizeof(formatTable) / sizeof(formatTable[0]);
 
+    // The sRGB and signed variants share the pixel format of the compression; they are
+    // selected with the colorspace and the channel type of the header.
+    const struct
+    {
+        TextureCompression compression;
+        TextureCompression variant;
+    }
+    variantTable[] =
+    {
+        { TextureCompression::PVRTC_RGB_2BPP,   TextureCompression::PVRTC_SRGB_2BPP },
+        { TextureCompression::PVRTC_RGBA_2BPP,  TextureCompression::PVRTC_SRGB_ALPHA_2BPP },
+        { TextureCompression::PVRTC_RGB_4BPP,   TextureCompression::PVRTC_SRGB_4BPP },
+        { TextureCompression::PVRTC_RGBA_4BPP,  TextureCompression::PVRTC_SRGB_ALPHA_4BPP },
+        { TextureCompression::DXT1,             TextureCompression::DXT1_SRGB },
+        { TextureCompression::DXT3,             TextureCompression::DXT3_SRGB },
+        { TextureCompression::DXT5,             TextureCompression::DXT5_SRGB },
+        { TextureCompression::RGTC1_RED,        TextureCompression::RGTC1_SIGNED_RED },
+        { TextureCompression::RGTC2_RG,         TextureCompression::RGTC2_SIGNED_RG },
+        { TextureCompression::BPTC_RGBA_UNORM,  TextureCompression::BPTC_SRGB_ALPHA_UNORM },
+        { TextureCompression::ETC2_RGB,         TextureCompression::ETC2_SRGB },
+        { TextureCompression::ETC2_RGBA,        TextureCompression::ETC2_SRGB_ALPHA8 },
+        { TextureCompression::ETC2_RGB_ALPHA1,  TextureCompression::ETC2_SRGB_ALPHA1 },
+        { TextureCompression::EAC_R11,          TextureCompression::EAC_SIGNED_R11 },
+        { TextureCompression::EAC_RG11,         TextureCompression::EAC_SIGNED_RG11 },
+        { TextureCompression::ASTC_RGBA_4x4,    TextureCompression::ASTC_SRGB_ALPHA_4x4 },
+        { TextureCompression::ASTC_RGBA_5x4,    TextureCompression::ASTC_SRGB_ALPHA_5x4 },
+        { TextureCompression::ASTC_RGBA_5x5,    TextureCompression::ASTC_SRGB_ALPHA_5x5 },
+        { TextureCompression::ASTC_RGBA_6x5,    TextureCompression::ASTC_SRGB_ALPHA_6x5 },
+        { TextureCompression::ASTC_RGBA_6x6,    TextureCompression::ASTC_SRGB_ALPHA_6x6 },
+        { TextureCompression::ASTC_RGBA_8x5,    TextureCompression::ASTC_SRGB_ALPHA_8x5 },
+        { TextureCompression::ASTC_RGBA_8x6,    TextureCompression::ASTC_SRGB_ALPHA_8x6 },
+        { TextureCompression::ASTC_RGBA_8x8,    TextureCompression::ASTC_SRGB_ALPHA_8x8 },
+        { TextureCompression::ASTC_RGBA_10x5,   TextureCompression::ASTC_SRGB_ALPHA_10x5 },
+        { TextureCompression::ASTC_RGBA_10x6,   TextureCompression::ASTC_SRGB_ALPHA_10x6 },
+        { TextureCompression::ASTC_RGBA_10x8,   TextureCompression::ASTC_SRGB_ALPHA_10x8 },
+        { TextureCompression::ASTC_RGBA_10x10,  TextureCompression::ASTC_SRGB_ALPHA_10x10 },
+        { TextureCompression::ASTC_RGBA_12x10,  TextureCompression::ASTC_SRGB_ALPHA_12x10 },
+        { TextureCompression::ASTC_RGBA_12x12,  TextureCompression::ASTC_SRGB_ALPHA_12x12 },
+    };
+
+    TextureCompression getVariant(TextureCompression compression, u32 flags)
+    {
+        for (const auto& node : variantTable)
+        {
+            if (node.compression == compression && (u32(node.variant) & flags))
+                return node.variant;
+        }
+
+        return compression;
+    }
+
+    int getPixelFormat(TextureCompression compression)
+    {
+        for (const auto& node : variantTable)
+        {
+            if (node.variant == compression)
+            {
+                compression = node.compression;
+                break;
+            }
+        }
+
+        for (int i = 0; i < formatTableSize; ++i)
+        {
+            if (formatTable[i] == compression)
+                return i;
+        }
+
+        return -1;
+    }
+
     struct pvr_type_t
     {
         int size : 8;
@@ -512,6 +591,11 @@ namespace
                     // TODO: support for COMPRESSED_NONE entries in the table (packed pixel formats, yuv, shared exponent, 1-bit b/w)
                     TextureCompression compression = formatTable[formatIndex];
 
+                    u32 flags = 0;
+                    flags |= pvr.colorspace == 1 ? TextureCompressionInfo::SRGB : 0;
+                    flags |= typeTable[pvr.channeltype].sign ? TextureCompressionInfo::SIGNED : 0;
+                    compression = getVariant(compression, flags);
+
                     TextureCompressionInfo info(compression);
 
                     if (info.compression != TextureCompression::NONE)
@@ -570,12 +654,10 @@ namespace
                 int width = std::max(1, m_width >> iLevel);
                 int height = std::max(1, m_height >> iLevel);
 
-                // align to next block size
-                width = (width + m_info.width - 1) & ~(m_info.width - 1);
-                height = (height + m_info.height - 1) & ~(m_info.height - 1);
-
-                // compute mip level size in bytes
-                int size = (width / m_info.width) * (height / m_info.height) * m_info.bytes;
+                // compute mip level size in bytes; the ASTC blocks are not power of two
+                const int xblocks = round_multiple_up(width, m_info.width);
+                const int yblocks = round_multiple_up(height, m_info.height);
+                int size = xblocks * yblocks * m_info.bytes;
 
                 for (int iSurface = 0; iSurface < m_surfaces; ++iSurface)
                 {
@@ -668,14 +750,90 @@ namespace
         return x;
     }
 
+    // ------------------------------------------------------------
+    // ImageEncoder
+    // ------------------------------------------------------------
+
+    void imageEncode(Stream& output, const Surface& surface, const ImageEncodeOptions& options)
+    {
+        encodeTexture(output, surface, options, writeTexturePVR);
+    }
+
 } // namespace
 
 namespace mango
 {
 
+    void writeTexturePVR(Stream& output, const Texture& texture, const ImageEncodeOptions& options)
+    {
+        MANGO_UNREFERENCED_PARAMETER(options);
+
+        if (texture.faces != 1 && texture.faces != 6)
+        {
+            MANGO_EXCEPTION(ID_ENCODER"Incorrect number of faces: %d", texture.faces);
+        }
+
+        u64 pixelformat = 0;
+        u32 colorspace = 0;
+        u32 channeltype = 0;
+
+        if (texture.compression != TextureCompression::NONE)
+        {
+            const int index = getPixelFormat(texture.compression);
+            if (index < 0)
+            {
+                MANGO_EXCEPTION(ID_ENCODER"Unsupported compression.");
+            }
+
+            const u32 flags = u32(texture.compression);
+            pixelformat = u64(index);
+            colorspace = flags & TextureCompressionInfo::SRGB ? 1 : 0;
+            channeltype = flags & TextureCompressionInfo::SIGNED ? 1 : 0;
+        }
+        else if (texture.format == FORMAT_R8G8B8A8)
+        {
+            pixelformat = make_u32('r', 'g', 'b', 'a') | (u64(0x08080808) << 32);
+        }
+        else if (texture.format == FORMAT_RGBA32F)
+        {
+            pixelformat = make_u32('r', 'g', 'b', 'a') | (u64(0x20202020) << 32);
+            channeltype = 12;
+        }
+        else
+        {
+            MANGO_EXCEPTION(ID_ENCODER"Unsupported format.");
+        }
+
+        LittleEndianStream s(output);
+
+        s.write32(0x03525650);
+        s.write32(0); // flags
+        s.write64(pixelformat);
+        s.write32(colorspace);
+        s.write32(channeltype);
+        s.write32(texture.height);
+        s.write32(texture.width);
+        s.write32(1); // depth
+        s.write32(1); // surfaces
+        s.write32(texture.faces);
+        s.write32(texture.levels);
+        s.write32(0); // metadata size
+
+        // the faces of each level are stored together
+        for (int level = 0; level < texture.levels; ++level)
+        {
+            for (int face = 0; face < texture.faces; ++face)
+            {
+                Memory memory = texture.getMemory(level, face);
+                s.write(memory.address, memory.size);
+            }
+        }
+    }
+
     void registerImageDecoderPVR()
     {
         registerImageDecoder(createInterface, ".pvr");
+        registerImageEncoder(imageEncode, ".pvr");
     }
 
 } // namespace mango
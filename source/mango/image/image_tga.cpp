@@ -401,13 +401,43 @@ namespace
         return x;
     }
 
+    bool probeHeader(ImageProbe& probe, Memory memory)
+    {
+        // the format has no magic; the header is validated when it is read
+        if (memory.size < 18)
+            return false;
+
+        HeaderTGA header;
+
+        try
+        {
+            LittleEndianPointer p = memory.address;
+            header.read(p);
+        }
+        catch (Exception&)
+        {
+            return false;
+        }
+
+        probe.header.width   = header.image_width;
+        probe.header.height  = header.image_height;
+        probe.header.depth   = 0;
+        probe.header.levels  = 0;
+        probe.header.faces   = 0;
+        probe.header.palette = header.isPalette();
+        probe.header.format  = header.getFormat();
+        probe.header.compression = TextureCompression::NONE;
+
+        return true;
+    }
+
     // ------------------------------------------------------------
     // ImageEncoder
     // ------------------------------------------------------------
 
-    void imageEncode(Stream& stream, const Surface& surface, float quality)
+    void imageEncode(Stream& stream, const Surface& surface, const ImageEncodeOptions& options)
     {
-        MANGO_UNREFERENCED_PARAMETER(quality);
+        MANGO_UNREFERENCED_PARAMETER(options);
 
         // configure output
         const bool isalpha = surface.format.alpha();
@@ -462,6 +492,7 @@ namespace mango
     void registerImageDecoderTGA()
     {
         registerImageDecoder(createInterface, ".tga");
+        registerImageProbe(probeHeader, ".tga");
         registerImageEncoder(imageEncode, ".tga");
     }
 
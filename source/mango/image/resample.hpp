@@ -0,0 +1,65 @@
+/*
+    MANGO Multimedia Development Platform
+    Copyright (C) 2012-2019 Twilight Finland 3D Oy Ltd. All rights reserved.
+*/
+#pragma once
+
+#include <vector>
+#include <mango/image/image.hpp>
+
+namespace mango {
+namespace detail {
+
+    // ----------------------------------------------------------------------------
+    // FilterTable
+    // ----------------------------------------------------------------------------
+
+    // Contributions of the source samples to each destination sample. The filter is stretched
+    // by the reduction ratio when reducing. The integer weights have 14 fractional bits and their
+    // sum is exactly one; the float weights are for the float kernels.
+    struct FilterTable
+    {
+        std::vector<int> start;
+        std::vector<int> count;
+        std::vector<s16> fixed;
+        std::vector<float> weights;
+        int taps;
+        bool identity; // the sizes are the same; the samples are copied
+
+        FilterTable(int source, int dest, ResizeFilter filter);
+
+        // range of the source samples used by the destination samples [i0, i1); the
+        // trimmed ranges are not in order
+        int begin(int i0, int i1) const
+        {
+            int x = start[i0];
+            for (int i = i0; i < i1; ++i)
+            {
+                x = std::min(x, start[i]);
+            }
+            return x;
+        }
+
+        int end(int i0, int i1) const
+        {
+            int x = 0;
+            for (int i = i0; i < i1; ++i)
+            {
+                x = std::max(x, start[i] + count[i]);
+            }
+            return x;
+        }
+    };
+
+    // ----------------------------------------------------------------------------
+    // 8 bit kernels (resize.cpp)
+    // ----------------------------------------------------------------------------
+
+    // The fastest kernels for the CPU which filter four 8 bit components of 32 bit pixels.
+    // The row kernel filters a source row horizontally and the column kernel filters the
+    // given source rows vertically with the weights of one destination row.
+    void resample_row(u8* dest, const u8* src, const FilterTable& table, int width);
+    void resample_column(u8* dest, const u8* const* rows, const s16* weight, int count, int bytes);
+
+} // namespace detail
+} // namespace mango
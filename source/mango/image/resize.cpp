@@ -0,0 +1,932 @@
+/*
+    MANGO Multimedia Development Platform
+    Copyright (C) 2012-2019 Twilight Finland 3D Oy Ltd. All rights reserved.
+*/
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <mango/core/bits.hpp>
+#include <mango/core/endian.hpp>
+#include <mango/core/cpuinfo.hpp>
+#include <mango/core/thread.hpp>
+#include <mango/image/image.hpp>
+#include <mango/math/math.hpp>
+#include "float_rows.hpp"
+#include "resample.hpp"
+#include "../core/dispatch.hpp"
+
+namespace
+{
+    using namespace mango;
+    using namespace mango::detail;
+
+    // ----------------------------------------------------------------------------
+    // filters
+    // ----------------------------------------------------------------------------
+
+    double filter_box(double x)
+    {
+        return x > -0.5 && x <= 0.5 ? 1.0 : 0.0;
+    }
+
+    double filter_bilinear(double x)
+    {
+        x = std::abs(x);
+        return x < 1.0 ? 1.0 - x : 0.0;
+    }
+
+    double filter_bicubic(double x)
+    {
+        // Keys cubic with a = -0.5
+        const double a = -0.5;
+        x = std::abs(x);
+        if (x < 1.0)
+            return ((a + 2.0) * x - (a + 3.0)) * x * x + 1.0;
+        if (x < 2.0)
+            return (((x - 5.0) * x + 8.0) * x - 4.0) * a;
+        return 0.0;
+    }
+
+    double filter_mitchell(double x)
+    {
+        // Mitchell-Netravali with B = C = 1/3
+        const double B = 1.0 / 3.0;
+        const double C = 1.0 / 3.0;
+        x = std::abs(x);
+        if (x < 1.0)
+            return ((12.0 - 9.0 * B - 6.0 * C) * x * x * x + (-18.0 + 12.0 * B + 6.0 * C) * x * x + (6.0 - 2.0 * B)) / 6.0;
+        if (x < 2.0)
+            return ((-B - 6.0 * C) * x * x * x + (6.0 * B + 30.0 * C) * x * x + (-12.0 * B - 48.0 * C) * x + (8.0 * B + 24.0 * C)) / 6.0;
+        return 0.0;
+    }
+
+    double sinc(double x)
+    {
+        if (x == 0.0)
+            return 1.0;
+        x *= 3.14159265358979323846;
+        return std::sin(x) / x;
+    }
+
+    double filter_lanczos3(double x)
+    {
+        return x > -3.0 && x < 3.0 ? sinc(x) * sinc(x / 3.0) : 0.0;
+    }
+
+    struct
+    {
+        double (*func)(double x);
+        double support;
+    }
+    const g_filter_table[] =
+    {
+        { filter_box,      0.5 },
+        { filter_bilinear, 1.0 },
+        { filter_bicubic,  2.0 },
+        { filter_mitchell, 2.0 },
+        { filter_lanczos3, 3.0 },
+    };
+
+    // ----------------------------------------------------------------------------
+    // FilterTable
+    // ----------------------------------------------------------------------------
+
+    constexpr int WEIGHT_BITS = 14;
+    constexpr int WEIGHT_ROUND = 1 << (WEIGHT_BITS - 1);
+
+    // ----------------------------------------------------------------------------
+    // kernels
+    // ----------------------------------------------------------------------------
+
+    // The integer kernels filter four 8 bit components of 32 bit pixels and the float
+    // kernels four float components. The row kernels filter horizontally and the
+    // column kernels vertically; the column kernels are given the source rows.
+
+    using RowFuncU8 = void (*)(u8* dest, const u8* src, const FilterTable& table, int width);
+    using ColumnFuncU8 = void (*)(u8* dest, const u8* const* rows, const s16* weight, int count, int bytes);
+    using RowFuncFloat = void (*)(float* dest, const float* src, const FilterTable& table, int width);
+    using ColumnFuncFloat = void (*)(float* dest, const float* const* rows, const float* weight, int count, int floats);
+
+    void resample_row_u8(u8* dest, const u8* src, const FilterTable& table, int width)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            const u8* s = src + table.start[x] * 4;
+            const s16* weight = table.fixed.data() + size_t(x) * table.taps;
+            const int count = table.count[x];
+
+            int s0 = WEIGHT_ROUND;
+            int s1 = WEIGHT_ROUND;
+            int s2 = WEIGHT_ROUND;
+            int s3 = WEIGHT_ROUND;
+
+            for (int i = 0; i < count; ++i)
+            {
+                const int w = weight[i];
+                s0 += s[0] * w;
+                s1 += s[1] * w;
+                s2 += s[2] * w;
+                s3 += s[3] * w;
+                s += 4;
+            }
+
+            dest[0] = byteclamp(s0 >> WEIGHT_BITS);
+            dest[1] = byteclamp(s1 >> WEIGHT_BITS);
+            dest[2] = byteclamp(s2 >> WEIGHT_BITS);
+            dest[3] = byteclamp(s3 >> WEIGHT_BITS);
+            dest += 4;
+        }
+    }
+
+    void resample_column_u8_span(u8* dest, const u8* const* rows, const s16* weight, int count, int x, int bytes)
+    {
+        for ( ; x < bytes; ++x)
+        {
+            int s = WEIGHT_ROUND;
+
+            for (int i = 0; i < count; ++i)
+            {
+                s += rows[i][x] * weight[i];
+            }
+
+            dest[x] = byteclamp(s >> WEIGHT_BITS);
+        }
+    }
+
+    void resample_column_u8(u8* dest, const u8* const* rows, const s16* weight, int count, int bytes)
+    {
+        resample_column_u8_span(dest, rows, weight, count, 0, bytes);
+    }
+
+    void resample_row_float(float* dest, const float* src, const FilterTable& table, int width)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            const float* s = src + table.start[x] * 4;
+            const float* weight = table.weights.data() + size_t(x) * table.taps;
+            const int count = table.count[x];
+
+            float32x4 sum = 0.0f;
+
+            for (int i = 0; i < count; ++i)
+            {
+                float32x4 v = simd::f32x4_uload(s + i * 4);
+                sum = sum + v * weight[i];
+            }
+
+            simd::f32x4_ustore(dest + x * 4, sum);
+        }
+    }
+
+    void resample_column_float_span(float* dest, const float* const* rows, const float* weight, int count, int x, int floats)
+    {
+        // the rows are whole pixels of four floats
+        for ( ; x < floats; x += 4)
+        {
+            float32x4 sum = 0.0f;
+
+            for (int i = 0; i < count; ++i)
+            {
+                float32x4 v = simd::f32x4_uload(rows[i] + x);
+                sum = sum + v * weight[i];
+            }
+
+            simd::f32x4_ustore(dest + x, sum);
+        }
+    }
+
+    void resample_column_float(float* dest, const float* const* rows, const float* weight, int count, int floats)
+    {
+        resample_column_float_span(dest, rows, weight, count, 0, floats);
+    }
+
+#if defined(MANGO_ENABLE_SSE2)
+
+    // The 8 bit components of two pixels are interleaved and widened to 16 bits so that
+    // _mm_madd_epi16 multiplies them with a pair of weights and adds the products.
+
+    static inline __m128i weight_pair_sse2(const s16* weight)
+    {
+        return _mm_set1_epi32(int(uload32(weight)));
+    }
+
+    static inline __m128i accumulate_u8x4_sse2(__m128i sum, const u8* s, const s16* weight, int i, int count)
+    {
+        const __m128i zero = _mm_setzero_si128();
+
+        for ( ; i + 4 <= count; i += 4)
+        {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + i * 4));
+            v = _mm_shuffle_epi32(v, _MM_SHUFFLE(3, 1, 2, 0));
+            v = _mm_unpacklo_epi8(v, _mm_srli_si128(v, 8));
+            sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_unpacklo_epi8(v, zero), weight_pair_sse2(weight + i + 0)));
+            sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_unpackhi_epi8(v, zero), weight_pair_sse2(weight + i + 2)));
+        }
+
+        if (i + 2 <= count)
+        {
+            __m128i v = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(s + i * 4));
+            v = _mm_unpacklo_epi8(v, _mm_srli_si128(v, 4));
+            sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_unpacklo_epi8(v, zero), weight_pair_sse2(weight + i)));
+            i += 2;
+        }
+
+        if (i < count)
+        {
+            __m128i v = _mm_cvtsi32_si128(int(uload32(s + i * 4)));
+            v = _mm_unpacklo_epi8(v, zero);
+            sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_unpacklo_epi8(v, zero), _mm_set1_epi32(u16(weight[i]))));
+        }
+
+        return sum;
+    }
+
+    static inline void store_u8x4_sse2(u8* dest, __m128i sum)
+    {
+        sum = _mm_srai_epi32(sum, WEIGHT_BITS);
+        sum = _mm_packs_epi32(sum, sum);
+        sum = _mm_packus_epi16(sum, sum);
+        ustore32(dest, u32(_mm_cvtsi128_si32(sum)));
+    }
+
+    void resample_row_u8_sse2(u8* dest, const u8* src, const FilterTable& table, int width)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            const u8* s = src + table.start[x] * 4;
+            const s16* weight = table.fixed.data() + size_t(x) * table.taps;
+
+            __m128i sum = _mm_set1_epi32(WEIGHT_ROUND);
+            sum = accumulate_u8x4_sse2(sum, s, weight, 0, table.count[x]);
+            store_u8x4_sse2(dest + x * 4, sum);
+        }
+    }
+
+    static inline void resample_column_u8x16_sse2(u8* dest, const u8* const* rows, const s16* weight, int count, int x)
+    {
+        const __m128i zero = _mm_setzero_si128();
+
+        __m128i s0 = _mm_set1_epi32(WEIGHT_ROUND);
+        __m128i s1 = s0;
+        __m128i s2 = s0;
+        __m128i s3 = s0;
+
+        for (int i = 0; i < count; i += 2)
+        {
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rows[i] + x));
+            __m128i b = zero;
+            __m128i w = _mm_set1_epi32(u16(weight[i]));
+
+            if (i + 1 < count)
+            {
+                b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rows[i + 1] + x));
+                w = weight_pair_sse2(weight + i);
+            }
+
+            __m128i lo = _mm_unpacklo_epi8(a, b);
+            __m128i hi = _mm_unpackhi_epi8(a, b);
+            s0 = _mm_add_epi32(s0, _mm_madd_epi16(_mm_unpacklo_epi8(lo, zero), w));
+            s1 = _mm_add_epi32(s1, _mm_madd_epi16(_mm_unpackhi_epi8(lo, zero), w));
+            s2 = _mm_add_epi32(s2, _mm_madd_epi16(_mm_unpacklo_epi8(hi, zero), w));
+            s3 = _mm_add_epi32(s3, _mm_madd_epi16(_mm_unpackhi_epi8(hi, zero), w));
+        }
+
+        s0 = _mm_srai_epi32(s0, WEIGHT_BITS);
+        s1 = _mm_srai_epi32(s1, WEIGHT_BITS);
+        s2 = _mm_srai_epi32(s2, WEIGHT_BITS);
+        s3 = _mm_srai_epi32(s3, WEIGHT_BITS);
+        __m128i v = _mm_packus_epi16(_mm_packs_epi32(s0, s1), _mm_packs_epi32(s2, s3));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dest + x), v);
+    }
+
+    void resample_column_u8_sse2(u8* dest, const u8* const* rows, const s16* weight, int count, int bytes)
+    {
+        int x = 0;
+
+        for ( ; x + 16 <= bytes; x += 16)
+        {
+            resample_column_u8x16_sse2(dest, rows, weight, count, x);
+        }
+
+        resample_column_u8_span(dest, rows, weight, count, x, bytes);
+    }
+
+#endif // defined(MANGO_ENABLE_SSE2)
+
+#if defined(MANGO_ENABLE_DISPATCH)
+
+    MANGO_TARGET("avx2")
+    void resample_row_u8_avx2(u8* dest, const u8* src, const FilterTable& table, int width)
+    {
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i index0 = _mm256_setr_epi32(0, 0, 0, 0, 2, 2, 2, 2);
+        const __m256i index1 = _mm256_setr_epi32(1, 1, 1, 1, 3, 3, 3, 3);
+
+        for (int x = 0; x < width; ++x)
+        {
+            const u8* s = src + table.start[x] * 4;
+            const s16* weight = table.fixed.data() + size_t(x) * table.taps;
+            const int count = table.count[x];
+
+            __m256i acc = _mm256_setzero_si256();
+            int i = 0;
+
+            // each 128 bit lane filters four pixels
+            for ( ; i + 8 <= count; i += 8)
+            {
+                __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s + i * 4));
+                v = _mm256_shuffle_epi32(v, _MM_SHUFFLE(3, 1, 2, 0));
+                v = _mm256_unpacklo_epi8(v, _mm256_srli_si256(v, 8));
+                __m256i w = _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(weight + i)));
+                acc = _mm256_add_epi32(acc, _mm256_madd_epi16(_mm256_unpacklo_epi8(v, zero), _mm256_permutevar8x32_epi32(w, index0)));
+                acc = _mm256_add_epi32(acc, _mm256_madd_epi16(_mm256_unpackhi_epi8(v, zero), _mm256_permutevar8x32_epi32(w, index1)));
+            }
+
+            __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+            sum = _mm_add_epi32(sum, _mm_set1_epi32(WEIGHT_ROUND));
+            sum = accumulate_u8x4_sse2(sum, s, weight, i, count);
+            store_u8x4_sse2(dest + x * 4, sum);
+        }
+    }
+
+    MANGO_TARGET("avx2")
+    void resample_column_u8_avx2(u8* dest, const u8* const* rows, const s16* weight, int count, int bytes)
+    {
+        const __m256i zero = _mm256_setzero_si256();
+
+        int x = 0;
+
+        for ( ; x + 32 <= bytes; x += 32)
+        {
+            __m256i s0 = _mm256_set1_epi32(WEIGHT_ROUND);
+            __m256i s1 = s0;
+            __m256i s2 = s0;
+            __m256i s3 = s0;
+
+            for (int i = 0; i < count; i += 2)
+            {
+                __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(rows[i] + x));
+                __m256i b = zero;
+                __m256i w = _mm256_set1_epi32(u16(weight[i]));
+
+                if (i + 1 < count)
+                {
+                    b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(rows[i + 1] + x));
+                    w = _mm256_set1_epi32(int(uload32(weight + i)));
+                }
+
+                __m256i lo = _mm256_unpacklo_epi8(a, b);
+                __m256i hi = _mm256_unpackhi_epi8(a, b);
+                s0 = _mm256_add_epi32(s0, _mm256_madd_epi16(_mm256_unpacklo_epi8(lo, zero), w));
+                s1 = _mm256_add_epi32(s1, _mm256_madd_epi16(_mm256_unpackhi_epi8(lo, zero), w));
+                s2 = _mm256_add_epi32(s2, _mm256_madd_epi16(_mm256_unpacklo_epi8(hi, zero), w));
+                s3 = _mm256_add_epi32(s3, _mm256_madd_epi16(_mm256_unpackhi_epi8(hi, zero), w));
+            }
+
+            // the unpacking and packing are both in-lane so the bytes stay in order
+            s0 = _mm256_srai_epi32(s0, WEIGHT_BITS);
+            s1 = _mm256_srai_epi32(s1, WEIGHT_BITS);
+            s2 = _mm256_srai_epi32(s2, WEIGHT_BITS);
+            s3 = _mm256_srai_epi32(s3, WEIGHT_BITS);
+            __m256i v = _mm256_packus_epi16(_mm256_packs_epi32(s0, s1), _mm256_packs_epi32(s2, s3));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(dest + x), v);
+        }
+
+        for ( ; x + 16 <= bytes; x += 16)
+        {
+            resample_column_u8x16_sse2(dest, rows, weight, count, x);
+        }
+
+        resample_column_u8_span(dest, rows, weight, count, x, bytes);
+    }
+
+    MANGO_TARGET("avx2")
+    void resample_row_float_avx2(float* dest, const float* src, const FilterTable& table, int width)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            const float* s = src + table.start[x] * 4;
+            const float* weight = table.weights.data() + size_t(x) * table.taps;
+            const int count = table.count[x];
+
+            __m256 acc = _mm256_setzero_ps();
+            int i = 0;
+
+            // two pixels at a time
+            for ( ; i + 2 <= count; i += 2)
+            {
+                __m256 v = _mm256_loadu_ps(s + i * 4);
+                __m256 w = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(weight[i])), _mm_set1_ps(weight[i + 1]), 1);
+                acc = _mm256_add_ps(acc, _mm256_mul_ps(v, w));
+            }
+
+            __m128 sum = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+
+            if (i < count)
+            {
+                sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(s + i * 4), _mm_set1_ps(weight[i])));
+            }
+
+            _mm_storeu_ps(dest + x * 4, sum);
+        }
+    }
+
+    MANGO_TARGET("avx2")
+    void resample_column_float_avx2(float* dest, const float* const* rows, const float* weight, int count, int floats)
+    {
+        int x = 0;
+
+        for ( ; x + 8 <= floats; x += 8)
+        {
+            __m256 sum = _mm256_setzero_ps();
+
+            for (int i = 0; i < count; ++i)
+            {
+                __m256 v = _mm256_loadu_ps(rows[i] + x);
+                sum = _mm256_add_ps(sum, _mm256_mul_ps(v, _mm256_set1_ps(weight[i])));
+            }
+
+            _mm256_storeu_ps(dest + x, sum);
+        }
+
+        resample_column_float_span(dest, rows, weight, count, x, floats);
+    }
+
+#endif // defined(MANGO_ENABLE_DISPATCH)
+
+#if defined(MANGO_ENABLE_NEON)
+
+    void resample_row_u8_neon(u8* dest, const u8* src, const FilterTable& table, int width)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            const u8* s = src + table.start[x] * 4;
+            const s16* weight = table.fixed.data() + size_t(x) * table.taps;
+            const int count = table.count[x];
+
+            int32x4_t sum = vdupq_n_s32(WEIGHT_ROUND);
+            int i = 0;
+
+            for ( ; i + 2 <= count; i += 2)
+            {
+                int16x8_t v = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(s + i * 4)));
+                sum = vmlal_n_s16(sum, vget_low_s16(v), weight[i + 0]);
+                sum = vmlal_n_s16(sum, vget_high_s16(v), weight[i + 1]);
+            }
+
+            if (i < count)
+            {
+                uint8x8_t p = vreinterpret_u8_u32(vdup_n_u32(uload32(s + i * 4)));
+                int16x8_t v = vreinterpretq_s16_u16(vmovl_u8(p));
+                sum = vmlal_n_s16(sum, vget_low_s16(v), weight[i]);
+            }
+
+            int16x4_t n = vqshrn_n_s32(sum, WEIGHT_BITS);
+            uint8x8_t b = vqmovun_s16(vcombine_s16(n, n));
+            ustore32(dest + x * 4, vget_lane_u32(vreinterpret_u32_u8(b), 0));
+        }
+    }
+
+    void resample_column_u8_neon(u8* dest, const u8* const* rows, const s16* weight, int count, int bytes)
+    {
+        int x = 0;
+
+        for ( ; x + 16 <= bytes; x += 16)
+        {
+            int32x4_t s0 = vdupq_n_s32(WEIGHT_ROUND);
+            int32x4_t s1 = s0;
+            int32x4_t s2 = s0;
+            int32x4_t s3 = s0;
+
+            for (int i = 0; i < count; ++i)
+            {
+                uint8x16_t v = vld1q_u8(rows[i] + x);
+                int16x8_t lo = vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(v)));
+                int16x8_t hi = vreinterpretq_s16_u16(vmovl_u8(vget_high_u8(v)));
+                s0 = vmlal_n_s16(s0, vget_low_s16(lo), weight[i]);
+                s1 = vmlal_n_s16(s1, vget_high_s16(lo), weight[i]);
+                s2 = vmlal_n_s16(s2, vget_low_s16(hi), weight[i]);
+                s3 = vmlal_n_s16(s3, vget_high_s16(hi), weight[i]);
+            }
+
+            int16x8_t lo = vcombine_s16(vqshrn_n_s32(s0, WEIGHT_BITS), vqshrn_n_s32(s1, WEIGHT_BITS));
+            int16x8_t hi = vcombine_s16(vqshrn_n_s32(s2, WEIGHT_BITS), vqshrn_n_s32(s3, WEIGHT_BITS));
+            vst1q_u8(dest + x, vcombine_u8(vqmovun_s16(lo), vqmovun_s16(hi)));
+        }
+
+        resample_column_u8_span(dest, rows, weight, count, x, bytes);
+    }
+
+#endif // defined(MANGO_ENABLE_NEON)
+
+    struct Kernels
+    {
+        RowFuncU8 row_u8;
+        ColumnFuncU8 column_u8;
+        RowFuncFloat row_float;
+        ColumnFuncFloat column_float;
+    };
+
+    const Kernels g_kernels = []
+    {
+        // the float32x4 kernels use the compile-time SIMD of the math library
+        Kernels kernels;
+
+        kernels.row_u8 = resample_row_u8;
+        kernels.column_u8 = resample_column_u8;
+        kernels.row_float = resample_row_float;
+        kernels.column_float = resample_column_float;
+
+#if defined(MANGO_ENABLE_SSE2)
+        kernels.row_u8 = resample_row_u8_sse2;
+        kernels.column_u8 = resample_column_u8_sse2;
+#endif
+
+#if defined(MANGO_ENABLE_NEON)
+        kernels.row_u8 = resample_row_u8_neon;
+        kernels.column_u8 = resample_column_u8_neon;
+#endif
+
+#if defined(MANGO_ENABLE_DISPATCH)
+        if (getCPUFlags() & CPU_AVX2)
+        {
+            kernels.row_u8 = resample_row_u8_avx2;
+            kernels.column_u8 = resample_column_u8_avx2;
+            kernels.row_float = resample_row_float_avx2;
+            kernels.column_float = resample_column_float_avx2;
+        }
+#endif
+
+        return kernels;
+    } ();
+
+    // ----------------------------------------------------------------------------
+    // Resampler
+    // ----------------------------------------------------------------------------
+
+    bool isIntegerFormat(const Format& format)
+    {
+        if (format.type != Format::UNORM)
+            return false;
+
+        for (int i = 0; i < 4; ++i)
+        {
+            if (format.size[i] > 8)
+                return false;
+        }
+
+        return true;
+    }
+
+    // Separable resampler which filters the source rows horizontally into a band buffer and
+    // the band buffer vertically into the destination. The destination is resampled in bands
+    // of rows which are independent; the source rows at the band edges are filtered twice.
+    // The source rows are converted into the working format of the kernels and the results
+    // back into the destination format when the formats are not the same. The colors are
+    // filtered with premultiplied alpha so that the transparent pixels do not bleed into
+    // the opaque ones.
+    class Resampler
+    {
+    protected:
+        const Surface& m_dest;
+        const Surface& m_source;
+        FilterTable m_xfilter;
+        FilterTable m_yfilter;
+
+        bool m_integer; // 8 bit integer kernels; otherwise float kernels
+        bool m_alpha;   // the source has alpha; the colors are premultiplied
+        Format m_format; // working format of the kernels
+
+        // integer kernels
+        std::unique_ptr<Blitter> m_input;
+        std::unique_ptr<Blitter> m_output;
+
+        // float kernels
+        FloatRows m_read;
+        FloatRows m_write;
+
+    public:
+        Resampler(const Surface& dest, const Surface& source, ResizeFilter filter, bool linear)
+            : m_dest(dest)
+            , m_source(source)
+            , m_xfilter(source.width, dest.width, filter)
+            , m_yfilter(source.height, dest.height, filter)
+            , m_read(source.format, false, linear)
+            , m_write(dest.format, true, linear)
+        {
+            m_integer = !linear && isIntegerFormat(source.format) && isIntegerFormat(dest.format);
+            m_alpha = source.format.alpha();
+
+            // the premultiply kernels need the alpha in the last byte
+            auto isWorkingFormat = [this] (const Format& format)
+            {
+                return m_alpha ? isByteAlphaFormat(format) : isByteFormat(format);
+            };
+
+            if (m_integer)
+            {
+                if (isWorkingFormat(source.format))
+                    m_format = source.format;
+                else if (isWorkingFormat(dest.format))
+                    m_format = dest.format;
+                else
+                    m_format = FORMAT_R8G8B8A8;
+
+                if (source.format != m_format)
+                {
+                    m_input.reset(new Blitter(m_format, source.format));
+                }
+
+                if (dest.format != m_format)
+                {
+                    m_output.reset(new Blitter(dest.format, m_format));
+                }
+            }
+            else
+            {
+                m_format = FORMAT_RGBA32F;
+            }
+        }
+
+        void resample(int y0, int y1)
+        {
+            if (m_integer)
+                resample_u8(y0, y1);
+            else
+                resample_float(y0, y1);
+        }
+
+    protected:
+        void blit(const Blitter& blitter, u8* dest, const u8* source, int width) const
+        {
+            BlitRect rect;
+
+            rect.src.address = const_cast<u8*>(source);
+            rect.src.stride = 0;
+            rect.dest.address = dest;
+            rect.dest.stride = 0;
+            rect.width = width;
+            rect.height = 1;
+
+            blitter.convert(rect);
+        }
+
+        void resample_u8(int y0, int y1)
+        {
+            const int sourceWidth = m_source.width;
+            const int width = m_dest.width;
+            const int first = m_yfilter.begin(y0, y1);
+            const int last = m_yfilter.end(y0, y1);
+
+            // the source rows are copied when they are converted or premultiplied
+            const bool copy = m_input || m_alpha;
+
+            std::vector<u8> temp(size_t(std::max(sourceWidth, width)) * 4);
+            std::vector<u8> buffer;
+            std::vector<const u8*> rows(last - first);
+
+            if (!m_xfilter.identity || copy)
+            {
+                buffer.resize(size_t(last - first) * width * 4);
+            }
+
+            // horizontal
+            for (int y = first; y < last; ++y)
+            {
+                const u8* src = m_source.address<u8>(0, y);
+                u8* dest = buffer.data() + size_t(y - first) * width * 4;
+
+                if (copy)
+                {
+                    u8* row = m_xfilter.identity ? dest : temp.data();
+
+                    if (m_input)
+                    {
+                        blit(*m_input, row, src, sourceWidth);
+                        src = row;
+                    }
+
+                    if (m_alpha)
+                    {
+                        premultiply_u8(row, src, sourceWidth);
+                    }
+
+                    src = row;
+                }
+
+                if (m_xfilter.identity)
+                {
+                    rows[y - first] = src;
+                }
+                else
+                {
+                    g_kernels.row_u8(dest, src, m_xfilter, width);
+                    rows[y - first] = dest;
+                }
+            }
+
+            // vertical
+            for (int y = y0; y < y1; ++y)
+            {
+                u8* dest = m_output ? temp.data() : m_dest.address<u8>(0, y);
+                const u8* const* source = rows.data() + m_yfilter.start[y] - first;
+
+                if (m_yfilter.identity)
+                {
+                    std::memcpy(dest, source[0], width * 4);
+                }
+                else
+                {
+                    const s16* weight = m_yfilter.fixed.data() + size_t(y) * m_yfilter.taps;
+                    g_kernels.column_u8(dest, source, weight, m_yfilter.count[y], width * 4);
+                }
+
+                if (m_alpha)
+                {
+                    unpremultiply_u8(dest, dest, width);
+                }
+
+                if (m_output)
+                {
+                    blit(*m_output, m_dest.address<u8>(0, y), dest, width);
+                }
+            }
+        }
+
+        void resample_float(int y0, int y1)
+        {
+            const int sourceWidth = m_source.width;
+            const int width = m_dest.width;
+            const int first = m_yfilter.begin(y0, y1);
+            const int last = m_yfilter.end(y0, y1);
+
+            // the float rows are always copies; the working format is not the storage format
+            std::vector<float> temp(size_t(std::max(sourceWidth, width)) * 4);
+            std::vector<float> buffer(size_t(last - first) * width * 4);
+            std::vector<const float*> rows(last - first);
+
+            // horizontal
+            for (int y = first; y < last; ++y)
+            {
+                const u8* src = m_source.address<u8>(0, y);
+                float* dest = buffer.data() + size_t(y - first) * width * 4;
+                float* row = m_read.read(m_xfilter.identity ? dest : temp.data(), src, sourceWidth);
+
+                if (m_alpha)
+                {
+                    premultiply_float(row, sourceWidth);
+                }
+
+                if (!m_xfilter.identity)
+                {
+                    g_kernels.row_float(dest, row, m_xfilter, width);
+                }
+
+                rows[y - first] = dest;
+            }
+
+            // vertical
+            for (int y = y0; y < y1; ++y)
+            {
+                const float* const* source = rows.data() + m_yfilter.start[y] - first;
+
+                if (m_yfilter.identity)
+                {
+                    std::memcpy(temp.data(), source[0], width * 16);
+                }
+                else
+                {
+                    const float* weight = m_yfilter.weights.data() + size_t(y) * m_yfilter.taps;
+                    g_kernels.column_float(temp.data(), source, weight, m_yfilter.count[y], width * 4);
+                }
+
+                if (m_alpha)
+                {
+                    unpremultiply_float(temp.data(), width);
+                }
+
+                m_write.write(m_dest.address<u8>(0, y), temp.data(), width);
+            }
+        }
+    };
+
+} // namespace
+
+namespace mango {
+namespace detail {
+
+    FilterTable::FilterTable(int source, int dest, ResizeFilter filter)
+        : start(dest)
+        , count(dest)
+        , identity(source == dest)
+    {
+        const auto& node = g_filter_table[int(filter)];
+
+        const double scale = double(source) / dest;
+        const double filterscale = std::max(scale, 1.0);
+        const double support = node.support * filterscale;
+
+        taps = int(std::ceil(support)) * 2 + 1;
+        fixed.resize(size_t(dest) * taps);
+        weights.resize(size_t(dest) * taps);
+
+        std::vector<double> w(taps);
+
+        for (int i = 0; i < dest; ++i)
+        {
+            const double center = (i + 0.5) * scale;
+            int x0 = std::max(0, int(center - support + 0.5));
+            int x1 = std::min(source, int(center + support + 0.5));
+
+            double total = 0.0;
+
+            for (int x = x0; x < x1; ++x)
+            {
+                w[x - x0] = node.func((x + 0.5 - center) / filterscale);
+                total += w[x - x0];
+            }
+
+            // skip the samples which are not used at the ends
+            while (x1 - x0 > 1 && w[x1 - x0 - 1] == 0.0)
+            {
+                --x1;
+            }
+
+            while (x1 - x0 > 1 && w[0] == 0.0)
+            {
+                std::copy(w.begin() + 1, w.end(), w.begin());
+                ++x0;
+            }
+
+            if (total == 0.0)
+            {
+                // the filter misses the samples; use the nearest one
+                x0 = std::min(int(center), source - 1);
+                x1 = x0 + 1;
+                w[0] = 1.0;
+                total = 1.0;
+            }
+
+            s16* weight = fixed.data() + size_t(i) * taps;
+            float* weightf = weights.data() + size_t(i) * taps;
+
+            int sum = 0;
+            int largest = 0;
+
+            for (int x = 0; x < x1 - x0; ++x)
+            {
+                weight[x] = s16(std::round(w[x] / total * (1 << WEIGHT_BITS)));
+                weightf[x] = float(w[x] / total);
+                sum += weight[x];
+
+                if (weight[x] > weight[largest])
+                    largest = x;
+            }
+
+            // the rounding error goes to the largest weight
+            weight[largest] += s16((1 << WEIGHT_BITS) - sum);
+
+            start[i] = x0;
+            count[i] = x1 - x0;
+        }
+    }
+
+    void resample_row(u8* dest, const u8* src, const FilterTable& table, int width)
+    {
+        g_kernels.row_u8(dest, src, table, width);
+    }
+
+    void resample_column(u8* dest, const u8* const* rows, const s16* weight, int count, int bytes)
+    {
+        g_kernels.column_u8(dest, rows, weight, count, bytes);
+    }
+
+} // namespace detail
+} // namespace mango
+
+namespace mango
+{
+
+    void Surface::resize(const Surface& source, ResizeFilter filter, bool linear)
+    {
+        if (!source.width || !source.height || !source.format.bits || !format.bits)
+            return;
+
+        if (!width || !height)
+            return;
+
+        Resampler resampler(*this, source, filter, linear);
+
+        // bands of destination rows are resampled in parallel; the work is mostly in the
+        // source rows when the image is reduced
+        const u64 work = u64(source.width) * source.height + u64(width) * height;
+
+        processBands("resize", width, height, [&resampler] (int y0, int y1)
+        {
+            resampler.resample(y0, y1);
+        }, work);
+    }
+
+} // namespace mango
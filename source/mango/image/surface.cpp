@@ -294,12 +294,19 @@ namespace mango
     }
 
     void Surface::save(const std::string& filename, float quality)
+    {
+        ImageEncodeOptions options;
+        options.quality = quality;
+        save(filename, options);
+    }
+
+    void Surface::save(const std::string& filename, const ImageEncodeOptions& options)
     {
         ImageEncoder encoder(filename);
         if (encoder.isEncoder())
         {
             filesystem::FileStream file(filename, Stream::WRITE);
-            encoder.encode(file, *this, quality);
+            encoder.encode(file, *this, options);
         }
     }
 
@@ -0,0 +1,407 @@
+/*
+    MANGO Multimedia Development Platform
+    Copyright (C) 2012-2019 Twilight Finland 3D Oy Ltd. All rights reserved.
+*/
+#include <cstring>
+#include <memory>
+#include <algorithm>
+#include <mango/core/bits.hpp>
+#include <mango/core/string.hpp>
+#include <mango/core/thread.hpp>
+#include <mango/core/exception.hpp>
+#include <mango/image/image.hpp>
+
+#define ID "[Texture] "
+
+namespace mango
+{
+
+    void writeTextureDDS(Stream& output, const Texture& texture, const ImageEncodeOptions& options);
+    void writeTextureKTX(Stream& output, const Texture& texture, const ImageEncodeOptions& options);
+    void writeTextureKTX2(Stream& output, const Texture& texture, const ImageEncodeOptions& options);
+    void writeTexturePVR(Stream& output, const Texture& texture, const ImageEncodeOptions& options);
+
+    void compressBlocks(const TextureCompressionInfo& info, u8* output, const Surface& surface,
+                        int y0, int y1, TextureQuality quality);
+
+} // namespace mango
+
+namespace
+{
+    using namespace mango;
+
+    // ----------------------------------------------------------------------------
+    // alpha coverage
+    // ----------------------------------------------------------------------------
+
+    // The alpha is scaled so that the same fraction of pixels passes the alpha test at
+    // every level. The 8 bit levels are searched from a histogram of the alpha values.
+
+    struct AlphaCoverage
+    {
+        float reference;
+        float coverage;
+
+        AlphaCoverage(const Surface& surface, float reference)
+            : reference(reference)
+        {
+            coverage = compute(surface, 1.0f);
+        }
+
+        float compute(const Surface& surface, float scale) const
+        {
+            u64 count = 0;
+
+            if (surface.format == FORMAT_R8G8B8A8)
+            {
+                u32 histogram[256];
+                computeHistogram(histogram, surface);
+
+                for (int i = 0; i < 256; ++i)
+                {
+                    if (i * scale > reference * 255.0f)
+                        count += histogram[i];
+                }
+            }
+            else
+            {
+                for (int y = 0; y < surface.height; ++y)
+                {
+                    const float* image = surface.address<float>(0, y);
+
+                    for (int x = 0; x < surface.width; ++x)
+                    {
+                        count += image[x * 4 + 3] * scale > reference;
+                    }
+                }
+            }
+
+            return float(count) / float(u64(surface.width) * surface.height);
+        }
+
+        void correct(const Surface& surface) const
+        {
+            // binary search for the smallest scale which reaches the coverage
+            float low = 0.0f;
+            float high = 4.0f;
+
+            for (int i = 0; i < 12; ++i)
+            {
+                float middle = (low + high) * 0.5f;
+                if (compute(surface, middle) < coverage)
+                    low = middle;
+                else
+                    high = middle;
+            }
+
+            const float scale = high;
+
+            for (int y = 0; y < surface.height; ++y)
+            {
+                if (surface.format == FORMAT_R8G8B8A8)
+                {
+                    u8* image = surface.address<u8>(0, y);
+
+                    for (int x = 0; x < surface.width; ++x)
+                    {
+                        image[x * 4 + 3] = u8(std::min(255.0f, image[x * 4 + 3] * scale + 0.5f));
+                    }
+                }
+                else
+                {
+                    float* image = surface.address<float>(0, y);
+
+                    for (int x = 0; x < surface.width; ++x)
+                    {
+                        image[x * 4 + 3] = std::min(1.0f, image[x * 4 + 3] * scale);
+                    }
+                }
+            }
+        }
+
+        static void computeHistogram(u32* histogram, const Surface& surface)
+        {
+            std::memset(histogram, 0, 256 * sizeof(u32));
+
+            for (int y = 0; y < surface.height; ++y)
+            {
+                const u8* image = surface.address<u8>(0, y);
+
+                for (int x = 0; x < surface.width; ++x)
+                {
+                    ++histogram[image[x * 4 + 3]];
+                }
+            }
+        }
+    };
+
+    void storeLevel(u8* output, const Surface& surface)
+    {
+        const int bytes = surface.width * surface.format.bytes();
+
+        for (int y = 0; y < surface.height; ++y)
+        {
+            std::memcpy(output + size_t(y) * bytes, surface.address<u8>(0, y), bytes);
+        }
+    }
+
+} // namespace
+
+namespace mango
+{
+
+    // ----------------------------------------------------------------------------
+    // Texture
+    // ----------------------------------------------------------------------------
+
+    int Texture::getWidth(int level) const
+    {
+        return std::max(1, width >> level);
+    }
+
+    int Texture::getHeight(int level) const
+    {
+        return std::max(1, height >> level);
+    }
+
+    size_t Texture::getLevelSize(int level) const
+    {
+        const int xsize = getWidth(level);
+        const int ysize = getHeight(level);
+
+        if (compression != TextureCompression::NONE)
+        {
+            TextureCompressionInfo info(compression);
+            const int xblocks = round_multiple_up(xsize, info.width);
+            const int yblocks = round_multiple_up(ysize, info.height);
+            return size_t(xblocks) * yblocks * info.bytes;
+        }
+
+        return size_t(xsize) * ysize * format.bytes();
+    }
+
+    Memory Texture::getMemory(int level, int face) const
+    {
+        const size_t index = size_t(face) * levels + level;
+        if (index >= images.size())
+        {
+            MANGO_EXCEPTION(ID"Image index out of range.");
+        }
+
+        return images[index];
+    }
+
+    // ----------------------------------------------------------------------------
+    // buildTexture()
+    // ----------------------------------------------------------------------------
+
+    void buildTexture(Texture& texture, const Surface& source, const TextureOptions& options)
+    {
+        TextureCompressionInfo info(options.compression);
+
+        if (options.compression != TextureCompression::NONE && !info.encode)
+        {
+            MANGO_EXCEPTION(ID"Compression is not supported.");
+        }
+
+        // the levels are generated in 8 bits unless the blocks store floating point color
+        // or the uncompressed levels keep the floating point color of the source
+        const bool fp = source.format.type >= Format::FP16;
+        const bool hdr = (info.getCompressionFlags() & TextureCompressionInfo::FLOAT) ||
+                         (options.compression == TextureCompression::NONE && fp);
+        const Format format = hdr ? FORMAT_RGBA32F : FORMAT_R8G8B8A8;
+        const bool linear = options.linear && !hdr;
+
+        const int maxLevels = u32_log2(std::max(1, std::max(source.width, source.height))) + 1;
+        const int levels = options.levels > 0 ? std::min(options.levels, maxLevels) : maxLevels;
+
+        texture.width = source.width;
+        texture.height = source.height;
+        texture.levels = levels;
+        texture.faces = 1;
+        texture.format = format;
+        texture.compression = options.compression;
+
+        std::vector<size_t> offsets(levels + 1, 0);
+        for (int level = 0; level < levels; ++level)
+        {
+            offsets[level + 1] = offsets[level] + texture.getLevelSize(level);
+        }
+
+        texture.data.resize(offsets[levels]);
+        texture.images.resize(levels);
+
+        for (int level = 0; level < levels; ++level)
+        {
+            texture.images[level] = Memory(texture.data.data() + offsets[level], offsets[level + 1] - offsets[level]);
+        }
+
+        // the levels are kept alive until the queue has drained; each one is read by
+        // the compression tasks and by the reduction to the next level
+        std::vector<std::unique_ptr<Bitmap>> images(levels);
+
+        images[0].reset(new Bitmap(source.width, source.height, format));
+        images[0]->blit(0, 0, source);
+
+        std::unique_ptr<AlphaCoverage> coverage;
+        if (options.alphaReference > 0.0f && source.format.size[3])
+        {
+            coverage.reset(new AlphaCoverage(*images[0], options.alphaReference));
+        }
+
+        ConcurrentQueue queue("texture", Priority::HIGH);
+
+        for (int level = 0; level < levels; ++level)
+        {
+            if (level > 0)
+            {
+                // reduce while the previous levels are compressed in the thread pool
+                Bitmap* next = new Bitmap(texture.getWidth(level), texture.getHeight(level), format);
+                images[level].reset(next);
+                next->resize(*images[level - 1], options.filter, linear);
+
+                if (coverage)
+                {
+                    coverage->correct(*next);
+                }
+            }
+
+            const Bitmap& image = *images[level];
+            u8* output = texture.data.data() + offsets[level];
+
+            if (options.compression == TextureCompression::NONE)
+            {
+                queue.enqueue([output, &image]
+                {
+                    storeLevel(output, image);
+                });
+                continue;
+            }
+
+            // split the level into tasks of about a thousand blocks
+            const int xblocks = round_multiple_up(image.width, info.width);
+            const int yblocks = round_multiple_up(image.height, info.height);
+            const int rows = std::max(1, 1024 / xblocks);
+
+            for (int y = 0; y < yblocks; y += rows)
+            {
+                const int y1 = std::min(y + rows, yblocks);
+
+                queue.enqueue([&info, output, &image, y, y1, &options]
+                {
+                    compressBlocks(info, output, image, y, y1, options.quality);
+                });
+            }
+        }
+
+        queue.wait();
+    }
+
+    // ----------------------------------------------------------------------------
+    // transcodeTexture()
+    // ----------------------------------------------------------------------------
+
+    void transcodeTexture(Texture& output, const Texture& input, TextureCompression compression)
+    {
+        if (!isTranscodable(input.compression, compression))
+        {
+            MANGO_EXCEPTION(ID"Transcoding is not supported.");
+        }
+
+        output.width = input.width;
+        output.height = input.height;
+        output.levels = input.levels;
+        output.faces = input.faces;
+        output.format = input.format;
+        output.compression = compression;
+
+        const int images = input.levels * input.faces;
+
+        std::vector<size_t> offsets(images + 1, 0);
+        for (int i = 0; i < images; ++i)
+        {
+            offsets[i + 1] = offsets[i] + output.getLevelSize(i % input.levels);
+        }
+
+        output.data.resize(offsets[images]);
+        output.images.resize(images);
+
+        ConcurrentQueue queue("texture.transcode", Priority::HIGH);
+
+        for (int i = 0; i < images; ++i)
+        {
+            const int level = i % input.levels;
+            const int face = i / input.levels;
+
+            output.images[i] = Memory(output.data.data() + offsets[i], offsets[i + 1] - offsets[i]);
+
+            queue.enqueue([&output, &input, i, level, face]
+            {
+                transcodeBlocks(output.images[i], output.compression, input.getMemory(level, face),
+                                input.compression, input.getWidth(level), input.getHeight(level));
+            });
+        }
+
+        queue.wait();
+    }
+
+    // ----------------------------------------------------------------------------
+    // writeTexture()
+    // ----------------------------------------------------------------------------
+
+    bool writeTexture(Stream& output, const Texture& texture, const std::string& extension,
+                      const ImageEncodeOptions& options)
+    {
+        const std::string ext = toLower(extension);
+
+        if (ext == ".dds")
+        {
+            writeTextureDDS(output, texture, options);
+        }
+        else if (ext == ".ktx")
+        {
+            writeTextureKTX(output, texture, options);
+        }
+        else if (ext == ".ktx2")
+        {
+            writeTextureKTX2(output, texture, options);
+        }
+        else if (ext == ".pvr")
+        {
+            writeTexturePVR(output, texture, options);
+        }
+        else
+        {
+            return false;
+        }
+
+        return true;
+    }
+
+    // ----------------------------------------------------------------------------
+    // encodeTexture()
+    // ----------------------------------------------------------------------------
+
+    // The image encoders of the texture containers write the texture of the options
+    // or build one from the surface.
+
+    void encodeTexture(Stream& output, const Surface& surface, const ImageEncodeOptions& options,
+                       void (*write)(Stream& output, const Texture& texture, const ImageEncodeOptions& options))
+    {
+        if (options.texture)
+        {
+            write(output, *options.texture, options);
+            return;
+        }
+
+        TextureOptions textureOptions;
+        textureOptions.compression = options.compression;
+        textureOptions.levels = options.mipmaps ? 0 : 1;
+        textureOptions.quality = options.compressionQuality;
+
+        Texture texture;
+        buildTexture(texture, surface, textureOptions);
+        write(output, texture, options);
+    }
+
+} // namespace mango
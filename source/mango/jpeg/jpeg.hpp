@@ -6,14 +6,17 @@
 
 #include <vector>
 #include <string>
+#include <atomic>
 #include <mango/core/core.hpp>
 #include <mango/image/image.hpp>
 #include <mango/math/math.hpp>
+#include "../core/dispatch.hpp"
 
 //#define JPEG_ENABLE_PRINT
 #define JPEG_ENABLE_THREAD
 #define JPEG_ENABLE_SIMD
 #define JPEG_ENABLE_MODERN_HUFFMAN
+#define JPEG_ENABLE_FANCY_UPSAMPLING
 
 #define JPEG_MAX_BLOCKS_IN_MCU   10  // Maximum # of blocks per MCU in the JPEG specification
 #define JPEG_MAX_COMPS_IN_SCAN   4   // JPEG limit on # of components in one scan
@@ -61,6 +64,10 @@ namespace jpeg
     using mango::Memory;
     using mango::Format;
     using mango::Surface;
+    using mango::YUVPlanes;
+    using mango::ImageProbe;
+    using mango::JPEGTransform;
+    using mango::JPEGTranscode;
 	using mango::Stream;
     using mango::ThreadPool;
 
@@ -226,7 +233,7 @@ namespace jpeg
         Arithmetic();
         ~Arithmetic();
 
-        void restart(jpegBuffer& buffer);
+        void restart();
     };
 
     struct Frame
@@ -275,6 +282,9 @@ namespace jpeg
         int successiveLow;
 
         void (*decode)(BlockType* output, DecodeState* state);
+
+        // set when the entropy coded data has codes which are not in the tables
+        std::atomic<bool>* corrupt;
     };
 
     struct Block
@@ -302,12 +312,50 @@ namespace jpeg
         void (*process_YCbCr_8x16 )(u8* dest, int stride, const BlockType* data, ProcessState* state, int width, int height);
         void (*process_YCbCr_16x8 )(u8* dest, int stride, const BlockType* data, ProcessState* state, int width, int height);
         void (*process_YCbCr_16x16)(u8* dest, int stride, const BlockType* data, ProcessState* state, int width, int height);
+
+        // fancy upsampling: the layout kernel reads the chroma from the planes of the MCU row (nullptr when not used)
+        void (*fancy)(u8* dest, int stride, const BlockType* data, ProcessState* state, const u8* cb, const u8* cr, int cstride, int width, int height);
+
+        // color conversion of 8 full resolution samples into 8 pixels
+        void (*convert_YCbCr)(u8* dest, const u8* y, const u8* cb, const u8* cr);
+        void (*convert_CMYK )(u8* dest, const u8* y, const u8* cb, const u8* cr, const u8* k);
+
+        // 12 bit precision: the samples are 16 bits and the pixels are R16G16B16A16
+        void (*idct12)(u16* dest, const BlockType* data, const u16* qt);
+        void (*convert_YCbCr_12)(u8* dest, const u16* y, const u16* cb, const u16* cr);
+
+        // reduced size decoding: each block is transformed into scale x scale samples
+        int scale; // 1, 2, 4 or 8
+        bool transposed; // the coefficients are in the transposed (variant) order
+
+        int xblocks; // MCU width in blocks
+        int bytes_per_pixel; // output pixel size of the color conversion
+        bool rgba; // the layout kernels write R8G8B8A8 instead of B8G8R8A8
+
+        // planar 4:2:0 output; the destination surface is the luma plane
+        struct Planar
+        {
+            u8* y;
+            u8* u;
+            u8* v;
+            int ustride;
+            int vstride;
+            int step; // distance between chroma samples: 1 (I420) or 2 (NV12)
+        } planar;
     };
 
     // ----------------------------------------------------------------------------
     // Parser
     // ----------------------------------------------------------------------------
 
+    struct ProgressiveGraph;
+
+    // receives the decoded image in bands from top to bottom; y is the first row of the band
+    using BandFunc = std::function<void(const Surface& band, int y)>;
+
+    // returns the coefficients of the MCU row y for the fancy upsampling
+    using FancyRowFunc = std::function<const BlockType*(int y)>;
+
     class Parser
     {
     protected:
@@ -323,19 +371,25 @@ namespace jpeg
         DecodeState decodeState;
         ProcessState processState;
 
+        ProgressiveGraph* progressiveGraph; // progressive scans are decoded as tasks when set
+        const BandFunc* m_band; // sequential scans are decoded in stripes into m_surface when set
+
         int restartInterval;
         int restartCounter;
 
         std::string m_info;
         Surface* m_surface;
 
+        bool m_eoi; // the EOI marker was reached after the scans
+        std::atomic<bool> m_corrupt; // the scans have invalid codes or missing restart markers
+
         int width;  // Image width, does include alignment
         int height; // Image height, does include alignment
         int xsize;  // Image width, does not include alignment
         int ysize;  // Image height, does not include alignment
         int xclip;
         int yclip;
-        int precision; // 8 or 16 bits
+        int precision; // 8 or 12 bits (2 to 16 bits in the lossless mode)
         bool is_progressive;
         bool is_arithmetic;
         bool is_lossless;
@@ -375,16 +429,31 @@ namespace jpeg
         void parse(Memory memory, bool decode);
 
         void restart();
+        void restart(DecodeState& state) const;
         bool handleRestart();
 
         void decodeLossless();
         void decodeSequential();
         void decodeSequentialST();
         void decodeSequentialMT();
+        void decodeSequentialFancy();
+        bool decodeSequentialSpeculative();
         void decodeProgressive();
+        u8* decodeProgressiveMT(u8* p, u8* end);
+        void processProgressive(int y0, int y1);
+        void processFancy(int y0, int y1, const FancyRowFunc& row);
         void finishProgressive();
         void finishProgressiveST();
         void finishProgressiveMT();
+        void finishProgressiveGraph();
+        void decodeSequentialCoefficients();
+        void decodeSequentialBands();
+        void processStripe(BlockType* data, int y0, int y1);
+
+        bool setOutputFormat(const Format& format);
+        void verifyScans(Status& status) const;
+        void decodeImage(Surface& target);
+        bool decodeCoefficients();
 
     public:
 
@@ -392,11 +461,18 @@ namespace jpeg
         Memory exif_memory; // Exif block, if one is present
         Memory icc_memory; // ICC color profile block, if one is present
         Memory scan_memory; // Scan block
+        std::vector<Memory> marker_memory; // APPn and COM segments before the frame, including the marker
 
         Parser(Memory memory);
         ~Parser();
 
         Status decode(Surface& target);
+        Status decodeYUV(const YUVPlanes& planes);
+        Status transform(Stream& output, const JPEGTransform& transform);
+
+        // decode the image reduced by scale / 8 (1, 2, 4 or 8) in bands of a few rows of MCUs
+        Status decodeBands(const BandFunc& func, const Format& format, int scale);
+        Status transcode(const std::vector<JPEGTranscode>& outputs);
     };
 
     // ----------------------------------------------------------------------------
@@ -429,9 +505,27 @@ namespace jpeg
     void process_YCbCr_8x16         (u8* dest, int stride, const BlockType* data, ProcessState* state, int width, int height);
     void process_YCbCr_16x8         (u8* dest, int stride, const BlockType* data, ProcessState* state, int width, int height);
     void process_YCbCr_16x16        (u8* dest, int stride, const BlockType* data, ProcessState* state, int width, int height);
+    void fancy_chroma               (u8* cb, u8* cr, int cstride, const BlockType* data, ProcessState* state, int count, int cwidth);
+    void process_YCbCr_16x8_fancy   (u8* dest, int stride, const BlockType* data, ProcessState* state, const u8* cb, const u8* cr, int cstride, int width, int height);
+    void process_YCbCr_16x16_fancy  (u8* dest, int stride, const BlockType* data, ProcessState* state, const u8* cb, const u8* cr, int cstride, int width, int height);
+    void process_Y_color            (u8* dest, int stride, const BlockType* data, ProcessState* state, int width, int height);
+    void process_YUV420             (u8* dest, int stride, const BlockType* data, ProcessState* state, int width, int height);
+    void convert_YCbCr              (u8* dest, const u8* y, const u8* cb, const u8* cr);
+    void convert_YCbCr_RGBA         (u8* dest, const u8* y, const u8* cb, const u8* cr);
+    void convert_YCbCr_RGB565       (u8* dest, const u8* y, const u8* cb, const u8* cr);
+    void convert_YCbCr_RGBA32F      (u8* dest, const u8* y, const u8* cb, const u8* cr);
+    void convert_CMYK               (u8* dest, const u8* y, const u8* cb, const u8* cr, const u8* k);
+    void idct12                     (u16* dest, const BlockType* data, const u16* qt);
+    void process_Y_12               (u8* dest, int stride, const BlockType* data, ProcessState* state, int width, int height);
+    void process_YCbCr_12           (u8* dest, int stride, const BlockType* data, ProcessState* state, int width, int height);
+    void process_CMYK_12            (u8* dest, int stride, const BlockType* data, ProcessState* state, int width, int height);
+    void convert_YCbCr_12           (u8* dest, const u16* y, const u16* cb, const u16* cr);
+    void idct_scaled                (u8* dest, const BlockType* data, const u16* qt, int size, bool transposed);
+    void process_scaled             (u8* dest, int stride, const BlockType* data, ProcessState* state, int width, int height);
 
 #if defined(JPEG_ENABLE_SIMD)
     void idct_simd                  (u8* dest, const BlockType* data, const u16* qt);
+    void idct12_simd                (u16* dest, const BlockType* data, const u16* qt);
 #endif
 
 #if defined(JPEG_ENABLE_SSE2)
@@ -440,8 +534,71 @@ namespace jpeg
     void process_YCbCr_8x16_sse2    (u8* dest, int stride, const BlockType* data, ProcessState* state, int width, int height);
     void process_YCbCr_16x8_sse2    (u8* dest, int stride, const BlockType* data, ProcessState* state, int width, int height);
     void process_YCbCr_16x16_sse2   (u8* dest, int stride, const BlockType* data, ProcessState* state, int width, int height);
+    void convert_YCbCr_sse2         (u8* dest, const u8* y, const u8* cb, const u8* cr);
+    void convert_YCbCr_RGBA_sse2    (u8* dest, const u8* y, const u8* cb, const u8* cr);
+    void convert_YCbCr_RGB565_sse2  (u8* dest, const u8* y, const u8* cb, const u8* cr);
+    void convert_YCbCr_RGBA32F_sse2 (u8* dest, const u8* y, const u8* cb, const u8* cr);
+    void convert_CMYK_sse2          (u8* dest, const u8* y, const u8* cb, const u8* cr, const u8* k);
+    void convert_YCbCr_12_sse2      (u8* dest, const u16* y, const u16* cb, const u16* cr);
 #endif
 
-	void EncodeImage(Stream& stream, const Surface& surface, float quality);
+#if defined(JPEG_ENABLE_SSE2) && defined(MANGO_ENABLE_DISPATCH)
+    void idct2_avx2                 (u8* dest, const BlockType* data, const u16* qt0, const u16* qt1);
+    void process_YCbCr_8x8_avx2     (u8* dest, int stride, const BlockType* data, ProcessState* state, int width, int height);
+    void process_YCbCr_8x16_avx2    (u8* dest, int stride, const BlockType* data, ProcessState* state, int width, int height);
+    void process_YCbCr_16x8_avx2    (u8* dest, int stride, const BlockType* data, ProcessState* state, int width, int height);
+    void process_YCbCr_16x16_avx2   (u8* dest, int stride, const BlockType* data, ProcessState* state, int width, int height);
+#endif
+
+#if defined(JPEG_ENABLE_NEON)
+    void idct_neon                  (u8* dest, const BlockType* data, const u16* qt);
+    void process_YCbCr_8x8_neon     (u8* dest, int stride, const BlockType* data, ProcessState* state, int width, int height);
+    void process_YCbCr_8x16_neon    (u8* dest, int stride, const BlockType* data, ProcessState* state, int width, int height);
+    void process_YCbCr_16x8_neon    (u8* dest, int stride, const BlockType* data, ProcessState* state, int width, int height);
+    void process_YCbCr_16x16_neon   (u8* dest, int stride, const BlockType* data, ProcessState* state, int width, int height);
+    void convert_YCbCr_neon         (u8* dest, const u8* y, const u8* cb, const u8* cr);
+    void convert_YCbCr_RGBA_neon    (u8* dest, const u8* y, const u8* cb, const u8* cr);
+    void convert_YCbCr_RGB565_neon  (u8* dest, const u8* y, const u8* cb, const u8* cr);
+    void convert_YCbCr_RGBA32F_neon (u8* dest, const u8* y, const u8* cb, const u8* cr);
+    void convert_CMYK_neon          (u8* dest, const u8* y, const u8* cb, const u8* cr, const u8* k);
+    void convert_YCbCr_12_neon      (u8* dest, const u16* y, const u16* cb, const u16* cr);
+#endif
+
+    // Quantized coefficients in the encoder layout: the blocks are in MCU order with the luminance
+    // blocks in raster order followed by one block for each chrominance component. The coefficients
+    // of each block are in zigzag order.
+    struct CoefficientImage
+    {
+        int width;
+        int height;
+        int components; // 1 or 3
+        int hsf; // luminance sampling factors
+        int vsf;
+        u8 compid[3];
+        u8 qtable[2][64]; // luminance and chrominance quantization tables in zigzag order
+        const BlockType* blocks;
+    };
+
+    // Baseline sequential encoder which is given the image in bands from top to bottom. The
+    // bands are encoded as they arrive so the image is never in memory at once; the huffman
+    // tables are the typical tables since the image can not be seen in advance.
+    class RowEncoder : private mango::NonCopyable
+    {
+    protected:
+        struct State;
+        State* m_state;
+
+    public:
+        RowEncoder(Stream& stream, int width, int height, const Format& format, const mango::ImageEncodeOptions& options);
+        ~RowEncoder();
+
+        // the bands have to be multiples of this height, except the last one
+        int getBandHeight() const;
+        void encode(const Surface& band);
+    };
+
+    bool Probe(ImageProbe& probe, Memory memory);
+    void EncodeImage(Stream& stream, const Surface& surface, const mango::ImageEncodeOptions& options);
+    void EncodeCoefficients(Stream& stream, const CoefficientImage& image, const std::vector<Memory>& markers, bool progressive);
 
 } // namespace jpeg
@@ -62,13 +62,19 @@ namespace
         if (buffer.ptr >= buffer.end)
             return 0;
 
-        u8 value = *buffer.ptr++;
+        u8 value = *buffer.ptr;
         if (value == 0xff)
         {
+            // a marker terminates the entropy coded segment; the decoder is fed with zeros
+            // and the marker is left in the stream for the restart logic
+            if (buffer.ptr + 1 >= buffer.end || buffer.ptr[1])
+                return 0;
+
             // skip stuff byte (0x00)
             ++buffer.ptr;
         }
 
+        ++buffer.ptr;
         return value;
     }
 
@@ -80,7 +86,16 @@ namespace
             {
                 int data = get_byte(buffer);
                 e.c = (e.c << 8) | data;
-                e.ct += 8;
+
+                if ((e.ct += 8) < 0)
+                {
+                    // need more initial bytes
+                    if (++e.ct == 0)
+                    {
+                        // got 2 initial bytes -> re-init A and exit loop
+                        e.a = 0x8000L; // => e.a = 0x10000L after loop exit
+                    }
+                }
             }
 
             e.a <<= 1;
@@ -306,9 +321,13 @@ namespace jpeg
                 while (arith_decode(arithmetic, buffer, st + 1) == 0)
                 {
                     st += 3;
-                    ++k;
+                    if (++k > end)
+                        break;
                 }
 
+                if (k > end)
+                    break; // corrupted data: spectral overflow
+
                 sign = arith_decode(arithmetic, buffer, arithmetic.fixed_bin);
                 st += 2;
 
@@ -461,7 +480,8 @@ namespace jpeg
             while (arith_decode(arithmetic, buffer, st + 1) == 0)
             {
                 st += 3;
-                ++k;
+                if (++k > end)
+                    return; // corrupted data: spectral overflow
             }
             
             // Figure F.21: Decoding nonzero value v
@@ -537,10 +557,10 @@ namespace jpeg
                     break; // EOB flag
             }
 
-            BlockType* coef = output + zigzagTable[k];
-            
             for (;;)
             {
+                BlockType* coef = output + zigzagTable[k];
+
                 if (*coef)
                 {
                     // previously nonzero coef
@@ -566,7 +586,8 @@ namespace jpeg
                 }
                 
                 st += 3;
-                ++k;
+                if (++k > end)
+                    return; // corrupted data: spectral overflow
             }
         }
     }
@@ -587,14 +608,12 @@ namespace jpeg
     {
     }
 
-    void Arithmetic::restart(jpegBuffer& buffer)
+    void Arithmetic::restart()
     {
-        u8 v0 = get_byte(buffer);
-        u8 v1 = get_byte(buffer);
-
-        c = (v0 << 8) | v1;
-        a = 0x10000;
-        ct = 0;
+        // the first two bytes are read by the decoder; the restart doesn't consume input
+        c = 0;
+        a = 0;
+        ct = -16;
 
         std::memset(dc_stats, 0, JPEG_NUM_ARITH_TBLS * JPEG_DC_STAT_BINS);
         std::memset(ac_stats, 0, JPEG_NUM_ARITH_TBLS * JPEG_AC_STAT_BINS);
@@ -621,7 +640,7 @@ namespace jpeg
     {
     }
     
-    void Arithmetic::restart(jpegBuffer& buffer)
+    void Arithmetic::restart()
     {
     }
 } // namespace jpeg
@@ -3,6 +3,12 @@
     Copyright (C) 2012-2018 Twilight Finland 3D Oy Ltd. All rights reserved.
 */
 #include <cmath>
+#include <algorithm>
+#include <memory>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <functional>
 #include <mango/core/endian.hpp>
 #include <mango/core/cpuinfo.hpp>
 #include <mango/core/thread.hpp>
@@ -13,7 +19,7 @@ namespace jpeg
 
     using namespace mango;
 
-#if defined(JPEG_ENABLE_SSE2)
+#if defined(JPEG_ENABLE_SSE2) || defined(JPEG_ENABLE_NEON)
 
     // The zigzag table is in 'natural' order ; each entry indicates
     // where the sample is located at in the original 8x8 block.
@@ -185,7 +191,7 @@ namespace jpeg
     {
         data = 0;
         remain = 0;
-        nextFF = reinterpret_cast<u8*>(std::memchr(ptr, 0xff, end - ptr));
+        nextFF = ptr < end ? reinterpret_cast<u8*>(std::memchr(ptr, 0xff, end - ptr)) : nullptr;
     }
 
     DataType jpegBuffer::bytes(int n)
@@ -221,6 +227,123 @@ namespace jpeg
         return temp;
     }
 
+    // ----------------------------------------------------------------------------
+    // ProgressiveGraph
+    // ----------------------------------------------------------------------------
+
+    // The progressive scans are split into segments at the restart markers. Each segment
+    // is a task which depends on the segments of the earlier scans decoding the same
+    // component in the same MCU rows. A task is enqueued as soon as its dependencies are
+    // complete so the scans of different components and the refinement passes over
+    // different rows are decoded concurrently while the parser is looking for the next
+    // scan. The MCU rows are processed in bands which depend on the last segments of every
+    // component covering the band.
+
+    struct ProgressiveTask
+    {
+        std::function<void()> func;
+        std::atomic<int> pending { 0 };
+        std::vector<ProgressiveTask*> dependents;
+        bool complete = false;
+    };
+
+    struct ProgressiveSegment
+    {
+        int y0; // first MCU row
+        int y1; // last MCU row
+        ProgressiveTask* task;
+    };
+
+    struct ProgressiveGraph
+    {
+        ConcurrentQueue queue;
+        std::mutex mutex;
+        std::deque<ProgressiveTask> tasks;
+
+        // scan data referenced by the tasks
+        std::deque<HuffTable> tables;
+        std::deque<std::vector<u8*>> intervals;
+
+        // segments of the latest scan of each component
+        std::vector<ProgressiveSegment> last[JPEG_MAX_COMPS_IN_SCAN];
+
+        ProgressiveGraph()
+            : queue("jpeg.progressive", Priority::HIGH)
+        {
+        }
+
+        ~ProgressiveGraph()
+        {
+            queue.wait();
+        }
+
+        void depends(std::vector<ProgressiveTask*>& dependencies, int component, int y0, int y1) const
+        {
+            for (const ProgressiveSegment& segment : last[component])
+            {
+                if (segment.y0 <= y1 && segment.y1 >= y0)
+                {
+                    auto i = std::find(dependencies.begin(), dependencies.end(), segment.task);
+                    if (i == dependencies.end())
+                    {
+                        dependencies.push_back(segment.task);
+                    }
+                }
+            }
+        }
+
+        ProgressiveTask* add(std::function<void()>&& func, const std::vector<ProgressiveTask*>& dependencies)
+        {
+            tasks.emplace_back();
+            ProgressiveTask* task = &tasks.back();
+            task->func = std::move(func);
+            task->pending = 1; // hold the task until the dependencies are registered
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+
+                for (ProgressiveTask* dependency : dependencies)
+                {
+                    if (!dependency->complete)
+                    {
+                        dependency->dependents.push_back(task);
+                        ++task->pending;
+                    }
+                }
+            }
+
+            release(task);
+            return task;
+        }
+
+        void release(ProgressiveTask* task)
+        {
+            if (!--task->pending)
+            {
+                queue.enqueue([this, task] {
+                    task->func();
+                    complete(task);
+                });
+            }
+        }
+
+        void complete(ProgressiveTask* task)
+        {
+            std::vector<ProgressiveTask*> dependents;
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                task->complete = true;
+                dependents.swap(task->dependents);
+            }
+
+            for (ProgressiveTask* dependent : dependents)
+            {
+                release(dependent);
+            }
+        }
+    };
+
     // ----------------------------------------------------------------------------
     // Parser
     // ----------------------------------------------------------------------------
@@ -228,9 +351,14 @@ namespace jpeg
     Parser::Parser(Memory memory)
         : quantTableVector(64 * JPEG_MAX_COMPS_IN_SCAN)
         , blockVector(nullptr)
+        , progressiveGraph(nullptr)
+        , m_band(nullptr)
+        , m_eoi(false)
+        , m_corrupt(false)
     {
         // configure default implementation
         decodeState.zigzagTable = g_zigzag_table_variant;
+        decodeState.corrupt = &m_corrupt;
         processState.idct = idct;
 
         processState.process_Y           = process_Y;
@@ -240,6 +368,18 @@ namespace jpeg
         processState.process_YCbCr_8x16  = process_YCbCr_8x16;
         processState.process_YCbCr_16x8  = process_YCbCr_16x8;
         processState.process_YCbCr_16x16 = process_YCbCr_16x16;
+        processState.fancy = nullptr;
+
+        processState.convert_YCbCr = convert_YCbCr;
+        processState.convert_CMYK  = convert_CMYK;
+
+        processState.idct12 = idct12;
+        processState.convert_YCbCr_12 = convert_YCbCr_12;
+
+        processState.scale = 8;
+        processState.xblocks = 1;
+        processState.bytes_per_pixel = 4;
+        processState.rgba = false;
 
         restartInterval = 0;
         restartCounter = 0;
@@ -261,11 +401,46 @@ namespace jpeg
             processState.process_YCbCr_8x16  = process_YCbCr_8x16_sse2;
             processState.process_YCbCr_16x8  = process_YCbCr_16x8_sse2;
             processState.process_YCbCr_16x16 = process_YCbCr_16x16_sse2;
+
+            processState.convert_YCbCr = convert_YCbCr_sse2;
+            processState.convert_CMYK  = convert_CMYK_sse2;
+
+            processState.idct12 = idct12_simd;
+            processState.convert_YCbCr_12 = convert_YCbCr_12_sse2;
+
+#if defined(MANGO_ENABLE_DISPATCH)
+            if (cpuFlags & CPU_AVX2)
+            {
+                processState.process_YCbCr_8x8   = process_YCbCr_8x8_avx2;
+                processState.process_YCbCr_8x16  = process_YCbCr_8x16_avx2;
+                processState.process_YCbCr_16x8  = process_YCbCr_16x8_avx2;
+                processState.process_YCbCr_16x16 = process_YCbCr_16x16_avx2;
+            }
+#endif
         }
 #endif
 
+#if defined(JPEG_ENABLE_NEON)
+        // NEON is part of the compile-time baseline (mandatory on AArch64)
+        decodeState.zigzagTable = g_zigzag_table_standard;
+        processState.idct = idct_neon;
+
+        processState.process_YCbCr_8x8   = process_YCbCr_8x8_neon;
+        processState.process_YCbCr_8x16  = process_YCbCr_8x16_neon;
+        processState.process_YCbCr_16x8  = process_YCbCr_16x8_neon;
+        processState.process_YCbCr_16x16 = process_YCbCr_16x16_neon;
+
+        processState.convert_YCbCr = convert_YCbCr_neon;
+        processState.convert_CMYK  = convert_CMYK_neon;
+
+        processState.idct12 = idct12_simd;
+        processState.convert_YCbCr_12 = convert_YCbCr_12_neon;
+#endif
+
         MANGO_UNREFERENCED_PARAMETER(cpuFlags);
 
+        processState.transposed = decodeState.zigzagTable == g_zigzag_table_variant;
+
         for (int i = 0; i < JPEG_MAX_COMPS_IN_SCAN; ++i)
         {
             quantTable[i].table = &quantTableVector[i * 64];
@@ -502,6 +677,18 @@ namespace jpeg
         }
     }
 
+    // The 12 bit DCT images are decoded into 16 bit per channel formats; the lossless
+    // images are scaled to 8 bits.
+    static Format getFormat(int comps, int precision, bool lossless)
+    {
+        if (precision == 12 && !lossless)
+        {
+            return comps > 1 ? Format(FORMAT_R16G16B16A16) : Format(FORMAT_L16);
+        }
+
+        return comps > 1 ? Format(FORMAT_B8G8R8A8) : Format(FORMAT_L8);
+    }
+
     void Parser::processSOF(u8* p, u16 marker)
     {
         jpegPrint("[ SOF%d ]\n", int(marker - MARKER_SOF0));
@@ -632,6 +819,8 @@ namespace jpeg
         xblock = 8 * Hmax;
         yblock = 8 * Vmax;
 
+        processState.xblocks = Hmax;
+
         jpegPrint("  Blocks per MCU: %d\n", blocks_in_mcu);
         jpegPrint("  MCU size: %d x %d\n", xblock, yblock);
 
@@ -688,6 +877,19 @@ namespace jpeg
                     {
                         processState.process = processState.process_YCbCr_16x16;
                     }
+
+#if defined(JPEG_ENABLE_FANCY_UPSAMPLING)
+                    // triangle filtered chroma for the horizontally subsampled layouts
+                    if (xblock == 16 && yblock == 8)
+                    {
+                        processState.fancy = process_YCbCr_16x8_fancy;
+                    }
+
+                    if (xblock == 16 && yblock == 16)
+                    {
+                        processState.fancy = process_YCbCr_16x16_fancy;
+                    }
+#endif
                 }
                 break;
 
@@ -697,12 +899,35 @@ namespace jpeg
                 break;
         }
 
+        if (precision == 12)
+        {
+            processState.fancy = nullptr;
+
+            switch (comps)
+            {
+                case 1:
+                    processState.process = process_Y_12;
+                    processState.clipped = process_Y_12;
+                    break;
+
+                case 3:
+                    processState.process = process_YCbCr_12;
+                    processState.clipped = process_YCbCr_12;
+                    break;
+
+                case 4:
+                    processState.process = process_CMYK_12;
+                    processState.clipped = process_CMYK_12;
+                    break;
+            }
+        }
+
         // configure header
         header.width = xsize;
         header.height = ysize;
         header.xblock = xblock;
         header.yblock = yblock;
-        header.format = comps > 1 ? Format(FORMAT_B8G8R8A8) : Format(FORMAT_L8);
+        header.format = getFormat(comps, precision, is_lossless);
 
         MANGO_UNREFERENCED_PARAMETER(length);
     }
@@ -806,7 +1031,7 @@ namespace jpeg
             // restart
             decodeState.buffer.restart();
 
-            arithmetic.restart(decodeState.buffer);
+            arithmetic.restart();
 
             if (is_lossless)
             {
@@ -840,6 +1065,13 @@ namespace jpeg
                         decodeState.decode = arith_decode_ac_refine;
                     }
                 }
+
+                if (progressiveGraph)
+                {
+                    // the scan is decoded in tasks; continue parsing after it
+                    return decodeProgressiveMT(p, end);
+                }
+
                 decodeProgressive();
             }
             else
@@ -893,6 +1125,13 @@ namespace jpeg
                         decodeState.decode = huff_decode_ac_refine;
                     }
                 }
+
+                if (progressiveGraph)
+                {
+                    // the scan is decoded in tasks; continue parsing after it
+                    return decodeProgressiveMT(p, end);
+                }
+
                 decodeProgressive();
             }
             else
@@ -1100,6 +1339,12 @@ namespace jpeg
 
         Timer timer;
 
+        if (decode)
+        {
+            m_eoi = false;
+            m_corrupt = false;
+        }
+
         for (; p < end;)
         {
             u16 marker = uload16be(p);
@@ -1115,6 +1360,7 @@ namespace jpeg
 
                 case MARKER_EOI:
                     processEOI();
+                    m_eoi = true;
                     p = end; // terminate parsing
                     break;
 
@@ -1155,6 +1401,10 @@ namespace jpeg
 
                 case MARKER_COM:
                     processCOM(p);
+                    if (!decode)
+                    {
+                        marker_memory.emplace_back(p - 2, uload16be(p) + 2);
+                    }
                     p = stepMarker(p);
                     break;
 
@@ -1185,6 +1435,10 @@ namespace jpeg
                 case MARKER_APP14:
                 case MARKER_APP15:
                     processAPP(p, marker);
+                    if (!decode)
+                    {
+                        marker_memory.emplace_back(p - 2, uload16be(p) + 2);
+                    }
                     p = stepMarker(p);
                     break;
 
@@ -1253,7 +1507,8 @@ namespace jpeg
 
                 default:
                     jpegPrint("[ 0x%x ]\n", marker);
-                    p = seekMarker(p, end);
+                    // the second byte can be the start of the next marker
+                    p = seekMarker(p - 1, end);
                     break;
             }
 
@@ -1279,17 +1534,23 @@ namespace jpeg
 
     void Parser::restart()
     {
+        restart(decodeState);
+    }
+
+    void Parser::restart(DecodeState& state) const
+    {
+        // the buffer must point to the first byte after the restart marker
         if (is_arithmetic)
         {
-            decodeState.arithmetic.restart(decodeState.buffer);
+            state.arithmetic.restart();
         }
         else
         {
-            decodeState.huffman.restart();
+            state.huffman.restart();
         }
 
         // restart
-        decodeState.buffer.restart();
+        state.buffer.restart();
     }
 
     bool Parser::handleRestart()
@@ -1298,133 +1559,430 @@ namespace jpeg
         {
             restartCounter = restartInterval;
 
-            if (isRestartMarker(decodeState.buffer.ptr))
+            if (is_arithmetic)
+            {
+                // the arithmetic decoder does not always consume the whole interval
+                decodeState.buffer.ptr = seekMarker(decodeState.buffer.ptr, decodeState.buffer.end);
+            }
+
+            const u8* p = decodeState.buffer.ptr;
+
+            if (isRestartMarker(p))
             {
-                restart();
                 decodeState.buffer.ptr += 2;
+                restart();
                 return true;
             }
+
+            // the interval has ended before the data; the last interval ends at the EOI marker
+            if (p + 2 <= decodeState.buffer.end && !(p[0] == 0xff && p[1]))
+            {
+                m_corrupt = true;
+            }
         }
 
         return false;
     }
 
-    Status Parser::decode(Surface& target)
+    // The decoding is lenient: the truncated and corrupted scans are decoded as far as they go
+    // but the status tells that the image is not complete.
+    void Parser::verifyScans(Status& status) const
     {
-        Status status;
+        if (!m_eoi)
+        {
+            status.success = false;
+            status.info = "Truncated image.";
+        }
+        else if (m_corrupt)
+        {
+            status.success = false;
+            status.info = "Corrupted image.";
+        }
+    }
 
-        status.success = true;
-        status.enableDirectDecode = true;
+    bool Parser::setOutputFormat(const Format& format)
+    {
+        if (format == header.format)
+        {
+            // configured in processSOF()
+            return true;
+        }
 
-        m_info = "";
+        const int comps = processState.frames;
 
-        if (!scan_memory.address)
+        if (is_lossless || precision != 8 || (comps != 1 && comps != 3))
         {
-            status.success = false;
-            return status;
+            return false;
         }
 
-        // allocate blocks
-        int count = mcus * blocks_in_mcu * 64;
-        blockVector = reinterpret_cast<BlockType*>(aligned_malloc(count * sizeof(BlockType)));
+        u64 cpuFlags = getCPUFlags();
+        decltype(processState.convert_YCbCr) convert = nullptr;
 
-        // target surface size has to match (clipping isn't yet supported)
-        if (target.width != xsize || target.height != ysize)
+        if (format == FORMAT_B8G8R8A8)
         {
-            status.enableDirectDecode = false;
+            // grayscale into color
+            convert = processState.convert_YCbCr;
         }
-
-        // pixel format has to match (we don't yet support convert-on-write)
-        if (target.format != header.format)
+        else if (format == FORMAT_R8G8B8A8)
         {
-            status.enableDirectDecode = false;
+            convert = convert_YCbCr_RGBA;
+#if defined(JPEG_ENABLE_SSE2)
+            if (cpuFlags & CPU_SSE2) convert = convert_YCbCr_RGBA_sse2;
+#endif
+#if defined(JPEG_ENABLE_NEON)
+            convert = convert_YCbCr_RGBA_neon;
+#endif
+        }
+        else if (format == FORMAT_B5G6R5)
+        {
+            convert = convert_YCbCr_RGB565;
+#if defined(JPEG_ENABLE_SSE2)
+            if (cpuFlags & CPU_SSE2) convert = convert_YCbCr_RGB565_sse2;
+#endif
+#if defined(JPEG_ENABLE_NEON)
+            convert = convert_YCbCr_RGB565_neon;
+#endif
+        }
+        else if (format == FORMAT_RGBA32F)
+        {
+            convert = convert_YCbCr_RGBA32F;
+#if defined(JPEG_ENABLE_SSE2)
+            if (cpuFlags & CPU_SSE2) convert = convert_YCbCr_RGBA32F_sse2;
+#endif
+#if defined(JPEG_ENABLE_NEON)
+            convert = convert_YCbCr_RGBA32F_neon;
+#endif
         }
 
-        if (status.enableDirectDecode)
+        MANGO_UNREFERENCED_PARAMETER(cpuFlags);
+
+        if (!convert)
         {
-            m_surface = &target;
+            return false;
+        }
 
-            parse(scan_memory, true);
+        processState.convert_YCbCr = convert;
+        processState.bytes_per_pixel = format.bytes();
+        processState.fancy = nullptr;
 
-            if (is_progressive)
-			{
-	            finishProgressive();
-			}
+        if (comps == 1)
+        {
+            processState.process = process_Y_color;
+            processState.clipped = process_Y_color;
         }
         else
         {
-            Bitmap temp(width, height, header.format);
-            m_surface = &temp;
-
-            parse(scan_memory, true);
+            if (format == FORMAT_R8G8B8A8)
+            {
+                // the layout kernels swap red and blue
+                processState.rgba = true;
+            }
+            else
+            {
+                // the layout kernels only write 32 bit pixels
+                processState.process = processState.process_YCbCr;
+                processState.clipped = processState.process_YCbCr;
+            }
 
-            if (is_progressive)
-			{
-	            finishProgressive();
-			}
+#if defined(JPEG_ENABLE_FANCY_UPSAMPLING)
+            // the fancy kernels write through the color conversion into any format
+            if (blocks_in_mcu <= 6)
+            {
+                if (xblock == 16 && yblock == 8)
+                {
+                    processState.fancy = process_YCbCr_16x8_fancy;
+                }
 
-            target.blit(0, 0, temp);
+                if (xblock == 16 && yblock == 16)
+                {
+                    processState.fancy = process_YCbCr_16x16_fancy;
+                }
+            }
+#endif
         }
 
-        status.info = m_info;
-
-        return status;
+        return true;
     }
 
-    void Parser::decodeLossless()
+    void Parser::decodeImage(Surface& target)
     {
-        int predictor = decodeState.spectralStart;
-        int pointTransform = decodeState.successiveLow;
+        // allocate blocks
+        aligned_free(blockVector);
 
-        auto decodeFunction = huff_decode_mcu_lossless;
-        int* previousDC = decodeState.huffman.last_dc_value;
+        int count = mcus * blocks_in_mcu * 64;
+        blockVector = reinterpret_cast<BlockType*>(aligned_malloc(count * sizeof(BlockType)));
 
-        if (is_arithmetic)
+#ifdef JPEG_ENABLE_THREAD
+        std::unique_ptr<ProgressiveGraph> graph;
+
+        if (is_progressive && ThreadPool::getInstanceSize() > 1)
         {
-#ifdef MANGO_ENABLE_LICENSE_BSD
-            decodeFunction = arith_decode_mcu_lossless;
-            previousDC = decodeState.arithmetic.last_dc_value;
-#else
-            // We don't have a license for arithmetic decoder
-            return;
-#endif
+            graph.reset(new ProgressiveGraph());
+            progressiveGraph = graph.get();
         }
+#endif
 
-        const int width = m_surface->width;
-        const int height = m_surface->height;
-        const int xlast = width - 1;
-        const int components = decodeState.comps_in_scan;
-
-        int initPredictor = 1 << (precision - pointTransform - 1);
+        m_surface = &target;
 
-        std::vector<int> scanLineCache[JPEG_MAX_BLOCKS_IN_MCU];
+        parse(scan_memory, true);
 
-        for (int i = 0; i < components; ++i)
+        if (is_progressive)
         {
-            scanLineCache[i] = std::vector<int>(width + 1, 0);
+            finishProgressive();
         }
 
-        for (int y = 0; y < height; ++y)
+        progressiveGraph = nullptr;
+    }
+
+    bool Parser::decodeCoefficients()
+    {
+        if (!scan_memory.address || is_lossless)
         {
-            for (int x = 0; x < width; ++x)
-            {
-                BlockType data[JPEG_MAX_BLOCKS_IN_MCU];
+            return false;
+        }
 
-                decodeFunction(data, &decodeState);
-                bool restarted = handleRestart();
+        // allocate blocks; the progressive scans don't write the blocks outside of the components
+        aligned_free(blockVector);
 
-                for (int currentComponent = 0; currentComponent < components; ++currentComponent)
-                {
-                    // Predictors
-                    int* cache = scanLineCache[currentComponent].data();
-                    int Ra = data[currentComponent];
-                    int Rb = cache[x + 1];
-                    int Rc = cache[x + 0];
+        size_t count = size_t(mcus) * blocks_in_mcu * 64;
+        blockVector = reinterpret_cast<BlockType*>(aligned_malloc(count * sizeof(BlockType)));
+        std::memset(blockVector, 0, count * sizeof(BlockType));
 
-                    int Px;
+#ifdef JPEG_ENABLE_THREAD
+        std::unique_ptr<ProgressiveGraph> graph;
 
-                    // NOTE: need more test files to make this more conformant
-                    // NOTE: color sub-sampling is not supported (need test files)
+        if (is_progressive && ThreadPool::getInstanceSize() > 1)
+        {
+            graph.reset(new ProgressiveGraph());
+            progressiveGraph = graph.get();
+        }
+#endif
+
+        // no target surface: the scans are only entropy decoded
+        m_surface = nullptr;
+
+        parse(scan_memory, true);
+
+        if (progressiveGraph)
+        {
+            progressiveGraph->queue.wait();
+            progressiveGraph = nullptr;
+        }
+
+        return true;
+    }
+
+    Status Parser::decode(Surface& target)
+    {
+        Status status;
+
+        status.success = true;
+        status.enableDirectDecode = true;
+
+        m_info = "";
+
+        if (!scan_memory.address)
+        {
+            status.success = false;
+            return status;
+        }
+
+        // target surface size has to match (clipping isn't yet supported)
+        if (target.width != xsize || target.height != ysize)
+        {
+            status.enableDirectDecode = false;
+        }
+
+        // pixel format has to be one the color conversion can write
+        if (status.enableDirectDecode && !setOutputFormat(target.format))
+        {
+            status.enableDirectDecode = false;
+        }
+
+        if (status.enableDirectDecode)
+        {
+            decodeImage(target);
+        }
+        else
+        {
+            Bitmap temp(width, height, header.format);
+            decodeImage(temp);
+            target.blit(0, 0, temp);
+        }
+
+        status.info = m_info;
+        verifyScans(status);
+
+        return status;
+    }
+
+    Status Parser::decodeYUV(const YUVPlanes& planes)
+    {
+        Status status;
+
+        status.success = false;
+        status.enableDirectDecode = true;
+
+        m_info = "";
+
+        const int comps = processState.frames;
+
+        if (!scan_memory.address || is_lossless || precision != 8 || (comps != 1 && comps != 3))
+        {
+            return status;
+        }
+
+        processState.planar.y = planes.y;
+        processState.planar.u = planes.u;
+        processState.planar.ustride = planes.ustride;
+
+        if (planes.layout == YUVPlanes::NV12)
+        {
+            processState.planar.v = planes.u + 1;
+            processState.planar.vstride = planes.ustride;
+            processState.planar.step = 2;
+        }
+        else
+        {
+            processState.planar.v = planes.v;
+            processState.planar.vstride = planes.vstride;
+            processState.planar.step = 1;
+        }
+
+        processState.process = process_YUV420;
+        processState.clipped = process_YUV420;
+        processState.fancy = nullptr;
+
+        // the luma plane is the destination surface
+        Surface luma(xsize, ysize, FORMAT_L8, planes.ystride, planes.y);
+        decodeImage(luma);
+
+        status.success = true;
+        status.info = m_info;
+
+        return status;
+    }
+
+    Status Parser::decodeBands(const BandFunc& func, const Format& format, int scale)
+    {
+        Status status;
+
+        status.success = false;
+        status.enableDirectDecode = false;
+
+        m_info = "";
+
+        if (!scan_memory.address || is_lossless || precision != 8 || !setOutputFormat(format))
+        {
+            status.info = "Unsupported image.";
+            return status;
+        }
+
+        processState.scale = scale;
+        processState.bytes_per_pixel = format.bytes();
+
+        // the stripes do not have the neighbouring MCU rows for the fancy upsampling
+        processState.fancy = nullptr;
+
+        if (scale < 8)
+        {
+            processState.process = process_scaled;
+            processState.clipped = process_scaled;
+        }
+
+        // one stripe of pixels; the stripes overlap with the entropy decoding of the next one
+        const int stripe = std::max(1, std::min(ThreadPool::getInstanceSize(), 8));
+
+        Bitmap band((xsize * scale + 7) / 8, stripe * yblock * scale / 8, format);
+        m_surface = &band;
+
+        if (is_progressive)
+        {
+            if (!decodeCoefficients())
+            {
+                return status;
+            }
+
+            m_surface = &band;
+            m_band = &func;
+
+            const size_t mcu_data_size = blocks_in_mcu * 64;
+
+            for (int y = 0; y < ymcu; y += stripe)
+            {
+                processStripe(blockVector + y * xmcu * mcu_data_size, y, std::min(y + stripe, ymcu));
+            }
+        }
+        else
+        {
+            m_band = &func;
+            parse(scan_memory, true);
+        }
+
+        m_band = nullptr;
+        m_surface = nullptr;
+
+        status.success = true;
+        status.info = m_info;
+        verifyScans(status);
+
+        return status;
+    }
+
+    void Parser::decodeLossless()
+    {
+        int predictor = decodeState.spectralStart;
+        int pointTransform = decodeState.successiveLow;
+
+        auto decodeFunction = huff_decode_mcu_lossless;
+        int* previousDC = decodeState.huffman.last_dc_value;
+
+        if (is_arithmetic)
+        {
+#ifdef MANGO_ENABLE_LICENSE_BSD
+            decodeFunction = arith_decode_mcu_lossless;
+            previousDC = decodeState.arithmetic.last_dc_value;
+#else
+            // We don't have a license for arithmetic decoder
+            return;
+#endif
+        }
+
+        const int width = m_surface->width;
+        const int height = m_surface->height;
+        const int xlast = width - 1;
+        const int components = decodeState.comps_in_scan;
+
+        int initPredictor = 1 << (precision - pointTransform - 1);
+
+        std::vector<int> scanLineCache[JPEG_MAX_BLOCKS_IN_MCU];
+
+        for (int i = 0; i < components; ++i)
+        {
+            scanLineCache[i] = std::vector<int>(width + 1, 0);
+        }
+
+        for (int y = 0; y < height; ++y)
+        {
+            for (int x = 0; x < width; ++x)
+            {
+                BlockType data[JPEG_MAX_BLOCKS_IN_MCU];
+
+                decodeFunction(data, &decodeState);
+                bool restarted = handleRestart();
+
+                for (int currentComponent = 0; currentComponent < components; ++currentComponent)
+                {
+                    // Predictors
+                    int* cache = scanLineCache[currentComponent].data();
+                    int Ra = data[currentComponent];
+                    int Rb = cache[x + 1];
+                    int Rc = cache[x + 0];
+
+                    int Px;
+
+                    // NOTE: need more test files to make this more conformant
+                    // NOTE: color sub-sampling is not supported (need test files)
 
                     if ((x == 0 && y == 0) || restarted)
                         Px = initPredictor;
@@ -1481,9 +2039,35 @@ namespace jpeg
 #else
         const int count = 1;
 #endif
-        if (count > 1)
+        if (m_band)
+        {
+            decodeSequentialBands();
+        }
+        else if (!m_surface)
+        {
+            decodeSequentialCoefficients();
+        }
+        else if (processState.fancy)
+        {
+            // the fancy upsampling reads the chroma of the neighbouring MCUs
+            if (count > 1)
+            {
+                // the whole scan is decoded into coefficients and transformed like in the progressive mode
+                decodeSequentialCoefficients();
+                finishProgressive();
+            }
+            else
+            {
+                decodeSequentialFancy();
+            }
+        }
+        else if (count > 1)
         {
-            decodeSequentialMT();
+            // without restart markers the entropy decoding is serial unless it can be speculated
+            if (restartInterval || !decodeSequentialSpeculative())
+            {
+                decodeSequentialMT();
+            }
         }
         else
         {
@@ -1533,6 +2117,33 @@ namespace jpeg
         }
     }
 
+    // The MCU rows are decoded into two rows of coefficients when the fancy upsampling asks
+    // for them: the row being transformed and the one below it.
+    void Parser::decodeSequentialFancy()
+    {
+        const size_t row_data_size = size_t(xmcu) * blocks_in_mcu * 64;
+        const int mcu_data_size = blocks_in_mcu * 64;
+
+        AlignedVector<BlockType> coefficients(row_data_size * 2);
+        int decoded = 0;
+
+        processFancy(0, ymcu, [&] (int y) -> const BlockType* {
+            for ( ; decoded <= y; ++decoded)
+            {
+                BlockType* data = coefficients.data() + (decoded & 1) * row_data_size;
+
+                for (int x = 0; x < xmcu; ++x)
+                {
+                    decodeState.decode(data, &decodeState);
+                    handleRestart();
+                    data += mcu_data_size;
+                }
+            }
+
+            return coefficients.data() + (y & 1) * row_data_size;
+        });
+    }
+
     void Parser::decodeSequentialMT()
     {
         const int stride = m_surface->stride;
@@ -1612,6 +2223,7 @@ namespace jpeg
                     BlockType data[640]; // TODO: alignment
                     DecodeState state = decodeState;
                     state.buffer.ptr = p;
+                    restart(state);
 
                     const int left = std::min(restartInterval, mcus - i);
 
@@ -1658,99 +2270,696 @@ namespace jpeg
         queue.wait();
     }
 
-    void Parser::decodeProgressive()
+    void Parser::decodeSequentialCoefficients()
     {
-        const bool dc_scan = (decodeState.spectralStart == 0);
-        BlockType* data = blockVector;
+        // the coefficients are stored in blockVector like in the progressive mode
+        const int mcu_data_size = blocks_in_mcu * 64;
 
-        if (dc_scan)
+        // the restart intervals are decoded in parallel
+        if (!restartInterval || ThreadPool::getInstanceSize() < 2)
         {
-            if (decodeState.comps_in_scan == 1 && decodeState.blocks > 1)
+            BlockType* data = blockVector;
+
+            for (int i = 0; i < mcus; ++i)
             {
-                // HACK: process 8x8 blocks in more expensive ac scanner code below
-                // NOTE: we propably should do this only when 8x8 block count is not multiple of MCU block size
-                decodeState.block[0].offset = 0;
-                decodeState.blocks = 1;
+                decodeState.decode(data, &decodeState);
+                handleRestart();
+                data += mcu_data_size;
             }
-            else
-            {
-                for (int i = 0; i < mcus; ++i)
-                {
-                    decodeState.decode(data, &decodeState);
-                    handleRestart();
-                    data += blocks_in_mcu * 64;
-                }
 
-                return;
-            }
+            return;
         }
 
-        const int hsf = u32_log2(scanFrame->Hsf);
-        const int vsf = u32_log2(scanFrame->Vsf);
-        const int hsize = (Hmax >> hsf) * 8;
-        const int vsize = (Vmax >> vsf) * 8;
-
-        jpegPrint("    hf: %i x %i, log2: %i x %i\n", 1 << hsf, 1 << vsf, hsf, vsf);
-        jpegPrint("    bs: %i x %i  scanSize: %d\n", hsize, vsize, decodeState.blocks);
+        ConcurrentQueue queue("jpeg.coefficients", Priority::HIGH);
 
-        const int scan_offset = scanFrame->offset;
+        u8* p = decodeState.buffer.ptr;
 
-        const int xs = ((xsize + hsize - 1) / hsize);
-        const int ys = ((ysize + vsize - 1) / vsize);
+        for (int i = 0; i < mcus; i += restartInterval)
+        {
+            queue.enqueue([=] {
+                DecodeState state = decodeState;
+                state.buffer.ptr = p;
+                restart(state);
 
-        jpegPrint("    blocks: %d x %d (%d x %d)\n", xs, ys, xs * hsize, ys * vsize);
+                BlockType* data = blockVector + size_t(i) * mcu_data_size;
+                const int left = std::min(restartInterval, mcus - i);
 
-        const int HMask = (1 << hsf) - 1;
-        const int VMask = (1 << vsf) - 1;
+                for (int j = 0; j < left; ++j)
+                {
+                    state.decode(data, &state);
+                    data += mcu_data_size;
+                }
+            });
 
-        for (int y = 0; y < ys; ++y)
-        {
-            int mcu_yoffset = (y >> vsf) * xmcu;
-            int block_yoffset = ((y & VMask) << hsf) + scan_offset;
+            // seek next restart marker
+            p = seekMarker(p, decodeState.buffer.end);
+            p += 2;
+        }
 
-            for (int x = 0; x < xs; ++x)
-            {
-                int mcu_offset = (mcu_yoffset + (x >> hsf)) * blocks_in_mcu;
-                int block_offset = (x & HMask) + block_yoffset;
-                BlockType* mcudata = data + (block_offset + mcu_offset) * 64;
+        decodeState.buffer.ptr = p;
 
-                // decode
-                decodeState.decode(mcudata, &decodeState);
-                handleRestart();
-            }
-        }
+        queue.wait();
     }
 
-    void Parser::finishProgressive()
+    // The scan is decoded in stripes of MCU rows into a stripe of coefficients. The previous
+    // stripe is transformed and given to the band function while the next one is entropy decoded.
+    void Parser::decodeSequentialBands()
     {
-#ifdef JPEG_ENABLE_THREAD
-        const int count = ThreadPool::getInstanceSize();
-#else
-        const int count = 1;
-#endif
-        if (count > 1)
+        const int mcu_data_size = blocks_in_mcu * 64;
+        const int stripe = m_surface->height / (yblock * processState.scale / 8);
+        const size_t stripe_size = size_t(stripe) * xmcu * mcu_data_size;
+
+        AlignedVector<BlockType> coefficients(stripe_size * 2);
+
+        ConcurrentQueue queue("jpeg.bands", Priority::HIGH);
+
+        for (int y = 0; y < ymcu; y += stripe)
+        {
+            const int y1 = std::min(y + stripe, ymcu);
+            BlockType* data = coefficients.data() + ((y / stripe) & 1) * stripe_size;
+
+            BlockType* p = data;
+            const int count = (y1 - y) * xmcu;
+
+            for (int i = 0; i < count; ++i)
+            {
+                decodeState.decode(p, &decodeState);
+                handleRestart();
+                p += mcu_data_size;
+            }
+
+            // the band surface is free when the previous stripe is done
+            queue.wait();
+
+            queue.enqueue([=] {
+                processStripe(data, y, y1);
+            });
+        }
+
+        queue.wait();
+    }
+
+    // transform the MCU rows [y0, y1) into the band surface and hand it to the band function
+    void Parser::processStripe(BlockType* data, int y0, int y1)
+    {
+        const int scale = processState.scale;
+        const int mcu_width = xblock * scale / 8;
+        const int mcu_height = yblock * scale / 8;
+        const int mcu_data_size = blocks_in_mcu * 64;
+
+        const int stride = m_surface->stride;
+        const int xstride = m_surface->format.bytes() * mcu_width;
+
+        ConcurrentQueue queue("jpeg.stripe", Priority::HIGH);
+
+        for (int y = y0; y < y1; ++y)
+        {
+            u8* image = m_surface->address<u8>(0, (y - y0) * mcu_height);
+            const BlockType* source = data + size_t(y - y0) * xmcu * mcu_data_size;
+
+            queue.enqueue([=] {
+                u8* dest = image;
+                const BlockType* input = source;
+
+                ProcessFunc process = processState.process;
+                int width = mcu_width;
+                int height = mcu_height;
+
+                if (yclip && y == ymcu - 1)
+                {
+                    process = processState.clipped;
+                    height = (yclip * scale + 7) / 8;
+                }
+
+                for (int x = 0; x < xmcu; ++x)
+                {
+                    if (xclip && x == xmcu - 1)
+                    {
+                        process = processState.clipped;
+                        width = (xclip * scale + 7) / 8;
+                    }
+
+                    process(dest, stride, input, &processState, width, height);
+                    input += mcu_data_size;
+                    dest += xstride;
+                }
+            });
+        }
+
+        queue.wait();
+
+        const int top = y0 * mcu_height;
+        const int bottom = std::min(y1 * mcu_height, (ysize * scale + 7) / 8);
+
+        Surface band(*m_surface, 0, 0, m_surface->width, bottom - top);
+        (*m_band)(band, top);
+    }
+
+    // ----------------------------------------------------------------------------
+    // speculative decoding
+    // ----------------------------------------------------------------------------
+
+    // The scan is split into chunks which are decoded in parallel. Except for the first one
+    // the chunks are decoded from a guessed position: the first bit of the chunk is assumed
+    // to start a MCU. The huffman codes resynchronize quickly so after a few blocks the
+    // speculative decoder is usually decoding the same MCUs as a sequential decoder would.
+    // The chunks are stitched together by finding the bit position where the previous chunk
+    // ended from the MCU positions of the next chunk; the MCUs before it are discarded and
+    // the DC predictors are corrected with a constant offset. When the position is not
+    // found the MCUs are decoded serially until the decoder meets the next chunk.
+
+    struct SpeculativeChunk
+    {
+        u8* start;      // first byte of the chunk
+        u64 end;        // bit position where the next chunk starts
+
+        // decoding results
+        std::unique_ptr<BlockType[]> data;
+        std::vector<u64> position; // bit position of each decoded MCU
+        int capacity = 0;
+        int count = 0;
+        u64 last = 0;   // bit position after the last decoded MCU
+        jpegBuffer buffer; // decoder state after the last decoded MCU
+
+        // synchronization
+        int first = 0;  // first MCU which is in sync
+        int used = 0;   // number of MCUs in sync
+        int dc_offset[JPEG_MAX_COMPS_IN_SCAN];
+    };
+
+    // position of the next unread bit in the scan; stuffed zero bytes are not counted
+    // in the look-ahead so that decoders with different prefetch report the same position
+    static u64 getBitPosition(const jpegBuffer& buffer, const u8* start)
+    {
+        const u8* p = buffer.ptr;
+
+        const int bytes = (buffer.remain + 7) >> 3;
+        for (int i = 0; i < bytes; ++i)
+        {
+            --p;
+            if (!*p && p > start && p[-1] == 0xff)
+            {
+                // stuff byte
+                --p;
+            }
+        }
+
+        return u64(p - start) * 8 + ((8 - (buffer.remain & 7)) & 7);
+    }
+
+    bool Parser::decodeSequentialSpeculative()
+    {
+        // only huffman codes are self-synchronizing
+        if (decodeState.decode != huff_decode_mcu)
+            return false;
+
+        u8* start = decodeState.buffer.ptr;
+        u8* end = seekMarker(start, decodeState.buffer.end);
+
+        // chunks must be large enough to amortize the mis-speculated prefix
+        constexpr int min_chunk_size = 64 * 1024;
+
+        const int pool_size = ThreadPool::getInstanceSize();
+        const int count = std::min(pool_size * 2, int((end - start) / min_chunk_size));
+        if (count < 2)
+            return false;
+
+        const int mcu_data_size = blocks_in_mcu * 64;
+        const size_t chunk_size = (end - start) / count;
+
+        std::vector<SpeculativeChunk> chunks(count);
+
+        for (int i = 0; i < count; ++i)
+        {
+            SpeculativeChunk& chunk = chunks[i];
+
+            u8* p = start + i * chunk_size;
+            if (i > 0 && p[-1] == 0xff && !p[0])
+            {
+                // don't start from a stuff byte
+                ++p;
+            }
+
+            chunk.start = p;
+
+            // expected MCUs in the chunk with some headroom
+            chunk.capacity = int(u64(mcus) * chunk_size / (end - start)) * 5 / 4 + 16;
+            chunk.data.reset(new BlockType[size_t(chunk.capacity) * mcu_data_size]);
+            chunk.position.reserve(chunk.capacity);
+
+            if (i > 0)
+            {
+                chunks[i - 1].end = u64(p - start) * 8;
+            }
+        }
+
+        chunks[count - 1].end = u64(end - start) * 8;
+
+        ConcurrentQueue queue("jpeg.speculative", Priority::HIGH);
+
+        // decode the chunks
+        for (int i = 0; i < count; ++i)
+        {
+            SpeculativeChunk* chunk = &chunks[i];
+
+            queue.enqueue([=] {
+                DecodeState state = decodeState;
+
+                if (i > 0)
+                {
+                    state.buffer.ptr = chunk->start;
+                    state.buffer.restart();
+                    state.huffman.restart();
+                }
+
+                for (int n = 0; n < mcus; ++n)
+                {
+                    const u64 position = getBitPosition(state.buffer, start);
+
+                    // the end of scan is decoded serially; there could be zeros instead of data
+                    if (position >= chunk->end || state.buffer.ptr >= end)
+                        break;
+
+                    if (n == chunk->capacity)
+                    {
+                        const int capacity = n * 2;
+                        BlockType* data = new BlockType[size_t(capacity) * mcu_data_size];
+                        std::memcpy(data, chunk->data.get(), size_t(n) * mcu_data_size * sizeof(BlockType));
+                        chunk->data.reset(data);
+                        chunk->capacity = capacity;
+                    }
+
+                    chunk->position.push_back(position);
+                    state.decode(chunk->data.get() + size_t(n) * mcu_data_size, &state);
+                    ++chunk->count;
+                }
+
+                chunk->last = getBitPosition(state.buffer, start);
+                chunk->buffer = state.buffer;
+            });
+        }
+
+        queue.wait();
+
+        // stitch the chunks together
+        std::vector<BlockType*> mcu_data(mcus);
+
+        DecodeState state = decodeState;
+        u64 position = getBitPosition(state.buffer, start);
+
+        int next = 0;
+
+        for (int n = 0; n < mcus; )
+        {
+            // skip the chunks the decoder has already passed
+            while (next < count && position >= chunks[next].last)
+            {
+                ++next;
+            }
+
+            if (next < count)
+            {
+                SpeculativeChunk& chunk = chunks[next];
+
+                auto it = std::lower_bound(chunk.position.begin(), chunk.position.end(), position);
+                if (it != chunk.position.end() && *it == position)
+                {
+                    const int first = int(it - chunk.position.begin());
+                    const int used = std::min(chunk.count - first, mcus - n);
+
+                    // DC predictors of the speculative decoder
+                    int predictor[JPEG_MAX_COMPS_IN_SCAN] = { 0 };
+
+                    if (first > 0)
+                    {
+                        const BlockType* data = chunk.data.get() + size_t(first - 1) * mcu_data_size;
+                        for (int j = 0; j < decodeState.blocks; ++j)
+                        {
+                            predictor[decodeState.block[j].pred] = data[j * 64];
+                        }
+                    }
+
+                    for (int j = 0; j < JPEG_MAX_COMPS_IN_SCAN; ++j)
+                    {
+                        chunk.dc_offset[j] = state.huffman.last_dc_value[j] - predictor[j];
+                    }
+
+                    chunk.first = first;
+                    chunk.used = used;
+
+                    for (int j = 0; j < used; ++j)
+                    {
+                        mcu_data[n++] = chunk.data.get() + size_t(first + j) * mcu_data_size;
+                    }
+
+                    // continue after the chunk
+                    const BlockType* data = chunk.data.get() + size_t(first + used - 1) * mcu_data_size;
+                    for (int j = 0; j < decodeState.blocks; ++j)
+                    {
+                        const int pred = decodeState.block[j].pred;
+                        state.huffman.last_dc_value[pred] = BlockType(data[j * 64] + chunk.dc_offset[pred]);
+                    }
+
+                    state.buffer = chunk.buffer;
+                    position = chunk.last;
+                    ++next;
+                    continue;
+                }
+            }
+
+            // mis-speculation: decode serially until the decoder is in sync with a chunk
+            BlockType* data = blockVector + size_t(n) * mcu_data_size;
+            state.decode(data, &state);
+            mcu_data[n++] = data;
+
+            position = getBitPosition(state.buffer, start);
+        }
+
+        decodeState.buffer = state.buffer;
+
+        const int stride = m_surface->stride;
+        const int xstride = m_surface->format.bytes() * xblock;
+        const int ystride = stride * yblock;
+        u8* image = m_surface->address<u8>(0, 0);
+
+        // correct the DC predictors
+        for (int i = 0; i < count; ++i)
+        {
+            SpeculativeChunk* chunk = &chunks[i];
+
+            queue.enqueue([=] {
+                BlockType* data = chunk->data.get() + size_t(chunk->first) * mcu_data_size;
+
+                for (int n = 0; n < chunk->used; ++n)
+                {
+                    for (int j = 0; j < decodeState.blocks; ++j)
+                    {
+                        data[j * 64] = BlockType(data[j * 64] + chunk->dc_offset[decodeState.block[j].pred]);
+                    }
+
+                    data += mcu_data_size;
+                }
+            });
+        }
+
+        queue.wait();
+
+        // process MCUs
+        const int N = std::max(ymcu / (4 * pool_size), 1);
+
+        for (int y = 0; y < ymcu; y += N)
+        {
+            const int y0 = y;
+            const int y1 = std::min(y + N, ymcu);
+
+            queue.enqueue([=, &mcu_data] {
+                for (int y = y0; y < y1; ++y)
+                {
+                    u8* dest = image + y * ystride;
+                    BlockType* const* source = mcu_data.data() + y * xmcu;
+
+                    ProcessFunc process = processState.process;
+                    int width = xblock;
+                    int height = yblock;
+
+                    if (yclip && y == ymcu - 1)
+                    {
+                        process = processState.clipped;
+                        height = yclip;
+                    }
+
+                    for (int x = 0; x < xmcu; ++x)
+                    {
+                        if (xclip && x == xmcu - 1)
+                        {
+                            process = processState.clipped;
+                            width = xclip;
+                        }
+
+                        process(dest, stride, source[x], &processState, width, height);
+                        dest += xstride;
+                    }
+                }
+            });
+        }
+
+        queue.wait();
+
+        return true;
+    }
+
+    void Parser::decodeProgressive()
+    {
+        const bool dc_scan = (decodeState.spectralStart == 0);
+        BlockType* data = blockVector;
+
+        if (dc_scan)
+        {
+            if (decodeState.comps_in_scan == 1 && decodeState.blocks > 1)
+            {
+                // HACK: process 8x8 blocks in more expensive ac scanner code below
+                // NOTE: we propably should do this only when 8x8 block count is not multiple of MCU block size
+                decodeState.block[0].offset = 0;
+                decodeState.blocks = 1;
+            }
+            else
+            {
+                for (int i = 0; i < mcus; ++i)
+                {
+                    decodeState.decode(data, &decodeState);
+                    handleRestart();
+                    data += blocks_in_mcu * 64;
+                }
+
+                return;
+            }
+        }
+
+        const int hsf = u32_log2(scanFrame->Hsf);
+        const int vsf = u32_log2(scanFrame->Vsf);
+        const int hsize = (Hmax >> hsf) * 8;
+        const int vsize = (Vmax >> vsf) * 8;
+
+        jpegPrint("    hf: %i x %i, log2: %i x %i\n", 1 << hsf, 1 << vsf, hsf, vsf);
+        jpegPrint("    bs: %i x %i  scanSize: %d\n", hsize, vsize, decodeState.blocks);
+
+        const int scan_offset = scanFrame->offset;
+
+        const int xs = ((xsize + hsize - 1) / hsize);
+        const int ys = ((ysize + vsize - 1) / vsize);
+
+        jpegPrint("    blocks: %d x %d (%d x %d)\n", xs, ys, xs * hsize, ys * vsize);
+
+        const int HMask = (1 << hsf) - 1;
+        const int VMask = (1 << vsf) - 1;
+
+        for (int y = 0; y < ys; ++y)
+        {
+            int mcu_yoffset = (y >> vsf) * xmcu;
+            int block_yoffset = ((y & VMask) << hsf) + scan_offset;
+
+            for (int x = 0; x < xs; ++x)
+            {
+                int mcu_offset = (mcu_yoffset + (x >> hsf)) * blocks_in_mcu;
+                int block_offset = (x & HMask) + block_yoffset;
+                BlockType* mcudata = data + (block_offset + mcu_offset) * 64;
+
+                // decode
+                decodeState.decode(mcudata, &decodeState);
+                handleRestart();
+            }
+        }
+    }
+
+    u8* Parser::decodeProgressiveMT(u8* p, u8* end)
+    {
+        ProgressiveGraph& graph = *progressiveGraph;
+        DecodeState state = decodeState;
+
+        const bool dc_scan = (state.spectralStart == 0);
+        const bool refine_scan = (state.successiveHigh != 0);
+
+        // the huffman tables can be redefined before the tasks are run; the arithmetic
+        // conditioning tables are in the copied decoder state
+        if (!is_arithmetic && (!dc_scan || !refine_scan))
+        {
+            HuffTable* copies[JPEG_MAX_COMPS_IN_SCAN] = { nullptr };
+
+            for (int i = 0; i < state.blocks; ++i)
+            {
+                HuffTable*& table = dc_scan ? state.block[i].table.dc : state.block[i].table.ac;
+                const int index = int(table - huffTable[dc_scan ? 0 : 1]);
+
+                if (!copies[index])
+                {
+                    graph.tables.push_back(*table);
+                    copies[index] = &graph.tables.back();
+                    copies[index]->configure();
+                }
+
+                table = copies[index];
+            }
+        }
+
+        int components[JPEG_MAX_COMPS_IN_SCAN];
+        int numComponents = 0;
+
+        for (int i = 0; i < state.blocks; ++i)
         {
-            finishProgressiveMT();
+            if (std::find(components, components + numComponents, state.block[i].pred) == components + numComponents)
+            {
+                components[numComponents++] = state.block[i].pred;
+            }
         }
-        else
+
+        // scan geometry; see decodeProgressive()
+        bool mcu_scan = dc_scan;
+        int hsf = 0;
+        int vsf = 0;
+        int xs = xmcu;
+        int units = mcus;
+        int scan_offset = 0;
+
+        if (!dc_scan || (state.comps_in_scan == 1 && state.blocks > 1))
         {
-            finishProgressiveST();
+            if (dc_scan)
+            {
+                state.block[0].offset = 0;
+                state.blocks = 1;
+            }
+
+            hsf = u32_log2(scanFrame->Hsf);
+            vsf = u32_log2(scanFrame->Vsf);
+            const int hsize = (Hmax >> hsf) * 8;
+            const int vsize = (Vmax >> vsf) * 8;
+
+            mcu_scan = false;
+            xs = ((xsize + hsize - 1) / hsize);
+            units = xs * ((ysize + vsize - 1) / vsize);
+            scan_offset = scanFrame->offset;
+        }
+
+        // find the restart intervals and the end of the scan
+        graph.intervals.emplace_back();
+        std::vector<u8*>* starts = &graph.intervals.back();
+        starts->push_back(p);
+
+        for (;;)
+        {
+            p = seekMarker(p, end);
+            if (p + 2 > end || !isRestartMarker(p))
+                break;
+
+            p += 2;
+            starts->push_back(p);
+        }
+
+        const int interval = restartInterval > 0 ? restartInterval : units;
+        const int count = (units + interval - 1) / interval;
+
+        const int pool_size = ThreadPool::getInstanceSize();
+        const int group = std::max(1, count / (4 * pool_size));
+
+        BlockType* data = blockVector;
+        const int mcu_data_size = blocks_in_mcu * 64;
+        const int blocks = blocks_in_mcu;
+        const int xmcus = xmcu;
+        u8* scan_end = p;
+
+        auto row = [=] (int n)
+        {
+            return mcu_scan ? n / xmcus : (n / xs) >> vsf;
+        };
+
+        std::vector<ProgressiveSegment> segments;
+
+        for (int i = 0; i < count; i += group)
+        {
+            const int n0 = i * interval;
+            const int n1 = std::min((i + group) * interval, units);
+
+            const int y0 = row(n0);
+            const int y1 = row(n1 - 1);
+
+            std::vector<ProgressiveTask*> dependencies;
+
+            for (int j = 0; j < numComponents; ++j)
+            {
+                graph.depends(dependencies, components[j], y0, y1);
+            }
+
+            jpegPrint("  Segment: [%d, %d] rows: [%d, %d] --> ThreadPool.\n", n0, n1 - 1, y0, y1);
+
+            ProgressiveTask* task = graph.add([=] {
+                DecodeState local = state;
+
+                const int HMask = (1 << hsf) - 1;
+                const int VMask = (1 << vsf) - 1;
+
+                for (int n = n0; n < n1; ++n)
+                {
+                    if (n == n0 || !(n % interval))
+                    {
+                        const size_t index = n / interval;
+
+                        local.buffer.ptr = index < starts->size() ? (*starts)[index] : scan_end;
+                        local.buffer.end = end;
+                        restart(local);
+                    }
+
+                    BlockType* mcudata;
+
+                    if (mcu_scan)
+                    {
+                        mcudata = data + n * mcu_data_size;
+                    }
+                    else
+                    {
+                        const int x = n % xs;
+                        const int y = n / xs;
+                        int mcu_offset = ((y >> vsf) * xmcus + (x >> hsf)) * blocks;
+                        int block_offset = (x & HMask) + ((y & VMask) << hsf) + scan_offset;
+                        mcudata = data + (block_offset + mcu_offset) * 64;
+                    }
+
+                    local.decode(mcudata, &local);
+                }
+            }, dependencies);
+
+            segments.push_back({ y0, y1, task });
+        }
+
+        for (int j = 0; j < numComponents; ++j)
+        {
+            graph.last[components[j]] = segments;
         }
+
+        return p;
     }
 
-    void Parser::finishProgressiveST()
+    void Parser::processProgressive(int y0, int y1)
     {
+        if (processState.fancy)
+        {
+            const size_t row_data_size = size_t(xmcu) * blocks_in_mcu * 64;
+
+            processFancy(y0, y1, [=] (int y) -> const BlockType* {
+                return blockVector + y * row_data_size;
+            });
+            return;
+        }
+
         const int stride = m_surface->stride;
         const int xstride = m_surface->format.bytes() * xblock;
         const int ystride = stride * yblock;
         u8* image = m_surface->address<u8>(0, 0);
 
         const int mcu_data_size = blocks_in_mcu * 64;
-        BlockType* data = blockVector;
 
-        for (int y = 0; y < ymcu; ++y)
+        for (int y = y0; y < y1; ++y)
         {
             u8* dest = image + y * ystride;
+            BlockType* source = blockVector + y * xmcu * mcu_data_size;
 
             ProcessFunc process = processState.process;
             int width = xblock;
@@ -1770,14 +2979,19 @@ namespace jpeg
                     width = xclip;
                 }
 
-                process(dest, stride, data, &processState, width, height);
-                data += mcu_data_size;
+                process(dest, stride, source, &processState, width, height);
+                source += mcu_data_size;
                 dest += xstride;
             }
         }
     }
 
-    void Parser::finishProgressiveMT()
+    // The chroma of the MCU rows is transformed into planes of 17 rows: the last row of the
+    // MCU row above, the 8 rows of the current MCU row and the 8 rows of the one below which
+    // are moved up for the next MCU row. The horizontal layout uses only the current rows.
+    // The rows and columns outside the image repeat the nearest sample inside the image
+    // like in libjpeg.
+    void Parser::processFancy(int y0, int y1, const FancyRowFunc& row)
     {
         const int stride = m_surface->stride;
         const int xstride = m_surface->format.bytes() * xblock;
@@ -1785,8 +2999,114 @@ namespace jpeg
         u8* image = m_surface->address<u8>(0, 0);
 
         const int mcu_data_size = blocks_in_mcu * 64;
-        BlockType* data = blockVector;
+        const bool vertical = yblock == 16;
+
+        // chroma samples inside the image
+        const int cwidth = (xsize + 1) >> 1;
+        const int cheight = vertical ? (ysize + 1) >> 1 : ysize;
+
+        // the upsampling reads 16 samples at a time from the last MCU
+        const int cstride = xmcu * 8 + 2;
+        AlignedVector<u8> planes(cstride * 17 * 2 + 16);
+        u8* cb = planes.data() + cstride + 1;
+        u8* cr = cb + cstride * 17;
+
+        if (vertical)
+        {
+            if (y0 > 0)
+            {
+                // the row above is the last row of the previous MCU row
+                fancy_chroma(cb, cr, cstride, row(y0 - 1), &processState, xmcu, cwidth);
+            }
+
+            fancy_chroma(cb + 8 * cstride, cr + 8 * cstride, cstride, row(y0), &processState, xmcu, cwidth);
+        }
+
+        for (int y = y0; y < y1; ++y)
+        {
+            u8* dest = image + y * ystride;
+
+            if (vertical)
+            {
+                // move the rows [7, 15] to [-1, 7]
+                std::memmove(cb - cstride - 1, cb + 7 * cstride - 1, cstride * 9);
+                std::memmove(cr - cstride - 1, cr + 7 * cstride - 1, cstride * 9);
+
+                if (y == 0)
+                {
+                    std::memcpy(cb - cstride - 1, cb - 1, cstride);
+                    std::memcpy(cr - cstride - 1, cr - 1, cstride);
+                }
+
+                if (y + 1 < ymcu)
+                {
+                    fancy_chroma(cb + 8 * cstride, cr + 8 * cstride, cstride, row(y + 1), &processState, xmcu, cwidth);
+                }
+
+                // the last row inside the image is repeated below it
+                const int bottom = cheight - y * 8;
+                if (bottom <= 8)
+                {
+                    std::memcpy(cb + bottom * cstride - 1, cb + (bottom - 1) * cstride - 1, cstride);
+                    std::memcpy(cr + bottom * cstride - 1, cr + (bottom - 1) * cstride - 1, cstride);
+                }
+            }
+            else
+            {
+                fancy_chroma(cb, cr, cstride, row(y), &processState, xmcu, cwidth);
+            }
+
+            const BlockType* source = row(y);
+            int width = xblock;
+            int height = yblock;
+
+            if (yclip && y == ymcu - 1)
+            {
+                height = yclip;
+            }
+
+            for (int x = 0; x < xmcu; ++x)
+            {
+                if (xclip && x == xmcu - 1)
+                {
+                    width = xclip;
+                }
+
+                processState.fancy(dest, stride, source, &processState, cb + x * 8, cr + x * 8, cstride, width, height);
+                source += mcu_data_size;
+                dest += xstride;
+            }
+        }
+    }
+
+    void Parser::finishProgressive()
+    {
+#ifdef JPEG_ENABLE_THREAD
+        const int count = ThreadPool::getInstanceSize();
+#else
+        const int count = 1;
+#endif
+        if (progressiveGraph)
+        {
+            finishProgressiveGraph();
+        }
+        else if (count > 1)
+        {
+            finishProgressiveMT();
+        }
+        else
+        {
+            finishProgressiveST();
+        }
+    }
+
+    void Parser::finishProgressiveST()
+    {
+        processProgressive(0, ymcu);
+    }
 
+    void Parser::finishProgressiveMT()
+    {
         ConcurrentQueue queue("jpeg.progressive", Priority::HIGH);
         const int pool_size = ThreadPool::getInstanceSize();
 
@@ -1802,39 +3122,176 @@ namespace jpeg
 
             // enqueue task
             queue.enqueue([=] {
-                for (int y = y0; y < y1; ++y)
+                processProgressive(y0, y1);
+            });
+        }
+
+        // synchronize
+        queue.wait();
+    }
+
+    void Parser::finishProgressiveGraph()
+    {
+        ProgressiveGraph& graph = *progressiveGraph;
+        const int pool_size = ThreadPool::getInstanceSize();
+
+        const int S = pool_size > 1 ? 4 * pool_size : 1;
+        const int N = std::max(ymcu / S, pool_size);
+
+        // process the bands as soon as the last scans covering them are decoded
+        for (int y = 0; y < ymcu; y += N)
+        {
+            const int y0 = y;
+            const int y1 = std::min(y + N, ymcu);
+
+            std::vector<ProgressiveTask*> dependencies;
+
+            // the fancy upsampling reads the last and first chroma rows of the neighbouring bands
+            const int first = processState.fancy ? std::max(y0 - 1, 0) : y0;
+            const int last = processState.fancy ? std::min(y1, ymcu - 1) : y1 - 1;
+
+            for (int i = 0; i < int(frames.size()) && i < JPEG_MAX_COMPS_IN_SCAN; ++i)
+            {
+                graph.depends(dependencies, i, first, last);
+            }
+
+            jpegPrint("  Process: [%d, %d] --> ThreadPool.\n", y0, y1 - 1);
+
+            graph.add([=] {
+                processProgressive(y0, y1);
+            }, dependencies);
+        }
+
+        // synchronize
+        graph.queue.wait();
+    }
+
+    // ----------------------------------------------------------------------------
+    // Probe
+    // ----------------------------------------------------------------------------
+
+    bool Probe(ImageProbe& probe, Memory memory)
+    {
+        const u8* p = memory.address;
+        const u8* end = memory.address + memory.size;
+
+        if (!p || memory.size < 4 || uload16be(p) != MARKER_SOI)
+            return false;
+
+        p += 2;
+
+        bool frame = false;
+
+        // only the segment headers are read; the scans are never reached
+        while (p + 4 <= end)
+        {
+            if (p[0] != 0xff)
+                return frame;
+
+            const u16 marker = uload16be(p);
+
+            // fill bytes and markers without a segment
+            if (marker == 0xffff)
+            {
+                ++p;
+                continue;
+            }
+
+            if (marker == MARKER_SOI || marker == MARKER_TEM || (marker >= MARKER_RST0 && marker <= MARKER_RST7))
+            {
+                p += 2;
+                continue;
+            }
+
+            if (marker == MARKER_SOS || marker == MARKER_EOI)
+                break;
+
+            const int length = uload16be(p + 2);
+            const u8* data = p + 4;
+            const int size = length - 2;
+
+            if (length < 2 || data + size > end)
+                break;
+
+            switch (marker)
+            {
+                case MARKER_SOF0:
+                case MARKER_SOF1:
+                case MARKER_SOF2:
+                case MARKER_SOF3:
+                case MARKER_SOF5:
+                case MARKER_SOF6:
+                case MARKER_SOF7:
+                case MARKER_SOF9:
+                case MARKER_SOF10:
+                case MARKER_SOF11:
+                case MARKER_SOF13:
+                case MARKER_SOF14:
+                case MARKER_SOF15:
                 {
-                    u8* dest = image + y * ystride;
-                    BlockType* source = data + y * xmcu * mcu_data_size;
+                    if (size < 6)
+                        return false;
+
+                    const int comps = data[5];
+                    const bool lossless = marker == MARKER_SOF3 || marker == MARKER_SOF7 ||
+                                          marker == MARKER_SOF11 || marker == MARKER_SOF15;
+
+                    probe.header.width   = uload16be(data + 3);
+                    probe.header.height  = uload16be(data + 1);
+                    probe.header.depth   = 0;
+                    probe.header.levels  = 0;
+                    probe.header.faces   = 0;
+                    probe.header.palette = false;
+                    probe.header.format  = getFormat(comps, data[0], lossless);
+                    probe.header.compression = TextureCompression::NONE;
+
+                    frame = true;
+                    break;
+                }
 
-                    ProcessFunc process = processState.process;
-                    int width = xblock;
-                    int height = yblock;
+                case MARKER_APP1:
+                {
+                    const u8 magicExif0[] = { 0x45, 0x78, 0x69, 0x66, 0, 0 }; // 'Exif', 0, 0
+                    const u8 magicExif255[] = { 0x45, 0x78, 0x69, 0x66, 0, 0xff }; // 'Exif', 0, 0xff
 
-                    if (yclip && y == ymcu - 1)
+                    if (size >= 6 && (!std::memcmp(data, magicExif0, 6) || !std::memcmp(data, magicExif255, 6)))
                     {
-                        process = processState.clipped;
-                        height = yclip;
+                        probe.exif = Memory(const_cast<u8*>(data + 6), size - 6);
                     }
 
-                    for (int x = 0; x < xmcu; ++x)
+                    break;
+                }
+
+                case MARKER_APP2:
+                {
+                    const u8 magicICC[] = { 0x49, 0x43, 0x43, 0x5f, 0x50, 0x52, 0x4f, 0x46, 0x49, 0x4c, 0x45, 0 }; // 'ICC_PROFILE', 0
+
+                    if (size >= 12 && !std::memcmp(data, magicICC, 12))
                     {
-                        if (xclip && x == xmcu - 1)
-                        {
-                            process = processState.clipped;
-                            width = xclip;
-                        }
+                        probe.icc = Memory(const_cast<u8*>(data + 12), size - 12);
+                    }
 
-                        process(dest, stride, source, &processState, width, height);
-                        source += mcu_data_size;
-                        dest += xstride;
+                    break;
+                }
+
+                case MARKER_APP3:
+                {
+                    const u8 magicMETA[] = { 0x4d, 0x45, 0x54, 0x41, 0, 0 }; // 'META', 0, 0
+                    const u8 magicMeta[] = { 0x4d, 0x65, 0x74, 0x61, 0, 0 }; // 'Meta', 0, 0
+
+                    if (size >= 6 && (!std::memcmp(data, magicMETA, 6) || !std::memcmp(data, magicMeta, 6)))
+                    {
+                        probe.exif = Memory(const_cast<u8*>(data + 6), size - 6);
                     }
+
+                    break;
                 }
-            });
+            }
+
+            p = data + size;
         }
 
-        // synchronize
-        queue.wait();
+        return frame;
     }
 
 } // namespace jpeg
@@ -29,6 +29,7 @@
 #include <mango/core/pointer.hpp>
 #include "jpeg.hpp"
 #include <cstring>
+#include <mutex>
 
 #define BLOCK_SIZE  64
 
@@ -61,116 +62,62 @@ namespace
     };
     const int g_format_table_size = sizeof(g_format_table) / sizeof(g_format_table[0]);
 
-    const u16 luminance_dc_code_table [] =
-    {
-        0x0000, 0x0002, 0x0003, 0x0004, 0x0005, 0x0006,
-        0x000E, 0x001E, 0x003E, 0x007E, 0x00FE, 0x01FE
-    };
+    // Annex K.3 typical Huffman tables: number of codes of each length 1..16
+    // followed by the symbols in order of increasing code length
 
-    const u16 luminance_dc_size_table [] =
+    const u8 luminance_dc_bits [] =
     {
-        0x0002, 0x0003, 0x0003, 0x0003, 0x0003, 0x0003,
-        0x0004, 0x0005, 0x0006, 0x0007, 0x0008, 0x0009
+        0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0
     };
 
-    const u16 chrominance_dc_code_table [] =
+    const u8 chrominance_dc_bits [] =
     {
-        0x0000, 0x0001, 0x0002, 0x0006, 0x000E, 0x001E,
-        0x003E, 0x007E, 0x00FE, 0x01FE, 0x03FE, 0x07FE
+        0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0
     };
 
-    const u16 chrominance_dc_size_table [] =
+    const u8 dc_values [] =
     {
-        0x0002, 0x0002, 0x0002, 0x0003, 0x0004, 0x0005,
-        0x0006, 0x0007, 0x0008, 0x0009, 0x000A, 0x000B
+        0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11
     };
 
-    const u16 luminance_ac_code_table [] =
-    {
-        0x000A,
-        0x0000, 0x0001, 0x0004, 0x000B, 0x001A, 0x0078, 0x00F8, 0x03F6, 0xFF82, 0xFF83,
-        0x000C, 0x001B, 0x0079, 0x01F6, 0x07F6, 0xFF84, 0xFF85, 0xFF86, 0xFF87, 0xFF88,
-        0x001C, 0x00F9, 0x03F7, 0x0FF4, 0xFF89, 0xFF8A, 0xFF8b, 0xFF8C, 0xFF8D, 0xFF8E,
-        0x003A, 0x01F7, 0x0FF5, 0xFF8F, 0xFF90, 0xFF91, 0xFF92, 0xFF93, 0xFF94, 0xFF95,
-        0x003B, 0x03F8, 0xFF96, 0xFF97, 0xFF98, 0xFF99, 0xFF9A, 0xFF9B, 0xFF9C, 0xFF9D,
-        0x007A, 0x07F7, 0xFF9E, 0xFF9F, 0xFFA0, 0xFFA1, 0xFFA2, 0xFFA3, 0xFFA4, 0xFFA5,
-        0x007B, 0x0FF6, 0xFFA6, 0xFFA7, 0xFFA8, 0xFFA9, 0xFFAA, 0xFFAB, 0xFFAC, 0xFFAD,
-        0x00FA, 0x0FF7, 0xFFAE, 0xFFAF, 0xFFB0, 0xFFB1, 0xFFB2, 0xFFB3, 0xFFB4, 0xFFB5,
-        0x01F8, 0x7FC0, 0xFFB6, 0xFFB7, 0xFFB8, 0xFFB9, 0xFFBA, 0xFFBB, 0xFFBC, 0xFFBD,
-        0x01F9, 0xFFBE, 0xFFBF, 0xFFC0, 0xFFC1, 0xFFC2, 0xFFC3, 0xFFC4, 0xFFC5, 0xFFC6,
-        0x01FA, 0xFFC7, 0xFFC8, 0xFFC9, 0xFFCA, 0xFFCB, 0xFFCC, 0xFFCD, 0xFFCE, 0xFFCF,
-        0x03F9, 0xFFD0, 0xFFD1, 0xFFD2, 0xFFD3, 0xFFD4, 0xFFD5, 0xFFD6, 0xFFD7, 0xFFD8,
-        0x03FA, 0xFFD9, 0xFFDA, 0xFFDB, 0xFFDC, 0xFFDD, 0xFFDE, 0xFFDF, 0xFFE0, 0xFFE1,
-        0x07F8, 0xFFE2, 0xFFE3, 0xFFE4, 0xFFE5, 0xFFE6, 0xFFE7, 0xFFE8, 0xFFE9, 0xFFEA,
-        0xFFEB, 0xFFEC, 0xFFED, 0xFFEE, 0xFFEF, 0xFFF0, 0xFFF1, 0xFFF2, 0xFFF3, 0xFFF4,
-        0xFFF5, 0xFFF6, 0xFFF7, 0xFFF8, 0xFFF9, 0xFFFA, 0xFFFB, 0xFFFC, 0xFFFD, 0xFFFE,
-        0x07F9
+    const u8 luminance_ac_bits [] =
+    {
+        0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7D
     };
 
-    const u16 luminance_ac_size_table [] =
-    {
-        0x0004,
-        0x0002, 0x0002, 0x0003, 0x0004, 0x0005, 0x0007, 0x0008, 0x000A, 0x0010, 0x0010,
-        0x0004, 0x0005, 0x0007, 0x0009, 0x000B, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010,
-        0x0005, 0x0008, 0x000A, 0x000C, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010,
-        0x0006, 0x0009, 0x000C, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010,
-        0x0006, 0x000A, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010,
-        0x0007, 0x000B, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010,
-        0x0007, 0x000C, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010,
-        0x0008, 0x000C, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010,
-        0x0009, 0x000F, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010,
-        0x0009, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010,
-        0x0009, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010,
-        0x000A, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010,
-        0x000A, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010,
-        0x000B, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010,
-        0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010,
-        0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010,
-        0x000B
+    const u8 luminance_ac_values [] =
+    {
+        0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+        0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xA1, 0x08, 0x23, 0x42, 0xB1, 0xC1, 0x15, 0x52, 0xD1, 0xF0,
+        0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0A, 0x16, 0x17, 0x18, 0x19, 0x1A, 0x25, 0x26, 0x27, 0x28,
+        0x29, 0x2A, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+        0x4A, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+        0x6A, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+        0x8A, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0xA2, 0xA3, 0xA4, 0xA5, 0xA6, 0xA7,
+        0xA8, 0xA9, 0xAA, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3, 0xC4, 0xC5,
+        0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA, 0xE1, 0xE2,
+        0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xF1, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8,
+        0xF9, 0xFA,
     };
 
-    const u16 chrominance_ac_code_table [] =
-    {
-        0x0000,
-        0x0001, 0x0004, 0x000A, 0x0018, 0x0019, 0x0038, 0x0078, 0x01F4, 0x03F6, 0x0FF4,
-        0x000B, 0x0039, 0x00F6, 0x01F5, 0x07F6, 0x0FF5, 0xFF88, 0xFF89, 0xFF8A, 0xFF8B,
-        0x001A, 0x00F7, 0x03F7, 0x0FF6, 0x7FC2, 0xFF8C, 0xFF8D, 0xFF8E, 0xFF8F, 0xFF90,
-        0x001B, 0x00F8, 0x03F8, 0x0FF7, 0xFF91, 0xFF92, 0xFF93, 0xFF94, 0xFF95, 0xFF96,
-        0x003A, 0x01F6, 0xFF97, 0xFF98, 0xFF99, 0xFF9A, 0xFF9B, 0xFF9C, 0xFF9D, 0xFF9E,
-        0x003B, 0x03F9, 0xFF9F, 0xFFA0, 0xFFA1, 0xFFA2, 0xFFA3, 0xFFA4, 0xFFA5, 0xFFA6,
-        0x0079, 0x07F7, 0xFFA7, 0xFFA8, 0xFFA9, 0xFFAA, 0xFFAB, 0xFFAC, 0xFFAD, 0xFFAE,
-        0x007A, 0x07F8, 0xFFAF, 0xFFB0, 0xFFB1, 0xFFB2, 0xFFB3, 0xFFB4, 0xFFB5, 0xFFB6,
-        0x00F9, 0xFFB7, 0xFFB8, 0xFFB9, 0xFFBA, 0xFFBB, 0xFFBC, 0xFFBD, 0xFFBE, 0xFFBF,
-        0x01F7, 0xFFC0, 0xFFC1, 0xFFC2, 0xFFC3, 0xFFC4, 0xFFC5, 0xFFC6, 0xFFC7, 0xFFC8,
-        0x01F8, 0xFFC9, 0xFFCA, 0xFFCB, 0xFFCC, 0xFFCD, 0xFFCE, 0xFFCF, 0xFFD0, 0xFFD1,
-        0x01F9, 0xFFD2, 0xFFD3, 0xFFD4, 0xFFD5, 0xFFD6, 0xFFD7, 0xFFD8, 0xFFD9, 0xFFDA,
-        0x01FA, 0xFFDB, 0xFFDC, 0xFFDD, 0xFFDE, 0xFFDF, 0xFFE0, 0xFFE1, 0xFFE2, 0xFFE3,
-        0x07F9, 0xFFE4, 0xFFE5, 0xFFE6, 0xFFE7, 0xFFE8, 0xFFE9, 0xFFEA, 0xFFEb, 0xFFEC,
-        0x3FE0, 0xFFED, 0xFFEE, 0xFFEF, 0xFFF0, 0xFFF1, 0xFFF2, 0xFFF3, 0xFFF4, 0xFFF5,
-        0x7FC3, 0xFFF6, 0xFFF7, 0xFFF8, 0xFFF9, 0xFFFA, 0xFFFB, 0xFFFC, 0xFFFD, 0xFFFE,
-        0x03FA
+    const u8 chrominance_ac_bits [] =
+    {
+        0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77
     };
 
-    const u16 chrominance_ac_size_table [] =
-    {
-        0x0002,
-        0x0002, 0x0003, 0x0004, 0x0005, 0x0005, 0x0006, 0x0007, 0x0009, 0x000A, 0x000C,
-        0x0004, 0x0006, 0x0008, 0x0009, 0x000B, 0x000C, 0x0010, 0x0010, 0x0010, 0x0010,
-        0x0005, 0x0008, 0x000A, 0x000C, 0x000F, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010,
-        0x0005, 0x0008, 0x000A, 0x000C, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010,
-        0x0006, 0x0009, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010,
-        0x0006, 0x000A, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010,
-        0x0007, 0x000B, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010,
-        0x0007, 0x000B, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010,
-        0x0008, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010,
-        0x0009, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010,
-        0x0009, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010,
-        0x0009, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010,
-        0x0009, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010,
-        0x000B, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010,
-        0x000E, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010,
-        0x000F, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010,
-        0x000A
+    const u8 chrominance_ac_values [] =
+    {
+        0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+        0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xA1, 0xB1, 0xC1, 0x09, 0x23, 0x33, 0x52, 0xF0,
+        0x15, 0x62, 0x72, 0xD1, 0x0A, 0x16, 0x24, 0x34, 0xE1, 0x25, 0xF1, 0x17, 0x18, 0x19, 0x1A, 0x26,
+        0x27, 0x28, 0x29, 0x2A, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+        0x49, 0x4A, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+        0x69, 0x6A, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+        0x88, 0x89, 0x8A, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0xA2, 0xA3, 0xA4, 0xA5,
+        0xA6, 0xA7, 0xA8, 0xA9, 0xAA, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3,
+        0xC4, 0xC5, 0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA,
+        0xE2, 0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8,
+        0xF9, 0xFA,
     };
 
     const u8 bit_size [] =
@@ -193,24 +140,6 @@ namespace
         8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8
     };
 
-    const u8 marker_data [] =
-    {
-        0xFF, 0xC4, 0x00, 0x1F, 0x00, 0x00, 0x01, 0x05, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B,
-        0xFF, 0xC4, 0x00, 0xB5, 0x10, 0x00, 0x02, 0x01, 0x03, 0x03, 0x02, 0x04, 0x03, 0x05, 0x05, 0x04, 0x04, 0x00, 0x00, 0x01, 0x7D, 0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06,
-		0x13, 0x51, 0x61, 0x07, 0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xA1, 0x08, 0x23, 0x42, 0xB1, 0xC1, 0x15, 0x52, 0xD1, 0xF0, 0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0A, 0x16, 0x17, 0x18, 0x19, 0x1A, 0x25,
-		0x26, 0x27, 0x28, 0x29, 0x2A, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4A, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x63, 0x64, 0x65, 0x66, 0x67,
-		0x68, 0x69, 0x6A, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89, 0x8A, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0xA2, 0xA3, 0xA4, 0xA5, 0xA6,
-		0xA7, 0xA8, 0xA9, 0xAA, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3, 0xC4, 0xC5, 0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA, 0xE1, 0xE2,
-		0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xF1, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8, 0xF9, 0xFA,
-        0xFF, 0xC4, 0x00, 0x1F, 0x01, 0x00, 0x03, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B,
-        0xFF, 0xC4, 0x00, 0xB5, 0x11, 0x00, 0x02, 0x01, 0x02, 0x04, 0x04, 0x03, 0x04, 0x07, 0x05, 0x04, 0x04, 0x00, 0x01, 0x02, 0x77, 0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41,
-		0x51, 0x07, 0x61, 0x71, 0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xA1, 0xB1, 0xC1, 0x09, 0x23, 0x33, 0x52, 0xF0, 0x15, 0x62, 0x72, 0xD1, 0x0A, 0x16, 0x24, 0x34, 0xE1, 0x25, 0xF1, 0x17, 0x18,
-		0x19, 0x1A, 0x26, 0x27, 0x28, 0x29, 0x2A, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4A, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x63, 0x64, 0x65, 0x66,
-		0x67, 0x68, 0x69, 0x6A, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89, 0x8A, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0xA2, 0xA3, 0xA4,
-		0xA5, 0xA6, 0xA7, 0xA8, 0xA9, 0xAA, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3, 0xC4, 0xC5, 0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA,
-		0xE2, 0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8, 0xF9, 0xFA,
-    };
-
     const u8 zigzag_table [] =
     {
         0,  1,   5,  6, 14, 15, 27, 28,
@@ -251,8 +180,232 @@ namespace
     {
         int         component;
         u16*     qtable;
+
+        int         hsf;        // sampling factors
+        int         vsf;
+        int         offset;     // index of the first block in MCU
+        int         xblocks;    // blocks in a non-interleaved scan
+        int         yblocks;
+    };
+
+    // ----------------------------------------------------------------------------
+    // HuffmanTable
+    // ----------------------------------------------------------------------------
+
+    struct HuffmanTable
+    {
+        u8          bits[16];       // number of codes of length 1..16
+        u8          values[256];    // symbols in order of increasing code length
+        u16         code[256];
+        u8          size[256];
+
+        void init(const u8* bits, const u8* values);
+        void optimize(const u32* frequency);
+        void write(BigEndianStream& p, u8 index) const;
+    };
+
+    void HuffmanTable::init(const u8* bits_, const u8* values_)
+    {
+        int count = 0;
+
+        for (int i = 0; i < 16; ++i)
+        {
+            bits[i] = bits_[i];
+            count += bits[i];
+        }
+
+        std::memcpy(values, values_, count);
+        std::memset(code, 0, sizeof(code));
+        std::memset(size, 0, sizeof(size));
+
+        // canonical codes (Annex C)
+        u32 huffcode = 0;
+        int k = 0;
+
+        for (int length = 1; length <= 16; ++length)
+        {
+            for (int i = 0; i < bits[length - 1]; ++i)
+            {
+                const u8 symbol = values[k++];
+                code[symbol] = u16(huffcode++);
+                size[symbol] = u8(length);
+            }
+
+            huffcode <<= 1;
+        }
+    }
+
+    void HuffmanTable::optimize(const u32* frequency)
+    {
+        // Annex K.2: code lengths from symbol frequencies, limited to 16 bits.
+        // Symbol 256 is reserved with the lowest frequency so that no code
+        // consists only of 1-bits.
+        u32 freq[257];
+        int codesize[257];
+        int others[257];
+
+        std::memcpy(freq, frequency, 256 * sizeof(u32));
+        freq[256] = 1;
+
+        for (int i = 0; i < 257; ++i)
+        {
+            codesize[i] = 0;
+            others[i] = -1;
+        }
+
+        for (;;)
+        {
+            // two least frequent symbols; ties go to the larger symbol value
+            int c1 = -1;
+            int c2 = -1;
+            u32 v1 = 0xffffffff;
+            u32 v2 = 0xffffffff;
+
+            for (int i = 0; i < 257; ++i)
+            {
+                if (freq[i] && freq[i] <= v1)
+                {
+                    v1 = freq[i];
+                    c1 = i;
+                }
+            }
+
+            for (int i = 0; i < 257; ++i)
+            {
+                if (freq[i] && freq[i] <= v2 && i != c1)
+                {
+                    v2 = freq[i];
+                    c2 = i;
+                }
+            }
+
+            if (c2 < 0)
+                break;
+
+            freq[c1] += freq[c2];
+            freq[c2] = 0;
+
+            ++codesize[c1];
+            while (others[c1] >= 0)
+            {
+                c1 = others[c1];
+                ++codesize[c1];
+            }
+
+            others[c1] = c2;
+
+            ++codesize[c2];
+            while (others[c2] >= 0)
+            {
+                c2 = others[c2];
+                ++codesize[c2];
+            }
+        }
+
+        int count[258] = { 0 };
+
+        for (int i = 0; i < 257; ++i)
+        {
+            ++count[codesize[i]];
+        }
+
+        count[0] = 0;
+
+        // move the codes longer than 16 bits into the tree above them
+        for (int i = 257; i > 16; --i)
+        {
+            while (count[i] > 0)
+            {
+                int j = i - 2;
+                while (count[j] == 0)
+                    --j;
+
+                count[i] -= 2;
+                count[i - 1]++;
+                count[j + 1] += 2;
+                count[j]--;
+            }
+        }
+
+        // remove the reserved symbol, which has the longest code
+        int longest = 16;
+        while (longest > 0 && count[longest] == 0)
+            --longest;
+
+        u8 bits_[16];
+        u8 values_[256];
+
+        if (longest == 0)
+        {
+            // no symbols were counted; emit a valid table with a single code
+            std::memset(bits_, 0, 16);
+            bits_[0] = 1;
+            values_[0] = 0;
+        }
+        else
+        {
+            count[longest]--;
+
+            for (int i = 0; i < 16; ++i)
+            {
+                bits_[i] = u8(count[i + 1]);
+            }
+
+            int k = 0;
+
+            for (int length = 1; length < 257; ++length)
+            {
+                for (int symbol = 0; symbol < 256; ++symbol)
+                {
+                    if (codesize[symbol] == length)
+                    {
+                        values_[k++] = u8(symbol);
+                    }
+                }
+            }
+        }
+
+        init(bits_, values_);
+    }
+
+    void HuffmanTable::write(BigEndianStream& p, u8 index) const
+    {
+        int count = 0;
+
+        for (int i = 0; i < 16; ++i)
+        {
+            count += bits[i];
+        }
+
+        // Define Huffman Table marker
+        p.write16(0xffc4);
+        p.write16(u16(19 + count));
+        p.write8(index); // Tc, Th
+        p.write(bits, 16);
+        p.write(values, count);
+    }
+
+    struct jpeg_scan
+    {
+        int         count;          // number of components in scan
+        int         component[3];   // channel indices
+        int         Ss;             // spectral selection
+        int         Se;
+        int         Ah;             // successive approximation
+        int         Al;
     };
 
+    struct jpeg_encode;
+
+    // convert MCU pixels into Y, Cb and Cr planes of mcu_width x mcu_height samples
+    typedef void (*ReadFunc)(jpeg_encode* jp, BlockType* block, const u8* input, int stride, int rows, int cols);
+
+    // convert count (multiple of 8) 32 bit pixels into Y, Cb and Cr samples
+    typedef void (*ColorFunc)(BlockType* y, BlockType* cb, BlockType* cr, const u8* input, int count);
+
+    // forward DCT of 8x8 samples with quantization; the output is in zigzag order
+    typedef void (*FDCTFunc)(BlockType* dest, const BlockType* data, int stride, const u16* qtable);
+
     struct jpeg_encode
     {
         int         mcu_width;
@@ -262,8 +415,7 @@ namespace
         int         cols_in_right_mcus;
         int         rows_in_bottom_mcus;
 
-        int         length_minus_mcu_width;
-        int         length_minus_width;
+        int         bytes_per_pixel;
         int         mcu_width_size;
 
         u8       Lqt [BLOCK_SIZE];
@@ -274,14 +426,28 @@ namespace
         // MCU configuration
         jpeg_chan   channel[3];
         int         channel_count;
+        int         blocks_in_mcu;
+        u8          sampling; // luminance sampling factors: 0x11, 0x21 or 0x22 (from the source when transcoding coefficients)
+
+        // huffman tables: 0 - luminance, 1 - chrominance
+        HuffmanTable dc_table[2];
+        HuffmanTable ac_table[2];
 
-        void (*read_format) (jpeg_encode* jp, BlockType *block, u8* input, int rows, int cols, int incr);
+        ReadFunc    read_format;
+        ColorFunc   color;
+        FDCTFunc    fdct;
 
-        jpeg_encode(jpegSampleFormat format, u32 width, u32 height, u32 stride, u32 quality);
+        jpeg_encode(jpegSampleFormat format, ImageEncodeOptions::Subsampling subsampling,
+                    u32 width, u32 height, u32 quality);
         ~jpeg_encode();
 
+        jpeg_encode(const CoefficientImage& image);
+
+        void init_geometry(u32 width, u32 height);
         void init_quantization_tables(u32 quality);
-        void write_markers(BigEndianStream& p, u32 format, u32 width, u32 height);
+        void write_markers(BigEndianStream& p, u32 width, u32 height, bool progressive);
+        void write_frame(BigEndianStream& p, u32 width, u32 height, bool progressive);
+        void write_scan_header(BigEndianStream& p, const jpeg_scan& scan, int interval) const;
     };
 
     struct HuffmanEncoder
@@ -297,7 +463,12 @@ namespace
 #endif
         int     bitindex;
 
-        HuffmanEncoder()
+        const HuffmanTable* dc_table;
+        const HuffmanTable* ac_table;
+
+        HuffmanEncoder(const HuffmanTable* dc, const HuffmanTable* ac)
+            : dc_table(dc)
+            , ac_table(ac)
         {
             ldc1 = 0;
             ldc2 = 0;
@@ -389,32 +560,32 @@ namespace
             return p;
         }
 
-        u8* encode(u8* p, int component, BlockType* temp)
+        u8* encode(u8* p, int component, const BlockType* temp)
         {
             const u16* DcCodeTable;
-            const u16* DcSizeTable;
+            const u8* DcSizeTable;
             const u16* AcCodeTable;
-            const u16* AcSizeTable;
+            const u8* AcSizeTable;
 
             int Coeff = *temp++;
             int LastDc;
 
             if (component == 1)
             {
-                DcCodeTable = luminance_dc_code_table;
-                DcSizeTable = luminance_dc_size_table;
-                AcCodeTable = luminance_ac_code_table;
-                AcSizeTable = luminance_ac_size_table;
+                DcCodeTable = dc_table[0].code;
+                DcSizeTable = dc_table[0].size;
+                AcCodeTable = ac_table[0].code;
+                AcSizeTable = ac_table[0].size;
 
                 LastDc = ldc1;
                 ldc1 = Coeff;
             }
             else
             {
-                DcCodeTable = chrominance_dc_code_table;
-                DcSizeTable = chrominance_dc_size_table;
-                AcCodeTable = chrominance_ac_code_table;
-                AcSizeTable = chrominance_ac_size_table;
+                DcCodeTable = dc_table[1].code;
+                DcSizeTable = dc_table[1].size;
+                AcCodeTable = ac_table[1].code;
+                AcSizeTable = ac_table[1].size;
 
                 if (component == 2)
                 {
@@ -459,8 +630,8 @@ namespace
                     {
                         RunLength -= 16;
 
-                        data = AcCodeTable [161];
-                        numbits = AcSizeTable [161];
+                        data = AcCodeTable [0xf0];
+                        numbits = AcSizeTable [0xf0];
                         p = putbits(p, data, numbits);
                     }
 
@@ -470,7 +641,7 @@ namespace
                     else
                         DataSize = bit_size [AbsCoeff >> 8] + 8;
 
-                    int index = RunLength * 10 + DataSize;
+                    int index = (RunLength << 4) + DataSize;
                     HuffCode = AcCodeTable [index];
                     HuffSize = AcSizeTable [index];
 
@@ -499,605 +670,1721 @@ namespace
         }
     };
 
-    void fdct(BlockType* dest, BlockType* data, const u16* quant_table)
+
+    // ----------------------------------------------------------------------------
+    // ScanEncoder
+    // ----------------------------------------------------------------------------
+
+    // Symbol counts for building optimal huffman tables: 0 - luminance, 1 - chrominance
+    struct HuffmanStatistics
     {
-        const u16 c1 = 1420;  // cos  PI/16 * root(2)
-        const u16 c2 = 1338;  // cos  PI/8  * root(2)
-        const u16 c3 = 1204;  // cos 3PI/16 * root(2)
-        const u16 c5 = 805;   // cos 5PI/16 * root(2)
-        const u16 c6 = 554;   // cos 3PI/8  * root(2)
-        const u16 c7 = 283;   // cos 7PI/16 * root(2)
+        u32     dc[2][256];
+        u32     ac[2][256];
 
-        for (int i = 0; i < 8; ++i)
+        HuffmanStatistics()
         {
-            int x8 = data [0] + data [7];
-            int x0 = data [0] - data [7];
-            int x7 = data [1] + data [6];
-            int x1 = data [1] - data [6];
-            int x6 = data [2] + data [5];
-            int x2 = data [2] - data [5];
-            int x5 = data [3] + data [4];
-            int x3 = data [3] - data [4];
-            int x4 = x8 + x5;
-            x8 = x8 - x5;
-            x5 = x7 + x6;
-            x7 = x7 - x6;
-            data[0] = BlockType(x4 + x5);
-            data[4] = BlockType(x4 - x5);
-            data[2] = BlockType((x8 * c2 + x7 * c6) >> 10);
-            data[6] = BlockType((x8 * c6 - x7 * c2) >> 10);
-            data[7] = BlockType((x0 * c7 - x1 * c5 + x2 * c3 - x3 * c1) >> 10);
-            data[5] = BlockType((x0 * c5 - x1 * c1 + x2 * c7 + x3 * c3) >> 10);
-            data[3] = BlockType((x0 * c3 - x1 * c7 - x2 * c1 - x3 * c5) >> 10);
-            data[1] = BlockType((x0 * c1 + x1 * c3 + x2 * c5 + x3 * c7) >> 10);
-            data += 8;
+            std::memset(dc, 0, sizeof(dc));
+            std::memset(ac, 0, sizeof(ac));
         }
 
-        data -= 64;
-
-        for (int i = 0; i < 8; ++i)
+        void add(const HuffmanStatistics& s)
         {
-            int x8 = data [i +  0] + data [i + 56];
-            int x0 = data [i +  0] - data [i + 56];
-            int x7 = data [i +  8] + data [i + 48];
-            int x1 = data [i +  8] - data [i + 48];
-            int x6 = data [i + 16] + data [i + 40];
-            int x2 = data [i + 16] - data [i + 40];
-            int x5 = data [i + 24] + data [i + 32];
-            int x3 = data [i + 24] - data [i + 32];
-            int x4 = x8 + x5;
-            x8 = x8 - x5;
-            x5 = x7 + x6;
-            x7 = x7 - x6;
-            auto v0 = BlockType((x4 + x5) >> 3);
-            auto v4 = BlockType((x4 - x5) >> 3);
-            auto v2 = BlockType((x8 * c2 + x7 * c6) >> 13);
-            auto v6 = BlockType((x8 * c6 - x7 * c2) >> 13);
-            auto v7 = BlockType((x0 * c7 - x1 * c5 + x2 * c3 - x3 * c1) >> 13);
-            auto v5 = BlockType((x0 * c5 - x1 * c1 + x2 * c7 + x3 * c3) >> 13);
-            auto v3 = BlockType((x0 * c3 - x1 * c7 - x2 * c1 - x3 * c5) >> 13);
-            auto v1 = BlockType((x0 * c1 + x1 * c3 + x2 * c5 + x3 * c7) >> 13);
-            dest[zigzag_table[i + 0 * 8]] = BlockType((v0 * quant_table[i + 0 * 8] + 0x4000) >> 15);
-            dest[zigzag_table[i + 1 * 8]] = BlockType((v1 * quant_table[i + 1 * 8] + 0x4000) >> 15);
-            dest[zigzag_table[i + 2 * 8]] = BlockType((v2 * quant_table[i + 2 * 8] + 0x4000) >> 15);
-            dest[zigzag_table[i + 3 * 8]] = BlockType((v3 * quant_table[i + 3 * 8] + 0x4000) >> 15);
-            dest[zigzag_table[i + 4 * 8]] = BlockType((v4 * quant_table[i + 4 * 8] + 0x4000) >> 15);
-            dest[zigzag_table[i + 5 * 8]] = BlockType((v5 * quant_table[i + 5 * 8] + 0x4000) >> 15);
-            dest[zigzag_table[i + 6 * 8]] = BlockType((v6 * quant_table[i + 6 * 8] + 0x4000) >> 15);
-            dest[zigzag_table[i + 7 * 8]] = BlockType((v7 * quant_table[i + 7 * 8] + 0x4000) >> 15);
+            for (int i = 0; i < 2; ++i)
+            {
+                for (int j = 0; j < 256; ++j)
+                {
+                    dc[i][j] += s.dc[i][j];
+                    ac[i][j] += s.ac[i][j];
+                }
+            }
         }
-    }
+    };
 
-    // ----------------------------------------------------------------------------
-    // read_xxx_format
-    // ----------------------------------------------------------------------------
+    // Entropy coder for one restart interval of a sequential or progressive scan.
+    // The gathering pass runs the same code with statistics and only counts the
+    // symbols; the encoding pass then writes them with the optimized tables.
+    // The progressive coding follows G.1.2 (and the libjpeg implementation).
 
-    void read_400_format(jpeg_encode* jp, BlockType* block, u8* input, int rows, int cols, int incr)
+    struct ScanEncoder
     {
-        for (int i = 0; i < rows; ++i)
+        enum { MAX_CORRECTION_BITS = 1000 };
+
+        const jpeg_scan&    scan;
+        const HuffmanTable* dc_table;
+        const HuffmanTable* ac_table;
+        HuffmanStatistics*  statistics;
+
+        HuffmanEncoder      huffman;
+        int                 last_dc[3];
+
+        // progressive AC: end-of-band run and correction bits buffered for it
+        int                 eobrun;
+        int                 correction_count;
+        u8                  correction[MAX_CORRECTION_BITS];
+
+        ScanEncoder(const jpeg_scan& scan, const HuffmanTable* dc, const HuffmanTable* ac, HuffmanStatistics* statistics)
+            : scan(scan)
+            , dc_table(dc)
+            , ac_table(ac)
+            , statistics(statistics)
+            , huffman(dc, ac)
+            , eobrun(0)
+            , correction_count(0)
         {
-            for (int j = cols; j > 0; --j)
-            {
-                *block++ = (*input++) - 128;
-            }
+            last_dc[0] = 0;
+            last_dc[1] = 0;
+            last_dc[2] = 0;
+        }
 
-            // replicate last column
-            for (int j = 8 - cols; j > 0; --j)
+        static int bitlength(int value)
+        {
+            return (value >> 8) ? bit_size[value >> 8] + 8 : bit_size[value];
+        }
+
+        u8* putSymbol(u8* p, bool ac, int table, int symbol)
+        {
+            if (statistics)
             {
-                *block = *(block - 1);
-                ++block;
+                ++(ac ? statistics->ac : statistics->dc)[table][symbol];
+                return p;
             }
 
-            input += incr;
+            const HuffmanTable& h = ac ? ac_table[table] : dc_table[table];
+            return huffman.putbits(p, h.code[symbol], h.size[symbol]);
         }
 
-        // replicate last row
-        for (int i = 8 - rows; i > 0; --i)
+        u8* putBits(u8* p, u32 value, int count)
         {
-            for (int j = 8; j > 0; --j)
-            {
-                *block = *(block - 8);
-                ++block;
-            }
+            if (statistics || !count)
+                return p;
+
+            return huffman.putbits(p, value & ((1u << count) - 1), count);
         }
-    }
 
-    void read_bgr888_format(jpeg_encode* jp, BlockType* block, u8* input, int rows, int cols, int incr)
-    {
-        for (int i = 0; i < rows; ++i)
+        // symbol (run << 4 | size) followed by the value in size bits
+        u8* putValue(u8* p, bool ac, int table, int run, int value)
         {
-            for (int j = 0; j < cols; ++j)
+            int absolute = value < 0 ? -value : value;
+            const int size = bitlength(absolute);
+
+            if (value < 0)
             {
-                int r = input[2];
-                int g = input[1];
-                int b = input[0];
-                int y = (76 * r + 151 * g + 29 * b) >> 8;
-                int cr = ((r - y) * 182) >> 8;
-                int cb = ((b - y) * 144) >> 8;
-                block[0 * 64] = BlockType(y - 128);
-                block[1 * 64] = BlockType(cb);
-                block[2 * 64] = BlockType(cr);
-                ++block;
-                input += 3;
+                // negative values are stored as ones' complement
+                --value;
             }
 
-            // replicate last column
-            for (int j = 8 - cols; j > 0; --j)
+            p = putSymbol(p, ac, table, (run << 4) | size);
+            return putBits(p, u32(value), size);
+        }
+
+        u8* putCorrectionBits(u8* p, const u8* bits, int count)
+        {
+            for (int i = 0; i < count; ++i)
             {
-                block[0 * 64] = block[0 * 64 - 1];
-                block[1 * 64] = block[1 * 64 - 1];
-                block[2 * 64] = block[2 * 64 - 1];
-                ++block;
+                p = putBits(p, bits[i], 1);
             }
 
-            input += incr;
+            return p;
         }
 
-        // replicate last row
-        for (int i = 8 - rows; i > 0; --i)
+        u8* flushEOBRun(u8* p)
         {
-            for (int j = 8; j > 0; --j)
+            if (eobrun > 0)
             {
-                block[0 * 64] = block[0 * 64 - 8];
-                block[1 * 64] = block[1 * 64 - 8];
-                block[2 * 64] = block[2 * 64 - 8];
-                ++block;
+                const int table = scan.component[0] ? 1 : 0;
+                const int size = bitlength(eobrun) - 1;
+
+                p = putSymbol(p, true, table, size << 4);
+                p = putBits(p, eobrun, size);
+                eobrun = 0;
+
+                p = putCorrectionBits(p, correction, correction_count);
+                correction_count = 0;
             }
+
+            return p;
         }
-    }
 
-    void read_rgb888_format(jpeg_encode* jp, BlockType* block, u8* input, int rows, int cols, int incr)
-    {
-        for (int i = 0; i < rows; ++i)
+        u8* encodeSequential(u8* p, int channel, const BlockType* block)
         {
-            for (int j = 0; j < cols; ++j)
+            const int table = channel ? 1 : 0;
+
+            const int dc = block[0];
+            p = putValue(p, false, table, 0, dc - last_dc[channel]);
+            last_dc[channel] = dc;
+
+            int run = 0;
+
+            for (int k = 1; k < 64; ++k)
             {
-                int r = input[0];
-                int g = input[1];
-                int b = input[2];
-                int y = (76 * r + 151 * g + 29 * b) >> 8;
-                int cr = ((r - y) * 182) >> 8;
-                int cb = ((b - y) * 144) >> 8;
-                block[0 * 64] = BlockType(y - 128);
-                block[1 * 64] = BlockType(cb);
-                block[2 * 64] = BlockType(cr);
-                ++block;
-                input += 3;
+                const int value = block[k];
+                if (!value)
+                {
+                    ++run;
+                    continue;
+                }
+
+                while (run > 15)
+                {
+                    p = putSymbol(p, true, table, 0xf0);
+                    run -= 16;
+                }
+
+                p = putValue(p, true, table, run, value);
+                run = 0;
             }
 
-            // replicate last column
-            for (int j = 8 - cols; j > 0; --j)
+            if (run > 0)
             {
-                block[0 * 64] = block[0 * 64 - 1];
-                block[1 * 64] = block[1 * 64 - 1];
-                block[2 * 64] = block[2 * 64 - 1];
-                ++block;
+                p = putSymbol(p, true, table, 0x00);
             }
 
-            input += incr;
+            return p;
         }
 
-        // replicate last row
-        for (int i = 8 - rows; i > 0; --i)
+        u8* encodeDCFirst(u8* p, int channel, const BlockType* block)
         {
-            for (int j = 8; j > 0; --j)
-            {
-                block[0 * 64] = block[0 * 64 - 8];
-                block[1 * 64] = block[1 * 64 - 8];
-                block[2 * 64] = block[2 * 64 - 8];
-                ++block;
-            }
+            // point transform is an arithmetic shift for the DC
+            const int dc = block[0] >> scan.Al;
+            p = putValue(p, false, channel ? 1 : 0, 0, dc - last_dc[channel]);
+            last_dc[channel] = dc;
+            return p;
         }
-    }
 
-    void read_bgra8888_format(jpeg_encode* jp, BlockType* block, u8* input, int rows, int cols, int incr)
-    {
-        for (int i = 0; i < rows; ++i)
+        u8* encodeDCRefine(u8* p, const BlockType* block)
         {
-            for (int j = 0; j < cols; ++j)
+            return putBits(p, (block[0] >> scan.Al) & 1, 1);
+        }
+
+        u8* encodeACFirst(u8* p, const BlockType* block)
+        {
+            const int table = scan.component[0] ? 1 : 0;
+            int run = 0;
+
+            for (int k = scan.Ss; k <= scan.Se; ++k)
             {
-                int r = input[2];
-                int g = input[1];
-                int b = input[0];
-                int y = (76 * r + 151 * g + 29 * b) >> 8;
-                int cr = ((r - y) * 182) >> 8;
-                int cb = ((b - y) * 144) >> 8;
-                block[0 * 64] = BlockType(y - 128);
-                block[1 * 64] = BlockType(cb);
-                block[2 * 64] = BlockType(cr);
-                ++block;
-                input += 4;
+                const int value = block[k];
+
+                // point transform of the magnitude
+                int absolute = (value < 0 ? -value : value) >> scan.Al;
+                if (!absolute)
+                {
+                    ++run;
+                    continue;
+                }
+
+                p = flushEOBRun(p);
+
+                while (run > 15)
+                {
+                    p = putSymbol(p, true, table, 0xf0);
+                    run -= 16;
+                }
+
+                p = putValue(p, true, table, run, value < 0 ? -absolute : absolute);
+                run = 0;
             }
 
-            // replicate last column
-            for (int j = 8 - cols; j > 0; --j)
+            if (run > 0)
             {
-                block[0 * 64] = block[0 * 64 - 1];
-                block[1 * 64] = block[1 * 64 - 1];
-                block[2 * 64] = block[2 * 64 - 1];
-                ++block;
+                if (++eobrun == 0x7fff)
+                {
+                    p = flushEOBRun(p);
+                }
             }
 
-            input += incr;
+            return p;
         }
 
-        // replicate last row
-        for (int i = 8 - rows; i > 0; --i)
+        u8* encodeACRefine(u8* p, const BlockType* block)
         {
-            for (int j = 8; j > 0; --j)
+            const int table = scan.component[0] ? 1 : 0;
+
+            int absolute[64];
+            int eob = 0;
+
+            for (int k = scan.Ss; k <= scan.Se; ++k)
             {
-                block[0 * 64] = block[0 * 64 - 8];
-                block[1 * 64] = block[1 * 64 - 8];
-                block[2 * 64] = block[2 * 64 - 8];
-                ++block;
+                const int value = block[k];
+                absolute[k] = (value < 0 ? -value : value) >> scan.Al;
+
+                // last coefficient which becomes nonzero in this scan
+                if (absolute[k] == 1)
+                    eob = k;
             }
-        }
-    }
 
-    void read_rgba8888_format(jpeg_encode* jp, BlockType* block, u8* input, int rows, int cols, int incr)
-    {
-        for (int i = 0; i < rows; ++i)
-        {
-            for (int j = 0; j < cols; ++j)
+            int run = 0;
+
+            // correction bits of this block are appended after the ones of the EOB run
+            u8* bits = correction + correction_count;
+            int count = 0;
+
+            for (int k = scan.Ss; k <= scan.Se; ++k)
             {
-                int r = input[0];
-                int g = input[1];
-                int b = input[2];
-                int y = (76 * r + 151 * g + 29 * b) >> 8;
-                int cr = ((r - y) * 182) >> 8;
-                int cb = ((b - y) * 144) >> 8;
-                block[0 * 64] = BlockType(y - 128);
-                block[1 * 64] = BlockType(cb);
-                block[2 * 64] = BlockType(cr);
-                ++block;
-                input += 4;
+                const int value = absolute[k];
+                if (!value)
+                {
+                    ++run;
+                    continue;
+                }
+
+                while (run > 15 && k <= eob)
+                {
+                    p = flushEOBRun(p);
+                    p = putSymbol(p, true, table, 0xf0);
+                    run -= 16;
+
+                    p = putCorrectionBits(p, bits, count);
+                    bits = correction;
+                    count = 0;
+                }
+
+                if (value > 1)
+                {
+                    // previously nonzero coefficient: buffer the correction bit
+                    bits[count++] = u8(value & 1);
+                    continue;
+                }
+
+                // newly nonzero coefficient: symbol, sign and the buffered corrections
+                p = flushEOBRun(p);
+                p = putSymbol(p, true, table, (run << 4) | 1);
+                p = putBits(p, block[k] < 0 ? 0 : 1, 1);
+
+                p = putCorrectionBits(p, bits, count);
+                bits = correction;
+                count = 0;
+                run = 0;
             }
 
-            // replicate last column
-            for (int j = 8 - cols; j > 0; --j)
+            if (run > 0 || count > 0)
             {
-                block[0 * 64] = block[0 * 64 - 1];
-                block[1 * 64] = block[1 * 64 - 1];
-                block[2 * 64] = block[2 * 64 - 1];
-                ++block;
+                ++eobrun;
+                correction_count += count;
+
+                if (eobrun == 0x7fff || correction_count > MAX_CORRECTION_BITS - 64 + 1)
+                {
+                    p = flushEOBRun(p);
+                }
             }
 
-            input += incr;
+            return p;
         }
 
-        // replicate last row
-        for (int i = 8 - rows; i > 0; --i)
+        u8* encode(u8* p, int channel, const BlockType* block)
         {
-            for (int j = 8; j > 0; --j)
+            if (scan.Ss == 0)
             {
-                block[0 * 64] = block[0 * 64 - 8];
-                block[1 * 64] = block[1 * 64 - 8];
-                block[2 * 64] = block[2 * 64 - 8];
-                ++block;
+                if (scan.Se > 0)
+                    return encodeSequential(p, channel, block);
+                if (scan.Ah == 0)
+                    return encodeDCFirst(p, channel, block);
+                return encodeDCRefine(p, block);
             }
-        }
-    }
 
-    // ----------------------------------------------------------------------------
-    // jpeg_encode methods
-    // ----------------------------------------------------------------------------
+            if (scan.Ah == 0)
+                return encodeACFirst(p, block);
+            return encodeACRefine(p, block);
+        }
 
-    jpeg_encode::jpeg_encode(jpegSampleFormat format, u32 width, u32 height, u32 stride, u32 quality)
+        u8* flush(u8* p)
+        {
+            p = flushEOBRun(p);
+            return huffman.flush(p);
+        }
+    };
+
+    // Sequential scans with optimized tables
+    const jpeg_scan g_sequential_scan_y [] =
+    {
+        { 1, { 0 }, 0, 63, 0, 0 },
+    };
+
+    const jpeg_scan g_sequential_scan_ycbcr [] =
+    {
+        { 3, { 0, 1, 2 }, 0, 63, 0, 0 },
+    };
+
+    // Progressive scripts; the same as libjpeg's jpeg_simple_progression()
+    const jpeg_scan g_progressive_scan_y [] =
+    {
+        { 1, { 0 }, 0,  0, 0, 1 },
+        { 1, { 0 }, 1,  5, 0, 2 },
+        { 1, { 0 }, 6, 63, 0, 2 },
+        { 1, { 0 }, 1, 63, 2, 1 },
+        { 1, { 0 }, 0,  0, 1, 0 },
+        { 1, { 0 }, 1, 63, 1, 0 },
+    };
+
+    const jpeg_scan g_progressive_scan_ycbcr [] =
+    {
+        { 3, { 0, 1, 2 }, 0,  0, 0, 1 },
+        { 1, { 0 },       1,  5, 0, 2 },
+        { 1, { 2 },       1, 63, 0, 1 },
+        { 1, { 1 },       1, 63, 0, 1 },
+        { 1, { 0 },       6, 63, 0, 2 },
+        { 1, { 0 },       1, 63, 2, 1 },
+        { 3, { 0, 1, 2 }, 0,  0, 1, 0 },
+        { 1, { 2 },       1, 63, 1, 0 },
+        { 1, { 1 },       1, 63, 1, 0 },
+        { 1, { 0 },       1, 63, 1, 0 },
+    };
+
+    // ----------------------------------------------------------------------------
+    // fdct
+    // ----------------------------------------------------------------------------
+
+    // The SIMD implementations compute the same integer transform with the same
+    // intermediate precision as the scalar code so the output is bit-exact.
+
+    const int fdct_c1 = 1420;  // cos  PI/16 * root(2)
+    const int fdct_c2 = 1338;  // cos  PI/8  * root(2)
+    const int fdct_c3 = 1204;  // cos 3PI/16 * root(2)
+    const int fdct_c5 = 805;   // cos 5PI/16 * root(2)
+    const int fdct_c6 = 554;   // cos 3PI/8  * root(2)
+    const int fdct_c7 = 283;   // cos 7PI/16 * root(2)
+
+    void fdct(BlockType* dest, const BlockType* source, int stride, const u16* quant_table)
+    {
+        const int c1 = fdct_c1;
+        const int c2 = fdct_c2;
+        const int c3 = fdct_c3;
+        const int c5 = fdct_c5;
+        const int c6 = fdct_c6;
+        const int c7 = fdct_c7;
+
+        BlockType data[64];
+
+        for (int i = 0; i < 8; ++i)
+        {
+            const BlockType* s = source + i * stride;
+            BlockType* d = data + i * 8;
+            int x8 = s [0] + s [7];
+            int x0 = s [0] - s [7];
+            int x7 = s [1] + s [6];
+            int x1 = s [1] - s [6];
+            int x6 = s [2] + s [5];
+            int x2 = s [2] - s [5];
+            int x5 = s [3] + s [4];
+            int x3 = s [3] - s [4];
+            int x4 = x8 + x5;
+            x8 = x8 - x5;
+            x5 = x7 + x6;
+            x7 = x7 - x6;
+            d[0] = BlockType(x4 + x5);
+            d[4] = BlockType(x4 - x5);
+            d[2] = BlockType((x8 * c2 + x7 * c6) >> 10);
+            d[6] = BlockType((x8 * c6 - x7 * c2) >> 10);
+            d[7] = BlockType((x0 * c7 - x1 * c5 + x2 * c3 - x3 * c1) >> 10);
+            d[5] = BlockType((x0 * c5 - x1 * c1 + x2 * c7 + x3 * c3) >> 10);
+            d[3] = BlockType((x0 * c3 - x1 * c7 - x2 * c1 - x3 * c5) >> 10);
+            d[1] = BlockType((x0 * c1 + x1 * c3 + x2 * c5 + x3 * c7) >> 10);
+        }
+
+        for (int i = 0; i < 8; ++i)
+        {
+            int x8 = data [i +  0] + data [i + 56];
+            int x0 = data [i +  0] - data [i + 56];
+            int x7 = data [i +  8] + data [i + 48];
+            int x1 = data [i +  8] - data [i + 48];
+            int x6 = data [i + 16] + data [i + 40];
+            int x2 = data [i + 16] - data [i + 40];
+            int x5 = data [i + 24] + data [i + 32];
+            int x3 = data [i + 24] - data [i + 32];
+            int x4 = x8 + x5;
+            x8 = x8 - x5;
+            x5 = x7 + x6;
+            x7 = x7 - x6;
+            auto v0 = BlockType((x4 + x5) >> 3);
+            auto v4 = BlockType((x4 - x5) >> 3);
+            auto v2 = BlockType((x8 * c2 + x7 * c6) >> 13);
+            auto v6 = BlockType((x8 * c6 - x7 * c2) >> 13);
+            auto v7 = BlockType((x0 * c7 - x1 * c5 + x2 * c3 - x3 * c1) >> 13);
+            auto v5 = BlockType((x0 * c5 - x1 * c1 + x2 * c7 + x3 * c3) >> 13);
+            auto v3 = BlockType((x0 * c3 - x1 * c7 - x2 * c1 - x3 * c5) >> 13);
+            auto v1 = BlockType((x0 * c1 + x1 * c3 + x2 * c5 + x3 * c7) >> 13);
+            dest[zigzag_table[i + 0 * 8]] = BlockType((v0 * quant_table[i + 0 * 8] + 0x4000) >> 15);
+            dest[zigzag_table[i + 1 * 8]] = BlockType((v1 * quant_table[i + 1 * 8] + 0x4000) >> 15);
+            dest[zigzag_table[i + 2 * 8]] = BlockType((v2 * quant_table[i + 2 * 8] + 0x4000) >> 15);
+            dest[zigzag_table[i + 3 * 8]] = BlockType((v3 * quant_table[i + 3 * 8] + 0x4000) >> 15);
+            dest[zigzag_table[i + 4 * 8]] = BlockType((v4 * quant_table[i + 4 * 8] + 0x4000) >> 15);
+            dest[zigzag_table[i + 5 * 8]] = BlockType((v5 * quant_table[i + 5 * 8] + 0x4000) >> 15);
+            dest[zigzag_table[i + 6 * 8]] = BlockType((v6 * quant_table[i + 6 * 8] + 0x4000) >> 15);
+            dest[zigzag_table[i + 7 * 8]] = BlockType((v7 * quant_table[i + 7 * 8] + 0x4000) >> 15);
+        }
+    }
+
+#if defined(JPEG_ENABLE_SSE2)
+
+    // (a * ca + b * cb) >> shift for 8 lanes, computed in 32 bits
+    static inline __m128i fdct_madd2(__m128i a, __m128i b, int ca, int cb, int shift)
+    {
+        const __m128i k = _mm_set1_epi32(int((u32(cb) << 16) | (u32(ca) & 0xffff)));
+        __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi16(a, b), k);
+        __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi16(a, b), k);
+        lo = _mm_srai_epi32(lo, shift);
+        hi = _mm_srai_epi32(hi, shift);
+        return _mm_packs_epi32(lo, hi);
+    }
+
+    // (a * ca + b * cb + c * cc + d * cd) >> shift for 8 lanes, computed in 32 bits
+    static inline __m128i fdct_madd4(__m128i a, __m128i b, __m128i c, __m128i d,
+                                     int ca, int cb, int cc, int cd, int shift)
+    {
+        const __m128i k0 = _mm_set1_epi32(int((u32(cb) << 16) | (u32(ca) & 0xffff)));
+        const __m128i k1 = _mm_set1_epi32(int((u32(cd) << 16) | (u32(cc) & 0xffff)));
+        __m128i lo = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(a, b), k0),
+                                   _mm_madd_epi16(_mm_unpacklo_epi16(c, d), k1));
+        __m128i hi = _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(a, b), k0),
+                                   _mm_madd_epi16(_mm_unpackhi_epi16(c, d), k1));
+        lo = _mm_srai_epi32(lo, shift);
+        hi = _mm_srai_epi32(hi, shift);
+        return _mm_packs_epi32(lo, hi);
+    }
+
+    // one dimensional transform; the lanes are independent transforms of v[0..7]
+    static inline void fdct_pass_sse2(__m128i* v, int shift, int dcshift)
+    {
+        __m128i x8 = _mm_add_epi16(v[0], v[7]);
+        __m128i x0 = _mm_sub_epi16(v[0], v[7]);
+        __m128i x7 = _mm_add_epi16(v[1], v[6]);
+        __m128i x1 = _mm_sub_epi16(v[1], v[6]);
+        __m128i x6 = _mm_add_epi16(v[2], v[5]);
+        __m128i x2 = _mm_sub_epi16(v[2], v[5]);
+        __m128i x5 = _mm_add_epi16(v[3], v[4]);
+        __m128i x3 = _mm_sub_epi16(v[3], v[4]);
+        __m128i x4 = _mm_add_epi16(x8, x5);
+        x8 = _mm_sub_epi16(x8, x5);
+        x5 = _mm_add_epi16(x7, x6);
+        x7 = _mm_sub_epi16(x7, x6);
+
+        v[0] = _mm_srai_epi16(_mm_add_epi16(x4, x5), dcshift);
+        v[4] = _mm_srai_epi16(_mm_sub_epi16(x4, x5), dcshift);
+        v[2] = fdct_madd2(x8, x7, fdct_c2, fdct_c6, shift);
+        v[6] = fdct_madd2(x8, x7, fdct_c6, -fdct_c2, shift);
+        v[7] = fdct_madd4(x0, x1, x2, x3, fdct_c7, -fdct_c5, fdct_c3, -fdct_c1, shift);
+        v[5] = fdct_madd4(x0, x1, x2, x3, fdct_c5, -fdct_c1, fdct_c7, fdct_c3, shift);
+        v[3] = fdct_madd4(x0, x1, x2, x3, fdct_c3, -fdct_c7, -fdct_c1, -fdct_c5, shift);
+        v[1] = fdct_madd4(x0, x1, x2, x3, fdct_c1, fdct_c3, fdct_c5, fdct_c7, shift);
+    }
+
+    static inline void fdct_transpose_sse2(__m128i* v)
+    {
+        __m128i a0 = _mm_unpacklo_epi16(v[0], v[1]);
+        __m128i a1 = _mm_unpackhi_epi16(v[0], v[1]);
+        __m128i a2 = _mm_unpacklo_epi16(v[2], v[3]);
+        __m128i a3 = _mm_unpackhi_epi16(v[2], v[3]);
+        __m128i a4 = _mm_unpacklo_epi16(v[4], v[5]);
+        __m128i a5 = _mm_unpackhi_epi16(v[4], v[5]);
+        __m128i a6 = _mm_unpacklo_epi16(v[6], v[7]);
+        __m128i a7 = _mm_unpackhi_epi16(v[6], v[7]);
+
+        __m128i b0 = _mm_unpacklo_epi32(a0, a2);
+        __m128i b1 = _mm_unpackhi_epi32(a0, a2);
+        __m128i b2 = _mm_unpacklo_epi32(a1, a3);
+        __m128i b3 = _mm_unpackhi_epi32(a1, a3);
+        __m128i b4 = _mm_unpacklo_epi32(a4, a6);
+        __m128i b5 = _mm_unpackhi_epi32(a4, a6);
+        __m128i b6 = _mm_unpacklo_epi32(a5, a7);
+        __m128i b7 = _mm_unpackhi_epi32(a5, a7);
+
+        v[0] = _mm_unpacklo_epi64(b0, b4);
+        v[1] = _mm_unpackhi_epi64(b0, b4);
+        v[2] = _mm_unpacklo_epi64(b1, b5);
+        v[3] = _mm_unpackhi_epi64(b1, b5);
+        v[4] = _mm_unpacklo_epi64(b2, b6);
+        v[5] = _mm_unpackhi_epi64(b2, b6);
+        v[6] = _mm_unpacklo_epi64(b3, b7);
+        v[7] = _mm_unpackhi_epi64(b3, b7);
+    }
+
+    void fdct_sse2(BlockType* dest, const BlockType* source, int stride, const u16* quant_table)
+    {
+        __m128i v[8];
+
+        for (int i = 0; i < 8; ++i)
+        {
+            v[i] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(source + i * stride));
+        }
+
+        // rows
+        fdct_transpose_sse2(v);
+        fdct_pass_sse2(v, 10, 0);
+        fdct_transpose_sse2(v);
+
+        // columns
+        fdct_pass_sse2(v, 13, 3);
+
+        // quantize: (v * q + 0x4000) >> 15
+        const __m128i bias = _mm_set1_epi16(0x4000);
+        const __m128i one = _mm_set1_epi16(1);
+
+        BlockType temp[64];
+
+        for (int i = 0; i < 8; ++i)
+        {
+            __m128i q = _mm_loadu_si128(reinterpret_cast<const __m128i *>(quant_table + i * 8));
+            __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi16(v[i], one), _mm_unpacklo_epi16(q, bias));
+            __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi16(v[i], one), _mm_unpackhi_epi16(q, bias));
+            lo = _mm_srai_epi32(lo, 15);
+            hi = _mm_srai_epi32(hi, 15);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(temp + i * 8), _mm_packs_epi32(lo, hi));
+        }
+
+        for (int i = 0; i < 64; ++i)
+        {
+            dest[zigzag_table[i]] = temp[i];
+        }
+    }
+
+#endif // JPEG_ENABLE_SSE2
+
+#if defined(JPEG_ENABLE_NEON)
+
+    // (a * ca + b * cb) >> shift for 8 lanes, computed in 32 bits
+    static inline int16x8_t fdct_mul2(int16x8_t a, int16x8_t b, int ca, int cb, int32x4_t shift)
+    {
+        int32x4_t lo = vmull_n_s16(vget_low_s16(a), s16(ca));
+        int32x4_t hi = vmull_n_s16(vget_high_s16(a), s16(ca));
+        lo = vmlal_n_s16(lo, vget_low_s16(b), s16(cb));
+        hi = vmlal_n_s16(hi, vget_high_s16(b), s16(cb));
+        return vcombine_s16(vmovn_s32(vshlq_s32(lo, shift)), vmovn_s32(vshlq_s32(hi, shift)));
+    }
+
+    // (a * ca + b * cb + c * cc + d * cd) >> shift for 8 lanes, computed in 32 bits
+    static inline int16x8_t fdct_mul4(int16x8_t a, int16x8_t b, int16x8_t c, int16x8_t d,
+                                      int ca, int cb, int cc, int cd, int32x4_t shift)
+    {
+        int32x4_t lo = vmull_n_s16(vget_low_s16(a), s16(ca));
+        int32x4_t hi = vmull_n_s16(vget_high_s16(a), s16(ca));
+        lo = vmlal_n_s16(lo, vget_low_s16(b), s16(cb));
+        hi = vmlal_n_s16(hi, vget_high_s16(b), s16(cb));
+        lo = vmlal_n_s16(lo, vget_low_s16(c), s16(cc));
+        hi = vmlal_n_s16(hi, vget_high_s16(c), s16(cc));
+        lo = vmlal_n_s16(lo, vget_low_s16(d), s16(cd));
+        hi = vmlal_n_s16(hi, vget_high_s16(d), s16(cd));
+        return vcombine_s16(vmovn_s32(vshlq_s32(lo, shift)), vmovn_s32(vshlq_s32(hi, shift)));
+    }
+
+    static inline void fdct_pass_neon(int16x8_t* v, int shift, int dcshift)
+    {
+        const int32x4_t s = vdupq_n_s32(-shift);
+        const int16x8_t dcs = vdupq_n_s16(s16(-dcshift));
+
+        int16x8_t x8 = vaddq_s16(v[0], v[7]);
+        int16x8_t x0 = vsubq_s16(v[0], v[7]);
+        int16x8_t x7 = vaddq_s16(v[1], v[6]);
+        int16x8_t x1 = vsubq_s16(v[1], v[6]);
+        int16x8_t x6 = vaddq_s16(v[2], v[5]);
+        int16x8_t x2 = vsubq_s16(v[2], v[5]);
+        int16x8_t x5 = vaddq_s16(v[3], v[4]);
+        int16x8_t x3 = vsubq_s16(v[3], v[4]);
+        int16x8_t x4 = vaddq_s16(x8, x5);
+        x8 = vsubq_s16(x8, x5);
+        x5 = vaddq_s16(x7, x6);
+        x7 = vsubq_s16(x7, x6);
+
+        v[0] = vshlq_s16(vaddq_s16(x4, x5), dcs);
+        v[4] = vshlq_s16(vsubq_s16(x4, x5), dcs);
+        v[2] = fdct_mul2(x8, x7, fdct_c2, fdct_c6, s);
+        v[6] = fdct_mul2(x8, x7, fdct_c6, -fdct_c2, s);
+        v[7] = fdct_mul4(x0, x1, x2, x3, fdct_c7, -fdct_c5, fdct_c3, -fdct_c1, s);
+        v[5] = fdct_mul4(x0, x1, x2, x3, fdct_c5, -fdct_c1, fdct_c7, fdct_c3, s);
+        v[3] = fdct_mul4(x0, x1, x2, x3, fdct_c3, -fdct_c7, -fdct_c1, -fdct_c5, s);
+        v[1] = fdct_mul4(x0, x1, x2, x3, fdct_c1, fdct_c3, fdct_c5, fdct_c7, s);
+    }
+
+    static inline void fdct_transpose_neon(int16x8_t* v)
+    {
+        int16x8x2_t t0 = vtrnq_s16(v[0], v[1]);
+        int16x8x2_t t1 = vtrnq_s16(v[2], v[3]);
+        int16x8x2_t t2 = vtrnq_s16(v[4], v[5]);
+        int16x8x2_t t3 = vtrnq_s16(v[6], v[7]);
+
+        int32x4x2_t u0 = vtrnq_s32(vreinterpretq_s32_s16(t0.val[0]), vreinterpretq_s32_s16(t1.val[0]));
+        int32x4x2_t u1 = vtrnq_s32(vreinterpretq_s32_s16(t0.val[1]), vreinterpretq_s32_s16(t1.val[1]));
+        int32x4x2_t u2 = vtrnq_s32(vreinterpretq_s32_s16(t2.val[0]), vreinterpretq_s32_s16(t3.val[0]));
+        int32x4x2_t u3 = vtrnq_s32(vreinterpretq_s32_s16(t2.val[1]), vreinterpretq_s32_s16(t3.val[1]));
+
+        v[0] = vreinterpretq_s16_s32(vcombine_s32(vget_low_s32(u0.val[0]), vget_low_s32(u2.val[0])));
+        v[1] = vreinterpretq_s16_s32(vcombine_s32(vget_low_s32(u1.val[0]), vget_low_s32(u3.val[0])));
+        v[2] = vreinterpretq_s16_s32(vcombine_s32(vget_low_s32(u0.val[1]), vget_low_s32(u2.val[1])));
+        v[3] = vreinterpretq_s16_s32(vcombine_s32(vget_low_s32(u1.val[1]), vget_low_s32(u3.val[1])));
+        v[4] = vreinterpretq_s16_s32(vcombine_s32(vget_high_s32(u0.val[0]), vget_high_s32(u2.val[0])));
+        v[5] = vreinterpretq_s16_s32(vcombine_s32(vget_high_s32(u1.val[0]), vget_high_s32(u3.val[0])));
+        v[6] = vreinterpretq_s16_s32(vcombine_s32(vget_high_s32(u0.val[1]), vget_high_s32(u2.val[1])));
+        v[7] = vreinterpretq_s16_s32(vcombine_s32(vget_high_s32(u1.val[1]), vget_high_s32(u3.val[1])));
+    }
+
+    void fdct_neon(BlockType* dest, const BlockType* source, int stride, const u16* quant_table)
+    {
+        int16x8_t v[8];
+
+        for (int i = 0; i < 8; ++i)
+        {
+            v[i] = vld1q_s16(source + i * stride);
+        }
+
+        // rows
+        fdct_transpose_neon(v);
+        fdct_pass_neon(v, 10, 0);
+        fdct_transpose_neon(v);
+
+        // columns
+        fdct_pass_neon(v, 13, 3);
+
+        // quantize: (v * q + 0x4000) >> 15
+        const int32x4_t bias = vdupq_n_s32(0x4000);
+
+        BlockType temp[64];
+
+        for (int i = 0; i < 8; ++i)
+        {
+            int16x8_t q = vreinterpretq_s16_u16(vld1q_u16(quant_table + i * 8));
+            int32x4_t lo = vmlal_s16(bias, vget_low_s16(v[i]), vget_low_s16(q));
+            int32x4_t hi = vmlal_s16(bias, vget_high_s16(v[i]), vget_high_s16(q));
+            vst1q_s16(temp + i * 8, vcombine_s16(vshrn_n_s32(lo, 15), vshrn_n_s32(hi, 15)));
+        }
+
+        for (int i = 0; i < 64; ++i)
+        {
+            dest[zigzag_table[i]] = temp[i];
+        }
+    }
+
+#endif // JPEG_ENABLE_NEON
+
+    // ----------------------------------------------------------------------------
+    // color conversion
+    // ----------------------------------------------------------------------------
+
+    // Y  = (76 * r + 151 * g + 29 * b) >> 8
+    // Cb = ((b - y) * 144) >> 8 = ((b - y) * 9) >> 4
+    // Cr = ((r - y) * 182) >> 8 = ((r - y) * 91) >> 7
+    // The reduced forms fit in 16 bits and give identical results.
+
+    template <int R, int B>
+    void color_rgbx(BlockType* y, BlockType* cb, BlockType* cr, const u8* input, int count)
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            int r = input[R];
+            int g = input[1];
+            int b = input[B];
+            int luma = (76 * r + 151 * g + 29 * b) >> 8;
+            y[i] = BlockType(luma - 128);
+            cb[i] = BlockType(((b - luma) * 144) >> 8);
+            cr[i] = BlockType(((r - luma) * 182) >> 8);
+            input += 4;
+        }
+    }
+
+#if defined(JPEG_ENABLE_SSE2)
+
+    template <int R, int B>
+    void color_rgbx_sse2(BlockType* y, BlockType* cb, BlockType* cr, const u8* input, int count)
+    {
+        const __m128i mask = _mm_set1_epi32(0xff);
+        const __m128i c76 = _mm_set1_epi16(76);
+        const __m128i c151 = _mm_set1_epi16(151);
+        const __m128i c29 = _mm_set1_epi16(29);
+        const __m128i c9 = _mm_set1_epi16(9);
+        const __m128i c91 = _mm_set1_epi16(91);
+        const __m128i c128 = _mm_set1_epi16(128);
+
+        for (int i = 0; i < count; i += 8)
+        {
+            __m128i p0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(input + i * 4 + 0));
+            __m128i p1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(input + i * 4 + 16));
+
+            __m128i r = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, R * 8), mask),
+                                        _mm_and_si128(_mm_srli_epi32(p1, R * 8), mask));
+            __m128i g = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 8), mask),
+                                        _mm_and_si128(_mm_srli_epi32(p1, 8), mask));
+            __m128i b = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, B * 8), mask),
+                                        _mm_and_si128(_mm_srli_epi32(p1, B * 8), mask));
+
+            // the weighted sum is at most 255 * 256 so it fits in unsigned 16 bits
+            __m128i luma = _mm_add_epi16(_mm_mullo_epi16(r, c76), _mm_mullo_epi16(g, c151));
+            luma = _mm_add_epi16(luma, _mm_mullo_epi16(b, c29));
+            luma = _mm_srli_epi16(luma, 8);
+
+            __m128i s_cb = _mm_srai_epi16(_mm_mullo_epi16(_mm_sub_epi16(b, luma), c9), 4);
+            __m128i s_cr = _mm_srai_epi16(_mm_mullo_epi16(_mm_sub_epi16(r, luma), c91), 7);
+
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(y + i), _mm_sub_epi16(luma, c128));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(cb + i), s_cb);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(cr + i), s_cr);
+        }
+    }
+
+#if defined(MANGO_ENABLE_DISPATCH)
+
+    template <int R, int B>
+    MANGO_TARGET("avx2")
+    void color_rgbx_avx2(BlockType* y, BlockType* cb, BlockType* cr, const u8* input, int count)
+    {
+        const __m256i mask = _mm256_set1_epi32(0xff);
+        const __m256i c76 = _mm256_set1_epi16(76);
+        const __m256i c151 = _mm256_set1_epi16(151);
+        const __m256i c29 = _mm256_set1_epi16(29);
+        const __m256i c9 = _mm256_set1_epi16(9);
+        const __m256i c91 = _mm256_set1_epi16(91);
+        const __m256i c128 = _mm256_set1_epi16(128);
+
+        int i = 0;
+
+        for ( ; i + 16 <= count; i += 16)
+        {
+            __m256i p0 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(input + i * 4 + 0));
+            __m256i p1 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(input + i * 4 + 32));
+
+            // the pack works within 128 bit lanes; the permute restores pixel order
+            __m256i r = _mm256_packs_epi32(_mm256_and_si256(_mm256_srli_epi32(p0, R * 8), mask),
+                                           _mm256_and_si256(_mm256_srli_epi32(p1, R * 8), mask));
+            __m256i g = _mm256_packs_epi32(_mm256_and_si256(_mm256_srli_epi32(p0, 8), mask),
+                                           _mm256_and_si256(_mm256_srli_epi32(p1, 8), mask));
+            __m256i b = _mm256_packs_epi32(_mm256_and_si256(_mm256_srli_epi32(p0, B * 8), mask),
+                                           _mm256_and_si256(_mm256_srli_epi32(p1, B * 8), mask));
+            r = _mm256_permute4x64_epi64(r, 0xd8);
+            g = _mm256_permute4x64_epi64(g, 0xd8);
+            b = _mm256_permute4x64_epi64(b, 0xd8);
+
+            __m256i luma = _mm256_add_epi16(_mm256_mullo_epi16(r, c76), _mm256_mullo_epi16(g, c151));
+            luma = _mm256_add_epi16(luma, _mm256_mullo_epi16(b, c29));
+            luma = _mm256_srli_epi16(luma, 8);
+
+            __m256i s_cb = _mm256_srai_epi16(_mm256_mullo_epi16(_mm256_sub_epi16(b, luma), c9), 4);
+            __m256i s_cr = _mm256_srai_epi16(_mm256_mullo_epi16(_mm256_sub_epi16(r, luma), c91), 7);
+
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(y + i), _mm256_sub_epi16(luma, c128));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(cb + i), s_cb);
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(cr + i), s_cr);
+        }
+
+        if (i < count)
+        {
+            color_rgbx_sse2<R, B>(y + i, cb + i, cr + i, input + i * 4, count - i);
+        }
+    }
+
+#endif // MANGO_ENABLE_DISPATCH
+
+#endif // JPEG_ENABLE_SSE2
+
+#if defined(JPEG_ENABLE_NEON)
+
+    template <int R, int B>
+    void color_rgbx_neon(BlockType* y, BlockType* cb, BlockType* cr, const u8* input, int count)
+    {
+        const int16x8_t c128 = vdupq_n_s16(128);
+
+        for (int i = 0; i < count; i += 8)
+        {
+            const uint8x8x4_t p = vld4_u8(input + i * 4);
+            const int16x8_t r = vreinterpretq_s16_u16(vmovl_u8(p.val[R]));
+            const int16x8_t g = vreinterpretq_s16_u16(vmovl_u8(p.val[1]));
+            const int16x8_t b = vreinterpretq_s16_u16(vmovl_u8(p.val[B]));
+
+            uint16x8_t sum = vmulq_n_u16(vreinterpretq_u16_s16(r), 76);
+            sum = vmlaq_n_u16(sum, vreinterpretq_u16_s16(g), 151);
+            sum = vmlaq_n_u16(sum, vreinterpretq_u16_s16(b), 29);
+            const int16x8_t luma = vreinterpretq_s16_u16(vshrq_n_u16(sum, 8));
+
+            const int16x8_t s_cb = vshrq_n_s16(vmulq_n_s16(vsubq_s16(b, luma), 9), 4);
+            const int16x8_t s_cr = vshrq_n_s16(vmulq_n_s16(vsubq_s16(r, luma), 91), 7);
+
+            vst1q_s16(y + i, vsubq_s16(luma, c128));
+            vst1q_s16(cb + i, s_cb);
+            vst1q_s16(cr + i, s_cr);
+        }
+    }
+
+#endif // JPEG_ENABLE_NEON
+
+    // ----------------------------------------------------------------------------
+    // chroma downsampling
+    // ----------------------------------------------------------------------------
+
+    // Box filter into one 8x8 block. The rounding bias alternates between columns
+    // so that the averages are not systematically biased in one direction.
+
+    void downsample_h2v1(BlockType* dest, const BlockType* source)
+    {
+        for (int y = 0; y < 8; ++y)
+        {
+            for (int x = 0; x < 8; ++x)
+            {
+                const BlockType* s = source + x * 2;
+                dest[x] = BlockType((s[0] + s[1] + (x & 1)) >> 1);
+            }
+
+            source += 16;
+            dest += 8;
+        }
+    }
+
+    void downsample_h2v2(BlockType* dest, const BlockType* source)
+    {
+        for (int y = 0; y < 8; ++y)
+        {
+            for (int x = 0; x < 8; ++x)
+            {
+                const BlockType* s = source + x * 2;
+                dest[x] = BlockType((s[0] + s[1] + s[16] + s[17] + 1 + (x & 1)) >> 2);
+            }
+
+            source += 32;
+            dest += 8;
+        }
+    }
+
+    // ----------------------------------------------------------------------------
+    // read_xxx_format
+    // ----------------------------------------------------------------------------
+
+    void read_400_format(jpeg_encode* jp, BlockType* block, const u8* input, int stride, int rows, int cols)
     {
-        int bytes_per_pixel = 0;
+        for (int i = 0; i < rows; ++i)
+        {
+            for (int j = 0; j < cols; ++j)
+            {
+                block[j] = BlockType(input[j] - 128);
+            }
 
+            // replicate last column
+            for (int j = cols; j < 8; ++j)
+            {
+                block[j] = block[j - 1];
+            }
+
+            block += 8;
+            input += stride;
+        }
+
+        // replicate last row
+        for (int i = rows; i < 8; ++i)
+        {
+            std::memcpy(block, block - 8, 8 * sizeof(BlockType));
+            block += 8;
+        }
+    }
+
+    void read_ycbcr_format(jpeg_encode* jp, BlockType* block, const u8* input, int stride, int rows, int cols)
+    {
+        const int width = jp->mcu_width;
+        const int size = width * jp->mcu_height;
+        const int bytes = jp->bytes_per_pixel;
+
+        BlockType* y = block;
+        BlockType* cb = block + size;
+        BlockType* cr = block + size * 2;
+
+        for (int i = 0; i < rows; ++i)
+        {
+            const u8* scan = input;
+            u8 temp[16 * 4];
+
+            if (cols < width || bytes != 4)
+            {
+                // expand to 32 bits per pixel and replicate last column
+                for (int j = 0; j < width; ++j)
+                {
+                    const u8* s = input + std::min(j, cols - 1) * bytes;
+                    temp[j * 4 + 0] = s[0];
+                    temp[j * 4 + 1] = s[1];
+                    temp[j * 4 + 2] = s[2];
+                    temp[j * 4 + 3] = 0;
+                }
+
+                scan = temp;
+            }
+
+            jp->color(y, cb, cr, scan, width);
+
+            y += width;
+            cb += width;
+            cr += width;
+            input += stride;
+        }
+
+        // replicate last row
+        for (int i = rows; i < jp->mcu_height; ++i)
+        {
+            std::memcpy(y, y - width, width * sizeof(BlockType));
+            std::memcpy(cb, cb - width, width * sizeof(BlockType));
+            std::memcpy(cr, cr - width, width * sizeof(BlockType));
+            y += width;
+            cb += width;
+            cr += width;
+        }
+    }
+
+    // ----------------------------------------------------------------------------
+    // jpeg_encode methods
+    // ----------------------------------------------------------------------------
+
+    jpeg_encode::jpeg_encode(jpegSampleFormat format, ImageEncodeOptions::Subsampling subsampling,
+                             u32 width, u32 height, u32 quality)
+    {
+        const u64 flags = getCPUFlags();
+
+        bytes_per_pixel = 0;
         channel_count = 0;
 
         channel[0].component = 1;
         channel[0].qtable = ILqt;
 
-        channel[1].component = 2;
-        channel[1].qtable = ICqt;
+        channel[1].component = 2;
+        channel[1].qtable = ICqt;
+
+        channel[2].component = 3;
+        channel[2].qtable = ICqt;
+
+        read_format = read_ycbcr_format;
+        color = nullptr;
+
+        bool bgr = false;
+
+        switch (format)
+        {
+            case JPEG_FORMAT_YUV400:
+                read_format = read_400_format;
+                bytes_per_pixel = 1;
+                channel_count = 1;
+                break;
+
+            case JPEG_FORMAT_BGR888:
+                bgr = true;
+                bytes_per_pixel = 3;
+                channel_count = 3;
+                break;
+
+            case JPEG_FORMAT_RGB888:
+                bytes_per_pixel = 3;
+                channel_count = 3;
+                break;
+
+            case JPEG_FORMAT_BGRA8888:
+                bgr = true;
+                bytes_per_pixel = 4;
+                channel_count = 3;
+                break;
+
+            case JPEG_FORMAT_RGBA8888:
+                bytes_per_pixel = 4;
+                channel_count = 3;
+                break;
+        }
+
+        fdct = ::fdct;
+
+        if (channel_count == 3)
+        {
+            color = bgr ? color_rgbx<2, 0> : color_rgbx<0, 2>;
+        }
+
+#if defined(JPEG_ENABLE_SSE2)
+        if (flags & CPU_SSE2)
+        {
+            fdct = fdct_sse2;
+            if (color)
+                color = bgr ? color_rgbx_sse2<2, 0> : color_rgbx_sse2<0, 2>;
+        }
+#if defined(MANGO_ENABLE_DISPATCH)
+        if (flags & CPU_AVX2)
+        {
+            if (color)
+                color = bgr ? color_rgbx_avx2<2, 0> : color_rgbx_avx2<0, 2>;
+        }
+#endif
+#endif
+
+#if defined(JPEG_ENABLE_NEON)
+        // NEON is part of the compile-time baseline
+        fdct = fdct_neon;
+        if (color)
+            color = bgr ? color_rgbx_neon<2, 0> : color_rgbx_neon<0, 2>;
+#endif
+
+        MANGO_UNREFERENCED_PARAMETER(flags);
+        MANGO_UNREFERENCED_PARAMETER(bgr);
+
+        // luminance has no chroma to subsample
+        if (channel_count == 1)
+        {
+            subsampling = ImageEncodeOptions::SUBSAMPLING_444;
+        }
+
+        switch (subsampling)
+        {
+            case ImageEncodeOptions::SUBSAMPLING_444:
+                sampling = 0x11;
+                break;
+
+            case ImageEncodeOptions::SUBSAMPLING_422:
+                sampling = 0x21;
+                break;
+
+            case ImageEncodeOptions::SUBSAMPLING_420:
+                sampling = 0x22;
+                break;
+        }
+
+        init_geometry(width, height);
+
+        dc_table[0].init(luminance_dc_bits, dc_values);
+        dc_table[1].init(chrominance_dc_bits, dc_values);
+        ac_table[0].init(luminance_ac_bits, luminance_ac_values);
+        ac_table[1].init(chrominance_ac_bits, chrominance_ac_values);
+
+        init_quantization_tables(quality);
+    }
+
+    jpeg_encode::jpeg_encode(const CoefficientImage& image)
+    {
+        bytes_per_pixel = 0;
+        channel_count = image.components;
+        sampling = u8((image.hsf << 4) | image.vsf);
+
+        for (int i = 0; i < channel_count; ++i)
+        {
+            channel[i].component = image.compid[i];
+            channel[i].qtable = i ? ICqt : ILqt;
+        }
+
+        std::memcpy(Lqt, image.qtable[0], BLOCK_SIZE);
+        std::memcpy(Cqt, image.qtable[1], BLOCK_SIZE);
+
+        // the coefficients are already quantized
+        read_format = nullptr;
+        color = nullptr;
+        fdct = nullptr;
+
+        init_geometry(image.width, image.height);
+    }
+
+    jpeg_encode::~jpeg_encode()
+    {
+    }
+
+    void jpeg_encode::init_geometry(u32 width, u32 height)
+    {
+        // component geometry
+        const int hmax = sampling >> 4;
+        const int vmax = sampling & 15;
+
+        mcu_width = hmax * 8;
+        mcu_height = vmax * 8;
+
+        horizontal_mcus = (width + mcu_width - 1) / mcu_width;
+        vertical_mcus   = (height + mcu_height - 1) / mcu_height;
+
+        rows_in_bottom_mcus = height - (vertical_mcus - 1) * mcu_height;
+        cols_in_right_mcus  = width  - (horizontal_mcus - 1) * mcu_width;
+
+        mcu_width_size = mcu_width * bytes_per_pixel;
+
+        blocks_in_mcu = 0;
+
+        for (int i = 0; i < channel_count; ++i)
+        {
+            jpeg_chan& chan = channel[i];
+
+            chan.hsf = i ? 1 : hmax;
+            chan.vsf = i ? 1 : vmax;
+            chan.offset = blocks_in_mcu;
+            blocks_in_mcu += chan.hsf * chan.vsf;
+
+            // non-interleaved scans only cover the blocks inside the component
+            const int xsize = (width * chan.hsf + hmax - 1) / hmax;
+            const int ysize = (height * chan.vsf + vmax - 1) / vmax;
+            chan.xblocks = (xsize + 7) / 8;
+            chan.yblocks = (ysize + 7) / 8;
+        }
+    }
+
+    void jpeg_encode::init_quantization_tables(u32 quality)
+    {
+        quality = std::min(quality, 1024u) * 16;
+
+        for (int i = 0; i < 64; ++i)
+        {
+            u16 index = zigzag_table [i];
+            u32 value;
+
+            // luminance quantization table * quality factor
+            value = luminance_quant_table [i] * quality;
+            value = (value + 0x200) >> 10;
+
+            if (value < 2)
+                value = 2;
+            else if (value > 255)
+                value = 255;
+
+            Lqt [index] = (u8) value;
+            ILqt [i] = static_cast<u16>(0x8000 / value);
+
+            // chrominance quantization table * quality factor
+            value = chrominance_quant_table [i] * quality;
+            value = (value + 0x200) >> 10;
+
+            if (value < 2)
+                value = 2;
+            else if (value > 255)
+                value = 255;
+
+            Cqt [index] = (u8) value;
+            ICqt [i] = static_cast<u16>(0x8000 / value);
+        }
+    }
+
+    void jpeg_encode::write_markers(BigEndianStream& p, u32 width, u32 height, bool progressive)
+    {
+        // Start of image marker
+        p.write16(0xffd8);
+
+        write_frame(p, width, height, progressive);
+    }
+
+    void jpeg_encode::write_frame(BigEndianStream& p, u32 width, u32 height, bool progressive)
+    {
+        // Quantization table marker
+        p.write16(0xffdb);
+        p.write16(0x43); // quantization table length
+        p.write8(0x00); // Pq, Tq
+
+        // Lqt table
+        p.write(Lqt, 64);
+
+        // Quantization table marker
+        p.write16(0xffdb);
+        p.write16(0x43); // quantization table length
+        p.write8(0x01); // Pq, Tq
+
+        // Cqt table
+        p.write(Cqt, 64);
+
+        // Start of frame marker: baseline or progressive DCT
+        p.write16(progressive ? 0xffc2 : 0xffc0);
+
+        u16 header_length = u16(8 + 3 * channel_count);
+
+        p.write16(header_length); // frame header length
+        p.write8(8); // precision
+        p.write16(static_cast<u16>(height)); // image height
+        p.write16(static_cast<u16>(width)); // image width
+        p.write8(u8(channel_count)); // Nf
+
+        for (int i = 0; i < channel_count; ++i)
+        {
+            // luminance sampling factors; chroma is always one block per MCU
+            p.write8(u8(channel[i].component)); // Ci
+            p.write8(u8((channel[i].hsf << 4) | channel[i].vsf)); // Hi, Vi
+            p.write8(i ? 0x01 : 0x00); // Tqi
+        }
+    }
+
+    void jpeg_encode::write_scan_header(BigEndianStream& p, const jpeg_scan& scan, int interval) const
+    {
+        // Define Restart Interval marker
+        p.write16(0xffdd);
+        p.write16(4);
+        p.write16(u16(interval));
+
+        // Start of scan marker
+        p.write16(0xffda);
+        p.write16(u16(6 + scan.count * 2)); // header length
+        p.write8(u8(scan.count)); // Ns
+
+        for (int i = 0; i < scan.count; ++i)
+        {
+            const int index = scan.component[i];
+            p.write8(u8(channel[index].component)); // Cs
+            p.write8(index ? 0x11 : 0x00); // Td, Ta
+        }
+
+        p.write8(u8(scan.Ss));
+        p.write8(u8(scan.Se));
+        p.write8(u8((scan.Ah << 4) | scan.Al));
+    }
+
+    // ----------------------------------------------------------------------------
+    // encodeJPEG()
+    // ----------------------------------------------------------------------------
+
+    // forward DCT of the MCU into blocks_in_mcu blocks: luminance blocks in raster order
+    // followed by the chrominance blocks (the same layout the decoder uses)
+    void fdct_mcu(BlockType* dest, const jpeg_encode& jp, const BlockType* block)
+    {
+        // luminance blocks
+        for (int y = 0; y < jp.mcu_height; y += 8)
+        {
+            for (int x = 0; x < jp.mcu_width; x += 8)
+            {
+                jp.fdct(dest, block + y * jp.mcu_width + x, jp.mcu_width, jp.channel[0].qtable);
+                dest += BLOCK_SIZE;
+            }
+        }
+
+        // chrominance blocks
+        const int size = jp.mcu_width * jp.mcu_height;
+
+        for (int i = 1; i < jp.channel_count; ++i)
+        {
+            const BlockType* source = block + i * size;
+            BlockType chroma[BLOCK_SIZE];
+
+            switch (jp.sampling)
+            {
+                case 0x21:
+                    downsample_h2v1(chroma, source);
+                    source = chroma;
+                    break;
+
+                case 0x22:
+                    downsample_h2v2(chroma, source);
+                    source = chroma;
+                    break;
+            }
+
+            jp.fdct(dest, source, 8, jp.channel[i].qtable);
+            dest += BLOCK_SIZE;
+        }
+    }
+
+    u8* encode_mcu(u8* p, HuffmanEncoder& huffman, const jpeg_encode& jp, const BlockType* block)
+    {
+        BlockType temp[BLOCK_SIZE * 6];
+
+        fdct_mcu(temp, jp, block);
+
+        const BlockType* data = temp;
+
+        for (int i = 0; i < jp.channel_count; ++i)
+        {
+            const int count = jp.channel[i].hsf * jp.channel[i].vsf;
+
+            for (int j = 0; j < count; ++j)
+            {
+                p = huffman.encode(p, jp.channel[i].component, data);
+                data += BLOCK_SIZE;
+            }
+        }
+
+        return p;
+    }
+
+    static const u8 g_restart_markers [] =
+    {
+        0xff, 0xd0, 0xff, 0xd1, 0xff, 0xd2, 0xff, 0xd3,
+        0xff, 0xd4, 0xff, 0xd5, 0xff, 0xd6, 0xff, 0xd7,
+    };
+
+    // frame, typical huffman tables and the scan header of a baseline sequential image
+    void writeSequentialHeader(jpeg_encode& jp, Stream& stream, u32 width, u32 height)
+    {
+        BigEndianStream s(stream);
+
+        // writing marker data
+        jp.write_markers(s, width, height, false);
+
+        jp.dc_table[0].write(s, 0x00);
+        jp.ac_table[0].write(s, 0x10);
+        jp.dc_table[1].write(s, 0x01);
+        jp.ac_table[1].write(s, 0x11);
+
+        const jpeg_scan& scan = jp.channel_count == 1 ? g_sequential_scan_y[0] : g_sequential_scan_ycbcr[0];
+        jp.write_scan_header(s, scan, jp.horizontal_mcus);
+    }
+
+    // Encode one row of MCUs into the buffer; the row is a restart interval.
+    void encodeSequentialRow(jpeg_encode& jp, SegmentedBuffer* buffer, const u8* image, int rows, int stride)
+    {
+        HuffmanEncoder huffman(jp.dc_table, jp.ac_table);
+
+        // encode directly into the buffer pages; worst case MCU is
+        // 6 blocks * 64 coefficients * 27 bits with every byte stuffed
+        constexpr int flush_threshold = 4096;
+
+        Memory page = buffer->acquire(flush_threshold);
+        u8* ptr = page.address;
+
+        const int right_mcu = jp.horizontal_mcus - 1;
+
+        for (int x = 0; x < jp.horizontal_mcus; ++x)
+        {
+            // clipping
+            int cols = x < right_mcu ? jp.mcu_width : jp.cols_in_right_mcus;
+
+            BlockType block[BLOCK_SIZE * 4 * 3];
+
+            // read MCU data
+            jp.read_format(&jp, block, image, stride, rows, cols);
+
+            // encode the data in MCU
+            ptr = encode_mcu(ptr, huffman, jp, block);
+
+            // move to next page
+            if (page.address + page.size - ptr < flush_threshold)
+            {
+                buffer->commit(ptr - page.address);
+                page = buffer->acquire(flush_threshold);
+                ptr = page.address;
+            }
+
+            image += jp.mcu_width_size;
+        }
+
+        // flush encoding buffer
+        ptr = huffman.flush(ptr);
+        buffer->commit(ptr - page.address);
+    }
+
+    // Encode the rows of MCUs in the surface in parallel, starting from MCU row y of the
+    // image. Each row is a restart interval so the rows are independent of each other.
+    // A task encodes a band of rows with their restart markers into one buffer, which
+    // keeps appending into its current page so that small rows share pages.
+    void encodeSequentialRows(jpeg_encode& jp, const Surface& surface, int y, Stream& stream)
+    {
+        const int count = (surface.height + jp.mcu_height - 1) / jp.mcu_height;
+        const int bands = std::min(count, ThreadPool::getInstanceSize() * 4);
+
+        ConcurrentQueue queue;
 
-        channel[2].component = 3;
-        channel[2].qtable = ICqt;
+        // bitstream for each band of MCU scans
+        std::vector<SegmentedBuffer> buffers(bands);
 
-        switch (format)
+        for (int band = 0; band < bands; ++band)
         {
-            case JPEG_FORMAT_YUV400:
-                read_format = read_400_format;
-                bytes_per_pixel = 1;
-                channel_count = 1;
-                break;
+            const int first = band * count / bands;
+            const int last = (band + 1) * count / bands;
 
-            case JPEG_FORMAT_BGR888:
-                read_format = read_bgr888_format;
-                bytes_per_pixel = 3;
-                channel_count = 3;
-                break;
+            SegmentedBuffer* buffer = &buffers[band];
 
-            case JPEG_FORMAT_RGB888:
-                read_format = read_rgb888_format;
-                bytes_per_pixel = 3;
-                channel_count = 3;
-                break;
+            queue.enqueue([&jp, &surface, buffer, first, last, y] {
+                for (int i = first; i < last; ++i)
+                {
+                    // clipping
+                    const int rows = std::min(jp.mcu_height, surface.height - i * jp.mcu_height);
+                    const u8* image = surface.image + i * jp.mcu_height * surface.stride;
 
-            case JPEG_FORMAT_BGRA8888:
-                read_format = read_bgra8888_format;
-                bytes_per_pixel = 4;
-                channel_count = 3;
-                break;
+                    encodeSequentialRow(jp, buffer, image, rows, surface.stride);
 
-            case JPEG_FORMAT_RGBA8888:
-                read_format = read_rgba8888_format;
-                bytes_per_pixel = 4;
-                channel_count = 3;
-                break;
+                    int index = (y + i) & 7;
+                    buffer->write(g_restart_markers + index * 2, 2);
+                }
+            });
         }
 
-        mcu_width = 8;
-        mcu_height = 8;
-
-        horizontal_mcus = (width + mcu_width - 1) >> 3;
-        vertical_mcus   = (height + mcu_height - 1) >> 3;
-
-        rows_in_bottom_mcus = height - (vertical_mcus - 1) * mcu_height;
-        cols_in_right_mcus  = width  - (horizontal_mcus - 1) * mcu_width;
+        queue.wait();
 
-        length_minus_mcu_width = stride - mcu_width * bytes_per_pixel;
-        length_minus_width     = stride - cols_in_right_mcus * bytes_per_pixel;
+        // gather huffman bitstreams and restart markers into one write
+        std::vector<Memory> segments;
 
-        mcu_width_size = mcu_width * bytes_per_pixel;
+        for (int i = 0; i < bands; ++i)
+        {
+            const std::vector<Memory>& pages = buffers[i].segments();
+            segments.insert(segments.end(), pages.begin(), pages.end());
+        }
 
-        init_quantization_tables(quality);
+        stream.writev(segments.data(), segments.size());
     }
 
-    jpeg_encode::~jpeg_encode()
+    // baseline sequential encoding with the typical huffman tables in a single pass
+    void encodeSequential(jpeg_encode& jp, const Surface& surface, Stream& stream)
     {
+        writeSequentialHeader(jp, stream, surface.width, surface.height);
+        encodeSequentialRows(jp, surface, 0, stream);
+
+        // End of image marker
+        BigEndianStream s(stream);
+        s.write16(0xffd9);
     }
 
-    void jpeg_encode::init_quantization_tables(u32 quality)
+    // encode one restart interval: a row of MCUs in interleaved scans and a row of
+    // blocks in single component scans; only gathers statistics without buffer
+    void encodeInterval(ScanEncoder& encoder, const jpeg_encode& jp, const BlockType* coefficients,
+                        int y, int count, SegmentedBuffer* buffer)
     {
-        quality = std::min(quality, 1024u) * 16;
+        const jpeg_scan& scan = encoder.scan;
+        const int mcu_size = jp.blocks_in_mcu * BLOCK_SIZE;
 
-        for (int i = 0; i < 64; ++i)
+        // see encodeSequential() for the threshold
+        constexpr int flush_threshold = 4096;
+
+        Memory page;
+        u8* ptr = nullptr;
+
+        if (buffer)
         {
-            u16 index = zigzag_table [i];
-            u32 value;
+            page = buffer->acquire(flush_threshold);
+            ptr = page.address;
+        }
 
-            // luminance quantization table * quality factor
-            value = luminance_quant_table [i] * quality;
-            value = (value + 0x200) >> 10;
+        for (int x = 0; x < count; ++x)
+        {
+            if (scan.count > 1)
+            {
+                const BlockType* mcu = coefficients + (y * jp.horizontal_mcus + x) * mcu_size;
 
-            if (value < 2)
-                value = 2;
-            else if (value > 255)
-                value = 255;
+                for (int i = 0; i < scan.count; ++i)
+                {
+                    const int index = scan.component[i];
+                    const jpeg_chan& chan = jp.channel[index];
+                    const BlockType* data = mcu + chan.offset * BLOCK_SIZE;
 
-            Lqt [index] = (u8) value;
-            ILqt [i] = static_cast<u16>(0x8000 / value);
+                    for (int j = 0; j < chan.hsf * chan.vsf; ++j)
+                    {
+                        ptr = encoder.encode(ptr, index, data);
+                        data += BLOCK_SIZE;
+                    }
+                }
+            }
+            else
+            {
+                const int index = scan.component[0];
+                const jpeg_chan& chan = jp.channel[index];
 
-            // chrominance quantization table * quality factor
-            value = chrominance_quant_table [i] * quality;
-            value = (value + 0x200) >> 10;
+                const int mcu = (y / chan.vsf) * jp.horizontal_mcus + (x / chan.hsf);
+                const int block = chan.offset + (y % chan.vsf) * chan.hsf + (x % chan.hsf);
 
-            if (value < 2)
-                value = 2;
-            else if (value > 255)
-                value = 255;
+                ptr = encoder.encode(ptr, index, coefficients + mcu * mcu_size + block * BLOCK_SIZE);
+            }
 
-            Cqt [index] = (u8) value;
-            ICqt [i] = static_cast<u16>(0x8000 / value);
+            // move to next page
+            if (buffer && page.address + page.size - ptr < flush_threshold)
+            {
+                buffer->commit(ptr - page.address);
+                page = buffer->acquire(flush_threshold);
+                ptr = page.address;
+            }
+        }
+
+        ptr = encoder.flush(ptr);
+
+        if (buffer)
+        {
+            buffer->commit(ptr - page.address);
         }
     }
 
-    void jpeg_encode::write_markers(BigEndianStream& p, u32 format, u32 width, u32 height)
+    void encodeScan(const jpeg_encode& jp, Stream& stream, const BlockType* coefficients, const jpeg_scan& scan)
     {
-        // Start of image marker
-        p.write16(0xffd8);
+        int xcount = jp.horizontal_mcus;
+        int ycount = jp.vertical_mcus;
 
-        // Quantization table marker
-        p.write16(0xffdb);
-        p.write16(0x43); // quantization table length
-        p.write8(0x00); // Pq, Tq
+        if (scan.count == 1)
+        {
+            const jpeg_chan& chan = jp.channel[scan.component[0]];
+            xcount = chan.xblocks;
+            ycount = chan.yblocks;
+        }
 
-        // Lqt table
-        p.write(Lqt, 64);
+        // tables referenced by the scan; DC refinement is not huffman coded
+        bool dc_used[2] = { false, false };
+        bool ac_used[2] = { false, false };
 
-        // Quantization table marker
-        p.write16(0xffdb);
-        p.write16(0x43); // quantization table length
-        p.write8(0x01); // Pq, Tq
+        for (int i = 0; i < scan.count; ++i)
+        {
+            const int table = scan.component[i] ? 1 : 0;
+            dc_used[table] |= scan.Ss == 0 && scan.Ah == 0;
+            ac_used[table] |= scan.Se > 0;
+        }
 
-        // Cqt table
-        p.write(Cqt, 64);
+        HuffmanTable dc_table[2];
+        HuffmanTable ac_table[2];
 
-        // Start of frame marker
-        p.write16(0xffc0);
+        if (dc_used[0] || dc_used[1] || ac_used[0] || ac_used[1])
+        {
+            // first pass: symbol statistics for each restart interval in parallel
+            HuffmanStatistics statistics;
+            std::mutex mutex;
 
-        u8 number_of_components = 0;
+            ConcurrentQueue queue;
 
-        switch (format)
-        {
-            case JPEG_FORMAT_YUV400:
-                number_of_components = 1;
-                break;
+            for (int y = 0; y < ycount; ++y)
+            {
+                queue.enqueue([&, y] {
+                    HuffmanStatistics local;
+                    ScanEncoder encoder(scan, dc_table, ac_table, &local);
+                    encodeInterval(encoder, jp, coefficients, y, xcount, nullptr);
+
+                    std::lock_guard<std::mutex> lock(mutex);
+                    statistics.add(local);
+                });
+            }
 
-            case JPEG_FORMAT_RGB888:
-            case JPEG_FORMAT_BGR888:
-            case JPEG_FORMAT_BGRA8888:
-            case JPEG_FORMAT_RGBA8888:
-                number_of_components = 3;
-                break;
+            queue.wait();
+
+            for (int i = 0; i < 2; ++i)
+            {
+                if (dc_used[i])
+                    dc_table[i].optimize(statistics.dc[i]);
+
+                if (ac_used[i])
+                    ac_table[i].optimize(statistics.ac[i]);
+            }
         }
 
-        u16 header_length = 8 + 3 * number_of_components;
+        // second pass: encode bands of restart intervals with the restart markers between
+        // them; the intervals of a band append into the same buffer
+        const int bands = std::min(ycount, ThreadPool::getInstanceSize() * 4);
+        std::vector<SegmentedBuffer> buffers(bands);
 
-        p.write16(header_length); // frame header length
-        p.write8(8); // precision
-        p.write16(static_cast<u16>(height)); // image height
-        p.write16(static_cast<u16>(width)); // image width
-        p.write8(number_of_components); // Nf
+        ConcurrentQueue queue;
 
-        const u8 nfdata[] =
+        for (int band = 0; band < bands; ++band)
         {
-            0x01, 0x11, 0x00, // component 1
-            0x00, 0x00, 0x00, // padding
-            0x01, 0x11, 0x00, // component 1
-            0x02, 0x11, 0x01, // component 2
-            0x03, 0x11, 0x01, // component 3
-        };
+            const int first = band * ycount / bands;
+            const int last = (band + 1) * ycount / bands;
 
-        p.write(nfdata + (number_of_components - 1) * 3, number_of_components * 3);
+            SegmentedBuffer* buffer = &buffers[band];
 
-        // huffman table(DHT)
-        p.write(marker_data, sizeof(marker_data));
+            queue.enqueue([&, first, last, buffer] {
+                for (int y = first; y < last; ++y)
+                {
+                    if (y > 0)
+                    {
+                        int index = (y - 1) & 7;
+                        buffer->write(g_restart_markers + index * 2, 2);
+                    }
 
-        // Define Restart Interval marker
-        p.write16(0xffdd);
-        p.write16(4);
-        p.write16(horizontal_mcus);
+                    ScanEncoder encoder(scan, dc_table, ac_table, nullptr);
+                    encodeInterval(encoder, jp, coefficients, y, xcount, buffer);
+                }
+            });
+        }
 
-        // Start of scan marker
-        p.write16(0xffda);
-        p.write16(6 + number_of_components * 2); // header length
-        p.write8(number_of_components); // Ns
+        queue.wait();
 
-        const u8 nsdata[] =
+        BigEndianStream s(stream);
+
+        for (int i = 0; i < 2; ++i)
         {
-            0x01, 0x00,
-            0x02, 0x11,
-            0x03, 0x11,
-        };
+            if (dc_used[i])
+                dc_table[i].write(s, u8(0x00 | i));
 
-        p.write(nsdata, number_of_components * 2);
-        p.write8(0x00);
-        p.write8(0x3f);
-        p.write8(0x00);
-    }
+            if (ac_used[i])
+                ac_table[i].write(s, u8(0x10 | i));
+        }
 
-    // ----------------------------------------------------------------------------
-    // encodeJPEG()
-    // ----------------------------------------------------------------------------
+        jp.write_scan_header(s, scan, xcount);
+
+        std::vector<Memory> segments;
 
-    void encodeJPEG(const Surface& surface, Stream& stream, int quality, jpegSampleFormat sample_format)
+        for (int i = 0; i < bands; ++i)
+        {
+            const std::vector<Memory>& pages = buffers[i].segments();
+            segments.insert(segments.end(), pages.begin(), pages.end());
+        }
+
+        stream.writev(segments.data(), segments.size());
+    }
+
+    // all scans of a sequential or progressive image with optimized huffman tables
+    void encodeScans(const jpeg_encode& jp, Stream& stream, const BlockType* coefficients, bool progressive)
     {
-        u8* input = surface.image;
+        const jpeg_scan* scans;
+        int count;
 
-        jpeg_encode jp(sample_format, surface.width, surface.height, surface.stride, quality);
+        if (progressive)
+        {
+            scans = jp.channel_count == 1 ? g_progressive_scan_y : g_progressive_scan_ycbcr;
+            count = jp.channel_count == 1 ? int(sizeof(g_progressive_scan_y) / sizeof(jpeg_scan))
+                                          : int(sizeof(g_progressive_scan_ycbcr) / sizeof(jpeg_scan));
+        }
+        else
+        {
+            scans = jp.channel_count == 1 ? g_sequential_scan_y : g_sequential_scan_ycbcr;
+            count = 1;
+        }
 
-        BigEndianStream s(stream);
+        for (int i = 0; i < count; ++i)
+        {
+            encodeScan(jp, stream, coefficients, scans[i]);
+        }
+    }
 
-        // writing marker data
-        jp.write_markers(s, sample_format, surface.width, surface.height);
+    // two pass encoding with optimized huffman tables; sequential or progressive
+    void encodeOptimized(jpeg_encode& jp, const Surface& surface, Stream& stream, bool progressive)
+    {
+        // quantized coefficients of the whole image in MCU order
+        const int mcu_size = jp.blocks_in_mcu * BLOCK_SIZE;
+        std::vector<BlockType> coefficients(size_t(jp.horizontal_mcus) * jp.vertical_mcus * mcu_size);
 
         ConcurrentQueue queue;
 
-        // bitstream for each MCU scan
-        Buffer* buffers = new Buffer[jp.vertical_mcus];
-
-        // encode MCUs
         const int bottom_mcu = jp.vertical_mcus - 1;
+        const int stride = surface.stride;
 
         for (int y = 0; y < jp.vertical_mcus; ++y)
         {
-            int rows;
-
-            if (y < bottom_mcu)
-            {
-                rows = jp.mcu_height;
-            }
-            else
-            {
-                // clipping
-                rows = jp.rows_in_bottom_mcus;
-            }
-
-            queue.enqueue([&jp, y, buffers, input, rows] {
-                u8* image = input;
+            const u8* input = surface.image + y * jp.mcu_height * stride;
+            const int rows = y < bottom_mcu ? jp.mcu_height : jp.rows_in_bottom_mcus;
 
-                HuffmanEncoder huffman;
+            BlockType* dest = coefficients.data() + size_t(y) * jp.horizontal_mcus * mcu_size;
 
-                constexpr int buffer_size = 2048;
-                constexpr int flush_threshold = buffer_size - 512;
-
-                u8 huff_temp[buffer_size]; // encoding buffer
-                u8* ptr = huff_temp;
+            queue.enqueue([&jp, dest, input, rows, stride, mcu_size] {
+                const u8* image = input;
+                BlockType* output = dest;
 
                 const int right_mcu = jp.horizontal_mcus - 1;
 
                 for (int x = 0; x < jp.horizontal_mcus; ++x)
                 {
-                    int cols;
-                    int incr;
-
-                    if (x < right_mcu)
-                    {
-                        cols = jp.mcu_width;
-                        incr = jp.length_minus_mcu_width;
-                    }
-                    else
-                    {
-                        // clipping
-                        cols = jp.cols_in_right_mcus;
-                        incr = jp.length_minus_width;
-                    }
-
-                    BlockType block[BLOCK_SIZE * 3];
+                    // clipping
+                    int cols = x < right_mcu ? jp.mcu_width : jp.cols_in_right_mcus;
 
-                    // read MCU data
-                    jp.read_format(&jp, block, image, rows, cols, incr);
+                    BlockType block[BLOCK_SIZE * 4 * 3];
 
-                    // encode the data in MCU
-                    for (int i = 0; i < jp.channel_count; ++i)
-                    {
-                        BlockType temp[BLOCK_SIZE];
-                        fdct(temp, block + i * BLOCK_SIZE, jp.channel[i].qtable);
-                        ptr = huffman.encode(ptr, jp.channel[i].component, temp);
-                    }
-
-                    // flush encoding buffer
-                    if (ptr - huff_temp > flush_threshold)
-                    {
-                        buffers[y].write(huff_temp, ptr - huff_temp);
-                        ptr = huff_temp;
-                    }
+                    jp.read_format(&jp, block, image, stride, rows, cols);
+                    fdct_mcu(output, jp, block);
 
+                    output += mcu_size;
                     image += jp.mcu_width_size;
                 }
-
-                // flush encoding buffer
-                ptr = huffman.flush(ptr);
-                buffers[y].write(huff_temp, ptr - huff_temp);
             });
-
-            input += surface.stride * jp.mcu_height;
         }
 
         queue.wait();
 
-        for (int y = 0; y < jp.vertical_mcus; ++y)
-        {
-            Buffer& buffer = buffers[y];
-
-            // write huffman bitstream
-            s.write(buffer, size_t(buffer.size()));
+        BigEndianStream s(stream);
 
-            // write restart marker
-            int index = y & 7;
-            s.write16(0xffd0 + index);
-        }
+        // writing marker data
+        jp.write_markers(s, surface.width, surface.height, progressive);
 
-        delete[] buffers;
+        encodeScans(jp, stream, coefficients.data(), progressive);
 
-        // EOI marker
+        // End of image marker
         s.write16(0xffd9);
     }
 
+    void encodeJPEG(const Surface& surface, Stream& stream, int quality, jpegSampleFormat sample_format,
+                    const ImageEncodeOptions& options)
+    {
+        jpeg_encode jp(sample_format, options.subsampling, surface.width, surface.height, quality);
+
+        if (options.optimize || options.progressive)
+        {
+            // progressive scans need the EOB run symbols, which the typical tables don't have
+            encodeOptimized(jp, surface, stream, options.progressive);
+        }
+        else
+        {
+            encodeSequential(jp, surface, stream);
+        }
+    }
+
 } // namespace
 
 namespace jpeg
 {
 
-    void EncodeImage(Stream& stream, const Surface& surface, float quality)
+    void EncodeImage(Stream& stream, const Surface& surface, const ImageEncodeOptions& options)
     {
         // configure quality
-        quality = clamp(1.0f - quality, 0.0f, 1.0f);
+        const float quality = clamp(1.0f - options.quality, 0.0f, 1.0f);
         const u32 iq = u32(quality * 1024);
 
         // set default format
@@ -1118,15 +2405,117 @@ namespace jpeg
         // encode
         if (surface.format == sourceFormat)
         {
-            encodeJPEG(surface, stream, iq, sample);
+            encodeJPEG(surface, stream, iq, sample, options);
         }
         else
         {
             // convert source surface to format supported in the encoder
             Bitmap temp(surface.width, surface.height, sourceFormat);
             temp.blit(0, 0, surface);
-            encodeJPEG(temp, stream, iq, sample);
+            encodeJPEG(temp, stream, iq, sample, options);
+        }
+    }
+
+    // ----------------------------------------------------------------------------
+    // RowEncoder
+    // ----------------------------------------------------------------------------
+
+    struct RowEncoder::State
+    {
+        jpeg_encode jp;
+        Stream& stream;
+        Format format;
+        int height;
+        int y; // next row of MCUs
+
+        State(Stream& stream, jpegSampleFormat sample, const Format& format, int width, int height, u32 quality,
+              ImageEncodeOptions::Subsampling subsampling)
+            : jp(sample, subsampling, width, height, quality)
+            , stream(stream)
+            , format(format)
+            , height(height)
+            , y(0)
+        {
+        }
+    };
+
+    RowEncoder::RowEncoder(Stream& stream, int width, int height, const Format& format, const ImageEncodeOptions& options)
+    {
+        const float quality = clamp(1.0f - options.quality, 0.0f, 1.0f);
+        const u32 iq = u32(quality * 1024);
+
+        Format sourceFormat = FORMAT_R8G8B8A8;
+        jpegSampleFormat sample = JPEG_FORMAT_RGBA8888;
+
+        for (int i = 0; i < g_format_table_size; ++i)
+        {
+            if (format == g_format_table[i].source)
+            {
+                sourceFormat = g_format_table[i].source;
+                sample = g_format_table[i].sample;
+                break;
+            }
+        }
+
+        m_state = new State(stream, sample, sourceFormat, width, height, iq, options.subsampling);
+        writeSequentialHeader(m_state->jp, stream, width, height);
+    }
+
+    RowEncoder::~RowEncoder()
+    {
+        delete m_state;
+    }
+
+    int RowEncoder::getBandHeight() const
+    {
+        return m_state->jp.mcu_height;
+    }
+
+    void RowEncoder::encode(const Surface& band)
+    {
+        State& state = *m_state;
+
+        if (band.format == state.format)
+        {
+            encodeSequentialRows(state.jp, band, state.y, state.stream);
+        }
+        else
+        {
+            Bitmap temp(band.width, band.height, state.format);
+            temp.blit(0, 0, band);
+            encodeSequentialRows(state.jp, temp, state.y, state.stream);
+        }
+
+        state.y += (band.height + state.jp.mcu_height - 1) / state.jp.mcu_height;
+
+        if (state.y * state.jp.mcu_height >= state.height)
+        {
+            // End of image marker
+            BigEndianStream s(state.stream);
+            s.write16(0xffd9);
+        }
+    }
+
+    void EncodeCoefficients(Stream& stream, const CoefficientImage& image, const std::vector<Memory>& markers, bool progressive)
+    {
+        jpeg_encode jp(image);
+
+        BigEndianStream s(stream);
+
+        // Start of image marker
+        s.write16(0xffd8);
+
+        for (const Memory& marker : markers)
+        {
+            s.write(marker.address, marker.size);
         }
+
+        jp.write_frame(s, image.width, image.height, progressive);
+
+        encodeScans(jp, stream, image.blocks, progressive);
+
+        // End of image marker
+        s.write16(0xffd9);
     }
 
 } // namespace jpeg
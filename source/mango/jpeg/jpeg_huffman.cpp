@@ -91,8 +91,15 @@ namespace jpeg
             while (x > h->maxcode[size]) { \
                 size++; \
             }  \
-            v = int(x >> (JPEG_REGISTER_SIZE - size)); \
-            symbol = h->valueAddress[size][v]; \
+            if (size > 16) { \
+                /* corrupted data: there is no code of this length */ \
+                state->corrupt->store(true, std::memory_order_relaxed); \
+                size = 16; \
+                symbol = 0; \
+            } else { \
+                v = int(x >> (JPEG_REGISTER_SIZE - size)); \
+                symbol = h->valueAddress[size][v]; \
+            } \
         } \
         buffer.remain -= size; \
     }
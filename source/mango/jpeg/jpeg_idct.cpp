@@ -132,6 +132,182 @@ namespace jpeg
         }
     }
 
+    // 12 bit samples: the first pass keeps one fractional bit so that the dequantized
+    // coefficients of the 12 bit precision fit into the 32 bit intermediate results.
+    void idct12(u16* dest, const BlockType* data, const u16* qt)
+    {
+        int temp[64];
+        int* v;
+
+        const int16_t *s = data;
+
+        v = temp;
+
+        for (int i = 0; i < 8; ++i)
+        {
+            if (s[1] || s[2] || s[3] || s[4] || s[5] || s[6] || s[7])
+            {
+                // dequantize
+                const int s0 = s[0] * qt[0];
+                const int s1 = s[1] * qt[1];
+                const int s2 = s[2] * qt[2];
+                const int s3 = s[3] * qt[3];
+                const int s4 = s[4] * qt[4];
+                const int s5 = s[5] * qt[5];
+                const int s6 = s[6] * qt[6];
+                const int s7 = s[7] * qt[7];
+
+                IDCT idct;
+                idct.compute(s0, s1, s2, s3, s4, s5, s6, s7);
+                const int bias = 0x400;
+                idct.x0 += bias;
+                idct.x1 += bias;
+                idct.x2 += bias;
+                idct.x3 += bias;
+                v[0] = (idct.x0 + idct.y3) >> 11;
+                v[1] = (idct.x1 + idct.y2) >> 11;
+                v[2] = (idct.x2 + idct.y1) >> 11;
+                v[3] = (idct.x3 + idct.y0) >> 11;
+                v[4] = (idct.x3 - idct.y0) >> 11;
+                v[5] = (idct.x2 - idct.y1) >> 11;
+                v[6] = (idct.x1 - idct.y2) >> 11;
+                v[7] = (idct.x0 - idct.y3) >> 11;
+            }
+            else
+            {
+                int dc = (s[0] * qt[0]) << 1;
+                v[0] = dc;
+                v[1] = dc;
+                v[2] = dc;
+                v[3] = dc;
+                v[4] = dc;
+                v[5] = dc;
+                v[6] = dc;
+                v[7] = dc;
+            }
+
+            v += 8;
+            s += 8;
+            qt += 8;
+        }
+
+        v = temp;
+
+        for (int i = 0; i < 8; ++i)
+        {
+            IDCT idct;
+            idct.compute(v[0], v[8], v[16], v[24], v[32], v[40], v[48], v[56]);
+            ++v;
+            const int bias = 0x8000 + (2048 << 16);
+            idct.x0 += bias;
+            idct.x1 += bias;
+            idct.x2 += bias;
+            idct.x3 += bias;
+            dest[0] = u16(clamp((idct.x0 + idct.y3) >> 16, 0, 4095));
+            dest[1] = u16(clamp((idct.x1 + idct.y2) >> 16, 0, 4095));
+            dest[2] = u16(clamp((idct.x2 + idct.y1) >> 16, 0, 4095));
+            dest[3] = u16(clamp((idct.x3 + idct.y0) >> 16, 0, 4095));
+            dest[4] = u16(clamp((idct.x3 - idct.y0) >> 16, 0, 4095));
+            dest[5] = u16(clamp((idct.x2 - idct.y1) >> 16, 0, 4095));
+            dest[6] = u16(clamp((idct.x1 - idct.y2) >> 16, 0, 4095));
+            dest[7] = u16(clamp((idct.x0 - idct.y3) >> 16, 0, 4095));
+            dest += 8;
+        }
+    }
+
+    // ------------------------------------------------------------------------------------------------
+    // Reduced size IDCT
+    // ------------------------------------------------------------------------------------------------
+
+    // The lowest size x size frequencies are transformed with a size point IDCT, which gives
+    // the block downsampled to size x size samples (the DCT scaling in libjpeg). The basis
+    // functions [x * size + u] include the amplitude correction and have 11 fractional bits.
+
+    static const int g_idct_basis_2 [] =
+    {
+        724,  724,
+        724, -724,
+    };
+
+    static const int g_idct_basis_4 [] =
+    {
+        724,  946,  724,  392,
+        724,  392, -724, -946,
+        724, -392, -724,  946,
+        724, -946,  724, -392,
+    };
+
+    template <int N>
+    static inline void idct_reduced(u8* dest, const BlockType* data, const u16* qt, const int* basis, bool transposed)
+    {
+        // distance between horizontal and vertical frequencies in the coefficients
+        const int ustep = transposed ? 8 : 1;
+        const int vstep = transposed ? 1 : 8;
+
+        int temp[N * N];
+
+        // columns; the result has 3 fractional bits
+        for (int u = 0; u < N; ++u)
+        {
+            int s[N];
+
+            for (int v = 0; v < N; ++v)
+            {
+                const int i = u * ustep + v * vstep;
+                s[v] = data[i] * qt[i];
+            }
+
+            for (int y = 0; y < N; ++y)
+            {
+                const int* b = basis + y * N;
+
+                int sum = 0;
+                for (int v = 0; v < N; ++v)
+                {
+                    sum += b[v] * s[v];
+                }
+
+                temp[y * N + u] = (sum + 128) >> 8;
+            }
+        }
+
+        // rows
+        for (int y = 0; y < N; ++y)
+        {
+            const int* t = temp + y * N;
+
+            for (int x = 0; x < N; ++x)
+            {
+                const int* b = basis + x * N;
+
+                int sum = 0;
+                for (int u = 0; u < N; ++u)
+                {
+                    sum += b[u] * t[u];
+                }
+
+                dest[y * N + x] = byteclamp(((sum + 0x2000) >> 14) + 128);
+            }
+        }
+    }
+
+    void idct_scaled(u8* dest, const BlockType* data, const u16* qt, int size, bool transposed)
+    {
+        switch (size)
+        {
+            case 1:
+                // average of the block
+                dest[0] = byteclamp(((data[0] * qt[0] + 4) >> 3) + 128);
+                break;
+            case 2:
+                idct_reduced<2>(dest, data, qt, g_idct_basis_2, transposed);
+                break;
+            case 4:
+                idct_reduced<4>(dest, data, qt, g_idct_basis_4, transposed);
+                break;
+        }
+    }
+
 #if defined(JPEG_ENABLE_SIMD)
 
     // ------------------------------------------------------------------------------------------------
@@ -238,18 +414,95 @@ namespace jpeg
         }
     }
 
-#endif // JPEG_ENABLE_SIMD
+    // 12 bit samples with natural order coefficients (the SSE2 and NEON layout). The 16 bit
+    // integer kernels would overflow with the 12 bit precision so this one is in floating point.
+    void idct12_simd(u16* dest, const BlockType* data, const u16* qt)
+    {
+        float32x4 temp[16];
 
-#if defined(JPEG_ENABLE_SSE2)
+        const float32x4 c0(0.3535533905f);
+        const float32x4 c1( 0.4619397662f, 0.1913417161f,-0.1913417161f,-0.4619397662f);
+        const float32x4 c2( 0.3535533905f,-0.3535533905f,-0.3535533905f, 0.3535533905f);
+        const float32x4 c3( 0.1913417161f,-0.4619397662f, 0.4619397662f,-0.1913417161f);
+        const float32x4 c4( 0.4903926402f, 0.4157348061f, 0.2777851165f, 0.0975451610f);
+        const float32x4 c5( 0.4157348061f,-0.0975451610f,-0.4903926402f,-0.2777851165f);
+        const float32x4 c6( 0.2777851165f,-0.4903926402f, 0.0975451610f, 0.4157348061f);
+        const float32x4 c7( 0.0975451610f,-0.2777851165f, 0.4157348061f,-0.4903926402f);
 
-    // ------------------------------------------------------------------------------------------------
-    // SSE2 implementation
-    // ------------------------------------------------------------------------------------------------
+        // rows
+        for (int i = 0; i < 8; ++i)
+        {
+            int16x8 d = *reinterpret_cast<const int16x8 *>(data);
+            uint16x8 q = *reinterpret_cast<const uint16x8 *>(qt);
+            float32x8 s = convert<float32x8>(int32x8(simd::extend32x8(d))) *
+                          convert<float32x8>(uint32x8(simd::extend32x8(q)));
+            float32x4 s0 = s.low;
+            float32x4 s1 = s.high;
+            float32x4 x = madd(madd(madd(s0.xxxx * c0, s0.zzzz, c1), s1.xxxx, c2), s1.zzzz, c3);
+            float32x4 y = madd(madd(madd(s0.yyyy * c4, s0.wwww, c5), s1.yyyy, c6), s1.wwww, c7);
+            float32x4 b = x - y;
 
-    // The original code is by Petr Kobalicek ; WE HAVE TAKEN LIBERTIES TO ADAPT IT TO OUR USE!!!
-    // https://github.com/kobalicek/simdtests
-    // [License]
-    // Public Domain <unlicense.org>
+            temp[i * 2 + 0] = x + y;
+            temp[i * 2 + 1] = b.wzyx;
+
+            data += 8;
+            qt += 8;
+        }
+
+        // columns
+        const float32x4 k0(0.3535533905f);
+        const float32x4 k1(0.4619397662f);
+        const float32x4 k2(0.1913417161f);
+        const float32x4 k3(0.4903926402f);
+        const float32x4 k4(0.4157348061f);
+        const float32x4 k5(0.2777851165f);
+        const float32x4 k6(0.0975451610f);
+        const float32x4 bias(2048.0f);
+        const float32x4 lower(0.0f);
+        const float32x4 upper(4095.0f);
+
+        float32x4 result[16];
+
+        for (int i = 0; i < 2; ++i)
+        {
+            const float32x4* v = temp + i;
+
+            float32x4 t0 = (v[0] + v[8]) * k0 + bias;
+            float32x4 t1 = (v[0] - v[8]) * k0 + bias;
+            float32x4 t2 = madd(v[4] * k1, v[12], k2);
+            float32x4 t3 = v[4] * k2 - v[12] * k1;
+
+            float32x4 x0 = t0 + t2;
+            float32x4 x1 = t1 + t3;
+            float32x4 x2 = t1 - t3;
+            float32x4 x3 = t0 - t2;
+
+            float32x4 y0 = madd(madd(madd(v[2] * k3, v[6], k4), v[10], k5), v[14], k6);
+            float32x4 y1 = v[2] * k4 - v[6] * k6 - v[10] * k3 - v[14] * k5;
+            float32x4 y2 = madd(v[2] * k5 - v[6] * k3, v[10], k6) + v[14] * k4;
+            float32x4 y3 = madd(v[2] * k6 - v[6] * k5, v[10], k4) - v[14] * k3;
+
+            result[i +  0] = clamp(x0 + y0, lower, upper);
+            result[i +  2] = clamp(x1 + y1, lower, upper);
+            result[i +  4] = clamp(x2 + y2, lower, upper);
+            result[i +  6] = clamp(x3 + y3, lower, upper);
+            result[i +  8] = clamp(x3 - y3, lower, upper);
+            result[i + 10] = clamp(x2 - y2, lower, upper);
+            result[i + 12] = clamp(x1 - y1, lower, upper);
+            result[i + 14] = clamp(x0 - y0, lower, upper);
+        }
+
+        int16x8* d = reinterpret_cast<int16x8 *>(dest);
+
+        for (int i = 0; i < 8; ++i)
+        {
+            d[i] = simd::narrow(convert<int32x4>(result[i * 2 + 0]).m, convert<int32x4>(result[i * 2 + 1]).m);
+        }
+    }
+
+#endif // JPEG_ENABLE_SIMD
+
+#if defined(JPEG_ENABLE_SSE2) || defined(JPEG_ENABLE_NEON)
 
     // Derived from jidctint's `jpeg_idct_islow`
     constexpr int JPEG_IDCT_PREC = 12;
@@ -278,6 +531,19 @@ namespace jpeg
     constexpr int JPEG_IDCT_ROW_NORM = (JPEG_IDCT_PREC + 2 + 3);
     constexpr int JPEG_IDCT_ROW_BIAS = (JPEG_IDCT_HALF(JPEG_IDCT_ROW_NORM) + (128 << JPEG_IDCT_ROW_NORM));
 
+#endif
+
+#if defined(JPEG_ENABLE_SSE2)
+
+    // ------------------------------------------------------------------------------------------------
+    // SSE2 implementation
+    // ------------------------------------------------------------------------------------------------
+
+    // The original code is by Petr Kobalicek ; WE HAVE TAKEN LIBERTIES TO ADAPT IT TO OUR USE!!!
+    // https://github.com/kobalicek/simdtests
+    // [License]
+    // Public Domain <unlicense.org>
+
 #define JPEG_CONST16_SSE2(x, y)  _mm_setr_epi16(x, y, x, y, x, y, x, y)
 #define JPEG_CONST32_SSE2(x)     _mm_setr_epi32(x, x, x, x)
 
@@ -423,6 +689,318 @@ namespace jpeg
         _mm_storeu_si128(d + 3, s3);
     }
 
+#if defined(MANGO_ENABLE_DISPATCH)
+
+    // ------------------------------------------------------------------------------------------------
+    // AVX2 implementation
+    // ------------------------------------------------------------------------------------------------
+
+    // Same computation as idct_sse2 but each 256 bit register holds a row from two blocks;
+    // the low 128 bits process the first block and the high 128 bits the second one.
+
+#define JPEG_CONST16_AVX2(x, y)  _mm256_set1_epi32(int((u32(y) << 16) | (u32(x) & 0xffff)))
+
+#define JPEG_IDCT_ROTATE_YMM(dst0, dst1, x, y, c0, c1) \
+    __m256i c0##_l = _mm256_unpacklo_epi16(x, y); \
+    __m256i c0##_h = _mm256_unpackhi_epi16(x, y); \
+    __m256i dst0##_l = _mm256_madd_epi16(c0##_l, c0); \
+    __m256i dst0##_h = _mm256_madd_epi16(c0##_h, c0); \
+    __m256i dst1##_l = _mm256_madd_epi16(c0##_l, c1); \
+    __m256i dst1##_h = _mm256_madd_epi16(c0##_h, c1);
+
+#define JPEG_IDCT_WIDEN_YMM(dst, in) \
+    __m256i dst##_l = _mm256_srai_epi32(_mm256_unpacklo_epi16(_mm256_setzero_si256(), (in)), 4); \
+    __m256i dst##_h = _mm256_srai_epi32(_mm256_unpackhi_epi16(_mm256_setzero_si256(), (in)), 4);
+
+#define JPEG_IDCT_WADD_YMM(dst, a, b) \
+    __m256i dst##_l = _mm256_add_epi32(a##_l, b##_l); \
+    __m256i dst##_h = _mm256_add_epi32(a##_h, b##_h);
+
+#define JPEG_IDCT_WSUB_YMM(dst, a, b) \
+    __m256i dst##_l = _mm256_sub_epi32(a##_l, b##_l); \
+    __m256i dst##_h = _mm256_sub_epi32(a##_h, b##_h);
+
+#define JPEG_IDCT_BFLY_YMM(dst0, dst1, a, b, bias, norm) { \
+    __m256i abiased_l = _mm256_add_epi32(a##_l, bias); \
+    __m256i abiased_h = _mm256_add_epi32(a##_h, bias); \
+    JPEG_IDCT_WADD_YMM(sum, abiased, b) \
+    JPEG_IDCT_WSUB_YMM(diff, abiased, b) \
+    dst0 = _mm256_packs_epi32(_mm256_srai_epi32(sum_l, norm), _mm256_srai_epi32(sum_h, norm)); \
+    dst1 = _mm256_packs_epi32(_mm256_srai_epi32(diff_l, norm), _mm256_srai_epi32(diff_h, norm)); \
+    }
+
+#define JPEG_IDCT_IDCT_PASS_YMM(bias, norm) { \
+    JPEG_IDCT_ROTATE_YMM(t2e, t3e, v2, v6, rot0_0, rot0_1) \
+    __m256i sum04 = _mm256_add_epi16(v0, v4); \
+    __m256i dif04 = _mm256_sub_epi16(v0, v4); \
+    JPEG_IDCT_WIDEN_YMM(t0e, sum04) \
+    JPEG_IDCT_WIDEN_YMM(t1e, dif04) \
+    JPEG_IDCT_WADD_YMM(x0, t0e, t3e) \
+    JPEG_IDCT_WSUB_YMM(x3, t0e, t3e) \
+    JPEG_IDCT_WADD_YMM(x1, t1e, t2e) \
+    JPEG_IDCT_WSUB_YMM(x2, t1e, t2e) \
+    JPEG_IDCT_ROTATE_YMM(y0o, y2o, v7, v3, rot2_0, rot2_1) \
+    JPEG_IDCT_ROTATE_YMM(y1o, y3o, v5, v1, rot3_0, rot3_1) \
+    __m256i sum17 = _mm256_add_epi16(v1, v7); \
+    __m256i sum35 = _mm256_add_epi16(v3, v5); \
+    JPEG_IDCT_ROTATE_YMM(y4o,y5o, sum17, sum35, rot1_0, rot1_1) \
+    JPEG_IDCT_WADD_YMM(x4, y0o, y4o) \
+    JPEG_IDCT_WADD_YMM(x5, y1o, y5o) \
+    JPEG_IDCT_WADD_YMM(x6, y2o, y5o) \
+    JPEG_IDCT_WADD_YMM(x7, y3o, y4o) \
+    JPEG_IDCT_BFLY_YMM(v0, v7, x0, x7, bias, norm) \
+    JPEG_IDCT_BFLY_YMM(v1, v6, x1, x6, bias, norm) \
+    JPEG_IDCT_BFLY_YMM(v2, v5, x2, x5, bias, norm) \
+    JPEG_IDCT_BFLY_YMM(v3, v4, x3, x4, bias, norm) \
+    }
+
+    MANGO_TARGET("avx2")
+    static inline void interleave8_avx2(__m256i &a, __m256i &b)
+    {
+        __m256i c = a;
+        a = _mm256_unpacklo_epi8(a, b);
+        b = _mm256_unpackhi_epi8(c, b);
+    }
+
+    MANGO_TARGET("avx2")
+    static inline void interleave16_avx2(__m256i &a, __m256i &b)
+    {
+        __m256i c = a;
+        a = _mm256_unpacklo_epi16(a, b);
+        b = _mm256_unpackhi_epi16(c, b);
+    }
+
+    MANGO_TARGET("avx2")
+    static inline __m256i load2_avx2(const void* p0, const void* p1)
+    {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p0));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p1));
+        return _mm256_inserti128_si256(_mm256_castsi128_si256(a), b, 1);
+    }
+
+    // IDCT of two consecutive blocks; the results are stored consecutively into dest
+    MANGO_TARGET("avx2")
+    void idct2_avx2(u8* dest, const BlockType* src, const u16* qt0, const u16* qt1)
+    {
+        const __m256i rot0_0 = JPEG_CONST16_AVX2(JPEG_IDCT_P_0_541196100                          , JPEG_IDCT_P_0_541196100 + JPEG_IDCT_M_1_847759065);
+        const __m256i rot0_1 = JPEG_CONST16_AVX2(JPEG_IDCT_P_0_541196100 + JPEG_IDCT_P_0_765366865, JPEG_IDCT_P_0_541196100                          );
+        const __m256i rot1_0 = JPEG_CONST16_AVX2(JPEG_IDCT_P_1_175875602 + JPEG_IDCT_M_0_899976223, JPEG_IDCT_P_1_175875602                          );
+        const __m256i rot1_1 = JPEG_CONST16_AVX2(JPEG_IDCT_P_1_175875602                          , JPEG_IDCT_P_1_175875602 + JPEG_IDCT_M_2_562915447);
+        const __m256i rot2_0 = JPEG_CONST16_AVX2(JPEG_IDCT_M_1_961570560 + JPEG_IDCT_P_0_298631336, JPEG_IDCT_M_1_961570560                          );
+        const __m256i rot2_1 = JPEG_CONST16_AVX2(JPEG_IDCT_M_1_961570560                          , JPEG_IDCT_M_1_961570560 + JPEG_IDCT_P_3_072711026);
+        const __m256i rot3_0 = JPEG_CONST16_AVX2(JPEG_IDCT_M_0_390180644 + JPEG_IDCT_P_2_053119869, JPEG_IDCT_M_0_390180644                          );
+        const __m256i rot3_1 = JPEG_CONST16_AVX2(JPEG_IDCT_M_0_390180644                          , JPEG_IDCT_M_0_390180644 + JPEG_IDCT_P_1_501321110);
+        const __m256i colBias = _mm256_set1_epi32(JPEG_IDCT_COL_BIAS);
+        const __m256i rowBias = _mm256_set1_epi32(JPEG_IDCT_ROW_BIAS);
+
+        // Load and dequantize
+        __m256i v0 = _mm256_mullo_epi16(load2_avx2(src + 0 * 8, src + 64 + 0 * 8), load2_avx2(qt0 + 0 * 8, qt1 + 0 * 8));
+        __m256i v1 = _mm256_mullo_epi16(load2_avx2(src + 1 * 8, src + 64 + 1 * 8), load2_avx2(qt0 + 1 * 8, qt1 + 1 * 8));
+        __m256i v2 = _mm256_mullo_epi16(load2_avx2(src + 2 * 8, src + 64 + 2 * 8), load2_avx2(qt0 + 2 * 8, qt1 + 2 * 8));
+        __m256i v3 = _mm256_mullo_epi16(load2_avx2(src + 3 * 8, src + 64 + 3 * 8), load2_avx2(qt0 + 3 * 8, qt1 + 3 * 8));
+        __m256i v4 = _mm256_mullo_epi16(load2_avx2(src + 4 * 8, src + 64 + 4 * 8), load2_avx2(qt0 + 4 * 8, qt1 + 4 * 8));
+        __m256i v5 = _mm256_mullo_epi16(load2_avx2(src + 5 * 8, src + 64 + 5 * 8), load2_avx2(qt0 + 5 * 8, qt1 + 5 * 8));
+        __m256i v6 = _mm256_mullo_epi16(load2_avx2(src + 6 * 8, src + 64 + 6 * 8), load2_avx2(qt0 + 6 * 8, qt1 + 6 * 8));
+        __m256i v7 = _mm256_mullo_epi16(load2_avx2(src + 7 * 8, src + 64 + 7 * 8), load2_avx2(qt0 + 7 * 8, qt1 + 7 * 8));
+
+        // IDCT columns
+        JPEG_IDCT_IDCT_PASS_YMM(colBias, 10)
+
+        // Transpose
+        interleave16_avx2(v0, v4);
+        interleave16_avx2(v2, v6);
+        interleave16_avx2(v1, v5);
+        interleave16_avx2(v3, v7);
+
+        interleave16_avx2(v0, v2);
+        interleave16_avx2(v1, v3);
+        interleave16_avx2(v4, v6);
+        interleave16_avx2(v5, v7);
+
+        interleave16_avx2(v0, v1);
+        interleave16_avx2(v2, v3);
+        interleave16_avx2(v4, v5);
+        interleave16_avx2(v6, v7);
+
+        // IDCT rows
+        JPEG_IDCT_IDCT_PASS_YMM(rowBias, 17)
+
+        // Pack to 8-bit integers, also saturates the result to 0..255
+        __m256i s0 = _mm256_packus_epi16(v0, v1);
+        __m256i s1 = _mm256_packus_epi16(v2, v3);
+        __m256i s2 = _mm256_packus_epi16(v4, v5);
+        __m256i s3 = _mm256_packus_epi16(v6, v7);
+
+        // Transpose
+        interleave8_avx2(s0, s2);
+        interleave8_avx2(s1, s3);
+        interleave8_avx2(s0, s1);
+        interleave8_avx2(s2, s3);
+        interleave8_avx2(s0, s2);
+        interleave8_avx2(s1, s3);
+
+        // Store; the low halves are the first block
+        __m256i* d = reinterpret_cast<__m256i *>(dest);
+        _mm256_storeu_si256(d + 0, _mm256_permute2x128_si256(s0, s2, 0x20));
+        _mm256_storeu_si256(d + 1, _mm256_permute2x128_si256(s1, s3, 0x20));
+        _mm256_storeu_si256(d + 2, _mm256_permute2x128_si256(s0, s2, 0x31));
+        _mm256_storeu_si256(d + 3, _mm256_permute2x128_si256(s1, s3, 0x31));
+    }
+
+#undef JPEG_CONST16_AVX2
+#undef JPEG_IDCT_ROTATE_YMM
+#undef JPEG_IDCT_WIDEN_YMM
+#undef JPEG_IDCT_WADD_YMM
+#undef JPEG_IDCT_WSUB_YMM
+#undef JPEG_IDCT_BFLY_YMM
+#undef JPEG_IDCT_IDCT_PASS_YMM
+
+#endif // MANGO_ENABLE_DISPATCH
+
 #endif // JPEG_ENABLE_SSE2
 
+#if defined(JPEG_ENABLE_NEON)
+
+    // ------------------------------------------------------------------------------------------------
+    // NEON implementation
+    // ------------------------------------------------------------------------------------------------
+
+    // Same fixed point computation as idct_sse2 so that the platforms decode identical images.
+
+    namespace
+    {
+
+        struct Wide
+        {
+            int32x4_t l;
+            int32x4_t h;
+        };
+
+        // x * c0 + y * c1
+        static inline Wide rotate(int16x8_t x, int16x8_t y, int c0, int c1)
+        {
+            Wide w;
+            w.l = vmlal_n_s16(vmull_n_s16(vget_low_s16(x), s16(c0)), vget_low_s16(y), s16(c1));
+            w.h = vmlal_n_s16(vmull_n_s16(vget_high_s16(x), s16(c0)), vget_high_s16(y), s16(c1));
+            return w;
+        }
+
+        // x << 12
+        static inline Wide widen(int16x8_t x)
+        {
+            Wide w;
+            w.l = vshll_n_s16(vget_low_s16(x), 12);
+            w.h = vshll_n_s16(vget_high_s16(x), 12);
+            return w;
+        }
+
+        static inline Wide add(Wide a, Wide b)
+        {
+            Wide w;
+            w.l = vaddq_s32(a.l, b.l);
+            w.h = vaddq_s32(a.h, b.h);
+            return w;
+        }
+
+        static inline Wide sub(Wide a, Wide b)
+        {
+            Wide w;
+            w.l = vsubq_s32(a.l, b.l);
+            w.h = vsubq_s32(a.h, b.h);
+            return w;
+        }
+
+        template <int norm>
+        static inline void butterfly(int16x8_t& dst0, int16x8_t& dst1, Wide a, Wide b, int32x4_t bias)
+        {
+            a.l = vaddq_s32(a.l, bias);
+            a.h = vaddq_s32(a.h, bias);
+            Wide sum = add(a, b);
+            Wide diff = sub(a, b);
+            dst0 = vcombine_s16(vqmovn_s32(vshrq_n_s32(sum.l, norm)), vqmovn_s32(vshrq_n_s32(sum.h, norm)));
+            dst1 = vcombine_s16(vqmovn_s32(vshrq_n_s32(diff.l, norm)), vqmovn_s32(vshrq_n_s32(diff.h, norm)));
+        }
+
+        template <int norm>
+        static inline void idct_pass(int16x8_t* v, int32x4_t bias)
+        {
+            Wide t2e = rotate(v[2], v[6], JPEG_IDCT_P_0_541196100, JPEG_IDCT_P_0_541196100 + JPEG_IDCT_M_1_847759065);
+            Wide t3e = rotate(v[2], v[6], JPEG_IDCT_P_0_541196100 + JPEG_IDCT_P_0_765366865, JPEG_IDCT_P_0_541196100);
+            Wide t0e = widen(vaddq_s16(v[0], v[4]));
+            Wide t1e = widen(vsubq_s16(v[0], v[4]));
+            Wide x0 = add(t0e, t3e);
+            Wide x3 = sub(t0e, t3e);
+            Wide x1 = add(t1e, t2e);
+            Wide x2 = sub(t1e, t2e);
+
+            Wide y0o = rotate(v[7], v[3], JPEG_IDCT_M_1_961570560 + JPEG_IDCT_P_0_298631336, JPEG_IDCT_M_1_961570560);
+            Wide y2o = rotate(v[7], v[3], JPEG_IDCT_M_1_961570560, JPEG_IDCT_M_1_961570560 + JPEG_IDCT_P_3_072711026);
+            Wide y1o = rotate(v[5], v[1], JPEG_IDCT_M_0_390180644 + JPEG_IDCT_P_2_053119869, JPEG_IDCT_M_0_390180644);
+            Wide y3o = rotate(v[5], v[1], JPEG_IDCT_M_0_390180644, JPEG_IDCT_M_0_390180644 + JPEG_IDCT_P_1_501321110);
+            int16x8_t sum17 = vaddq_s16(v[1], v[7]);
+            int16x8_t sum35 = vaddq_s16(v[3], v[5]);
+            Wide y4o = rotate(sum17, sum35, JPEG_IDCT_P_1_175875602 + JPEG_IDCT_M_0_899976223, JPEG_IDCT_P_1_175875602);
+            Wide y5o = rotate(sum17, sum35, JPEG_IDCT_P_1_175875602, JPEG_IDCT_P_1_175875602 + JPEG_IDCT_M_2_562915447);
+            Wide x4 = add(y0o, y4o);
+            Wide x5 = add(y1o, y5o);
+            Wide x6 = add(y2o, y5o);
+            Wide x7 = add(y3o, y4o);
+
+            butterfly<norm>(v[0], v[7], x0, x7, bias);
+            butterfly<norm>(v[1], v[6], x1, x6, bias);
+            butterfly<norm>(v[2], v[5], x2, x5, bias);
+            butterfly<norm>(v[3], v[4], x3, x4, bias);
+        }
+
+        static inline void transpose(int16x8_t* v)
+        {
+            int16x8x2_t t0 = vtrnq_s16(v[0], v[1]);
+            int16x8x2_t t1 = vtrnq_s16(v[2], v[3]);
+            int16x8x2_t t2 = vtrnq_s16(v[4], v[5]);
+            int16x8x2_t t3 = vtrnq_s16(v[6], v[7]);
+
+            int32x4x2_t u0 = vtrnq_s32(vreinterpretq_s32_s16(t0.val[0]), vreinterpretq_s32_s16(t1.val[0]));
+            int32x4x2_t u1 = vtrnq_s32(vreinterpretq_s32_s16(t0.val[1]), vreinterpretq_s32_s16(t1.val[1]));
+            int32x4x2_t u2 = vtrnq_s32(vreinterpretq_s32_s16(t2.val[0]), vreinterpretq_s32_s16(t3.val[0]));
+            int32x4x2_t u3 = vtrnq_s32(vreinterpretq_s32_s16(t2.val[1]), vreinterpretq_s32_s16(t3.val[1]));
+
+            v[0] = vreinterpretq_s16_s32(vcombine_s32(vget_low_s32(u0.val[0]), vget_low_s32(u2.val[0])));
+            v[1] = vreinterpretq_s16_s32(vcombine_s32(vget_low_s32(u1.val[0]), vget_low_s32(u3.val[0])));
+            v[2] = vreinterpretq_s16_s32(vcombine_s32(vget_low_s32(u0.val[1]), vget_low_s32(u2.val[1])));
+            v[3] = vreinterpretq_s16_s32(vcombine_s32(vget_low_s32(u1.val[1]), vget_low_s32(u3.val[1])));
+            v[4] = vreinterpretq_s16_s32(vcombine_s32(vget_high_s32(u0.val[0]), vget_high_s32(u2.val[0])));
+            v[5] = vreinterpretq_s16_s32(vcombine_s32(vget_high_s32(u1.val[0]), vget_high_s32(u3.val[0])));
+            v[6] = vreinterpretq_s16_s32(vcombine_s32(vget_high_s32(u0.val[1]), vget_high_s32(u2.val[1])));
+            v[7] = vreinterpretq_s16_s32(vcombine_s32(vget_high_s32(u1.val[1]), vget_high_s32(u3.val[1])));
+        }
+
+    } // namespace
+
+    void idct_neon(u8* dest, const BlockType* data, const u16* qt)
+    {
+        int16x8_t v[8];
+
+        // Load and dequantize
+        for (int i = 0; i < 8; ++i)
+        {
+            v[i] = vmulq_s16(vld1q_s16(data + i * 8), vreinterpretq_s16_u16(vld1q_u16(qt + i * 8)));
+        }
+
+        // IDCT columns
+        idct_pass<10>(v, vdupq_n_s32(JPEG_IDCT_COL_BIAS));
+        transpose(v);
+
+        // IDCT rows
+        idct_pass<17>(v, vdupq_n_s32(JPEG_IDCT_ROW_BIAS));
+        transpose(v);
+
+        // Pack to 8-bit integers, also saturates the result to 0..255
+        for (int i = 0; i < 8; ++i)
+        {
+            vst1_u8(dest + i * 8, vqmovun_s16(v[i]));
+        }
+    }
+
+#endif // JPEG_ENABLE_NEON
+
 } // namespace jpeg
@@ -52,6 +52,10 @@ namespace jpeg
 #define PACK_BGRA(y) \
     0xff000000 | (byteclamp(y + r) << 16) | (byteclamp(y + g) << 8) | byteclamp(y + b);
 
+// the layout kernels write B8G8R8A8 or R8G8B8A8 (when rgba is set)
+#define PACK_COLOR(y) \
+    0xff000000 | (byteclamp(y + (rgba ? b : r)) << 16) | (byteclamp(y + g) << 8) | byteclamp(y + (rgba ? r : b));
+
 // ----------------------------------------------------------------------------
 // Generic C++ implementation
 // ----------------------------------------------------------------------------
@@ -94,6 +98,9 @@ void process_YCbCr(u8* dest, int stride, const BlockType* data, ProcessState* st
     u8* cb_data = result + cb_offset;
     u8* cr_data = result + cr_offset;
 
+    const int xblocks = state->xblocks >> state->frame[0].Hsf;
+    const int xstride = 8 * state->bytes_per_pixel;
+
     // process MCU
     for (int yb = 0; yb < ysize; ++yb)
     {
@@ -102,8 +109,8 @@ void process_YCbCr(u8* dest, int stride, const BlockType* data, ProcessState* st
 
         for (int xb = 0; xb < xsize; ++xb)
         {
-            u8* dest_block = dest + yb * 8 * stride + xb * 8 * sizeof(u32);
-            u8* y_block = result + (yb * xsize + xb) * 64;
+            u8* dest_block = dest + yb * 8 * stride + xb * xstride;
+            u8* y_block = result + (yb * xblocks + xb) * 64;
             u8* cb_block = cb_data + yb * (8 >> cb_yshift) * 8 + xb * (8 >> cb_xshift);
             u8* cr_block = cr_data + yb * (8 >> cr_yshift) * 8 + xb * (8 >> cr_xshift);
 
@@ -113,19 +120,29 @@ void process_YCbCr(u8* dest, int stride, const BlockType* data, ProcessState* st
             // process 8x8 block
             for (int y = 0; y < ymax; ++y)
             {
-                u32* d = reinterpret_cast<u32*>(dest_block);
-
                 u8* cb_scan = cb_block + (y >> cb_yshift) * 8;
                 u8* cr_scan = cr_block + (y >> cr_yshift) * 8;
 
-                for (int x = 0; x < xmax; ++x)
+                u8 cb[8];
+                u8 cr[8];
+
+                for (int x = 0; x < 8; ++x)
+                {
+                    cb[x] = cb_scan[x >> cb_xshift];
+                    cr[x] = cr_scan[x >> cr_xshift];
+                }
+
+                if (xmax == 8)
+                {
+                    state->convert_YCbCr(dest_block, y_block, cb, cr);
+                }
+                else
                 {
-                    u8 Y = y_block[x];
-                    u8 cb = cb_scan[x >> cb_xshift];
-                    u8 cr = cr_scan[x >> cr_xshift];
-                    COMPUTE_CBCR(cb, cr);
-                    d[x] = PACK_BGRA(Y);
+                    u8 temp[8 * 16];
+                    state->convert_YCbCr(temp, y_block, cb, cr);
+                    std::memcpy(dest_block, temp, xmax * state->bytes_per_pixel);
                 }
+
                 dest_block += stride;
                 y_block += 8;
             }
@@ -164,6 +181,9 @@ void process_CMYK(u8* dest, int stride, const BlockType* data, ProcessState* sta
     u8* cr_data = result + cr_offset;
     u8* ck_data = result + ck_offset;
 
+    const int xblocks = state->xblocks >> state->frame[0].Hsf;
+    const int xstride = 8 * state->bytes_per_pixel;
+
     // process MCU
     for (int yb = 0; yb < ysize; ++yb)
     {
@@ -172,8 +192,8 @@ void process_CMYK(u8* dest, int stride, const BlockType* data, ProcessState* sta
 
         for (int xb = 0; xb < xsize; ++xb)
         {
-            u8* dest_block = dest + yb * 8 * stride + xb * 8 * sizeof(u32);
-            u8* y_block = result + (yb * xsize + xb) * 64;
+            u8* dest_block = dest + yb * 8 * stride + xb * xstride;
+            u8* y_block = result + (yb * xblocks + xb) * 64;
             u8* cb_block = cb_data + yb * (8 >> cb_yshift) * 8 + xb * (8 >> cb_xshift);
             u8* cr_block = cr_data + yb * (8 >> cr_yshift) * 8 + xb * (8 >> cr_xshift);
             u8* ck_block = ck_data + yb * (8 >> ck_yshift) * 8 + xb * (8 >> ck_xshift);
@@ -184,22 +204,32 @@ void process_CMYK(u8* dest, int stride, const BlockType* data, ProcessState* sta
             // process 8x8 block
             for (int y = 0; y < ymax; ++y)
             {
-                u32* d = reinterpret_cast<u32*>(dest_block);
-
                 u8* cb_scan = cb_block + (y >> cb_yshift) * 8;
                 u8* cr_scan = cr_block + (y >> cr_yshift) * 8;
                 u8* ck_scan = ck_block + (y >> ck_yshift) * 8;
 
-                for (int x = 0; x < xmax; ++x)
+                u8 cb[8];
+                u8 cr[8];
+                u8 ck[8];
+
+                for (int x = 0; x < 8; ++x)
+                {
+                    cb[x] = cb_scan[x >> cb_xshift];
+                    cr[x] = cr_scan[x >> cr_xshift];
+                    ck[x] = ck_scan[x >> ck_xshift];
+                }
+
+                if (xmax == 8)
                 {
-                    u8 Y = y_block[x];
-                    u8 cb = cb_scan[x >> cb_xshift];
-                    u8 cr = cr_scan[x >> cr_xshift];
-                    u8 ck = ck_scan[x >> ck_xshift];
-                    COMPUTE_CBCR(cb, cr);
-                    COMPUTE_CMYK(Y, ck);
-                    d[x] = PACK_BGRA(0);
+                    state->convert_CMYK(dest_block, y_block, cb, cr, ck);
                 }
+                else
+                {
+                    u8 temp[8 * 16];
+                    state->convert_CMYK(temp, y_block, cb, cr, ck);
+                    std::memcpy(dest_block, temp, xmax * state->bytes_per_pixel);
+                }
+
                 dest_block += stride;
                 y_block += 8;
             }
@@ -216,6 +246,7 @@ void process_YCbCr_8x8(u8* dest, int stride, const BlockType* data, ProcessState
     state->idct(result + 64 * 2, data + 64 * 2, state->block[2].qt); // Cr
 
     // color conversion
+    const bool rgba = state->rgba;
     const u8* src = result;
 
     for (int y = 0; y < 8; ++y)
@@ -228,7 +259,7 @@ void process_YCbCr_8x8(u8* dest, int stride, const BlockType* data, ProcessState
             int cb = s[x + 64];
             int cr = s[x + 128];
             COMPUTE_CBCR(cb, cr);
-            d[x] = PACK_BGRA(s[x]);
+            d[x] = PACK_COLOR(s[x]);
         }
         
         dest += stride;
@@ -248,6 +279,7 @@ void process_YCbCr_8x16(u8* dest, int stride, const BlockType* data, ProcessStat
     state->idct(result + 192, data + 192, state->block[3].qt); // Cr
 
     // color conversion
+    const bool rgba = state->rgba;
     for (int y = 0; y < 8; ++y)
     {
         u32* d0 = reinterpret_cast<u32*>(dest);
@@ -260,8 +292,8 @@ void process_YCbCr_8x16(u8* dest, int stride, const BlockType* data, ProcessStat
             int cb = c[x + 0];
             int cr = c[x + 64];
             COMPUTE_CBCR(cb, cr);
-            d0[x] = PACK_BGRA(s[x + 0]);
-            d1[x] = PACK_BGRA(s[x + 8]);
+            d0[x] = PACK_COLOR(s[x + 0]);
+            d1[x] = PACK_COLOR(s[x + 8]);
         }
 
         dest += stride * 2;
@@ -281,6 +313,7 @@ void process_YCbCr_16x8(u8* dest, int stride, const BlockType* data, ProcessStat
     state->idct(result + 192, data + 192, state->block[3].qt); // Cr
 
     // color conversion
+    const bool rgba = state->rgba;
     for (int y = 0; y < 8; ++y)
     {
         u32* d = reinterpret_cast<u32*>(dest);
@@ -292,8 +325,8 @@ void process_YCbCr_16x8(u8* dest, int stride, const BlockType* data, ProcessStat
             int cb = c[x + 0];
             int cr = c[x + 64];
             COMPUTE_CBCR(cb, cr);
-            d[x * 2 + 0] = PACK_BGRA(s[x * 2 + 0]);
-            d[x * 2 + 1] = PACK_BGRA(s[x * 2 + 1]);
+            d[x * 2 + 0] = PACK_COLOR(s[x * 2 + 0]);
+            d[x * 2 + 1] = PACK_COLOR(s[x * 2 + 1]);
         }
 
         for (int x = 0; x < 4; ++x)
@@ -301,8 +334,8 @@ void process_YCbCr_16x8(u8* dest, int stride, const BlockType* data, ProcessStat
             int cb = c[x + 4];
             int cr = c[x + 68];
             COMPUTE_CBCR(cb, cr);
-            d[x * 2 + 8] = PACK_BGRA(s[x * 2 + 64]);
-            d[x * 2 + 9] = PACK_BGRA(s[x * 2 + 65]);
+            d[x * 2 + 8] = PACK_COLOR(s[x * 2 + 64]);
+            d[x * 2 + 9] = PACK_COLOR(s[x * 2 + 65]);
         }
 
         dest += stride;
@@ -324,6 +357,7 @@ void process_YCbCr_16x16(u8* dest, int stride, const BlockType* data, ProcessSta
     state->idct(result + 320, data + 320, state->block[5].qt); // Cr
 
     // color conversion
+    const bool rgba = state->rgba;
     for (int y = 0; y < 8; ++y)
     {
         u32* d0 = reinterpret_cast<u32*>(dest);
@@ -336,10 +370,10 @@ void process_YCbCr_16x16(u8* dest, int stride, const BlockType* data, ProcessSta
             int cb = c[x + 0];
             int cr = c[x + 64];
             COMPUTE_CBCR(cb, cr);
-            d0[x * 2 + 0] = PACK_BGRA(s[x * 2 + 0]);
-            d0[x * 2 + 1] = PACK_BGRA(s[x * 2 + 1]);
-            d1[x * 2 + 0] = PACK_BGRA(s[x * 2 + 8]);
-            d1[x * 2 + 1] = PACK_BGRA(s[x * 2 + 9]);
+            d0[x * 2 + 0] = PACK_COLOR(s[x * 2 + 0]);
+            d0[x * 2 + 1] = PACK_COLOR(s[x * 2 + 1]);
+            d1[x * 2 + 0] = PACK_COLOR(s[x * 2 + 8]);
+            d1[x * 2 + 1] = PACK_COLOR(s[x * 2 + 9]);
         }
 
         for (int x = 0; x < 4; ++x)
@@ -347,10 +381,10 @@ void process_YCbCr_16x16(u8* dest, int stride, const BlockType* data, ProcessSta
             int cb = c[x + 4];
             int cr = c[x + 68];
             COMPUTE_CBCR(cb, cr);
-            d0[x * 2 + 8] = PACK_BGRA(s[x * 2 + 128]);
-            d0[x * 2 + 9] = PACK_BGRA(s[x * 2 + 129]);
-            d1[x * 2 + 8] = PACK_BGRA(s[x * 2 + 136]);
-            d1[x * 2 + 9] = PACK_BGRA(s[x * 2 + 137]);
+            d0[x * 2 + 8] = PACK_COLOR(s[x * 2 + 128]);
+            d0[x * 2 + 9] = PACK_COLOR(s[x * 2 + 129]);
+            d1[x * 2 + 8] = PACK_COLOR(s[x * 2 + 136]);
+            d1[x * 2 + 9] = PACK_COLOR(s[x * 2 + 137]);
         }
 
         dest += stride * 2;
@@ -360,317 +394,1849 @@ void process_YCbCr_16x16(u8* dest, int stride, const BlockType* data, ProcessSta
     MANGO_UNREFERENCED_PARAMETER(height);
 }
 
-#undef COMPUTE_CBCR
-#undef COMPUTE_CMYK
-#undef PACK_BGRA
-
-#if defined(JPEG_ENABLE_SSE2)
-    
-    // ------------------------------------------------------------------------------------------------
-    // SSE2 implementation
-    // ------------------------------------------------------------------------------------------------
+void convert_YCbCr(u8* dest, const u8* y, const u8* cb, const u8* cr)
+{
+    u32* d = reinterpret_cast<u32*>(dest);
 
-    // The original code is by Petr Kobalicek ; WE HAVE TAKEN LIBERTIES TO ADAPT IT TO OUR USE!!!
-    // https://github.com/kobalicek/simdtests
-    // [License]
-    // Public Domain <unlicense.org>
+    for (int x = 0; x < 8; ++x)
+    {
+        COMPUTE_CBCR(cb[x], cr[x]);
+        d[x] = PACK_BGRA(y[x]);
+    }
+}
 
-    constexpr int JPEG_PREC = 12;
-    constexpr int JPEG_SCALE(int x) { return x << JPEG_PREC; }
-    constexpr int JPEG_FIXED(double x) { return int((x * double(1 << JPEG_PREC) + 0.5)); }
+void convert_CMYK(u8* dest, const u8* y, const u8* cb, const u8* cr, const u8* k)
+{
+    u32* d = reinterpret_cast<u32*>(dest);
 
-#define JPEG_CONST_SSE2(x, y)  _mm_setr_epi16(x, y, x, y, x, y, x, y)
+    for (int x = 0; x < 8; ++x)
+    {
+        COMPUTE_CBCR(cb[x], cr[x]);
+        COMPUTE_CMYK(y[x], k[x]);
+        d[x] = PACK_BGRA(0);
+    }
+}
 
-    static inline
-    void convert_ycbcr_8x1_sse2(u8* dest, __m128i y, __m128i cb, __m128i cr, __m128i s0, __m128i s1, __m128i s2, __m128i rounding)
+void convert_YCbCr_RGBA(u8* dest, const u8* y, const u8* cb, const u8* cr)
+{
+    for (int x = 0; x < 8; ++x)
     {
-        __m128i zero = _mm_setzero_si128();
+        COMPUTE_CBCR(cb[x], cr[x]);
+        dest[0] = byteclamp(y[x] + r);
+        dest[1] = byteclamp(y[x] + g);
+        dest[2] = byteclamp(y[x] + b);
+        dest[3] = 0xff;
+        dest += 4;
+    }
+}
 
-        __m128i r_l = _mm_madd_epi16(_mm_unpacklo_epi16(y, cr), s0);
-        __m128i r_h = _mm_madd_epi16(_mm_unpackhi_epi16(y, cr), s0);
+void convert_YCbCr_RGB565(u8* dest, const u8* y, const u8* cb, const u8* cr)
+{
+    u16* d = reinterpret_cast<u16*>(dest);
 
-        __m128i b_l = _mm_madd_epi16(_mm_unpacklo_epi16(y, cb), s1);
-        __m128i b_h = _mm_madd_epi16(_mm_unpackhi_epi16(y, cb), s1);
+    for (int x = 0; x < 8; ++x)
+    {
+        COMPUTE_CBCR(cb[x], cr[x]);
+        u32 red   = byteclamp(y[x] + r);
+        u32 green = byteclamp(y[x] + g);
+        u32 blue  = byteclamp(y[x] + b);
+        d[x] = u16(((red & 0xf8) << 8) | ((green & 0xfc) << 3) | (blue >> 3));
+    }
+}
 
-        __m128i g_l = _mm_madd_epi16(_mm_unpacklo_epi16(cb, cr), s2);
-        __m128i g_h = _mm_madd_epi16(_mm_unpackhi_epi16(cb, cr), s2);
+void convert_YCbCr_RGBA32F(u8* dest, const u8* y, const u8* cb, const u8* cr)
+{
+    float* d = reinterpret_cast<float*>(dest);
+    const float scale = 1.0f / 255.0f;
 
-        g_l = _mm_add_epi32(g_l, _mm_slli_epi32(_mm_unpacklo_epi16(y, zero), JPEG_PREC));
-        g_h = _mm_add_epi32(g_h, _mm_slli_epi32(_mm_unpackhi_epi16(y, zero), JPEG_PREC));
+    for (int x = 0; x < 8; ++x)
+    {
+        COMPUTE_CBCR(cb[x], cr[x]);
+        d[0] = byteclamp(y[x] + r) * scale;
+        d[1] = byteclamp(y[x] + g) * scale;
+        d[2] = byteclamp(y[x] + b) * scale;
+        d[3] = 1.0f;
+        d += 4;
+    }
+}
 
-        r_l = _mm_add_epi32(r_l, rounding);
-        r_h = _mm_add_epi32(r_h, rounding);
+// grayscale into a color format through the output converter
+void process_Y_color(u8* dest, int stride, const BlockType* data, ProcessState* state, int width, int height)
+{
+    static const u8 neutral[8] = { 128, 128, 128, 128, 128, 128, 128, 128 };
 
-        b_l = _mm_add_epi32(b_l, rounding);
-        b_h = _mm_add_epi32(b_h, rounding);
+    u8 result[64];
+    state->idct(result, data, state->block[0].qt); // Y
 
-        g_l = _mm_add_epi32(g_l, rounding);
-        g_h = _mm_add_epi32(g_h, rounding);
+    for (int y = 0; y < height; ++y)
+    {
+        if (width == 8)
+        {
+            state->convert_YCbCr(dest, result + y * 8, neutral, neutral);
+        }
+        else
+        {
+            u8 temp[8 * 16];
+            state->convert_YCbCr(temp, result + y * 8, neutral, neutral);
+            std::memcpy(dest, temp, width * state->bytes_per_pixel);
+        }
 
-        r_l = _mm_srai_epi32(r_l, JPEG_PREC);
-        r_h = _mm_srai_epi32(r_h, JPEG_PREC);
+        dest += stride;
+    }
+}
 
-        b_l = _mm_srai_epi32(b_l, JPEG_PREC);
-        b_h = _mm_srai_epi32(b_h, JPEG_PREC);
+// ----------------------------------------------------------------------------
+// reduced size output
+// ----------------------------------------------------------------------------
 
-        g_l = _mm_srai_epi32(g_l, JPEG_PREC);
-        g_h = _mm_srai_epi32(g_h, JPEG_PREC);
+// The blocks are transformed into scale x scale samples and the MCU is converted one
+// row at a time; the width and height are in the reduced size. The subsampled components
+// are reduced less to keep their resolution; when the subsampling is not the same in both
+// directions the extra samples in the less subsampled direction are skipped.
+void process_scaled(u8* dest, int stride, const BlockType* data, ProcessState* state, int width, int height)
+{
+    static const u8 neutral[32] =
+    {
+        128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128,
+        128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128,
+    };
 
-        __m128i r = _mm_packs_epi32(r_l, r_h);
-        __m128i g = _mm_packs_epi32(g_l, g_h);
-        __m128i b = _mm_packs_epi32(b_l, b_h);
+    const int scale = state->scale;
+    const int comps = state->frames;
 
-        r = _mm_packus_epi16(r, r);
-        g = _mm_packus_epi16(g, g);
-        b = _mm_packus_epi16(b, b);
+    u8 result[64 * JPEG_MAX_BLOCKS_IN_MCU];
 
-        __m128i ra = _mm_unpacklo_epi8(r, _mm_cmpeq_epi8(r, r));
-        __m128i bg = _mm_unpacklo_epi8(b, g);
+    const int bytes_per_pixel = state->bytes_per_pixel;
 
-        __m128i bgra0 = _mm_unpacklo_epi16(bg, ra);
-        __m128i bgra1 = _mm_unpackhi_epi16(bg, ra);
+    // the conversion is done 8 pixels at a time
+    const int count = (width + 7) & ~7;
 
-        _mm_storeu_si128(reinterpret_cast<__m128i *>(dest +  0), bgra0);
-        _mm_storeu_si128(reinterpret_cast<__m128i *>(dest + 16), bgra1);
-    }
+    // block size (log2), vertical sample shifts and the horizontal sample offsets of each component
+    int bits[JPEG_MAX_COMPS_IN_SCAN];
+    int yshift[JPEG_MAX_COMPS_IN_SCAN];
+    int yskip[JPEG_MAX_COMPS_IN_SCAN];
+    int offset[JPEG_MAX_COMPS_IN_SCAN][32];
 
-    void process_YCbCr_8x8_sse2(u8* dest, int stride, const BlockType* data, ProcessState* state, int width, int height)
+    for (int c = 0; c < comps; ++c)
     {
-        u8 result[64 * 3];
-
-        state->idct(result +   0, data +   0, state->block[0].qt); // Y
-        state->idct(result +  64, data +  64, state->block[1].qt); // Cb
-        state->idct(result + 128, data + 128, state->block[2].qt); // Cr
+        const Frame& frame = state->frame[c];
 
-        // color conversion
-        const __m128i s0 = JPEG_CONST_SSE2(JPEG_FIXED( 1.00000), JPEG_FIXED( 1.40200));
-        const __m128i s1 = JPEG_CONST_SSE2(JPEG_FIXED( 1.00000), JPEG_FIXED( 1.77200));
-        const __m128i s2 = JPEG_CONST_SSE2(JPEG_FIXED(-0.34414), JPEG_FIXED(-0.71414));
-        const __m128i rounding = _mm_set1_epi32(1 << (JPEG_PREC - 1));
-        const __m128i tosigned = _mm_set1_epi16(-128);
+        int k = 0;
 
-        for (int y = 0; y < 4; ++y)
-        {
-            __m128i yy = _mm_loadu_si128(reinterpret_cast<const __m128i *>(result + y * 16 + 0));
-            __m128i cb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(result + y * 16 + 64));
-            __m128i cr = _mm_loadu_si128(reinterpret_cast<const __m128i *>(result + y * 16 + 128));
+        while (k < std::max(frame.Hsf, frame.Vsf) && (scale << (k + 1)) <= 8)
+            ++k;
 
-            __m128i zero = _mm_setzero_si128();
+        const int size = scale << k;
+        bits[c] = u32_log2(size);
+        yshift[c] = std::max(0, frame.Vsf - k);
+        yskip[c] = std::max(0, k - frame.Vsf);
 
-            __m128i cb0 = _mm_unpacklo_epi8(cb, zero);
-            __m128i cr0 = _mm_unpacklo_epi8(cr, zero);
-            __m128i cb1 = _mm_unpackhi_epi8(cb, zero);
-            __m128i cr1 = _mm_unpackhi_epi8(cr, zero);
+        const int xshift = std::max(0, frame.Hsf - k);
+        const int xskip = std::max(0, k - frame.Hsf);
 
-            cb0 = _mm_add_epi16(cb0, tosigned);
-            cr0 = _mm_add_epi16(cr0, tosigned);
-            cb1 = _mm_add_epi16(cb1, tosigned);
-            cr1 = _mm_add_epi16(cr1, tosigned);
+        for (int x = 0; x < count; ++x)
+        {
+            const int sx = (std::min(x, width - 1) >> xshift) << xskip;
+            offset[c][x] = (sx >> bits[c]) * 64 + (sx & (size - 1));
+        }
 
-            convert_ycbcr_8x1_sse2(dest, _mm_unpacklo_epi8(yy, zero), cb0, cr0, s0, s1, s2, rounding);
-            dest += stride;
+        const int first = frame.offset;
+        const int last = c + 1 < comps ? state->frame[c + 1].offset : state->blocks;
 
-            convert_ycbcr_8x1_sse2(dest, _mm_unpackhi_epi8(yy, zero), cb1, cr1, s0, s1, s2, rounding);
-            dest += stride;
+        for (int i = first; i < last; ++i)
+        {
+            if (size == 8)
+                state->idct(result + i * 64, data + i * 64, state->block[i].qt);
+            else
+                idct_scaled(result + i * 64, data + i * 64, state->block[i].qt, size, state->transposed);
         }
-
-        MANGO_UNREFERENCED_PARAMETER(width);
-        MANGO_UNREFERENCED_PARAMETER(height);
     }
-    
-    void process_YCbCr_8x16_sse2(u8* dest, int stride, const BlockType* data, ProcessState* state, int width, int height)
+
+    for (int y = 0; y < height; ++y)
     {
-        u8 result[64 * 4];
+        u8 sample[JPEG_MAX_COMPS_IN_SCAN][32];
 
-        state->idct(result +   0, data +   0, state->block[0].qt); // Y0
-        state->idct(result +  64, data +  64, state->block[1].qt); // Y1
-        state->idct(result + 128, data + 128, state->block[2].qt); // Cb
-        state->idct(result + 192, data + 192, state->block[3].qt); // Cr
+        for (int c = 0; c < comps; ++c)
+        {
+            const Frame& frame = state->frame[c];
+            const int xblocks = state->xblocks >> frame.Hsf;
+            const int sy = (y >> yshift[c]) << yskip[c];
+            const int mask = (1 << bits[c]) - 1;
+            const u8* scan = result + (frame.offset + (sy >> bits[c]) * xblocks) * 64 + ((sy & mask) << bits[c]);
 
-        // color conversion
-        const __m128i s0 = JPEG_CONST_SSE2(JPEG_FIXED( 1.00000), JPEG_FIXED( 1.40200));
-        const __m128i s1 = JPEG_CONST_SSE2(JPEG_FIXED( 1.00000), JPEG_FIXED( 1.77200));
-        const __m128i s2 = JPEG_CONST_SSE2(JPEG_FIXED(-0.34414), JPEG_FIXED(-0.71414));
-        const __m128i rounding = _mm_set1_epi32(1 << (JPEG_PREC - 1));
-        const __m128i tosigned = _mm_set1_epi16(-128);
+            for (int x = 0; x < count; ++x)
+            {
+                sample[c][x] = scan[offset[c][x]];
+            }
+        }
 
-        for (int y = 0; y < 4; ++y)
+        u8 temp[32 * 16];
+
+        for (int x = 0; x < count; x += 8)
         {
-            __m128i y0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(result + y * 32 + 0));
-            __m128i y1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(result + y * 32 + 16));
-            __m128i cb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(result + y * 16 + 128));
-            __m128i cr = _mm_loadu_si128(reinterpret_cast<const __m128i *>(result + y * 16 + 192));
+            u8* output = temp + x * bytes_per_pixel;
 
-            __m128i zero = _mm_setzero_si128();
+            switch (comps)
+            {
+                case 1:
+                    if (bytes_per_pixel == 1)
+                        std::memcpy(output, sample[0] + x, 8);
+                    else
+                        state->convert_YCbCr(output, sample[0] + x, neutral, neutral);
+                    break;
+                case 3:
+                    state->convert_YCbCr(output, sample[0] + x, sample[1] + x, sample[2] + x);
+                    break;
+                case 4:
+                    state->convert_CMYK(output, sample[0] + x, sample[1] + x, sample[2] + x, sample[3] + x);
+                    break;
+            }
+        }
 
-            __m128i cb0 = _mm_unpacklo_epi8(cb, zero);
-            __m128i cr0 = _mm_unpacklo_epi8(cr, zero);
-            __m128i cb1 = _mm_unpackhi_epi8(cb, zero);
-            __m128i cr1 = _mm_unpackhi_epi8(cr, zero);
+        std::memcpy(dest, temp, width * bytes_per_pixel);
+        dest += stride;
+    }
+}
 
-            cb0 = _mm_add_epi16(cb0, tosigned);
-            cr0 = _mm_add_epi16(cr0, tosigned);
-            cb1 = _mm_add_epi16(cb1, tosigned);
-            cr1 = _mm_add_epi16(cr1, tosigned);
+// ----------------------------------------------------------------------------
+// planar YCbCr 4:2:0 output
+// ----------------------------------------------------------------------------
 
-            convert_ycbcr_8x1_sse2(dest, _mm_unpacklo_epi8(y0, zero), cb0, cr0, s0, s1, s2, rounding);
-            dest += stride;
+/*
+    The destination is the luma plane; the MCU position is recovered from the
+    destination address to locate the chroma samples. Chroma which is already
+    4:2:0 is copied as-is, other layouts are box filtered from the MCU samples.
+*/
 
-            convert_ycbcr_8x1_sse2(dest, _mm_unpackhi_epi8(y0, zero), cb0, cr0, s0, s1, s2, rounding);
-            dest += stride;
+// copy in fixed size chunks; the rows are too short for a memcpy() call
+static inline
+void planar_copy(u8* dest, const u8* src, int count)
+{
+    int x = 0;
 
-            convert_ycbcr_8x1_sse2(dest, _mm_unpacklo_epi8(y1, zero), cb1, cr1, s0, s1, s2, rounding);
-            dest += stride;
-            
-            convert_ycbcr_8x1_sse2(dest, _mm_unpackhi_epi8(y1, zero), cb1, cr1, s0, s1, s2, rounding);
-            dest += stride;
-        }
+    for ( ; x + 8 <= count; x += 8)
+    {
+        std::memcpy(dest + x, src + x, 8);
+    }
 
-        MANGO_UNREFERENCED_PARAMETER(width);
-        MANGO_UNREFERENCED_PARAMETER(height);
+    for ( ; x < count; ++x)
+    {
+        dest[x] = src[x];
     }
-    
-    void process_YCbCr_16x8_sse2(u8* dest, int stride, const BlockType* data, ProcessState* state, int width, int height)
+}
+
+// gather one row of component samples from the MCU blocks
+static inline
+const u8* planar_row(u8* temp, const u8* data, int xblocks, int y)
+{
+    if (xblocks == 1)
     {
-        u8 result[64 * 4];
+        return data + (y & 7) * 8;
+    }
 
-        state->idct(result +   0, data +   0, state->block[0].qt); // Y0
-        state->idct(result +  64, data +  64, state->block[1].qt); // Y1
-        state->idct(result + 128, data + 128, state->block[2].qt); // Cb
-        state->idct(result + 192, data + 192, state->block[3].qt); // Cr
+    const u8* src = data + (y >> 3) * xblocks * 64 + (y & 7) * 8;
 
-        // color conversion
-        const __m128i s0 = JPEG_CONST_SSE2(JPEG_FIXED( 1.00000), JPEG_FIXED( 1.40200));
-        const __m128i s1 = JPEG_CONST_SSE2(JPEG_FIXED( 1.00000), JPEG_FIXED( 1.77200));
-        const __m128i s2 = JPEG_CONST_SSE2(JPEG_FIXED(-0.34414), JPEG_FIXED(-0.71414));
-        const __m128i rounding = _mm_set1_epi32(1 << (JPEG_PREC - 1));
-        const __m128i tosigned = _mm_set1_epi16(-128);
+    for (int i = 0; i < xblocks; ++i)
+    {
+        std::memcpy(temp + i * 8, src + i * 64, 8);
+    }
 
-        for (int y = 0; y < 4; ++y)
-        {
-            __m128i y0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(result + y * 16 + 0));
-            __m128i y1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(result + y * 16 + 64));
-            __m128i cb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(result + y * 16 + 128));
-            __m128i cr = _mm_loadu_si128(reinterpret_cast<const __m128i *>(result + y * 16 + 192));
+    return temp;
+}
 
-            __m128i zero = _mm_setzero_si128();
-            __m128i cb0;
-            __m128i cb1;
-            __m128i cr0;
-            __m128i cr1;
+static inline
+void planar_chroma(u8* dest, int stride, int step, const u8* result, const Frame& frame, int xblocks, int width, int height)
+{
+    const u8* data = result + frame.offset * 64;
+    const int xshift = frame.Hsf;
+    const int yshift = frame.Vsf;
+    const int comp_xblocks = xblocks >> xshift;
 
-            cb0 = _mm_unpacklo_epi8(cb, cb);
-            cr0 = _mm_unpacklo_epi8(cr, cr);
+    const int cw = (width + 1) >> 1;
+    const int ch = (height + 1) >> 1;
 
-            cb1 = _mm_unpackhi_epi8(cb0, zero);
-            cr1 = _mm_unpackhi_epi8(cr0, zero);
-            cb0 = _mm_unpacklo_epi8(cb0, zero);
-            cr0 = _mm_unpacklo_epi8(cr0, zero);
+    u8 temp0[8 * 4];
+    u8 temp1[8 * 4];
 
-            cb0 = _mm_add_epi16(cb0, tosigned);
-            cr0 = _mm_add_epi16(cr0, tosigned);
-            cb1 = _mm_add_epi16(cb1, tosigned);
-            cr1 = _mm_add_epi16(cr1, tosigned);
+    for (int y = 0; y < ch; ++y)
+    {
+        const u8* s0 = planar_row(temp0, data, comp_xblocks, (y * 2) >> yshift);
 
-            convert_ycbcr_8x1_sse2(dest +  0, _mm_unpacklo_epi8(y0, zero), cb0, cr0, s0, s1, s2, rounding);
-            convert_ycbcr_8x1_sse2(dest + 32, _mm_unpacklo_epi8(y1, zero), cb1, cr1, s0, s1, s2, rounding);
-            dest += stride;
+        if (xshift == 1 && yshift == 1)
+        {
+            // already 4:2:0
+            if (step == 1)
+            {
+                planar_copy(dest, s0, cw);
+            }
+            else
+            {
+                for (int x = 0; x < cw; ++x)
+                {
+                    dest[x * step] = s0[x];
+                }
+            }
+        }
+        else
+        {
+            const u8* s1 = planar_row(temp1, data, comp_xblocks, std::min(y * 2 + 1, height - 1) >> yshift);
 
-            cb0 = _mm_unpackhi_epi8(cb, cb);
-            cr0 = _mm_unpackhi_epi8(cr, cr);
+            if (xshift == 0)
+            {
+                const int xpairs = width >> 1;
 
-            cb1 = _mm_unpackhi_epi8(cb0, zero);
-            cr1 = _mm_unpackhi_epi8(cr0, zero);
-            cb0 = _mm_unpacklo_epi8(cb0, zero);
-            cr0 = _mm_unpacklo_epi8(cr0, zero);
+                for (int x = 0; x < xpairs; ++x)
+                {
+                    dest[x * step] = u8((s0[x * 2] + s0[x * 2 + 1] + s1[x * 2] + s1[x * 2 + 1] + 2) >> 2);
+                }
+
+                if (width & 1)
+                {
+                    dest[xpairs * step] = u8((s0[width - 1] + s1[width - 1] + 1) >> 1);
+                }
+            }
+            else if (xshift == 1)
+            {
+                for (int x = 0; x < cw; ++x)
+                {
+                    dest[x * step] = u8((s0[x] + s1[x] + 1) >> 1);
+                }
+            }
+            else
+            {
+                for (int x = 0; x < cw; ++x)
+                {
+                    const int x0 = (x * 2) >> xshift;
+                    const int x1 = std::min(x * 2 + 1, width - 1) >> xshift;
+                    dest[x * step] = u8((s0[x0] + s0[x1] + s1[x0] + s1[x1] + 2) >> 2);
+                }
+            }
+        }
+
+        dest += stride;
+    }
+}
+
+void process_YUV420(u8* dest, int stride, const BlockType* data, ProcessState* state, int width, int height)
+{
+    u8 result[64 * JPEG_MAX_BLOCKS_IN_MCU];
+
+    for (int i = 0; i < state->blocks; ++i)
+    {
+        Block& block = state->block[i];
+        state->idct(result + i * 64, data, block.qt);
+        data += 64;
+    }
+
+    // locate the MCU in the planes
+    const int offset = int(dest - state->planar.y);
+    const int x0 = (offset % stride) >> 1;
+    const int y0 = (offset / stride) >> 1;
+
+    const int xblocks = state->xblocks >> state->frame[0].Hsf;
+    const int step = state->planar.step;
+
+    // luma
+    for (int y = 0; y < height; ++y)
+    {
+        const u8* src = result + (y >> 3) * xblocks * 64 + (y & 7) * 8;
+
+        for (int x = 0; x < width; x += 8)
+        {
+            planar_copy(dest + x, src + x * 8, std::min(8, width - x));
+        }
+
+        dest += stride;
+    }
+
+    u8* u = state->planar.u + y0 * state->planar.ustride + x0 * step;
+    u8* v = state->planar.v + y0 * state->planar.vstride + x0 * step;
+
+    if (state->frames < 3)
+    {
+        // grayscale
+        const int cw = (width + 1) >> 1;
+        const int ch = (height + 1) >> 1;
+
+        for (int y = 0; y < ch; ++y)
+        {
+            for (int x = 0; x < cw; ++x)
+            {
+                u[x * step] = 128;
+                v[x * step] = 128;
+            }
+
+            u += state->planar.ustride;
+            v += state->planar.vstride;
+        }
+    }
+    else if (xblocks == 2 && width == 16 && height == 16 &&
+             state->frame[1].Hsf == 1 && state->frame[1].Vsf == 1 &&
+             state->frame[2].Hsf == 1 && state->frame[2].Vsf == 1)
+    {
+        // complete 4:2:0 MCU: the chroma blocks are the planar samples
+        const u8* cb = result + state->frame[1].offset * 64;
+        const u8* cr = result + state->frame[2].offset * 64;
+
+        for (int y = 0; y < 8; ++y)
+        {
+            if (step == 1)
+            {
+                std::memcpy(u, cb, 8);
+                std::memcpy(v, cr, 8);
+            }
+            else
+            {
+                for (int x = 0; x < 8; ++x)
+                {
+                    u[x * 2] = cb[x];
+                    v[x * 2] = cr[x];
+                }
+            }
+
+            cb += 8;
+            cr += 8;
+            u += state->planar.ustride;
+            v += state->planar.vstride;
+        }
+    }
+    else
+    {
+        planar_chroma(u, state->planar.ustride, step, result, state->frame[1], state->xblocks, width, height);
+        planar_chroma(v, state->planar.vstride, step, result, state->frame[2], state->xblocks, width, height);
+    }
+}
+
+// ----------------------------------------------------------------------------
+// fancy upsampling
+// ----------------------------------------------------------------------------
+
+/*
+    Triangle filtered chroma upsampling (the libjpeg "fancy" upsampling). Each output
+    sample is 3/4 * nearer + 1/4 * further input sample. The chroma of a MCU row is
+    transformed into planes with a border of one sample (see fancy_chroma) so that the
+    filter reads the samples of the neighbouring MCUs across the MCU edges.
+*/
+
+// transform the chroma blocks of count MCUs into the rows [0, 8) of the planes; the planes
+// have one sample of border on both sides which is the nearest sample inside the image
+void fancy_chroma(u8* cb, u8* cr, int cstride, const BlockType* data, ProcessState* state, int count, int cwidth)
+{
+    const int mcu_data_size = state->blocks * 64;
+    const int cb_index = state->blocks - 2;
+    const int cr_index = state->blocks - 1;
+
+    for (int x = 0; x < count; ++x)
+    {
+        u8 result[64 * 2];
+
+        state->idct(result +  0, data + cb_index * 64, state->block[cb_index].qt);
+        state->idct(result + 64, data + cr_index * 64, state->block[cr_index].qt);
+
+        for (int y = 0; y < 8; ++y)
+        {
+            std::memcpy(cb + y * cstride + x * 8, result +  0 + y * 8, 8);
+            std::memcpy(cr + y * cstride + x * 8, result + 64 + y * 8, 8);
+        }
+
+        data += mcu_data_size;
+    }
+
+    for (int y = 0; y < 8; ++y)
+    {
+        u8* u = cb + y * cstride;
+        u8* v = cr + y * cstride;
+        u[-1] = u[0];
+        v[-1] = v[0];
+        u[cwidth] = u[cwidth - 1];
+        v[cwidth] = v[cwidth - 1];
+    }
+}
+
+#if defined(JPEG_ENABLE_SSE2)
+
+// the samples [-1, 14] are loaded; the planes are padded for the reads past the last MCU
+
+static inline
+void upsample_h2v1(u8* dest, const u8* s)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s - 1));
+    const __m128i lo = _mm_unpacklo_epi8(v, zero);
+    const __m128i hi = _mm_unpackhi_epi8(v, zero);
+
+    const __m128i a = lo;
+    const __m128i b = _mm_or_si128(_mm_srli_si128(lo, 2), _mm_slli_si128(hi, 14));
+    const __m128i c = _mm_or_si128(_mm_srli_si128(lo, 4), _mm_slli_si128(hi, 12));
+    const __m128i b3 = _mm_add_epi16(b, _mm_add_epi16(b, b));
+
+    const __m128i even = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(b3, a), _mm_set1_epi16(1)), 2);
+    const __m128i odd = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(b3, c), _mm_set1_epi16(2)), 2);
+
+    const __m128i result = _mm_packus_epi16(_mm_unpacklo_epi16(even, odd), _mm_unpackhi_epi16(even, odd));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dest), result);
+}
+
+static inline
+void upsample_h2v2(u8* dest, const u8* nearer, const u8* further)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i n = _mm_loadu_si128(reinterpret_cast<const __m128i*>(nearer - 1));
+    const __m128i f = _mm_loadu_si128(reinterpret_cast<const __m128i*>(further - 1));
+    const __m128i n_lo = _mm_unpacklo_epi8(n, zero);
+    const __m128i n_hi = _mm_unpackhi_epi8(n, zero);
+    const __m128i lo = _mm_add_epi16(_mm_add_epi16(n_lo, _mm_add_epi16(n_lo, n_lo)), _mm_unpacklo_epi8(f, zero));
+    const __m128i hi = _mm_add_epi16(_mm_add_epi16(n_hi, _mm_add_epi16(n_hi, n_hi)), _mm_unpackhi_epi8(f, zero));
+
+    const __m128i a = lo;
+    const __m128i b = _mm_or_si128(_mm_srli_si128(lo, 2), _mm_slli_si128(hi, 14));
+    const __m128i c = _mm_or_si128(_mm_srli_si128(lo, 4), _mm_slli_si128(hi, 12));
+    const __m128i b3 = _mm_add_epi16(b, _mm_add_epi16(b, b));
+
+    const __m128i even = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(b3, a), _mm_set1_epi16(8)), 4);
+    const __m128i odd = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(b3, c), _mm_set1_epi16(7)), 4);
+
+    const __m128i result = _mm_packus_epi16(_mm_unpacklo_epi16(even, odd), _mm_unpackhi_epi16(even, odd));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dest), result);
+}
+
+#else
+
+static inline
+void upsample_h2v1(u8* dest, const u8* s)
+{
+    for (int x = 0; x < 8; ++x)
+    {
+        const int a = s[x - 1];
+        const int b = s[x] * 3;
+        const int c = s[x + 1];
+        dest[x * 2 + 0] = u8((b + a + 1) >> 2);
+        dest[x * 2 + 1] = u8((b + c + 2) >> 2);
+    }
+}
+
+static inline
+void upsample_h2v2(u8* dest, const u8* nearer, const u8* further)
+{
+    int sum[10];
+
+    for (int x = 0; x < 10; ++x)
+    {
+        sum[x] = nearer[x - 1] * 3 + further[x - 1];
+    }
+
+    for (int x = 0; x < 8; ++x)
+    {
+        const int a = sum[x + 0];
+        const int b = sum[x + 1] * 3;
+        const int c = sum[x + 2];
+        dest[x * 2 + 0] = u8((b + a + 8) >> 4);
+        dest[x * 2 + 1] = u8((b + c + 7) >> 4);
+    }
+}
+
+#endif // JPEG_ENABLE_SSE2
+
+// the clipped MCUs are converted into a temporary buffer
+static inline
+void fancy_clip(u8* dest, int stride, const u8* temp, ProcessState* state, int width, int height)
+{
+    const int bytes = width * state->bytes_per_pixel;
+
+    for (int y = 0; y < height; ++y)
+    {
+        std::memcpy(dest, temp + y * 16 * state->bytes_per_pixel, bytes);
+        dest += stride;
+    }
+}
+
+void process_YCbCr_16x8_fancy(u8* dest, int stride, const BlockType* data, ProcessState* state, const u8* cb, const u8* cr, int cstride, int width, int height)
+{
+    u8 result[64 * 2];
+    u8 temp[16 * 8 * 16];
+
+    state->idct(result +  0, data +  0, state->block[0].qt); // Y0
+    state->idct(result + 64, data + 64, state->block[1].qt); // Y1
+
+    const bool clipped = width < 16 || height < 8;
+    u8* target = clipped ? temp : dest;
+    const int target_stride = clipped ? 16 * state->bytes_per_pixel : stride;
+
+    for (int y = 0; y < 8; ++y)
+    {
+        u8 u[16];
+        u8 v[16];
+
+        upsample_h2v1(u, cb + y * cstride);
+        upsample_h2v1(v, cr + y * cstride);
+
+        state->convert_YCbCr(target, result +  0 + y * 8, u + 0, v + 0);
+        state->convert_YCbCr(target + 8 * state->bytes_per_pixel, result + 64 + y * 8, u + 8, v + 8);
+        target += target_stride;
+    }
+
+    if (clipped)
+    {
+        fancy_clip(dest, stride, temp, state, width, height);
+    }
+}
+
+void process_YCbCr_16x16_fancy(u8* dest, int stride, const BlockType* data, ProcessState* state, const u8* cb, const u8* cr, int cstride, int width, int height)
+{
+    u8 result[64 * 4];
+    u8 temp[16 * 16 * 16];
+
+    state->idct(result +   0, data +   0, state->block[0].qt); // Y0
+    state->idct(result +  64, data +  64, state->block[1].qt); // Y1
+    state->idct(result + 128, data + 128, state->block[2].qt); // Y2
+    state->idct(result + 192, data + 192, state->block[3].qt); // Y3
+
+    const bool clipped = width < 16 || height < 16;
+    u8* target = clipped ? temp : dest;
+    const int target_stride = clipped ? 16 * state->bytes_per_pixel : stride;
+
+    for (int y = 0; y < 16; ++y)
+    {
+        // the further row is above for the even rows and below for the odd rows
+        const int nearer = (y >> 1) * cstride;
+        const int further = nearer + (y & 1 ? cstride : -cstride);
+
+        u8 u[16];
+        u8 v[16];
+
+        upsample_h2v2(u, cb + nearer, cb + further);
+        upsample_h2v2(v, cr + nearer, cr + further);
+
+        const u8* s = result + (y >> 3) * 128 + (y & 7) * 8;
+
+        state->convert_YCbCr(target, s +  0, u + 0, v + 0);
+        state->convert_YCbCr(target + 8 * state->bytes_per_pixel, s + 64, u + 8, v + 8);
+        target += target_stride;
+    }
+
+    if (clipped)
+    {
+        fancy_clip(dest, stride, temp, state, width, height);
+    }
+}
+
+// ----------------------------------------------------------------------------
+// 12 bit precision
+// ----------------------------------------------------------------------------
+
+// The 12 bit samples are written as 16 bit per channel pixels: L16 for grayscale
+// and R16G16B16A16 for color. The samples are scaled to the full 16 bit range.
+
+#define COMPUTE_CBCR_12(cb, cr) \
+    int r = ((cr - 2048) * 91881 + 32768) >> 16; \
+    int g = ((cb - 2048) * -22554 + (cr - 2048) * -46802 + 32768) >> 16; \
+    int b = ((cb - 2048) * 116130 + 32768) >> 16;
+
+static inline u16 expand12(int v)
+{
+    v = clamp(v, 0, 4095);
+    return u16((v << 4) | (v >> 8));
+}
+
+void convert_YCbCr_12(u8* dest, const u16* y, const u16* cb, const u16* cr)
+{
+    u16* d = reinterpret_cast<u16*>(dest);
+
+    for (int x = 0; x < 8; ++x)
+    {
+        COMPUTE_CBCR_12(cb[x], cr[x]);
+        d[0] = expand12(y[x] + r);
+        d[1] = expand12(y[x] + g);
+        d[2] = expand12(y[x] + b);
+        d[3] = 0xffff;
+        d += 4;
+    }
+}
+
+void process_Y_12(u8* dest, int stride, const BlockType* data, ProcessState* state, int width, int height)
+{
+    u16 result[64];
+    state->idct12(result, data, state->block[0].qt); // Y
+
+    for (int y = 0; y < height; ++y)
+    {
+        u16* d = reinterpret_cast<u16*>(dest);
+        const u16* s = result + y * 8;
+
+        for (int x = 0; x < width; ++x)
+        {
+            d[x] = expand12(s[x]);
+        }
+
+        dest += stride;
+    }
+}
+
+void process_YCbCr_12(u8* dest, int stride, const BlockType* data, ProcessState* state, int width, int height)
+{
+    u16 result[64 * JPEG_MAX_BLOCKS_IN_MCU];
+
+    for (int i = 0; i < state->blocks; ++i)
+    {
+        Block& block = state->block[i];
+        state->idct12(result + i * 64, data, block.qt);
+        data += 64;
+    }
+
+    // MCU size in blocks
+    int xsize = (width + 7) / 8;
+    int ysize = (height + 7) / 8;
+
+    int cb_offset = state->frame[1].offset * 64;
+    int cb_xshift = state->frame[1].Hsf;
+    int cb_yshift = state->frame[1].Vsf;
+
+    int cr_offset = state->frame[2].offset * 64;
+    int cr_xshift = state->frame[2].Hsf;
+    int cr_yshift = state->frame[2].Vsf;
+
+    u16* cb_data = result + cb_offset;
+    u16* cr_data = result + cr_offset;
+
+    const int xblocks = state->xblocks >> state->frame[0].Hsf;
+    const int xstride = 8 * 8;
+
+    // process MCU
+    for (int yb = 0; yb < ysize; ++yb)
+    {
+        // vertical clipping limit for current block
+        const int ymax = std::min(8, height - yb * 8);
+
+        for (int xb = 0; xb < xsize; ++xb)
+        {
+            u8* dest_block = dest + yb * 8 * stride + xb * xstride;
+            u16* y_block = result + (yb * xblocks + xb) * 64;
+            u16* cb_block = cb_data + yb * (8 >> cb_yshift) * 8 + xb * (8 >> cb_xshift);
+            u16* cr_block = cr_data + yb * (8 >> cr_yshift) * 8 + xb * (8 >> cr_xshift);
+
+            // horizontal clipping limit for current block
+            const int xmax = std::min(8, width - xb * 8);
+
+            // process 8x8 block
+            for (int y = 0; y < ymax; ++y)
+            {
+                u16* cb_scan = cb_block + (y >> cb_yshift) * 8;
+                u16* cr_scan = cr_block + (y >> cr_yshift) * 8;
+
+                u16 cb[8];
+                u16 cr[8];
+
+                for (int x = 0; x < 8; ++x)
+                {
+                    cb[x] = cb_scan[x >> cb_xshift];
+                    cr[x] = cr_scan[x >> cr_xshift];
+                }
+
+                if (xmax == 8)
+                {
+                    state->convert_YCbCr_12(dest_block, y_block, cb, cr);
+                }
+                else
+                {
+                    u8 temp[8 * 8];
+                    state->convert_YCbCr_12(temp, y_block, cb, cr);
+                    std::memcpy(dest_block, temp, xmax * 8);
+                }
+
+                dest_block += stride;
+                y_block += 8;
+            }
+        }
+    }
+}
+
+void process_CMYK_12(u8* dest, int stride, const BlockType* data, ProcessState* state, int width, int height)
+{
+    u16 result[64 * JPEG_MAX_BLOCKS_IN_MCU];
+
+    for (int i = 0; i < state->blocks; ++i)
+    {
+        Block& block = state->block[i];
+        state->idct12(result + i * 64, data, block.qt);
+        data += 64;
+    }
+
+    const u16* y_data = result + state->frame[0].offset * 64;
+    const u16* cb_data = result + state->frame[1].offset * 64;
+    const u16* cr_data = result + state->frame[2].offset * 64;
+    const u16* ck_data = result + state->frame[3].offset * 64;
+
+    const int xblocks = state->xblocks;
+
+    // sample of a component at the pixel; the components can be subsampled
+    auto sample = [xblocks] (const u16* data, const Frame& frame, int x, int y)
+    {
+        const int sx = x >> frame.Hsf;
+        const int sy = y >> frame.Vsf;
+        const int blocks = xblocks >> frame.Hsf;
+        return int(data[((sy >> 3) * blocks + (sx >> 3)) * 64 + (sy & 7) * 8 + (sx & 7)]);
+    };
+
+    for (int y = 0; y < height; ++y)
+    {
+        u16* d = reinterpret_cast<u16*>(dest);
+
+        for (int x = 0; x < width; ++x)
+        {
+            const int cy = sample(y_data, state->frame[0], x, y);
+            const int cb = sample(cb_data, state->frame[1], x, y);
+            const int cr = sample(cr_data, state->frame[2], x, y);
+            const int ck = sample(ck_data, state->frame[3], x, y);
+
+            COMPUTE_CBCR_12(cb, cr);
+            r = ((4095 - r - cy) * ck) / 4095;
+            g = ((4095 - g - cy) * ck) / 4095;
+            b = ((4095 - b - cy) * ck) / 4095;
+
+            d[0] = expand12(r);
+            d[1] = expand12(g);
+            d[2] = expand12(b);
+            d[3] = 0xffff;
+            d += 4;
+        }
+
+        dest += stride;
+    }
+}
+
+#undef COMPUTE_CBCR_12
+
+#undef COMPUTE_CBCR
+#undef COMPUTE_CMYK
+#undef PACK_BGRA
+#undef PACK_COLOR
+
+#if defined(JPEG_ENABLE_SSE2) || defined(JPEG_ENABLE_NEON)
+
+    constexpr int JPEG_PREC = 12;
+    constexpr int JPEG_SCALE(int x) { return x << JPEG_PREC; }
+    constexpr int JPEG_FIXED(double x) { return int((x * double(1 << JPEG_PREC) + 0.5)); }
+
+#endif
+
+#if defined(JPEG_ENABLE_SSE2)
+    
+    // ------------------------------------------------------------------------------------------------
+    // SSE2 implementation
+    // ------------------------------------------------------------------------------------------------
+
+    // The original code is by Petr Kobalicek ; WE HAVE TAKEN LIBERTIES TO ADAPT IT TO OUR USE!!!
+    // https://github.com/kobalicek/simdtests
+    // [License]
+    // Public Domain <unlicense.org>
+
+#define JPEG_CONST_SSE2(x, y)  _mm_setr_epi16(x, y, x, y, x, y, x, y)
+
+    // signed 16 bit r, g and b without clamping
+    static inline
+    void compute_ycbcr_8x1_sse2(__m128i& r, __m128i& g, __m128i& b, __m128i y, __m128i cb, __m128i cr, __m128i s0, __m128i s1, __m128i s2, __m128i rounding)
+    {
+        __m128i zero = _mm_setzero_si128();
+
+        __m128i r_l = _mm_madd_epi16(_mm_unpacklo_epi16(y, cr), s0);
+        __m128i r_h = _mm_madd_epi16(_mm_unpackhi_epi16(y, cr), s0);
+
+        __m128i b_l = _mm_madd_epi16(_mm_unpacklo_epi16(y, cb), s1);
+        __m128i b_h = _mm_madd_epi16(_mm_unpackhi_epi16(y, cb), s1);
+
+        __m128i g_l = _mm_madd_epi16(_mm_unpacklo_epi16(cb, cr), s2);
+        __m128i g_h = _mm_madd_epi16(_mm_unpackhi_epi16(cb, cr), s2);
+
+        g_l = _mm_add_epi32(g_l, _mm_slli_epi32(_mm_unpacklo_epi16(y, zero), JPEG_PREC));
+        g_h = _mm_add_epi32(g_h, _mm_slli_epi32(_mm_unpackhi_epi16(y, zero), JPEG_PREC));
+
+        r_l = _mm_add_epi32(r_l, rounding);
+        r_h = _mm_add_epi32(r_h, rounding);
+
+        b_l = _mm_add_epi32(b_l, rounding);
+        b_h = _mm_add_epi32(b_h, rounding);
+
+        g_l = _mm_add_epi32(g_l, rounding);
+        g_h = _mm_add_epi32(g_h, rounding);
+
+        r_l = _mm_srai_epi32(r_l, JPEG_PREC);
+        r_h = _mm_srai_epi32(r_h, JPEG_PREC);
+
+        b_l = _mm_srai_epi32(b_l, JPEG_PREC);
+        b_h = _mm_srai_epi32(b_h, JPEG_PREC);
+
+        g_l = _mm_srai_epi32(g_l, JPEG_PREC);
+        g_h = _mm_srai_epi32(g_h, JPEG_PREC);
+
+        r = _mm_packs_epi32(r_l, r_h);
+        g = _mm_packs_epi32(g_l, g_h);
+        b = _mm_packs_epi32(b_l, b_h);
+    }
+
+    static inline
+    void store_bgra_8x1_sse2(u8* dest, __m128i r, __m128i g, __m128i b)
+    {
+        r = _mm_packus_epi16(r, r);
+        g = _mm_packus_epi16(g, g);
+        b = _mm_packus_epi16(b, b);
+
+        __m128i ra = _mm_unpacklo_epi8(r, _mm_cmpeq_epi8(r, r));
+        __m128i bg = _mm_unpacklo_epi8(b, g);
+
+        __m128i bgra0 = _mm_unpacklo_epi16(bg, ra);
+        __m128i bgra1 = _mm_unpackhi_epi16(bg, ra);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dest +  0), bgra0);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dest + 16), bgra1);
+    }
+
+    static inline
+    void convert_ycbcr_8x1_sse2(u8* dest, __m128i y, __m128i cb, __m128i cr, __m128i s0, __m128i s1, __m128i s2, __m128i rounding, bool rgba = false)
+    {
+        __m128i r;
+        __m128i g;
+        __m128i b;
+        compute_ycbcr_8x1_sse2(r, g, b, y, cb, cr, s0, s1, s2, rounding);
+
+        if (rgba)
+        {
+            std::swap(r, b);
+        }
+
+        store_bgra_8x1_sse2(dest, r, g, b);
+    }
+
+    void process_YCbCr_8x8_sse2(u8* dest, int stride, const BlockType* data, ProcessState* state, int width, int height)
+    {
+        u8 result[64 * 3];
+
+        state->idct(result +   0, data +   0, state->block[0].qt); // Y
+        state->idct(result +  64, data +  64, state->block[1].qt); // Cb
+        state->idct(result + 128, data + 128, state->block[2].qt); // Cr
+
+        // color conversion
+        const __m128i s0 = JPEG_CONST_SSE2(JPEG_FIXED( 1.00000), JPEG_FIXED( 1.40200));
+        const __m128i s1 = JPEG_CONST_SSE2(JPEG_FIXED( 1.00000), JPEG_FIXED( 1.77200));
+        const __m128i s2 = JPEG_CONST_SSE2(JPEG_FIXED(-0.34414), JPEG_FIXED(-0.71414));
+        const __m128i rounding = _mm_set1_epi32(1 << (JPEG_PREC - 1));
+        const bool rgba = state->rgba;
+        const __m128i tosigned = _mm_set1_epi16(-128);
+
+        for (int y = 0; y < 4; ++y)
+        {
+            __m128i yy = _mm_loadu_si128(reinterpret_cast<const __m128i *>(result + y * 16 + 0));
+            __m128i cb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(result + y * 16 + 64));
+            __m128i cr = _mm_loadu_si128(reinterpret_cast<const __m128i *>(result + y * 16 + 128));
+
+            __m128i zero = _mm_setzero_si128();
+
+            __m128i cb0 = _mm_unpacklo_epi8(cb, zero);
+            __m128i cr0 = _mm_unpacklo_epi8(cr, zero);
+            __m128i cb1 = _mm_unpackhi_epi8(cb, zero);
+            __m128i cr1 = _mm_unpackhi_epi8(cr, zero);
+
+            cb0 = _mm_add_epi16(cb0, tosigned);
+            cr0 = _mm_add_epi16(cr0, tosigned);
+            cb1 = _mm_add_epi16(cb1, tosigned);
+            cr1 = _mm_add_epi16(cr1, tosigned);
+
+            convert_ycbcr_8x1_sse2(dest, _mm_unpacklo_epi8(yy, zero), cb0, cr0, s0, s1, s2, rounding, rgba);
+            dest += stride;
+
+            convert_ycbcr_8x1_sse2(dest, _mm_unpackhi_epi8(yy, zero), cb1, cr1, s0, s1, s2, rounding, rgba);
+            dest += stride;
+        }
+
+        MANGO_UNREFERENCED_PARAMETER(width);
+        MANGO_UNREFERENCED_PARAMETER(height);
+    }
+    
+    void process_YCbCr_8x16_sse2(u8* dest, int stride, const BlockType* data, ProcessState* state, int width, int height)
+    {
+        u8 result[64 * 4];
+
+        state->idct(result +   0, data +   0, state->block[0].qt); // Y0
+        state->idct(result +  64, data +  64, state->block[1].qt); // Y1
+        state->idct(result + 128, data + 128, state->block[2].qt); // Cb
+        state->idct(result + 192, data + 192, state->block[3].qt); // Cr
+
+        // color conversion
+        const __m128i s0 = JPEG_CONST_SSE2(JPEG_FIXED( 1.00000), JPEG_FIXED( 1.40200));
+        const __m128i s1 = JPEG_CONST_SSE2(JPEG_FIXED( 1.00000), JPEG_FIXED( 1.77200));
+        const __m128i s2 = JPEG_CONST_SSE2(JPEG_FIXED(-0.34414), JPEG_FIXED(-0.71414));
+        const __m128i rounding = _mm_set1_epi32(1 << (JPEG_PREC - 1));
+        const bool rgba = state->rgba;
+        const __m128i tosigned = _mm_set1_epi16(-128);
+
+        for (int y = 0; y < 4; ++y)
+        {
+            __m128i y0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(result + y * 32 + 0));
+            __m128i y1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(result + y * 32 + 16));
+            __m128i cb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(result + y * 16 + 128));
+            __m128i cr = _mm_loadu_si128(reinterpret_cast<const __m128i *>(result + y * 16 + 192));
+
+            __m128i zero = _mm_setzero_si128();
+
+            __m128i cb0 = _mm_unpacklo_epi8(cb, zero);
+            __m128i cr0 = _mm_unpacklo_epi8(cr, zero);
+            __m128i cb1 = _mm_unpackhi_epi8(cb, zero);
+            __m128i cr1 = _mm_unpackhi_epi8(cr, zero);
+
+            cb0 = _mm_add_epi16(cb0, tosigned);
+            cr0 = _mm_add_epi16(cr0, tosigned);
+            cb1 = _mm_add_epi16(cb1, tosigned);
+            cr1 = _mm_add_epi16(cr1, tosigned);
+
+            convert_ycbcr_8x1_sse2(dest, _mm_unpacklo_epi8(y0, zero), cb0, cr0, s0, s1, s2, rounding, rgba);
+            dest += stride;
+
+            convert_ycbcr_8x1_sse2(dest, _mm_unpackhi_epi8(y0, zero), cb0, cr0, s0, s1, s2, rounding, rgba);
+            dest += stride;
+
+            convert_ycbcr_8x1_sse2(dest, _mm_unpacklo_epi8(y1, zero), cb1, cr1, s0, s1, s2, rounding, rgba);
+            dest += stride;
+            
+            convert_ycbcr_8x1_sse2(dest, _mm_unpackhi_epi8(y1, zero), cb1, cr1, s0, s1, s2, rounding, rgba);
+            dest += stride;
+        }
+
+        MANGO_UNREFERENCED_PARAMETER(width);
+        MANGO_UNREFERENCED_PARAMETER(height);
+    }
+    
+    void process_YCbCr_16x8_sse2(u8* dest, int stride, const BlockType* data, ProcessState* state, int width, int height)
+    {
+        u8 result[64 * 4];
+
+        state->idct(result +   0, data +   0, state->block[0].qt); // Y0
+        state->idct(result +  64, data +  64, state->block[1].qt); // Y1
+        state->idct(result + 128, data + 128, state->block[2].qt); // Cb
+        state->idct(result + 192, data + 192, state->block[3].qt); // Cr
+
+        // color conversion
+        const __m128i s0 = JPEG_CONST_SSE2(JPEG_FIXED( 1.00000), JPEG_FIXED( 1.40200));
+        const __m128i s1 = JPEG_CONST_SSE2(JPEG_FIXED( 1.00000), JPEG_FIXED( 1.77200));
+        const __m128i s2 = JPEG_CONST_SSE2(JPEG_FIXED(-0.34414), JPEG_FIXED(-0.71414));
+        const __m128i rounding = _mm_set1_epi32(1 << (JPEG_PREC - 1));
+        const bool rgba = state->rgba;
+        const __m128i tosigned = _mm_set1_epi16(-128);
+
+        for (int y = 0; y < 4; ++y)
+        {
+            __m128i y0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(result + y * 16 + 0));
+            __m128i y1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(result + y * 16 + 64));
+            __m128i cb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(result + y * 16 + 128));
+            __m128i cr = _mm_loadu_si128(reinterpret_cast<const __m128i *>(result + y * 16 + 192));
+
+            __m128i zero = _mm_setzero_si128();
+            __m128i cb0;
+            __m128i cb1;
+            __m128i cr0;
+            __m128i cr1;
+
+            cb0 = _mm_unpacklo_epi8(cb, cb);
+            cr0 = _mm_unpacklo_epi8(cr, cr);
+
+            cb1 = _mm_unpackhi_epi8(cb0, zero);
+            cr1 = _mm_unpackhi_epi8(cr0, zero);
+            cb0 = _mm_unpacklo_epi8(cb0, zero);
+            cr0 = _mm_unpacklo_epi8(cr0, zero);
+
+            cb0 = _mm_add_epi16(cb0, tosigned);
+            cr0 = _mm_add_epi16(cr0, tosigned);
+            cb1 = _mm_add_epi16(cb1, tosigned);
+            cr1 = _mm_add_epi16(cr1, tosigned);
+
+            convert_ycbcr_8x1_sse2(dest +  0, _mm_unpacklo_epi8(y0, zero), cb0, cr0, s0, s1, s2, rounding, rgba);
+            convert_ycbcr_8x1_sse2(dest + 32, _mm_unpacklo_epi8(y1, zero), cb1, cr1, s0, s1, s2, rounding, rgba);
+            dest += stride;
+
+            cb0 = _mm_unpackhi_epi8(cb, cb);
+            cr0 = _mm_unpackhi_epi8(cr, cr);
+
+            cb1 = _mm_unpackhi_epi8(cb0, zero);
+            cr1 = _mm_unpackhi_epi8(cr0, zero);
+            cb0 = _mm_unpacklo_epi8(cb0, zero);
+            cr0 = _mm_unpacklo_epi8(cr0, zero);
+
+            cb0 = _mm_add_epi16(cb0, tosigned);
+            cr0 = _mm_add_epi16(cr0, tosigned);
+            cb1 = _mm_add_epi16(cb1, tosigned);
+            cr1 = _mm_add_epi16(cr1, tosigned);
+
+            convert_ycbcr_8x1_sse2(dest +  0, _mm_unpackhi_epi8(y0, zero), cb0, cr0, s0, s1, s2, rounding, rgba);
+            convert_ycbcr_8x1_sse2(dest + 32, _mm_unpackhi_epi8(y1, zero), cb1, cr1, s0, s1, s2, rounding, rgba);
+            dest += stride;
+        }
+
+        MANGO_UNREFERENCED_PARAMETER(width);
+        MANGO_UNREFERENCED_PARAMETER(height);
+    }
+    
+    void process_YCbCr_16x16_sse2(u8* dest, int stride, const BlockType* data, ProcessState* state, int width, int height)
+    {
+        u8 result[64 * 6];
+
+        state->idct(result +   0, data +   0, state->block[0].qt); // Y0
+        state->idct(result + 128, data +  64, state->block[1].qt); // Y1
+        state->idct(result +  64, data + 128, state->block[2].qt); // Y2
+        state->idct(result + 192, data + 192, state->block[3].qt); // Y3
+        state->idct(result + 256, data + 256, state->block[4].qt); // Cb
+        state->idct(result + 320, data + 320, state->block[5].qt); // Cr
+
+        // color conversion
+        const __m128i s0 = JPEG_CONST_SSE2(JPEG_FIXED( 1.00000), JPEG_FIXED( 1.40200));
+        const __m128i s1 = JPEG_CONST_SSE2(JPEG_FIXED( 1.00000), JPEG_FIXED( 1.77200));
+        const __m128i s2 = JPEG_CONST_SSE2(JPEG_FIXED(-0.34414), JPEG_FIXED(-0.71414));
+        const __m128i rounding = _mm_set1_epi32(1 << (JPEG_PREC - 1));
+        const bool rgba = state->rgba;
+        const __m128i tosigned = _mm_set1_epi16(-128);
+
+        for (int y = 0; y < 4; ++y)
+        {
+            __m128i y0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(result + y * 32 + 0));
+            __m128i y1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(result + y * 32 + 128));
+            __m128i y2 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(result + y * 32 + 16));
+            __m128i y3 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(result + y * 32 + 144));
+            __m128i cb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(result + y * 16 + 256));
+            __m128i cr = _mm_loadu_si128(reinterpret_cast<const __m128i *>(result + y * 16 + 320));
+
+            __m128i zero = _mm_setzero_si128();
+            __m128i cb0;
+            __m128i cb1;
+            __m128i cr0;
+            __m128i cr1;
+
+            cb0 = _mm_unpacklo_epi8(cb, cb);
+            cr0 = _mm_unpacklo_epi8(cr, cr);
+
+            cb1 = _mm_unpackhi_epi8(cb0, zero);
+            cr1 = _mm_unpackhi_epi8(cr0, zero);
+            cb0 = _mm_unpacklo_epi8(cb0, zero);
+            cr0 = _mm_unpacklo_epi8(cr0, zero);
+
+            cb0 = _mm_add_epi16(cb0, tosigned);
+            cr0 = _mm_add_epi16(cr0, tosigned);
+            cb1 = _mm_add_epi16(cb1, tosigned);
+            cr1 = _mm_add_epi16(cr1, tosigned);
+
+            convert_ycbcr_8x1_sse2(dest +  0, _mm_unpacklo_epi8(y0, zero), cb0, cr0, s0, s1, s2, rounding, rgba);
+            convert_ycbcr_8x1_sse2(dest + 32, _mm_unpacklo_epi8(y1, zero), cb1, cr1, s0, s1, s2, rounding, rgba);
+            dest += stride;
+
+            convert_ycbcr_8x1_sse2(dest +  0, _mm_unpackhi_epi8(y0, zero), cb0, cr0, s0, s1, s2, rounding, rgba);
+            convert_ycbcr_8x1_sse2(dest + 32, _mm_unpackhi_epi8(y1, zero), cb1, cr1, s0, s1, s2, rounding, rgba);
+            dest += stride;
+
+            cb0 = _mm_unpackhi_epi8(cb, cb);
+            cr0 = _mm_unpackhi_epi8(cr, cr);
+
+            cb1 = _mm_unpackhi_epi8(cb0, zero);
+            cr1 = _mm_unpackhi_epi8(cr0, zero);
+            cb0 = _mm_unpacklo_epi8(cb0, zero);
+            cr0 = _mm_unpacklo_epi8(cr0, zero);
 
             cb0 = _mm_add_epi16(cb0, tosigned);
             cr0 = _mm_add_epi16(cr0, tosigned);
             cb1 = _mm_add_epi16(cb1, tosigned);
             cr1 = _mm_add_epi16(cr1, tosigned);
 
-            convert_ycbcr_8x1_sse2(dest +  0, _mm_unpackhi_epi8(y0, zero), cb0, cr0, s0, s1, s2, rounding);
-            convert_ycbcr_8x1_sse2(dest + 32, _mm_unpackhi_epi8(y1, zero), cb1, cr1, s0, s1, s2, rounding);
+            convert_ycbcr_8x1_sse2(dest +  0, _mm_unpacklo_epi8(y2, zero), cb0, cr0, s0, s1, s2, rounding, rgba);
+            convert_ycbcr_8x1_sse2(dest + 32, _mm_unpacklo_epi8(y3, zero), cb1, cr1, s0, s1, s2, rounding, rgba);
+            dest += stride;
+
+            convert_ycbcr_8x1_sse2(dest +  0, _mm_unpackhi_epi8(y2, zero), cb0, cr0, s0, s1, s2, rounding, rgba);
+            convert_ycbcr_8x1_sse2(dest + 32, _mm_unpackhi_epi8(y3, zero), cb1, cr1, s0, s1, s2, rounding, rgba);
+            dest += stride;
+        }
+
+        MANGO_UNREFERENCED_PARAMETER(width);
+        MANGO_UNREFERENCED_PARAMETER(height);
+    }
+
+    void convert_YCbCr_sse2(u8* dest, const u8* y, const u8* cb, const u8* cr)
+    {
+        const __m128i s0 = JPEG_CONST_SSE2(JPEG_FIXED( 1.00000), JPEG_FIXED( 1.40200));
+        const __m128i s1 = JPEG_CONST_SSE2(JPEG_FIXED( 1.00000), JPEG_FIXED( 1.77200));
+        const __m128i s2 = JPEG_CONST_SSE2(JPEG_FIXED(-0.34414), JPEG_FIXED(-0.71414));
+        const __m128i rounding = _mm_set1_epi32(1 << (JPEG_PREC - 1));
+        const __m128i tosigned = _mm_set1_epi16(-128);
+        const __m128i zero = _mm_setzero_si128();
+
+        __m128i yy = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(y)), zero);
+        __m128i cb0 = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(cb)), zero);
+        __m128i cr0 = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(cr)), zero);
+
+        convert_ycbcr_8x1_sse2(dest, yy, _mm_add_epi16(cb0, tosigned), _mm_add_epi16(cr0, tosigned), s0, s1, s2, rounding);
+    }
+
+    // (255 - x) * k / 255 for 8 signed 16 bit x, result is rounded
+    static inline
+    __m128i scale_cmyk_sse2(__m128i x, __m128i k)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i bias = _mm_set1_epi32(128);
+
+        x = _mm_sub_epi16(_mm_set1_epi16(255), x);
+
+        __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi16(x, zero), _mm_unpacklo_epi16(k, zero));
+        __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi16(x, zero), _mm_unpackhi_epi16(k, zero));
+
+        lo = _mm_add_epi32(lo, bias);
+        hi = _mm_add_epi32(hi, bias);
+        lo = _mm_srai_epi32(_mm_add_epi32(lo, _mm_srai_epi32(lo, 8)), 8);
+        hi = _mm_srai_epi32(_mm_add_epi32(hi, _mm_srai_epi32(hi, 8)), 8);
+
+        return _mm_packs_epi32(lo, hi);
+    }
+
+    void convert_CMYK_sse2(u8* dest, const u8* y, const u8* cb, const u8* cr, const u8* k)
+    {
+        const __m128i s0 = JPEG_CONST_SSE2(JPEG_FIXED( 1.00000), JPEG_FIXED( 1.40200));
+        const __m128i s1 = JPEG_CONST_SSE2(JPEG_FIXED( 1.00000), JPEG_FIXED( 1.77200));
+        const __m128i s2 = JPEG_CONST_SSE2(JPEG_FIXED(-0.34414), JPEG_FIXED(-0.71414));
+        const __m128i rounding = _mm_set1_epi32(1 << (JPEG_PREC - 1));
+        const __m128i tosigned = _mm_set1_epi16(-128);
+        const __m128i zero = _mm_setzero_si128();
+
+        __m128i yy = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(y)), zero);
+        __m128i cb0 = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(cb)), zero);
+        __m128i cr0 = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(cr)), zero);
+        __m128i kk = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(k)), zero);
+
+        __m128i r;
+        __m128i g;
+        __m128i b;
+        compute_ycbcr_8x1_sse2(r, g, b, yy, _mm_add_epi16(cb0, tosigned), _mm_add_epi16(cr0, tosigned), s0, s1, s2, rounding);
+
+        r = scale_cmyk_sse2(r, kk);
+        g = scale_cmyk_sse2(g, kk);
+        b = scale_cmyk_sse2(b, kk);
+
+        store_bgra_8x1_sse2(dest, r, g, b);
+    }
+
+    // load 8 samples of each channel and compute signed 16 bit r, g and b
+    static inline
+    void compute_ycbcr_8x1_sse2(__m128i& r, __m128i& g, __m128i& b, const u8* y, const u8* cb, const u8* cr)
+    {
+        const __m128i s0 = JPEG_CONST_SSE2(JPEG_FIXED( 1.00000), JPEG_FIXED( 1.40200));
+        const __m128i s1 = JPEG_CONST_SSE2(JPEG_FIXED( 1.00000), JPEG_FIXED( 1.77200));
+        const __m128i s2 = JPEG_CONST_SSE2(JPEG_FIXED(-0.34414), JPEG_FIXED(-0.71414));
+        const __m128i rounding = _mm_set1_epi32(1 << (JPEG_PREC - 1));
+        const __m128i tosigned = _mm_set1_epi16(-128);
+        const __m128i zero = _mm_setzero_si128();
+
+        __m128i yy = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(y)), zero);
+        __m128i cb0 = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(cb)), zero);
+        __m128i cr0 = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(cr)), zero);
+
+        compute_ycbcr_8x1_sse2(r, g, b, yy, _mm_add_epi16(cb0, tosigned), _mm_add_epi16(cr0, tosigned), s0, s1, s2, rounding);
+    }
+
+    // clamp signed 16 bit samples to [0, 255]
+    static inline
+    __m128i clamp_u8_sse2(__m128i x)
+    {
+        return _mm_unpacklo_epi8(_mm_packus_epi16(x, x), _mm_setzero_si128());
+    }
+
+    void convert_YCbCr_RGBA_sse2(u8* dest, const u8* y, const u8* cb, const u8* cr)
+    {
+        __m128i r;
+        __m128i g;
+        __m128i b;
+        compute_ycbcr_8x1_sse2(r, g, b, y, cb, cr);
+
+        // swapping red and blue stores RGBA
+        store_bgra_8x1_sse2(dest, b, g, r);
+    }
+
+    void convert_YCbCr_RGB565_sse2(u8* dest, const u8* y, const u8* cb, const u8* cr)
+    {
+        __m128i r;
+        __m128i g;
+        __m128i b;
+        compute_ycbcr_8x1_sse2(r, g, b, y, cb, cr);
+
+        r = _mm_and_si128(_mm_slli_epi16(clamp_u8_sse2(r), 8), _mm_set1_epi16(0xf800u));
+        g = _mm_and_si128(_mm_slli_epi16(clamp_u8_sse2(g), 3), _mm_set1_epi16(0x07e0));
+        b = _mm_srli_epi16(clamp_u8_sse2(b), 3);
+
+        __m128i color = _mm_or_si128(_mm_or_si128(r, g), b);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dest), color);
+    }
+
+    void convert_YCbCr_RGBA32F_sse2(u8* dest, const u8* y, const u8* cb, const u8* cr)
+    {
+        __m128i r;
+        __m128i g;
+        __m128i b;
+        compute_ycbcr_8x1_sse2(r, g, b, y, cb, cr);
+
+        r = clamp_u8_sse2(r);
+        g = clamp_u8_sse2(g);
+        b = clamp_u8_sse2(b);
+
+        const __m128i zero = _mm_setzero_si128();
+        const __m128 scale = _mm_set1_ps(1.0f / 255.0f);
+
+        float* d = reinterpret_cast<float*>(dest);
+
+        for (int i = 0; i < 2; ++i)
+        {
+            __m128 fr = _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(r, zero)), scale);
+            __m128 fg = _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(g, zero)), scale);
+            __m128 fb = _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(b, zero)), scale);
+            __m128 fa = _mm_set1_ps(1.0f);
+
+            _MM_TRANSPOSE4_PS(fr, fg, fb, fa);
+
+            _mm_storeu_ps(d +  0, fr);
+            _mm_storeu_ps(d +  4, fg);
+            _mm_storeu_ps(d +  8, fb);
+            _mm_storeu_ps(d + 12, fa);
+            d += 16;
+
+            r = _mm_unpackhi_epi64(r, r);
+            g = _mm_unpackhi_epi64(g, g);
+            b = _mm_unpackhi_epi64(b, b);
+        }
+    }
+
+    // scale clamped 12 bit samples to 16 bits
+    static inline
+    __m128i expand12_sse2(__m128i x)
+    {
+        x = _mm_min_epi16(_mm_max_epi16(x, _mm_setzero_si128()), _mm_set1_epi16(4095));
+        return _mm_or_si128(_mm_slli_epi16(x, 4), _mm_srli_epi16(x, 8));
+    }
+
+    void convert_YCbCr_12_sse2(u8* dest, const u16* y, const u16* cb, const u16* cr)
+    {
+        // the constants have two more fractional bits than the 8 bit conversion
+        const __m128i s0 = JPEG_CONST_SSE2(0, JPEG_FIXED(1.40200 * 4));
+        const __m128i s1 = JPEG_CONST_SSE2(JPEG_FIXED(1.77200 * 4), 0);
+        const __m128i s2 = JPEG_CONST_SSE2(JPEG_FIXED(-0.34414 * 4), JPEG_FIXED(-0.71414 * 4));
+        const __m128i rounding = _mm_set1_epi32(1 << (JPEG_PREC + 1));
+        const __m128i tosigned = _mm_set1_epi16(-2048);
+
+        __m128i yy = _mm_loadu_si128(reinterpret_cast<const __m128i *>(y));
+        __m128i cb0 = _mm_add_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(cb)), tosigned);
+        __m128i cr0 = _mm_add_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(cr)), tosigned);
+
+        __m128i cbcr_lo = _mm_unpacklo_epi16(cb0, cr0);
+        __m128i cbcr_hi = _mm_unpackhi_epi16(cb0, cr0);
+
+        __m128i r_lo = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(cbcr_lo, s0), rounding), JPEG_PREC + 2);
+        __m128i r_hi = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(cbcr_hi, s0), rounding), JPEG_PREC + 2);
+        __m128i b_lo = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(cbcr_lo, s1), rounding), JPEG_PREC + 2);
+        __m128i b_hi = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(cbcr_hi, s1), rounding), JPEG_PREC + 2);
+        __m128i g_lo = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(cbcr_lo, s2), rounding), JPEG_PREC + 2);
+        __m128i g_hi = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(cbcr_hi, s2), rounding), JPEG_PREC + 2);
+
+        __m128i r = expand12_sse2(_mm_add_epi16(yy, _mm_packs_epi32(r_lo, r_hi)));
+        __m128i g = expand12_sse2(_mm_add_epi16(yy, _mm_packs_epi32(g_lo, g_hi)));
+        __m128i b = expand12_sse2(_mm_add_epi16(yy, _mm_packs_epi32(b_lo, b_hi)));
+        __m128i a = _mm_set1_epi16(-1);
+
+        __m128i rg_lo = _mm_unpacklo_epi16(r, g);
+        __m128i rg_hi = _mm_unpackhi_epi16(r, g);
+        __m128i ba_lo = _mm_unpacklo_epi16(b, a);
+        __m128i ba_hi = _mm_unpackhi_epi16(b, a);
+
+        __m128i* d = reinterpret_cast<__m128i *>(dest);
+        _mm_storeu_si128(d + 0, _mm_unpacklo_epi32(rg_lo, ba_lo));
+        _mm_storeu_si128(d + 1, _mm_unpackhi_epi32(rg_lo, ba_lo));
+        _mm_storeu_si128(d + 2, _mm_unpacklo_epi32(rg_hi, ba_hi));
+        _mm_storeu_si128(d + 3, _mm_unpackhi_epi32(rg_hi, ba_hi));
+    }
+
+#if defined(MANGO_ENABLE_DISPATCH)
+
+    // ------------------------------------------------------------------------------------------------
+    // AVX2 implementation
+    // ------------------------------------------------------------------------------------------------
+
+    // Converts 16 pixels; the first 8 are stored into dest0 and the next 8 into dest1.
+    MANGO_TARGET("avx2")
+    static inline
+    void convert_ycbcr_16x1_avx2(u8* dest0, u8* dest1, __m128i y8, __m128i cb8, __m128i cr8, bool rgba)
+    {
+        const __m256i s0 = _mm256_set1_epi32(int((u32(JPEG_FIXED( 1.40200)) << 16) | u32(JPEG_FIXED(1.00000))));
+        const __m256i s1 = _mm256_set1_epi32(int((u32(JPEG_FIXED( 1.77200)) << 16) | u32(JPEG_FIXED(1.00000))));
+        const __m256i s2 = _mm256_set1_epi32(int((u32(JPEG_FIXED(-0.71414)) << 16) | (u32(JPEG_FIXED(-0.34414)) & 0xffff)));
+        const __m256i rounding = _mm256_set1_epi32(1 << (JPEG_PREC - 1));
+        const __m256i tosigned = _mm256_set1_epi16(-128);
+        const __m256i zero = _mm256_setzero_si256();
+
+        __m256i y = _mm256_cvtepu8_epi16(y8);
+        __m256i cb = _mm256_add_epi16(_mm256_cvtepu8_epi16(cb8), tosigned);
+        __m256i cr = _mm256_add_epi16(_mm256_cvtepu8_epi16(cr8), tosigned);
+
+        __m256i r_l = _mm256_madd_epi16(_mm256_unpacklo_epi16(y, cr), s0);
+        __m256i r_h = _mm256_madd_epi16(_mm256_unpackhi_epi16(y, cr), s0);
+
+        __m256i b_l = _mm256_madd_epi16(_mm256_unpacklo_epi16(y, cb), s1);
+        __m256i b_h = _mm256_madd_epi16(_mm256_unpackhi_epi16(y, cb), s1);
+
+        __m256i g_l = _mm256_madd_epi16(_mm256_unpacklo_epi16(cb, cr), s2);
+        __m256i g_h = _mm256_madd_epi16(_mm256_unpackhi_epi16(cb, cr), s2);
+
+        g_l = _mm256_add_epi32(g_l, _mm256_slli_epi32(_mm256_unpacklo_epi16(y, zero), JPEG_PREC));
+        g_h = _mm256_add_epi32(g_h, _mm256_slli_epi32(_mm256_unpackhi_epi16(y, zero), JPEG_PREC));
+
+        r_l = _mm256_srai_epi32(_mm256_add_epi32(r_l, rounding), JPEG_PREC);
+        r_h = _mm256_srai_epi32(_mm256_add_epi32(r_h, rounding), JPEG_PREC);
+        b_l = _mm256_srai_epi32(_mm256_add_epi32(b_l, rounding), JPEG_PREC);
+        b_h = _mm256_srai_epi32(_mm256_add_epi32(b_h, rounding), JPEG_PREC);
+        g_l = _mm256_srai_epi32(_mm256_add_epi32(g_l, rounding), JPEG_PREC);
+        g_h = _mm256_srai_epi32(_mm256_add_epi32(g_h, rounding), JPEG_PREC);
+
+        // the packs and unpacks work within 128 bit lanes: low lane has pixels 0..7
+        __m256i r = _mm256_packs_epi32(r_l, r_h);
+        __m256i g = _mm256_packs_epi32(g_l, g_h);
+        __m256i b = _mm256_packs_epi32(b_l, b_h);
+
+        if (rgba)
+        {
+            std::swap(r, b);
+        }
+
+        r = _mm256_packus_epi16(r, r);
+        g = _mm256_packus_epi16(g, g);
+        b = _mm256_packus_epi16(b, b);
+
+        __m256i ra = _mm256_unpacklo_epi8(r, _mm256_cmpeq_epi8(r, r));
+        __m256i bg = _mm256_unpacklo_epi8(b, g);
+
+        __m256i bgra0 = _mm256_unpacklo_epi16(bg, ra);
+        __m256i bgra1 = _mm256_unpackhi_epi16(bg, ra);
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dest0), _mm256_permute2x128_si256(bgra0, bgra1, 0x20));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dest1), _mm256_permute2x128_si256(bgra0, bgra1, 0x31));
+    }
+
+    static inline __m128i load64(const u8* p)
+    {
+        return _mm_loadl_epi64(reinterpret_cast<const __m128i *>(p));
+    }
+
+    static inline __m128i load128(const u8* p)
+    {
+        return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    }
+
+    MANGO_TARGET("avx2")
+    void process_YCbCr_8x8_avx2(u8* dest, int stride, const BlockType* data, ProcessState* state, int width, int height)
+    {
+        u8 result[64 * 3];
+
+        idct2_avx2(result, data, state->block[0].qt, state->block[1].qt); // Y, Cb
+        state->idct(result + 128, data + 128, state->block[2].qt); // Cr
+
+        // color conversion
+        for (int y = 0; y < 8; y += 2)
+        {
+            __m128i yy = load128(result + y * 8);
+            __m128i cb = load128(result + y * 8 + 64);
+            __m128i cr = load128(result + y * 8 + 128);
+            convert_ycbcr_16x1_avx2(dest, dest + stride, yy, cb, cr, state->rgba);
+            dest += stride * 2;
+        }
+
+        MANGO_UNREFERENCED_PARAMETER(width);
+        MANGO_UNREFERENCED_PARAMETER(height);
+    }
+
+    MANGO_TARGET("avx2")
+    void process_YCbCr_8x16_avx2(u8* dest, int stride, const BlockType* data, ProcessState* state, int width, int height)
+    {
+        u8 result[64 * 4];
+
+        idct2_avx2(result +   0, data +   0, state->block[0].qt, state->block[1].qt); // Y0, Y1
+        idct2_avx2(result + 128, data + 128, state->block[2].qt, state->block[3].qt); // Cb, Cr
+
+        // color conversion
+        for (int y = 0; y < 16; y += 2)
+        {
+            __m128i yy = load128(result + y * 8);
+            __m128i cb = load64(result + (y >> 1) * 8 + 128);
+            __m128i cr = load64(result + (y >> 1) * 8 + 192);
+            cb = _mm_unpacklo_epi64(cb, cb);
+            cr = _mm_unpacklo_epi64(cr, cr);
+            convert_ycbcr_16x1_avx2(dest, dest + stride, yy, cb, cr, state->rgba);
+            dest += stride * 2;
+        }
+
+        MANGO_UNREFERENCED_PARAMETER(width);
+        MANGO_UNREFERENCED_PARAMETER(height);
+    }
+
+    MANGO_TARGET("avx2")
+    void process_YCbCr_16x8_avx2(u8* dest, int stride, const BlockType* data, ProcessState* state, int width, int height)
+    {
+        u8 result[64 * 4];
+
+        idct2_avx2(result +   0, data +   0, state->block[0].qt, state->block[1].qt); // Y0, Y1
+        idct2_avx2(result + 128, data + 128, state->block[2].qt, state->block[3].qt); // Cb, Cr
+
+        // color conversion
+        for (int y = 0; y < 8; ++y)
+        {
+            __m128i yy = _mm_unpacklo_epi64(load64(result + y * 8), load64(result + y * 8 + 64));
+            __m128i cb = load64(result + y * 8 + 128);
+            __m128i cr = load64(result + y * 8 + 192);
+            cb = _mm_unpacklo_epi8(cb, cb);
+            cr = _mm_unpacklo_epi8(cr, cr);
+            convert_ycbcr_16x1_avx2(dest, dest + 32, yy, cb, cr, state->rgba);
             dest += stride;
         }
 
         MANGO_UNREFERENCED_PARAMETER(width);
         MANGO_UNREFERENCED_PARAMETER(height);
     }
-    
-    void process_YCbCr_16x16_sse2(u8* dest, int stride, const BlockType* data, ProcessState* state, int width, int height)
+
+    MANGO_TARGET("avx2")
+    void process_YCbCr_16x16_avx2(u8* dest, int stride, const BlockType* data, ProcessState* state, int width, int height)
     {
         u8 result[64 * 6];
 
-        state->idct(result +   0, data +   0, state->block[0].qt); // Y0
-        state->idct(result + 128, data +  64, state->block[1].qt); // Y1
-        state->idct(result +  64, data + 128, state->block[2].qt); // Y2
-        state->idct(result + 192, data + 192, state->block[3].qt); // Y3
-        state->idct(result + 256, data + 256, state->block[4].qt); // Cb
-        state->idct(result + 320, data + 320, state->block[5].qt); // Cr
+        idct2_avx2(result +   0, data +   0, state->block[0].qt, state->block[1].qt); // Y0, Y1
+        idct2_avx2(result + 128, data + 128, state->block[2].qt, state->block[3].qt); // Y2, Y3
+        idct2_avx2(result + 256, data + 256, state->block[4].qt, state->block[5].qt); // Cb, Cr
 
         // color conversion
-        const __m128i s0 = JPEG_CONST_SSE2(JPEG_FIXED( 1.00000), JPEG_FIXED( 1.40200));
-        const __m128i s1 = JPEG_CONST_SSE2(JPEG_FIXED( 1.00000), JPEG_FIXED( 1.77200));
-        const __m128i s2 = JPEG_CONST_SSE2(JPEG_FIXED(-0.34414), JPEG_FIXED(-0.71414));
-        const __m128i rounding = _mm_set1_epi32(1 << (JPEG_PREC - 1));
-        const __m128i tosigned = _mm_set1_epi16(-128);
+        for (int y = 0; y < 16; ++y)
+        {
+            const u8* s = result + (y >> 3) * 128 + (y & 7) * 8;
+            __m128i yy = _mm_unpacklo_epi64(load64(s), load64(s + 64));
+            __m128i cb = load64(result + (y >> 1) * 8 + 256);
+            __m128i cr = load64(result + (y >> 1) * 8 + 320);
+            cb = _mm_unpacklo_epi8(cb, cb);
+            cr = _mm_unpacklo_epi8(cr, cr);
+            convert_ycbcr_16x1_avx2(dest, dest + 32, yy, cb, cr, state->rgba);
+            dest += stride;
+        }
 
-        for (int y = 0; y < 4; ++y)
+        MANGO_UNREFERENCED_PARAMETER(width);
+        MANGO_UNREFERENCED_PARAMETER(height);
+    }
+
+#endif // MANGO_ENABLE_DISPATCH
+
+#endif // JPEG_ENABLE_SSE2
+
+#if defined(JPEG_ENABLE_NEON)
+
+    // ------------------------------------------------------------------------------------------------
+    // NEON implementation
+    // ------------------------------------------------------------------------------------------------
+
+    // Same fixed point computation as convert_ycbcr_8x1_sse2
+
+    static inline
+    void compute_ycbcr_8x1_neon(int16x8_t& r, int16x8_t& g, int16x8_t& b, int16x8_t y, int16x8_t cb, int16x8_t cr)
+    {
+        const s16 cr_r = JPEG_FIXED( 1.40200);
+        const s16 cb_b = JPEG_FIXED( 1.77200);
+        const s16 cb_g = JPEG_FIXED(-0.34414);
+        const s16 cr_g = JPEG_FIXED(-0.71414);
+
+        int32x4_t y_l = vshll_n_s16(vget_low_s16(y), JPEG_PREC);
+        int32x4_t y_h = vshll_n_s16(vget_high_s16(y), JPEG_PREC);
+
+        int32x4_t r_l = vmlal_n_s16(y_l, vget_low_s16(cr), cr_r);
+        int32x4_t r_h = vmlal_n_s16(y_h, vget_high_s16(cr), cr_r);
+
+        int32x4_t b_l = vmlal_n_s16(y_l, vget_low_s16(cb), cb_b);
+        int32x4_t b_h = vmlal_n_s16(y_h, vget_high_s16(cb), cb_b);
+
+        int32x4_t g_l = vmlal_n_s16(vmlal_n_s16(y_l, vget_low_s16(cb), cb_g), vget_low_s16(cr), cr_g);
+        int32x4_t g_h = vmlal_n_s16(vmlal_n_s16(y_h, vget_high_s16(cb), cb_g), vget_high_s16(cr), cr_g);
+
+        r = vcombine_s16(vqrshrn_n_s32(r_l, JPEG_PREC), vqrshrn_n_s32(r_h, JPEG_PREC));
+        g = vcombine_s16(vqrshrn_n_s32(g_l, JPEG_PREC), vqrshrn_n_s32(g_h, JPEG_PREC));
+        b = vcombine_s16(vqrshrn_n_s32(b_l, JPEG_PREC), vqrshrn_n_s32(b_h, JPEG_PREC));
+    }
+
+    static inline
+    void store_bgra_8x1_neon(u8* dest, int16x8_t r, int16x8_t g, int16x8_t b)
+    {
+        uint8x8x4_t bgra;
+        bgra.val[0] = vqmovun_s16(b);
+        bgra.val[1] = vqmovun_s16(g);
+        bgra.val[2] = vqmovun_s16(r);
+        bgra.val[3] = vdup_n_u8(0xff);
+        vst4_u8(dest, bgra);
+    }
+
+    static inline
+    void convert_ycbcr_8x1_neon(u8* dest, uint8x8_t y, uint8x8_t cb, uint8x8_t cr, bool rgba = false)
+    {
+        const int16x8_t tosigned = vdupq_n_s16(128);
+
+        int16x8_t r;
+        int16x8_t g;
+        int16x8_t b;
+
+        compute_ycbcr_8x1_neon(r, g, b,
+            vreinterpretq_s16_u16(vmovl_u8(y)),
+            vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(cb)), tosigned),
+            vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(cr)), tosigned));
+
+        if (rgba)
         {
-            __m128i y0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(result + y * 32 + 0));
-            __m128i y1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(result + y * 32 + 128));
-            __m128i y2 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(result + y * 32 + 16));
-            __m128i y3 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(result + y * 32 + 144));
-            __m128i cb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(result + y * 16 + 256));
-            __m128i cr = _mm_loadu_si128(reinterpret_cast<const __m128i *>(result + y * 16 + 320));
+            std::swap(r, b);
+        }
 
-            __m128i zero = _mm_setzero_si128();
-            __m128i cb0;
-            __m128i cb1;
-            __m128i cr0;
-            __m128i cr1;
+        store_bgra_8x1_neon(dest, r, g, b);
+    }
 
-            cb0 = _mm_unpacklo_epi8(cb, cb);
-            cr0 = _mm_unpacklo_epi8(cr, cr);
+    void convert_YCbCr_neon(u8* dest, const u8* y, const u8* cb, const u8* cr)
+    {
+        convert_ycbcr_8x1_neon(dest, vld1_u8(y), vld1_u8(cb), vld1_u8(cr));
+    }
 
-            cb1 = _mm_unpackhi_epi8(cb0, zero);
-            cr1 = _mm_unpackhi_epi8(cr0, zero);
-            cb0 = _mm_unpacklo_epi8(cb0, zero);
-            cr0 = _mm_unpacklo_epi8(cr0, zero);
+    // (255 - x) * k / 255 for 8 signed 16 bit x, result is rounded
+    static inline
+    int16x8_t scale_cmyk_neon(int16x8_t x, int16x8_t k)
+    {
+        x = vsubq_s16(vdupq_n_s16(255), x);
 
-            cb0 = _mm_add_epi16(cb0, tosigned);
-            cr0 = _mm_add_epi16(cr0, tosigned);
-            cb1 = _mm_add_epi16(cb1, tosigned);
-            cr1 = _mm_add_epi16(cr1, tosigned);
+        int32x4_t lo = vaddq_s32(vmull_s16(vget_low_s16(x), vget_low_s16(k)), vdupq_n_s32(128));
+        int32x4_t hi = vaddq_s32(vmull_s16(vget_high_s16(x), vget_high_s16(k)), vdupq_n_s32(128));
+
+        lo = vshrq_n_s32(vaddq_s32(lo, vshrq_n_s32(lo, 8)), 8);
+        hi = vshrq_n_s32(vaddq_s32(hi, vshrq_n_s32(hi, 8)), 8);
+
+        return vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi));
+    }
+
+    void convert_CMYK_neon(u8* dest, const u8* y, const u8* cb, const u8* cr, const u8* k)
+    {
+        const int16x8_t tosigned = vdupq_n_s16(128);
+
+        int16x8_t r;
+        int16x8_t g;
+        int16x8_t b;
+
+        compute_ycbcr_8x1_neon(r, g, b,
+            vreinterpretq_s16_u16(vmovl_u8(vld1_u8(y))),
+            vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vld1_u8(cb))), tosigned),
+            vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vld1_u8(cr))), tosigned));
+
+        int16x8_t kk = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(k)));
+
+        r = scale_cmyk_neon(r, kk);
+        g = scale_cmyk_neon(g, kk);
+        b = scale_cmyk_neon(b, kk);
+
+        store_bgra_8x1_neon(dest, r, g, b);
+    }
+
+    static inline
+    void compute_ycbcr_8x1_neon(uint8x8_t& r, uint8x8_t& g, uint8x8_t& b, const u8* y, const u8* cb, const u8* cr)
+    {
+        const int16x8_t tosigned = vdupq_n_s16(128);
+
+        int16x8_t r16;
+        int16x8_t g16;
+        int16x8_t b16;
+
+        compute_ycbcr_8x1_neon(r16, g16, b16,
+            vreinterpretq_s16_u16(vmovl_u8(vld1_u8(y))),
+            vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vld1_u8(cb))), tosigned),
+            vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vld1_u8(cr))), tosigned));
+
+        r = vqmovun_s16(r16);
+        g = vqmovun_s16(g16);
+        b = vqmovun_s16(b16);
+    }
+
+    void convert_YCbCr_RGBA_neon(u8* dest, const u8* y, const u8* cb, const u8* cr)
+    {
+        uint8x8x4_t rgba;
+        compute_ycbcr_8x1_neon(rgba.val[0], rgba.val[1], rgba.val[2], y, cb, cr);
+        rgba.val[3] = vdup_n_u8(0xff);
+        vst4_u8(dest, rgba);
+    }
+
+    void convert_YCbCr_RGB565_neon(u8* dest, const u8* y, const u8* cb, const u8* cr)
+    {
+        uint8x8_t r;
+        uint8x8_t g;
+        uint8x8_t b;
+        compute_ycbcr_8x1_neon(r, g, b, y, cb, cr);
+
+        uint16x8_t color = vshll_n_u8(r, 8);
+        color = vsriq_n_u16(color, vshll_n_u8(g, 8), 5);
+        color = vsriq_n_u16(color, vshll_n_u8(b, 8), 11);
+        vst1q_u16(reinterpret_cast<u16*>(dest), color);
+    }
+
+    void convert_YCbCr_RGBA32F_neon(u8* dest, const u8* y, const u8* cb, const u8* cr)
+    {
+        uint8x8_t r;
+        uint8x8_t g;
+        uint8x8_t b;
+        compute_ycbcr_8x1_neon(r, g, b, y, cb, cr);
+
+        const uint16x8_t r16 = vmovl_u8(r);
+        const uint16x8_t g16 = vmovl_u8(g);
+        const uint16x8_t b16 = vmovl_u8(b);
+        const float scale = 1.0f / 255.0f;
+
+        float* d = reinterpret_cast<float*>(dest);
+
+        float32x4x4_t lo;
+        lo.val[0] = vmulq_n_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(r16))), scale);
+        lo.val[1] = vmulq_n_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(g16))), scale);
+        lo.val[2] = vmulq_n_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(b16))), scale);
+        lo.val[3] = vdupq_n_f32(1.0f);
+        vst4q_f32(d + 0, lo);
+
+        float32x4x4_t hi;
+        hi.val[0] = vmulq_n_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(r16))), scale);
+        hi.val[1] = vmulq_n_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(g16))), scale);
+        hi.val[2] = vmulq_n_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(b16))), scale);
+        hi.val[3] = vdupq_n_f32(1.0f);
+        vst4q_f32(d + 16, hi);
+    }
+
+    // scale clamped 12 bit samples to 16 bits
+    static inline
+    uint16x8_t expand12_neon(int16x8_t x)
+    {
+        uint16x8_t s = vreinterpretq_u16_s16(vminq_s16(vmaxq_s16(x, vdupq_n_s16(0)), vdupq_n_s16(4095)));
+        return vorrq_u16(vshlq_n_u16(s, 4), vshrq_n_u16(s, 8));
+    }
+
+    void convert_YCbCr_12_neon(u8* dest, const u16* y, const u16* cb, const u16* cr)
+    {
+        // the constants have two more fractional bits than the 8 bit conversion
+        const int16_t s0 = JPEG_FIXED(1.40200 * 4);
+        const int16_t s1 = JPEG_FIXED(1.77200 * 4);
+        const int16_t s2 = JPEG_FIXED(-0.34414 * 4);
+        const int16_t s3 = JPEG_FIXED(-0.71414 * 4);
+        const int16x8_t tosigned = vdupq_n_s16(2048);
+
+        int16x8_t yy = vreinterpretq_s16_u16(vld1q_u16(y));
+        int16x8_t cb0 = vsubq_s16(vreinterpretq_s16_u16(vld1q_u16(cb)), tosigned);
+        int16x8_t cr0 = vsubq_s16(vreinterpretq_s16_u16(vld1q_u16(cr)), tosigned);
+
+        int32x4_t r_lo = vmull_n_s16(vget_low_s16(cr0), s0);
+        int32x4_t r_hi = vmull_n_s16(vget_high_s16(cr0), s0);
+        int32x4_t b_lo = vmull_n_s16(vget_low_s16(cb0), s1);
+        int32x4_t b_hi = vmull_n_s16(vget_high_s16(cb0), s1);
+        int32x4_t g_lo = vmlal_n_s16(vmull_n_s16(vget_low_s16(cb0), s2), vget_low_s16(cr0), s3);
+        int32x4_t g_hi = vmlal_n_s16(vmull_n_s16(vget_high_s16(cb0), s2), vget_high_s16(cr0), s3);
+
+        int16x8_t r = vcombine_s16(vrshrn_n_s32(r_lo, JPEG_PREC + 2), vrshrn_n_s32(r_hi, JPEG_PREC + 2));
+        int16x8_t g = vcombine_s16(vrshrn_n_s32(g_lo, JPEG_PREC + 2), vrshrn_n_s32(g_hi, JPEG_PREC + 2));
+        int16x8_t b = vcombine_s16(vrshrn_n_s32(b_lo, JPEG_PREC + 2), vrshrn_n_s32(b_hi, JPEG_PREC + 2));
+
+        uint16x8x4_t rgba;
+        rgba.val[0] = expand12_neon(vaddq_s16(yy, r));
+        rgba.val[1] = expand12_neon(vaddq_s16(yy, g));
+        rgba.val[2] = expand12_neon(vaddq_s16(yy, b));
+        rgba.val[3] = vdupq_n_u16(0xffff);
+        vst4q_u16(reinterpret_cast<u16*>(dest), rgba);
+    }
+
+    void process_YCbCr_8x8_neon(u8* dest, int stride, const BlockType* data, ProcessState* state, int width, int height)
+    {
+        u8 result[64 * 3];
+
+        state->idct(result +   0, data +   0, state->block[0].qt); // Y
+        state->idct(result +  64, data +  64, state->block[1].qt); // Cb
+        state->idct(result + 128, data + 128, state->block[2].qt); // Cr
 
-            convert_ycbcr_8x1_sse2(dest +  0, _mm_unpacklo_epi8(y0, zero), cb0, cr0, s0, s1, s2, rounding);
-            convert_ycbcr_8x1_sse2(dest + 32, _mm_unpacklo_epi8(y1, zero), cb1, cr1, s0, s1, s2, rounding);
+        // color conversion
+        for (int y = 0; y < 8; ++y)
+        {
+            const u8* s = result + y * 8;
+            convert_ycbcr_8x1_neon(dest, vld1_u8(s), vld1_u8(s + 64), vld1_u8(s + 128), state->rgba);
             dest += stride;
+        }
+
+        MANGO_UNREFERENCED_PARAMETER(width);
+        MANGO_UNREFERENCED_PARAMETER(height);
+    }
+
+    void process_YCbCr_8x16_neon(u8* dest, int stride, const BlockType* data, ProcessState* state, int width, int height)
+    {
+        u8 result[64 * 4];
+
+        state->idct(result +   0, data +   0, state->block[0].qt); // Y0
+        state->idct(result +  64, data +  64, state->block[1].qt); // Y1
+        state->idct(result + 128, data + 128, state->block[2].qt); // Cb
+        state->idct(result + 192, data + 192, state->block[3].qt); // Cr
+
+        // color conversion
+        for (int y = 0; y < 8; ++y)
+        {
+            const u8* s = result + y * 16;
+            uint8x8_t cb = vld1_u8(result + y * 8 + 128);
+            uint8x8_t cr = vld1_u8(result + y * 8 + 192);
 
-            convert_ycbcr_8x1_sse2(dest +  0, _mm_unpackhi_epi8(y0, zero), cb0, cr0, s0, s1, s2, rounding);
-            convert_ycbcr_8x1_sse2(dest + 32, _mm_unpackhi_epi8(y1, zero), cb1, cr1, s0, s1, s2, rounding);
+            convert_ycbcr_8x1_neon(dest, vld1_u8(s + 0), cb, cr, state->rgba);
             dest += stride;
 
-            cb0 = _mm_unpackhi_epi8(cb, cb);
-            cr0 = _mm_unpackhi_epi8(cr, cr);
+            convert_ycbcr_8x1_neon(dest, vld1_u8(s + 8), cb, cr, state->rgba);
+            dest += stride;
+        }
 
-            cb1 = _mm_unpackhi_epi8(cb0, zero);
-            cr1 = _mm_unpackhi_epi8(cr0, zero);
-            cb0 = _mm_unpacklo_epi8(cb0, zero);
-            cr0 = _mm_unpacklo_epi8(cr0, zero);
+        MANGO_UNREFERENCED_PARAMETER(width);
+        MANGO_UNREFERENCED_PARAMETER(height);
+    }
 
-            cb0 = _mm_add_epi16(cb0, tosigned);
-            cr0 = _mm_add_epi16(cr0, tosigned);
-            cb1 = _mm_add_epi16(cb1, tosigned);
-            cr1 = _mm_add_epi16(cr1, tosigned);
+    void process_YCbCr_16x8_neon(u8* dest, int stride, const BlockType* data, ProcessState* state, int width, int height)
+    {
+        u8 result[64 * 4];
+
+        state->idct(result +   0, data +   0, state->block[0].qt); // Y0
+        state->idct(result +  64, data +  64, state->block[1].qt); // Y1
+        state->idct(result + 128, data + 128, state->block[2].qt); // Cb
+        state->idct(result + 192, data + 192, state->block[3].qt); // Cr
+
+        // color conversion
+        for (int y = 0; y < 8; ++y)
+        {
+            const u8* s = result + y * 8;
+            uint8x8x2_t cb = vzip_u8(vld1_u8(s + 128), vld1_u8(s + 128));
+            uint8x8x2_t cr = vzip_u8(vld1_u8(s + 192), vld1_u8(s + 192));
 
-            convert_ycbcr_8x1_sse2(dest +  0, _mm_unpacklo_epi8(y2, zero), cb0, cr0, s0, s1, s2, rounding);
-            convert_ycbcr_8x1_sse2(dest + 32, _mm_unpacklo_epi8(y3, zero), cb1, cr1, s0, s1, s2, rounding);
+            convert_ycbcr_8x1_neon(dest +  0, vld1_u8(s +  0), cb.val[0], cr.val[0], state->rgba);
+            convert_ycbcr_8x1_neon(dest + 32, vld1_u8(s + 64), cb.val[1], cr.val[1], state->rgba);
             dest += stride;
+        }
+
+        MANGO_UNREFERENCED_PARAMETER(width);
+        MANGO_UNREFERENCED_PARAMETER(height);
+    }
+
+    void process_YCbCr_16x16_neon(u8* dest, int stride, const BlockType* data, ProcessState* state, int width, int height)
+    {
+        u8 result[64 * 6];
+
+        state->idct(result +   0, data +   0, state->block[0].qt); // Y0
+        state->idct(result +  64, data +  64, state->block[1].qt); // Y1
+        state->idct(result + 128, data + 128, state->block[2].qt); // Y2
+        state->idct(result + 192, data + 192, state->block[3].qt); // Y3
+        state->idct(result + 256, data + 256, state->block[4].qt); // Cb
+        state->idct(result + 320, data + 320, state->block[5].qt); // Cr
 
-            convert_ycbcr_8x1_sse2(dest +  0, _mm_unpackhi_epi8(y2, zero), cb0, cr0, s0, s1, s2, rounding);
-            convert_ycbcr_8x1_sse2(dest + 32, _mm_unpackhi_epi8(y3, zero), cb1, cr1, s0, s1, s2, rounding);
+        // color conversion
+        for (int y = 0; y < 16; ++y)
+        {
+            const u8* s = result + (y >> 3) * 128 + (y & 7) * 8;
+            const u8* c = result + (y >> 1) * 8 + 256;
+            uint8x8x2_t cb = vzip_u8(vld1_u8(c +  0), vld1_u8(c +  0));
+            uint8x8x2_t cr = vzip_u8(vld1_u8(c + 64), vld1_u8(c + 64));
+
+            convert_ycbcr_8x1_neon(dest +  0, vld1_u8(s +  0), cb.val[0], cr.val[0], state->rgba);
+            convert_ycbcr_8x1_neon(dest + 32, vld1_u8(s + 64), cb.val[1], cr.val[1], state->rgba);
             dest += stride;
         }
 
@@ -678,6 +2244,6 @@ void process_YCbCr_16x16(u8* dest, int stride, const BlockType* data, ProcessSta
         MANGO_UNREFERENCED_PARAMETER(height);
     }
 
-#endif // JPEG_ENABLE_SSE2
+#endif // JPEG_ENABLE_NEON
 
 } // namespace jpeg
@@ -0,0 +1,318 @@
+/*
+    MANGO Multimedia Development Platform
+    Copyright (C) 2012-2019 Twilight Finland 3D Oy Ltd. All rights reserved.
+*/
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <algorithm>
+#include "jpeg.hpp"
+#include "../image/resample.hpp"
+
+namespace
+{
+
+    using namespace mango;
+    using namespace jpeg;
+
+    // ----------------------------------------------------------------------------
+    // RowResampler
+    // ----------------------------------------------------------------------------
+
+    // Separable resampler of 32 bit pixels which is fed with the source rows from top to bottom.
+    // The rows are filtered horizontally as they arrive into a ring buffer which is large enough
+    // for the vertical filter; a destination row is ready when its last source row has arrived.
+    // The filter is stretched by the reduction ratio so that it averages all the source samples
+    // when reducing. The filtering is done with the resize kernels.
+    class RowResampler
+    {
+    protected:
+        detail::FilterTable m_xfilter;
+        detail::FilterTable m_yfilter;
+
+        int m_width;    // destination width
+        int m_height;   // destination height
+
+        std::vector<u8> m_ring; // horizontally filtered source rows
+        std::vector<const u8*> m_rows;
+        int m_input;    // source rows given
+        int m_output;   // destination rows produced
+
+        u8* row(int y)
+        {
+            return m_ring.data() + size_t(y % m_yfilter.taps) * m_width * 4;
+        }
+
+    public:
+        RowResampler(int sourceWidth, int sourceHeight, int width, int height)
+            : m_xfilter(sourceWidth, width, ResizeFilter::BILINEAR)
+            , m_yfilter(sourceHeight, height, ResizeFilter::BILINEAR)
+            , m_width(width)
+            , m_height(height)
+            , m_ring(size_t(m_yfilter.taps) * width * 4)
+            , m_rows(m_yfilter.taps)
+            , m_input(0)
+            , m_output(0)
+        {
+        }
+
+        void push(const u8* source)
+        {
+            u8* dest = row(m_input++);
+
+            if (m_xfilter.identity)
+            {
+                std::memcpy(dest, source, m_width * 4);
+                return;
+            }
+
+            detail::resample_row(dest, source, m_xfilter, m_width);
+        }
+
+        bool ready() const
+        {
+            return m_output < m_height &&
+                   m_yfilter.start[m_output] + m_yfilter.count[m_output] <= m_input;
+        }
+
+        void pop(u8* dest)
+        {
+            const int y = m_output++;
+            const int size = m_width * 4;
+
+            if (m_yfilter.identity)
+            {
+                std::memcpy(dest, row(y), size);
+                return;
+            }
+
+            const s16* weight = m_yfilter.fixed.data() + size_t(y) * m_yfilter.taps;
+            const int first = m_yfilter.start[y];
+            const int count = m_yfilter.count[y];
+
+            for (int i = 0; i < count; ++i)
+            {
+                m_rows[i] = row(first + i);
+            }
+
+            detail::resample_column(dest, m_rows.data(), weight, count, size);
+        }
+    };
+
+    // ----------------------------------------------------------------------------
+    // TranscodeOutput
+    // ----------------------------------------------------------------------------
+
+    // Resizes the decoded bands into the output. The baseline JPEG outputs are encoded a band
+    // of MCU rows at a time; the other outputs collect the image and encode it at the end.
+    struct TranscodeOutput
+    {
+        const JPEGTranscode& desc;
+
+        RowResampler resampler;
+        std::unique_ptr<RowEncoder> encoder;
+        std::unique_ptr<Bitmap> image;
+        int rows; // rows in the image
+
+        TranscodeOutput(const JPEGTranscode& desc, int sourceWidth, int sourceHeight, int width, int height)
+            : desc(desc)
+            , resampler(sourceWidth, sourceHeight, width, height)
+            , rows(0)
+        {
+            const std::string extension = toLower(filesystem::getExtension(desc.extension));
+            const bool jpeg = extension == ".jpg" || extension == ".jpeg";
+
+            if (jpeg && !desc.options.optimize && !desc.options.progressive)
+            {
+                encoder.reset(new RowEncoder(*desc.output, width, height, FORMAT_R8G8B8A8, desc.options));
+
+                // a few rows of MCUs are encoded in parallel
+                const int count = std::max(1, std::min(ThreadPool::getInstanceSize(), 8));
+                height = std::min(height, encoder->getBandHeight() * count);
+            }
+
+            image.reset(new Bitmap(width, height, FORMAT_R8G8B8A8));
+        }
+
+        void push(const Surface& band)
+        {
+            for (int y = 0; y < band.height; ++y)
+            {
+                resampler.push(band.address<u8>(0, y));
+
+                while (resampler.ready())
+                {
+                    resampler.pop(image->address<u8>(0, rows++));
+
+                    if (encoder && rows == image->height)
+                    {
+                        encoder->encode(*image);
+                        rows = 0;
+                    }
+                }
+            }
+        }
+
+        void finish()
+        {
+            if (encoder)
+            {
+                if (rows)
+                {
+                    encoder->encode(Surface(*image, 0, 0, image->width, rows));
+                }
+            }
+            else
+            {
+                ImageEncoder imageEncoder(desc.extension);
+                imageEncoder.encode(*desc.output, *image, desc.options);
+            }
+        }
+    };
+
+} // namespace
+
+namespace jpeg
+{
+
+    Status Parser::transcode(const std::vector<JPEGTranscode>& outputs)
+    {
+        Status status;
+
+        status.success = false;
+        status.enableDirectDecode = false;
+
+        if (!scan_memory.address)
+        {
+            status.info = "Unsupported image.";
+            return status;
+        }
+
+        // output sizes
+        std::vector<int> widths;
+        std::vector<int> heights;
+
+        int maxWidth = 0;
+        int maxHeight = 0;
+
+        for (const JPEGTranscode& desc : outputs)
+        {
+            if (!desc.output || !isImageEncoder(desc.extension) || desc.width < 0 || desc.height < 0)
+            {
+                status.info = "Incorrect output.";
+                return status;
+            }
+
+            int width = desc.width;
+            int height = desc.height;
+
+            if (!width && !height)
+            {
+                width = xsize;
+                height = ysize;
+            }
+            else if (!width)
+            {
+                width = std::max(1, int((s64(height) * xsize + ysize / 2) / ysize));
+            }
+            else if (!height)
+            {
+                height = std::max(1, int((s64(width) * ysize + xsize / 2) / xsize));
+            }
+
+            widths.push_back(width);
+            heights.push_back(height);
+
+            maxWidth = std::max(maxWidth, width);
+            maxHeight = std::max(maxHeight, height);
+        }
+
+        // largest reduction which keeps the decoded image at least as large as the outputs
+        int scale = 8;
+
+        for (int s = 1; s < 8; s *= 2)
+        {
+            if ((xsize * s + 7) / 8 >= maxWidth && (ysize * s + 7) / 8 >= maxHeight)
+            {
+                scale = s;
+                break;
+            }
+        }
+
+        std::vector<std::unique_ptr<TranscodeOutput>> targets;
+        int sourceHeight = (ysize * scale + 7) / 8;
+
+        // the outputs are resized in parallel
+        BandFunc func = [&] (const Surface& band, int y)
+        {
+            MANGO_UNREFERENCED_PARAMETER(y);
+
+            if (targets.empty())
+            {
+                // the outputs are created with the first band; nothing is written before it
+                for (size_t i = 0; i < outputs.size(); ++i)
+                {
+                    targets.emplace_back(new TranscodeOutput(outputs[i], band.width, sourceHeight, widths[i], heights[i]));
+                }
+            }
+
+            ConcurrentQueue queue("jpeg.transcode", Priority::HIGH);
+
+            for (auto& target : targets)
+            {
+                TranscodeOutput* output = target.get();
+
+                queue.enqueue([output, &band] {
+                    output->push(band);
+                });
+            }
+
+            queue.wait();
+        };
+
+        Status decoded;
+
+        if (!is_lossless && precision == 8 && setOutputFormat(FORMAT_R8G8B8A8))
+        {
+            decoded = decodeBands(func, FORMAT_R8G8B8A8, scale);
+        }
+        else
+        {
+            // the lossless, 12 bit and CMYK images are decoded at once
+            Bitmap image(xsize, ysize, FORMAT_R8G8B8A8);
+            decoded = decode(image);
+
+            if (decoded.success)
+            {
+                sourceHeight = ysize;
+                func(image, 0);
+            }
+        }
+
+        if (!decoded.success)
+        {
+            // the outputs which were written a band at a time are left incomplete
+            decoded.enableDirectDecode = false;
+            return decoded;
+        }
+
+        ConcurrentQueue queue("jpeg.transcode", Priority::HIGH);
+
+        for (auto& target : targets)
+        {
+            TranscodeOutput* output = target.get();
+
+            queue.enqueue([output] {
+                output->finish();
+            });
+        }
+
+        queue.wait();
+
+        status.success = true;
+        status.info = m_info;
+
+        return status;
+    }
+
+} // namespace jpeg
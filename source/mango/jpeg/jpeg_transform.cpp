@@ -0,0 +1,393 @@
+/*
+    MANGO Multimedia Development Platform
+    Copyright (C) 2012-2019 Twilight Finland 3D Oy Ltd. All rights reserved.
+*/
+#include <cstring>
+#include <algorithm>
+#include <mango/core/endian.hpp>
+#include "jpeg.hpp"
+
+namespace
+{
+
+    using namespace mango;
+    using namespace jpeg;
+
+    // natural order index of each zigzag position
+    const int g_zigzag_natural [] =
+    {
+         0,  1,  8, 16,  9,  2,  3, 10, 17, 24, 32, 25, 18, 11,  4,  5,
+        12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13,  6,  7, 14, 21, 28,
+        35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+        58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63,
+    };
+
+    // Mapping from the output to the source: the output coordinates are swapped when
+    // transposed and then mirrored along the source axes. Mirroring negates the odd
+    // frequencies of a DCT block and transposing transposes the block.
+    struct BlockTransform
+    {
+        bool transpose;
+        bool xflip;
+        bool yflip;
+    };
+
+    BlockTransform getBlockTransform(JPEGTransform::Operation operation)
+    {
+        switch (operation)
+        {
+            case JPEGTransform::NONE:            return { false, false, false };
+            case JPEGTransform::FLIP_HORIZONTAL: return { false, true,  false };
+            case JPEGTransform::FLIP_VERTICAL:   return { false, false, true  };
+            case JPEGTransform::TRANSPOSE:       return { true,  false, false };
+            case JPEGTransform::TRANSVERSE:      return { true,  true,  true  };
+            case JPEGTransform::ROTATE_90:       return { true,  false, true  };
+            case JPEGTransform::ROTATE_180:      return { false, true,  true  };
+            case JPEGTransform::ROTATE_270:      return { true,  true,  false };
+        }
+
+        return { false, false, false };
+    }
+
+    // transform which applies first and then second
+    BlockTransform combine(const BlockTransform& first, const BlockTransform& second)
+    {
+        BlockTransform result;
+
+        result.transpose = first.transpose != second.transpose;
+        result.xflip = first.xflip != (first.transpose ? second.yflip : second.xflip);
+        result.yflip = first.yflip != (first.transpose ? second.xflip : second.yflip);
+
+        return result;
+    }
+
+    // operation which displays an image with the Exif orientation upright
+    JPEGTransform::Operation getOrientationOperation(u16 orientation)
+    {
+        switch (orientation)
+        {
+            case 2: return JPEGTransform::FLIP_HORIZONTAL;
+            case 3: return JPEGTransform::ROTATE_180;
+            case 4: return JPEGTransform::FLIP_VERTICAL;
+            case 5: return JPEGTransform::TRANSPOSE;
+            case 6: return JPEGTransform::ROTATE_90;
+            case 7: return JPEGTransform::TRANSVERSE;
+            case 8: return JPEGTransform::ROTATE_270;
+        }
+
+        return JPEGTransform::NONE;
+    }
+
+    // set the Orientation tag of the first IFD in an APP1 Exif segment to top-left
+    void resetOrientation(u8* segment, size_t size)
+    {
+        const u8 magicExif[] = { 0x45, 0x78, 0x69, 0x66, 0 }; // 'Exif', 0
+
+        // marker, length and the Exif identifier come before the TIFF header
+        if (size < 20 || std::memcmp(segment + 4, magicExif, 5))
+            return;
+
+        u8* start = segment + 10;
+        u8* end = segment + size;
+
+        bool littleEndian;
+
+        switch (uload16be(start))
+        {
+            case 0x4949:
+                littleEndian = true;
+                break;
+            case 0x4d4d:
+                littleEndian = false;
+                break;
+            default:
+                return;
+        }
+
+        auto read16 = [=] (const u8* p) { return littleEndian ? uload16le(p) : uload16be(p); };
+
+        u32 offset = littleEndian ? uload32le(start + 4) : uload32be(start + 4);
+        if (offset > u32(end - start - 2))
+            return;
+
+        u8* p = start + offset;
+        const int count = read16(p);
+        p += 2;
+
+        for (int i = 0; i < count && p + 12 <= end; ++i)
+        {
+            // Orientation, SHORT
+            if (read16(p + 0) == 0x0112 && read16(p + 2) == 3)
+            {
+                if (littleEndian)
+                    ustore16le(p + 8, 1);
+                else
+                    ustore16be(p + 8, 1);
+                return;
+            }
+
+            p += 12;
+        }
+    }
+
+    // Source range of one output axis in MCUs.
+    struct AxisRange
+    {
+        int mcu;    // first source MCU
+        int count;  // number of MCUs
+        int size;   // output size in pixels
+    };
+
+    bool cropAxis(AxisRange& range, int length, int mcu, bool mirror, int offset, int size)
+    {
+        if (mirror)
+        {
+            // the partial MCU would end up on the wrong side of the image
+            length -= length % mcu;
+        }
+
+        if (offset < 0 || size < 0)
+            return false;
+
+        if (!size)
+        {
+            offset = 0;
+            size = length;
+        }
+        else
+        {
+            size += offset % mcu;
+            offset -= offset % mcu;
+        }
+
+        if (offset >= length)
+            return false;
+
+        size = std::min(size, length - offset);
+
+        const int count = (size + mcu - 1) / mcu;
+
+        range.mcu = mirror ? (length - offset) / mcu - count : offset / mcu;
+        range.count = count;
+        range.size = size;
+
+        return true;
+    }
+
+} // namespace
+
+namespace jpeg
+{
+
+    Status Parser::transform(Stream& output, const JPEGTransform& transform)
+    {
+        Status status;
+
+        status.success = false;
+        status.enableDirectDecode = false;
+
+        m_info = "";
+
+        const int comps = processState.frames;
+
+        if (!scan_memory.address || is_lossless || precision != 8 || (comps != 1 && comps != 3))
+        {
+            status.info = "Unsupported image.";
+            return status;
+        }
+
+        // sampling factors; the frames have them as shifts from the maximum
+        int hsf[3];
+        int vsf[3];
+
+        for (int i = 0; i < comps; ++i)
+        {
+            hsf[i] = Hmax >> processState.frame[i].Hsf;
+            vsf[i] = Vmax >> processState.frame[i].Vsf;
+        }
+
+        // the encoder has one block of each chrominance component in a MCU
+        if (comps == 3 && (hsf[1] != 1 || vsf[1] != 1 || hsf[2] != 1 || vsf[2] != 1 ||
+                           processState.frame[1].Tq != processState.frame[2].Tq))
+        {
+            status.info = "Unsupported sampling factors.";
+            return status;
+        }
+
+        BlockTransform operation = getBlockTransform(transform.operation);
+
+        if (transform.orient && exif_memory.address)
+        {
+            mango::Exif exif(exif_memory);
+            operation = combine(getBlockTransform(getOrientationOperation(exif.Orientation)), operation);
+        }
+
+        // the crop rectangle is in the output image
+        AxisRange xrange;
+        AxisRange yrange;
+
+        bool crop;
+
+        if (operation.transpose)
+        {
+            crop = cropAxis(xrange, xsize, xblock, operation.xflip, transform.y, transform.height) &&
+                   cropAxis(yrange, ysize, yblock, operation.yflip, transform.x, transform.width);
+        }
+        else
+        {
+            crop = cropAxis(xrange, xsize, xblock, operation.xflip, transform.x, transform.width) &&
+                   cropAxis(yrange, ysize, yblock, operation.yflip, transform.y, transform.height);
+        }
+
+        if (!crop)
+        {
+            status.info = "Incorrect crop rectangle.";
+            return status;
+        }
+
+        // source location of the output coefficients in zigzag order
+        int inverse[64];
+        int index[64];
+        bool negate[64];
+
+        for (int i = 0; i < 64; ++i)
+        {
+            inverse[g_zigzag_natural[i]] = i;
+        }
+
+        for (int i = 0; i < 64; ++i)
+        {
+            const int v = g_zigzag_natural[i] >> 3;
+            const int u = g_zigzag_natural[i] & 7;
+            const int row = operation.transpose ? u : v;
+            const int col = operation.transpose ? v : u;
+
+            index[i] = decodeState.zigzagTable[inverse[row * 8 + col]];
+            negate[i] = (operation.xflip && (col & 1)) != (operation.yflip && (row & 1));
+        }
+
+        CoefficientImage image;
+
+        image.width = operation.transpose ? yrange.size : xrange.size;
+        image.height = operation.transpose ? xrange.size : yrange.size;
+        image.components = comps;
+        image.hsf = operation.transpose ? vsf[0] : hsf[0];
+        image.vsf = operation.transpose ? hsf[0] : vsf[0];
+
+        for (int i = 0; i < comps; ++i)
+        {
+            image.compid[i] = u8(processState.frame[i].compid);
+        }
+
+        // the quantization tables are transposed with the coefficients
+        for (int i = 0; i < std::min(comps, 2); ++i)
+        {
+            const u16* table = quantTable[processState.frame[i].Tq].table;
+
+            for (int j = 0; j < 64; ++j)
+            {
+                const u16 value = table[index[j]];
+                if (value > 255)
+                {
+                    status.info = "16 bit quantization tables are not supported.";
+                    return status;
+                }
+
+                image.qtable[i][j] = u8(value);
+            }
+        }
+
+        if (comps == 1)
+        {
+            std::memcpy(image.qtable[1], image.qtable[0], 64);
+        }
+
+        if (!decodeCoefficients())
+        {
+            return status;
+        }
+
+        // output MCUs
+        const int xmcus = operation.transpose ? yrange.count : xrange.count;
+        const int ymcus = operation.transpose ? xrange.count : yrange.count;
+        const int mcu_data_size = blocks_in_mcu * 64;
+
+        AlignedVector<BlockType> coefficients(size_t(xmcus) * ymcus * mcu_data_size);
+        BlockType* dest = coefficients.data();
+
+        for (int y = 0; y < ymcus; ++y)
+        {
+            for (int x = 0; x < xmcus; ++x)
+            {
+                for (int c = 0; c < comps; ++c)
+                {
+                    const Frame& frame = processState.frame[c];
+
+                    const int xcount = operation.transpose ? vsf[c] : hsf[c];
+                    const int ycount = operation.transpose ? hsf[c] : vsf[c];
+
+                    // source blocks of the component along the source axes
+                    const int xblocks = xrange.count * hsf[c];
+                    const int yblocks = yrange.count * vsf[c];
+
+                    for (int j = 0; j < ycount; ++j)
+                    {
+                        for (int i = 0; i < xcount; ++i)
+                        {
+                            int bx = x * xcount + i;
+                            int by = y * ycount + j;
+
+                            if (operation.transpose)
+                            {
+                                std::swap(bx, by);
+                            }
+
+                            const int sx = xrange.mcu * hsf[c] + (operation.xflip ? xblocks - 1 - bx : bx);
+                            const int sy = yrange.mcu * vsf[c] + (operation.yflip ? yblocks - 1 - by : by);
+
+                            const int mcu = (sy / vsf[c]) * xmcu + sx / hsf[c];
+                            const int block = frame.offset + (sy % vsf[c]) * hsf[c] + sx % hsf[c];
+                            const BlockType* source = blockVector + size_t(mcu) * mcu_data_size + block * 64;
+
+                            for (int k = 0; k < 64; ++k)
+                            {
+                                const BlockType s = source[index[k]];
+                                dest[k] = negate[k] ? -s : s;
+                            }
+
+                            dest += 64;
+                        }
+                    }
+                }
+            }
+        }
+
+        image.blocks = coefficients.data();
+
+        // copy the metadata; the orientation has been applied
+        std::vector<Memory> markers = marker_memory;
+        std::vector<u8> exif;
+
+        if (transform.orient && exif_memory.address)
+        {
+            for (Memory& marker : markers)
+            {
+                if (exif_memory.address > marker.address && exif_memory.address < marker.address + marker.size)
+                {
+                    exif.assign(marker.address, marker.address + marker.size);
+                    resetOrientation(exif.data(), exif.size());
+                    marker = Memory(exif.data(), exif.size());
+                    break;
+                }
+            }
+        }
+
+        EncodeCoefficients(output, image, markers, transform.progressive);
+
+        status.success = true;
+        status.info = m_info;
+
+        return status;
+    }
+
+} // namespace jpeg